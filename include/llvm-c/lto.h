@@ -20,7 +20,7 @@
 #include <stddef.h>
 #include <unistd.h>
 
-#define LTO_API_VERSION 4
+#define LTO_API_VERSION 6
 
 typedef enum {
     LTO_SYMBOL_ALIGNMENT_MASK              = 0x0000001F, /* log2 of alignment */
@@ -229,6 +229,23 @@ extern void
 lto_codegen_set_cpu(lto_code_gen_t cg, const char *cpu);
 
 
+/**
+ * Turns on incremental compilation, caching the object files produced and
+ * the summaries of the modules in the directory at path.  Instead of being
+ * merged, each module is optimized and code generated on its own, after
+ * importing the small functions it calls from other modules, and is only
+ * compiled again when it or a module it imports from changes.  Code can
+ * only be generated with lto_codegen_compile_to_files(), which produces an
+ * object file for each module.  Once the cache grows beyond the size given
+ * by the -lto-cache-size code generation option, in megabytes (1024 unless
+ * set), its least recently used entries are removed.  Must be called before
+ * any module is added.
+ * Returns true on error (check lto_get_error_message() for details).
+ */
+extern bool
+lto_codegen_set_cache_dir(lto_code_gen_t cg, const char* path);
+
+
 /**
  * Sets the location of the assembler tool to run. If not set, libLTO
  * will use gcc to invoke the assembler.
@@ -279,6 +296,17 @@ lto_codegen_compile(lto_code_gen_t cg, size_t* length);
 extern bool
 lto_codegen_compile_to_file(lto_code_gen_t cg, const char** name);
 
+/**
+ * Generates code for all added modules into one or more native object files.
+ * The merged module is split into as many partitions as the -lto-partitions
+ * code generator option asks for, and they are code generated in parallel.
+ * On success, names is set to an array of count file names, which is owned
+ * by the lto_code_gen_t.  Returns true on error.
+ */
+extern bool
+lto_codegen_compile_to_files(lto_code_gen_t cg, const char*** names,
+                             unsigned* count);
+
 
 /**
  * Sets options to help debug codegen bugs.
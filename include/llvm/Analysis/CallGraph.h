@@ -55,7 +55,9 @@
 #include "llvm/Pass.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Atomic.h"
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/ValueHandle.h"
 #include "llvm/Support/IncludeFile.h"
 #include <map>
@@ -76,6 +78,12 @@ protected:
   typedef std::map<const Function *, CallGraphNode *> FunctionMapTy;
   FunctionMapTy FunctionMap;    // Map from a function to its node
 
+  // MapLock - Guards FunctionMap when the call graph is updated by several
+  // threads at once, as the CGSCC pass manager does with -cgscc-threads.  The
+  // call edges of a node are not guarded: only the thread working on the SCC
+  // that contains a node changes its edges.
+  mutable sys::SmartMutex<true> MapLock;
+
 public:
   static char ID; // Class identification, replacement for typeinfo
   //===---------------------------------------------------------------------
@@ -96,11 +104,13 @@ public:
   // Subscripting operators, return the call graph node for the provided
   // function
   inline const CallGraphNode *operator[](const Function *F) const {
+    sys::SmartScopedLock<true> Guard(MapLock);
     const_iterator I = FunctionMap.find(F);
     assert(I != FunctionMap.end() && "Function not in callgraph!");
     return I->second;
   }
   inline CallGraphNode *operator[](const Function *F) {
+    sys::SmartScopedLock<true> Guard(MapLock);
     const_iterator I = FunctionMap.find(F);
     assert(I != FunctionMap.end() && "Function not in callgraph!");
     return I->second;
@@ -182,14 +192,16 @@ private:
   std::vector<CallRecord> CalledFunctions;
   
   /// NumReferences - This is the number of times that this CallGraphNode occurs
-  /// in the CalledFunctions array of this or other CallGraphNodes.
-  unsigned NumReferences;
+  /// in the CalledFunctions array of this or other CallGraphNodes.  Nodes in
+  /// different SCCs may gain or lose edges to the same callee concurrently, so
+  /// it is updated atomically.
+  volatile sys::cas_flag NumReferences;
 
   CallGraphNode(const CallGraphNode &);            // DO NOT IMPLEMENT
   void operator=(const CallGraphNode &);           // DO NOT IMPLEMENT
   
-  void DropRef() { --NumReferences; }
-  void AddRef() { ++NumReferences; }
+  void DropRef() { sys::AtomicDecrement(&NumReferences); }
+  void AddRef() { sys::AtomicIncrement(&NumReferences); }
 public:
   typedef std::vector<CallRecord> CalledFunctionsVector;
 
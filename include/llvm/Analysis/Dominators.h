@@ -17,6 +17,7 @@
 
 #include "llvm/Pass.h"
 #include "llvm/Function.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/GraphTraits.h"
@@ -26,6 +27,7 @@
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <queue>
 
 namespace llvm {
 
@@ -66,6 +68,7 @@ class DomTreeNodeBase {
   DomTreeNodeBase<NodeT> *IDom;
   std::vector<DomTreeNodeBase<NodeT> *> Children;
   int DFSNumIn, DFSNumOut;
+  unsigned Level;
 
   template<class N> friend class DominatorTreeBase;
   friend struct PostDominatorTree;
@@ -85,8 +88,13 @@ public:
     return Children;
   }
 
+  /// getLevel - Return the depth of this node in the tree.  The root is at
+  /// level 0.
+  unsigned getLevel() const { return Level; }
+
   DomTreeNodeBase(NodeT *BB, DomTreeNodeBase<NodeT> *iDom)
-    : TheBB(BB), IDom(iDom), DFSNumIn(-1), DFSNumOut(-1) { }
+    : TheBB(BB), IDom(iDom), DFSNumIn(-1), DFSNumOut(-1),
+      Level(iDom ? iDom->Level + 1 : 0) { }
 
   DomTreeNodeBase<NodeT> *addChild(DomTreeNodeBase<NodeT> *C) {
     Children.push_back(C);
@@ -132,6 +140,7 @@ public:
       // Switch to new dominator
       IDom = NewIDom;
       IDom->Children.push_back(this);
+      updateLevel();
     }
   }
 
@@ -140,6 +149,24 @@ public:
   unsigned getDFSNumIn() const { return DFSNumIn; }
   unsigned getDFSNumOut() const { return DFSNumOut; }
 private:
+  // Recompute the level of this node and of everything it dominates after its
+  // immediate dominator changed.
+  void updateLevel() {
+    if (Level == IDom->Level + 1)
+      return;
+
+    Level = IDom->Level + 1;
+    SmallVector<DomTreeNodeBase<NodeT>*, 16> Worklist;
+    Worklist.push_back(this);
+    while (!Worklist.empty()) {
+      DomTreeNodeBase<NodeT> *N = Worklist.pop_back_val();
+      for (iterator I = N->begin(), E = N->end(); I != E; ++I) {
+        (*I)->Level = N->Level + 1;
+        Worklist.push_back(*I);
+      }
+    }
+  }
+
   // Return true if this node is dominated by other. Use this only if DFS info
   // is valid.
   bool DominatedBy(const DomTreeNodeBase<NodeT> *other) const {
@@ -183,6 +210,11 @@ template<class FuncT, class N>
 void Calculate(DominatorTreeBase<typename GraphTraits<N>::NodeType>& DT,
                FuncT& F);
 
+namespace DomTreeUpdate {
+  /// Kind - Whether an edge was inserted into or deleted from the CFG.
+  enum Kind { Insert, Delete };
+}
+
 template<class NodeT>
 class DominatorTreeBase : public DominatorBase<NodeT> {
 protected:
@@ -545,6 +577,95 @@ public:
       this->Split<NodeT*, GraphTraits<NodeT*> >(*this, NewBB);
   }
 
+  //===--------------------------------------------------------------------===//
+  // Incremental updates.  These keep a forward dominator tree in sync with
+  // edges being added to and removed from the CFG, without recomputing it.
+  // The CFG must already reflect the change when they are called.
+
+  /// Update - The edge From->To was inserted into or deleted from the CFG.
+  struct Update {
+    DomTreeUpdate::Kind Kind;
+    NodeT *From, *To;
+    Update(DomTreeUpdate::Kind K, NodeT *F, NodeT *T)
+      : Kind(K), From(F), To(T) {}
+  };
+
+  /// insertEdge - Update the tree for a new CFG edge From->To.
+  void insertEdge(NodeT *From, NodeT *To) {
+    assert(!this->isPostDominator() &&
+           "Incremental updates need a forward dominator tree");
+    applyInsert(From, To, 0);
+  }
+
+  /// deleteEdge - Update the tree for a CFG edge From->To that was removed.
+  /// If another edge From->To remains, e.g. in a switch, nothing changes.
+  void deleteEdge(NodeT *From, NodeT *To) {
+    assert(!this->isPostDominator() &&
+           "Incremental updates need a forward dominator tree");
+    applyDelete(From, To, 0);
+  }
+
+  /// applyUpdates - Update the tree for a batch of CFG edits that have all
+  /// been made already, in any order.  Updates of the same edge cancel out.
+  /// An Insert must only be reported for an edge that did not exist before.
+  /// Blocks that were erased from the function are listed in Erased, with
+  /// every edge into and out of them reported as deleted.
+  void applyUpdates(ArrayRef<Update> Updates,
+                    ArrayRef<NodeT*> Erased = ArrayRef<NodeT*>()) {
+    assert(!this->isPostDominator() &&
+           "Incremental updates need a forward dominator tree");
+
+    // Reduce the batch to the net change of each edge, in first-seen order.
+    typedef std::pair<NodeT*, NodeT*> Edge;
+    DenseMap<Edge, int> NetChange;
+    SmallVector<Edge, 16> Edges;
+    for (unsigned i = 0, e = Updates.size(); i != e; ++i) {
+      const Update &U = Updates[i];
+      std::pair<typename DenseMap<Edge, int>::iterator, bool> Entry =
+        NetChange.insert(std::make_pair(Edge(U.From, U.To), 0));
+      if (Entry.second)
+        Edges.push_back(Entry.first->first);
+      Entry.first->second += U.Kind == DomTreeUpdate::Insert ? 1 : -1;
+    }
+
+    SmallVector<Update, 16> Legal;
+    for (unsigned i = 0, e = Edges.size(); i != e; ++i) {
+      int Change = NetChange[Edges[i]];
+      if (Change != 0)
+        Legal.push_back(Update(Change > 0 ? DomTreeUpdate::Insert :
+                                            DomTreeUpdate::Delete,
+                               Edges[i].first, Edges[i].second));
+    }
+    if (Legal.empty())
+      return;
+
+    // A batch touching a sizable part of the function is cheaper to handle by
+    // recomputing the tree.
+    if (Legal.size() > 100 && Legal.size() > DomTreeNodes.size() / 40) {
+      recalculate(*getRoot()->getParent());
+      return;
+    }
+
+    // Apply the updates one at a time.  While doing so, CFG walks must see the
+    // edges of the updates still pending the way they were before the batch.
+    PendingUpdates PU;
+    PU.Erased.insert(Erased.begin(), Erased.end());
+    for (unsigned i = 0, e = Legal.size(); i != e; ++i)
+      PU.add(Legal[i]);
+    for (unsigned i = 0, e = Legal.size(); i != e; ++i) {
+      PU.remove(Legal[i]);
+      if (Legal[i].Kind == DomTreeUpdate::Insert)
+        applyInsert(Legal[i].From, Legal[i].To, &PU);
+      else
+        applyDelete(Legal[i].From, Legal[i].To, &PU);
+    }
+
+#ifndef NDEBUG
+    for (unsigned i = 0, e = Erased.size(); i != e; ++i)
+      assert(!getNode(Erased[i]) && "Erased block is still in the tree!");
+#endif
+  }
+
   /// print - Convert to human readable form
   ///
   void print(raw_ostream &o) const {
@@ -649,6 +770,381 @@ protected:
     this->Roots.push_back(BB);
   }
 
+  //===--------------------------------------------------------------------===//
+  // Implementation of the incremental updates.  Insertions follow the
+  // depth-based search of Georgiadis et al., "An Experimental Study of
+  // Dynamic Dominators"; deletions recompute the affected subtree.
+
+  /// PendingUpdates - The edits of a batch that the tree does not reflect yet,
+  /// keyed by both endpoints.
+  struct PendingUpdates {
+    typedef SmallVector<std::pair<NodeT*, DomTreeUpdate::Kind>, 4> EdgeList;
+    typedef DenseMap<NodeT*, EdgeList> EdgeMap;
+    EdgeMap Succs, Preds;
+    SmallPtrSet<NodeT*, 4> Erased;
+
+    void add(const Update &U) {
+      Succs[U.From].push_back(std::make_pair(U.To, U.Kind));
+      Preds[U.To].push_back(std::make_pair(U.From, U.Kind));
+    }
+
+    void remove(const Update &U) {
+      removeFrom(Succs[U.From], std::make_pair(U.To, U.Kind));
+      removeFrom(Preds[U.To], std::make_pair(U.From, U.Kind));
+    }
+
+    static void removeFrom(EdgeList &L,
+                           const std::pair<NodeT*, DomTreeUpdate::Kind> &E) {
+      typename EdgeList::iterator I = std::find(L.begin(), L.end(), E);
+      assert(I != L.end() && "Update is not pending!");
+      L.erase(I);
+    }
+  };
+
+  /// getCFGChildren - Collect the successors of N (predecessors if GraphT is
+  /// an Inverse graph) as the tree sees them: edges inserted by pending
+  /// updates are left out and edges deleted by them are still there.
+  template<class GraphT>
+  static void getCFGChildren(NodeT *N, const PendingUpdates *PU,
+                             const typename PendingUpdates::EdgeMap *Pending,
+                             SmallVectorImpl<NodeT*> &Children) {
+    const typename PendingUpdates::EdgeList *Edges = 0;
+    if (Pending) {
+      typename PendingUpdates::EdgeMap::const_iterator I = Pending->find(N);
+      if (I != Pending->end() && !I->second.empty())
+        Edges = &I->second;
+    }
+
+    if (!PU || !PU->Erased.count(N))
+      for (typename GraphT::ChildIteratorType I = GraphT::child_begin(N),
+           E = GraphT::child_end(N); I != E; ++I) {
+        if (Edges && std::find(Edges->begin(), Edges->end(),
+                               std::make_pair(*I, DomTreeUpdate::Insert)) !=
+                     Edges->end())
+          continue;
+        Children.push_back(*I);
+      }
+
+    if (Edges)
+      for (unsigned i = 0, e = Edges->size(); i != e; ++i)
+        if ((*Edges)[i].second == DomTreeUpdate::Delete)
+          Children.push_back((*Edges)[i].first);
+  }
+
+  static void getSuccessors(NodeT *N, const PendingUpdates *PU,
+                            SmallVectorImpl<NodeT*> &Succs) {
+    getCFGChildren<GraphTraits<NodeT*> >(N, PU, PU ? &PU->Succs : 0, Succs);
+  }
+
+  static void getPredecessors(NodeT *N, const PendingUpdates *PU,
+                              SmallVectorImpl<NodeT*> &Preds) {
+    getCFGChildren<GraphTraits<Inverse<NodeT*> > >(N, PU, PU ? &PU->Preds : 0,
+                                                  Preds);
+  }
+
+  /// getNearestCommonDominatorNode - Like findNearestCommonDominator, but
+  /// on tree nodes, using their levels.
+  static DomTreeNodeBase<NodeT> *
+  getNearestCommonDominatorNode(DomTreeNodeBase<NodeT> *A,
+                                DomTreeNodeBase<NodeT> *B) {
+    while (A != B) {
+      if (A->getLevel() < B->getLevel())
+        std::swap(A, B);
+      A = A->getIDom();
+    }
+    return A;
+  }
+
+  /// RegionInfo - Dominators of a single-entry region of the CFG, computed by
+  /// computeRegionIDoms.  Blocks are numbered in postorder, so the root comes
+  /// last and walking the numbers down visits the region in reverse postorder.
+  struct RegionInfo {
+    SmallVector<NodeT*, 32> PostOrder;
+    SmallVector<unsigned, 32> IDom;
+    DenseMap<NodeT*, unsigned> Number;
+    // Edges from the region to blocks in the tree (unreachable regions only).
+    SmallVector<std::pair<NodeT*, NodeT*>, 4> Exits;
+  };
+
+  struct DFSFrame {
+    NodeT *BB;
+    unsigned Begin, Next, End;
+    DFSFrame(NodeT *B, unsigned Bg, unsigned E)
+      : BB(B), Begin(Bg), Next(Bg), End(E) {}
+  };
+
+  /// computeRegionIDoms - Compute immediate dominators for the blocks Root
+  /// reaches without leaving the region, which is Region if given and the
+  /// blocks not in the tree otherwise.  The region must only be entered
+  /// through Root.  Uses the iterative algorithm of Cooper, Harvey and
+  /// Kennedy, which is quick on the small regions updates touch.
+  void computeRegionIDoms(NodeT *Root, const SmallPtrSet<NodeT*, 32> *Region,
+                          const PendingUpdates *PU, RegionInfo &RI) const {
+    SmallVector<DFSFrame, 32> Stack;
+    SmallVector<NodeT*, 64> Succs;
+    RI.Number[Root] = ~0U;
+    getSuccessors(Root, PU, Succs);
+    Stack.push_back(DFSFrame(Root, 0, Succs.size()));
+    while (!Stack.empty()) {
+      DFSFrame &F = Stack.back();
+      if (F.Next == F.End) {
+        RI.Number[F.BB] = RI.PostOrder.size();
+        RI.PostOrder.push_back(F.BB);
+        Succs.resize(F.Begin);
+        Stack.pop_back();
+        continue;
+      }
+
+      NodeT *BB = F.BB, *Succ = Succs[F.Next++];
+      if (Region ? !Region->count(Succ) : getNode(Succ) != 0) {
+        if (!Region)
+          RI.Exits.push_back(std::make_pair(BB, Succ));
+        continue;
+      }
+      if (!RI.Number.insert(std::make_pair(Succ, ~0U)).second)
+        continue;
+
+      unsigned Begin = Succs.size();
+      getSuccessors(Succ, PU, Succs);
+      Stack.push_back(DFSFrame(Succ, Begin, Succs.size()));
+    }
+
+    // Predecessors inside the region, by number.
+    unsigned N = RI.PostOrder.size();
+    SmallVector<unsigned, 64> PredNums;
+    SmallVector<unsigned, 32> PredBegin;
+    SmallVector<NodeT*, 8> Preds;
+    for (unsigned i = 0; i != N; ++i) {
+      PredBegin.push_back(PredNums.size());
+      Preds.clear();
+      getPredecessors(RI.PostOrder[i], PU, Preds);
+      for (unsigned p = 0, e = Preds.size(); p != e; ++p) {
+        typename DenseMap<NodeT*, unsigned>::const_iterator I =
+          RI.Number.find(Preds[p]);
+        if (I != RI.Number.end())
+          PredNums.push_back(I->second);
+      }
+    }
+    PredBegin.push_back(PredNums.size());
+
+    const unsigned Undef = ~0U;
+    RI.IDom.assign(N, Undef);
+    RI.IDom[N - 1] = N - 1;
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (unsigned i = N - 1; i-- != 0; ) {
+        unsigned NewIDom = Undef;
+        for (unsigned p = PredBegin[i], e = PredBegin[i + 1]; p != e; ++p) {
+          unsigned A = PredNums[p];
+          if (RI.IDom[A] == Undef)
+            continue;
+          if (NewIDom == Undef) {
+            NewIDom = A;
+            continue;
+          }
+          unsigned B = NewIDom;
+          while (A != B) {
+            while (A < B) A = RI.IDom[A];
+            while (B < A) B = RI.IDom[B];
+          }
+          NewIDom = A;
+        }
+        if (NewIDom != RI.IDom[i]) {
+          RI.IDom[i] = NewIDom;
+          Changed = true;
+        }
+      }
+    }
+  }
+
+  void applyInsert(NodeT *From, NodeT *To, const PendingUpdates *PU) {
+    // An edge out of unreachable code changes nothing.
+    DomTreeNodeBase<NodeT> *FromTN = getNode(From);
+    if (!FromTN)
+      return;
+
+    DFSInfoValid = false;
+    if (DomTreeNodeBase<NodeT> *ToTN = getNode(To))
+      insertReachable(FromTN, ToTN, PU);
+    else
+      insertUnreachable(FromTN, To, PU);
+  }
+
+  /// insertReachable - Handle a new edge between two reachable blocks.  The
+  /// blocks whose immediate dominator changes all become children of
+  /// NCD(From, To): they are the blocks deeper than the NCD's children that To
+  /// reaches without passing anything shallower than themselves.
+  void insertReachable(DomTreeNodeBase<NodeT> *FromTN,
+                       DomTreeNodeBase<NodeT> *ToTN, const PendingUpdates *PU) {
+    DomTreeNodeBase<NodeT> *NCD = getNearestCommonDominatorNode(FromTN, ToTN);
+    unsigned NCDLevel = NCD->getLevel();
+
+    // To dominates From, or already is a child of the NCD.
+    if (NCDLevel + 1 >= ToTN->getLevel())
+      return;
+
+    // Visit the candidates deepest first.  Below the current level the search
+    // goes on through blocks that are not affected themselves.
+    SmallVector<DomTreeNodeBase<NodeT>*, 16> Queued, Affected, Deeper;
+    SmallPtrSet<DomTreeNodeBase<NodeT>*, 16> Visited;
+    std::priority_queue<std::pair<unsigned, unsigned> > Bucket;
+    SmallVector<NodeT*, 8> Succs;
+    Visited.insert(ToTN);
+    Bucket.push(std::make_pair(ToTN->getLevel(), 0U));
+    Queued.push_back(ToTN);
+    while (!Bucket.empty()) {
+      DomTreeNodeBase<NodeT> *TN = Queued[Bucket.top().second];
+      Bucket.pop();
+      Affected.push_back(TN);
+
+      unsigned CurrentLevel = TN->getLevel();
+      Deeper.push_back(TN);
+      while (!Deeper.empty()) {
+        DomTreeNodeBase<NodeT> *N = Deeper.pop_back_val();
+        Succs.clear();
+        getSuccessors(N->getBlock(), PU, Succs);
+        for (unsigned i = 0, e = Succs.size(); i != e; ++i) {
+          DomTreeNodeBase<NodeT> *SuccTN = getNode(Succs[i]);
+          if (!SuccTN || SuccTN->getLevel() <= NCDLevel + 1 ||
+              !Visited.insert(SuccTN))
+            continue;
+
+          if (SuccTN->getLevel() > CurrentLevel) {
+            Deeper.push_back(SuccTN);
+          } else {
+            Bucket.push(std::make_pair(SuccTN->getLevel(), Queued.size()));
+            Queued.push_back(SuccTN);
+          }
+        }
+      }
+    }
+
+    for (unsigned i = 0, e = Affected.size(); i != e; ++i)
+      Affected[i]->setIDom(NCD);
+  }
+
+  /// insertUnreachable - Handle a new edge that makes To reachable, along with
+  /// the unreachable blocks it leads to.  Those are only entered through To,
+  /// whose immediate dominator is From, so their tree is computed on its own.
+  /// Their edges back into the reachable part are then inserted one by one.
+  void insertUnreachable(DomTreeNodeBase<NodeT> *FromTN, NodeT *To,
+                         const PendingUpdates *PU) {
+    RegionInfo RI;
+    computeRegionIDoms(To, 0, PU, RI);
+
+    DomTreeNodes[To] = FromTN->addChild(new DomTreeNodeBase<NodeT>(To, FromTN));
+    for (unsigned i = RI.PostOrder.size() - 1; i-- != 0; ) {
+      NodeT *BB = RI.PostOrder[i];
+      DomTreeNodeBase<NodeT> *IDomTN = getNode(RI.PostOrder[RI.IDom[i]]);
+      DomTreeNodes[BB] =
+        IDomTN->addChild(new DomTreeNodeBase<NodeT>(BB, IDomTN));
+    }
+
+    for (unsigned i = 0, e = RI.Exits.size(); i != e; ++i)
+      insertReachable(getNode(RI.Exits[i].first),
+                      getNode(RI.Exits[i].second), PU);
+  }
+
+  void applyDelete(NodeT *From, NodeT *To, const PendingUpdates *PU) {
+    // An edge out of or into unreachable code changes nothing.
+    DomTreeNodeBase<NodeT> *FromTN = getNode(From);
+    DomTreeNodeBase<NodeT> *ToTN = getNode(To);
+    if (!FromTN || !ToTN)
+      return;
+
+    SmallVector<NodeT*, 8> Succs;
+    getSuccessors(From, PU, Succs);
+    if (std::find(Succs.begin(), Succs.end(), To) != Succs.end())
+      return;
+
+    // A deleted back edge to a dominator changes nothing either.
+    DomTreeNodeBase<NodeT> *NCD = getNearestCommonDominatorNode(FromTN, ToTN);
+    if (NCD == ToTN)
+      return;
+
+    DFSInfoValid = false;
+
+    // If To is still reachable, only blocks below the NCD can be affected.
+    if (ToTN->getIDom() != FromTN || hasProperSupport(ToTN, PU)) {
+      rebuildSubtree(NCD, PU);
+      return;
+    }
+
+    // Otherwise To and everything it dominates become unreachable.  Blocks
+    // outside of To's subtree it branched to can get deeper immediate
+    // dominators; their old ones lie on the path from the root to To, so
+    // rebuild from the shallowest of them.
+    SmallVector<DomTreeNodeBase<NodeT>*, 32> Subtree;
+    SmallPtrSet<DomTreeNodeBase<NodeT>*, 32> InSubtree;
+    Subtree.push_back(ToTN);
+    for (unsigned i = 0; i != Subtree.size(); ++i) {
+      InSubtree.insert(Subtree[i]);
+      Subtree.append(Subtree[i]->begin(), Subtree[i]->end());
+    }
+
+    DomTreeNodeBase<NodeT> *Top = FromTN;
+    for (unsigned i = 0, e = Subtree.size(); i != e; ++i) {
+      Succs.clear();
+      getSuccessors(Subtree[i]->getBlock(), PU, Succs);
+      for (unsigned s = 0, se = Succs.size(); s != se; ++s) {
+        DomTreeNodeBase<NodeT> *SuccTN = getNode(Succs[s]);
+        if (!SuccTN || InSubtree.count(SuccTN) || !SuccTN->getIDom())
+          continue;
+        if (SuccTN->getIDom()->getLevel() < Top->getLevel())
+          Top = SuccTN->getIDom();
+      }
+    }
+    rebuildSubtree(Top, PU);
+  }
+
+  /// hasProperSupport - Return true if TN has a reachable predecessor it does
+  /// not dominate, which keeps it reachable.
+  bool hasProperSupport(DomTreeNodeBase<NodeT> *TN,
+                        const PendingUpdates *PU) const {
+    SmallVector<NodeT*, 8> Preds;
+    getPredecessors(TN->getBlock(), PU, Preds);
+    for (unsigned i = 0, e = Preds.size(); i != e; ++i) {
+      DomTreeNodeBase<NodeT> *PredTN = getNode(Preds[i]);
+      if (PredTN && getNearestCommonDominatorNode(PredTN, TN) != TN)
+        return true;
+    }
+    return false;
+  }
+
+  /// rebuildSubtree - Recompute the part of the tree below R after edges were
+  /// deleted.  Deletions only add dominators, so R still dominates whatever of
+  /// its subtree remains reachable and no other block can end up below it.
+  /// Blocks that are no longer reached are dropped from the tree.
+  void rebuildSubtree(DomTreeNodeBase<NodeT> *R, const PendingUpdates *PU) {
+    SmallVector<DomTreeNodeBase<NodeT>*, 32> Nodes;
+    SmallPtrSet<NodeT*, 32> Region;
+    Nodes.push_back(R);
+    for (unsigned i = 0; i != Nodes.size(); ++i) {
+      Region.insert(Nodes[i]->getBlock());
+      Nodes.append(Nodes[i]->begin(), Nodes[i]->end());
+    }
+
+    RegionInfo RI;
+    computeRegionIDoms(R->getBlock(), &Region, PU, RI);
+
+    for (unsigned i = 0, e = Nodes.size(); i != e; ++i)
+      Nodes[i]->Children.clear();
+    for (unsigned i = 1, e = Nodes.size(); i != e; ++i)
+      if (!RI.Number.count(Nodes[i]->getBlock())) {
+        DomTreeNodes.erase(Nodes[i]->getBlock());
+        delete Nodes[i];
+      }
+
+    for (unsigned i = RI.PostOrder.size() - 1; i-- != 0; ) {
+      DomTreeNodeBase<NodeT> *TN = getNode(RI.PostOrder[i]);
+      DomTreeNodeBase<NodeT> *IDomTN = getNode(RI.PostOrder[RI.IDom[i]]);
+      TN->IDom = IDomTN;
+      TN->Level = IDomTN->Level + 1;
+      IDomTN->Children.push_back(TN);
+    }
+  }
+
 public:
   /// recalculate - compute a dominator tree for the given function
   template<class FT>
@@ -814,10 +1310,23 @@ public:
     DT->splitBlock(NewBB);
   }
 
+  typedef DominatorTreeBase<BasicBlock>::Update UpdateType;
+
+  /// insertEdge, deleteEdge, applyUpdates - Update the tree incrementally for
+  /// edges added to or removed from the CFG.  See DominatorTreeBase.
+  void insertEdge(BasicBlock *From, BasicBlock *To);
+  void deleteEdge(BasicBlock *From, BasicBlock *To);
+  void applyUpdates(ArrayRef<UpdateType> Updates,
+                    ArrayRef<BasicBlock*> Erased = ArrayRef<BasicBlock*>());
+
   bool isReachableFromEntry(const BasicBlock* A) {
     return DT->isReachableFromEntry(A);
   }
 
+  /// verifyDomTree - Recompute the tree from scratch and abort with a report
+  /// if it differs from this one.
+  void verifyDomTree() const;
+
 
   virtual void releaseMemory() {
     DT->releaseMemory();
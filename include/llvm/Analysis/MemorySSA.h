@@ -0,0 +1,266 @@
+//===- MemorySSA.h - Build Memory SSA ---------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file exposes an interface to building and querying Memory SSA, an
+// explicit def/use form for the memory state of a function.
+//
+// Every instruction that may write memory gets a MemoryDef, every other
+// instruction that may read memory gets a MemoryUse, and every block where
+// the memory states of its predecessors merge gets a MemoryPhi.  Each use or
+// def points at the access that defines the memory state it sees; the state
+// on entry to the function is represented by a single "live on entry" def.
+// As with scalar SSA, a single memory state is tracked for the whole of
+// memory: a def is not necessarily a clobber of every location, and clients
+// use getClobberingMemoryAccess to skip defs that do not modify the location
+// they are interested in.
+//
+// The form is built once per function, so clients walk direct links between
+// the accesses that matter instead of rescanning blocks for every query the
+// way MemoryDependenceAnalysis does.  Clients that change the function keep it
+// up to date with removeMemoryAccess, createMemoryUse, splitEdge and
+// mergeBlockIntoPredecessor.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_MEMORYSSA_H
+#define LLVM_ANALYSIS_MEMORYSSA_H
+
+#include "llvm/Pass.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include <vector>
+
+namespace llvm {
+  class BasicBlock;
+  class DominatorTree;
+  class Instruction;
+  class MemorySSA;
+  class raw_ostream;
+
+/// MemoryAccess - The common base of MemoryUse, MemoryDef and MemoryPhi.  An
+/// access keeps track of the accesses that use the memory state it defines.
+class MemoryAccess {
+public:
+  enum AccessKind { MemoryUseKind, MemoryDefKind, MemoryPhiKind };
+
+  typedef std::vector<MemoryAccess*>::const_iterator user_iterator;
+
+  AccessKind getKind() const { return Kind; }
+  BasicBlock *getBlock() const { return Block; }
+
+  /// user_begin/user_end - Iterate over the uses, defs and phis that see the
+  /// memory state defined by this access.  MemoryUses never have users.
+  user_iterator user_begin() const { return Users.begin(); }
+  user_iterator user_end() const { return Users.end(); }
+  bool user_empty() const { return Users.empty(); }
+  unsigned getNumUsers() const { return unsigned(Users.size()); }
+
+  void print(raw_ostream &OS) const;
+  void dump() const;
+
+  static inline bool classof(const MemoryAccess *) { return true; }
+
+protected:
+  MemoryAccess(AccessKind K, BasicBlock *BB) : Kind(K), Block(BB), ID(0) {}
+  virtual ~MemoryAccess() {}
+
+private:
+  MemoryAccess(const MemoryAccess &);   // DO NOT IMPLEMENT
+  void operator=(const MemoryAccess &); // DO NOT IMPLEMENT
+
+  void addUser(MemoryAccess *MA) { Users.push_back(MA); }
+  void removeUser(MemoryAccess *MA);
+
+  /// printName - Print the name that users of this access refer to it by.
+  void printName(raw_ostream &OS) const;
+
+  AccessKind Kind;
+  BasicBlock *Block;
+  std::vector<MemoryAccess*> Users;
+
+  /// ID - The number printed for defs and phis, zero for uses.
+  unsigned ID;
+
+  friend class MemorySSA;
+  friend class MemoryUseOrDef;
+  friend class MemoryPhi;
+};
+
+/// MemoryUseOrDef - An access for a single instruction.
+class MemoryUseOrDef : public MemoryAccess {
+public:
+  /// getMemoryInst - Return the instruction this access is for, or null for
+  /// the live on entry def.
+  Instruction *getMemoryInst() const { return MemoryInst; }
+
+  /// getDefiningAccess - Return the access that defines the memory state this
+  /// instruction sees, or null for the live on entry def.
+  MemoryAccess *getDefiningAccess() const { return DefiningAccess; }
+
+  static inline bool classof(const MemoryUseOrDef *) { return true; }
+  static inline bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == MemoryUseKind || MA->getKind() == MemoryDefKind;
+  }
+
+protected:
+  MemoryUseOrDef(AccessKind K, Instruction *I, BasicBlock *BB)
+    : MemoryAccess(K, BB), MemoryInst(I), DefiningAccess(0) {}
+
+private:
+  void setDefiningAccess(MemoryAccess *MA);
+
+  Instruction *MemoryInst;
+  MemoryAccess *DefiningAccess;
+
+  friend class MemorySSA;
+};
+
+/// MemoryUse - An instruction that may read memory but does not write it.
+class MemoryUse : public MemoryUseOrDef {
+public:
+  MemoryUse(Instruction *I, BasicBlock *BB)
+    : MemoryUseOrDef(MemoryUseKind, I, BB) {}
+
+  static inline bool classof(const MemoryUse *) { return true; }
+  static inline bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == MemoryUseKind;
+  }
+};
+
+/// MemoryDef - An instruction that may write memory, or the live on entry
+/// def, which has neither an instruction nor a defining access.
+class MemoryDef : public MemoryUseOrDef {
+public:
+  MemoryDef(Instruction *I, BasicBlock *BB)
+    : MemoryUseOrDef(MemoryDefKind, I, BB) {}
+
+  static inline bool classof(const MemoryDef *) { return true; }
+  static inline bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == MemoryDefKind;
+  }
+};
+
+/// MemoryPhi - The merge of the memory states flowing out of the
+/// predecessors of a block.  There is one incoming value per predecessor
+/// block, no matter how many edges the predecessor has to the block.
+class MemoryPhi : public MemoryAccess {
+public:
+  explicit MemoryPhi(BasicBlock *BB) : MemoryAccess(MemoryPhiKind, BB) {}
+
+  unsigned getNumIncomingValues() const { return unsigned(Incoming.size()); }
+  MemoryAccess *getIncomingValue(unsigned i) const {
+    return Incoming[i].first;
+  }
+  BasicBlock *getIncomingBlock(unsigned i) const {
+    return Incoming[i].second;
+  }
+
+  /// getIncomingValueForBlock - Return the memory state flowing in from Pred,
+  /// or null if Pred is not an incoming block.
+  MemoryAccess *getIncomingValueForBlock(const BasicBlock *Pred) const;
+
+  static inline bool classof(const MemoryPhi *) { return true; }
+  static inline bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == MemoryPhiKind;
+  }
+
+private:
+  void addIncoming(MemoryAccess *MA, BasicBlock *Pred);
+  void setIncomingValue(unsigned i, MemoryAccess *MA);
+
+  SmallVector<std::pair<MemoryAccess*, BasicBlock*>, 4> Incoming;
+
+  friend class MemorySSA;
+};
+
+/// MemorySSA - This pass builds Memory SSA for a function and answers
+/// queries about it.
+class MemorySSA : public FunctionPass {
+  Function *F;
+  AliasAnalysis *AA;
+  DominatorTree *DT;
+
+  /// LiveOnEntry - The memory state on entry to the function.
+  MemoryDef *LiveOnEntry;
+
+  DenseMap<const Instruction*, MemoryUseOrDef*> InstAccesses;
+  DenseMap<const BasicBlock*, MemoryPhi*> PhiAccesses;
+
+  /// NextID - The ID to give the next def or phi that is created.
+  unsigned NextID;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  MemorySSA();
+  ~MemorySSA();
+
+  bool runOnFunction(Function &F);
+  void releaseMemory();
+  void getAnalysisUsage(AnalysisUsage &AU) const;
+  void print(raw_ostream &OS, const Module *M) const;
+  void verifyAnalysis() const;
+
+  /// getMemoryAccess - Return the use or def for the specified instruction, or
+  /// null if it does not access memory.
+  MemoryUseOrDef *getMemoryAccess(const Instruction *I) const {
+    return InstAccesses.lookup(I);
+  }
+
+  /// getMemoryAccess - Return the phi at the start of the specified block, or
+  /// null if there is none.
+  MemoryPhi *getMemoryAccess(const BasicBlock *BB) const {
+    return PhiAccesses.lookup(BB);
+  }
+
+  MemoryDef *getLiveOnEntryDef() const { return LiveOnEntry; }
+  bool isLiveOnEntryDef(const MemoryAccess *MA) const {
+    return MA == LiveOnEntry;
+  }
+
+  /// getClobberingMemoryAccess - Walk up the def chain from Start, inclusive,
+  /// and return the first def that may modify Loc.  The walk stops at phis
+  /// and at the live on entry def, which are returned as is.
+  MemoryAccess *getClobberingMemoryAccess(MemoryAccess *Start,
+                                          const AliasAnalysis::Location &Loc);
+
+  /// getReachingDefAtEnd - Return the memory state at the end of BB.
+  MemoryAccess *getReachingDefAtEnd(BasicBlock *BB) const;
+
+  //===--------------------------------------------------------------------===//
+  // Update interface.
+  //
+
+  /// removeMemoryAccess - Remove the access for the specified instruction, if
+  /// it has one, before the instruction is deleted.  The users of a removed
+  /// def see its defining access instead.
+  void removeMemoryAccess(Instruction *I);
+
+  /// createMemoryUse - Create a use for an instruction that has just been
+  /// inserted and that reads, but does not write, memory.
+  MemoryUse *createMemoryUse(Instruction *I);
+
+  /// splitEdge - An edge from From to To has been split by inserting NewBB
+  /// between them.  The dominator tree must already have been updated.
+  void splitEdge(BasicBlock *From, BasicBlock *To, BasicBlock *NewBB);
+
+  /// mergeBlockIntoPredecessor - BB is about to be spliced onto the end of
+  /// its unique predecessor PredBB, which has no other successors, and erased.
+  void mergeBlockIntoPredecessor(BasicBlock *BB, BasicBlock *PredBB);
+
+private:
+  void placePhis(const SmallVectorImpl<BasicBlock*> &DefBlocks,
+                 DenseMap<BasicBlock*, unsigned> &BBNumbers);
+  void renameBlock(BasicBlock *BB, MemoryAccess *&Incoming);
+  MemoryAccess *getReachingDefAtEntry(BasicBlock *BB) const;
+};
+
+} // End llvm namespace
+
+#endif
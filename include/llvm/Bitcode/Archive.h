@@ -346,9 +346,11 @@ class Archive {
     /// there is purposefully no interface provided by Archive to look up
     /// members by their offset. Use the findModulesDefiningSymbols and
     /// findModuleDefiningSymbol methods instead.
+    /// The symbol table is normally searched in place in the archive file, so
+    /// the first call to this method has to read all of it into memory.
     /// @returns the Archive's symbol table.
     /// @brief Get the archive's symbol table
-    const SymTabType& getSymbolTable() { return symTab; }
+    const SymTabType& getSymbolTable();
 
     /// This method returns the offset in the archive file to the first "real"
     /// file member. Archive files, on disk, have a signature and might have a
@@ -458,6 +460,17 @@ class Archive {
     /// @brief Parse the symbol table at \p data.
     bool parseSymbolTable(const void* data,unsigned len,std::string* error);
 
+    /// @returns true if the archive has a non-empty symbol table, in either
+    /// form.
+    /// @brief Determine whether a symbol table has been loaded.
+    bool hasSymbolTable() const { return symIndex != 0 || !symTab.empty(); }
+
+    /// Look up \p symbol in the symbol index if there is one, or else in
+    /// symTab.
+    /// @returns true and sets \p offset if the symbol is found.
+    /// @brief Find the offset of the member that defines a symbol.
+    bool findSymbolOffset(StringRef symbol, unsigned& offset);
+
     /// @returns A fully populated ArchiveMember or 0 if an error occurred.
     /// @brief Parse the header of a member starting at \p At
     ArchiveMember* parseMemberHeader(
@@ -525,6 +538,7 @@ class Archive {
     MemoryBuffer *mapfile;    ///< Raw Archive contents mapped into memory
     const char* base;         ///< Base of the memory mapped file data
     SymTabType symTab;        ///< The symbol table
+    const char* symIndex;     ///< The mapped symbol index, if there is one
     std::string strtab;       ///< The string table for long file names
     unsigned symTabSize;      ///< Size in bytes of symbol table
     unsigned firstFileOffset; ///< Offset to first normal file.
@@ -251,6 +251,79 @@ public:
     BlockScope.pop_back();
   }
 
+  /// cloneBlockInfo - Give this writer its own copy of the abbreviations that
+  /// were registered through BLOCKINFO_BLOCK records in \arg Other, without
+  /// emitting anything.  Blocks encoded by this writer can then be spliced
+  /// into Other's stream with EmitEncodedSubblock.  The abbreviations are
+  /// copied rather than shared so that the two writers may be used from
+  /// different threads.
+  void cloneBlockInfo(const BitstreamWriter &Other) {
+    assert(BlockInfoRecords.empty() && "Writer already has blockinfo!");
+    BlockInfoRecords.resize(Other.BlockInfoRecords.size());
+    for (unsigned i = 0, e = static_cast<unsigned>(BlockInfoRecords.size());
+         i != e; ++i) {
+      const BlockInfo &From = Other.BlockInfoRecords[i];
+      BlockInfo &To = BlockInfoRecords[i];
+      To.BlockID = From.BlockID;
+      for (unsigned j = 0, je = static_cast<unsigned>(From.Abbrevs.size());
+           j != je; ++j) {
+        BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+        for (unsigned k = 0, ke = From.Abbrevs[j]->getNumOperandInfos();
+             k != ke; ++k)
+          Abbv->Add(From.Abbrevs[j]->getOperandInfo(k));
+        To.Abbrevs.push_back(Abbv);
+      }
+    }
+  }
+
+  /// EmitEncodedSubblock - Append a block that was encoded by a separate
+  /// writer.  \arg Block must hold exactly one complete block, written with
+  /// EnterSubblock/ExitBlock into an otherwise empty stream.  The result is
+  /// bit-for-bit what encoding the block directly into this stream would have
+  /// produced, since block contents are word aligned and do not depend on the
+  /// enclosing block.
+  void EmitEncodedSubblock(const std::vector<unsigned char> &Block) {
+    assert(Block.size() >= 8 && (Block.size() & 3) == 0 && "Invalid block!");
+
+    // A fresh writer uses 2-bit codes, so the header is
+    //    [ENTER_SUBBLOCK:2, blockid:vbr8, newcodelen:vbr4, <align4bytes>]
+    // followed by the block size word.  Decode it from the first word.
+    uint32_t Header = Block[0] | (Block[1] << 8) | (Block[2] << 16) |
+                      ((uint32_t)Block[3] << 24);
+    assert((Header & 3) == bitc::ENTER_SUBBLOCK && "Not a block!");
+    Header >>= 2;
+    unsigned BlockID = DecodeHeaderVBR(Header, bitc::BlockIDWidth);
+    unsigned CodeLen = DecodeHeaderVBR(Header, bitc::CodeLenWidth);
+
+    unsigned SizeInWords = Block[4] | (Block[5] << 8) | (Block[6] << 16) |
+                           ((unsigned)Block[7] << 24);
+    assert(Block.size() == 8 + SizeInWords*4 && "Block size mismatch!");
+
+    // Re-emit the header for this stream's code size, then the contents.
+    EmitCode(bitc::ENTER_SUBBLOCK);
+    EmitVBR(BlockID, bitc::BlockIDWidth);
+    EmitVBR(CodeLen, bitc::CodeLenWidth);
+    FlushToWord();
+    Emit(SizeInWords, bitc::BlockSizeWidth);
+    Out.insert(Out.end(), Block.begin() + 8, Block.end());
+  }
+
+private:
+  /// DecodeHeaderVBR - Pull a VBR value of the given width off the low bits of
+  /// Bits, for EmitEncodedSubblock.
+  static unsigned DecodeHeaderVBR(uint32_t &Bits, unsigned NumBits) {
+    uint32_t HiMask = 1U << (NumBits-1);
+    unsigned Result = 0, Shift = 0;
+    while (1) {
+      uint32_t Piece = Bits & ((1U << NumBits)-1);
+      Bits >>= NumBits;
+      Result |= (Piece & (HiMask-1)) << Shift;
+      if ((Piece & HiMask) == 0)
+        return Result;
+      Shift += NumBits-1;
+    }
+  }
+
   //===--------------------------------------------------------------------===//
   // Record Emission
   //===--------------------------------------------------------------------===//
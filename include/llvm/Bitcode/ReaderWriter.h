@@ -25,10 +25,16 @@ namespace llvm {
   class raw_ostream;
   
   /// getLazyBitcodeModule - Read the header of the specified bitcode buffer
-  /// and prepare for lazy deserialization of function bodies.  If successful,
-  /// this takes ownership of 'buffer' and returns a non-null pointer.  On
-  /// error, this returns null, *does not* take ownership of Buffer, and fills
-  /// in *ErrMsg with an error description if ErrMsg is non-null.
+  /// and prepare for lazy deserialization of function bodies and module-level
+  /// metadata.  If successful, this takes ownership of 'buffer' and returns a
+  /// non-null pointer.  On error, this returns null, *does not* take
+  /// ownership of Buffer, and fills in *ErrMsg with an error description if
+  /// ErrMsg is non-null.
+  ///
+  /// Named metadata such as !llvm.dbg.cu is not in the module until a
+  /// function body is materialized or Module::MaterializeMetadata or
+  /// Module::MaterializeAll is called.  Clients that look at it before then
+  /// must call Module::MaterializeMetadata first.
   Module *getLazyBitcodeModule(MemoryBuffer *Buffer,
                                LLVMContext& Context,
                                std::string *ErrMsg = 0);
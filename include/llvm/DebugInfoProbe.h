@@ -60,6 +60,9 @@ namespace llvm {
     /// finalize - Collect information after running an optimization pass. This
     /// must be used after initialization.
     void finalize(Pass *P, Function &F);
+
+    /// isEnabled - Return true if -enable-debug-info-probe is specified.
+    bool isEnabled() const;
   };
 
 } // End llvm namespace
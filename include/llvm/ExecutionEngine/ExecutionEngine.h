@@ -105,6 +105,10 @@ class ExecutionEngine {
   /// Whether lazy JIT compilation is enabled.
   bool CompilingLazily;
 
+  /// Whether the JIT compiles lazily-called functions ahead of their first
+  /// call on a background thread.
+  bool CompilingSpeculatively;
+
   /// Whether JIT compilation of external global variables is allowed.
   bool GVCompilationDisabled;
 
@@ -369,6 +373,20 @@ public:
     return !CompilingLazily;
   }
 
+  /// EnableSpeculativeCompilation - When lazy compilation is on, the first call
+  /// to each function stops in the compiler.  If speculative compilation is
+  /// also enabled, the JIT compiles the functions reachable from the code it
+  /// has emitted on a background thread, so that most lazy stubs find their
+  /// function already compiled when they're first called.  The background
+  /// thread holds the JIT's lock while it compiles, so the requirements given
+  /// for DisableLazyCompilation apply to it as well.
+  void EnableSpeculativeCompilation(bool Enabled = true) {
+    CompilingSpeculatively = Enabled;
+  }
+  bool isCompilingSpeculatively() const {
+    return CompilingSpeculatively;
+  }
+
   /// DisableGVCompilation - If called, the JIT will abort if it's asked to
   /// allocate space and populate a GlobalVariable that is not internal to
   /// the module.
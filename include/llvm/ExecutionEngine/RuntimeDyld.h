@@ -44,6 +44,12 @@ public:
   // memory was actually used.
   virtual void endFunctionBody(const char *Name, uint8_t *FunctionStart,
                                uint8_t *FunctionEnd) = 0;
+
+  // Allocate Size bytes, aligned to Alignment, for a whole section of a
+  // loaded object (or for linker generated GOT entries and stubs). Unlike
+  // function bodies, these blocks are not associated with any single symbol.
+  // The memory must be writable and executable.
+  virtual uint8_t *allocateSection(uintptr_t Size, unsigned Alignment) = 0;
 };
 
 class RuntimeDyld {
@@ -63,10 +69,13 @@ public:
   // and resolve relocatons based on where they put it).
   void *getSymbolAddress(StringRef Name);
   // Resolve the relocations for all symbols we currently know about.
-  void resolveRelocations();
+  // Returns true, with the reason in getErrorString(), if a relocation
+  // cannot be applied.
+  bool resolveRelocations();
   // Change the address associated with a symbol when resolving relocations.
   // Any relocations already associated with the symbol will be re-resolved.
-  void reassignSymbolAddress(StringRef Name, uint8_t *Addr);
+  // Returns true on error, like resolveRelocations.
+  bool reassignSymbolAddress(StringRef Name, uint8_t *Addr);
   StringRef getErrorString();
 };
 
@@ -54,6 +54,13 @@ public:
   ///
   virtual void Dematerialize(GlobalValue *) {}
 
+  /// MaterializeMetadata - make sure any module-level metadata that this
+  /// GVMaterializer deferred has been read.  On error, this returns true and
+  /// fills in the optional string with information about the problem.  If
+  /// successful, this returns false.
+  ///
+  virtual bool MaterializeMetadata(std::string *ErrInfo = 0) { return false; }
+
   /// MaterializeModule - make sure the entire Module has been completely read.
   /// On error, this returns true and fills in the optional string with
   /// information about the problem.  If successful, this returns false.
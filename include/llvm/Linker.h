@@ -16,6 +16,7 @@
 
 #include <memory>
 #include <vector>
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 
 namespace llvm {
@@ -261,6 +262,24 @@ class Linker {
     /// @brief Generically link two modules together.
     static bool LinkModules(Module* Dest, Module* Src, std::string* ErrorMsg);
 
+    /// This links each of the \p Srcs modules into \p Dest, with the same
+    /// result as calling LinkModules on each of them in turn. The named types
+    /// of all of the inputs are resolved first, and symbols are resolved
+    /// across all of the inputs before their function bodies are linked, so a
+    /// weak or linkonce body that another input overrides is never moved over.
+    /// The inputs may be read lazily (see getLazyBitcodeModule), in which case
+    /// the bodies that aren't linked in are never read at all. Appending
+    /// variables are merged and aliases resolved once, after all of the inputs
+    /// are linked, rather than once per input. As with LinkModules, the
+    /// \p Srcs modules are not usable afterwards, but the caller still owns
+    /// them. If linking one of the inputs fails and \p FailedSrc is not null,
+    /// it is set to that input's index in \p Srcs; errors found once all of
+    /// the inputs are in set it to Srcs.size().
+    /// @returns True if an error occurs, false otherwise.
+    /// @brief Link a list of modules into one.
+    static bool LinkModules(Module* Dest, ArrayRef<Module*> Srcs,
+                            std::string* ErrorMsg, unsigned *FailedSrc = 0);
+
     /// This function looks through the Linker's LibPaths to find a library with
     /// the name \p Filename. If the library cannot be found, the returned path
     /// will be empty (i.e. sys::Path::isEmpty() will return true).
@@ -15,6 +15,7 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/Support/Allocator.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/raw_ostream.h"
 #include <vector> // FIXME: Shouldn't be needed.
 
@@ -36,6 +37,11 @@ namespace llvm {
   /// MCContext - Context object for machine code objects.  This class owns all
   /// of the sections that it creates.
   ///
+  /// Symbol creation, section uniquing and allocation in a context marked
+  /// with setShared are serialized through ContextLock, so that several
+  /// threads can share one context.  The dwarf and directional label state is
+  /// only touched by the assembler parser and is not protected.
+  ///
   class MCContext {
     MCContext(const MCContext&); // DO NOT IMPLEMENT
     MCContext &operator=(const MCContext&); // DO NOT IMPLEMENT
@@ -51,6 +57,30 @@ namespace llvm {
     /// objects.
     BumpPtrAllocator Allocator;
 
+    /// ContextLock - Guards Allocator, the symbol tables and the section
+    /// uniquing maps of a shared context.
+    mutable sys::Mutex ContextLock;
+
+    /// Shared - Whether several threads may use this context at once.  Only
+    /// then is ContextLock taken.
+    bool Shared;
+
+    /// ContextGuard - Holds ContextLock for its lifetime if the context is
+    /// shared.
+    class ContextGuard {
+      const MCContext &Ctx;
+    public:
+      explicit ContextGuard(const MCContext &C) : Ctx(C) {
+        if (Ctx.Shared)
+          Ctx.ContextLock.acquire();
+      }
+      ~ContextGuard() {
+        if (Ctx.Shared)
+          Ctx.ContextLock.release();
+      }
+    };
+    friend class ContextGuard;
+
     /// Symbols - Bindings of names to symbols.
     StringMap<MCSymbol*, BumpPtrAllocator&> Symbols;
 
@@ -116,6 +146,14 @@ namespace llvm {
 
     void setAllowTemporaryLabels(bool Value) { AllowTemporaryLabels = Value; }
 
+    /// setShared - Let several threads create symbols and sections in this
+    /// context at once.  This must be set before a second thread uses the
+    /// context.  Nothing in LLVM shares a context between threads yet; this
+    /// is groundwork for running code generation on several functions at
+    /// once.
+    void setShared(bool Value) { Shared = Value; }
+    bool isShared() const { return Shared; }
+
     /// @name Symbol Management
     /// @{
 
@@ -245,6 +283,7 @@ namespace llvm {
     }
 
     void *Allocate(unsigned Size, unsigned Align = 8) {
+      ContextGuard Guard(*this);
       return Allocator.Allocate(Size, Align);
     }
     void Deallocate(void *Ptr) {
@@ -77,6 +77,17 @@ private:
   mutable ilist_node<NamedMDNode> Sentinel;
 };
 
+/// ModuleAccessHook - Clients that change a Module from several threads at
+/// once install one of these to put the changes to the module itself in
+/// order.  willAccessModule is called before the lists of globals, functions
+/// and aliases, the symbol tables or the named metadata of the module are
+/// looked at or changed through the non-const accessors.
+class ModuleAccessHook {
+public:
+  virtual ~ModuleAccessHook();
+  virtual void willAccessModule() = 0;
+};
+
 /// A Module instance is used to store all the information related to an
 /// LLVM module. Modules are the top level container of all other LLVM
 /// Intermediate Representation (IR) objects. Each module directly contains a
@@ -151,9 +162,14 @@ private:
   std::string TargetTriple;       ///< Platform target triple Module compiled on
   std::string DataLayout;         ///< Target data description
   void *NamedMDSymTab;            ///< NamedMDNode names.
+  ModuleAccessHook *AccessHook;   ///< Told about accesses to the lists above.
 
   friend class Constant;
 
+  void noteAccess() const {
+    if (AccessHook) AccessHook->willAccessModule();
+  }
+
 /// @}
 /// @name Constructors
 /// @{
@@ -387,6 +403,14 @@ public:
   /// materialized lazily.  If !isDematerializable(), this method is a noop.
   void Dematerialize(GlobalValue *GV);
 
+  /// MaterializeMetadata - Make sure the module-level metadata is fully read.
+  /// It is read automatically along with the first materialized function or
+  /// by MaterializeAll; clients that inspect named metadata without
+  /// materializing any function need to call this.  If the module is corrupt,
+  /// this returns true and fills in the optional string with information
+  /// about the problem.  If successful, this returns false.
+  bool MaterializeMetadata(std::string *ErrInfo = 0);
+
   /// MaterializeAll - Make sure all GlobalValues in this Module are fully read.
   /// If the module is corrupt, this returns true and fills in the optional
   /// string with information about the problem.  If successful, this returns
@@ -400,6 +424,17 @@ public:
   /// returns false.
   bool MaterializeAllPermanently(std::string *ErrInfo = 0);
 
+/// @}
+/// @name Access Hook
+/// @{
+
+  /// setAccessHook - Install H to be told about accesses to the lists and
+  /// symbol tables of this module, or remove the hook if H is null.  The
+  /// module does not take ownership of H.
+  void setAccessHook(ModuleAccessHook *H) { AccessHook = H; }
+  /// getAccessHook - Return the installed access hook, if any.
+  ModuleAccessHook *getAccessHook() const { return AccessHook; }
+
 /// @}
 /// @name Direct access to the globals list, functions list, and symbol table
 /// @{
@@ -407,43 +442,64 @@ public:
   /// Get the Module's list of global variables (constant).
   const GlobalListType   &getGlobalList() const       { return GlobalList; }
   /// Get the Module's list of global variables.
-  GlobalListType         &getGlobalList()             { return GlobalList; }
+  GlobalListType         &getGlobalList() {
+    noteAccess();
+    return GlobalList;
+  }
   static iplist<GlobalVariable> Module::*getSublistAccess(GlobalVariable*) {
     return &Module::GlobalList;
   }
   /// Get the Module's list of functions (constant).
   const FunctionListType &getFunctionList() const     { return FunctionList; }
   /// Get the Module's list of functions.
-  FunctionListType       &getFunctionList()           { return FunctionList; }
+  FunctionListType       &getFunctionList() {
+    noteAccess();
+    return FunctionList;
+  }
   static iplist<Function> Module::*getSublistAccess(Function*) {
     return &Module::FunctionList;
   }
   /// Get the Module's list of aliases (constant).
   const AliasListType    &getAliasList() const        { return AliasList; }
   /// Get the Module's list of aliases.
-  AliasListType          &getAliasList()              { return AliasList; }
+  AliasListType          &getAliasList() {
+    noteAccess();
+    return AliasList;
+  }
   static iplist<GlobalAlias> Module::*getSublistAccess(GlobalAlias*) {
     return &Module::AliasList;
   }
   /// Get the symbol table of global variable and function identifiers
   const ValueSymbolTable &getValueSymbolTable() const { return *ValSymTab; }
   /// Get the Module's symbol table of global variable and function identifiers.
-  ValueSymbolTable       &getValueSymbolTable()       { return *ValSymTab; }
+  ValueSymbolTable       &getValueSymbolTable() {
+    noteAccess();
+    return *ValSymTab;
+  }
   /// Get the symbol table of types
   const TypeSymbolTable  &getTypeSymbolTable() const  { return *TypeSymTab; }
   /// Get the Module's symbol table of types
-  TypeSymbolTable        &getTypeSymbolTable()        { return *TypeSymTab; }
+  TypeSymbolTable        &getTypeSymbolTable() {
+    noteAccess();
+    return *TypeSymTab;
+  }
 
 /// @}
 /// @name Global Variable Iteration
 /// @{
 
   /// Get an iterator to the first global variable
-  global_iterator       global_begin()       { return GlobalList.begin(); }
+  global_iterator       global_begin() {
+    noteAccess();
+    return GlobalList.begin();
+  }
   /// Get a constant iterator to the first global variable
   const_global_iterator global_begin() const { return GlobalList.begin(); }
   /// Get an iterator to the last global variable
-  global_iterator       global_end  ()       { return GlobalList.end(); }
+  global_iterator       global_end  () {
+    noteAccess();
+    return GlobalList.end();
+  }
   /// Get a constant iterator to the last global variable
   const_global_iterator global_end  () const { return GlobalList.end(); }
   /// Determine if the list of globals is empty.
@@ -454,11 +510,17 @@ public:
 /// @{
 
   /// Get an iterator to the first function.
-  iterator                begin()       { return FunctionList.begin(); }
+  iterator                begin() {
+    noteAccess();
+    return FunctionList.begin();
+  }
   /// Get a constant iterator to the first function.
   const_iterator          begin() const { return FunctionList.begin(); }
   /// Get an iterator to the last function.
-  iterator                end  ()       { return FunctionList.end();   }
+  iterator                end  () {
+    noteAccess();
+    return FunctionList.end();
+  }
   /// Get a constant iterator to the last function.
   const_iterator          end  () const { return FunctionList.end();   }
   /// Determine how many functions are in the Module's list of functions.
@@ -488,11 +550,17 @@ public:
 /// @{
 
   /// Get an iterator to the first alias.
-  alias_iterator       alias_begin()            { return AliasList.begin(); }
+  alias_iterator       alias_begin() {
+    noteAccess();
+    return AliasList.begin();
+  }
   /// Get a constant iterator to the first alias.
   const_alias_iterator alias_begin() const      { return AliasList.begin(); }
   /// Get an iterator to the last alias.
-  alias_iterator       alias_end  ()            { return AliasList.end();   }
+  alias_iterator       alias_end  () {
+    noteAccess();
+    return AliasList.end();
+  }
   /// Get a constant iterator to the last alias.
   const_alias_iterator alias_end  () const      { return AliasList.end();   }
   /// Determine how many aliases are in the Module's list of aliases.
@@ -506,14 +574,20 @@ public:
 /// @{
 
   /// Get an iterator to the first named metadata.
-  named_metadata_iterator named_metadata_begin() { return NamedMDList.begin(); }
+  named_metadata_iterator named_metadata_begin() {
+    noteAccess();
+    return NamedMDList.begin();
+  }
   /// Get a constant iterator to the first named metadata.
   const_named_metadata_iterator named_metadata_begin() const {
     return NamedMDList.begin();
   }
 
   /// Get an iterator to the last named metadata.
-  named_metadata_iterator named_metadata_end() { return NamedMDList.end(); }
+  named_metadata_iterator named_metadata_end() {
+    noteAccess();
+    return NamedMDList.end();
+  }
   /// Get a constant iterator to the last named metadata.
   const_named_metadata_iterator named_metadata_end() const {
     return NamedMDList.end();
@@ -118,6 +118,13 @@ public:
   virtual Pass *createPrinterPass(raw_ostream &O,
                                   const std::string &Banner) const = 0;
 
+  /// createClone - Return a new pass, not yet added to any pass manager, that
+  /// is configured the same way as this one, or null if this pass cannot be
+  /// copied.  Pass managers use this to run a pipeline on several threads at
+  /// once.  By default this calls the default constructor registered for the
+  /// pass, so passes that take constructor arguments must override it.
+  virtual Pass *createClone() const;
+
   /// Each pass is responsible for assigning a pass manager to itself.
   /// PMS is the stack of available pass manager. 
   virtual void assignPassManager(PMStack &, 
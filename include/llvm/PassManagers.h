@@ -97,6 +97,8 @@ namespace llvm {
   class Value;
   class Timer;
   class PMDataManager;
+  class PassManager;
+  class FunctionSchedule;
 
 // enums for debugging strings
 enum PassDebuggingString {
@@ -346,12 +348,27 @@ public:
     return (unsigned)PassVector.size();
   }
 
+  /// getContainedPass - Return the N'th pass managed by this manager.
+  /// Managers that hold a single kind of pass hide this with a version that
+  /// returns that kind.
+  Pass *getContainedPass(unsigned N) {
+    assert(N < PassVector.size() && "Pass number out of range!");
+    return PassVector[N];
+  }
+
+  /// collectPasses - Append the passes run by this manager, and by the
+  /// managers nested in it, to Passes in the order they run.  Shape gets the
+  /// IDs of the passes and the nested managers, so that a copy of this
+  /// manager can be checked to have the same structure.
+  void collectPasses(std::vector<Pass*> &Passes,
+                     std::vector<AnalysisID> &Shape);
+
   virtual PassManagerType getPassManagerType() const { 
     assert ( 0 && "Invalid use of getPassManagerType");
     return PMT_Unknown; 
   }
 
-  std::map<AnalysisID, Pass*> *getAvailableAnalysis() {
+  DenseMap<AnalysisID, Pass*> *getAvailableAnalysis() {
     return &AvailableAnalysis;
   }
 
@@ -374,12 +391,17 @@ protected:
   // Collection of Analysis provided by Parent pass manager and
   // used by current pass manager. At at time there can not be more
   // then PMT_Last active pass mangers.
-  std::map<AnalysisID, Pass *> *InheritedAnalysis[PMT_Last];
+  DenseMap<AnalysisID, Pass*> *InheritedAnalysis[PMT_Last];
 
   
   /// isPassDebuggingExecutionsOrMore - Return true if -debug-pass=Executions
   /// or higher is specified.
   bool isPassDebuggingExecutionsOrMore() const;
+
+  /// isPassInstrumentationEnabled - Return true if -debug-pass or
+  /// -time-passes is specified.  Both keep global state that must not be
+  /// updated from several threads at once.
+  bool isPassInstrumentationEnabled() const;
   
 private:
   void dumpAnalysisUsage(StringRef Msg, const Pass *P,
@@ -389,7 +411,7 @@ private:
   // pass. If a pass requires an analysis which is not available then 
   // the required analysis pass is scheduled to run before the pass itself is
   // scheduled to run.
-  std::map<AnalysisID, Pass*> AvailableAnalysis;
+  DenseMap<AnalysisID, Pass*> AvailableAnalysis;
 
   // Collection of higher level analysis used by the pass managed by
   // this manager.
@@ -409,7 +431,7 @@ class FPPassManager : public ModulePass, public PMDataManager {
 public:
   static char ID;
   explicit FPPassManager(int Depth) 
-  : ModulePass(ID), PMDataManager(Depth) { }
+  : ModulePass(ID), PMDataManager(Depth), Schedule(0) { }
   
   /// run - Execute all of the passes scheduled for execution.  Keep track of
   /// whether any of the passes modifies the module, and if so, return true.
@@ -451,6 +473,23 @@ public:
   virtual PassManagerType getPassManagerType() const { 
     return PMT_FunctionPassManager; 
   }
+
+  /// runInOrder - Run the passes on every function in Sched in module order,
+  /// skipping the ones that a helper thread takes first.
+  bool runInOrder(FunctionSchedule &Sched);
+
+  /// runReadyFunctions - Run the passes on functions in Sched as they become
+  /// ready, until all of them are done.
+  bool runReadyFunctions(FunctionSchedule &Sched);
+
+private:
+  /// Schedule - Set on the copies of this pass manager that run on helper
+  /// threads.  See runInParallel.
+  FunctionSchedule *Schedule;
+
+  bool runInParallel(Module &M, bool &Changed);
+  PassManager *createHelper(const std::vector<AnalysisID> &Shape,
+                            FPPassManager *&Copy);
 };
 
 Timer *getPassTimer(Pass *);
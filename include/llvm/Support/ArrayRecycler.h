@@ -0,0 +1,126 @@
+//==- llvm/Support/ArrayRecycler.h - Recycling of Arrays ---------*- C++ -*-==//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the ArrayRecycler class template which can recycle small
+// arrays allocated from one of the allocators in Allocator.h
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_ARRAYRECYCLER_H
+#define LLVM_SUPPORT_ARRAYRECYCLER_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/AlignOf.h"
+#include "llvm/Support/MathExtras.h"
+#include <cassert>
+
+namespace llvm {
+
+/// ArrayRecycler - Recycle arrays of T whose capacity is a power of two.
+///
+/// Arrays are allocated from an allocator such as BumpPtrAllocator, and the
+/// ones given back are kept on a free list for their size class, to be handed
+/// out again by the next allocation of that capacity. Like Recycler, it keeps
+/// no record of the arrays that are in use, which the allocator releases
+/// along with everything else.
+///
+/// Arrays are not constructed or destroyed; it is the caller's job to
+/// construct the elements it uses and destroy them before deallocating.
+template<class T, size_t Align = AlignOf<T>::Alignment>
+class ArrayRecycler {
+  /// FreeList - Free arrays are linked through their first element.
+  struct FreeList {
+    FreeList *Next;
+  };
+
+  /// Bucket - The free lists, indexed by the log2 of the array capacity.
+  SmallVector<FreeList*, 8> Bucket;
+
+  /// pop - Remove an entry from the free list in Bucket[Idx] and return it,
+  /// or null if the list is empty.
+  T *pop(unsigned Idx) {
+    if (Idx >= Bucket.size())
+      return 0;
+    FreeList *Entry = Bucket[Idx];
+    if (!Entry)
+      return 0;
+    Bucket[Idx] = Entry->Next;
+    return reinterpret_cast<T*>(Entry);
+  }
+
+  /// push - Add an entry to the free list at Bucket[Idx].
+  void push(unsigned Idx, T *Ptr) {
+    assert(Ptr && "Cannot recycle NULL pointer");
+    FreeList *Entry = reinterpret_cast<FreeList*>(Ptr);
+    if (Idx >= Bucket.size())
+      Bucket.resize(size_t(Idx) + 1);
+    Entry->Next = Bucket[Idx];
+    Bucket[Idx] = Entry;
+  }
+
+public:
+  /// Capacity - The size class of an array. Arrays are allocated with a
+  /// power-of-two number of elements, so that a capacity fits in a byte.
+  class Capacity {
+    uint8_t Index;
+    explicit Capacity(uint8_t idx) : Index(idx) {}
+
+  public:
+    Capacity() : Index(0) {}
+
+    /// get - Return the smallest capacity that can hold N elements.
+    static Capacity get(size_t N) {
+      return Capacity(N ? Log2_64_Ceil(N) : 0);
+    }
+
+    /// getBucket - The index of this capacity's free list.
+    unsigned getBucket() const { return Index; }
+
+    /// getSize - The number of elements an array of this capacity holds.
+    size_t getSize() const { return size_t(1u) << Index; }
+
+    /// getNext - The capacity twice as large as this one.
+    Capacity getNext() const { return Capacity(Index + 1); }
+  };
+
+  ~ArrayRecycler() {
+    // The free lists point into memory owned by the allocator, so just
+    // forgetting them is fine, but it has to be done with clear() to make it
+    // clear that this is intended.
+    assert(Bucket.empty() && "Non-empty ArrayRecycler deleted!");
+  }
+
+  /// clear - Forget all the free arrays. The memory stays with the
+  /// allocator, which must be reset or destroyed to reclaim it.
+  template<class AllocatorType>
+  void clear(AllocatorType &Allocator) {
+    Bucket.clear();
+  }
+
+  /// allocate - Return an uninitialized array of capacity Cap, recycling a
+  /// free one if there is one.
+  template<class AllocatorType>
+  T *allocate(Capacity Cap, AllocatorType &Allocator) {
+    // Try to recycle an existing array.
+    if (T *Ptr = pop(Cap.getBucket()))
+      return Ptr;
+    // Nope, get more memory.
+    return static_cast<T*>(Allocator.Allocate(sizeof(T)*Cap.getSize(), Align));
+  }
+
+  /// deallocate - Put an array of capacity Cap back on the free list. Its
+  /// elements must already have been destroyed.
+  void deallocate(Capacity Cap, T *Ptr) {
+    push(Cap.getBucket(), Ptr);
+  }
+};
+
+} // end llvm namespace
+
+#endif
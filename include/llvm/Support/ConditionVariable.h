@@ -0,0 +1,73 @@
+//===- llvm/Support/ConditionVariable.h - Condition Variable ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the llvm::sys::ConditionVariable class.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SYSTEM_CONDITIONVARIABLE_H
+#define LLVM_SYSTEM_CONDITIONVARIABLE_H
+
+#include "llvm/Support/Mutex.h"
+
+namespace llvm
+{
+  namespace sys
+  {
+    /// @brief Platform agnostic condition variable class.
+    class ConditionVariable
+    {
+    /// @name Constructors
+    /// @{
+    public:
+
+      /// @brief Default Constructor.
+      ConditionVariable();
+
+      /// @brief Destructor
+      ~ConditionVariable();
+
+    /// @}
+    /// @name Methods
+    /// @{
+    public:
+
+      /// Atomically releases \p Lock, which the calling thread must hold, and
+      /// blocks until another thread calls notifyAll.  The lock is acquired
+      /// again before this method returns.  Waiting threads may also wake up
+      /// spuriously, so callers must wait in a loop that rechecks the
+      /// condition they are waiting for.
+      /// @returns false if any kind of error occurs, true otherwise.
+      /// @brief Wait for a notification.
+      bool wait(MutexImpl &Lock);
+
+      /// Wakes up all of the threads that are waiting on this condition
+      /// variable.
+      /// @returns false if any kind of error occurs, true otherwise.
+      /// @brief Wake up all waiting threads.
+      bool notifyAll();
+
+    /// @}
+    /// @name Platform Dependent Data
+    /// @{
+    private:
+      void* data_; ///< We don't know what the data will be
+
+    /// @}
+    /// @name Do Not Implement
+    /// @{
+    private:
+      ConditionVariable(const ConditionVariable &original);
+      void operator=(const ConditionVariable &);
+    /// @}
+    };
+  }
+}
+
+#endif
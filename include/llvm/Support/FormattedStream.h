@@ -60,9 +60,10 @@ namespace llvm
     /// current_pos - Return the current position within the stream,
     /// not counting the bytes currently in the buffer.
     virtual uint64_t current_pos() const { 
-      // This has the same effect as calling TheStream.current_pos(),
-      // but that interface is private.
-      return TheStream->tell() - TheStream->GetNumBytesInBuffer();
+      // Everything handed to TheStream has been written as far as we are
+      // concerned, even if TheStream is still holding it in its own buffer,
+      // as a raw_svector_ostream does.
+      return TheStream->tell();
     }
 
     /// ComputeColumn - Examine the given output buffer and figure out which
@@ -71,6 +71,8 @@ namespace llvm
     private:
       void* data_; ///< We don't know what the data will be
 
+      friend class ConditionVariable;
+
     /// @}
     /// @name Do Not Implement
     /// @{
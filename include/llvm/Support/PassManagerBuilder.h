@@ -83,6 +83,13 @@ public:
   /// per-module pass pipeline.
   TargetLibraryInfo *LibraryInfo;
   
+  /// TLI - The target's lowering information, which the -O3 vectorizers use
+  /// to tell which vector types and operations are legal.  It is not owned
+  /// by the builder.  If this is null, as it is when opt builds the
+  /// pipeline, the vectorizers fall back to target-independent costs and
+  /// assume a -vector-register-bits wide vector register.
+  const TargetLowering *TLI;
+  
   /// Inliner - Specifies the inliner to use.  If this is non-null, it is
   /// added to the per-module passes.
   Pass *Inliner;
@@ -100,6 +107,7 @@ public:
     OptLevel = 2;
     SizeLevel = 0;
     LibraryInfo = 0;
+    TLI = 0;
     Inliner = 0;
     DisableSimplifyLibCalls = false;
     DisableUnitAtATime = false;
@@ -208,6 +216,8 @@ public:
     MPM.add(createIndVarSimplifyPass());        // Canonicalize indvars
     MPM.add(createLoopIdiomPass());             // Recognize idioms like memset.
     MPM.add(createLoopDeletionPass());          // Delete dead loops
+    if (OptLevel > 2 && SizeLevel == 0)
+      MPM.add(createLoopVectorizePass(TLI));    // Vectorize simple loops
     if (!DisableUnrollLoops)
       MPM.add(createLoopUnrollPass());          // Unroll small loops
     addExtensionsToPM(EP_LoopOptimizerEnd, MPM);
@@ -223,6 +233,8 @@ public:
     MPM.add(createJumpThreadingPass());         // Thread jumps
     MPM.add(createCorrelatedValuePropagationPass());
     MPM.add(createDeadStoreEliminationPass());  // Delete dead stores
+    if (OptLevel > 2 && SizeLevel == 0)
+      MPM.add(createSLPVectorizerPass(TLI));    // Vectorize straight-line code
     MPM.add(createAggressiveDCEPass());         // Delete dead instructions
     MPM.add(createCFGSimplificationPass());     // Merge & remove BBs
     MPM.add(createInstructionCombiningPass());  // Clean up after everything.
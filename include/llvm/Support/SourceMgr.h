@@ -19,6 +19,7 @@
 #include "llvm/Support/SMLoc.h"
 
 #include <string>
+#include <utility>
 #include <vector>
 #include <cassert>
 
@@ -45,6 +46,11 @@ private:
     /// IncludeLoc - This is the location of the parent include, or null if at
     /// the top level.
     SMLoc IncludeLoc;
+
+    /// LineOffsets - The offsets of the newlines in the buffer, built by the
+    /// first line number query.  Its implementation is private to
+    /// SourceMgr.cpp.
+    mutable void *LineOffsets;
   };
 
   /// Buffers - This is all of the buffers that we are reading from.
@@ -54,17 +60,13 @@ private:
   // include files in.
   std::vector<std::string> IncludeDirectories;
 
-  /// LineNoCache - This is a cache for line number queries, its implementation
-  /// is really private to SourceMgr.cpp.
-  mutable void *LineNoCache;
-
   DiagHandlerTy DiagHandler;
   void *DiagContext;
   
   SourceMgr(const SourceMgr&);    // DO NOT IMPLEMENT
   void operator=(const SourceMgr&); // DO NOT IMPLEMENT
 public:
-  SourceMgr() : LineNoCache(0), DiagHandler(0), DiagContext(0) {}
+  SourceMgr() : DiagHandler(0), DiagContext(0) {}
   ~SourceMgr();
 
   void setIncludeDirs(const std::vector<std::string> &Dirs) {
@@ -99,6 +101,7 @@ public:
     SrcBuffer NB;
     NB.Buffer = F;
     NB.IncludeLoc = IncludeLoc;
+    NB.LineOffsets = 0;
     Buffers.push_back(NB);
     return Buffers.size()-1;
   }
@@ -113,8 +116,17 @@ public:
   int FindBufferContainingLoc(SMLoc Loc) const;
 
   /// FindLineNumber - Find the line number for the specified location in the
-  /// specified file.  This is not a fast method.
-  unsigned FindLineNumber(SMLoc Loc, int BufferID = -1) const;
+  /// specified file.  The first query for a buffer indexes the newlines in it,
+  /// later queries are a binary search.
+  unsigned FindLineNumber(SMLoc Loc, int BufferID = -1) const {
+    return getLineAndColumn(Loc, BufferID).first;
+  }
+
+  /// getLineAndColumn - Find the line number and the 0-based column of the
+  /// specified location in the specified file, with the same cost as
+  /// FindLineNumber.
+  std::pair<unsigned, unsigned> getLineAndColumn(SMLoc Loc,
+                                                 int BufferID = -1) const;
 
   /// PrintMessage - Emit a message about the specified location with the
   /// specified string.
@@ -54,6 +54,33 @@ namespace llvm {
   /// the thread stack.
   void llvm_execute_on_thread(void (*UserFn)(void*), void *UserData,
                               unsigned RequestedStackSize = 0);
+
+  /// llvm_execute_on_threads - Execute the given \arg UserFn once for each of
+  /// the \arg NumThreads entries of \arg UserData, running the calls
+  /// concurrently, and return once all of them have completed.  The call for
+  /// the first entry runs on the calling thread.
+  ///
+  /// As with llvm_execute_on_thread, the calls may run one after another on
+  /// the calling thread where system support for threads is not available.
+  ///
+  /// \param UserFn - The callback to execute.
+  /// \param UserData - The arguments to pass to the callback function, one per
+  /// thread.
+  /// \param NumThreads - The number of entries in \arg UserData.
+  void llvm_execute_on_threads(void (*UserFn)(void*), void *const *UserData,
+                               unsigned NumThreads);
+
+  /// llvm_start_thread - Start running the given \arg UserFn on a new thread,
+  /// passing it the provided \arg UserData, and return without waiting for it.
+  ///
+  /// \returns A handle for the thread, which must be passed to
+  /// llvm_join_thread, or null if no thread could be started (in which case
+  /// \arg UserFn has not been called).
+  void *llvm_start_thread(void (*UserFn)(void*), void *UserData);
+
+  /// llvm_join_thread - Wait for a thread started by llvm_start_thread to
+  /// finish, and release its handle.
+  void llvm_join_thread(void *Thread);
 }
 
 #endif
@@ -66,8 +66,10 @@ public:
   }
   ValueHandleBase(HandleBaseKind Kind, const ValueHandleBase &RHS)
     : PrevPair(0, Kind), Next(0), VP(RHS.VP) {
+    // Go after RHS rather than before it: another thread can move RHS's
+    // PrevPtr while we are being linked in, but not RHS itself.
     if (isValid(VP))
-      AddToExistingUseList(RHS.getPrevPtr());
+      AddToExistingUseListAfter(const_cast<ValueHandleBase*>(&RHS));
   }
   ~ValueHandleBase() {
     if (isValid(VP))
@@ -86,7 +88,8 @@ public:
     if (VP == RHS.VP) return RHS.VP;
     if (isValid(VP)) RemoveFromUseList();
     VP = RHS.VP;
-    if (isValid(VP)) AddToExistingUseList(RHS.getPrevPtr());
+    if (isValid(VP))
+      AddToExistingUseListAfter(const_cast<ValueHandleBase*>(&RHS));
     return VP;
   }
 
@@ -129,6 +129,8 @@ public:
     LayoutMap(0)
   { }
 
+  virtual Pass *createClone() const { return new TargetData(*this); }
+
   ~TargetData();  // Not virtual, do not subclass this class
 
   //! Parse a target data layout string and initialize TargetData alignments.
@@ -52,6 +52,8 @@ public:
   TargetLibraryInfo();
   TargetLibraryInfo(const Triple &T);
   explicit TargetLibraryInfo(const TargetLibraryInfo &TLI);
+
+  virtual Pass *createClone() const;
   
   /// has - This function is used by optimizations that want to match on or form
   /// a given library function.
@@ -141,6 +141,22 @@ Pass *createLoopRotatePass();
 // LoopIdiom - This pass recognizes and replaces idioms in loops.
 //
 Pass *createLoopIdiomPass();
+
+//===----------------------------------------------------------------------===//
+//
+// LoopVectorize - This pass rewrites simple innermost loops to run several
+// iterations at once on vector types, keeping the original loop for the
+// leftover iterations.
+//
+Pass *createLoopVectorizePass(const TargetLowering *TLI = 0);
+
+//===----------------------------------------------------------------------===//
+//
+// SLPVectorizer - This pass packs isomorphic computations on adjacent memory
+// within a basic block, such as unrolled loop bodies, into vector
+// instructions.
+//
+FunctionPass *createSLPVectorizerPass(const TargetLowering *TLI = 0);
   
 //===----------------------------------------------------------------------===//
 //
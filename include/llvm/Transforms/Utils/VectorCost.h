@@ -0,0 +1,40 @@
+//===- llvm/Transforms/Utils/VectorCost.h - Vectorizer costs --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the cost model shared by the vectorizers.  It asks the
+// optional TargetLowering which vector types and operations the target has,
+// and falls back to a generic 128-bit vector unit without one.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_UTILS_VECTORCOST_H
+#define LLVM_TRANSFORMS_UTILS_VECTORCOST_H
+
+namespace llvm {
+
+class LLVMContext;
+class TargetLowering;
+class VectorType;
+
+/// getVectorRegisterBits - Return the width of the widest vector of
+/// ElementBits wide integers that the target has registers for, or zero if
+/// it has none.
+unsigned getVectorRegisterBits(LLVMContext &Context, unsigned ElementBits,
+                               const TargetLowering *TLI);
+
+/// getVectorizedCost - Estimate the cost of an instruction with the given
+/// opcode on vectors of type VecTy, in units of a simple scalar instruction.
+/// For stores, VecTy is the type of the stored vector.  Operations that the
+/// target has no vector form for are split into one operation per lane.
+unsigned getVectorizedCost(unsigned Opcode, const VectorType *VecTy,
+                           const TargetLowering *TLI);
+
+} // End llvm namespace
+
+#endif
@@ -14,9 +14,11 @@
 // Pointer tagging is used to efficiently find the User corresponding
 // to a Use without having to store a User pointer in every Use. A
 // User is preceded in memory by all the Uses corresponding to its
-// operands, and the low bits of one of the fields (Prev) of the Use
-// class are used to encode offsets to be able to find that User given
-// a pointer to any Use. For details, see:
+// operands, and the low bits of two of the fields (Next and Prev) of the
+// Use class are used to encode offsets to be able to find that User given
+// a pointer to any Use.  The Uses closest to the User hold their distance
+// from it outright; the others hold the digits of the waymarking scheme.
+// For details, see:
 //
 //   http://www.llvm.org/docs/ProgrammersManual.html#UserLayout
 //
@@ -26,6 +28,7 @@
 #define LLVM_USE_H
 
 #include "llvm/ADT/PointerIntPair.h"
+#include "llvm/Support/DataTypes.h"
 #include <cstddef>
 #include <iterator>
 
@@ -65,18 +68,23 @@ private:
   Use(const Use &U);
 
   /// Destructor - Only for zap()
-  ~Use() {
-    if (Val) removeFromList();
-  }
+  inline ~Use();
 
   enum PrevPtrTag { zeroDigitTag
                   , oneDigitTag
                   , stopTag
                   , fullStopTag };
 
+  /// A Use's tag is four bits wide: the low two are kept in Prev and the
+  /// high two in Next.  Tags below directTag are the waymarking digits, and
+  /// are only found in Uses more than MaxDirectDistance from their User.  A
+  /// tag of directTag + N - 1 marks a Use that is N Uses before its User.
+  enum { directTag = 4, MaxDirectDistance = 12, NextTagMask = 3 };
+
   /// Constructor
-  Use(PrevPtrTag tag) : Val(0) {
-    Prev.setInt(tag);
+  explicit Use(unsigned Tag)
+    : Val(0), Next(reinterpret_cast<Use*>(uintptr_t(Tag >> 2))) {
+    Prev.setInt(PrevPtrTag(Tag & 3));
   }
 
 public:
@@ -89,6 +97,10 @@ public:
   
   /// getUser - This returns the User that contains this Use.  For an
   /// instruction operand, for example, this will return the instruction.
+  /// This takes constant time only for the last MaxDirectDistance (twelve)
+  /// Uses of an operand list, so only for every operand of a User with at
+  /// most twelve operands.  Earlier Uses of a longer list walk the
+  /// waymarking digits, which takes time logarithmic in their distance.
   User *getUser() const;
 
   inline void set(Value *Val);
@@ -105,7 +117,10 @@ public:
         Value *operator->()       { return Val; }
   const Value *operator->() const { return Val; }
 
-  Use *getNext() const { return Next; }
+  Use *getNext() const {
+    return reinterpret_cast<Use*>(reinterpret_cast<uintptr_t>(Next) &
+                                  ~uintptr_t(NextTagMask));
+  }
 
   
   /// zap - This is used to destroy Use operands when the number of operands of
@@ -117,22 +132,41 @@ private:
   static Use *initTags(Use *Start, Use *Stop);
   
   Value *Val;
+  /// Next - The next Use in the use list.  The low bits hold the high half
+  /// of the tag; use getNext to read it.
   Use *Next;
+  /// Prev - The Next field of the previous Use in the use list, or the
+  /// Value's UseList, along with the low half of the tag.
   PointerIntPair<Use**, 2, PrevPtrTag> Prev;
 
+  /// getTag - Return the tag that locates this Use's User.
+  unsigned getTag() const {
+    return unsigned(reinterpret_cast<uintptr_t>(Next) & NextTagMask) << 2 |
+           Prev.getInt();
+  }
+
+  /// setLink - Point the link at Slot to U, keeping the tag bits that the
+  /// Next field of a Use keeps there.  A Value's UseList has none.
+  static void setLink(Use **Slot, Use *U) {
+    uintptr_t Tag = reinterpret_cast<uintptr_t>(*Slot) & NextTagMask;
+    *Slot = reinterpret_cast<Use*>(reinterpret_cast<uintptr_t>(U) | Tag);
+  }
+
   void setPrev(Use **NewPrev) {
     Prev.setPointer(NewPrev);
   }
   void addToList(Use **List) {
-    Next = *List;
-    if (Next) Next->setPrev(&Next);
+    Use *Head = *List;
+    setLink(&Next, Head);
+    if (Head) Head->setPrev(&Next);
     setPrev(List);
     *List = this;
   }
   void removeFromList() {
     Use **StrippedPrev = Prev.getPointer();
-    *StrippedPrev = Next;
-    if (Next) Next->setPrev(StrippedPrev);
+    Use *N = getNext();
+    setLink(StrippedPrev, N);
+    if (N) N->setPrev(StrippedPrev);
   }
 
   friend class Value;
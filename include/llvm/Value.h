@@ -195,7 +195,21 @@ public:
 
   /// addUse - This method should only be used by the Use class.
   ///
-  void addUse(Use &U) { U.addToList(&UseList); }
+  void addUse(Use &U) {
+    if (hasSharedUseList())
+      addSharedUse(U);
+    else
+      U.addToList(&UseList);
+  }
+
+  /// removeUse - This method should only be used by the Use class.
+  ///
+  void removeUse(Use &U) {
+    if (hasSharedUseList())
+      removeSharedUse(U);
+    else
+      U.removeFromList();
+  }
 
   /// An enumeration for keeping track of the concrete subclass of Value that
   /// is actually instantiated. Values of this enumeration are kept in the 
@@ -313,6 +327,20 @@ public:
 protected:
   unsigned short getSubclassDataFromValue() const { return SubclassData; }
   void setValueSubclassData(unsigned short D) { SubclassData = D; }
+
+private:
+  /// hasSharedUseList - Return true if this value can be used from more than
+  /// one function, so that threads building different functions may change
+  /// its use list at the same time.  Only arguments, basic blocks and
+  /// instructions belong to a single function.
+  bool hasSharedUseList() const {
+    return SubclassID > BasicBlockVal && SubclassID < InstructionVal;
+  }
+
+  /// addSharedUse/removeSharedUse - Change the use list of a value for which
+  /// hasSharedUseList() is true, under its lock in the LLVMContext.
+  void addSharedUse(Use &U);
+  void removeSharedUse(Use &U);
 };
 
 inline raw_ostream &operator<<(raw_ostream &OS, const Value &V) {
@@ -321,11 +349,15 @@ inline raw_ostream &operator<<(raw_ostream &OS, const Value &V) {
 }
   
 void Use::set(Value *V) {
-  if (Val) removeFromList();
+  if (Val) Val->removeUse(*this);
   Val = V;
   if (V) V->addUse(*this);
 }
 
+Use::~Use() {
+  if (Val) Val->removeUse(*this);
+}
+
 
 // isa - Provide some specializations of isa so that we don't have to include
 // the subtype header files to test to see if the value is a subclass...
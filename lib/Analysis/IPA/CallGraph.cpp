@@ -224,8 +224,13 @@ Function *CallGraph::removeFunctionFromModule(CallGraphNode *CGN) {
          "graph if it references other functions!");
   Function *F = CGN->getFunction(); // Get the function for the call graph node
   delete CGN;                       // Delete the call graph node for this func
-  FunctionMap.erase(F);             // Remove the call graph node from the map
+  {
+    sys::SmartScopedLock<true> Guard(MapLock);
+    FunctionMap.erase(F);           // Remove the call graph node from the map
+  }
 
+  // Don't hold the lock here: touching the module may have to wait for other
+  // threads that use the call graph.
   Mod->getFunctionList().remove(F);
   return F;
 }
@@ -236,6 +241,7 @@ Function *CallGraph::removeFunctionFromModule(CallGraphNode *CGN) {
 /// callers from old to new.
 ///
 void CallGraph::spliceFunction(const Function *From, const Function *To) {
+  sys::SmartScopedLock<true> Guard(MapLock);
   assert(FunctionMap.count(From) && "No CallGraphNode for function!");
   assert(!FunctionMap.count(To) &&
          "Pointing CallGraphNode at a function that already exists");
@@ -249,6 +255,7 @@ void CallGraph::spliceFunction(const Function *From, const Function *To) {
 // it will insert a new CallGraphNode for the specified function if one does
 // not already exist.
 CallGraphNode *CallGraph::getOrInsertFunction(const Function *F) {
+  sys::SmartScopedLock<true> Guard(MapLock);
   CallGraphNode *&CGN = FunctionMap[F];
   if (CGN) return CGN;
   
@@ -17,22 +17,408 @@
 
 #define DEBUG_TYPE "cgscc-passmgr"
 #include "llvm/CallGraphSCCPass.h"
+#include "llvm/Constants.h"
+#include "llvm/GlobalAlias.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/InlineAsm.h"
 #include "llvm/IntrinsicInst.h"
 #include "llvm/Function.h"
+#include "llvm/Module.h"
+#include "llvm/PassManager.h"
 #include "llvm/PassManagers.h"
 #include "llvm/Analysis/CallGraph.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ConditionVariable.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/ThreadLocal.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <set>
 using namespace llvm;
 
 static cl::opt<unsigned> 
 MaxIterations("max-cg-scc-iterations", cl::ReallyHidden, cl::init(4));
 
+static cl::opt<unsigned>
+CGSCCThreads("cgscc-threads", cl::Hidden, cl::init(1),
+             cl::desc("Number of threads to visit call graph SCCs on "
+                      "(default = 1)"));
+
 STATISTIC(MaxSCCIterations, "Maximum CGSCCPassMgr iterations on one SCC");
+STATISTIC(NumHelperSCCs, "Number of SCCs visited on helper threads");
+
+//===----------------------------------------------------------------------===//
+// SCCSchedule
+//
+/// SCCSchedule - Decides which SCCs of a module may be visited at the same
+/// time without changing the result of the bottom-up walk.
+///
+/// The thread that runs the CGPassManager still visits every SCC in order.
+/// Helper threads run copies of the passes and only take SCCs that call no
+/// defined function, not even one of their own.  Nothing is ever inlined into
+/// those, so the state the passes keep between SCCs does not depend on which
+/// copy visits them.
+///
+/// An SCC starts once the SCCs it calls have finished, and so have the
+/// earlier SCCs that may refer to any of the globals it may refer to.  SCCs
+/// with indirect calls, or that call such SCCs, may devirtualize a call and
+/// inline from anywhere, so they run alone.  Lastly, only the first
+/// unfinished SCC may look at the module's lists and symbol tables: a thread
+/// that gets there early waits in willAccessModule, so globals are created
+/// and named in the same order as in a serial walk.
+
+namespace {
+
+class SCCSchedule : public ModuleAccessHook {
+  enum SCCState { NotStarted, Running, Finished };
+
+  struct SCCInfo {
+    std::vector<CallGraphNode*> Nodes;
+    std::vector<unsigned> Dependents; // SCCs that wait for this one.
+    unsigned Index;
+    unsigned NumPending;   // Unfinished SCCs this one waits for.
+    bool Independent;      // May be visited by a helper thread.
+    bool Exclusive;        // Runs with no other SCC running.
+    mutable bool HasTurn;  // All earlier SCCs have finished.  Only the
+                           // visiting thread uses this.
+    SCCState State;
+  };
+  std::vector<SCCInfo> SCCs;
+
+  /// Exclusives - The indices of the exclusive SCCs, in order.
+  std::vector<unsigned> Exclusives;
+
+  sys::Mutex Lock;
+  sys::ConditionVariable StateChanged;
+
+  /// Ready - Independent SCCs that are only waiting for a thread.
+  std::set<unsigned> Ready;
+
+  /// FirstUnfinished - All SCCs before this one have finished.
+  unsigned FirstUnfinished;
+
+  /// NextExclusive - Index into Exclusives of the first unfinished exclusive
+  /// SCC.  Helper threads do not start SCCs after it before it finishes.
+  unsigned NextExclusive;
+
+  /// Current - The SCC that the calling thread is visiting, if any.
+  sys::ThreadLocal<const SCCInfo> Current;
+
+  void computeDependences(CallGraph &CG);
+
+  unsigned getExclusiveLimit() const {
+    return NextExclusive == Exclusives.size() ? SCCs.size() :
+                                                Exclusives[NextExclusive];
+  }
+
+  void begin(SCCInfo &S, CallGraphSCC &SCC) {
+    S.HasTurn = false;
+    SCC.initialize(&S.Nodes[0], &S.Nodes[0]+S.Nodes.size());
+    Current.set(&S);
+  }
+
+public:
+  explicit SCCSchedule(CallGraph &CG);
+
+  unsigned size() const { return SCCs.size(); }
+
+  /// hasIndependentSCCs - Return true if there is anything for helper
+  /// threads to do.
+  bool hasIndependentSCCs() const;
+
+  /// startInOrder - Wait until SCC #i may start, and set up SCC to visit it.
+  /// Returns false if a helper thread has already taken it.
+  bool startInOrder(unsigned i, CallGraphSCC &SCC);
+
+  /// startNext - Wait for an independent SCC that may start, and set up SCC
+  /// to visit it.  Returns false once every SCC has finished.
+  bool startNext(unsigned &i, CallGraphSCC &SCC);
+
+  /// finish - Note that the calling thread is done with SCC #i, after
+  /// Iterations trips through the pass pipeline.
+  void finish(unsigned i, unsigned Iterations);
+
+  virtual void willAccessModule();
+};
+
+} // end anonymous namespace.
+
+/// MaxGlobalsPerSCC - SCCs that may refer to more globals than this are made
+/// exclusive instead of tracking each global, which bounds the memory and
+/// time spent on the schedule for deep call chains.
+static const unsigned MaxGlobalsPerSCC = 1024;
+
+typedef std::vector<const GlobalValue*> GlobalList;
+
+/// addReferencedGlobals - Add the globals that constant C may refer to, which
+/// a pass visiting a user of C may look at or change, to Refs.
+static void addReferencedGlobals(const Constant *C,
+                                 SmallPtrSet<const Constant*, 32> &Visited,
+                                 GlobalList &Refs) {
+  if (!Visited.insert(C))
+    return;
+
+  if (const GlobalAlias *GA = dyn_cast<GlobalAlias>(C)) {
+    if (const Constant *Aliasee = GA->getAliasee())
+      addReferencedGlobals(Aliasee, Visited, Refs);
+    return;
+  }
+
+  if (const GlobalVariable *GV = dyn_cast<GlobalVariable>(C)) {
+    // Passes may change the alignment of any global variable, and may look
+    // through the initializers of constant ones.
+    Refs.push_back(GV);
+    if (GV->isConstant() && GV->hasDefinitiveInitializer())
+      addReferencedGlobals(GV->getInitializer(), Visited, Refs);
+    return;
+  }
+
+  if (const Function *F = dyn_cast<Function>(C)) {
+    if (!F->isDeclaration())
+      Refs.push_back(F);
+    return;
+  }
+
+  for (User::const_op_iterator I = C->op_begin(), E = C->op_end(); I != E; ++I)
+    if (const Constant *Op = dyn_cast<Constant>(*I))
+      addReferencedGlobals(Op, Visited, Refs);
+}
+
+/// isIndirectCall - Return true if the call graph edge for call site V stands
+/// for a call that could be devirtualized.
+static bool isIndirectCall(Value *V) {
+  if (V == 0)
+    return true;
+  CallSite CS(V);
+  return !CS || !isa<InlineAsm>(CS.getCalledValue());
+}
+
+SCCSchedule::SCCSchedule(CallGraph &CG)
+  : Lock(false), FirstUnfinished(0), NextExclusive(0) {
+  for (scc_iterator<CallGraph*> I = scc_begin(&CG); !I.isAtEnd(); ++I) {
+    SCCs.push_back(SCCInfo());
+    SCCInfo &S = SCCs.back();
+    S.Nodes = *I;
+    S.Index = SCCs.size()-1;
+    S.NumPending = 0;
+    S.Independent = true;
+    S.Exclusive = false;
+    S.HasTurn = false;
+    S.State = NotStarted;
+  }
+  computeDependences(CG);
+
+  for (unsigned i = 0, e = SCCs.size(); i != e; ++i) {
+    if (SCCs[i].Exclusive)
+      Exclusives.push_back(i);
+    else if (SCCs[i].Independent && SCCs[i].NumPending == 0)
+      Ready.insert(i);
+  }
+}
+
+void SCCSchedule::computeDependences(CallGraph &CG) {
+  DenseMap<CallGraphNode*, unsigned> SCCOf;
+  for (unsigned i = 0, e = SCCs.size(); i != e; ++i)
+    for (unsigned j = 0, je = SCCs[i].Nodes.size(); j != je; ++j)
+      SCCOf[SCCs[i].Nodes[j]] = i;
+
+  // The globals each SCC may refer to, including through its callees, and
+  // the last SCC so far that may refer to each global.
+  std::vector<GlobalList> Refs(SCCs.size());
+  DenseMap<const GlobalValue*, unsigned> LastUser;
+
+  for (unsigned i = 0, e = SCCs.size(); i != e; ++i) {
+    SCCInfo &S = SCCs[i];
+    GlobalList &R = Refs[i];
+    SmallVector<unsigned, 8> Deps;
+    SmallPtrSet<const Constant*, 32> Visited;
+
+    for (unsigned n = 0, ne = S.Nodes.size(); n != ne; ++n) {
+      CallGraphNode *Node = S.Nodes[n];
+      Function *F = Node->getFunction();
+      if (F == 0) {
+        S.Independent = false;
+        continue;
+      }
+      if (F->isDeclaration())
+        continue;
+
+      for (CallGraphNode::iterator I = Node->begin(), E = Node->end();
+           I != E; ++I) {
+        CallGraphNode *Callee = I->second;
+        if (Callee == CG.getCallsExternalNode()) {
+          if (isIndirectCall(I->first))
+            S.Exclusive = true;
+          continue;
+        }
+        if (Callee->getFunction() && !Callee->getFunction()->isDeclaration())
+          S.Independent = false;
+
+        DenseMap<CallGraphNode*, unsigned>::iterator It = SCCOf.find(Callee);
+        if (It == SCCOf.end() || It->second == i)
+          continue;
+        Deps.push_back(It->second);
+        if (SCCs[It->second].Exclusive)
+          S.Exclusive = true;
+        else
+          R.insert(R.end(), Refs[It->second].begin(), Refs[It->second].end());
+      }
+
+      R.push_back(F);
+      for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+        for (BasicBlock::iterator I = BB->begin(), IE = BB->end();
+             I != IE; ++I)
+          for (User::op_iterator OI = I->op_begin(), OE = I->op_end();
+               OI != OE; ++OI)
+            if (Constant *C = dyn_cast<Constant>(*OI))
+              addReferencedGlobals(C, Visited, R);
+    }
+
+    std::sort(R.begin(), R.end());
+    R.erase(std::unique(R.begin(), R.end()), R.end());
+    if (R.size() > MaxGlobalsPerSCC)
+      S.Exclusive = true;
+
+    if (S.Exclusive) {
+      // Exclusive SCCs wait for everything before them and hold up everything
+      // after them, so they need no other ordering.
+      S.Independent = false;
+      GlobalList().swap(R);
+      continue;
+    }
+
+    for (GlobalList::iterator I = R.begin(), E = R.end(); I != E; ++I) {
+      unsigned &Last = LastUser[*I];
+      if (Last != 0)
+        Deps.push_back(Last-1);
+      Last = i+1;
+    }
+
+    std::sort(Deps.begin(), Deps.end());
+    Deps.erase(std::unique(Deps.begin(), Deps.end()), Deps.end());
+    S.NumPending = Deps.size();
+    for (unsigned d = 0, de = Deps.size(); d != de; ++d)
+      SCCs[Deps[d]].Dependents.push_back(i);
+  }
+}
+
+bool SCCSchedule::hasIndependentSCCs() const {
+  for (unsigned i = 0, e = SCCs.size(); i != e; ++i)
+    if (SCCs[i].Independent)
+      return true;
+  return false;
+}
+
+bool SCCSchedule::startInOrder(unsigned i, CallGraphSCC &SCC) {
+  SCCInfo &S = SCCs[i];
+  {
+    sys::ScopedLock Guard(Lock);
+    for (;;) {
+      if (S.State != NotStarted)
+        return false;
+      if (S.NumPending == 0 && (!S.Exclusive || FirstUnfinished == i))
+        break;
+      StateChanged.wait(Lock);
+    }
+    S.State = Running;
+    Ready.erase(i);
+  }
+  begin(S, SCC);
+  return true;
+}
+
+bool SCCSchedule::startNext(unsigned &i, CallGraphSCC &SCC) {
+  {
+    sys::ScopedLock Guard(Lock);
+    for (;;) {
+      if (!Ready.empty() && *Ready.begin() < getExclusiveLimit())
+        break;
+      if (FirstUnfinished == SCCs.size())
+        return false;
+      StateChanged.wait(Lock);
+    }
+    i = *Ready.begin();
+    Ready.erase(Ready.begin());
+    SCCs[i].State = Running;
+  }
+  begin(SCCs[i], SCC);
+  return true;
+}
+
+void SCCSchedule::finish(unsigned i, unsigned Iterations) {
+  Current.erase();
+
+  sys::ScopedLock Guard(Lock);
+  SCCInfo &S = SCCs[i];
+  S.State = Finished;
+  if (Iterations > MaxSCCIterations)
+    MaxSCCIterations = Iterations;
+
+  for (unsigned d = 0, e = S.Dependents.size(); d != e; ++d) {
+    SCCInfo &D = SCCs[S.Dependents[d]];
+    if (--D.NumPending == 0 && D.Independent && D.State == NotStarted)
+      Ready.insert(D.Index);
+  }
+
+  while (FirstUnfinished != SCCs.size() &&
+         SCCs[FirstUnfinished].State == Finished)
+    ++FirstUnfinished;
+  if (S.Exclusive)
+    ++NextExclusive;
+
+  StateChanged.notifyAll();
+}
+
+/// willAccessModule - Called whenever a pass is about to look at the lists or
+/// symbol tables of the module.  Hold the calling thread until all the SCCs
+/// before its own have finished.
+void SCCSchedule::willAccessModule() {
+  const SCCInfo *S = Current.get();
+  if (S == 0 || S->HasTurn)
+    return;
+
+  sys::ScopedLock Guard(Lock);
+  while (FirstUnfinished != S->Index)
+    StateChanged.wait(Lock);
+  S->HasTurn = true;
+}
+
+//===----------------------------------------------------------------------===//
+// SharedCallGraph
+//
+/// SharedCallGraph - Hands the call graph of the module to the copies of a
+/// CGPassManager's passes that run on helper threads, in place of building a
+/// call graph of their own.
+
+namespace {
+
+class SharedCallGraph : public ImmutablePass {
+  CallGraph *CG;
+public:
+  static char ID;
+  explicit SharedCallGraph(CallGraph *cg = 0) : ImmutablePass(ID), CG(cg) {
+    initializeSharedCallGraphPass(*PassRegistry::getPassRegistry());
+  }
+
+  virtual void *getAdjustedAnalysisPointer(AnalysisID PI) {
+    if (PI == &CallGraph::ID)
+      return CG;
+    return this;
+  }
+};
+
+} // end anonymous namespace.
+
+char SharedCallGraph::ID = 0;
+INITIALIZE_AG_PASS(SharedCallGraph, CallGraph, "",
+                   "Call graph shared with helper threads", false, true, false)
 
 //===----------------------------------------------------------------------===//
 // CGPassManager
@@ -45,7 +431,7 @@ class CGPassManager : public ModulePass, public PMDataManager {
 public:
   static char ID;
   explicit CGPassManager(int Depth) 
-    : ModulePass(ID), PMDataManager(Depth) { }
+    : ModulePass(ID), PMDataManager(Depth), Schedule(0) { }
 
   /// run - Execute all of the passes scheduled for execution.  Keep track of
   /// whether any of the passes modifies the module, and if so, return true.
@@ -86,8 +472,22 @@ public:
   virtual PassManagerType getPassManagerType() const { 
     return PMT_CallGraphPassManager; 
   }
+
+  bool RunSCCsInOrder(CallGraph &CG, SCCSchedule &Sched);
   
 private:
+  /// Schedule - Set on the copies of this pass manager that visit SCCs on
+  /// helper threads.  See RunSCCsInParallel.
+  SCCSchedule *Schedule;
+
+  bool RunSCCsInParallel(CallGraph &CG, bool &Changed);
+  PassManager *createHelper(CallGraph &CG,
+                            const std::vector<AnalysisID> &Shape,
+                            CGPassManager *&Copy);
+  bool RunIndependentSCCs(CallGraph &CG, SCCSchedule &Sched);
+
+  bool RunSCC(CallGraphSCC &CurSCC, CallGraph &CG, unsigned &Iteration);
+
   bool RunAllPassesOnSCC(CallGraphSCC &CurSCC, CallGraph &CG,
                          bool &DevirtualizedCall);
   
@@ -415,11 +815,53 @@ bool CGPassManager::RunAllPassesOnSCC(CallGraphSCC &CurSCC, CallGraph &CG,
   return Changed;
 }
 
+/// RunSCC - Run all the passes in this pass manager on the functions in
+/// CurSCC, repeating them if they devirtualize a call.  Iteration is set to
+/// the number of times the passes were run.
+bool CGPassManager::RunSCC(CallGraphSCC &CurSCC, CallGraph &CG,
+                           unsigned &Iteration) {
+  // At the top level, we run all the passes in this pass manager on the
+  // functions in this SCC.  However, we support iterative compilation in the
+  // case where a function pass devirtualizes a call to a function.  For
+  // example, it is very common for a function pass (often GVN or instcombine)
+  // to eliminate the addressing that feeds into a call.  With that improved
+  // information, we would like the call to be an inline candidate, infer
+  // mod-ref information etc.
+  //
+  // Because of this, we allow iteration up to a specified iteration count.
+  // This only happens in the case of a devirtualized call, so we only burn
+  // compile time in the case that we're making progress.  We also have a hard
+  // iteration count limit in case there is crazy code.
+  bool Changed = false;
+  Iteration = 0;
+  bool DevirtualizedCall = false;
+  do {
+    DEBUG(if (Iteration)
+            dbgs() << "  SCCPASSMGR: Re-visiting SCC, iteration #"
+                   << Iteration << '\n');
+    DevirtualizedCall = false;
+    Changed |= RunAllPassesOnSCC(CurSCC, CG, DevirtualizedCall);
+  } while (Iteration++ < MaxIterations && DevirtualizedCall);
+  
+  if (DevirtualizedCall)
+    DEBUG(dbgs() << "  CGSCCPASSMGR: Stopped iteration after " << Iteration
+                 << " times, due to -max-cg-scc-iterations\n");
+  return Changed;
+}
+
 /// run - Execute all of the passes scheduled for execution.  Keep track of
 /// whether any of the passes modifies the module, and if so, return true.
 bool CGPassManager::runOnModule(Module &M) {
   CallGraph &CG = getAnalysis<CallGraph>();
+
+  // Copies of this pass manager on helper threads only visit the SCCs they
+  // are handed.  The original is initialized and finalized on their behalf.
+  if (Schedule)
+    return RunIndependentSCCs(CG, *Schedule);
+
   bool Changed = doInitialization(CG);
+  if (CGSCCThreads > 1 && RunSCCsInParallel(CG, Changed))
+    return doFinalization(CG) || Changed;
   
   // Walk the callgraph in bottom-up SCC order.
   scc_iterator<CallGraph*> CGI = scc_begin(&CG);
@@ -432,31 +874,8 @@ bool CGPassManager::runOnModule(Module &M) {
     CurSCC.initialize(&NodeVec[0], &NodeVec[0]+NodeVec.size());
     ++CGI;
     
-    // At the top level, we run all the passes in this pass manager on the
-    // functions in this SCC.  However, we support iterative compilation in the
-    // case where a function pass devirtualizes a call to a function.  For
-    // example, it is very common for a function pass (often GVN or instcombine)
-    // to eliminate the addressing that feeds into a call.  With that improved
-    // information, we would like the call to be an inline candidate, infer
-    // mod-ref information etc.
-    //
-    // Because of this, we allow iteration up to a specified iteration count.
-    // This only happens in the case of a devirtualized call, so we only burn
-    // compile time in the case that we're making progress.  We also have a hard
-    // iteration count limit in case there is crazy code.
-    unsigned Iteration = 0;
-    bool DevirtualizedCall = false;
-    do {
-      DEBUG(if (Iteration)
-              dbgs() << "  SCCPASSMGR: Re-visiting SCC, iteration #"
-                     << Iteration << '\n');
-      DevirtualizedCall = false;
-      Changed |= RunAllPassesOnSCC(CurSCC, CG, DevirtualizedCall);
-    } while (Iteration++ < MaxIterations && DevirtualizedCall);
-    
-    if (DevirtualizedCall)
-      DEBUG(dbgs() << "  CGSCCPASSMGR: Stopped iteration after " << Iteration
-                   << " times, due to -max-cg-scc-iterations\n");
+    unsigned Iteration;
+    Changed |= RunSCC(CurSCC, CG, Iteration);
     
     if (Iteration > MaxSCCIterations)
       MaxSCCIterations = Iteration;
@@ -466,6 +885,198 @@ bool CGPassManager::runOnModule(Module &M) {
   return Changed;
 }
 
+/// RunSCCsInOrder - Visit every SCC in bottom-up order, skipping the ones
+/// that a helper thread takes first.
+bool CGPassManager::RunSCCsInOrder(CallGraph &CG, SCCSchedule &Sched) {
+  bool Changed = false;
+  CallGraphSCC CurSCC(0);
+  for (unsigned i = 0, e = Sched.size(); i != e; ++i) {
+    if (!Sched.startInOrder(i, CurSCC))
+      continue;
+    unsigned Iteration;
+    Changed |= RunSCC(CurSCC, CG, Iteration);
+    Sched.finish(i, Iteration);
+  }
+  return Changed;
+}
+
+/// RunIndependentSCCs - Visit independent SCCs as they become ready, until
+/// all SCCs have been visited.
+bool CGPassManager::RunIndependentSCCs(CallGraph &CG, SCCSchedule &Sched) {
+  bool Changed = false;
+  CallGraphSCC CurSCC(0);
+  unsigned i;
+  while (Sched.startNext(i, CurSCC)) {
+    ++NumHelperSCCs;
+    unsigned Iteration;
+    Changed |= RunSCC(CurSCC, CG, Iteration);
+    Sched.finish(i, Iteration);
+  }
+  return Changed;
+}
+
+/// createHelper - Build a pass manager that runs copies of the passes in this
+/// one on the call graph CG, for a helper thread, and set Copy to the copy of
+/// this pass manager in it.  Returns null if some pass cannot be copied, or
+/// if the copy would not have the given Shape.
+PassManager *CGPassManager::createHelper(CallGraph &CG,
+                                         const std::vector<AnalysisID> &Shape,
+                                         CGPassManager *&Copy) {
+  PassManager *PM = new PassManager();
+
+  SmallVectorImpl<ImmutablePass*> &Immutables = TPM->getImmutablePasses();
+  for (unsigned i = 0, e = Immutables.size(); i != e; ++i) {
+    Pass *P = Immutables[i]->createClone();
+    if (P == 0) {
+      delete PM;
+      return 0;
+    }
+    PM->add(P);
+  }
+  PM->add(new SharedCallGraph(&CG));
+
+  std::vector<Pass*> Passes;
+  std::vector<AnalysisID> Unused;
+  collectPasses(Passes, Unused);
+  Pass *First = 0;
+  for (unsigned i = 0, e = Passes.size(); i != e; ++i) {
+    Pass *P = Passes[i]->createClone();
+    if (P == 0) {
+      delete PM;
+      return 0;
+    }
+    PM->add(P);
+    if (i == 0)
+      First = P;
+  }
+
+  // The first pass is a CallGraphSCCPass, so it was added straight to the
+  // copy of this pass manager, which must be the only module pass.
+  CGPassManager *Helper =
+    static_cast<CGPassManager*>(&First->getResolver()->getPMDataManager());
+  std::vector<Pass*> HelperPasses;
+  std::vector<AnalysisID> HelperShape;
+  Helper->collectPasses(HelperPasses, HelperShape);
+  if (HelperShape != Shape ||
+      Helper->getResolver()->getPMDataManager().getNumContainedPasses() != 1) {
+    delete PM;
+    return 0;
+  }
+
+  Copy = Helper;
+  return PM;
+}
+
+namespace {
+
+/// SCCLane - One of the threads that visit SCCs in parallel.
+struct SCCLane {
+  CGPassManager *InOrder; // Set for the calling thread.
+  PassManager *Helper;    // Set for helper threads.
+  CallGraph *CG;
+  SCCSchedule *Sched;
+  bool Changed;
+};
+
+} // end anonymous namespace.
+
+static void RunSCCLane(void *Arg) {
+  SCCLane *Lane = static_cast<SCCLane*>(Arg);
+  if (Lane->InOrder)
+    Lane->Changed = Lane->InOrder->RunSCCsInOrder(*Lane->CG, *Lane->Sched);
+  else
+    Lane->Changed = Lane->Helper->run(Lane->CG->getModule());
+}
+
+/// RunSCCsInParallel - Visit the SCCs of CG on -cgscc-threads threads, as
+/// SCCSchedule allows.  Returns false, having done nothing, if that cannot be
+/// done with the same result as a serial walk, e.g. because some pass cannot
+/// be copied.
+bool CGPassManager::RunSCCsInParallel(CallGraph &CG, bool &Changed) {
+  // Pass timers and -debug-pass output are not thread safe.
+  if (isPassInstrumentationEnabled())
+    return false;
+
+  // The first pass must be a CallGraphSCCPass, see createHelper.
+  if (getNumContainedPasses() == 0 ||
+      getContainedPass(0)->getAsPMDataManager())
+    return false;
+
+  // Helper threads only get the call graph and the immutable passes, so no
+  // other module level analysis may be in use.
+  Pass *CGPass = getResolver()->findImplPass(&CallGraph::ID);
+  DenseMap<AnalysisID, Pass*> *Available =
+    getResolver()->getPMDataManager().getAvailableAnalysis();
+  for (DenseMap<AnalysisID, Pass*>::iterator I = Available->begin(),
+       E = Available->end(); I != E; ++I) {
+    if (I->second == CGPass)
+      continue;
+    const PassInfo *PI = lookupPassInfo(I->second->getPassID());
+    if (PI && PI->isAnalysis())
+      return false;
+  }
+
+  SCCSchedule Sched(CG);
+  if (!Sched.hasIndependentSCCs())
+    return false;
+
+  std::vector<Pass*> Passes;
+  std::vector<AnalysisID> Shape;
+  collectPasses(Passes, Shape);
+
+  std::vector<PassManager*> Helpers;
+  std::vector<CGPassManager*> Copies;
+  for (unsigned i = 1; i < CGSCCThreads; ++i) {
+    CGPassManager *Copy;
+    PassManager *Helper = createHelper(CG, Shape, Copy);
+    if (Helper == 0)
+      break;
+    Helpers.push_back(Helper);
+    Copies.push_back(Copy);
+  }
+
+  bool StartedThreads = false;
+  if (Helpers.size() == CGSCCThreads-1 && !llvm_is_multithreaded())
+    StartedThreads = llvm_start_multithreaded();
+  if (Helpers.size() != CGSCCThreads-1 || !llvm_is_multithreaded()) {
+    for (unsigned i = 0, e = Helpers.size(); i != e; ++i)
+      delete Helpers[i];
+    return false;
+  }
+
+  // The copies start out like the original, initialized before any SCC is
+  // visited.  Only the original is finalized.
+  for (unsigned i = 0, e = Copies.size(); i != e; ++i) {
+    Copies[i]->doInitialization(CG);
+    Copies[i]->Schedule = &Sched;
+  }
+
+  std::vector<SCCLane> Lanes(Helpers.size()+1);
+  std::vector<void*> Args(Lanes.size());
+  for (unsigned i = 0, e = Lanes.size(); i != e; ++i) {
+    SCCLane &Lane = Lanes[i];
+    Lane.InOrder = i == 0 ? this : 0;
+    Lane.Helper = i == 0 ? 0 : Helpers[i-1];
+    Lane.CG = &CG;
+    Lane.Sched = &Sched;
+    Lane.Changed = false;
+    Args[i] = &Lane;
+  }
+
+  Module &M = CG.getModule();
+  M.setAccessHook(&Sched);
+  llvm_execute_on_threads(RunSCCLane, &Args[0], Args.size());
+  M.setAccessHook(0);
+
+  if (StartedThreads)
+    llvm_stop_multithreaded();
+
+  for (unsigned i = 0, e = Lanes.size(); i != e; ++i)
+    Changed |= Lanes[i].Changed;
+  for (unsigned i = 0, e = Helpers.size(); i != e; ++i)
+    delete Helpers[i];
+  return true;
+}
 
 /// Initialize CG
 bool CGPassManager::doInitialization(CallGraph &CG) {
@@ -513,9 +1124,10 @@ void CallGraphSCC::ReplaceNode(CallGraphNode *Old, CallGraphNode *New) {
   }
   
   // Update the active scc_iterator so that it doesn't contain dangling
-  // pointers to the old CallGraphNode.
-  scc_iterator<CallGraph*> *CGI = (scc_iterator<CallGraph*>*)Context;
-  CGI->ReplaceNode(Old, New);
+  // pointers to the old CallGraphNode.  SCCs visited in parallel have none:
+  // their node lists are all copied before the walk starts.
+  if (scc_iterator<CallGraph*> *CGI = (scc_iterator<CallGraph*>*)Context)
+    CGI->ReplaceNode(Old, New);
 }
 
 
@@ -22,6 +22,7 @@ void llvm::initializeIPA(PassRegistry &Registry) {
   initializeCallGraphAnalysisGroup(Registry);
   initializeFindUsedTypesPass(Registry);
   initializeGlobalsModRefPass(Registry);
+  initializeSharedCallGraphPass(Registry);
 }
 
 void LLVMInitializeIPA(LLVMPassRegistryRef R) {
@@ -0,0 +1,564 @@
+//===- MemorySSA.cpp - Memory SSA Builder ---------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the MemorySSA pass, which builds Memory SSA for a
+// function.  Phis are placed at the iterated dominance frontier of the blocks
+// that contain defs, and the accesses are then linked up with a walk over the
+// dominator tree, the same way PromoteMemoryToRegister builds scalar SSA.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "memoryssa"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Assembly/Writer.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+using namespace llvm;
+
+STATISTIC(NumMemoryDefs, "Number of memory defs built");
+STATISTIC(NumMemoryPhis, "Number of memory phis built");
+
+// Always verify Memory SSA if expensive checking is enabled.
+#ifdef XDEBUG
+static bool VerifyMemorySSA = true;
+#else
+static bool VerifyMemorySSA = false;
+#endif
+static cl::opt<bool,true>
+VerifyMemorySSAX("verify-memoryssa", cl::location(VerifyMemorySSA),
+                 cl::desc("Verify Memory SSA (time consuming)"));
+
+char MemorySSA::ID = 0;
+INITIALIZE_PASS_BEGIN(MemorySSA, "memoryssa", "Memory SSA", false, true)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
+INITIALIZE_PASS_END(MemorySSA, "memoryssa", "Memory SSA", false, true)
+
+//===----------------------------------------------------------------------===//
+// MemoryAccess Implementation
+//===----------------------------------------------------------------------===//
+
+void MemoryAccess::removeUser(MemoryAccess *MA) {
+  // Users are usually removed in about the order they were added, so look for
+  // the most recent one first.
+  std::vector<MemoryAccess*>::iterator I =
+    std::find(Users.rbegin(), Users.rend(), MA).base();
+  assert(I != Users.begin() && "Not a user of this access!");
+  Users.erase(--I);
+}
+
+void MemoryUseOrDef::setDefiningAccess(MemoryAccess *MA) {
+  if (DefiningAccess)
+    DefiningAccess->removeUser(this);
+  DefiningAccess = MA;
+  if (MA)
+    MA->addUser(this);
+}
+
+MemoryAccess *MemoryPhi::getIncomingValueForBlock(const BasicBlock *BB) const {
+  for (unsigned i = 0, e = getNumIncomingValues(); i != e; ++i)
+    if (getIncomingBlock(i) == BB)
+      return getIncomingValue(i);
+  return 0;
+}
+
+void MemoryPhi::addIncoming(MemoryAccess *MA, BasicBlock *Pred) {
+  Incoming.push_back(std::make_pair(MA, Pred));
+  MA->addUser(this);
+}
+
+void MemoryPhi::setIncomingValue(unsigned i, MemoryAccess *MA) {
+  Incoming[i].first->removeUser(this);
+  Incoming[i].first = MA;
+  MA->addUser(this);
+}
+
+void MemoryAccess::printName(raw_ostream &OS) const {
+  const MemoryDef *Def = dyn_cast<MemoryDef>(this);
+  if (Def && Def->getMemoryInst() == 0)
+    OS << "liveOnEntry";
+  else
+    OS << ID;
+}
+
+void MemoryAccess::print(raw_ostream &OS) const {
+  if (const MemoryPhi *Phi = dyn_cast<MemoryPhi>(this)) {
+    OS << ID << " = MemoryPhi(";
+    for (unsigned i = 0, e = Phi->getNumIncomingValues(); i != e; ++i) {
+      if (i) OS << ',';
+      OS << '{';
+      WriteAsOperand(OS, Phi->getIncomingBlock(i), false);
+      OS << ',';
+      Phi->getIncomingValue(i)->printName(OS);
+      OS << '}';
+    }
+    OS << ')';
+    return;
+  }
+
+  const MemoryUseOrDef *MA = cast<MemoryUseOrDef>(this);
+  if (isa<MemoryDef>(MA)) {
+    if (MA->getMemoryInst() == 0) {
+      OS << "liveOnEntry";
+      return;
+    }
+    OS << ID << " = MemoryDef(";
+  } else {
+    OS << "MemoryUse(";
+  }
+  MA->getDefiningAccess()->printName(OS);
+  OS << ')';
+}
+
+void MemoryAccess::dump() const {
+  print(dbgs());
+  dbgs() << '\n';
+}
+
+//===----------------------------------------------------------------------===//
+// MemorySSA Implementation
+//===----------------------------------------------------------------------===//
+
+MemorySSA::MemorySSA()
+  : FunctionPass(ID), F(0), AA(0), DT(0), LiveOnEntry(0), NextID(1) {
+  initializeMemorySSAPass(*PassRegistry::getPassRegistry());
+}
+
+MemorySSA::~MemorySSA() {
+  releaseMemory();
+}
+
+void MemorySSA::releaseMemory() {
+  for (DenseMap<const Instruction*, MemoryUseOrDef*>::iterator
+       I = InstAccesses.begin(), E = InstAccesses.end(); I != E; ++I)
+    delete I->second;
+  for (DenseMap<const BasicBlock*, MemoryPhi*>::iterator
+       I = PhiAccesses.begin(), E = PhiAccesses.end(); I != E; ++I)
+    delete I->second;
+  delete LiveOnEntry;
+  InstAccesses.clear();
+  PhiAccesses.clear();
+  LiveOnEntry = 0;
+  NextID = 1;
+}
+
+void MemorySSA::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+  AU.addRequiredTransitive<DominatorTree>();
+  AU.addRequiredTransitive<AliasAnalysis>();
+}
+
+namespace {
+  typedef std::pair<DomTreeNode*, unsigned> DomTreeNodePair;
+
+  struct DomTreeNodeCompare {
+    bool operator()(const DomTreeNodePair &LHS, const DomTreeNodePair &RHS) {
+      return LHS.second < RHS.second;
+    }
+  };
+}
+
+bool MemorySSA::runOnFunction(Function &Fn) {
+  F = &Fn;
+  AA = &getAnalysis<AliasAnalysis>();
+  DT = &getAnalysis<DominatorTree>();
+
+  BasicBlock *Entry = &F->getEntryBlock();
+  LiveOnEntry = new MemoryDef(0, Entry);
+
+  // Create a use or def for every instruction that touches memory and note
+  // the blocks with defs, which are where memory phis flow from.
+  DenseMap<BasicBlock*, unsigned> BBNumbers;
+  SmallVector<BasicBlock*, 32> DefBlocks;
+  unsigned BBNumber = 0;
+  for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
+    BBNumbers[BB] = BBNumber++;
+    bool HasDef = false;
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+      MemoryUseOrDef *MA;
+      if (I->mayWriteToMemory()) {
+        MemoryDef *Def = new MemoryDef(I, BB);
+        Def->ID = NextID++;
+        MA = Def;
+        HasDef = true;
+        ++NumMemoryDefs;
+      } else if (I->mayReadFromMemory()) {
+        MA = new MemoryUse(I, BB);
+      } else {
+        continue;
+      }
+      InstAccesses[I] = MA;
+    }
+    if (HasDef)
+      DefBlocks.push_back(BB);
+  }
+
+  placePhis(DefBlocks, BBNumbers);
+
+  // Link up the reachable blocks in dominator tree preorder, handing each
+  // block the memory state at the end of its immediate dominator.
+  SmallVector<std::pair<DomTreeNode*, MemoryAccess*>, 32> Worklist;
+  Worklist.push_back(std::make_pair(DT->getRootNode(),
+                                    static_cast<MemoryAccess*>(LiveOnEntry)));
+  while (!Worklist.empty()) {
+    DomTreeNode *Node = Worklist.back().first;
+    MemoryAccess *Incoming = Worklist.back().second;
+    Worklist.pop_back();
+
+    renameBlock(Node->getBlock(), Incoming);
+    for (DomTreeNode::iterator CI = Node->begin(), CE = Node->end();
+         CI != CE; ++CI)
+      Worklist.push_back(std::make_pair(*CI, Incoming));
+  }
+
+  // Unreachable blocks have no dominator to inherit a state from; treat each
+  // of them as if it started with the state on entry to the function.
+  for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+    if (!DT->isReachableFromEntry(BB)) {
+      MemoryAccess *Incoming = LiveOnEntry;
+      renameBlock(BB, Incoming);
+    }
+
+  return false;
+}
+
+/// placePhis - Insert a memory phi in every block of the iterated dominance
+/// frontier of DefBlocks.  Only defs are interesting here; the entry block
+/// dominates everything, so its live on entry def never needs a phi.
+void MemorySSA::placePhis(const SmallVectorImpl<BasicBlock*> &DefBlocks,
+                          DenseMap<BasicBlock*, unsigned> &BBNumbers) {
+  if (DefBlocks.empty())
+    return;
+
+  DenseMap<DomTreeNode*, unsigned> DomLevels;
+  SmallVector<DomTreeNode*, 32> Worklist;
+
+  DomTreeNode *Root = DT->getRootNode();
+  DomLevels[Root] = 0;
+  Worklist.push_back(Root);
+  while (!Worklist.empty()) {
+    DomTreeNode *Node = Worklist.pop_back_val();
+    unsigned ChildLevel = DomLevels[Node] + 1;
+    for (DomTreeNode::iterator CI = Node->begin(), CE = Node->end();
+         CI != CE; ++CI) {
+      DomLevels[*CI] = ChildLevel;
+      Worklist.push_back(*CI);
+    }
+  }
+
+  SmallPtrSet<BasicBlock*, 32> DefBlockSet;
+  DefBlockSet.insert(DefBlocks.begin(), DefBlocks.end());
+
+  // Use a priority queue keyed on dominator tree level so that inserted nodes
+  // are handled from the bottom of the dominator tree upwards.
+  typedef std::priority_queue<DomTreeNodePair, SmallVector<DomTreeNodePair, 32>,
+                              DomTreeNodeCompare> IDFPriorityQueue;
+  IDFPriorityQueue PQ;
+
+  for (unsigned i = 0, e = DefBlocks.size(); i != e; ++i)
+    if (DomTreeNode *Node = DT->getNode(DefBlocks[i]))
+      PQ.push(std::make_pair(Node, DomLevels[Node]));
+
+  SmallVector<std::pair<unsigned, BasicBlock*>, 32> DFBlocks;
+  SmallPtrSet<DomTreeNode*, 32> Visited;
+  while (!PQ.empty()) {
+    DomTreeNodePair RootPair = PQ.top();
+    PQ.pop();
+    DomTreeNode *Root = RootPair.first;
+    unsigned RootLevel = RootPair.second;
+
+    // Walk all dominator tree children of Root, inspecting their CFG edges with
+    // targets elsewhere on the dominator tree. Only targets whose level is at
+    // most Root's level are added to the iterated dominance frontier of the
+    // definition set.
+    Worklist.clear();
+    Worklist.push_back(Root);
+
+    while (!Worklist.empty()) {
+      DomTreeNode *Node = Worklist.pop_back_val();
+      BasicBlock *BB = Node->getBlock();
+
+      for (succ_iterator SI = succ_begin(BB), SE = succ_end(BB); SI != SE;
+           ++SI) {
+        DomTreeNode *SuccNode = DT->getNode(*SI);
+
+        // Quickly skip all CFG edges that are also dominator tree edges instead
+        // of catching them below.
+        if (SuccNode->getIDom() == Node)
+          continue;
+
+        unsigned SuccLevel = DomLevels[SuccNode];
+        if (SuccLevel > RootLevel)
+          continue;
+
+        if (!Visited.insert(SuccNode))
+          continue;
+
+        BasicBlock *SuccBB = SuccNode->getBlock();
+        DFBlocks.push_back(std::make_pair(BBNumbers[SuccBB], SuccBB));
+        if (!DefBlockSet.count(SuccBB))
+          PQ.push(std::make_pair(SuccNode, SuccLevel));
+      }
+
+      for (DomTreeNode::iterator CI = Node->begin(), CE = Node->end(); CI != CE;
+           ++CI) {
+        if (!Visited.count(*CI))
+          Worklist.push_back(*CI);
+      }
+    }
+  }
+
+  // Number the phis in block order so that printing is deterministic.
+  if (DFBlocks.size() > 1)
+    std::sort(DFBlocks.begin(), DFBlocks.end());
+
+  for (unsigned i = 0, e = DFBlocks.size(); i != e; ++i) {
+    MemoryPhi *Phi = new MemoryPhi(DFBlocks[i].second);
+    Phi->ID = NextID++;
+    PhiAccesses[DFBlocks[i].second] = Phi;
+    ++NumMemoryPhis;
+  }
+}
+
+/// renameBlock - Link the accesses of BB to the memory state that reaches
+/// them, starting with Incoming at the top of the block, and add the state at
+/// the end of the block to the phis of its successors.  On return, Incoming
+/// is the state at the end of the block.
+void MemorySSA::renameBlock(BasicBlock *BB, MemoryAccess *&Incoming) {
+  if (MemoryPhi *Phi = PhiAccesses.lookup(BB))
+    Incoming = Phi;
+
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+    MemoryUseOrDef *MA = InstAccesses.lookup(I);
+    if (MA == 0) continue;
+    MA->setDefiningAccess(Incoming);
+    if (isa<MemoryDef>(MA))
+      Incoming = MA;
+  }
+
+  for (succ_iterator SI = succ_begin(BB), SE = succ_end(BB); SI != SE; ++SI) {
+    MemoryPhi *Phi = PhiAccesses.lookup(*SI);
+    if (Phi == 0) continue;
+    // Multiple edges from BB to the same successor share one entry.
+    unsigned NumIncoming = Phi->getNumIncomingValues();
+    if (NumIncoming == 0 || Phi->getIncomingBlock(NumIncoming-1) != BB)
+      Phi->addIncoming(Incoming, BB);
+  }
+}
+
+/// getReachingDefAtEntry - Return the memory state at the start of BB.
+MemoryAccess *MemorySSA::getReachingDefAtEntry(BasicBlock *BB) const {
+  if (MemoryPhi *Phi = getMemoryAccess(BB))
+    return Phi;
+  // Without a phi, the state is the one at the end of the immediate dominator.
+  DomTreeNode *Node = DT->getNode(BB);
+  if (Node == 0 || Node->getIDom() == 0)
+    return LiveOnEntry;
+  return getReachingDefAtEnd(Node->getIDom()->getBlock());
+}
+
+MemoryAccess *MemorySSA::getReachingDefAtEnd(BasicBlock *BB) const {
+  while (1) {
+    for (BasicBlock::iterator I = BB->end(); I != BB->begin(); ) {
+      MemoryUseOrDef *MA = getMemoryAccess(--I);
+      if (MA && isa<MemoryDef>(MA))
+        return MA;
+    }
+    if (MemoryPhi *Phi = getMemoryAccess(BB))
+      return Phi;
+    DomTreeNode *Node = DT->getNode(BB);
+    if (Node == 0 || Node->getIDom() == 0)
+      return LiveOnEntry;
+    BB = Node->getIDom()->getBlock();
+  }
+}
+
+MemoryAccess *
+MemorySSA::getClobberingMemoryAccess(MemoryAccess *Start,
+                                     const AliasAnalysis::Location &Loc) {
+  MemoryAccess *MA = Start;
+  if (MemoryUse *MU = dyn_cast<MemoryUse>(MA))
+    MA = MU->getDefiningAccess();
+
+  while (MemoryDef *Def = dyn_cast<MemoryDef>(MA)) {
+    if (isLiveOnEntryDef(Def) ||
+        (AA->getModRefInfo(Def->getMemoryInst(), Loc) & AliasAnalysis::Mod))
+      break;
+    MA = Def->getDefiningAccess();
+  }
+  return MA;
+}
+
+void MemorySSA::removeMemoryAccess(Instruction *I) {
+  DenseMap<const Instruction*, MemoryUseOrDef*>::iterator It =
+    InstAccesses.find(I);
+  if (It == InstAccesses.end())
+    return;
+  MemoryUseOrDef *MA = It->second;
+  InstAccesses.erase(It);
+
+  // Everything that saw the state defined by a removed def now sees the state
+  // it was defined from.
+  MemoryAccess *Def = MA->getDefiningAccess();
+  while (!MA->user_empty()) {
+    MemoryAccess *User = MA->Users.back();
+    if (MemoryUseOrDef *UD = dyn_cast<MemoryUseOrDef>(User)) {
+      UD->setDefiningAccess(Def);
+      continue;
+    }
+    MemoryPhi *Phi = cast<MemoryPhi>(User);
+    for (unsigned i = 0, e = Phi->getNumIncomingValues(); i != e; ++i)
+      if (Phi->getIncomingValue(i) == MA)
+        Phi->setIncomingValue(i, Def);
+  }
+
+  MA->setDefiningAccess(0);
+  delete MA;
+}
+
+MemoryUse *MemorySSA::createMemoryUse(Instruction *I) {
+  assert(!I->mayWriteToMemory() && I->mayReadFromMemory() &&
+         "Only instructions that just read memory can be added!");
+  assert(getMemoryAccess(I) == 0 && "Instruction already has an access!");
+
+  BasicBlock *BB = I->getParent();
+  MemoryAccess *Def = 0;
+  for (BasicBlock::iterator It = I; It != BB->begin(); ) {
+    MemoryUseOrDef *MA = getMemoryAccess(--It);
+    if (MA && isa<MemoryDef>(MA)) {
+      Def = MA;
+      break;
+    }
+  }
+  if (Def == 0)
+    Def = getReachingDefAtEntry(BB);
+
+  MemoryUse *MU = new MemoryUse(I, BB);
+  MU->setDefiningAccess(Def);
+  InstAccesses[I] = MU;
+  return MU;
+}
+
+void MemorySSA::splitEdge(BasicBlock *From, BasicBlock *To,
+                          BasicBlock *NewBB) {
+  // NewBB has no accesses of its own; only a phi in To needs to learn that
+  // the state from From now arrives through NewBB.
+  MemoryPhi *Phi = getMemoryAccess(To);
+  if (Phi == 0)
+    return;
+
+  for (unsigned i = 0, e = Phi->getNumIncomingValues(); i != e; ++i) {
+    if (Phi->getIncomingBlock(i) != From)
+      continue;
+
+    // If only some of the edges from From were split, From stays a
+    // predecessor and NewBB is a new one.
+    TerminatorInst *TI = From->getTerminator();
+    bool StillPred = false;
+    for (unsigned s = 0, se = TI->getNumSuccessors(); s != se; ++s)
+      if (TI->getSuccessor(s) == To)
+        StillPred = true;
+
+    if (StillPred)
+      Phi->addIncoming(Phi->getIncomingValue(i), NewBB);
+    else
+      Phi->Incoming[i].second = NewBB;
+    return;
+  }
+}
+
+void MemorySSA::mergeBlockIntoPredecessor(BasicBlock *BB, BasicBlock *PredBB) {
+  assert(getMemoryAccess(BB) == 0 && "Block with one predecessor has a phi?");
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+    if (MemoryUseOrDef *MA = getMemoryAccess(I))
+      MA->Block = PredBB;
+
+  // The memory state at the end of BB now flows out of PredBB.
+  TerminatorInst *TI = BB->getTerminator();
+  for (unsigned s = 0, se = TI->getNumSuccessors(); s != se; ++s)
+    if (MemoryPhi *Phi = getMemoryAccess(TI->getSuccessor(s)))
+      for (unsigned i = 0, e = Phi->getNumIncomingValues(); i != e; ++i)
+        if (Phi->getIncomingBlock(i) == BB)
+          Phi->Incoming[i].second = PredBB;
+}
+
+void MemorySSA::print(raw_ostream &OS, const Module *) const {
+  for (Function::const_iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
+    WriteAsOperand(OS, BB, false);
+    OS << ":\n";
+    if (MemoryPhi *Phi = getMemoryAccess(BB)) {
+      OS << "; ";
+      Phi->print(OS);
+      OS << '\n';
+    }
+    for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end();
+         I != IE; ++I) {
+      if (MemoryUseOrDef *MA = getMemoryAccess(I)) {
+        OS << "; ";
+        MA->print(OS);
+        OS << '\n';
+      }
+      OS << *I << '\n';
+    }
+  }
+}
+
+/// verifyAnalysis - Check that every access is linked to the state that
+/// reaches it, as a fresh build would have done.
+void MemorySSA::verifyAnalysis() const {
+  if (!VerifyMemorySSA) return;
+
+  bool Broken = false;
+  for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
+    MemoryAccess *Expected = getReachingDefAtEntry(BB);
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+      MemoryUseOrDef *MA = getMemoryAccess(I);
+      if (MA == 0) {
+        if (I->mayReadFromMemory() || I->mayWriteToMemory()) {
+          errs() << "Memory SSA has no access for: " << *I << '\n';
+          Broken = true;
+        }
+        continue;
+      }
+      if (MA->getDefiningAccess() != Expected) {
+        errs() << "Memory SSA access has the wrong defining access: "
+               << *I << '\n';
+        Broken = true;
+      }
+      if (isa<MemoryDef>(MA))
+        Expected = MA;
+    }
+
+    if (MemoryPhi *Phi = getMemoryAccess(BB))
+      for (unsigned i = 0, e = Phi->getNumIncomingValues(); i != e; ++i)
+        if (Phi->getIncomingValue(i) !=
+            getReachingDefAtEnd(Phi->getIncomingBlock(i))) {
+          errs() << "Memory SSA phi in '" << BB->getName()
+                 << "' has the wrong incoming value for '"
+                 << Phi->getIncomingBlock(i)->getName() << "'\n";
+          Broken = true;
+        }
+  }
+
+  if (Broken) {
+    errs() << "Memory SSA is not up to date!\n";
+    print(errs(), 0);
+    abort();
+  }
+}
@@ -44,6 +44,8 @@ namespace {
       if (execcount == 0) ExecCount = LoopWeight;
     }
 
+    Pass *createClone() const { return new ProfileEstimatorPass(ExecCount); }
+
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.setPreservesAll();
       AU.addRequired<LoopInfo>();
@@ -68,6 +68,10 @@ namespace llvm {
       initializeProfileVerifierPassPass(*PassRegistry::getPassRegistry());
     }
 
+    Pass *createClone() const {
+      return new ProfileVerifierPassT(DisableAssertions);
+    }
+
     void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.setPreservesAll();
       AU.addRequired<ProfileInfoT<FType, BType> >();
@@ -143,8 +143,9 @@ bool ArchiveMember::replaceWith(const sys::Path& newFile, std::string* ErrMsg) {
 // Archive class. Everything else (default,copy) is deprecated. This just
 // initializes and maps the file into memory, if requested.
 Archive::Archive(const sys::Path& filename, LLVMContext& C)
-  : archPath(filename), members(), mapfile(0), base(0), symTab(), strtab(),
-    symTabSize(0), firstFileOffset(0), modules(), foreignST(0), Context(C) {
+  : archPath(filename), members(), mapfile(0), base(0), symTab(), symIndex(0),
+    strtab(), symTabSize(0), firstFileOffset(0), modules(), foreignST(0),
+    Context(C) {
 }
 
 bool
@@ -168,6 +169,7 @@ void Archive::cleanUpMemory() {
 
   // Forget the entire symbol table
   symTab.clear();
+  symIndex = 0;
   symTabSize = 0;
 
   firstFileOffset = 0;
@@ -15,6 +15,7 @@
 #define LIB_ARCHIVE_ARCHIVEINTERNALS_H
 
 #include "llvm/Bitcode/Archive.h"
+#include "llvm/Support/DataTypes.h"
 #include "llvm/Support/TimeValue.h"
 #include "llvm/ADT/StringExtras.h"
 
@@ -28,6 +29,8 @@
 #define ARFILE_STRTAB_NAME      "//              " ///< Name of string table
 #define ARFILE_PAD "\n"                            ///< inter-file align padding
 #define ARFILE_MEMBER_MAGIC "`\n"                  ///< fmag field magic #
+#define ARFILE_SYMIDX_MAGIC "\377LSYMIDX"           ///< LLVM symtab index magic
+#define ARFILE_SYMIDX_MAGIC_LEN (sizeof(ARFILE_SYMIDX_MAGIC)-1)
 
 namespace llvm {
 
@@ -71,6 +74,30 @@ namespace llvm {
     }
   };
   
+  /// The LLVM symbol table is written as a hash table that is searched in
+  /// place in the mapped archive, without being read into memory first. It
+  /// consists of ARFILE_SYMIDX_MAGIC, the number of buckets (a power of two)
+  /// and the number of symbols, followed by the buckets and then the symbol
+  /// names. Each bucket holds the hash of a symbol's name, the offset of the
+  /// name from the end of the buckets, the length of the name and the offset
+  /// of the member defining it (as in Archive::SymTabType). All integers are
+  /// 32-bit little endian. A symbol goes in the first free bucket at or after
+  /// its hash modulo the number of buckets; free buckets have a zero length.
+  enum {
+    ArchiveSymbolIndexHeaderSize = ARFILE_SYMIDX_MAGIC_LEN + 8,
+    ArchiveSymbolIndexEntrySize = 16
+  };
+
+  /// @brief Hash a symbol name for the LLVM symbol table (FNV-1a).
+  static inline uint32_t HashArchiveSymbol(StringRef Name) {
+    uint32_t Result = 2166136261U;
+    for (unsigned i = 0, e = Name.size(); i != e; ++i) {
+      Result ^= (unsigned char)Name[i];
+      Result *= 16777619U;
+    }
+    return Result;
+  }
+
   // Get just the externally visible defined symbols from the bitcode
   bool GetBitcodeSymbols(const sys::Path& fName,
                           LLVMContext& Context,
@@ -13,6 +13,7 @@
 
 #include "ArchiveInternals.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Module.h"
 #include <cstdlib>
@@ -33,11 +34,38 @@ static inline unsigned readInteger(const char*&At, const char*End) {
   return Result;
 }
 
-// Completely parse the Archive's symbol table and populate symTab member var.
+/// Read the 32-bit little endian field at \p Field of the symbol index.
+static inline uint32_t readIndexField(const char* Field) {
+  return support::endian::read_le<uint32_t, support::unaligned>(Field);
+}
+
+// Parse the Archive's symbol table. An indexed symbol table is only checked
+// and used in place; an old-style table is read into symTab.
 bool
 Archive::parseSymbolTable(const void* data, unsigned size, std::string* error) {
   const char* At = (const char*) data;
   const char* End = At + size;
+
+  if (size >= ArchiveSymbolIndexHeaderSize &&
+      0 == memcmp(At, ARFILE_SYMIDX_MAGIC, ARFILE_SYMIDX_MAGIC_LEN)) {
+    const char* Header = At + ARFILE_SYMIDX_MAGIC_LEN;
+    uint32_t NumBuckets = readIndexField(Header);
+    uint32_t NumSymbols = readIndexField(Header + 4);
+    uint64_t NamesStart = ArchiveSymbolIndexHeaderSize +
+                          uint64_t(NumBuckets) * ArchiveSymbolIndexEntrySize;
+    if (NumBuckets == 0 || (NumBuckets & (NumBuckets - 1)) != 0 ||
+        NumSymbols >= NumBuckets || NamesStart > size) {
+      if (error)
+        *error = "Malformed symbol table index";
+      return false;
+    }
+    // An empty index is no different from having no symbol table.
+    if (NumSymbols != 0)
+      symIndex = At;
+    symTabSize = size;
+    return true;
+  }
+
   while (At < End) {
     unsigned offset = readInteger(At, End);
     if (At == End) {
@@ -64,6 +92,63 @@ Archive::parseSymbolTable(const void* data, unsigned size, std::string* error) {
   return true;
 }
 
+bool Archive::findSymbolOffset(StringRef symbol, unsigned& offset) {
+  if (!symIndex) {
+    SymTabType::iterator SI = symTab.find(symbol);
+    if (SI == symTab.end())
+      return false;
+    offset = SI->second;
+    return true;
+  }
+
+  uint32_t NumBuckets = readIndexField(symIndex + ARFILE_SYMIDX_MAGIC_LEN);
+  const char* Buckets = symIndex + ArchiveSymbolIndexHeaderSize;
+  const char* Names = Buckets + NumBuckets * ArchiveSymbolIndexEntrySize;
+  const char* End = symIndex + symTabSize;
+
+  // The table is never full, so there is always a free bucket to stop at.
+  uint32_t Hash = HashArchiveSymbol(symbol);
+  for (uint32_t Bucket = Hash & (NumBuckets - 1), Probes = 0;
+       Probes != NumBuckets; Bucket = (Bucket + 1) & (NumBuckets - 1),
+       ++Probes) {
+    const char* Entry = Buckets + Bucket * ArchiveSymbolIndexEntrySize;
+    uint32_t NameLength = readIndexField(Entry + 8);
+    if (NameLength == 0)
+      return false;
+    if (readIndexField(Entry) != Hash || NameLength != symbol.size())
+      continue;
+    uint32_t NameOffset = readIndexField(Entry + 4);
+    if (uint64_t(NameOffset) + NameLength > uint64_t(End - Names))
+      return false;
+    if (StringRef(Names + NameOffset, NameLength) == symbol) {
+      offset = readIndexField(Entry + 12);
+      return true;
+    }
+  }
+  return false;
+}
+
+const Archive::SymTabType& Archive::getSymbolTable() {
+  if (!symIndex || !symTab.empty())
+    return symTab;
+
+  uint32_t NumBuckets = readIndexField(symIndex + ARFILE_SYMIDX_MAGIC_LEN);
+  const char* Buckets = symIndex + ArchiveSymbolIndexHeaderSize;
+  const char* Names = Buckets + NumBuckets * ArchiveSymbolIndexEntrySize;
+  const char* End = symIndex + symTabSize;
+  for (uint32_t i = 0; i != NumBuckets; ++i) {
+    const char* Entry = Buckets + i * ArchiveSymbolIndexEntrySize;
+    uint32_t NameLength = readIndexField(Entry + 8);
+    uint32_t NameOffset = readIndexField(Entry + 4);
+    if (NameLength == 0 ||
+        uint64_t(NameOffset) + NameLength > uint64_t(End - Names))
+      continue;
+    symTab.insert(std::make_pair(std::string(Names + NameOffset, NameLength),
+                                 readIndexField(Entry + 12)));
+  }
+  return symTab;
+}
+
 // This member parses an ArchiveMemberHeader that is presumed to be pointed to
 // by At. The At pointer is updated to the byte just after the header, which
 // can be variable in size.
@@ -255,6 +340,7 @@ Archive::loadArchive(std::string* error) {
   // Set up parsing
   members.clear();
   symTab.clear();
+  symIndex = 0;
   const char *At = base;
   const char *End = mapfile->getBufferEnd();
 
@@ -369,6 +455,7 @@ Archive::loadSymbolTable(std::string* ErrorMsg) {
   // Set up parsing
   members.clear();
   symTab.clear();
+  symIndex = 0;
   const char *At = base;
   const char *End = mapfile->getBufferEnd();
 
@@ -458,8 +545,8 @@ Archive* Archive::OpenAndLoadSymbols(const sys::Path& file,
 Module*
 Archive::findModuleDefiningSymbol(const std::string& symbol, 
                                   std::string* ErrMsg) {
-  SymTabType::iterator SI = symTab.find(symbol);
-  if (SI == symTab.end())
+  unsigned symOffset;
+  if (!findSymbolOffset(symbol, symOffset))
     return 0;
 
   // The symbol table was previously constructed assuming that the members were
@@ -469,7 +556,7 @@ Archive::findModuleDefiningSymbol(const std::string& symbol,
   // We now have to account for this by adjusting the offset by the size of the
   // symbol table and its header.
   unsigned fileOffset =
-    SI->second +                // offset in symbol-table-less file
+    symOffset +                 // offset in symbol-table-less file
     firstFileOffset;            // add offset to first "real" file in archive
 
   // See if the module is already loaded
@@ -512,7 +599,7 @@ Archive::findModulesDefiningSymbols(std::set<std::string>& symbols,
     return false;
   }
 
-  if (symTab.empty()) {
+  if (!hasSymbolTable()) {
     // We don't have a symbol table, so we must build it now but lets also
     // make sure that we populate the modules table as we do this to ensure
     // that we don't load them twice when findModuleDefiningSymbol is called
@@ -591,13 +678,13 @@ Archive::findModulesDefiningSymbols(std::set<std::string>& symbols,
 bool Archive::isBitcodeArchive() {
   // Make sure the symTab has been loaded. In most cases this should have been
   // done when the archive was constructed, but still,  this is just in case.
-  if (symTab.empty())
+  if (!hasSymbolTable())
     if (!loadSymbolTable(0))
       return false;
 
   // Now that we know it's been loaded, return true
   // if it has a size
-  if (symTab.size()) return true;
+  if (hasSymbolTable()) return true;
 
   // We still can't be sure it isn't a bitcode archive
   if (!loadArchive(0))
@@ -15,6 +15,7 @@
 #include "llvm/Module.h"
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Process.h"
@@ -25,44 +26,10 @@
 #include <iomanip>
 using namespace llvm;
 
-// Write an integer using variable bit rate encoding. This saves a few bytes
-// per entry in the symbol table.
-static inline void writeInteger(unsigned num, std::ofstream& ARFile) {
-  while (1) {
-    if (num < 0x80) { // done?
-      ARFile << (unsigned char)num;
-      return;
-    }
-
-    // Nope, we are bigger than a character, output the next 7 bits and set the
-    // high bit to say that there is more coming...
-    ARFile << (unsigned char)(0x80 | ((unsigned char)num & 0x7F));
-    num >>= 7;  // Shift out 7 bits now...
-  }
-}
-
-// Compute how many bytes are taken by a given VBR encoded value. This is needed
-// to pre-compute the size of the symbol table.
-static inline unsigned numVbrBytes(unsigned num) {
-
-  // Note that the following nested ifs are somewhat equivalent to a binary
-  // search. We split it in half by comparing against 2^14 first. This allows
-  // most reasonable values to be done in 2 comparisons instead of 1 for
-  // small ones and four for large ones. We expect this to access file offsets
-  // in the 2^10 to 2^24 range and symbol lengths in the 2^0 to 2^8 range,
-  // so this approach is reasonable.
-  if (num < 1<<14) {
-    if (num < 1<<7)
-      return 1;
-    else
-      return 2;
-  }
-  if (num < 1<<21)
-    return 3;
-
-  if (num < 1<<28)
-    return 4;
-  return 5; // anything >= 2^28 takes 5 bytes
+// Append the 32-bit little endian value to the symbol index being built.
+static inline void writeIndexField(std::vector<char>& Index, unsigned Pos,
+                                   uint32_t Value) {
+  support::endian::write_le<uint32_t, support::unaligned>(&Index[Pos], Value);
 }
 
 // Create an empty archive.
@@ -242,14 +209,7 @@ Archive::writeMember(
       for (std::vector<std::string>::iterator SI = symbols.begin(),
            SE = symbols.end(); SI != SE; ++SI) {
 
-        std::pair<SymTabType::iterator,bool> Res =
-          symTab.insert(std::make_pair(*SI,filepos));
-
-        if (Res.second) {
-          symTabSize += SI->length() +
-                        numVbrBytes(SI->length()) +
-                        numVbrBytes(filepos);
-        }
+        symTab.insert(std::make_pair(*SI,filepos));
       }
       // We don't need this module any more.
       delete M;
@@ -289,10 +249,49 @@ Archive::writeMember(
   return false;
 }
 
-// Write out the LLVM symbol table as an archive member to the file.
+// Write out the LLVM symbol table as an archive member to the file. The table
+// is written as a hashed index (see ArchiveInternals.h) so that readers can
+// search it without parsing it first.
 void
 Archive::writeSymbolTable(std::ofstream& ARFile) {
 
+  // Size the table so that it's at most half full.
+  uint32_t NumBuckets = 1;
+  while (NumBuckets < 2 * symTab.size())
+    NumBuckets <<= 1;
+  unsigned NamesStart = ArchiveSymbolIndexHeaderSize +
+                        NumBuckets * ArchiveSymbolIndexEntrySize;
+  unsigned NamesSize = 0;
+  for (SymTabType::iterator I = symTab.begin(), E = symTab.end(); I != E; ++I)
+    NamesSize += I->first.length();
+  symTabSize = NamesStart + NamesSize;
+
+  std::vector<char> Index(symTabSize, 0);
+  memcpy(&Index[0], ARFILE_SYMIDX_MAGIC, ARFILE_SYMIDX_MAGIC_LEN);
+  writeIndexField(Index, ARFILE_SYMIDX_MAGIC_LEN, NumBuckets);
+  writeIndexField(Index, ARFILE_SYMIDX_MAGIC_LEN + 4, symTab.size());
+
+  unsigned NameOffset = 0;
+  for (SymTabType::iterator I = symTab.begin(), E = symTab.end(); I != E; ++I) {
+    uint32_t Hash = HashArchiveSymbol(I->first);
+    uint32_t Bucket = Hash & (NumBuckets - 1);
+    unsigned Pos;
+    while (true) {
+      Pos = ArchiveSymbolIndexHeaderSize + Bucket * ArchiveSymbolIndexEntrySize;
+      if (support::endian::read_le<uint32_t, support::unaligned>(
+            &Index[Pos + 8]) == 0)
+        break;
+      Bucket = (Bucket + 1) & (NumBuckets - 1);
+    }
+    writeIndexField(Index, Pos, Hash);
+    writeIndexField(Index, Pos + 4, NameOffset);
+    writeIndexField(Index, Pos + 8, I->first.length());
+    writeIndexField(Index, Pos + 12, I->second);
+    memcpy(&Index[NamesStart + NameOffset], I->first.data(),
+           I->first.length());
+    NameOffset += I->first.length();
+  }
+
   // Construct the symbol table's header
   ArchiveMemberHeader Hdr;
   Hdr.init();
@@ -310,34 +309,9 @@ Archive::writeSymbolTable(std::ofstream& ARFile) {
   sprintf(buffer,"%-10u",symTabSize);
   memcpy(Hdr.size,buffer,10);
 
-  // Write the header
+  // Write the header and the table
   ARFile.write((char*)&Hdr, sizeof(Hdr));
-
-#ifndef NDEBUG
-  // Save the starting position of the symbol tables data content.
-  unsigned startpos = ARFile.tellp();
-#endif
-
-  // Write out the symbols sequentially
-  for ( Archive::SymTabType::iterator I = symTab.begin(), E = symTab.end();
-        I != E; ++I)
-  {
-    // Write out the file index
-    writeInteger(I->second, ARFile);
-    // Write out the length of the symbol
-    writeInteger(I->first.length(), ARFile);
-    // Write out the symbol
-    ARFile.write(I->first.data(), I->first.length());
-  }
-
-#ifndef NDEBUG
-  // Now that we're done with the symbol table, get the ending file position
-  unsigned endpos = ARFile.tellp();
-#endif
-
-  // Make sure that the amount we wrote is what we pre-computed. This is
-  // critical for file integrity purposes.
-  assert(endpos - startpos == symTabSize && "Invalid symTabSize computation");
+  ARFile.write(&Index[0], symTabSize);
 
   // Make sure the symbol table is even sized
   if (symTabSize % 2 != 0 )
@@ -137,11 +137,8 @@ void LLLexer::FP80HexToIntPair(const char *Buffer, const char *End,
 }
 
 // UnEscapeLexed - Run through the specified buffer and change \xx codes to the
-// appropriate character.
-static void UnEscapeLexed(std::string &Str) {
-  if (Str.empty()) return;
-
-  char *Buffer = &Str[0], *EndBuffer = Buffer+Str.size();
+// appropriate character.  Returns the new end of the buffer.
+static char *UnEscapeLexed(char *Buffer, char *EndBuffer) {
   char *BOut = Buffer;
   for (char *BIn = Buffer; BIn != EndBuffer; ) {
     if (BIn[0] == '\\') {
@@ -161,7 +158,7 @@ static void UnEscapeLexed(std::string &Str) {
       *BOut++ = *BIn++;
     }
   }
-  Str.resize(BOut-Buffer);
+  return BOut;
 }
 
 /// isLabelChar - Return true for [-a-zA-Z$._0-9].
@@ -191,6 +188,22 @@ LLLexer::LLLexer(MemoryBuffer *StartBuf, SourceMgr &sm, SMDiagnostic &Err,
   CurPtr = CurBuf->getBufferStart();
 }
 
+/// setEscapedStrVal - Set StrVal to the quoted text [Start, End), undoing any
+/// \xx escapes in it.  Text without escapes is referenced in place.
+void LLLexer::setEscapedStrVal(const char *Start, const char *End) {
+  size_t Len = End-Start;
+  if (!memchr(Start, '\\', Len)) {
+    setStrVal(Start, End);
+    return;
+  }
+
+  // UnEscapeLexed peeks one character past an escape, so leave room for it.
+  char *Buf = StrAlloc.Allocate<char>(Len+1);
+  memcpy(Buf, Start, Len);
+  Buf[Len] = 0;
+  StrVal = StringRef(Buf, UnEscapeLexed(Buf, Buf+Len) - Buf);
+}
+
 std::string LLLexer::getFilename() const {
   return CurBuf->getBufferIdentifier();
 }
@@ -238,7 +251,7 @@ lltok::Kind LLLexer::LexToken() {
   case '.':
     if (const char *Ptr = isLabelTail(CurPtr)) {
       CurPtr = Ptr;
-      StrVal.assign(TokStart, CurPtr-1);
+      setStrVal(TokStart, CurPtr-1);
       return lltok::LabelStr;
     }
     if (CurPtr[0] == '.' && CurPtr[1] == '.') {
@@ -249,7 +262,7 @@ lltok::Kind LLLexer::LexToken() {
   case '$':
     if (const char *Ptr = isLabelTail(CurPtr)) {
       CurPtr = Ptr;
-      StrVal.assign(TokStart, CurPtr-1);
+      setStrVal(TokStart, CurPtr-1);
       return lltok::LabelStr;
     }
     return lltok::Error;
@@ -300,8 +313,7 @@ lltok::Kind LLLexer::LexAt() {
         return lltok::Error;
       }
       if (CurChar == '"') {
-        StrVal.assign(TokStart+2, CurPtr-1);
-        UnEscapeLexed(StrVal);
+        setEscapedStrVal(TokStart+2, CurPtr-1);
         return lltok::GlobalVar;
       }
     }
@@ -315,7 +327,7 @@ lltok::Kind LLLexer::LexAt() {
            CurPtr[0] == '.' || CurPtr[0] == '_')
       ++CurPtr;
 
-    StrVal.assign(TokStart+1, CurPtr);   // Skip @
+    setStrVal(TokStart+1, CurPtr);   // Skip @
     return lltok::GlobalVar;
   }
 
@@ -352,8 +364,7 @@ lltok::Kind LLLexer::LexPercent() {
         return lltok::Error;
       }
       if (CurChar == '"') {
-        StrVal.assign(TokStart+2, CurPtr-1);
-        UnEscapeLexed(StrVal);
+        setEscapedStrVal(TokStart+2, CurPtr-1);
         return lltok::LocalVar;
       }
     }
@@ -367,7 +378,7 @@ lltok::Kind LLLexer::LexPercent() {
            CurPtr[0] == '.' || CurPtr[0] == '_')
       ++CurPtr;
 
-    StrVal.assign(TokStart+1, CurPtr);   // Skip %
+    setStrVal(TokStart+1, CurPtr);   // Skip %
     return lltok::LocalVar;
   }
 
@@ -401,14 +412,12 @@ lltok::Kind LLLexer::LexQuote() {
     if (CurChar != '"') continue;
 
     if (CurPtr[0] != ':') {
-      StrVal.assign(TokStart+1, CurPtr-1);
-      UnEscapeLexed(StrVal);
+      setEscapedStrVal(TokStart+1, CurPtr-1);
       return lltok::StringConstant;
     }
 
     ++CurPtr;
-    StrVal.assign(TokStart+1, CurPtr-2);
-    UnEscapeLexed(StrVal);
+    setEscapedStrVal(TokStart+1, CurPtr-2);
     return lltok::LabelStr;
   }
 }
@@ -435,7 +444,7 @@ lltok::Kind LLLexer::LexExclaim() {
            CurPtr[0] == '.' || CurPtr[0] == '_')
       ++CurPtr;
 
-    StrVal.assign(TokStart+1, CurPtr);   // Skip !
+    setStrVal(TokStart+1, CurPtr);   // Skip !
     return lltok::MetadataVar;
   }
   return lltok::exclaim;
@@ -459,7 +468,7 @@ lltok::Kind LLLexer::LexIdentifier() {
 
   // If we stopped due to a colon, this really is a label.
   if (*CurPtr == ':') {
-    StrVal.assign(StartChar-1, CurPtr++);
+    setStrVal(StartChar-1, CurPtr++);
     return lltok::LabelStr;
   }
 
@@ -778,7 +787,7 @@ lltok::Kind LLLexer::LexDigitOrNegative() {
   if (!isdigit(TokStart[0]) && !isdigit(CurPtr[0])) {
     // Okay, this is not a number after the -, it's probably a label.
     if (const char *End = isLabelTail(CurPtr)) {
-      StrVal.assign(TokStart, End-1);
+      setStrVal(TokStart, End-1);
       CurPtr = End;
       return lltok::LabelStr;
     }
@@ -795,7 +804,7 @@ lltok::Kind LLLexer::LexDigitOrNegative() {
   // Check to see if this really is a label afterall, e.g. "-1:".
   if (isLabelChar(CurPtr[0]) || CurPtr[0] == ':') {
     if (const char *End = isLabelTail(CurPtr)) {
-      StrVal.assign(TokStart, End-1);
+      setStrVal(TokStart, End-1);
       CurPtr = End;
       return lltok::LabelStr;
     }
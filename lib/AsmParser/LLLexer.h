@@ -17,6 +17,8 @@
 #include "LLToken.h"
 #include "llvm/ADT/APSInt.h"
 #include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/SourceMgr.h"
 #include <string>
 
@@ -36,12 +38,16 @@ namespace llvm {
     // Information about the current token.
     const char *TokStart;
     lltok::Kind CurKind;
-    std::string StrVal;
+    StringRef StrVal;
     unsigned UIntVal;
     const Type *TyVal;
     APFloat APFloatVal;
     APSInt  APSIntVal;
 
+    /// StrAlloc - Holds the unescaped copies of quoted names and strings that
+    /// contain escapes.  All other StrVals point straight into CurBuf.
+    BumpPtrAllocator StrAlloc;
+
     std::string TheError;
   public:
     explicit LLLexer(MemoryBuffer *StartBuf, SourceMgr &SM, SMDiagnostic &,
@@ -55,7 +61,10 @@ namespace llvm {
     typedef SMLoc LocTy;
     LocTy getLoc() const { return SMLoc::getFromPointer(TokStart); }
     lltok::Kind getKind() const { return CurKind; }
-    const std::string &getStrVal() const { return StrVal; }
+    /// getStrVal - Return the name or string of the current token.  It points
+    /// into the buffer being lexed or into memory owned by the lexer, so it
+    /// stays valid until the lexer is destroyed, not just until the next Lex.
+    StringRef getStrVal() const { return StrVal; }
     const Type *getTyVal() const { return TyVal; }
     unsigned getUIntVal() const { return UIntVal; }
     const APSInt &getAPSIntVal() const { return APSIntVal; }
@@ -80,6 +89,11 @@ namespace llvm {
     lltok::Kind LexQuote();
     lltok::Kind Lex0x();
 
+    void setStrVal(const char *Start, const char *End) {
+      StrVal = StringRef(Start, End-Start);
+    }
+    void setEscapedStrVal(const char *Start, const char *End);
+
     uint64_t atoull(const char *Buffer, const char *End);
     uint64_t HexIntToVal(const char *Buffer, const char *End);
     void HexToIntPair(const char *Buffer, const char *End, uint64_t Pair[2]);
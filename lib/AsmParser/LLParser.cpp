@@ -26,6 +26,20 @@
 #include "llvm/Support/raw_ostream.h"
 using namespace llvm;
 
+/// getFirstForwardRef - Return the entry of a forward reference table with
+/// the smallest name.  The table is hashed, so this keeps the "use of
+/// undefined" diagnostics independent of its iteration order.
+template <typename ValueTy>
+static typename StringMap<ValueTy>::iterator
+getFirstForwardRef(StringMap<ValueTy> &Refs) {
+  typename StringMap<ValueTy>::iterator First = Refs.begin();
+  for (typename StringMap<ValueTy>::iterator I = First, E = Refs.end();
+       I != E; ++I)
+    if (I->getKey() < First->getKey())
+      First = I;
+  return First;
+}
+
 /// Run: module ::= toplevelentity*
 bool LLParser::Run() {
   // Prime the lexer.
@@ -101,19 +115,23 @@ bool LLParser::ValidateEndOfModule() {
   }
   
   
-  if (!ForwardRefTypes.empty())
-    return Error(ForwardRefTypes.begin()->second.second,
-                 "use of undefined type named '" +
-                 ForwardRefTypes.begin()->first + "'");
+  if (!ForwardRefTypes.empty()) {
+    StringMap<std::pair<PATypeHolder, LocTy> >::iterator
+      I = getFirstForwardRef(ForwardRefTypes);
+    return Error(I->second.second,
+                 "use of undefined type named '" + I->getKey() + "'");
+  }
   if (!ForwardRefTypeIDs.empty())
     return Error(ForwardRefTypeIDs.begin()->second.second,
                  "use of undefined type '%" +
                  Twine(ForwardRefTypeIDs.begin()->first) + "'");
 
-  if (!ForwardRefVals.empty())
-    return Error(ForwardRefVals.begin()->second.second,
-                 "use of undefined value '@" + ForwardRefVals.begin()->first +
-                 "'");
+  if (!ForwardRefVals.empty()) {
+    StringMap<std::pair<GlobalValue*, LocTy> >::iterator
+      I = getFirstForwardRef(ForwardRefVals);
+    return Error(I->second.second,
+                 "use of undefined value '@" + I->getKey() + "'");
+  }
 
   if (!ForwardRefValIDs.empty())
     return Error(ForwardRefValIDs.begin()->second.second,
@@ -245,7 +263,7 @@ bool LLParser::ParseModuleAsm() {
   assert(Lex.getKind() == lltok::kw_module);
   Lex.Lex();
 
-  std::string AsmStr;
+  StringRef AsmStr;
   if (ParseToken(lltok::kw_asm, "expected 'module asm'") ||
       ParseStringConstant(AsmStr)) return true;
 
@@ -258,7 +276,7 @@ bool LLParser::ParseModuleAsm() {
 ///   ::= 'target' 'datalayout' '=' STRINGCONSTANT
 bool LLParser::ParseTargetDefinition() {
   assert(Lex.getKind() == lltok::kw_target);
-  std::string Str;
+  StringRef Str;
   switch (Lex.Lex()) {
   default: return TokError("unknown target property");
   case lltok::kw_triple:
@@ -291,7 +309,7 @@ bool LLParser::ParseDepLibs() {
   if (EatIfPresent(lltok::rsquare))
     return false;
 
-  std::string Str;
+  StringRef Str;
   if (ParseStringConstant(Str)) return true;
   M->addLibrary(Str);
 
@@ -346,7 +364,7 @@ bool LLParser::ParseUnnamedType() {
 /// toplevelentity
 ///   ::= LocalVar '=' 'type' type
 bool LLParser::ParseNamedType() {
-  std::string Name = Lex.getStrVal();
+  StringRef Name = Lex.getStrVal();
   LocTy NameLoc = Lex.getLoc();
   Lex.Lex();  // eat LocalVar.
 
@@ -363,7 +381,7 @@ bool LLParser::ParseNamedType() {
 
   // See if this type is a forward reference.  We need to eagerly resolve
   // types to allow recursive type redefinitions below.
-  std::map<std::string, std::pair<PATypeHolder, LocTy> >::iterator
+  StringMap<std::pair<PATypeHolder, LocTy> >::iterator
   FI = ForwardRefTypes.find(Name);
   if (FI != ForwardRefTypes.end()) {
     if (FI->second.first.get() == Ty)
@@ -433,7 +451,7 @@ bool LLParser::ParseGlobalType(bool &IsConstant) {
 ///   GlobalID '=' OptionalLinkage OptionalVisibility ...   -> global variable
 bool LLParser::ParseUnnamedGlobal() {
   unsigned VarID = NumberedVals.size();
-  std::string Name;
+  StringRef Name;
   LocTy NameLoc = Lex.getLoc();
 
   // Handle the GlobalID form.
@@ -464,7 +482,7 @@ bool LLParser::ParseUnnamedGlobal() {
 bool LLParser::ParseNamedGlobal() {
   assert(Lex.getKind() == lltok::GlobalVar);
   LocTy NameLoc = Lex.getLoc();
-  std::string Name = Lex.getStrVal();
+  StringRef Name = Lex.getStrVal();
   Lex.Lex();
 
   bool HasLinkage;
@@ -482,7 +500,7 @@ bool LLParser::ParseNamedGlobal() {
 // MDString:
 //   ::= '!' STRINGCONSTANT
 bool LLParser::ParseMDString(MDString *&Result) {
-  std::string Str;
+  StringRef Str;
   if (ParseStringConstant(Str)) return true;
   Result = MDString::get(Context, Str);
   return false;
@@ -528,7 +546,7 @@ bool LLParser::ParseMDNodeID(MDNode *&Result) {
 ///   !foo = !{ !1, !2 }
 bool LLParser::ParseNamedMetadata() {
   assert(Lex.getKind() == lltok::MetadataVar);
-  std::string Name = Lex.getStrVal();
+  StringRef Name = Lex.getStrVal();
   Lex.Lex();
 
   if (ParseToken(lltok::equal, "expected '=' here") ||
@@ -605,7 +623,7 @@ bool LLParser::ParseStandaloneMetadata() {
 ///
 /// Everything through visibility has already been parsed.
 ///
-bool LLParser::ParseAlias(const std::string &Name, LocTy NameLoc,
+bool LLParser::ParseAlias(StringRef Name, LocTy NameLoc,
                           unsigned Visibility) {
   assert(Lex.getKind() == lltok::kw_alias);
   Lex.Lex();
@@ -652,7 +670,7 @@ bool LLParser::ParseAlias(const std::string &Name, LocTy NameLoc,
   if (GlobalValue *Val = M->getNamedValue(Name)) {
     // See if this was a redefinition.  If so, there is no entry in
     // ForwardRefVals.
-    std::map<std::string, std::pair<GlobalValue*, LocTy> >::iterator
+    StringMap<std::pair<GlobalValue*, LocTy> >::iterator
       I = ForwardRefVals.find(Name);
     if (I == ForwardRefVals.end())
       return Error(NameLoc, "redefinition of global named '@" + Name + "'");
@@ -685,7 +703,7 @@ bool LLParser::ParseAlias(const std::string &Name, LocTy NameLoc,
 ///
 /// Everything through visibility has been parsed already.
 ///
-bool LLParser::ParseGlobal(const std::string &Name, LocTy NameLoc,
+bool LLParser::ParseGlobal(StringRef Name, LocTy NameLoc,
                            unsigned Linkage, bool HasLinkage,
                            unsigned Visibility) {
   unsigned AddrSpace;
@@ -786,7 +804,7 @@ bool LLParser::ParseGlobal(const std::string &Name, LocTy NameLoc,
 /// GetGlobalVal - Get a value with the specified name or ID, creating a
 /// forward reference record if needed.  This can return null if the value
 /// exists but does not have the right type.
-GlobalValue *LLParser::GetGlobalVal(const std::string &Name, const Type *Ty,
+GlobalValue *LLParser::GetGlobalVal(StringRef Name, const Type *Ty,
                                     LocTy Loc) {
   const PointerType *PTy = dyn_cast<PointerType>(Ty);
   if (PTy == 0) {
@@ -801,7 +819,7 @@ GlobalValue *LLParser::GetGlobalVal(const std::string &Name, const Type *Ty,
   // If this is a forward reference for the value, see if we already created a
   // forward ref record.
   if (Val == 0) {
-    std::map<std::string, std::pair<GlobalValue*, LocTy> >::iterator
+    StringMap<std::pair<GlobalValue*, LocTy> >::iterator
       I = ForwardRefVals.find(Name);
     if (I != ForwardRefVals.end())
       Val = I->second.first;
@@ -894,7 +912,7 @@ bool LLParser::ParseToken(lltok::Kind T, const char *ErrMsg) {
 
 /// ParseStringConstant
 ///   ::= StringConstant
-bool LLParser::ParseStringConstant(std::string &Result) {
+bool LLParser::ParseStringConstant(StringRef &Result) {
   if (Lex.getKind() != lltok::StringConstant)
     return TokError("expected string constant");
   Result = Lex.getStrVal();
@@ -1129,8 +1147,8 @@ bool LLParser::ParseInstructionMetadata(Instruction *Inst,
     if (Lex.getKind() != lltok::MetadataVar)
       return TokError("expected metadata after comma");
 
-    std::string Name = Lex.getStrVal();
-    unsigned MDK = M->getMDKindID(Name.c_str());
+    StringRef Name = Lex.getStrVal();
+    unsigned MDK = M->getMDKindID(Name);
     Lex.Lex();
 
     MDNode *Node;
@@ -1387,9 +1405,7 @@ bool LLParser::ParseTypeRec(PATypeHolder &Result) {
       Result = T;
     } else {
       Result = OpaqueType::get(Context);
-      ForwardRefTypes.insert(std::make_pair(Lex.getStrVal(),
-                                            std::make_pair(Result,
-                                                           Lex.getLoc())));
+      ForwardRefTypes[Lex.getStrVal()] = std::make_pair(Result, Lex.getLoc());
       M->addTypeName(Lex.getStrVal(), Result.get());
     }
     Lex.Lex();
@@ -1534,7 +1550,7 @@ bool LLParser::ParseArgumentList(std::vector<ArgInfo> &ArgList,
     LocTy TypeLoc = Lex.getLoc();
     PATypeHolder ArgTy(Type::getVoidTy(Context));
     unsigned Attrs;
-    std::string Name;
+    StringRef Name;
 
     // If we're parsing a type, use ParseTypeRec, because we allow recursive
     // types (such as a function returning a pointer to itself).  If parsing a
@@ -1734,7 +1750,7 @@ LLParser::PerFunctionState::PerFunctionState(LLParser &p, Function &f,
 
 LLParser::PerFunctionState::~PerFunctionState() {
   // If there were any forward referenced non-basicblock values, delete them.
-  for (std::map<std::string, std::pair<Value*, LocTy> >::iterator
+  for (StringMap<std::pair<Value*, LocTy> >::iterator
        I = ForwardRefVals.begin(), E = ForwardRefVals.end(); I != E; ++I)
     if (!isa<BasicBlock>(I->second.first)) {
       I->second.first->replaceAllUsesWith(
@@ -1776,10 +1792,12 @@ bool LLParser::PerFunctionState::FinishFunction() {
     }
   }
   
-  if (!ForwardRefVals.empty())
-    return P.Error(ForwardRefVals.begin()->second.second,
-                   "use of undefined value '%" + ForwardRefVals.begin()->first +
-                   "'");
+  if (!ForwardRefVals.empty()) {
+    StringMap<std::pair<Value*, LocTy> >::iterator
+      I = getFirstForwardRef(ForwardRefVals);
+    return P.Error(I->second.second,
+                   "use of undefined value '%" + I->getKey() + "'");
+  }
   if (!ForwardRefValIDs.empty())
     return P.Error(ForwardRefValIDs.begin()->second.second,
                    "use of undefined value '%" +
@@ -1791,7 +1809,7 @@ bool LLParser::PerFunctionState::FinishFunction() {
 /// GetVal - Get a value with the specified name or ID, creating a
 /// forward reference record if needed.  This can return null if the value
 /// exists but does not have the right type.
-Value *LLParser::PerFunctionState::GetVal(const std::string &Name,
+Value *LLParser::PerFunctionState::GetVal(StringRef Name,
                                           const Type *Ty, LocTy Loc) {
   // Look this name up in the normal function symbol table.
   Value *Val = F.getValueSymbolTable().lookup(Name);
@@ -1799,7 +1817,7 @@ Value *LLParser::PerFunctionState::GetVal(const std::string &Name,
   // If this is a forward reference for the value, see if we already created a
   // forward ref record.
   if (Val == 0) {
-    std::map<std::string, std::pair<Value*, LocTy> >::iterator
+    StringMap<std::pair<Value*, LocTy> >::iterator
       I = ForwardRefVals.find(Name);
     if (I != ForwardRefVals.end())
       Val = I->second.first;
@@ -1877,7 +1895,7 @@ Value *LLParser::PerFunctionState::GetVal(unsigned ID, const Type *Ty,
 /// SetInstName - After an instruction is parsed and inserted into its
 /// basic block, this installs its name.
 bool LLParser::PerFunctionState::SetInstName(int NameID,
-                                             const std::string &NameStr,
+                                             StringRef NameStr,
                                              LocTy NameLoc, Instruction *Inst) {
   // If this instruction has void type, it cannot have a name or ID specified.
   if (Inst->getType()->isVoidTy()) {
@@ -1913,7 +1931,7 @@ bool LLParser::PerFunctionState::SetInstName(int NameID,
   }
 
   // Otherwise, the instruction had a name.  Resolve forward refs and set it.
-  std::map<std::string, std::pair<Value*, LocTy> >::iterator
+  StringMap<std::pair<Value*, LocTy> >::iterator
     FI = ForwardRefVals.find(NameStr);
   if (FI != ForwardRefVals.end()) {
     if (FI->second.first->getType() != Inst->getType())
@@ -1935,7 +1953,7 @@ bool LLParser::PerFunctionState::SetInstName(int NameID,
 
 /// GetBB - Get a basic block with the specified name or ID, creating a
 /// forward reference record if needed.
-BasicBlock *LLParser::PerFunctionState::GetBB(const std::string &Name,
+BasicBlock *LLParser::PerFunctionState::GetBB(StringRef Name,
                                               LocTy Loc) {
   return cast_or_null<BasicBlock>(GetVal(Name,
                                         Type::getLabelTy(F.getContext()), Loc));
@@ -1949,7 +1967,7 @@ BasicBlock *LLParser::PerFunctionState::GetBB(unsigned ID, LocTy Loc) {
 /// DefineBB - Define the specified basic block, which is either named or
 /// unnamed.  If there is an error, this returns null otherwise it returns
 /// the block being defined.
-BasicBlock *LLParser::PerFunctionState::DefineBB(const std::string &Name,
+BasicBlock *LLParser::PerFunctionState::DefineBB(StringRef Name,
                                                  LocTy Loc) {
   BasicBlock *BB;
   if (Name.empty())
@@ -2714,7 +2732,7 @@ bool LLParser::ParseFunctionHeader(Function *&Fn, bool isDefine) {
 
   LocTy NameLoc = Lex.getLoc();
 
-  std::string FunctionName;
+  StringRef FunctionName;
   if (Lex.getKind() == lltok::GlobalVar) {
     FunctionName = Lex.getStrVal();
   } else if (Lex.getKind() == lltok::GlobalID) {     // @42 is ok.
@@ -2735,9 +2753,9 @@ bool LLParser::ParseFunctionHeader(Function *&Fn, bool isDefine) {
   std::vector<ArgInfo> ArgList;
   bool isVarArg;
   unsigned FuncAttrs;
-  std::string Section;
+  StringRef Section;
   unsigned Alignment;
-  std::string GC;
+  StringRef GC;
   bool UnnamedAddr;
   LocTy UnnamedAddrLoc;
 
@@ -2795,7 +2813,7 @@ bool LLParser::ParseFunctionHeader(Function *&Fn, bool isDefine) {
   if (!FunctionName.empty()) {
     // If this was a definition of a forward reference, remove the definition
     // from the forward reference table and fill in the forward ref.
-    std::map<std::string, std::pair<GlobalValue*, LocTy> >::iterator FRVI =
+    StringMap<std::pair<GlobalValue*, LocTy> >::iterator FRVI =
       ForwardRefVals.find(FunctionName);
     if (FRVI != ForwardRefVals.end()) {
       Fn = M->getFunction(FunctionName);
@@ -2853,7 +2871,7 @@ bool LLParser::ParseFunctionHeader(Function *&Fn, bool isDefine) {
   Fn->setUnnamedAddr(UnnamedAddr);
   Fn->setAlignment(Alignment);
   Fn->setSection(Section);
-  if (!GC.empty()) Fn->setGC(GC.c_str());
+  if (!GC.empty()) Fn->setGC(GC.str().c_str());
 
   // Add all of the arguments we parsed to the function.
   Function::arg_iterator ArgIt = Fn->arg_begin();
@@ -2909,7 +2927,7 @@ bool LLParser::ParseFunctionBody(Function &Fn) {
 ///   ::= LabelStr? Instruction*
 bool LLParser::ParseBasicBlock(PerFunctionState &PFS) {
   // If this basic block starts out with a name, remember it.
-  std::string Name;
+  StringRef Name;
   LocTy NameLoc = Lex.getLoc();
   if (Lex.getKind() == lltok::LabelStr) {
     Name = Lex.getStrVal();
@@ -2919,7 +2937,7 @@ bool LLParser::ParseBasicBlock(PerFunctionState &PFS) {
   BasicBlock *BB = PFS.DefineBB(Name, NameLoc);
   if (BB == 0) return true;
 
-  std::string NameStr;
+  StringRef NameStr;
 
   // Parse the instructions in this block until we get a terminator.
   Instruction *Inst;
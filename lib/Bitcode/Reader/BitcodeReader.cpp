@@ -39,6 +39,7 @@ void BitcodeReader::FreeState() {
   std::vector<BasicBlock*>().swap(FunctionBBs);
   std::vector<Function*>().swap(FunctionsWithBodies);
   DeferredFunctionInfo.clear();
+  std::vector<uint64_t>().swap(DeferredMetadataInfo);
   MDKindMap.clear();
 }
 
@@ -1273,6 +1274,17 @@ bool BitcodeReader::RememberAndSkipFunctionBody() {
   return false;
 }
 
+bool BitcodeReader::RememberAndSkipMetadata() {
+  // Save the current stream state.
+  uint64_t CurBit = Stream.GetCurrentBitNo();
+  DeferredMetadataInfo.push_back(CurBit);
+
+  // Skip over the metadata block for now.
+  if (Stream.SkipBlock())
+    return Error("Malformed block record");
+  return false;
+}
+
 bool BitcodeReader::ParseModule() {
   if (Stream.EnterSubBlock(bitc::MODULE_BLOCK_ID))
     return Error("Malformed block record");
@@ -1348,7 +1360,7 @@ bool BitcodeReader::ParseModule() {
           return true;
         break;
       case bitc::METADATA_BLOCK_ID:
-        if (ParseMetadata())
+        if (RememberAndSkipMetadata())
           return true;
         break;
       case bitc::FUNCTION_BLOCK_ID:
@@ -2542,6 +2554,11 @@ bool BitcodeReader::Materialize(GlobalValue *GV, std::string *ErrInfo) {
   // If it's not a function or is already material, ignore the request.
   if (!F || !F->isMaterializable()) return false;
 
+  // Function bodies refer to the module-level metadata by ID, so it has to be
+  // read first.
+  if (MaterializeMetadata(ErrInfo))
+    return true;
+
   DenseMap<Function*, uint64_t>::iterator DFII = DeferredFunctionInfo.find(F);
   assert(DFII != DeferredFunctionInfo.end() && "Deferred function not found!");
 
@@ -2588,9 +2605,26 @@ void BitcodeReader::Dematerialize(GlobalValue *GV) {
 }
 
 
+bool BitcodeReader::MaterializeMetadata(std::string *ErrInfo) {
+  // Parse the deferred blocks in stream order so metadata IDs are assigned
+  // exactly as they would have been by an eager read.
+  for (unsigned i = 0, e = DeferredMetadataInfo.size(); i != e; ++i) {
+    Stream.JumpToBit(DeferredMetadataInfo[i]);
+    if (ParseMetadata()) {
+      if (ErrInfo) *ErrInfo = ErrorString;
+      return true;
+    }
+  }
+  std::vector<uint64_t>().swap(DeferredMetadataInfo);
+  return false;
+}
+
 bool BitcodeReader::MaterializeModule(Module *M, std::string *ErrInfo) {
   assert(M == TheModule &&
          "Can only Materialize the Module this BitcodeReader is attached to.");
+  if (MaterializeMetadata(ErrInfo))
+    return true;
+
   // Iterate over the module, deserializing any functions that are still on
   // disk.
   for (Module::iterator F = TheModule->begin(), E = TheModule->end();
@@ -168,6 +168,13 @@ class BitcodeReader : public GVMaterializer {
   /// map contains info about where to find deferred function body in the
   /// stream.
   DenseMap<Function*, uint64_t> DeferredFunctionInfo;
+
+  /// DeferredMetadataInfo - When module-level metadata blocks are initially
+  /// scanned, this holds their positions in the stream, in order.  They are
+  /// parsed before the first function body is read or when the whole module
+  /// is materialized, so lazy clients that only look at the global values
+  /// (the LTO and archive symbol tables) never pay for debug info.
+  std::vector<uint64_t> DeferredMetadataInfo;
   
   /// BlockAddrFwdRefs - These are blockaddr references to basic blocks.  These
   /// are resolved lazily when functions are loaded.
@@ -202,6 +209,7 @@ public:
   virtual bool Materialize(GlobalValue *GV, std::string *ErrInfo = 0);
   virtual bool MaterializeModule(Module *M, std::string *ErrInfo = 0);
   virtual void Dematerialize(GlobalValue *GV);
+  virtual bool MaterializeMetadata(std::string *ErrInfo = 0);
 
   bool Error(const char *Str) {
     ErrorString = Str;
@@ -270,6 +278,7 @@ private:
   bool ParseValueSymbolTable();
   bool ParseConstants();
   bool RememberAndSkipFunctionBody();
+  bool RememberAndSkipMetadata();
   bool ParseFunctionBody(Function *F);
   bool ResolveGlobalAndAliasInits();
   bool ParseMetadata();
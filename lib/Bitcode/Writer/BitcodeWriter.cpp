@@ -23,10 +23,13 @@
 #include "llvm/Operator.h"
 #include "llvm/TypeSymbolTable.h"
 #include "llvm/ValueSymbolTable.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Program.h"
+#include "llvm/Support/Threading.h"
 #include <cctype>
 using namespace llvm;
 
@@ -57,6 +60,11 @@ enum {
   FUNCTION_INST_UNREACHABLE_ABBREV
 };
 
+static cl::opt<unsigned>
+WriterThreads("bitcode-writer-threads", cl::Hidden, cl::init(1),
+              cl::desc("Number of threads used to encode function blocks "
+                       "when writing bitcode"));
+
 
 static unsigned GetEncodedCastOpcode(unsigned Opcode) {
   switch (Opcode) {
@@ -1276,6 +1284,87 @@ static void WriteFunction(const Function &F, ValueEnumerator &VE,
   Stream.ExitBlock();
 }
 
+namespace {
+/// FunctionBlockWorker - The state of one thread of the parallel function
+/// block writer.  Each worker encodes whole function blocks into separate
+/// buffers, using its own copy of the module-level enumeration and of the
+/// BLOCKINFO abbreviations.
+struct FunctionBlockWorker {
+  ValueEnumerator VE;
+  const BitstreamWriter &Parent;
+  const std::vector<const Function*> &Functions;
+  std::vector<std::vector<unsigned char> > &Blocks;
+  volatile sys::cas_flag &NextFunction;
+
+  FunctionBlockWorker(const ValueEnumerator &ve, const BitstreamWriter &parent,
+                      const std::vector<const Function*> &functions,
+                      std::vector<std::vector<unsigned char> > &blocks,
+                      volatile sys::cas_flag &next)
+    : VE(ve), Parent(parent), Functions(functions), Blocks(blocks),
+      NextFunction(next) {}
+
+  static void run(void *Arg) {
+    FunctionBlockWorker &W = *static_cast<FunctionBlockWorker*>(Arg);
+    while (1) {
+      unsigned Idx = sys::AtomicIncrement(&W.NextFunction) - 1;
+      if (Idx >= W.Functions.size())
+        return;
+      BitstreamWriter Stream(W.Blocks[Idx]);
+      Stream.cloneBlockInfo(W.Parent);
+      WriteFunction(*W.Functions[Idx], W.VE, Stream);
+    }
+  }
+};
+}
+
+/// WriteFunctions - Emit the blocks for all function bodies in the module.
+/// With -bitcode-writer-threads=N, the blocks are encoded concurrently into
+/// separate buffers and then spliced into the stream in module order, which
+/// produces exactly the same bits as encoding them one after another.
+static void WriteFunctions(const Module *M, ValueEnumerator &VE,
+                           BitstreamWriter &Stream) {
+  std::vector<const Function*> Functions;
+  for (Module::const_iterator I = M->begin(), E = M->end(); I != E; ++I)
+    if (!I->isDeclaration())
+      Functions.push_back(I);
+
+  unsigned NumThreads = std::min<unsigned>(WriterThreads, Functions.size());
+
+  // Encoding reads the attribute lists of calls, whose reference counts are
+  // only safe to update concurrently in multithreaded mode.
+  bool StartedThreads = false;
+  if (NumThreads > 1 && !llvm_is_multithreaded())
+    StartedThreads = llvm_start_multithreaded();
+  if (!llvm_is_multithreaded())
+    NumThreads = 1;
+
+  if (NumThreads <= 1) {
+    for (unsigned i = 0, e = Functions.size(); i != e; ++i)
+      WriteFunction(*Functions[i], VE, Stream);
+    return;
+  }
+
+  std::vector<std::vector<unsigned char> > Blocks(Functions.size());
+  volatile sys::cas_flag NextFunction = 0;
+  std::vector<void*> Workers;
+  for (unsigned i = 0; i != NumThreads; ++i)
+    Workers.push_back(new FunctionBlockWorker(VE, Stream, Functions, Blocks,
+                                              NextFunction));
+
+  llvm_execute_on_threads(FunctionBlockWorker::run, &Workers[0], NumThreads);
+
+  if (StartedThreads)
+    llvm_stop_multithreaded();
+
+  for (unsigned i = 0; i != NumThreads; ++i)
+    delete static_cast<FunctionBlockWorker*>(Workers[i]);
+
+  for (unsigned i = 0, e = Blocks.size(); i != e; ++i) {
+    Stream.EmitEncodedSubblock(Blocks[i]);
+    std::vector<unsigned char>().swap(Blocks[i]);
+  }
+}
+
 /// WriteTypeSymbolTable - Emit a block for the specified type symtab.
 static void WriteTypeSymbolTable(const TypeSymbolTable &TST,
                                  const ValueEnumerator &VE,
@@ -1512,9 +1601,7 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream) {
   WriteModuleMetadata(M, VE, Stream);
 
   // Emit function bodies.
-  for (Module::const_iterator I = M->begin(), E = M->end(); I != E; ++I)
-    if (!I->isDeclaration())
-      WriteFunction(*I, VE, Stream);
+  WriteFunctions(M, VE, Stream);
 
   // Emit metadata.
   WriteModuleMetadataStore(M, Stream);
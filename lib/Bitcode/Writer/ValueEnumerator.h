@@ -79,11 +79,13 @@ private:
   unsigned FirstFuncConstantID;
   unsigned FirstInstID;
   
-  ValueEnumerator(const ValueEnumerator &);  // DO NOT IMPLEMENT
   void operator=(const ValueEnumerator &);   // DO NOT IMPLEMENT
 public:
   ValueEnumerator(const Module *M);
 
+  // The implicit copy constructor is used to give each thread of the parallel
+  // function block writer its own copy of the module-level enumeration.
+
   unsigned getValueID(const Value *V) const;
 
   unsigned getTypeID(const Type *T) const {
@@ -60,6 +60,7 @@ ExecutionEngine::ExecutionEngine(Module *M)
     ExceptionTableRegister(0),
     ExceptionTableDeregister(0) {
   CompilingLazily         = false;
+  CompilingSpeculatively  = false;
   GVCompilationDisabled   = false;
   SymbolSearchingDisabled = false;
   Modules.push_back(M);
@@ -0,0 +1,609 @@
+//===-- Bytecode.cpp - Lower functions to the interpreter's bytecode ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file lowers the functions the interpreter runs to the register
+//  bytecode that Interpreter::run dispatches over.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Interpreter.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/Support/GetElementPtrTypeIterator.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+using namespace llvm;
+
+//===----------------------------------------------------------------------===//
+//                     Register Representation
+//===----------------------------------------------------------------------===//
+
+/// lowBits - Return a mask of the low Bits bits of a word.
+static uint64_t lowBits(unsigned Bits) {
+  assert(Bits && Bits <= 64 && "Not a register width!");
+  return ~0ULL >> (64 - Bits);
+}
+
+bool FunctionCode::isWordType(const Type *Ty) {
+  switch (Ty->getTypeID()) {
+  case Type::IntegerTyID:
+    return cast<IntegerType>(Ty)->getBitWidth() <= 64;
+  case Type::PointerTyID:
+  case Type::FloatTyID:
+  case Type::DoubleTyID:
+    return true;
+  default:
+    return false;
+  }
+}
+
+uint64_t FunctionCode::toWord(const GenericValue &Val, const Type *Ty) {
+  switch (Ty->getTypeID()) {
+  default: llvm_unreachable("Value doesn't live in a register!");
+  case Type::IntegerTyID:
+    return Val.IntVal.getRawData()[0] &
+           lowBits(cast<IntegerType>(Ty)->getBitWidth());
+  case Type::PointerTyID:
+    return (uintptr_t)Val.PointerVal;
+  case Type::FloatTyID:
+    return FloatToBits(Val.FloatVal);
+  case Type::DoubleTyID:
+    return DoubleToBits(Val.DoubleVal);
+  }
+  return 0;
+}
+
+GenericValue FunctionCode::fromWord(uint64_t Word, const Type *Ty) {
+  GenericValue Val;
+  switch (Ty->getTypeID()) {
+  default: llvm_unreachable("Value doesn't live in a register!");
+  case Type::IntegerTyID:
+    Val.IntVal = APInt(cast<IntegerType>(Ty)->getBitWidth(), Word);
+    break;
+  case Type::PointerTyID:
+    Val.PointerVal = (PointerTy)(uintptr_t)Word;
+    break;
+  case Type::FloatTyID:
+    Val.FloatVal = BitsToFloat(uint32_t(Word));
+    break;
+  case Type::DoubleTyID:
+    Val.DoubleVal = BitsToDouble(Word);
+    break;
+  }
+  return Val;
+}
+
+//===----------------------------------------------------------------------===//
+//                     Locations and Registers
+//===----------------------------------------------------------------------===//
+
+/// assignLocation - Give V, an argument or instruction, a location in Code
+/// if it doesn't have one yet, and return it.
+static unsigned assignLocation(const Value *V, FunctionCode &Code) {
+  std::pair<DenseMap<const Value*, unsigned>::iterator, bool> Entry =
+    Code.Locations.insert(std::make_pair(V, 0U));
+  if (!Entry.second)
+    return Entry.first->second;
+  if (FunctionCode::isWordType(V->getType())) {
+    Entry.first->second = Code.NumRegs++;
+    Code.InitialRegs.push_back(0);
+  } else {
+    Entry.first->second = FunctionCode::GenericSlot | Code.NumGeneric++;
+  }
+  return Entry.first->second;
+}
+
+/// isPreloadable - Return true if C can be evaluated once, when its function
+/// is lowered, and kept in a register from then on.
+static bool isPreloadable(const Constant *C) {
+  if (!FunctionCode::isWordType(C->getType()))
+    return false;
+  if (isa<ConstantInt>(C) || isa<ConstantFP>(C) ||
+      isa<ConstantPointerNull>(C) || isa<UndefValue>(C) || isa<GlobalValue>(C))
+    return true;
+
+  // Addresses computed from globals are common enough operands to be worth
+  // folding, but leave the rarer expressions for getConstantExprValue to
+  // evaluate when they are reached.
+  const ConstantExpr *CE = dyn_cast<ConstantExpr>(C);
+  if (!CE)
+    return false;
+  switch (CE->getOpcode()) {
+  case Instruction::GetElementPtr:
+  case Instruction::BitCast:
+  case Instruction::IntToPtr:
+  case Instruction::PtrToInt:
+    break;
+  default:
+    return false;
+  }
+  for (User::const_op_iterator I = CE->op_begin(), E = CE->op_end();
+       I != E; ++I)
+    if (!isPreloadable(cast<Constant>(*I)))
+      return false;
+  return true;
+}
+
+/// getRegister - Return the register holding V in Code, or NoSlot if V
+/// doesn't live in one. Constants get a register, loaded with their value,
+/// the first time they are asked for.
+unsigned Interpreter::getRegister(Value *V, FunctionCode &Code) {
+  DenseMap<const Value*, unsigned>::iterator I = Code.Locations.find(V);
+  if (I != Code.Locations.end())
+    return I->second & FunctionCode::GenericSlot ?
+           unsigned(FunctionCode::NoSlot) : I->second;
+
+  Constant *C = dyn_cast<Constant>(V);
+  if (!C || !isPreloadable(C))
+    return FunctionCode::NoSlot;
+
+  ExecutionContext Empty;
+  Empty.Code = 0;
+  Empty.CurInstruction = 0;
+  unsigned Reg = Code.NumRegs++;
+  Code.Locations[C] = Reg;
+  Code.InitialRegs.push_back(FunctionCode::toWord(getOperandValue(C, Empty),
+                                                  C->getType()));
+  return Reg;
+}
+
+//===----------------------------------------------------------------------===//
+//                     Opcode Selection
+//===----------------------------------------------------------------------===//
+
+/// getBinaryOpcode - Return the bytecode opcode for the binary operator
+/// Opcode on operands of type Ty, or Generic if it has no fast path. Sets Imm
+/// to the result mask of the opcodes that need one.
+static unsigned getBinaryOpcode(unsigned Opcode, const Type *Ty,
+                                uint64_t &Imm) {
+  if (Ty->isDoubleTy())
+    switch (Opcode) {
+    case Instruction::FAdd: return InterpOp::FAdd;
+    case Instruction::FSub: return InterpOp::FSub;
+    case Instruction::FMul: return InterpOp::FMul;
+    case Instruction::FDiv: return InterpOp::FDiv;
+    default:                return InterpOp::Generic;
+    }
+
+  const IntegerType *ITy = dyn_cast<IntegerType>(Ty);
+  if (!ITy || ITy->getBitWidth() > 64)
+    return InterpOp::Generic;
+
+  switch (Opcode) {
+  case Instruction::And: return InterpOp::And;
+  case Instruction::Or:  return InterpOp::Or;
+  case Instruction::Xor: return InterpOp::Xor;
+  default: break;
+  }
+
+  unsigned Width = ITy->getBitWidth();
+  if (Width != 32 && Width != 64) {
+    Imm = lowBits(Width);
+    switch (Opcode) {
+    case Instruction::Add: return InterpOp::AddN;
+    case Instruction::Sub: return InterpOp::SubN;
+    case Instruction::Mul: return InterpOp::MulN;
+    default:               return InterpOp::Generic;
+    }
+  }
+
+  bool Is32 = Width == 32;
+  switch (Opcode) {
+  case Instruction::Add:  return Is32 ? InterpOp::Add32  : InterpOp::Add64;
+  case Instruction::Sub:  return Is32 ? InterpOp::Sub32  : InterpOp::Sub64;
+  case Instruction::Mul:  return Is32 ? InterpOp::Mul32  : InterpOp::Mul64;
+  case Instruction::Shl:  return Is32 ? InterpOp::Shl32  : InterpOp::Shl64;
+  case Instruction::LShr: return Is32 ? InterpOp::LShr32 : InterpOp::LShr64;
+  case Instruction::AShr: return Is32 ? InterpOp::AShr32 : InterpOp::AShr64;
+  case Instruction::UDiv: return Is32 ? InterpOp::UDiv32 : InterpOp::UDiv64;
+  case Instruction::SDiv: return Is32 ? InterpOp::SDiv32 : InterpOp::SDiv64;
+  case Instruction::URem: return Is32 ? InterpOp::URem32 : InterpOp::URem64;
+  case Instruction::SRem: return Is32 ? InterpOp::SRem32 : InterpOp::SRem64;
+  default:                return InterpOp::Generic;
+  }
+}
+
+/// getICmpOpcode - Return the bytecode opcode for an integer comparison of
+/// type Ty. Pointers always compare unsigned, as in executeCmpInst.
+static unsigned getICmpOpcode(unsigned Pred, const Type *Ty, uint64_t &Imm) {
+  bool IsPtr = Ty->isPointerTy();
+  if (!IsPtr)
+    Imm = 64 - cast<IntegerType>(Ty)->getBitWidth();
+  switch (Pred) {
+  case ICmpInst::ICMP_EQ:  return InterpOp::ICmpEQ;
+  case ICmpInst::ICMP_NE:  return InterpOp::ICmpNE;
+  case ICmpInst::ICMP_UGT: return InterpOp::ICmpUGT;
+  case ICmpInst::ICMP_UGE: return InterpOp::ICmpUGE;
+  case ICmpInst::ICMP_ULT: return InterpOp::ICmpULT;
+  case ICmpInst::ICMP_ULE: return InterpOp::ICmpULE;
+  case ICmpInst::ICMP_SGT: return IsPtr ? InterpOp::ICmpUGT : InterpOp::ICmpSGT;
+  case ICmpInst::ICMP_SGE: return IsPtr ? InterpOp::ICmpUGE : InterpOp::ICmpSGE;
+  case ICmpInst::ICMP_SLT: return IsPtr ? InterpOp::ICmpULT : InterpOp::ICmpSLT;
+  case ICmpInst::ICMP_SLE: return IsPtr ? InterpOp::ICmpULE : InterpOp::ICmpSLE;
+  default:                 return InterpOp::Generic;
+  }
+}
+
+/// getFCmpOpcode - Return the bytecode opcode for a comparison of doubles.
+static unsigned getFCmpOpcode(unsigned Pred) {
+  switch (Pred) {
+  case FCmpInst::FCMP_OEQ: return InterpOp::FCmpOEQ;
+  case FCmpInst::FCMP_ONE: return InterpOp::FCmpONE;
+  case FCmpInst::FCMP_OGT: return InterpOp::FCmpOGT;
+  case FCmpInst::FCMP_OGE: return InterpOp::FCmpOGE;
+  case FCmpInst::FCMP_OLT: return InterpOp::FCmpOLT;
+  case FCmpInst::FCMP_OLE: return InterpOp::FCmpOLE;
+  case FCmpInst::FCMP_ORD: return InterpOp::FCmpORD;
+  case FCmpInst::FCMP_UNO: return InterpOp::FCmpUNO;
+  case FCmpInst::FCMP_UEQ: return InterpOp::FCmpUEQ;
+  case FCmpInst::FCMP_UNE: return InterpOp::FCmpUNE;
+  case FCmpInst::FCMP_UGT: return InterpOp::FCmpUGT;
+  case FCmpInst::FCMP_UGE: return InterpOp::FCmpUGE;
+  case FCmpInst::FCMP_ULT: return InterpOp::FCmpULT;
+  case FCmpInst::FCMP_ULE: return InterpOp::FCmpULE;
+  default:                 return InterpOp::Generic;
+  }
+}
+
+/// getAccessSize - Return the number of bytes a fast load or store of type Ty
+/// moves, or 0 if it has to go through Load/StoreValueToMemory to be laid
+/// out the way the target expects.
+static unsigned getAccessSize(const Type *Ty, const TargetData &TD) {
+  if (sys::isLittleEndianHost() != TD.isLittleEndian())
+    return 0;
+  if (Ty->isPointerTy())
+    return TD.getPointerSize() == sizeof(void*) ? sizeof(void*) : 0;
+  unsigned Size = (unsigned)TD.getTypeStoreSize(Ty);
+  return Size == 1 || Size == 2 || Size == 4 || Size == 8 ? Size : 0;
+}
+
+/// getAccessMask - Return the mask of the bits of a register that a load of
+/// type Ty fills.
+static uint64_t getAccessMask(const Type *Ty, unsigned Size) {
+  if (const IntegerType *ITy = dyn_cast<IntegerType>(Ty))
+    return lowBits(ITy->getBitWidth());
+  return lowBits(Size * 8);
+}
+
+//===----------------------------------------------------------------------===//
+//                     Lowering
+//===----------------------------------------------------------------------===//
+
+/// lowerEdge - Add the edge From -> To to Code, with the moves for To's PHI
+/// nodes, and return its index.
+unsigned Interpreter::lowerEdge(BasicBlock *From, BasicBlock *To,
+                                FunctionCode &Code) {
+  InterpEdge Edge;
+  Edge.From = From;
+  Edge.To = To;
+  Edge.Target = Code.BlockStart.lookup(To);
+  Edge.MovesBegin = Code.Moves.size();
+  Edge.Slow = Edge.Parallel = false;
+
+  for (BasicBlock::iterator I = To->begin(); PHINode *PN = dyn_cast<PHINode>(I);
+       ++I) {
+    unsigned Dst = getRegister(PN, Code);
+    unsigned Src = getRegister(PN->getIncomingValueForBlock(From), Code);
+    if (Dst == FunctionCode::NoSlot || Src == FunctionCode::NoSlot) {
+      Edge.Slow = true;
+      break;
+    }
+    for (unsigned i = Edge.MovesBegin, e = Code.Moves.size(); i != e; ++i)
+      if (Code.Moves[i].first == Src)
+        Edge.Parallel = true;
+    Code.Moves.push_back(std::make_pair(Dst, Src));
+  }
+  if (Edge.Slow)
+    Code.Moves.resize(Edge.MovesBegin);
+  Edge.MovesEnd = Code.Moves.size();
+
+  Code.Edges.push_back(Edge);
+  return Code.Edges.size() - 1;
+}
+
+/// lowerInstruction - Append the op for I, which is not a PHI node, to Code.
+/// The op is Generic unless I and its operands fit one of the fast paths.
+void Interpreter::lowerInstruction(Instruction *I, FunctionCode &Code) {
+  InterpOp Op;
+  Op.Handler = 0;
+  Op.Opcode = InterpOp::Generic;
+  Op.Dst = Op.A = Op.B = Op.C = 0;
+  Op.Imm = 0;
+  Op.Inst = I;
+  Op.Run = Code.Runs.size();
+
+  Code.Runs.push_back(I->getType()->isVoidTy() ?
+                      unsigned(FunctionCode::NoSlot) :
+                      Code.Locations.lookup(I));
+  for (User::op_iterator OI = I->op_begin(), OE = I->op_end(); OI != OE; ++OI)
+    Code.Runs.push_back(isa<Instruction>(*OI) || isa<Argument>(*OI) ?
+                        Code.Locations.lookup(*OI) :
+                        unsigned(FunctionCode::NoSlot));
+
+  const unsigned NoSlot = FunctionCode::NoSlot;
+  unsigned Dst = NoSlot;
+  if (!I->getType()->isVoidTy())
+    Dst = getRegister(I, Code);
+  unsigned A = NoSlot, B = NoSlot, C = NoSlot;
+  unsigned Opcode = InterpOp::Generic;
+
+  switch (I->getOpcode()) {
+  default:
+    break;
+
+  case Instruction::Add:  case Instruction::Sub:  case Instruction::Mul:
+  case Instruction::FAdd: case Instruction::FSub: case Instruction::FMul:
+  case Instruction::FDiv: case Instruction::UDiv: case Instruction::SDiv:
+  case Instruction::URem: case Instruction::SRem: case Instruction::Shl:
+  case Instruction::LShr: case Instruction::AShr: case Instruction::And:
+  case Instruction::Or:   case Instruction::Xor:
+    A = getRegister(I->getOperand(0), Code);
+    B = getRegister(I->getOperand(1), Code);
+    if (Dst != NoSlot && A != NoSlot && B != NoSlot)
+      Opcode = getBinaryOpcode(I->getOpcode(), I->getType(), Op.Imm);
+    break;
+
+  case Instruction::ICmp:
+    A = getRegister(I->getOperand(0), Code);
+    B = getRegister(I->getOperand(1), Code);
+    if (Dst != NoSlot && A != NoSlot && B != NoSlot)
+      Opcode = getICmpOpcode(cast<ICmpInst>(I)->getPredicate(),
+                             I->getOperand(0)->getType(), Op.Imm);
+    break;
+
+  case Instruction::FCmp:
+    A = getRegister(I->getOperand(0), Code);
+    B = getRegister(I->getOperand(1), Code);
+    if (Dst != NoSlot && A != NoSlot && B != NoSlot &&
+        I->getOperand(0)->getType()->isDoubleTy())
+      Opcode = getFCmpOpcode(cast<FCmpInst>(I)->getPredicate());
+    break;
+
+  case Instruction::Select:
+    A = getRegister(I->getOperand(0), Code);
+    B = getRegister(I->getOperand(1), Code);
+    C = getRegister(I->getOperand(2), Code);
+    if (Dst != NoSlot && A != NoSlot && B != NoSlot && C != NoSlot)
+      Opcode = InterpOp::Select;
+    break;
+
+  case Instruction::Trunc:   case Instruction::ZExt:
+  case Instruction::SExt:    case Instruction::BitCast:
+  case Instruction::PtrToInt: case Instruction::IntToPtr:
+  case Instruction::SIToFP:  case Instruction::UIToFP:
+  case Instruction::FPExt:   case Instruction::FPTrunc: {
+    A = getRegister(I->getOperand(0), Code);
+    if (Dst == NoSlot || A == NoSlot)
+      break;
+    const Type *SrcTy = I->getOperand(0)->getType();
+    const Type *DstTy = I->getType();
+    switch (I->getOpcode()) {
+    case Instruction::Trunc:
+      Opcode = InterpOp::Trunc;
+      Op.Imm = lowBits(cast<IntegerType>(DstTy)->getBitWidth());
+      break;
+    case Instruction::ZExt:
+    case Instruction::BitCast:
+      Opcode = InterpOp::Move;
+      break;
+    case Instruction::SExt:
+      Opcode = InterpOp::SExt;
+      B = 64 - cast<IntegerType>(SrcTy)->getBitWidth();
+      Op.Imm = lowBits(cast<IntegerType>(DstTy)->getBitWidth());
+      break;
+    case Instruction::PtrToInt:
+      Opcode = InterpOp::Trunc;
+      Op.Imm = lowBits(cast<IntegerType>(DstTy)->getBitWidth());
+      break;
+    case Instruction::IntToPtr:
+      // Like executeIntToPtrInst, truncate to the target's pointer size.
+      Opcode = InterpOp::Trunc;
+      Op.Imm = lowBits(std::min(TD.getPointerSizeInBits(), 64U));
+      break;
+    case Instruction::SIToFP:
+      if (DstTy->isDoubleTy()) {
+        Opcode = InterpOp::SIToFP;
+        Op.Imm = 64 - cast<IntegerType>(SrcTy)->getBitWidth();
+      }
+      break;
+    case Instruction::UIToFP:
+      if (DstTy->isDoubleTy())
+        Opcode = InterpOp::UIToFP;
+      break;
+    case Instruction::FPExt:
+      if (SrcTy->isFloatTy() && DstTy->isDoubleTy())
+        Opcode = InterpOp::FPExt;
+      break;
+    case Instruction::FPTrunc:
+      if (SrcTy->isDoubleTy() && DstTy->isFloatTy())
+        Opcode = InterpOp::FPTrunc;
+      break;
+    }
+    break;
+  }
+
+  case Instruction::Load: {
+    LoadInst *LI = cast<LoadInst>(I);
+    A = getRegister(LI->getPointerOperand(), Code);
+    unsigned Size = getAccessSize(LI->getType(), TD);
+    if (Dst == NoSlot || A == NoSlot || !Size || LI->isVolatile())
+      break;
+    Opcode = Size == 1 ? InterpOp::Load8 : Size == 2 ? InterpOp::Load16 :
+             Size == 4 ? InterpOp::Load32 : InterpOp::Load64;
+    Op.Imm = getAccessMask(LI->getType(), Size);
+    break;
+  }
+
+  case Instruction::Store: {
+    StoreInst *SI = cast<StoreInst>(I);
+    A = getRegister(SI->getOperand(0), Code);
+    B = getRegister(SI->getPointerOperand(), Code);
+    unsigned Size = getAccessSize(SI->getOperand(0)->getType(), TD);
+    if (A == NoSlot || B == NoSlot || !Size || SI->isVolatile())
+      break;
+    Opcode = Size == 1 ? InterpOp::Store8 : Size == 2 ? InterpOp::Store16 :
+             Size == 4 ? InterpOp::Store32 : InterpOp::Store64;
+    break;
+  }
+
+  case Instruction::GetElementPtr: {
+    A = getRegister(I->getOperand(0), Code);
+    if (Dst == NoSlot || A == NoSlot)
+      break;
+
+    // Fold the struct fields and constant indices into one offset, and keep
+    // the variable indices for run() to scale.
+    unsigned First = Code.GEPIndices.size();
+    bool Fast = true;
+    for (gep_type_iterator GTI = gep_type_begin(I), E = gep_type_end(I);
+         GTI != E; ++GTI) {
+      if (const StructType *STy = dyn_cast<StructType>(*GTI)) {
+        unsigned Field = cast<ConstantInt>(GTI.getOperand())->getZExtValue();
+        Op.Imm += TD.getStructLayout(STy)->getElementOffset(Field);
+        continue;
+      }
+      const SequentialType *STy = cast<SequentialType>(*GTI);
+      uint64_t Scale = TD.getTypeAllocSize(STy->getElementType());
+      Value *Idx = GTI.getOperand();
+      unsigned Width = cast<IntegerType>(Idx->getType())->getBitWidth();
+      if (Width != 32 && Width != 64) {
+        Fast = false;
+        break;
+      }
+      if (ConstantInt *CI = dyn_cast<ConstantInt>(Idx)) {
+        Op.Imm += Scale * CI->getSExtValue();
+        continue;
+      }
+      InterpGEPIndex Index;
+      Index.Reg = getRegister(Idx, Code);
+      Index.Shift = 64 - Width;
+      Index.Scale = Scale;
+      if (Index.Reg == NoSlot) {
+        Fast = false;
+        break;
+      }
+      Code.GEPIndices.push_back(Index);
+    }
+    if (!Fast) {
+      Code.GEPIndices.resize(First);
+      Op.Imm = 0;
+      break;
+    }
+    Opcode = InterpOp::GEP;
+    B = First;
+    C = Code.GEPIndices.size();
+    break;
+  }
+
+  case Instruction::Br: {
+    BranchInst *BI = cast<BranchInst>(I);
+    BasicBlock *BB = BI->getParent();
+    if (BI->isUnconditional()) {
+      Opcode = InterpOp::Br;
+      A = lowerEdge(BB, BI->getSuccessor(0), Code);
+      break;
+    }
+    A = getRegister(BI->getCondition(), Code);
+    if (A == NoSlot)
+      break;
+    Opcode = InterpOp::CondBr;
+    B = lowerEdge(BB, BI->getSuccessor(0), Code);
+    C = lowerEdge(BB, BI->getSuccessor(1), Code);
+    break;
+  }
+  }
+
+  if (Opcode != InterpOp::Generic) {
+    Op.Opcode = Opcode;
+    Op.Dst = Dst;
+    Op.A = A;
+    Op.B = B;
+    Op.C = C;
+  } else {
+    Op.Imm = 0;
+  }
+  Code.Ops.push_back(Op);
+}
+
+/// lowerFunction - Lower F to bytecode in Code. The arguments and
+/// instructions that don't have a location yet are given one first.
+void Interpreter::lowerFunction(Function *F, FunctionCode &Code) {
+  Code.ArgLocs.clear();
+  for (Function::arg_iterator AI = F->arg_begin(), E = F->arg_end();
+       AI != E; ++AI)
+    Code.ArgLocs.push_back(assignLocation(AI, Code));
+  for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+      if (!I->getType()->isVoidTy())
+        assignLocation(I, Code);
+
+  Code.Ops.clear();
+  Code.Runs.clear();
+  Code.Edges.clear();
+  Code.Moves.clear();
+  Code.GEPIndices.clear();
+  Code.BlockStart.clear();
+  Code.Threaded = false;
+
+  // Branches need to know where their destinations start, so find that
+  // first. PHI nodes get no ops; the edges into their blocks set them.
+  unsigned NumOps = 0;
+  for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB) {
+    Code.BlockStart[BB] = NumOps;
+    for (BasicBlock::iterator I(BB->getFirstNonPHI()), E = BB->end();
+         I != E; ++I)
+      ++NumOps;
+  }
+
+  Code.Ops.reserve(NumOps);
+  for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+    for (BasicBlock::iterator I(BB->getFirstNonPHI()), E = BB->end();
+         I != E; ++I)
+      lowerInstruction(I, Code);
+}
+
+/// getFunctionCode - Return the bytecode for F, lowering it the first time
+/// it's called.
+FunctionCode *Interpreter::getFunctionCode(Function *F) {
+  FunctionCode *&Code = FunctionCodes[F];
+  if (!Code) {
+    Code = new FunctionCode();
+    lowerFunction(F, *Code);
+  }
+  return Code;
+}
+
+/// relowerFunction - Lower F again after IntrinsicLowering changed it, and
+/// move each frame running F to the op of the instruction Resume holds for
+/// it, by stack depth; frames with none get a new PC when their call
+/// returns. Existing values keep their locations, so the frames only need
+/// room for the new ones, and the constants among those loaded.
+void Interpreter::relowerFunction(Function *F,
+                                  const std::vector<Instruction*> &Resume) {
+  FunctionCode &Code = *FunctionCodes[F];
+  lowerFunction(F, Code);
+
+  DenseMap<const Instruction*, unsigned> OpNumbers;
+  for (unsigned i = 0, e = Code.Ops.size(); i != e; ++i)
+    OpNumbers[Code.Ops[i].Inst] = i;
+
+  for (unsigned i = 0, e = ECStack.size(); i != e; ++i) {
+    ExecutionContext &SF = ECStack[i];
+    if (SF.Code != &Code)
+      continue;
+    SF.Regs.insert(SF.Regs.end(), Code.InitialRegs.begin() + SF.Regs.size(),
+                   Code.InitialRegs.end());
+    SF.Values.resize(Code.NumGeneric);
+    SF.PC = &Code.Ops[Resume[i] ? OpNumbers.lookup(Resume[i]) : 0];
+    SF.CurInstruction = 0;
+    SF.CurSlots = 0;
+  }
+}
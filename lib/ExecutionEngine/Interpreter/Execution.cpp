@@ -19,6 +19,7 @@
 #include "llvm/CodeGen/IntrinsicLowering.h"
 #include "llvm/Support/GetElementPtrTypeIterator.h"
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
@@ -26,6 +27,7 @@
 #include "llvm/Support/MathExtras.h"
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 using namespace llvm;
 
 STATISTIC(NumDynamicInsts, "Number of dynamic instructions executed");
@@ -37,8 +39,38 @@ static cl::opt<bool> PrintVolatile("interpreter-print-volatile", cl::Hidden,
 //                     Various Helper Functions
 //===----------------------------------------------------------------------===//
 
+/// getLocationValue - Return the value of type Ty held in location Loc of the
+/// frame SF, in generic form.
+static GenericValue getLocationValue(unsigned Loc, const Type *Ty,
+                                     ExecutionContext &SF) {
+  if (Loc & FunctionCode::GenericSlot)
+    return SF.Values[Loc & ~unsigned(FunctionCode::GenericSlot)];
+  return FunctionCode::fromWord(SF.Regs[Loc], Ty);
+}
+
+/// setLocationValue - Store Val, of type Ty, in location Loc of the frame SF.
+static void setLocationValue(unsigned Loc, const GenericValue &Val,
+                             const Type *Ty, ExecutionContext &SF) {
+  if (Loc & FunctionCode::GenericSlot)
+    SF.Values[Loc & ~unsigned(FunctionCode::GenericSlot)] = Val;
+  else
+    SF.Regs[Loc] = FunctionCode::toWord(Val, Ty);
+}
+
+/// SetValue - Record Val as the value of V in the frame SF. The result of the
+/// instruction being executed goes straight into its pre-resolved location,
+/// if it has one; void instructions such as va_start don't.
 static void SetValue(Value *V, GenericValue Val, ExecutionContext &SF) {
-  SF.Values[V] = Val;
+  unsigned Loc;
+  if (V == SF.CurInstruction) {
+    Loc = SF.CurSlots[0];
+    if (Loc == FunctionCode::NoSlot)
+      return;
+  } else {
+    assert(SF.Code->Locations.count(V) && "Value was never lowered!");
+    Loc = SF.Code->Locations.lookup(V);
+  }
+  setLocationValue(Loc, Val, V->getType(), SF);
 }
 
 //===----------------------------------------------------------------------===//
@@ -257,8 +289,8 @@ static GenericValue executeICMP_SGE(GenericValue Src1, GenericValue Src2,
 void Interpreter::visitICmpInst(ICmpInst &I) {
   ExecutionContext &SF = ECStack.back();
   const Type *Ty    = I.getOperand(0)->getType();
-  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
-  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
+  GenericValue Src1 = getOperandValue(&I, 0, SF);
+  GenericValue Src2 = getOperandValue(&I, 1, SF);
   GenericValue R;   // Result
   
   switch (I.getPredicate()) {
@@ -445,8 +477,8 @@ static GenericValue executeFCMP_UNO(GenericValue Src1, GenericValue Src2,
 void Interpreter::visitFCmpInst(FCmpInst &I) {
   ExecutionContext &SF = ECStack.back();
   const Type *Ty    = I.getOperand(0)->getType();
-  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
-  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
+  GenericValue Src1 = getOperandValue(&I, 0, SF);
+  GenericValue Src2 = getOperandValue(&I, 1, SF);
   GenericValue R;   // Result
   
   switch (I.getPredicate()) {
@@ -521,8 +553,8 @@ static GenericValue executeCmpInst(unsigned predicate, GenericValue Src1,
 void Interpreter::visitBinaryOperator(BinaryOperator &I) {
   ExecutionContext &SF = ECStack.back();
   const Type *Ty    = I.getOperand(0)->getType();
-  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
-  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
+  GenericValue Src1 = getOperandValue(&I, 0, SF);
+  GenericValue Src2 = getOperandValue(&I, 1, SF);
   GenericValue R;   // Result
 
   switch (I.getOpcode()) {
@@ -556,9 +588,9 @@ static GenericValue executeSelectInst(GenericValue Src1, GenericValue Src2,
 
 void Interpreter::visitSelectInst(SelectInst &I) {
   ExecutionContext &SF = ECStack.back();
-  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
-  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
-  GenericValue Src3 = getOperandValue(I.getOperand(2), SF);
+  GenericValue Src1 = getOperandValue(&I, 0, SF);
+  GenericValue Src2 = getOperandValue(&I, 1, SF);
+  GenericValue Src3 = getOperandValue(&I, 2, SF);
   GenericValue R = executeSelectInst(Src1, Src2, Src3);
   SetValue(&I, R, SF);
 }
@@ -574,6 +606,9 @@ void Interpreter::exitCalled(GenericValue GV) {
   // the stack before interpreting atexit handlers.
   ECStack.clear();
   runAtExitHandlers();
+  // Don't let the process exit under the JIT's compile thread.
+  if (TierUp)
+    TierUp->stopCompiling();
   exit(GV.IntVal.zextOrTrunc(32).getZExtValue());
 }
 
@@ -619,7 +654,7 @@ void Interpreter::visitReturnInst(ReturnInst &I) {
   // Save away the return value... (if we are not 'ret void')
   if (I.getNumOperands()) {
     RetTy  = I.getReturnValue()->getType();
-    Result = getOperandValue(I.getReturnValue(), SF);
+    Result = getOperandValue(&I, 0, SF);
   }
 
   popStackAndReturnValueToCaller(RetTy, Result);
@@ -653,8 +688,7 @@ void Interpreter::visitBranchInst(BranchInst &I) {
 
   Dest = I.getSuccessor(0);          // Uncond branches have a fixed dest...
   if (!I.isUnconditional()) {
-    Value *Cond = I.getCondition();
-    if (getOperandValue(Cond, SF).IntVal == 0) // If false cond...
+    if (getOperandValue(&I, 0, SF).IntVal == 0) // If false cond...
       Dest = I.getSuccessor(1);
   }
   SwitchToNewBasicBlock(Dest, SF);
@@ -662,13 +696,13 @@ void Interpreter::visitBranchInst(BranchInst &I) {
 
 void Interpreter::visitSwitchInst(SwitchInst &I) {
   ExecutionContext &SF = ECStack.back();
-  GenericValue CondVal = getOperandValue(I.getOperand(0), SF);
+  GenericValue CondVal = getOperandValue(&I, 0, SF);
   const Type *ElTy = I.getOperand(0)->getType();
 
   // Check to see if any of the cases match...
   BasicBlock *Dest = 0;
   for (unsigned i = 2, e = I.getNumOperands(); i != e; i += 2)
-    if (executeICMP_EQ(CondVal, getOperandValue(I.getOperand(i), SF), ElTy)
+    if (executeICMP_EQ(CondVal, getOperandValue(&I, i, SF), ElTy)
         .IntVal != 0) {
       Dest = cast<BasicBlock>(I.getOperand(i+1));
       break;
@@ -680,7 +714,7 @@ void Interpreter::visitSwitchInst(SwitchInst &I) {
 
 void Interpreter::visitIndirectBrInst(IndirectBrInst &I) {
   ExecutionContext &SF = ECStack.back();
-  void *Dest = GVTOP(getOperandValue(I.getAddress(), SF));
+  void *Dest = GVTOP(getOperandValue(&I, 0, SF));
   SwitchToNewBasicBlock((BasicBlock*)Dest, SF);
 }
 
@@ -697,30 +731,30 @@ void Interpreter::visitIndirectBrInst(IndirectBrInst &I) {
 //
 void Interpreter::SwitchToNewBasicBlock(BasicBlock *Dest, ExecutionContext &SF){
   BasicBlock *PrevBB = SF.CurBB;      // Remember where we came from...
+  if (TierUp)
+    TierUp->noteBranch(PrevBB, Dest);
   SF.CurBB   = Dest;                  // Update CurBB to branch destination
-  SF.CurInst = SF.CurBB->begin();     // Update new instruction ptr...
+  SF.PC = &SF.Code->Ops[SF.Code->BlockStart.lookup(Dest)];
 
-  if (!isa<PHINode>(SF.CurInst)) return;  // Nothing fancy to do
+  BasicBlock::iterator I = Dest->begin();
+  if (!isa<PHINode>(I)) return;       // Nothing fancy to do
 
   // Loop over all of the PHI nodes in the current block, reading their inputs.
   std::vector<GenericValue> ResultValues;
 
-  for (; PHINode *PN = dyn_cast<PHINode>(SF.CurInst); ++SF.CurInst) {
+  for (; PHINode *PN = dyn_cast<PHINode>(I); ++I) {
     // Search for the value corresponding to this previous bb...
     int i = PN->getBasicBlockIndex(PrevBB);
     assert(i != -1 && "PHINode doesn't contain entry for predecessor??");
-    Value *IncomingValue = PN->getIncomingValue(i);
 
     // Save the incoming value for this PHI node...
-    ResultValues.push_back(getOperandValue(IncomingValue, SF));
+    ResultValues.push_back(getOperandValue(PN->getIncomingValue(i), SF));
   }
 
   // Now loop over all of the PHI nodes setting their values...
-  SF.CurInst = SF.CurBB->begin();
-  for (unsigned i = 0; isa<PHINode>(SF.CurInst); ++SF.CurInst, ++i) {
-    PHINode *PN = cast<PHINode>(SF.CurInst);
-    SetValue(PN, ResultValues[i], SF);
-  }
+  I = Dest->begin();
+  for (unsigned i = 0, e = ResultValues.size(); i != e; ++i, ++I)
+    SetValue(I, ResultValues[i], SF);
 }
 
 //===----------------------------------------------------------------------===//
@@ -734,7 +768,7 @@ void Interpreter::visitAllocaInst(AllocaInst &I) {
 
   // Get the number of elements being allocated by the array...
   unsigned NumElements = 
-    getOperandValue(I.getOperand(0), SF).IntVal.getZExtValue();
+    getOperandValue(&I, 0, SF).IntVal.getZExtValue();
 
   unsigned TypeSize = (size_t)TD.getTypeAllocSize(Ty);
 
@@ -758,15 +792,15 @@ void Interpreter::visitAllocaInst(AllocaInst &I) {
 
 // getElementOffset - The workhorse for getelementptr.
 //
-GenericValue Interpreter::executeGEPOperation(Value *Ptr, gep_type_iterator I,
-                                              gep_type_iterator E,
-                                              ExecutionContext &SF) {
-  assert(Ptr->getType()->isPointerTy() &&
+GenericValue Interpreter::executeGEPOperation(User *GEP, ExecutionContext &SF) {
+  assert(GEP->getOperand(0)->getType()->isPointerTy() &&
          "Cannot getElementOffset of a nonpointer type!");
 
   uint64_t Total = 0;
 
-  for (; I != E; ++I) {
+  unsigned OpNo = 1;
+  for (gep_type_iterator I = gep_type_begin(GEP), E = gep_type_end(GEP);
+       I != E; ++I, ++OpNo) {
     if (const StructType *STy = dyn_cast<StructType>(*I)) {
       const StructLayout *SLO = TD.getStructLayout(STy);
 
@@ -777,7 +811,7 @@ GenericValue Interpreter::executeGEPOperation(Value *Ptr, gep_type_iterator I,
     } else {
       const SequentialType *ST = cast<SequentialType>(*I);
       // Get the index number for the array... which must be long type...
-      GenericValue IdxGV = getOperandValue(I.getOperand(), SF);
+      GenericValue IdxGV = getOperandValue(GEP, OpNo, SF);
 
       int64_t Idx;
       unsigned BitWidth = 
@@ -793,20 +827,19 @@ GenericValue Interpreter::executeGEPOperation(Value *Ptr, gep_type_iterator I,
   }
 
   GenericValue Result;
-  Result.PointerVal = ((char*)getOperandValue(Ptr, SF).PointerVal) + Total;
+  Result.PointerVal = ((char*)getOperandValue(GEP, 0, SF).PointerVal) + Total;
   DEBUG(dbgs() << "GEP Index " << Total << " bytes.\n");
   return Result;
 }
 
 void Interpreter::visitGetElementPtrInst(GetElementPtrInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeGEPOperation(I.getPointerOperand(),
-                                   gep_type_begin(I), gep_type_end(I), SF), SF);
+  SetValue(&I, executeGEPOperation(&I, SF), SF);
 }
 
 void Interpreter::visitLoadInst(LoadInst &I) {
   ExecutionContext &SF = ECStack.back();
-  GenericValue SRC = getOperandValue(I.getPointerOperand(), SF);
+  GenericValue SRC = getOperandValue(&I, 0, SF);
   GenericValue *Ptr = (GenericValue*)GVTOP(SRC);
   GenericValue Result;
   LoadValueFromMemory(Result, Ptr, I.getType());
@@ -817,8 +850,8 @@ void Interpreter::visitLoadInst(LoadInst &I) {
 
 void Interpreter::visitStoreInst(StoreInst &I) {
   ExecutionContext &SF = ECStack.back();
-  GenericValue Val = getOperandValue(I.getOperand(0), SF);
-  GenericValue SRC = getOperandValue(I.getPointerOperand(), SF);
+  GenericValue Val = getOperandValue(&I, 0, SF);
+  GenericValue SRC = getOperandValue(&I, 1, SF);
   StoreValueToMemory(Val, (GenericValue *)GVTOP(SRC),
                      I.getOperand(0)->getType());
   if (I.isVolatile() && PrintVolatile)
@@ -848,29 +881,50 @@ void Interpreter::visitCallSite(CallSite CS) {
     case Intrinsic::vaend:    // va_end is a noop for the interpreter
       return;
     case Intrinsic::vacopy:   // va_copy: dest = src
-      SetValue(CS.getInstruction(), getOperandValue(*CS.arg_begin(), SF), SF);
+      SetValue(CS.getInstruction(),
+               getOperandValue(CS.getInstruction(), 0, SF), SF);
       return;
-    default:
+    default: {
       // If it is an unknown intrinsic function, use the intrinsic lowering
       // class to transform it into hopefully tasty LLVM code.
       //
-      BasicBlock::iterator me(CS.getInstruction());
-      BasicBlock *Parent = CS.getInstruction()->getParent();
+      CallInst *CI = cast<CallInst>(CS.getInstruction());
+      BasicBlock::iterator me(CI);
+      BasicBlock *Parent = CI->getParent();
       bool atBegin(Parent->begin() == me);
       if (!atBegin)
         --me;
-      IL->LowerIntrinsicCall(cast<CallInst>(CS.getInstruction()));
-
-      // Restore the CurInst pointer to the first instruction newly inserted, if
-      // any.
-      if (atBegin) {
-        SF.CurInst = Parent->begin();
-      } else {
-        SF.CurInst = me;
-        ++SF.CurInst;
+
+      // The function is lowered to bytecode again afterwards, so note the
+      // instruction each frame running it resumes at. Frames waiting on an
+      // invoke get theirs when it returns or unwinds.
+      std::vector<Instruction*> Resume(ECStack.size());
+      SmallVector<unsigned, 4> AtCall;
+      AtCall.push_back(ECStack.size() - 1);
+      for (unsigned i = 0, e = ECStack.size() - 1; i != e; ++i) {
+        ExecutionContext &Frame = ECStack[i];
+        Instruction *Call = Frame.Caller.getInstruction();
+        if (Frame.Code != SF.Code || (Call && isa<InvokeInst>(Call)))
+          continue;
+        if (Frame.PC->Inst == CI)
+          AtCall.push_back(i);
+        else
+          Resume[i] = Frame.PC->Inst;
       }
+      SF.CurInstruction = 0;
+      IL->LowerIntrinsicCall(CI);
+
+      // Resume at the first instruction newly inserted, if any.
+      if (atBegin)
+        me = Parent->begin();
+      else
+        ++me;
+      for (unsigned i = 0, e = AtCall.size(); i != e; ++i)
+        Resume[AtCall[i]] = &*me;
+      relowerFunction(Parent->getParent(), Resume);
       return;
     }
+    }
 
 
   SF.Caller = CS;
@@ -878,22 +932,20 @@ void Interpreter::visitCallSite(CallSite CS) {
   const unsigned NumArgs = SF.Caller.arg_size();
   ArgVals.reserve(NumArgs);
   uint16_t pNum = 1;
-  for (CallSite::arg_iterator i = SF.Caller.arg_begin(),
-         e = SF.Caller.arg_end(); i != e; ++i, ++pNum) {
-    Value *V = *i;
-    ArgVals.push_back(getOperandValue(V, SF));
-  }
+  for (unsigned i = 0; i != NumArgs; ++i, ++pNum)
+    ArgVals.push_back(getOperandValue(CS.getInstruction(), i, SF));
 
   // To handle indirect calls, we must get the pointer value from the argument
   // and treat it as a function pointer.
-  GenericValue SRC = getOperandValue(SF.Caller.getCalledValue(), SF);
+  // The callee follows the arguments in both calls and invokes.
+  GenericValue SRC = getOperandValue(CS.getInstruction(), NumArgs, SF);
   callFunction((Function*)GVTOP(SRC), ArgVals);
 }
 
 void Interpreter::visitShl(BinaryOperator &I) {
   ExecutionContext &SF = ECStack.back();
-  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
-  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
+  GenericValue Src1 = getOperandValue(&I, 0, SF);
+  GenericValue Src2 = getOperandValue(&I, 1, SF);
   GenericValue Dest;
   if (Src2.IntVal.getZExtValue() < Src1.IntVal.getBitWidth())
     Dest.IntVal = Src1.IntVal.shl(Src2.IntVal.getZExtValue());
@@ -905,8 +957,8 @@ void Interpreter::visitShl(BinaryOperator &I) {
 
 void Interpreter::visitLShr(BinaryOperator &I) {
   ExecutionContext &SF = ECStack.back();
-  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
-  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
+  GenericValue Src1 = getOperandValue(&I, 0, SF);
+  GenericValue Src2 = getOperandValue(&I, 1, SF);
   GenericValue Dest;
   if (Src2.IntVal.getZExtValue() < Src1.IntVal.getBitWidth())
     Dest.IntVal = Src1.IntVal.lshr(Src2.IntVal.getZExtValue());
@@ -918,8 +970,8 @@ void Interpreter::visitLShr(BinaryOperator &I) {
 
 void Interpreter::visitAShr(BinaryOperator &I) {
   ExecutionContext &SF = ECStack.back();
-  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
-  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
+  GenericValue Src1 = getOperandValue(&I, 0, SF);
+  GenericValue Src2 = getOperandValue(&I, 1, SF);
   GenericValue Dest;
   if (Src2.IntVal.getZExtValue() < Src1.IntVal.getBitWidth())
     Dest.IntVal = Src1.IntVal.ashr(Src2.IntVal.getZExtValue());
@@ -929,56 +981,59 @@ void Interpreter::visitAShr(BinaryOperator &I) {
   SetValue(&I, Dest, SF);
 }
 
-GenericValue Interpreter::executeTruncInst(Value *SrcVal, const Type *DstTy,
-                                           ExecutionContext &SF) {
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+GenericValue Interpreter::executeTruncInst(User *Cast, ExecutionContext &SF) {
+  const Type *DstTy = Cast->getType();
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   const IntegerType *DITy = cast<IntegerType>(DstTy);
   unsigned DBitWidth = DITy->getBitWidth();
   Dest.IntVal = Src.IntVal.trunc(DBitWidth);
   return Dest;
 }
 
-GenericValue Interpreter::executeSExtInst(Value *SrcVal, const Type *DstTy,
-                                          ExecutionContext &SF) {
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+GenericValue Interpreter::executeSExtInst(User *Cast, ExecutionContext &SF) {
+  const Type *DstTy = Cast->getType();
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   const IntegerType *DITy = cast<IntegerType>(DstTy);
   unsigned DBitWidth = DITy->getBitWidth();
   Dest.IntVal = Src.IntVal.sext(DBitWidth);
   return Dest;
 }
 
-GenericValue Interpreter::executeZExtInst(Value *SrcVal, const Type *DstTy,
-                                          ExecutionContext &SF) {
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+GenericValue Interpreter::executeZExtInst(User *Cast, ExecutionContext &SF) {
+  const Type *DstTy = Cast->getType();
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   const IntegerType *DITy = cast<IntegerType>(DstTy);
   unsigned DBitWidth = DITy->getBitWidth();
   Dest.IntVal = Src.IntVal.zext(DBitWidth);
   return Dest;
 }
 
-GenericValue Interpreter::executeFPTruncInst(Value *SrcVal, const Type *DstTy,
-                                             ExecutionContext &SF) {
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+GenericValue Interpreter::executeFPTruncInst(User *Cast, ExecutionContext &SF) {
+  Value *SrcVal = Cast->getOperand(0);
+  const Type *DstTy = Cast->getType();
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   assert(SrcVal->getType()->isDoubleTy() && DstTy->isFloatTy() &&
          "Invalid FPTrunc instruction");
   Dest.FloatVal = (float) Src.DoubleVal;
   return Dest;
 }
 
-GenericValue Interpreter::executeFPExtInst(Value *SrcVal, const Type *DstTy,
-                                           ExecutionContext &SF) {
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+GenericValue Interpreter::executeFPExtInst(User *Cast, ExecutionContext &SF) {
+  Value *SrcVal = Cast->getOperand(0);
+  const Type *DstTy = Cast->getType();
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   assert(SrcVal->getType()->isFloatTy() && DstTy->isDoubleTy() &&
          "Invalid FPTrunc instruction");
   Dest.DoubleVal = (double) Src.FloatVal;
   return Dest;
 }
 
-GenericValue Interpreter::executeFPToUIInst(Value *SrcVal, const Type *DstTy,
-                                            ExecutionContext &SF) {
+GenericValue Interpreter::executeFPToUIInst(User *Cast, ExecutionContext &SF) {
+  Value *SrcVal = Cast->getOperand(0);
+  const Type *DstTy = Cast->getType();
   const Type *SrcTy = SrcVal->getType();
   uint32_t DBitWidth = cast<IntegerType>(DstTy)->getBitWidth();
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   assert(SrcTy->isFloatingPointTy() && "Invalid FPToUI instruction");
 
   if (SrcTy->getTypeID() == Type::FloatTyID)
@@ -988,11 +1043,12 @@ GenericValue Interpreter::executeFPToUIInst(Value *SrcVal, const Type *DstTy,
   return Dest;
 }
 
-GenericValue Interpreter::executeFPToSIInst(Value *SrcVal, const Type *DstTy,
-                                            ExecutionContext &SF) {
+GenericValue Interpreter::executeFPToSIInst(User *Cast, ExecutionContext &SF) {
+  Value *SrcVal = Cast->getOperand(0);
+  const Type *DstTy = Cast->getType();
   const Type *SrcTy = SrcVal->getType();
   uint32_t DBitWidth = cast<IntegerType>(DstTy)->getBitWidth();
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   assert(SrcTy->isFloatingPointTy() && "Invalid FPToSI instruction");
 
   if (SrcTy->getTypeID() == Type::FloatTyID)
@@ -1002,9 +1058,9 @@ GenericValue Interpreter::executeFPToSIInst(Value *SrcVal, const Type *DstTy,
   return Dest;
 }
 
-GenericValue Interpreter::executeUIToFPInst(Value *SrcVal, const Type *DstTy,
-                                            ExecutionContext &SF) {
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+GenericValue Interpreter::executeUIToFPInst(User *Cast, ExecutionContext &SF) {
+  const Type *DstTy = Cast->getType();
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   assert(DstTy->isFloatingPointTy() && "Invalid UIToFP instruction");
 
   if (DstTy->getTypeID() == Type::FloatTyID)
@@ -1014,9 +1070,9 @@ GenericValue Interpreter::executeUIToFPInst(Value *SrcVal, const Type *DstTy,
   return Dest;
 }
 
-GenericValue Interpreter::executeSIToFPInst(Value *SrcVal, const Type *DstTy,
-                                            ExecutionContext &SF) {
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+GenericValue Interpreter::executeSIToFPInst(User *Cast, ExecutionContext &SF) {
+  const Type *DstTy = Cast->getType();
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   assert(DstTy->isFloatingPointTy() && "Invalid SIToFP instruction");
 
   if (DstTy->getTypeID() == Type::FloatTyID)
@@ -1027,19 +1083,22 @@ GenericValue Interpreter::executeSIToFPInst(Value *SrcVal, const Type *DstTy,
 
 }
 
-GenericValue Interpreter::executePtrToIntInst(Value *SrcVal, const Type *DstTy,
+GenericValue Interpreter::executePtrToIntInst(User *Cast,
                                               ExecutionContext &SF) {
+  Value *SrcVal = Cast->getOperand(0);
+  const Type *DstTy = Cast->getType();
   uint32_t DBitWidth = cast<IntegerType>(DstTy)->getBitWidth();
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   assert(SrcVal->getType()->isPointerTy() && "Invalid PtrToInt instruction");
 
   Dest.IntVal = APInt(DBitWidth, (intptr_t) Src.PointerVal);
   return Dest;
 }
 
-GenericValue Interpreter::executeIntToPtrInst(Value *SrcVal, const Type *DstTy,
+GenericValue Interpreter::executeIntToPtrInst(User *Cast,
                                               ExecutionContext &SF) {
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+  const Type *DstTy = Cast->getType();
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   assert(DstTy->isPointerTy() && "Invalid PtrToInt instruction");
 
   uint32_t PtrSize = TD.getPointerSizeInBits();
@@ -1050,11 +1109,12 @@ GenericValue Interpreter::executeIntToPtrInst(Value *SrcVal, const Type *DstTy,
   return Dest;
 }
 
-GenericValue Interpreter::executeBitCastInst(Value *SrcVal, const Type *DstTy,
-                                             ExecutionContext &SF) {
+GenericValue Interpreter::executeBitCastInst(User *Cast, ExecutionContext &SF) {
+  Value *SrcVal = Cast->getOperand(0);
+  const Type *DstTy = Cast->getType();
   
   const Type *SrcTy = SrcVal->getType();
-  GenericValue Dest, Src = getOperandValue(SrcVal, SF);
+  GenericValue Dest, Src = getOperandValue(Cast, 0, SF);
   if (DstTy->isPointerTy()) {
     assert(SrcTy->isPointerTy() && "Invalid BitCast");
     Dest.PointerVal = Src.PointerVal;
@@ -1085,62 +1145,62 @@ GenericValue Interpreter::executeBitCastInst(Value *SrcVal, const Type *DstTy,
 
 void Interpreter::visitTruncInst(TruncInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeTruncInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executeTruncInst(&I, SF), SF);
 }
 
 void Interpreter::visitSExtInst(SExtInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeSExtInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executeSExtInst(&I, SF), SF);
 }
 
 void Interpreter::visitZExtInst(ZExtInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeZExtInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executeZExtInst(&I, SF), SF);
 }
 
 void Interpreter::visitFPTruncInst(FPTruncInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeFPTruncInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executeFPTruncInst(&I, SF), SF);
 }
 
 void Interpreter::visitFPExtInst(FPExtInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeFPExtInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executeFPExtInst(&I, SF), SF);
 }
 
 void Interpreter::visitUIToFPInst(UIToFPInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeUIToFPInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executeUIToFPInst(&I, SF), SF);
 }
 
 void Interpreter::visitSIToFPInst(SIToFPInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeSIToFPInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executeSIToFPInst(&I, SF), SF);
 }
 
 void Interpreter::visitFPToUIInst(FPToUIInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeFPToUIInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executeFPToUIInst(&I, SF), SF);
 }
 
 void Interpreter::visitFPToSIInst(FPToSIInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeFPToSIInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executeFPToSIInst(&I, SF), SF);
 }
 
 void Interpreter::visitPtrToIntInst(PtrToIntInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executePtrToIntInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executePtrToIntInst(&I, SF), SF);
 }
 
 void Interpreter::visitIntToPtrInst(IntToPtrInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeIntToPtrInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executeIntToPtrInst(&I, SF), SF);
 }
 
 void Interpreter::visitBitCastInst(BitCastInst &I) {
   ExecutionContext &SF = ECStack.back();
-  SetValue(&I, executeBitCastInst(I.getOperand(0), I.getType(), SF), SF);
+  SetValue(&I, executeBitCastInst(&I, SF), SF);
 }
 
 #define IMPLEMENT_VAARG(TY) \
@@ -1151,7 +1211,7 @@ void Interpreter::visitVAArgInst(VAArgInst &I) {
 
   // Get the incoming valist parameter.  LLI treats the valist as a
   // (ec-stack-depth var-arg-index) pair.
-  GenericValue VAList = getOperandValue(I.getOperand(0), SF);
+  GenericValue VAList = getOperandValue(&I, 0, SF);
   GenericValue Dest;
   GenericValue Src = ECStack[VAList.UIntPairVal.first]
                       .VarArgs[VAList.UIntPairVal.second];
@@ -1177,32 +1237,31 @@ GenericValue Interpreter::getConstantExprValue (ConstantExpr *CE,
                                                 ExecutionContext &SF) {
   switch (CE->getOpcode()) {
   case Instruction::Trunc:   
-      return executeTruncInst(CE->getOperand(0), CE->getType(), SF);
+      return executeTruncInst(CE, SF);
   case Instruction::ZExt:
-      return executeZExtInst(CE->getOperand(0), CE->getType(), SF);
+      return executeZExtInst(CE, SF);
   case Instruction::SExt:
-      return executeSExtInst(CE->getOperand(0), CE->getType(), SF);
+      return executeSExtInst(CE, SF);
   case Instruction::FPTrunc:
-      return executeFPTruncInst(CE->getOperand(0), CE->getType(), SF);
+      return executeFPTruncInst(CE, SF);
   case Instruction::FPExt:
-      return executeFPExtInst(CE->getOperand(0), CE->getType(), SF);
+      return executeFPExtInst(CE, SF);
   case Instruction::UIToFP:
-      return executeUIToFPInst(CE->getOperand(0), CE->getType(), SF);
+      return executeUIToFPInst(CE, SF);
   case Instruction::SIToFP:
-      return executeSIToFPInst(CE->getOperand(0), CE->getType(), SF);
+      return executeSIToFPInst(CE, SF);
   case Instruction::FPToUI:
-      return executeFPToUIInst(CE->getOperand(0), CE->getType(), SF);
+      return executeFPToUIInst(CE, SF);
   case Instruction::FPToSI:
-      return executeFPToSIInst(CE->getOperand(0), CE->getType(), SF);
+      return executeFPToSIInst(CE, SF);
   case Instruction::PtrToInt:
-      return executePtrToIntInst(CE->getOperand(0), CE->getType(), SF);
+      return executePtrToIntInst(CE, SF);
   case Instruction::IntToPtr:
-      return executeIntToPtrInst(CE->getOperand(0), CE->getType(), SF);
+      return executeIntToPtrInst(CE, SF);
   case Instruction::BitCast:
-      return executeBitCastInst(CE->getOperand(0), CE->getType(), SF);
+      return executeBitCastInst(CE, SF);
   case Instruction::GetElementPtr:
-    return executeGEPOperation(CE->getOperand(0), gep_type_begin(CE),
-                               gep_type_end(CE), SF);
+    return executeGEPOperation(CE, SF);
   case Instruction::FCmp:
   case Instruction::ICmp:
     return executeCmpInst(CE->getPredicate(),
@@ -1264,8 +1323,22 @@ GenericValue Interpreter::getOperandValue(Value *V, ExecutionContext &SF) {
   } else if (GlobalValue *GV = dyn_cast<GlobalValue>(V)) {
     return PTOGV(getPointerToGlobal(GV));
   } else {
-    return SF.Values[V];
+    assert(SF.Code->Locations.count(V) && "Value was never lowered!");
+    return getLocationValue(SF.Code->Locations.lookup(V), V->getType(), SF);
+  }
+}
+
+/// getOperandValue - Return the value of operand OpNo of U. Arguments and
+/// instructions used by the instruction SF is executing are read straight out
+/// of the locations resolved for them when the function was lowered.
+GenericValue Interpreter::getOperandValue(User *U, unsigned OpNo,
+                                          ExecutionContext &SF) {
+  if (U == SF.CurInstruction) {
+    unsigned Loc = SF.CurSlots[OpNo + 1];
+    if (Loc != FunctionCode::NoSlot)
+      return getLocationValue(Loc, U->getOperand(OpNo)->getType(), SF);
   }
+  return getOperandValue(U->getOperand(OpNo), SF);
 }
 
 //===----------------------------------------------------------------------===//
@@ -1284,6 +1357,10 @@ void Interpreter::callFunction(Function *F,
   ECStack.push_back(ExecutionContext());
   ExecutionContext &StackFrame = ECStack.back();
   StackFrame.CurFunction = F;
+  StackFrame.Code = 0;
+  StackFrame.PC = 0;
+  StackFrame.CurInstruction = 0;
+  StackFrame.CurSlots = 0;
 
   // Special handling for external functions.
   if (F->isDeclaration()) {
@@ -1293,9 +1370,24 @@ void Interpreter::callFunction(Function *F,
     return;
   }
 
-  // Get pointers to first LLVM BB & Instruction in function.
-  StackFrame.CurBB     = F->begin();
-  StackFrame.CurInst   = StackFrame.CurBB->begin();
+  // Hot functions run natively once the JIT has compiled them.
+  if (TierUp) {
+    GenericValue Result;
+    if (TierUp->runIfCompiled(F, ArgVals, Result)) {
+      popStackAndReturnValueToCaller(F->getReturnType(), Result);
+      return;
+    }
+  }
+
+  // Get pointers to first LLVM BB & op in function.
+  StackFrame.CurBB = F->begin();
+  StackFrame.Code  = getFunctionCode(F);
+  StackFrame.PC    = &StackFrame.Code->Ops[0];
+
+  // Make room for all of the function's values up front. The registers start
+  // out holding the constants the function uses.
+  StackFrame.Regs = StackFrame.Code->InitialRegs;
+  StackFrame.Values.resize(StackFrame.Code->NumGeneric);
 
   // Run through the function arguments and initialize their values...
   assert((ArgVals.size() == F->arg_size() ||
@@ -1304,47 +1396,314 @@ void Interpreter::callFunction(Function *F,
 
   // Handle non-varargs arguments...
   unsigned i = 0;
-  for (Function::arg_iterator AI = F->arg_begin(), E = F->arg_end(); 
+  for (Function::arg_iterator AI = F->arg_begin(), E = F->arg_end();
        AI != E; ++AI, ++i)
-    SetValue(AI, ArgVals[i], StackFrame);
+    setLocationValue(StackFrame.Code->ArgLocs[i], ArgVals[i], AI->getType(),
+                     StackFrame);
 
   // Handle varargs arguments...
   StackFrame.VarArgs.assign(ArgVals.begin()+i, ArgVals.end());
 }
 
 
+// The dispatch loop of run(). With GCC's labels as values, each op holds the
+// address of its handler and every handler jumps straight to the next one's.
+// Other compilers get a switch.
+#ifdef __GNUC__
+#define INTERP_OP(Name) case InterpOp::Name: Name##Handler:
+#define INTERP_DISPATCH()                                          \
+  do {                                                             \
+    ++Count;                                                       \
+    DEBUG(dbgs() << "About to interpret: " << *Op->Inst);          \
+    goto *Op->Handler;                                             \
+  } while (0)
+#else
+#define INTERP_OP(Name) case InterpOp::Name:
+#define INTERP_DISPATCH() goto Dispatch
+#endif
+#define INTERP_NEXT() do { ++Op; INTERP_DISPATCH(); } while (0)
+
 void Interpreter::run() {
-  while (!ECStack.empty()) {
-    // Interpret a single instruction & increment the "PC".
-    ExecutionContext &SF = ECStack.back();  // Current stack frame
-    Instruction &I = *SF.CurInst++;         // Increment before execute
-
-    // Track the number of dynamic instructions executed.
-    ++NumDynamicInsts;
-
-    DEBUG(dbgs() << "About to interpret: " << I);
-    visit(I);   // Dispatch to one of the visit* methods...
-#if 0
-    // This is not safe, as visiting the instruction could lower it and free I.
-DEBUG(
-    if (!isa<CallInst>(I) && !isa<InvokeInst>(I) && 
-        I.getType() != Type::VoidTy) {
-      dbgs() << "  --> ";
-      const GenericValue &Val = SF.Values[&I];
-      switch (I.getType()->getTypeID()) {
-      default: llvm_unreachable("Invalid GenericValue Type");
-      case Type::VoidTyID:    dbgs() << "void"; break;
-      case Type::FloatTyID:   dbgs() << "float " << Val.FloatVal; break;
-      case Type::DoubleTyID:  dbgs() << "double " << Val.DoubleVal; break;
-      case Type::PointerTyID: dbgs() << "void* " << intptr_t(Val.PointerVal);
-        break;
-      case Type::IntegerTyID: 
-        dbgs() << "i" << Val.IntVal.getBitWidth() << " "
-               << Val.IntVal.toStringUnsigned(10)
-               << " (0x" << Val.IntVal.toStringUnsigned(16) << ")\n";
-        break;
-      }
-    });
+#ifdef __GNUC__
+  static const void *const Handlers[] = {
+#define HANDLE_INTERP_OP(Name) &&Name##Handler,
+#include "Bytecode.def"
+  };
+#endif
+
+  ExecutionContext *SF;
+  FunctionCode *Code;
+  const InterpOp *Op;
+  uint64_t *R;
+  const InterpEdge *Edge;
+  SmallVector<uint64_t, 16> Temps;
+  unsigned Count = 0;
+
+  // Pick up the frame on top of the stack. This is where execution continues
+  // after every Generic op, since calls, returns and lowering intrinsics all
+  // change the stack or the code under it.
+Resume:
+  if (ECStack.empty()) {
+    NumDynamicInsts += Count;
+    return;
+  }
+  SF = &ECStack.back();
+  Code = SF->Code;
+  Op = SF->PC;
+  R = SF->Regs.empty() ? 0 : &SF->Regs[0];
+#ifdef __GNUC__
+  if (!Code->Threaded) {
+    for (std::vector<InterpOp>::iterator I = Code->Ops.begin(),
+         E = Code->Ops.end(); I != E; ++I)
+      I->Handler = Handlers[I->Opcode];
+    Code->Threaded = true;
+  }
 #endif
+  INTERP_DISPATCH();
+
+#ifndef __GNUC__
+Dispatch:
+  ++Count;
+  DEBUG(dbgs() << "About to interpret: " << *Op->Inst);
+#endif
+  switch (Op->Opcode) {
+  default: llvm_unreachable("Unknown interpreter opcode!");
+
+  INTERP_OP(Generic)
+  RunGeneric:
+    SF->CurInstruction = Op->Inst;
+    SF->CurSlots = &Code->Runs[Op->Run];
+    SF->PC = Op + 1;
+    NumDynamicInsts += Count;
+    Count = 0;
+    visit(*Op->Inst);   // Dispatch to one of the visit* methods...
+    goto Resume;
+
+  INTERP_OP(Add32) R[Op->Dst] = uint32_t(R[Op->A] + R[Op->B]); INTERP_NEXT();
+  INTERP_OP(Sub32) R[Op->Dst] = uint32_t(R[Op->A] - R[Op->B]); INTERP_NEXT();
+  INTERP_OP(Mul32) R[Op->Dst] = uint32_t(R[Op->A] * R[Op->B]); INTERP_NEXT();
+  INTERP_OP(Add64) R[Op->Dst] = R[Op->A] + R[Op->B]; INTERP_NEXT();
+  INTERP_OP(Sub64) R[Op->Dst] = R[Op->A] - R[Op->B]; INTERP_NEXT();
+  INTERP_OP(Mul64) R[Op->Dst] = R[Op->A] * R[Op->B]; INTERP_NEXT();
+  INTERP_OP(AddN) R[Op->Dst] = (R[Op->A] + R[Op->B]) & Op->Imm; INTERP_NEXT();
+  INTERP_OP(SubN) R[Op->Dst] = (R[Op->A] - R[Op->B]) & Op->Imm; INTERP_NEXT();
+  INTERP_OP(MulN) R[Op->Dst] = (R[Op->A] * R[Op->B]) & Op->Imm; INTERP_NEXT();
+  INTERP_OP(And) R[Op->Dst] = R[Op->A] & R[Op->B]; INTERP_NEXT();
+  INTERP_OP(Or)  R[Op->Dst] = R[Op->A] | R[Op->B]; INTERP_NEXT();
+  INTERP_OP(Xor) R[Op->Dst] = R[Op->A] ^ R[Op->B]; INTERP_NEXT();
+
+  // Shifting by the width or more leaves the value alone, as in visitShl.
+  INTERP_OP(Shl32)
+    R[Op->Dst] = R[Op->B] < 32 ? uint32_t(R[Op->A] << R[Op->B]) : R[Op->A];
+    INTERP_NEXT();
+  INTERP_OP(LShr32)
+    R[Op->Dst] = R[Op->B] < 32 ? R[Op->A] >> R[Op->B] : R[Op->A];
+    INTERP_NEXT();
+  INTERP_OP(AShr32)
+    R[Op->Dst] = R[Op->B] < 32 ?
+      uint32_t(int32_t(uint32_t(R[Op->A])) >> R[Op->B]) : R[Op->A];
+    INTERP_NEXT();
+  INTERP_OP(Shl64)
+    R[Op->Dst] = R[Op->B] < 64 ? R[Op->A] << R[Op->B] : R[Op->A];
+    INTERP_NEXT();
+  INTERP_OP(LShr64)
+    R[Op->Dst] = R[Op->B] < 64 ? R[Op->A] >> R[Op->B] : R[Op->A];
+    INTERP_NEXT();
+  INTERP_OP(AShr64)
+    R[Op->Dst] = R[Op->B] < 64 ? uint64_t(int64_t(R[Op->A]) >> R[Op->B]) :
+                                 R[Op->A];
+    INTERP_NEXT();
+
+  // Leave division by zero to APInt. Dividing the smallest signed value by -1
+  // wraps around, as APInt::sdiv does.
+  INTERP_OP(UDiv32)
+    if (!R[Op->B]) goto RunGeneric;
+    R[Op->Dst] = uint32_t(R[Op->A]) / uint32_t(R[Op->B]);
+    INTERP_NEXT();
+  INTERP_OP(SDiv32)
+    if (!R[Op->B]) goto RunGeneric;
+    R[Op->Dst] = int32_t(R[Op->B]) == -1 ? uint32_t(0U - uint32_t(R[Op->A])) :
+      uint32_t(int32_t(R[Op->A]) / int32_t(R[Op->B]));
+    INTERP_NEXT();
+  INTERP_OP(URem32)
+    if (!R[Op->B]) goto RunGeneric;
+    R[Op->Dst] = uint32_t(R[Op->A]) % uint32_t(R[Op->B]);
+    INTERP_NEXT();
+  INTERP_OP(SRem32)
+    if (!R[Op->B]) goto RunGeneric;
+    R[Op->Dst] = int32_t(R[Op->B]) == -1 ? 0 :
+      uint32_t(int32_t(R[Op->A]) % int32_t(R[Op->B]));
+    INTERP_NEXT();
+  INTERP_OP(UDiv64)
+    if (!R[Op->B]) goto RunGeneric;
+    R[Op->Dst] = R[Op->A] / R[Op->B];
+    INTERP_NEXT();
+  INTERP_OP(SDiv64)
+    if (!R[Op->B]) goto RunGeneric;
+    R[Op->Dst] = int64_t(R[Op->B]) == -1 ? 0ULL - R[Op->A] :
+      uint64_t(int64_t(R[Op->A]) / int64_t(R[Op->B]));
+    INTERP_NEXT();
+  INTERP_OP(URem64)
+    if (!R[Op->B]) goto RunGeneric;
+    R[Op->Dst] = R[Op->A] % R[Op->B];
+    INTERP_NEXT();
+  INTERP_OP(SRem64)
+    if (!R[Op->B]) goto RunGeneric;
+    R[Op->Dst] = int64_t(R[Op->B]) == -1 ? 0 :
+      uint64_t(int64_t(R[Op->A]) % int64_t(R[Op->B]));
+    INTERP_NEXT();
+
+#define INTERP_DOUBLE_OP(Name, OP)                                       \
+  INTERP_OP(Name)                                                        \
+    R[Op->Dst] = DoubleToBits(BitsToDouble(R[Op->A]) OP                  \
+                              BitsToDouble(R[Op->B]));                   \
+    INTERP_NEXT();
+  INTERP_DOUBLE_OP(FAdd, +)
+  INTERP_DOUBLE_OP(FSub, -)
+  INTERP_DOUBLE_OP(FMul, *)
+  INTERP_DOUBLE_OP(FDiv, /)
+#undef INTERP_DOUBLE_OP
+
+#define INTERP_ICMP(Name, OP)                                            \
+  INTERP_OP(Name) R[Op->Dst] = R[Op->A] OP R[Op->B]; INTERP_NEXT();
+#define INTERP_SIGNED_ICMP(Name, OP)                                     \
+  INTERP_OP(Name)                                                        \
+    R[Op->Dst] = int64_t(R[Op->A] << Op->Imm) OP                         \
+                 int64_t(R[Op->B] << Op->Imm);                           \
+    INTERP_NEXT();
+  INTERP_ICMP(ICmpEQ, ==)
+  INTERP_ICMP(ICmpNE, !=)
+  INTERP_ICMP(ICmpUGT, >)
+  INTERP_ICMP(ICmpUGE, >=)
+  INTERP_ICMP(ICmpULT, <)
+  INTERP_ICMP(ICmpULE, <=)
+  INTERP_SIGNED_ICMP(ICmpSGT, >)
+  INTERP_SIGNED_ICMP(ICmpSGE, >=)
+  INTERP_SIGNED_ICMP(ICmpSLT, <)
+  INTERP_SIGNED_ICMP(ICmpSLE, <=)
+#undef INTERP_ICMP
+#undef INTERP_SIGNED_ICMP
+
+  // The ordered comparisons are the plain C ones, like executeFCMP_OEQ and
+  // friends; the unordered ones are also true if either side is a NaN.
+#define INTERP_FCMP(Name, OP, UNORDERED)                                 \
+  INTERP_OP(Name) {                                                      \
+    double X = BitsToDouble(R[Op->A]), Y = BitsToDouble(R[Op->B]);       \
+    R[Op->Dst] = (UNORDERED && (X != X || Y != Y)) || (X OP Y);          \
+    INTERP_NEXT();                                                       \
+  }
+  INTERP_FCMP(FCmpOEQ, ==, false)
+  INTERP_FCMP(FCmpONE, !=, false)
+  INTERP_FCMP(FCmpOGT, >,  false)
+  INTERP_FCMP(FCmpOGE, >=, false)
+  INTERP_FCMP(FCmpOLT, <,  false)
+  INTERP_FCMP(FCmpOLE, <=, false)
+  INTERP_FCMP(FCmpUEQ, ==, true)
+  INTERP_FCMP(FCmpUNE, !=, true)
+  INTERP_FCMP(FCmpUGT, >,  true)
+  INTERP_FCMP(FCmpUGE, >=, true)
+  INTERP_FCMP(FCmpULT, <,  true)
+  INTERP_FCMP(FCmpULE, <=, true)
+#undef INTERP_FCMP
+  INTERP_OP(FCmpORD) {
+    double X = BitsToDouble(R[Op->A]), Y = BitsToDouble(R[Op->B]);
+    R[Op->Dst] = X == X && Y == Y;
+    INTERP_NEXT();
+  }
+  INTERP_OP(FCmpUNO) {
+    double X = BitsToDouble(R[Op->A]), Y = BitsToDouble(R[Op->B]);
+    R[Op->Dst] = X != X || Y != Y;
+    INTERP_NEXT();
+  }
+
+  INTERP_OP(Select)
+    R[Op->Dst] = R[Op->A] ? R[Op->B] : R[Op->C];
+    INTERP_NEXT();
+
+  INTERP_OP(Move) R[Op->Dst] = R[Op->A]; INTERP_NEXT();
+  INTERP_OP(Trunc) R[Op->Dst] = R[Op->A] & Op->Imm; INTERP_NEXT();
+  INTERP_OP(SExt)
+    R[Op->Dst] = uint64_t(int64_t(R[Op->A] << Op->B) >> Op->B) & Op->Imm;
+    INTERP_NEXT();
+  INTERP_OP(SIToFP)
+    R[Op->Dst] = DoubleToBits(double(int64_t(R[Op->A] << Op->Imm) >> Op->Imm));
+    INTERP_NEXT();
+  INTERP_OP(UIToFP)
+    R[Op->Dst] = DoubleToBits(double(R[Op->A]));
+    INTERP_NEXT();
+  INTERP_OP(FPExt)
+    R[Op->Dst] = DoubleToBits(double(BitsToFloat(uint32_t(R[Op->A]))));
+    INTERP_NEXT();
+  INTERP_OP(FPTrunc)
+    R[Op->Dst] = FloatToBits(float(BitsToDouble(R[Op->A])));
+    INTERP_NEXT();
+
+  // Memory may be misaligned, so go through memcpy, which compiles to a
+  // plain load or store where that is allowed anyway.
+#define INTERP_LOAD(Name, TY)                                            \
+  INTERP_OP(Name) {                                                      \
+    TY V;                                                                \
+    memcpy(&V, (void*)(intptr_t)R[Op->A], sizeof(V));                    \
+    R[Op->Dst] = V & Op->Imm;                                            \
+    INTERP_NEXT();                                                       \
+  }
+#define INTERP_STORE(Name, TY)                                           \
+  INTERP_OP(Name) {                                                      \
+    TY V = TY(R[Op->A]);                                                 \
+    memcpy((void*)(intptr_t)R[Op->B], &V, sizeof(V));                    \
+    INTERP_NEXT();                                                       \
+  }
+  INTERP_LOAD(Load8, uint8_t)
+  INTERP_LOAD(Load16, uint16_t)
+  INTERP_LOAD(Load32, uint32_t)
+  INTERP_LOAD(Load64, uint64_t)
+  INTERP_STORE(Store8, uint8_t)
+  INTERP_STORE(Store16, uint16_t)
+  INTERP_STORE(Store32, uint32_t)
+  INTERP_STORE(Store64, uint64_t)
+#undef INTERP_LOAD
+#undef INTERP_STORE
+
+  INTERP_OP(GEP) {
+    uint64_t Addr = R[Op->A] + Op->Imm;
+    for (unsigned i = Op->B; i != Op->C; ++i) {
+      const InterpGEPIndex &Idx = Code->GEPIndices[i];
+      Addr += uint64_t(int64_t(R[Idx.Reg] << Idx.Shift) >> Idx.Shift) *
+              Idx.Scale;
+    }
+    R[Op->Dst] = uintptr_t(Addr);
+    INTERP_NEXT();
+  }
+
+  INTERP_OP(Br)
+    Edge = &Code->Edges[Op->A];
+    goto TakeEdge;
+  INTERP_OP(CondBr)
+    Edge = &Code->Edges[R[Op->A] ? Op->B : Op->C];
+    goto TakeEdge;
+  }
+
+TakeEdge:
+  if (Edge->Slow) {
+    SwitchToNewBasicBlock(Edge->To, *SF);
+    Op = SF->PC;
+    INTERP_DISPATCH();
+  }
+  if (TierUp)
+    TierUp->noteBranch(Edge->From, Edge->To);
+  SF->CurBB = Edge->To;
+  if (!Edge->Parallel) {
+    for (unsigned i = Edge->MovesBegin; i != Edge->MovesEnd; ++i)
+      R[Code->Moves[i].first] = R[Code->Moves[i].second];
+  } else {
+    // Read every PHI node's input before writing any of them, as
+    // SwitchToNewBasicBlock does.
+    Temps.clear();
+    for (unsigned i = Edge->MovesBegin; i != Edge->MovesEnd; ++i)
+      Temps.push_back(R[Code->Moves[i].second]);
+    for (unsigned i = Edge->MovesBegin; i != Edge->MovesEnd; ++i)
+      R[Code->Moves[i].first] = Temps[i - Edge->MovesBegin];
   }
+  Op = &Code->Ops[Edge->Target];
+  INTERP_DISPATCH();
 }
@@ -17,9 +17,21 @@
 #include "llvm/CodeGen/IntrinsicLowering.h"
 #include "llvm/DerivedTypes.h"
 #include "llvm/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include <cstring>
 using namespace llvm;
 
+static cl::opt<unsigned>
+TierUpThreshold("interpreter-jit-threshold",
+  cl::desc("Compile functions with the JIT once they have been called or "
+           "looped this many times (0 = never)"),
+  cl::init(0));
+
+static cl::opt<bool>
+TierUpInForeground("interpreter-jit-sync", cl::Hidden,
+  cl::desc("Compile hot functions on the interpreter's thread instead of in "
+           "the background"));
+
 namespace {
 
 static struct RegisterInterp {
@@ -55,9 +67,18 @@ Interpreter::Interpreter(Module *M)
   emitGlobals();
 
   IL = new IntrinsicLowering(TD);
+
+  TierUp = 0;
+  if (TierUpThreshold)
+    TierUp = new InterpreterTierUp(*this, *M, TierUpThreshold,
+                                   !TierUpInForeground);
 }
 
 Interpreter::~Interpreter() {
+  for (DenseMap<const Function*, FunctionCode*>::iterator
+       I = FunctionCodes.begin(), E = FunctionCodes.end(); I != E; ++I)
+    delete I->second;
+  delete TierUp;
   delete IL;
 }
 
@@ -18,14 +18,19 @@
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/Target/TargetData.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/Atomic.h"
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/InstVisitor.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/raw_ostream.h"
+#include <deque>
 namespace llvm {
 
 class IntrinsicLowering;
+class Interpreter;
 struct FunctionInfo;
 template<typename T> class generic_gep_type_iterator;
 class ConstantExpr;
@@ -64,20 +69,186 @@ public:
 
 typedef std::vector<GenericValue> ValuePlaneTy;
 
+// InterpOp - One operation of the register bytecode that a function is
+// lowered to before it first runs; Bytecode.def lists the opcodes. Every
+// integer of up to 64 bits, pointer, float and double value of a frame lives
+// in one of its 64-bit registers. Other values live in its generic slots, and
+// the instructions using them run as Generic ops, which hand Inst to the
+// InstVisitor. So do calls, returns, switches and everything else without a
+// fast path of its own.
+//
+struct InterpOp {
+  enum {
+#define HANDLE_INTERP_OP(Name) Name,
+#include "Bytecode.def"
+    NumOpcodes
+  };
+  const void *Handler;      // Where run() dispatches to, once threaded
+  unsigned Opcode;
+  unsigned Dst, A, B, C;    // Registers, or indices into the code's tables
+  uint64_t Imm;             // A mask, shift amount or offset
+  Instruction *Inst;        // The instruction this op was lowered from
+  unsigned Run;             // Inst's run in FunctionCode::Runs
+};
+
+// InterpEdge - A branch from one block to another, together with the register
+// moves that give the destination's PHI nodes their values. Slow edges have
+// PHI nodes that don't live in registers and go through
+// SwitchToNewBasicBlock instead. Parallel edges have a move that reads a
+// register an earlier one writes, so they read all sources first.
+//
+struct InterpEdge {
+  BasicBlock *From, *To;
+  unsigned Target;                  // The op To starts at
+  unsigned MovesBegin, MovesEnd;    // Its range in FunctionCode::Moves
+  bool Slow, Parallel;
+};
+
+// InterpGEPIndex - A variable index of a lowered getelementptr, which adds
+// the index, sign extended by shifting left and back by Shift, times Scale.
+//
+struct InterpGEPIndex {
+  unsigned Reg;
+  unsigned Shift;
+  uint64_t Scale;
+};
+
+// FunctionCode - A function lowered to the interpreter's bytecode. Locations
+// maps each argument and instruction of the function, and each constant
+// preloaded into a register, to its register, or to its generic slot with
+// GenericSlot set. Locations are never reused, so the instructions that
+// IntrinsicLowering inserts into a running function get locations of their
+// own when it is lowered again. InitialRegs holds the constants' values and
+// is what each new frame's registers start out as.
+//
+// Runs holds one run per op, for the Generic path: the location of the
+// instruction itself, then one for each operand, NoSlot for void results and
+// for operands that are not arguments or instructions.
+//
+struct FunctionCode {
+  enum { NoSlot = ~0U, GenericSlot = 1U << 31 };
+  DenseMap<const Value*, unsigned> Locations;
+  unsigned NumRegs, NumGeneric;
+  std::vector<uint64_t> InitialRegs;
+  std::vector<unsigned> ArgLocs;
+  std::vector<InterpOp> Ops;
+  std::vector<unsigned> Runs;
+  std::vector<InterpEdge> Edges;
+  std::vector<std::pair<unsigned, unsigned> > Moves;  // (Dst, Src) registers
+  std::vector<InterpGEPIndex> GEPIndices;
+  DenseMap<const BasicBlock*, unsigned> BlockStart;   // Op of first non-PHI
+  bool Threaded;            // The ops' Handlers have been filled in.
+
+  FunctionCode() : NumRegs(0), NumGeneric(0), Threaded(false) {}
+
+  /// isWordType - Return true if values of type Ty live in registers.
+  static bool isWordType(const Type *Ty);
+
+  /// toWord/fromWord - Convert between a value of type Ty in its generic form
+  /// and its register form.
+  static uint64_t toWord(const GenericValue &Val, const Type *Ty);
+  static GenericValue fromWord(uint64_t Word, const Type *Ty);
+};
+
 // ExecutionContext struct - This struct represents one stack frame currently
 // executing.
 //
 struct ExecutionContext {
   Function             *CurFunction;// The currently executing function
   BasicBlock           *CurBB;      // The currently executing BB
-  BasicBlock::iterator  CurInst;    // The next instruction to execute
-  std::map<Value *, GenericValue> Values; // LLVM values used in this invocation
+  FunctionCode         *Code;       // CurFunction, lowered to bytecode
+  const InterpOp       *PC;         // The next op to execute
+  Instruction          *CurInstruction; // The instruction a Generic op runs
+  const unsigned       *CurSlots;   // Its run in Code->Runs
+  std::vector<uint64_t> Regs;       // Values in registers, by register
+  ValuePlaneTy          Values;     // Other LLVM values used in this
+                                    // invocation, by generic slot
   std::vector<GenericValue>  VarArgs; // Values passed through an ellipsis
   CallSite             Caller;     // Holds the call that called subframes.
                                    // NULL if main func or debugger invoked fn
   AllocaHolderHandle    Allocas;    // Track memory allocated by alloca
 };
 
+// InterpreterTierUp - Counts the calls and loop back edges executed in each
+// function. Once a function is hot enough it is compiled, together with
+// everything it calls, by the JIT on a background thread, and calls to it
+// that start after the code is ready run natively. The JIT works on a clone
+// of the module whose globals are mapped onto the interpreter's, so both
+// tiers share the program's memory.
+//
+class InterpreterTierUp {
+  Interpreter &Interp;
+  Module &M;
+  unsigned Threshold;
+  bool Background;            // Compile on a separate thread.
+
+  // The JIT and the module it compiles, created when the first function gets
+  // hot. Clones maps each function to its copy in that module.
+  ExecutionEngine *JIT;
+  bool JITFailed;
+  DenseMap<const Function*, Function*> Clones;
+
+  // A function handed to the compile thread. The compile thread sets Entry,
+  // which stays null if F can't be compiled, and then Done. The interpreter
+  // only looks at Entry once it has seen Done.
+  struct CompileRequest {
+    Function *F;
+    Function *Callee;            // F's copy in the JIT's module.
+    void (*Entry)(uint64_t *);
+    volatile sys::cas_flag Done;
+  };
+
+  struct FunctionState {
+    unsigned Count;             // Calls and back edges executed so far.
+    bool Rejected;              // Can't be compiled, keep interpreting.
+    CompileRequest *Request;    // Set once F has been handed to the JIT.
+    void (*Entry)(uint64_t *);  // Native entry taking marshalled arguments.
+    FunctionState() : Count(0), Rejected(false), Request(0), Entry(0) {}
+  };
+  DenseMap<const Function*, FunctionState> Functions;
+  DenseMap<const Function*, bool> LocallyCompilable;
+  DenseMap<const BasicBlock*, unsigned> BlockNumbers;
+
+  // Requests owns every CompileRequest. Queue holds the ones the compile
+  // thread has yet to start on; it and the thread's state are guarded by
+  // QueueLock. CompileThreadRunning is cleared by the thread, with the lock
+  // held, right before it exits.
+  std::vector<CompileRequest*> Requests;
+  std::deque<CompileRequest*> Queue;
+  sys::Mutex QueueLock;
+  void *CompileThread;
+  bool CompileThreadRunning;
+  bool ShuttingDown;
+  bool StartedMultithreading;
+
+  bool createJIT();
+  bool isLocallyCompilable(const Function *F);
+  bool isCompilable(Function *F);
+  CompileRequest *requestCompile(Function *F);
+  void compile(CompileRequest *R);
+
+  static void CompileThreadMain(void *TierUp);
+  void runCompileThread();
+
+public:
+  InterpreterTierUp(Interpreter &I, Module &M, unsigned Threshold,
+                    bool Background);
+  ~InterpreterTierUp();
+
+  /// noteBranch - Record a branch from one block to another, counting it
+  /// against the function if it's a loop back edge.
+  void noteBranch(const BasicBlock *From, const BasicBlock *To);
+
+  /// runIfCompiled - Count a call to F. If F has been compiled, run the
+  /// native code, set Result and return true.
+  bool runIfCompiled(Function *F, const std::vector<GenericValue> &ArgVals,
+                     GenericValue &Result);
+
+  /// stopCompiling - Drop the functions waiting to be compiled and wait for
+  /// the compile thread to finish the one it is working on.
+  void stopCompiling();
+};
+
 // Interpreter - This class represents the entirety of the interpreter.
 //
 class Interpreter : public ExecutionEngine, public InstVisitor<Interpreter> {
@@ -93,6 +264,13 @@ class Interpreter : public ExecutionEngine, public InstVisitor<Interpreter> {
   // registered with the atexit() library function.
   std::vector<Function*> AtExitHandlers;
 
+  // TierUp - Hands hot functions over to the JIT, if tiered execution was
+  // requested with -interpreter-jit-threshold.
+  InterpreterTierUp *TierUp;
+
+  // FunctionCodes - The bytecode of each function executed so far.
+  DenseMap<const Function*, FunctionCode*> FunctionCodes;
+
 public:
   explicit Interpreter(Module *M);
   ~Interpreter();
@@ -191,8 +369,7 @@ public:
   }
 
 private:  // Helper functions
-  GenericValue executeGEPOperation(Value *Ptr, gep_type_iterator I,
-                                   gep_type_iterator E, ExecutionContext &SF);
+  GenericValue executeGEPOperation(User *GEP, ExecutionContext &SF);
 
   // SwitchToNewBasicBlock - Start execution in a new basic block and run any
   // PHI nodes in the top of the block.  This is used for intraprocedural
@@ -203,34 +380,31 @@ private:  // Helper functions
   void *getPointerToFunction(Function *F) { return (void*)F; }
   void *getPointerToBasicBlock(BasicBlock *BB) { return (void*)BB; }
 
+  // Lowering to bytecode, in Bytecode.cpp.
+  FunctionCode *getFunctionCode(Function *F);
+  void lowerFunction(Function *F, FunctionCode &Code);
+  void lowerInstruction(Instruction *I, FunctionCode &Code);
+  unsigned lowerEdge(BasicBlock *From, BasicBlock *To, FunctionCode &Code);
+  unsigned getRegister(Value *V, FunctionCode &Code);
+  void relowerFunction(Function *F, const std::vector<Instruction*> &Resume);
+
   void initializeExecutionEngine() { }
   void initializeExternalFunctions();
   GenericValue getConstantExprValue(ConstantExpr *CE, ExecutionContext &SF);
   GenericValue getOperandValue(Value *V, ExecutionContext &SF);
-  GenericValue executeTruncInst(Value *SrcVal, const Type *DstTy,
-                                ExecutionContext &SF);
-  GenericValue executeSExtInst(Value *SrcVal, const Type *DstTy,
-                               ExecutionContext &SF);
-  GenericValue executeZExtInst(Value *SrcVal, const Type *DstTy,
-                               ExecutionContext &SF);
-  GenericValue executeFPTruncInst(Value *SrcVal, const Type *DstTy,
-                                  ExecutionContext &SF);
-  GenericValue executeFPExtInst(Value *SrcVal, const Type *DstTy,
-                                ExecutionContext &SF);
-  GenericValue executeFPToUIInst(Value *SrcVal, const Type *DstTy,
-                                 ExecutionContext &SF);
-  GenericValue executeFPToSIInst(Value *SrcVal, const Type *DstTy,
-                                 ExecutionContext &SF);
-  GenericValue executeUIToFPInst(Value *SrcVal, const Type *DstTy,
-                                 ExecutionContext &SF);
-  GenericValue executeSIToFPInst(Value *SrcVal, const Type *DstTy,
-                                 ExecutionContext &SF);
-  GenericValue executePtrToIntInst(Value *SrcVal, const Type *DstTy,
-                                   ExecutionContext &SF);
-  GenericValue executeIntToPtrInst(Value *SrcVal, const Type *DstTy,
-                                   ExecutionContext &SF);
-  GenericValue executeBitCastInst(Value *SrcVal, const Type *DstTy,
-                                  ExecutionContext &SF);
+  GenericValue getOperandValue(User *U, unsigned OpNo, ExecutionContext &SF);
+  GenericValue executeTruncInst(User *Cast, ExecutionContext &SF);
+  GenericValue executeSExtInst(User *Cast, ExecutionContext &SF);
+  GenericValue executeZExtInst(User *Cast, ExecutionContext &SF);
+  GenericValue executeFPTruncInst(User *Cast, ExecutionContext &SF);
+  GenericValue executeFPExtInst(User *Cast, ExecutionContext &SF);
+  GenericValue executeFPToUIInst(User *Cast, ExecutionContext &SF);
+  GenericValue executeFPToSIInst(User *Cast, ExecutionContext &SF);
+  GenericValue executeUIToFPInst(User *Cast, ExecutionContext &SF);
+  GenericValue executeSIToFPInst(User *Cast, ExecutionContext &SF);
+  GenericValue executePtrToIntInst(User *Cast, ExecutionContext &SF);
+  GenericValue executeIntToPtrInst(User *Cast, ExecutionContext &SF);
+  GenericValue executeBitCastInst(User *Cast, ExecutionContext &SF);
   GenericValue executeCastOperation(Instruction::CastOps opcode, Value *SrcVal, 
                                     const Type *Ty, ExecutionContext &SF);
   void popStackAndReturnValueToCaller(const Type *RetTy, GenericValue Result);
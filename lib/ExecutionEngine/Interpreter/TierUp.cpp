@@ -0,0 +1,418 @@
+//===-- TierUp.cpp - Hand hot functions from the interpreter to the JIT ---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements tiered execution for the interpreter: functions start
+// out interpreted, and the ones that turn out to be hot are compiled with the
+// JIT on a background thread while the interpreter keeps going.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "interpreter"
+#include "Interpreter.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <algorithm>
+#include <cstring>
+using namespace llvm;
+
+STATISTIC(NumRequested, "Number of functions handed over to the JIT");
+STATISTIC(NumTieredUp, "Number of functions compiled by the JIT");
+STATISTIC(NumNativeCalls, "Number of calls run natively");
+
+InterpreterTierUp::InterpreterTierUp(Interpreter &I, Module &m,
+                                     unsigned threshold, bool background)
+  : Interp(I), M(m), Threshold(threshold), Background(background), JIT(0),
+    JITFailed(false), CompileThread(0), CompileThreadRunning(false),
+    ShuttingDown(false), StartedMultithreading(false) {}
+
+InterpreterTierUp::~InterpreterTierUp() {
+  stopCompiling();
+  if (StartedMultithreading)
+    llvm_stop_multithreaded();
+
+  for (unsigned i = 0, e = Requests.size(); i != e; ++i)
+    delete Requests[i];
+  // The JIT owns the cloned module.
+  delete JIT;
+}
+
+void InterpreterTierUp::stopCompiling() {
+  {
+    sys::ScopedLock Guard(QueueLock);
+    ShuttingDown = true;
+    Queue.clear();
+  }
+  if (CompileThread) {
+    llvm_join_thread(CompileThread);
+    CompileThread = 0;
+  }
+}
+
+void InterpreterTierUp::noteBranch(const BasicBlock *From,
+                                   const BasicBlock *To) {
+  // Number the blocks of a function in layout order the first time we branch
+  // within it, so that back edges can be recognized cheaply.
+  DenseMap<const BasicBlock*, unsigned>::iterator FromI =
+    BlockNumbers.find(From);
+  if (FromI == BlockNumbers.end()) {
+    const Function *F = From->getParent();
+    unsigned Num = 0;
+    for (Function::const_iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+      BlockNumbers[BB] = Num++;
+    FromI = BlockNumbers.find(From);
+  }
+  if (BlockNumbers.lookup(To) <= FromI->second)
+    ++Functions[From->getParent()].Count;
+}
+
+/// referencesFunction - Return true if the constant C takes the address of a
+/// function or a basic block.
+static bool referencesFunction(const Constant *C) {
+  if (isa<Function>(C) || isa<BlockAddress>(C))
+    return true;
+  if (isa<GlobalValue>(C))
+    return false;
+  for (User::const_op_iterator I = C->op_begin(), E = C->op_end(); I != E; ++I)
+    if (referencesFunction(cast<Constant>(*I)))
+      return true;
+  return false;
+}
+
+/// isLocallyCompilable - Return true if the body of F can run natively. The
+/// interpreter represents function pointers as Function*, so native code must
+/// neither create function pointers nor call through them.
+bool InterpreterTierUp::isLocallyCompilable(const Function *F) {
+  DenseMap<const Function*, bool>::iterator I = LocallyCompilable.find(F);
+  if (I != LocallyCompilable.end())
+    return I->second;
+
+  bool Result = true;
+  for (Function::const_iterator BB = F->begin(), BE = F->end();
+       BB != BE && Result; ++BB)
+    for (BasicBlock::const_iterator II = BB->begin(), IE = BB->end();
+         II != IE && Result; ++II) {
+      // Unwinding can't cross between the tiers.
+      if (isa<InvokeInst>(II) || isa<UnwindInst>(II) ||
+          isa<IndirectBrInst>(II)) {
+        Result = false;
+        break;
+      }
+
+      unsigned NumOperands = II->getNumOperands();
+      if (const CallInst *CI = dyn_cast<CallInst>(II)) {
+        if (!CI->getCalledFunction()) {
+          Result = false;
+          break;
+        }
+        NumOperands = CI->getNumArgOperands();
+      }
+      for (unsigned i = 0; i != NumOperands; ++i)
+        if (const Constant *C = dyn_cast<Constant>(II->getOperand(i)))
+          if (referencesFunction(C)) {
+            Result = false;
+            break;
+          }
+    }
+
+  LocallyCompilable[F] = Result;
+  return Result;
+}
+
+/// isCompilable - Return true if F and every function it can call can run
+/// natively.
+bool InterpreterTierUp::isCompilable(Function *F) {
+  SmallVector<Function*, 16> Worklist;
+  SmallPtrSet<Function*, 16> Visited;
+  Worklist.push_back(F);
+  Visited.insert(F);
+  while (!Worklist.empty()) {
+    Function *G = Worklist.pop_back_val();
+    if (G->isDeclaration()) {
+      // The interpreter implements these itself, so that atexit handlers run
+      // interpreted and exit() unwinds the interpreter.
+      if (G->getName() == "exit" || G->getName() == "atexit")
+        return false;
+      continue;
+    }
+    if (!isLocallyCompilable(G))
+      return false;
+    for (Function::iterator BB = G->begin(), BE = G->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+        if (CallInst *CI = dyn_cast<CallInst>(I))
+          if (Visited.insert(CI->getCalledFunction()))
+            Worklist.push_back(CI->getCalledFunction());
+  }
+  return true;
+}
+
+bool InterpreterTierUp::createJIT() {
+  if (JIT || JITFailed)
+    return JIT != 0;
+
+  // The JIT lowers the functions it compiles in place, which must not happen
+  // to code the interpreter may still be executing, so it gets a copy.
+  ValueToValueMapTy VMap;
+  Module *Clone = CloneModule(&M, VMap);
+  std::string ErrorStr;
+  JIT = EngineBuilder(Clone).setEngineKind(EngineKind::JIT)
+                            .setErrorStr(&ErrorStr).create();
+  if (!JIT) {
+    DEBUG(dbgs() << "Unable to create a JIT for tiered execution: "
+                 << ErrorStr << "\n");
+    delete Clone;
+    JITFailed = true;
+    return false;
+  }
+
+  // The tiers share memory, so they must agree on how it is laid out. A
+  // module without a data layout is interpreted with the big-endian default.
+  if (JIT->getTargetData()->getStringRepresentation() !=
+      Interp.getTargetData()->getStringRepresentation()) {
+    DEBUG(dbgs() << "Not tiering up: the module's data layout doesn't match "
+                 << "the host's\n");
+    delete JIT;
+    JIT = 0;
+    JITFailed = true;
+    return false;
+  }
+
+  // Share the interpreter's globals.
+  for (Module::global_iterator I = M.global_begin(), E = M.global_end();
+       I != E; ++I) {
+    Value *V = VMap[I];
+    JIT->addGlobalMapping(cast<GlobalValue>(V), Interp.getPointerToGlobal(I));
+  }
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
+    Value *V = VMap[I];
+    Clones[I] = cast<Function>(V);
+  }
+  return true;
+}
+
+/// isMarshallableType - Return true if values of type Ty can be passed to and
+/// from native code in a 64-bit slot.
+static bool isMarshallableType(const Type *Ty) {
+  if (const IntegerType *ITy = dyn_cast<IntegerType>(Ty))
+    return ITy->getBitWidth() <= 64;
+  return Ty->isFloatTy() || Ty->isDoubleTy() || Ty->isPointerTy();
+}
+
+/// requestCompile - Hand F to the JIT, unless it can't run natively.  The
+/// native entry point will take an array of 64-bit slots holding the
+/// arguments and receive the return value in the first slot.
+InterpreterTierUp::CompileRequest *
+InterpreterTierUp::requestCompile(Function *F) {
+  const FunctionType *FTy = F->getFunctionType();
+  if (FTy->isVarArg())
+    return 0;
+  if (!FTy->getReturnType()->isVoidTy() &&
+      !isMarshallableType(FTy->getReturnType()))
+    return 0;
+  for (unsigned i = 0, e = FTy->getNumParams(); i != e; ++i)
+    if (!isMarshallableType(FTy->getParamType(i)))
+      return 0;
+  if (!isCompilable(F) || !createJIT())
+    return 0;
+
+  CompileRequest *R = new CompileRequest();
+  R->F = F;
+  R->Callee = Clones.lookup(F);
+  R->Entry = 0;
+  R->Done = 0;
+  Requests.push_back(R);
+  DEBUG(dbgs() << "Handing '" << F->getName() << "' to the JIT\n");
+  ++NumRequested;
+
+  // The JIT shares the LLVMContext with the interpreter, which creates
+  // constants of its own as it lowers intrinsics, so the context has to be
+  // locked once a second thread uses it.
+  if (Background && !llvm_is_multithreaded())
+    StartedMultithreading = llvm_start_multithreaded();
+
+  if (Background && llvm_is_multithreaded()) {
+    sys::ScopedLock Guard(QueueLock);
+    if (ShuttingDown)
+      return R;
+    Queue.push_back(R);
+    if (CompileThreadRunning)
+      return R;
+
+    // The previous thread, if any, has already given up the lock for good.
+    if (CompileThread)
+      llvm_join_thread(CompileThread);
+    CompileThreadRunning = true;
+    CompileThread = llvm_start_thread(CompileThreadMain, this);
+    if (CompileThread)
+      return R;
+    CompileThreadRunning = false;
+    Queue.pop_back();
+  }
+
+  // No compile thread; compile right away.
+  compile(R);
+  return R;
+}
+
+void InterpreterTierUp::CompileThreadMain(void *TierUp) {
+  static_cast<InterpreterTierUp*>(TierUp)->runCompileThread();
+}
+
+/// runCompileThread - Compile the requests in Queue until it is empty.
+void InterpreterTierUp::runCompileThread() {
+  while (true) {
+    CompileRequest *R;
+    {
+      sys::ScopedLock Guard(QueueLock);
+      if (ShuttingDown || Queue.empty()) {
+        CompileThreadRunning = false;
+        return;
+      }
+      R = Queue.front();
+      Queue.pop_front();
+    }
+    compile(R);
+  }
+}
+
+/// compile - Build the entry wrapper for R's function in the JIT's module,
+/// compile it and publish the entry point.
+void InterpreterTierUp::compile(CompileRequest *R) {
+  void *Entry;
+  {
+    // Native code running on the interpreter's thread may be compiling
+    // through a lazy stub, which also changes the JIT's module.
+    MutexGuard Locked(JIT->lock);
+
+    Function *Callee = R->Callee;
+    const FunctionType *FTy = Callee->getFunctionType();
+    LLVMContext &Context = Callee->getContext();
+    const Type *SlotTy = Type::getInt64Ty(Context);
+    std::vector<const Type*> Params(1, PointerType::getUnqual(SlotTy));
+    Function *Wrapper =
+      Function::Create(FunctionType::get(Type::getVoidTy(Context), Params,
+                                         false),
+                       GlobalValue::InternalLinkage,
+                       "tierup." + Callee->getName(), Callee->getParent());
+    IRBuilder<> Builder(BasicBlock::Create(Context, "entry", Wrapper));
+    Value *Slots = Wrapper->arg_begin();
+
+    std::vector<Value*> Args;
+    for (unsigned i = 0, e = FTy->getNumParams(); i != e; ++i) {
+      const Type *Ty = FTy->getParamType(i);
+      Value *Slot = Builder.CreateConstGEP1_32(Slots, i);
+      if (Ty->isFloatingPointTy()) {
+        Slot = Builder.CreateBitCast(Slot, PointerType::getUnqual(Ty));
+        Args.push_back(Builder.CreateLoad(Slot));
+        continue;
+      }
+      Value *Arg = Builder.CreateLoad(Slot);
+      if (Ty->isPointerTy())
+        Arg = Builder.CreateIntToPtr(Arg, Ty);
+      else
+        Arg = Builder.CreateTrunc(Arg, Ty);
+      Args.push_back(Arg);
+    }
+
+    CallInst *Call = Builder.CreateCall(Callee, Args.begin(), Args.end());
+    Call->setCallingConv(Callee->getCallingConv());
+
+    const Type *RetTy = FTy->getReturnType();
+    if (RetTy->isFloatingPointTy())
+      Builder.CreateStore(Call,
+                          Builder.CreateBitCast(Slots,
+                                                PointerType::getUnqual(RetTy)));
+    else if (RetTy->isPointerTy())
+      Builder.CreateStore(Builder.CreatePtrToInt(Call, SlotTy), Slots);
+    else if (!RetTy->isVoidTy())
+      Builder.CreateStore(Builder.CreateZExt(Call, SlotTy), Slots);
+    Builder.CreateRetVoid();
+
+    Entry = JIT->getPointerToFunction(Wrapper);
+  }
+
+  DEBUG(dbgs() << "The JIT compiled '" << R->F->getName() << "'\n");
+  ++NumTieredUp;
+
+  // Publish the entry point before saying it is there.
+  R->Entry = (void(*)(uint64_t*))(intptr_t)Entry;
+  sys::MemoryFence();
+  R->Done = 1;
+}
+
+bool InterpreterTierUp::runIfCompiled(Function *F,
+                                      const std::vector<GenericValue> &ArgVals,
+                                      GenericValue &Result) {
+  FunctionState &State = Functions[F];
+  if (!State.Entry) {
+    if (State.Rejected)
+      return false;
+    if (!State.Request) {
+      if (++State.Count < Threshold)
+        return false;
+      CompileRequest *R = requestCompile(F);
+      // requestCompile() may have grown the map.
+      FunctionState &NewState = Functions[F];
+      if (!R) {
+        NewState.Rejected = true;
+        return false;
+      }
+      NewState.Request = R;
+      return runIfCompiled(F, ArgVals, Result);
+    }
+
+    // Keep interpreting until the compile thread is done with F.
+    CompileRequest *R = State.Request;
+    if (!R->Done)
+      return false;
+    sys::MemoryFence();
+    if (!R->Entry) {
+      State.Rejected = true;
+      return false;
+    }
+    State.Entry = R->Entry;
+  }
+  // Marshal the arguments into 64-bit slots.
+  const FunctionType *FTy = F->getFunctionType();
+  unsigned NumSlots = std::max(FTy->getNumParams(), 1U);
+  SmallVector<uint64_t, 8> Slots(NumSlots);
+  for (unsigned i = 0, e = FTy->getNumParams(); i != e; ++i) {
+    const Type *Ty = FTy->getParamType(i);
+    if (Ty->isFloatTy())
+      memcpy(&Slots[i], &ArgVals[i].FloatVal, sizeof(float));
+    else if (Ty->isDoubleTy())
+      memcpy(&Slots[i], &ArgVals[i].DoubleVal, sizeof(double));
+    else if (Ty->isPointerTy())
+      Slots[i] = (uint64_t)(intptr_t)ArgVals[i].PointerVal;
+    else
+      Slots[i] = ArgVals[i].IntVal.getZExtValue();
+  }
+
+  ++NumNativeCalls;
+  State.Entry(Slots.data());
+
+  const Type *RetTy = FTy->getReturnType();
+  if (RetTy->isFloatTy())
+    memcpy(&Result.FloatVal, &Slots[0], sizeof(float));
+  else if (RetTy->isDoubleTy())
+    memcpy(&Result.DoubleVal, &Slots[0], sizeof(double));
+  else if (RetTy->isPointerTy())
+    Result.PointerVal = (void*)(intptr_t)Slots[0];
+  else if (const IntegerType *ITy = dyn_cast<IntegerType>(RetTy))
+    Result.IntVal = APInt(ITy->getBitWidth(), Slots[0]);
+  return true;
+}
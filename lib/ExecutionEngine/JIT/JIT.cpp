@@ -12,6 +12,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#define DEBUG_TYPE "jit"
 #include "JIT.h"
 #include "llvm/Constants.h"
 #include "llvm/DerivedTypes.h"
@@ -19,6 +20,7 @@
 #include "llvm/GlobalVariable.h"
 #include "llvm/Instructions.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/CodeGen/JITCodeEmitter.h"
 #include "llvm/CodeGen/MachineCodeInfo.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
@@ -26,15 +28,22 @@
 #include "llvm/Target/TargetData.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetJITInfo.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/Dwarf.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MutexGuard.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
 #include "llvm/Config/config.h"
+#include <algorithm>
 
 using namespace llvm;
 
+STATISTIC(NumSpeculated, "Number of functions compiled ahead of a call");
+
 #ifdef __APPLE__
 // Apple gcc defaults to -fuse-cxa-atexit (i.e. calls __cxa_atexit instead
 // of atexit). It passes the address of linker generated symbol __dso_handle
@@ -270,7 +279,8 @@ extern "C" {
 JIT::JIT(Module *M, TargetMachine &tm, TargetJITInfo &tji,
          JITMemoryManager *JMM, CodeGenOpt::Level OptLevel, bool GVsWithCode)
   : ExecutionEngine(M), TM(tm), TJI(tji), AllocateGVsWithCode(GVsWithCode),
-    isAlreadyCodeGenerating(false) {
+    isAlreadyCodeGenerating(false), CompileThread(0),
+    CompileThreadRunning(false), ShuttingDown(false) {
   setTargetData(TM.getTargetData());
 
   jitstate = new JITState(M);
@@ -317,6 +327,15 @@ JIT::JIT(Module *M, TargetMachine &tm, TargetJITInfo &tji,
 }
 
 JIT::~JIT() {
+  // Let the compile thread finish the function it is working on and exit.
+  {
+    MutexGuard locked(lock);
+    ShuttingDown = true;
+    SpeculationQueue.clear();
+  }
+  if (CompileThread)
+    llvm_join_thread(CompileThread);
+
   // Unregister all exception tables registered by this JIT.
   DeregisterAllTables();
   // Cleanup.
@@ -355,10 +374,11 @@ void JIT::addModule(Module *M) {
 /// removeModule - If we are removing the last Module, invalidate the jitstate
 /// since the PassManager it contains references a released Module.
 bool JIT::removeModule(Module *M) {
-  bool result = ExecutionEngine::removeModule(M);
-
+  // The compile thread looks at the module list.
   MutexGuard locked(lock);
 
+  bool result = ExecutionEngine::removeModule(M);
+
   if (jitstate->getModule() == M) {
     delete jitstate;
     jitstate = 0;
@@ -487,6 +507,10 @@ GenericValue JIT::runFunction(Function *F,
   // function we are interested in, passing in constants for all of the
   // arguments.  Make this function and return.
 
+  // The compile thread may be generating code from the IR, so hold the lock
+  // while changing it, but not while running the stub.
+  lock.acquire();
+
   // First, create the function.
   FunctionType *STy=FunctionType::get(RetTy, false);
   Function *Stub = Function::Create(STy, Function::InternalLinkage, "",
@@ -543,9 +567,12 @@ GenericValue JIT::runFunction(Function *F,
   else
     ReturnInst::Create(F->getContext(), StubBB);           // Just return void.
 
+  lock.release();
+
   // Finally, call our nullary stub function.
   GenericValue Result = runFunction(Stub, std::vector<GenericValue>());
   // Erase it, since no other function can have a reference to it.
+  MutexGuard locked(lock);
   Stub->eraseFromParent();
   // And return the result.
   return Result;
@@ -617,6 +644,7 @@ void JIT::runJITOnFunctionUnlocked(Function *F, const MutexGuard &locked) {
   assert(!isAlreadyCodeGenerating && "Error: Recursive compilation detected!");
 
   jitTheFunction(F, locked);
+  queueCallees(F, locked);
 
   // If the function referred to another function that had not yet been
   // read from bitcode, and we are jitting non-lazily, emit it now.
@@ -644,6 +672,73 @@ void JIT::jitTheFunction(Function *F, const MutexGuard &locked) {
   getBasicBlockAddressMap(locked).clear();
 }
 
+void JIT::queueCallees(Function *F, const MutexGuard &locked) {
+  if (!isCompilingLazily() || !isCompilingSpeculatively() || ShuttingDown)
+    return;
+
+  bool Queued = false;
+  for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+      CallSite CS(I);
+      if (!CS)
+        continue;
+      Function *Callee = CS.getCalledFunction();
+      if (!Callee ||
+          (Callee->isDeclaration() && !Callee->isMaterializable()) ||
+          Callee->hasAvailableExternallyLinkage() ||
+          getPointerToGlobalIfAvailable(Callee))
+        continue;
+      SpeculationQueue.push_back(Callee);
+      Queued = true;
+    }
+
+  if (!Queued || CompileThreadRunning)
+    return;
+
+  // The previous thread, if any, has already given up the lock for good.
+  if (CompileThread)
+    llvm_join_thread(CompileThread);
+  CompileThreadRunning = true;
+  CompileThread = llvm_start_thread(CompileThreadMain, this);
+  if (!CompileThread) {
+    // No threads on this host; leave everything to the lazy stubs.
+    CompileThreadRunning = false;
+    SpeculationQueue.clear();
+  }
+}
+
+void JIT::CompileThreadMain(void *JITPtr) {
+  static_cast<JIT*>(JITPtr)->runCompileThread();
+}
+
+/// runCompileThread - Compile the functions in SpeculationQueue until it is
+/// empty.  The lock is dropped between functions, so that a thread which
+/// calls a lazy stub waits for at most one function to be compiled.
+void JIT::runCompileThread() {
+  while (true) {
+    MutexGuard locked(lock);
+    if (ShuttingDown || SpeculationQueue.empty()) {
+      CompileThreadRunning = false;
+      return;
+    }
+
+    Value *V = SpeculationQueue.front();
+    SpeculationQueue.pop_front();
+
+    // Skip functions that have been deleted, compiled through their stub in
+    // the meantime, or whose module has been removed from the JIT.
+    Function *F = cast_or_null<Function>(V);
+    if (!F || !jitstate || getPointerToGlobalIfAvailable(F) ||
+        std::find(Modules.begin(), Modules.end(), F->getParent()) ==
+          Modules.end())
+      continue;
+
+    DEBUG(dbgs() << "JIT: Speculatively compiling '" << F->getName() << "'\n");
+    getPointerToFunction(F);
+    ++NumSpeculated;
+  }
+}
+
 /// getPointerToFunction - This method is used to get the address of the
 /// specified function, compiling it if necessary.
 ///
@@ -17,6 +17,7 @@
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/PassManager.h"
 #include "llvm/Support/ValueHandle.h"
+#include <deque>
 
 namespace llvm {
 
@@ -76,6 +77,19 @@ class JIT : public ExecutionEngine {
   /// taken.
   BasicBlockAddressMapTy BasicBlockAddressMap;
 
+  /// SpeculationQueue - Functions called from code the JIT has emitted that
+  /// may not have been compiled yet, in the order the compile thread should
+  /// get to them.  Guarded by the JIT lock.
+  std::deque<WeakVH> SpeculationQueue;
+
+  /// CompileThread - The thread compiling the functions in SpeculationQueue,
+  /// or null if none has been started.  The thread clears
+  /// CompileThreadRunning, with the JIT lock held, right before it exits.
+  void *CompileThread;
+  bool CompileThreadRunning;
+
+  /// ShuttingDown - Set when the JIT is destroyed, to stop the compile thread.
+  bool ShuttingDown;
 
   JIT(Module *M, TargetMachine &tm, TargetJITInfo &tji,
       JITMemoryManager *JMM, CodeGenOpt::Level OptLevel,
@@ -214,6 +228,12 @@ private:
   void updateFunctionStub(Function *F);
   void jitTheFunction(Function *F, const MutexGuard &locked);
 
+  /// queueCallees - If the JIT is compiling speculatively, queue the functions
+  /// that F calls for the compile thread, starting it if need be.
+  void queueCallees(Function *F, const MutexGuard &locked);
+  static void CompileThreadMain(void *JITPtr);
+  void runCompileThread();
+
 protected:
 
   /// getMemoryforGV - Allocate memory for a global variable.
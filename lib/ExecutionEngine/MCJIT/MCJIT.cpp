@@ -9,12 +9,15 @@
 
 #include "MCJIT.h"
 #include "MCJITMemoryManager.h"
+#include "MCJITObjectCache.h"
 #include "llvm/DerivedTypes.h"
 #include "llvm/Function.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
 #include "llvm/ExecutionEngine/JITMemoryManager.h"
 #include "llvm/MC/MCAsmInfo.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/MemoryBuffer.h"
@@ -22,6 +25,16 @@
 
 using namespace llvm;
 
+static cl::opt<std::string>
+ObjectCacheDir("mcjit-object-cache",
+  cl::desc("Reuse objects emitted by the MC-JIT from this directory"),
+  cl::value_desc("directory"));
+
+static cl::opt<unsigned>
+ObjectCacheSize("mcjit-object-cache-size",
+  cl::desc("Size limit of the MC-JIT object cache, in megabytes"),
+  cl::init(256));
+
 namespace {
 
 static struct RegisterJIT {
@@ -67,22 +80,39 @@ MCJIT::MCJIT(Module *m, TargetMachine *tm, TargetJITInfo &tji,
     report_fatal_error("Target does not support MC emission!");
   }
 
-  // Initialize passes.
-  // FIXME: When we support multiple modules, we'll want to move the code
-  // gen and finalization out of the constructor here and do it more
-  // on-demand as part of getPointerToFunction().
-  PM.run(*M);
-  // Flush the output buffer so the SmallVector gets its data.
-  OS.flush();
+  // If we've compiled this module before, load the object we emitted then
+  // instead of running code generation again.
+  OwningPtr<MCJITObjectCache> Cache;
+  MemoryBuffer *MB = 0;
+  if (!ObjectCacheDir.empty()) {
+    Cache.reset(new MCJITObjectCache(ObjectCacheDir,
+                                     (uint64_t)ObjectCacheSize << 20));
+    MB = Cache->lookup(M, TM, CodeGenOpt::Default);
+  }
+
+  if (!MB) {
+    // Initialize passes.
+    // FIXME: When we support multiple modules, we'll want to move the code
+    // gen and finalization out of the constructor here and do it more
+    // on-demand as part of getPointerToFunction().
+    PM.run(*M);
+    // Flush the output buffer so the SmallVector gets its data.
+    OS.flush();
+
+    StringRef Object(Buffer.data(), Buffer.size());
+    if (Cache)
+      Cache->store(Object);
+
+    // FIXME: It would be nice to avoid making yet another copy.
+    MB = MemoryBuffer::getMemBufferCopy(Object);
+  }
 
   // Load the object into the dynamic linker.
-  // FIXME: It would be nice to avoid making yet another copy.
-  MemoryBuffer *MB = MemoryBuffer::getMemBufferCopy(StringRef(Buffer.data(),
-                                                              Buffer.size()));
   if (Dyld.loadObject(MB))
     report_fatal_error(Dyld.getErrorString());
   // Resolve any relocations.
-  Dyld.resolveRelocations();
+  if (Dyld.resolveRelocations())
+    report_fatal_error(Dyld.getErrorString());
 }
 
 MCJIT::~MCJIT() {
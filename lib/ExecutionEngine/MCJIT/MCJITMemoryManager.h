@@ -26,7 +26,10 @@ class MCJITMemoryManager : public RTDyldMemoryManager {
   // FIXME: Multiple modules.
   Module *M;
 public:
-  MCJITMemoryManager(JITMemoryManager *jmm, Module *m) : JMM(jmm), M(m) {}
+  MCJITMemoryManager(JITMemoryManager *jmm, Module *m)
+    : JMM(jmm ? jmm : JITMemoryManager::CreateDefaultMemManager()), M(m) {}
+  // We own the JMM, so make sure to delete it.
+  ~MCJITMemoryManager() { delete JMM; }
 
   // Allocate ActualSize bytes, or more, for the named function. Return
   // a pointer to the allocated memory and update Size to reflect how much
@@ -62,6 +65,11 @@ public:
     JMM->endFunctionBody(F, FunctionStart, FunctionEnd);
   }
 
+  // Allocate a block for a section which isn't tied to a single function.
+  uint8_t *allocateSection(uintptr_t Size, unsigned Alignment) {
+    return JMM->allocateSpace(Size, Alignment);
+  }
+
 };
 
 } // End llvm namespace
@@ -0,0 +1,221 @@
+//===-- MCJITObjectCache.cpp - On-disk cache of MCJIT objects -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the on-disk object cache used by the MC-JIT.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "mcjit"
+#include "MCJITObjectCache.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Target/TargetRegistry.h"
+#include <algorithm>
+#include <set>
+using namespace llvm;
+
+// Every entry starts with this, followed by the length of the key, the key
+// itself and then the object. Bump the version when the key changes.
+static const char CacheMagic[] = "MCJITOC1";
+static const char CachePrefix[] = "mcjit-";
+static const char CacheSuffix[] = ".o";
+
+STATISTIC(NumCacheHits, "Number of objects loaded from the object cache");
+STATISTIC(NumCacheStores, "Number of objects stored in the object cache");
+
+/// HashFNV64 - 64-bit FNV-1a hash of Str, continuing from Result.
+static uint64_t HashFNV64(StringRef Str,
+                          uint64_t Result = 14695981039346656037ULL) {
+  for (unsigned i = 0, e = Str.size(); i != e; ++i) {
+    Result ^= (unsigned char)Str[i];
+    Result *= 1099511628211ULL;
+  }
+  return Result;
+}
+
+MCJITObjectCache::MCJITObjectCache(StringRef Dir, uint64_t maxSize)
+  : CacheDir(Dir), MaxSize(maxSize) {
+  bool Existed;
+  if (error_code ec = sys::fs::create_directories(CacheDir, Existed))
+    DEBUG(dbgs() << "MCJIT object cache: unable to create '" << CacheDir
+                 << "': " << ec.message() << "\n");
+}
+
+MemoryBuffer *MCJITObjectCache::lookup(Module *M, const TargetMachine *TM,
+                                       CodeGenOpt::Level OptLevel) {
+  Key.clear();
+  EntryPath.clear();
+
+  // The bitcode writer only sees what has been materialized.
+  std::string ErrInfo;
+  if (M->MaterializeAll(&ErrInfo))
+    return 0;
+
+  // Everything that can change the generated code goes into the key. The
+  // global TargetOptions are included as they're set from the command line.
+  raw_string_ostream KeyOS(Key);
+  KeyOS << TM->getTarget().getName() << '\0' << M->getTargetTriple() << '\0';
+  if (const TargetData *TD = TM->getTargetData())
+    KeyOS << TD->getStringRepresentation();
+  KeyOS << '\0' << sys::getHostCPUName() << '\0'
+        << (unsigned)OptLevel << ' '
+        << (unsigned)TargetMachine::getRelocationModel() << ' '
+        << (unsigned)TargetMachine::getCodeModel() << ' '
+        << NoFramePointerElim << NoFramePointerElimNonLeaf
+        << LessPreciseFPMADOption << NoExcessFPPrecision << UnsafeFPMath
+        << NoInfsFPMath << NoNaNsFPMath
+        << HonorSignDependentRoundingFPMathOption << UseSoftFloat
+        << NoZerosInBSS << JITExceptionHandling << JITEmitDebugInfo
+        << GuaranteedTailCallOpt << ' ' << StackAlignment << ' '
+        << RealignStack << DisableJumpTables << EnableFastISel << '\0';
+
+  // The module itself is represented by a hash of its bitcode, and the size
+  // of it as a cheap guard against collisions.
+  SmallString<4096> Bitcode;
+  raw_svector_ostream BitcodeOS(Bitcode);
+  WriteBitcodeToFile(M, BitcodeOS);
+  BitcodeOS.flush();
+  uint64_t Hash = HashFNV64(Bitcode.str());
+  KeyOS << Bitcode.size() << ':' << utohexstr(Hash);
+  KeyOS.flush();
+
+  SmallString<128> Path(CacheDir);
+  sys::path::append(Path, Twine(CachePrefix) +
+                          utohexstr(HashFNV64(Key)) + CacheSuffix);
+  EntryPath = Path.str();
+
+  OwningPtr<MemoryBuffer> Entry;
+  if (MemoryBuffer::getFile(EntryPath, Entry))
+    return 0;
+
+  // Check that this entry really is for this key.
+  StringRef Contents = Entry->getBuffer();
+  StringRef Magic(CacheMagic);
+  if (!Contents.startswith(Magic))
+    return 0;
+  Contents = Contents.substr(Magic.size());
+  size_t KeyEnd = Contents.find('\n');
+  unsigned long long KeySize;
+  if (KeyEnd == StringRef::npos ||
+      Contents.slice(0, KeyEnd).getAsInteger(10, KeySize) ||
+      Contents.substr(KeyEnd + 1, KeySize) != Key)
+    return 0;
+  StringRef Object = Contents.substr(KeyEnd + 1 + KeySize);
+
+  // Mark the entry as recently used.
+  sys::PathWithStatus EntryFile(EntryPath);
+  if (const sys::FileStatus *Status = EntryFile.getFileStatus()) {
+    sys::FileStatus NewStatus = *Status;
+    NewStatus.modTime = sys::TimeValue::now();
+    EntryFile.setStatusInfoOnDisk(NewStatus);
+  }
+
+  ++NumCacheHits;
+  DEBUG(dbgs() << "MCJIT object cache: hit '" << EntryPath << "'\n");
+  return MemoryBuffer::getMemBufferCopy(Object, EntryPath);
+}
+
+void MCJITObjectCache::store(StringRef Object) {
+  if (EntryPath.empty())
+    return;
+
+  // Write to a temporary file and move it into place, so that other processes
+  // sharing the cache never see a partial entry.
+  SmallString<128> Model(CacheDir);
+  sys::path::append(Model, Twine(CachePrefix) + "%%%%%%%%.tmp");
+  SmallString<128> TempPath;
+  int FD;
+  if (sys::fs::unique_file(Model.str(), FD, TempPath))
+    return;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << CacheMagic << Key.size() << '\n' << Key << Object;
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      bool Existed;
+      sys::fs::remove(TempPath.str(), Existed);
+      return;
+    }
+  }
+  if (sys::fs::rename(TempPath.str(), EntryPath)) {
+    bool Existed;
+    sys::fs::remove(TempPath.str(), Existed);
+    return;
+  }
+  ++NumCacheStores;
+  DEBUG(dbgs() << "MCJIT object cache: stored '" << EntryPath << "'\n");
+
+  prune();
+}
+
+namespace {
+struct CacheEntry {
+  sys::TimeValue LastUsed;
+  uint64_t Size;
+  sys::Path File;
+
+  CacheEntry(const sys::TimeValue &lastUsed, uint64_t size,
+             const sys::Path &file)
+    : LastUsed(lastUsed), Size(size), File(file) {}
+
+  bool operator<(const CacheEntry &RHS) const {
+    return LastUsed < RHS.LastUsed;
+  }
+};
+}
+
+// Remove the least recently used entries until the cache fits in MaxSize.
+void MCJITObjectCache::prune() {
+  std::set<sys::Path> Contents;
+  if (sys::Path(CacheDir).getDirectoryContents(Contents, 0))
+    return;
+
+  std::vector<CacheEntry> Entries;
+  uint64_t TotalSize = 0;
+  for (std::set<sys::Path>::iterator I = Contents.begin(), E = Contents.end();
+       I != E; ++I) {
+    StringRef Name = I->getLast();
+    if (!Name.startswith(CachePrefix) || !Name.endswith(CacheSuffix))
+      continue;
+    sys::PathWithStatus File(*I);
+    const sys::FileStatus *Status = File.getFileStatus();
+    if (!Status || Status->isDir)
+      continue;
+    Entries.push_back(CacheEntry(Status->modTime, Status->fileSize, *I));
+    TotalSize += Status->fileSize;
+  }
+
+  if (TotalSize <= MaxSize)
+    return;
+
+  std::sort(Entries.begin(), Entries.end());
+  for (unsigned i = 0, e = Entries.size(); i != e && TotalSize > MaxSize; ++i) {
+    // Never evict the entry we've just written.
+    if (Entries[i].File.str() == EntryPath)
+      continue;
+    DEBUG(dbgs() << "MCJIT object cache: evicting '" << Entries[i].File.str()
+                 << "'\n");
+    if (!Entries[i].File.eraseFromDisk())
+      TotalSize -= Entries[i].Size;
+  }
+}
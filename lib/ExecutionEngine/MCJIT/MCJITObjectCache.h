@@ -0,0 +1,60 @@
+//===-- MCJITObjectCache.h - On-disk cache of MCJIT objects -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_EXECUTIONENGINE_MCJITOBJECTCACHE_H
+#define LLVM_LIB_EXECUTIONENGINE_MCJITOBJECTCACHE_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Target/TargetMachine.h"
+#include <string>
+
+namespace llvm {
+
+class MemoryBuffer;
+class Module;
+
+// The MCJIT object cache keeps the objects emitted for a module in a local
+// directory, so that a later process JITing an identical module for the same
+// target and code generation options can skip code generation entirely and
+// hand the cached object straight to the dynamic linker.
+//
+// Entries are keyed on the module's bitcode, the target triple and data
+// layout, the host CPU and the global code generation options. When the
+// directory grows beyond its size limit the least recently used entries are
+// removed.
+class MCJITObjectCache {
+  MCJITObjectCache(const MCJITObjectCache&);  // DO NOT IMPLEMENT
+  void operator=(const MCJITObjectCache&);    // DO NOT IMPLEMENT
+
+  std::string CacheDir;
+  uint64_t MaxSize;
+
+  // The key of the module last looked up, and the file it lives in.
+  std::string Key;
+  std::string EntryPath;
+
+  void prune();
+
+public:
+  MCJITObjectCache(StringRef Dir, uint64_t MaxSize);
+
+  // Compute the key for compiling M with TM at OptLevel and return the cached
+  // object for it, or null on a miss. The module is fully materialized.
+  MemoryBuffer *lookup(Module *M, const TargetMachine *TM,
+                       CodeGenOpt::Level OptLevel);
+
+  // Store the object emitted for the module of the last lookup, evicting old
+  // entries if the cache has grown too large.
+  void store(StringRef Object);
+};
+
+} // End llvm namespace
+
+#endif
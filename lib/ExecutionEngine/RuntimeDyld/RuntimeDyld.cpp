@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #define DEBUG_TYPE "dyld"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
@@ -21,6 +22,7 @@
 #include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/Object/MachOObject.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/ELF.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/Memory.h"
@@ -59,12 +61,15 @@ class RuntimeDyldImpl {
   struct RelocationEntry {
     std::string Target;     // Object this relocation is contained in.
     uint64_t    Offset;     // Offset into the object for the relocation.
-    uint32_t    Data;       // Second word of the raw macho relocation entry.
+    uint32_t    Data;       // Second word of the raw macho relocation entry,
+                            // or the relocation type for ELF.
     int64_t     Addend;     // Addend encoded in the instruction itself, if any.
+    bool        isELF;      // Did this relocation come from an ELF object?
     bool        isResolved; // Has this relocation been resolved previously?
 
-    RelocationEntry(StringRef t, uint64_t offset, uint32_t data, int64_t addend)
-      : Target(t), Offset(offset), Data(data), Addend(addend),
+    RelocationEntry(StringRef t, uint64_t offset, uint32_t data, int64_t addend,
+                    bool elf = false)
+      : Target(t), Offset(offset), Data(data), Addend(addend), isELF(elf),
         isResolved(false) {}
   };
   typedef SmallVector<RelocationEntry, 4> RelocationList;
@@ -74,6 +79,11 @@ class RuntimeDyldImpl {
   // this to dynamically answer whether all of the relocations in it have
   // been resolved or not.
 
+  // Number of ELF objects loaded so far. Sections of an ELF object are
+  // entered into the symbol table under names derived from this, so that
+  // section relative relocations don't collide between objects.
+  unsigned NumELFObjects;
+
   bool HasError;
   std::string ErrorStr;
 
@@ -92,6 +102,10 @@ class RuntimeDyldImpl {
                                unsigned Type, unsigned Size);
   bool resolveARMRelocation(uintptr_t Address, uintptr_t Value, bool isPCRel,
                             unsigned Type, unsigned Size);
+  bool resolveX86_64ELFRelocation(uintptr_t Address, uint64_t Value,
+                                  unsigned Type);
+
+  bool loadELFObject(MemoryBuffer *InputBuffer);
 
   bool loadSegment32(const MachOObject *Obj,
                      const MachOObject::LoadCommandInfo *SegmentLCI,
@@ -101,7 +115,8 @@ class RuntimeDyldImpl {
                      const InMemoryStruct<macho::SymtabLoadCommand> &SymtabLC);
 
 public:
-  RuntimeDyldImpl(RTDyldMemoryManager *mm) : MemMgr(mm), HasError(false) {}
+  RuntimeDyldImpl(RTDyldMemoryManager *mm)
+    : MemMgr(mm), NumELFObjects(0), HasError(false) {}
 
   bool loadObject(MemoryBuffer *InputBuffer);
 
@@ -111,9 +126,9 @@ public:
     return SymbolTable.lookup(Name);
   }
 
-  void resolveRelocations();
+  bool resolveRelocations();
 
-  void reassignSymbolAddress(StringRef Name, uint8_t *Addr);
+  bool reassignSymbolAddress(StringRef Name, uint8_t *Addr);
 
   // Is the linker in an error state?
   bool hasError() { return HasError; }
@@ -254,6 +269,39 @@ bool RuntimeDyldImpl::resolveARMRelocation(uintptr_t Address, uintptr_t Value,
   return false;
 }
 
+bool RuntimeDyldImpl::
+resolveX86_64ELFRelocation(uintptr_t Address, uint64_t Value, unsigned Type) {
+  // Value already includes the addend. ELF relocations don't carry an
+  // implicit PC adjustment, that's folded into the addend by the assembler.
+  switch (Type) {
+  default:
+    return Error("Relocation type not implemented yet!");
+  case ELF::R_X86_64_64:
+    memcpy((uint8_t*)Address, &Value, sizeof(Value));
+    return false;
+  case ELF::R_X86_64_32:
+  case ELF::R_X86_64_32S: {
+    if (Type == ELF::R_X86_64_32 ? Value != (uint32_t)Value
+                                 : (int64_t)Value != (int32_t)Value)
+      return Error("Relocation value out of range!");
+    uint32_t Truncated = (uint32_t)Value;
+    memcpy((uint8_t*)Address, &Truncated, sizeof(Truncated));
+    return false;
+  }
+  case ELF::R_X86_64_PC32: {
+    // PLT32 and GOTPCREL relocations have been turned into PC32 relocations
+    // against a stub or GOT entry by the time we get here.
+    int64_t Delta = (int64_t)(Value - (uint64_t)Address);
+    if (Delta != (int32_t)Delta)
+      return Error("PC-relative relocation out of range!");
+    int32_t Truncated = (int32_t)Delta;
+    memcpy((uint8_t*)Address, &Truncated, sizeof(Truncated));
+    return false;
+  }
+  }
+  return false;
+}
+
 bool RuntimeDyldImpl::
 loadSegment32(const MachOObject *Obj,
               const MachOObject::LoadCommandInfo *SegmentLCI,
@@ -523,10 +571,269 @@ loadSegment64(const MachOObject *Obj,
   return false;
 }
 
+bool RuntimeDyldImpl::loadELFObject(MemoryBuffer *InputBuffer) {
+  OwningPtr<MemoryBuffer> Buffer(InputBuffer);
+  const uint8_t *Base = (const uint8_t*)Buffer->getBufferStart();
+  uint64_t BufferSize = Buffer->getBufferSize();
+
+  // We only run objects built for the host, so the structures can be read in
+  // place.
+  if (BufferSize < sizeof(ELF::Elf64_Ehdr))
+    return Error("ELF object is too small");
+  const ELF::Elf64_Ehdr *Header = (const ELF::Elf64_Ehdr*)Base;
+  if (Header->getFileClass() != ELF::ELFCLASS64 ||
+      Header->getDataEncoding() != ELF::ELFDATA2LSB ||
+      Header->e_machine != ELF::EM_X86_64)
+    return Error("unsupported ELF object (only x86-64 is supported)");
+  if (Header->e_type != ELF::ET_REL)
+    return Error("unexpected ELF object (not relocatable)");
+  if (Header->e_shentsize != sizeof(ELF::Elf64_Shdr) ||
+      Header->e_shoff + Header->e_shnum * sizeof(ELF::Elf64_Shdr) > BufferSize)
+    return Error("malformed ELF section header table");
+
+  const ELF::Elf64_Shdr *Sections =
+    (const ELF::Elf64_Shdr*)(Base + Header->e_shoff);
+  unsigned NumSections = Header->e_shnum;
+  for (unsigned i = 0; i != NumSections; ++i)
+    if (Sections[i].sh_type != ELF::SHT_NOBITS &&
+        Sections[i].sh_offset + Sections[i].sh_size > BufferSize)
+      return Error("malformed ELF section: '" + Twine(i) + "'");
+
+  unsigned ObjNum = NumELFObjects++;
+
+  // Load every allocatable section. Each one is entered into the symbol table
+  // under a name private to this object, which is what relocations against
+  // local symbols and sections get attached to.
+  SmallVector<std::string, 16> SectionNames(NumSections);
+  for (unsigned i = 0; i != NumSections; ++i) {
+    const ELF::Elf64_Shdr &Sect = Sections[i];
+    if (!(Sect.sh_flags & ELF::SHF_ALLOC))
+      continue;
+    SectionNames[i] = ("elf" + Twine(ObjNum) + ":section" + Twine(i)).str();
+    uintptr_t Size = Sect.sh_size ? Sect.sh_size : 1;
+    uint8_t *Mem = MemMgr->allocateSection(Size, Sect.sh_addralign);
+    if (!Mem)
+      return Error("unable to allocate memory for section: '" + Twine(i) + "'");
+    if (Sect.sh_type == ELF::SHT_NOBITS)
+      memset(Mem, 0, Sect.sh_size);
+    else
+      memcpy(Mem, Base + Sect.sh_offset, Sect.sh_size);
+    SymbolTable[SectionNames[i]] = Mem;
+    DEBUG(dbgs() << "Section " << i << " allocated to [" << (void*)Mem
+                 << ", " << (void*)(Mem + Sect.sh_size) << "]\n");
+  }
+
+  // Find the symbol table. Relocatable objects have exactly one.
+  const ELF::Elf64_Shdr *SymtabSect = 0;
+  for (unsigned i = 0; i != NumSections; ++i)
+    if (Sections[i].sh_type == ELF::SHT_SYMTAB) {
+      if (SymtabSect)
+        return Error("unexpected input object (multiple symbol tables)");
+      SymtabSect = &Sections[i];
+    }
+  if (!SymtabSect)
+    return Error("no symbol table found in object");
+  if (SymtabSect->sh_link >= NumSections)
+    return Error("invalid string table for symbol table");
+  const ELF::Elf64_Shdr &StrtabSect = Sections[SymtabSect->sh_link];
+  const char *Strtab = (const char*)Base + StrtabSect.sh_offset;
+
+  // For each symbol, the name relocations against it are keyed by and the
+  // offset to add to the addend. Globals are keyed by their own names so that
+  // they can be resolved against other objects; everything defined locally is
+  // turned into a reference to its section.
+  typedef std::pair<StringRef, uint64_t> SymbolKey;
+  const ELF::Elf64_Sym *Symbols =
+    (const ELF::Elf64_Sym*)(Base + SymtabSect->sh_offset);
+  unsigned NumSymbols = SymtabSect->sh_size / sizeof(ELF::Elf64_Sym);
+  SmallVector<SymbolKey, 64> SymbolKeys(NumSymbols);
+  for (unsigned i = 1; i < NumSymbols; ++i) {
+    const ELF::Elf64_Sym &Sym = Symbols[i];
+    if (Sym.st_name >= StrtabSect.sh_size)
+      return Error("invalid symbol name: '" + Twine(i) + "'");
+    StringRef Name(Strtab + Sym.st_name);
+    bool isLocal = Sym.getBinding() == ELF::STB_LOCAL;
+    unsigned SectIdx = Sym.st_shndx;
+
+    if (SectIdx == ELF::SHN_UNDEF) {
+      SymbolKeys[i] = SymbolKey(Name, 0);
+      continue;
+    }
+    if (SectIdx == ELF::SHN_COMMON) {
+      // Common symbols get zero-filled storage of their own. The value is
+      // the required alignment.
+      uint8_t *Mem = MemMgr->allocateSection(Sym.st_size ? Sym.st_size : 1,
+                                             Sym.st_value);
+      if (!Mem)
+        return Error("unable to allocate memory for common symbol: '" +
+                     Name + "'");
+      memset(Mem, 0, Sym.st_size);
+      SymbolTable[Name] = Mem;
+      SymbolKeys[i] = SymbolKey(Name, 0);
+      continue;
+    }
+    if (SectIdx == ELF::SHN_ABS) {
+      if (isLocal)
+        continue;
+      SymbolTable[Name] = (uint8_t*)(uintptr_t)Sym.st_value;
+      SymbolKeys[i] = SymbolKey(Name, 0);
+      continue;
+    }
+    // Symbols in sections we didn't load (debug info, etc.) can't be the
+    // source of a relocation we care about.
+    if (SectIdx >= NumSections || SectionNames[SectIdx].empty())
+      continue;
+
+    if (isLocal || Sym.getType() == ELF::STT_SECTION) {
+      SymbolKeys[i] = SymbolKey(SectionNames[SectIdx], Sym.st_value);
+      continue;
+    }
+    SymbolTable[Name] = SymbolTable[SectionNames[SectIdx]] + Sym.st_value;
+    SymbolKeys[i] = SymbolKey(Name, 0);
+    DEBUG(dbgs() << "Symbol: '" << Name << "' @ "
+                 << (void*)SymbolTable[Name] << "\n");
+  }
+
+  // GOTPCREL relocations need a GOT entry holding the address of the symbol,
+  // and PLT32 relocations against symbols defined outside of this object
+  // need a stub, as the definition may well be out of range of a 32-bit
+  // displacement. Both live in a single block allocated for this object.
+  // GOT entries are keyed by symbol index, as locally defined symbols share
+  // their section's name.
+  DenseMap<unsigned, unsigned> GOTEntries;
+  StringMap<unsigned> Stubs;
+  for (unsigned i = 0; i != NumSections; ++i) {
+    const ELF::Elf64_Shdr &Sect = Sections[i];
+    if (Sect.sh_type != ELF::SHT_RELA || Sect.sh_info >= NumSections ||
+        SectionNames[Sect.sh_info].empty())
+      continue;
+    const ELF::Elf64_Rela *Rels = (const ELF::Elf64_Rela*)(Base +
+                                                           Sect.sh_offset);
+    for (unsigned j = 0, e = Sect.sh_size / sizeof(*Rels); j != e; ++j) {
+      unsigned SymNum = Rels[j].getSymbol();
+      if (SymNum >= NumSymbols)
+        return Error("invalid symbol index in relocation");
+      StringRef SourceName = SymbolKeys[SymNum].first;
+      if (SourceName.empty())
+        continue;
+      if (Rels[j].getType() == ELF::R_X86_64_GOTPCREL) {
+        if (!GOTEntries.count(SymNum)) {
+          unsigned Slot = GOTEntries.size();
+          GOTEntries[SymNum] = Slot;
+        }
+      } else if (Rels[j].getType() == ELF::R_X86_64_PLT32 &&
+               Symbols[SymNum].st_shndx == ELF::SHN_UNDEF &&
+               !Stubs.count(SourceName))
+        Stubs.GetOrCreateValue(SourceName, Stubs.size());
+    }
+  }
+
+  // Each stub is "jmp *0(%rip)" followed by the 8-byte target address, padded
+  // out to 16 bytes.
+  const unsigned GOTEntrySize = 8, StubSize = 16, StubTargetOffset = 6;
+  std::string StubsName;
+  uint8_t *StubMem = 0;
+  unsigned StubsOffset = GOTEntries.size() * GOTEntrySize;
+  if (!GOTEntries.empty() || !Stubs.empty()) {
+    StubsName = ("elf" + Twine(ObjNum) + ":stubs").str();
+    StubMem = MemMgr->allocateSection(StubsOffset + Stubs.size() * StubSize,
+                                      GOTEntrySize);
+    if (!StubMem)
+      return Error("unable to allocate memory for GOT and stubs");
+    SymbolTable[StubsName] = StubMem;
+
+    for (DenseMap<unsigned, unsigned>::iterator I = GOTEntries.begin(),
+         E = GOTEntries.end(); I != E; ++I) {
+      const SymbolKey &Source = SymbolKeys[I->first];
+      Relocations[Source.first].push_back(
+        RelocationEntry(StubsName, I->second * GOTEntrySize,
+                        ELF::R_X86_64_64, Source.second, true));
+    }
+    for (StringMap<unsigned>::iterator I = Stubs.begin(), E = Stubs.end();
+         I != E; ++I) {
+      uint8_t *Stub = StubMem + StubsOffset + I->getValue() * StubSize;
+      static const uint8_t JmpIndirect[] = { 0xff, 0x25, 0, 0, 0, 0 };
+      memcpy(Stub, JmpIndirect, sizeof(JmpIndirect));
+      memset(Stub + StubTargetOffset, 0, StubSize - StubTargetOffset);
+      Relocations[I->getKey()].push_back(
+        RelocationEntry(StubsName, Stub - StubMem + StubTargetOffset,
+                        ELF::R_X86_64_64, 0, true));
+    }
+  }
+
+  // Now record the relocations, associated with their source symbol.
+  for (unsigned i = 0; i != NumSections; ++i) {
+    const ELF::Elf64_Shdr &Sect = Sections[i];
+    if (Sect.sh_type == ELF::SHT_REL)
+      return Error("NOT YET IMPLEMENTED: ELF relocations without addends.");
+    if (Sect.sh_type != ELF::SHT_RELA || Sect.sh_info >= NumSections ||
+        SectionNames[Sect.sh_info].empty())
+      continue;
+    StringRef TargetName = SectionNames[Sect.sh_info];
+    const ELF::Elf64_Rela *Rels = (const ELF::Elf64_Rela*)(Base +
+                                                           Sect.sh_offset);
+    for (unsigned j = 0, e = Sect.sh_size / sizeof(*Rels); j != e; ++j) {
+      const ELF::Elf64_Rela &Rel = Rels[j];
+      unsigned Type = Rel.getType();
+      if (Type == ELF::R_X86_64_NONE)
+        continue;
+      unsigned SymNum = Rel.getSymbol();
+      const SymbolKey &Source = SymbolKeys[SymNum];
+      if (Source.first.empty())
+        return Error("relocation against a symbol in an unloaded section");
+
+      StringRef SourceName = Source.first;
+      int64_t Addend = Rel.r_addend + Source.second;
+      switch (Type) {
+      default:
+        return Error("Relocation type not implemented yet!");
+      case ELF::R_X86_64_64:
+      case ELF::R_X86_64_32:
+      case ELF::R_X86_64_32S:
+      case ELF::R_X86_64_PC32:
+        break;
+      case ELF::R_X86_64_PLT32:
+        Type = ELF::R_X86_64_PC32;
+        if (Stubs.count(SourceName)) {
+          Addend += StubsOffset + Stubs.lookup(SourceName) * StubSize;
+          SourceName = StubsName;
+        }
+        break;
+      case ELF::R_X86_64_GOTPCREL:
+        // The addend applies to the address of the GOT entry, not to the
+        // symbol; any section offset was put in the GOT entry itself.
+        Type = ELF::R_X86_64_PC32;
+        Addend = Rel.r_addend + GOTEntries.lookup(SymNum) * GOTEntrySize;
+        SourceName = StubsName;
+        break;
+      }
+
+      // Every supported relocation writes 4 bytes, except R_X86_64_64.
+      uint64_t Width = Type == ELF::R_X86_64_64 ? 8 : 4;
+      uint64_t TargetSize = Sections[Sect.sh_info].sh_size;
+      if (Width > TargetSize || Rel.r_offset > TargetSize - Width)
+        return Error("relocation offset out of range of its section");
+
+      Relocations[SourceName].push_back(RelocationEntry(TargetName,
+                                                        Rel.r_offset,
+                                                        Type, Addend, true));
+      DEBUG(dbgs() << "Relocation at '" << TargetName << "' + "
+                   << Rel.r_offset << " from '" << SourceName
+                   << "' (type: " << Type << ", addend: " << Addend << ")\n");
+    }
+  }
+  return false;
+}
+
 bool RuntimeDyldImpl::loadObject(MemoryBuffer *InputBuffer) {
   // If the linker is in an error state, don't do anything.
   if (hasError())
     return true;
+
+  // Dispatch on the object file format.
+  StringRef Magic = InputBuffer->getBuffer().slice(0, 4);
+  if (Magic == StringRef(ELF::ElfMagic, 4))
+    return loadELFObject(InputBuffer);
   // Load the Mach-O wrapper object.
   std::string ErrorStr;
   OwningPtr<MachOObject> Obj(
@@ -611,18 +918,21 @@ bool RuntimeDyldImpl::loadObject(MemoryBuffer *InputBuffer) {
 }
 
 // Resolve the relocations for all symbols we currently know about.
-void RuntimeDyldImpl::resolveRelocations() {
+bool RuntimeDyldImpl::resolveRelocations() {
   // Just iterate over the symbols in our symbol table and assign their
   // addresses.
   StringMap<uint8_t*>::iterator i = SymbolTable.begin();
   StringMap<uint8_t*>::iterator e = SymbolTable.end();
   for (;i != e; ++i)
-    reassignSymbolAddress(i->getKey(), i->getValue());
+    if (reassignSymbolAddress(i->getKey(), i->getValue()))
+      return true;
+  return false;
 }
 
 // Assign an address to a symbol name and resolve all the relocations
-// associated with it.
-void RuntimeDyldImpl::reassignSymbolAddress(StringRef Name, uint8_t *Addr) {
+// associated with it.  Stops at the first relocation that cannot be applied
+// and returns true.
+bool RuntimeDyldImpl::reassignSymbolAddress(StringRef Name, uint8_t *Addr) {
   // Assign the address in our symbol table.
   SymbolTable[Name] = Addr;
 
@@ -630,6 +940,19 @@ void RuntimeDyldImpl::reassignSymbolAddress(StringRef Name, uint8_t *Addr) {
   for (unsigned i = 0, e = Relocs.size(); i != e; ++i) {
     RelocationEntry &RE = Relocs[i];
     uint8_t *Target = SymbolTable[RE.Target] + RE.Offset;
+
+    if (RE.isELF) {
+      DEBUG(dbgs() << "Resolving relocation at '" << RE.Target
+            << "' + " << RE.Offset << " (" << format("%p", Target) << ")"
+            << " from '" << Name << " (" << format("%p", Addr) << ")"
+            << "(type: " << RE.Data << ", addend: " << RE.Addend << ").\n");
+      if (resolveX86_64ELFRelocation((uintptr_t)Target,
+                                     (uint64_t)(uintptr_t)Addr + RE.Addend,
+                                     RE.Data))
+        return true;
+      RE.isResolved = true;
+      continue;
+    }
     bool isPCRel = (RE.Data >> 24) & 1;
     unsigned Type = (RE.Data >> 28) & 0xf;
     unsigned Size = 1 << ((RE.Data >> 25) & 3);
@@ -640,9 +963,11 @@ void RuntimeDyldImpl::reassignSymbolAddress(StringRef Name, uint8_t *Addr) {
           << "(" << (isPCRel ? "pcrel" : "absolute")
           << ", type: " << Type << ", Size: " << Size << ").\n");
 
-    resolveRelocation(Target, Addr, isPCRel, Type, Size);
+    if (resolveRelocation(Target, Addr, isPCRel, Type, Size))
+      return true;
     RE.isResolved = true;
   }
+  return false;
 }
 
 //===----------------------------------------------------------------------===//
@@ -663,12 +988,12 @@ void *RuntimeDyld::getSymbolAddress(StringRef Name) {
   return Dyld->getSymbolAddress(Name);
 }
 
-void RuntimeDyld::resolveRelocations() {
-  Dyld->resolveRelocations();
+bool RuntimeDyld::resolveRelocations() {
+  return Dyld->resolveRelocations();
 }
 
-void RuntimeDyld::reassignSymbolAddress(StringRef Name, uint8_t *Addr) {
-  Dyld->reassignSymbolAddress(Name, Addr);
+bool RuntimeDyld::reassignSymbolAddress(StringRef Name, uint8_t *Addr) {
+  return Dyld->reassignSymbolAddress(Name, Addr);
 }
 
 StringRef RuntimeDyld::getErrorString() {
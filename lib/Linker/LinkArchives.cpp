@@ -14,7 +14,6 @@
 
 #include "llvm/Linker.h"
 #include "llvm/Module.h"
-#include "llvm/ADT/SetOperations.h"
 #include "llvm/Bitcode/Archive.h"
 #include "llvm/Config/config.h"
 #include <memory>
@@ -126,18 +125,13 @@ Linker::LinkInArchive(const sys::Path &Filename, bool &is_native) {
   }
   is_native = false;
 
-  // Save a set of symbols that are not defined by the archive. Since we're
-  // entering a loop, there's no point searching for these multiple times. This
-  // variable is used to "set_subtract" from the set of undefined symbols.
-  std::set<std::string> NotDefinedByArchive;
-
-  // Save the current set of undefined symbols, because we may have to make
-  // multiple passes over the archive:
-  std::set<std::string> CurrentlyUndefinedSymbols;
-
-  do {
-    CurrentlyUndefinedSymbols = UndefinedSymbols;
-
+  // Look up every symbol once. Each module pulled in from the archive may
+  // leave symbols of its own undefined; those that nothing linked so far
+  // defines are looked up next, until no new ones turn up. Symbols the archive
+  // doesn't define are never searched for again.
+  std::set<std::string> Searched(UndefinedSymbols);
+  std::set<Module*> Linked;
+  while (!UndefinedSymbols.empty()) {
     // Find the modules we need to link into the target module.  Note that arch
     // keeps ownership of these modules and may return the same Module* from a
     // subsequent call.
@@ -145,29 +139,28 @@ Linker::LinkInArchive(const sys::Path &Filename, bool &is_native) {
     if (!arch->findModulesDefiningSymbols(UndefinedSymbols, Modules, &ErrMsg))
       return error("Cannot find symbols in '" + Filename.str() + 
                    "': " + ErrMsg);
-
-    // If we didn't find any more modules to link this time, we are done
-    // searching this archive.
-    if (Modules.empty())
-      break;
-
-    // Any symbols remaining in UndefinedSymbols after
-    // findModulesDefiningSymbols are ones that the archive does not define. So
-    // we add them to the NotDefinedByArchive variable now.
-    NotDefinedByArchive.insert(UndefinedSymbols.begin(),
-        UndefinedSymbols.end());
+    UndefinedSymbols.clear();
 
     // Loop over all the Modules that we got back from the archive
+    std::set<std::string> NewSymbols;
     for (std::set<Module*>::iterator I=Modules.begin(), E=Modules.end();
          I != E; ++I) {
 
       // Get the module we must link in.
       std::string moduleErrorMsg;
       Module* aModule = *I;
-      if (aModule != NULL) {
+      if (aModule != NULL && Linked.insert(aModule).second) {
         if (aModule->MaterializeAll(&moduleErrorMsg))
           return error("Could not load a module: " + moduleErrorMsg);
 
+        // Note what the module needs before it's linked in.
+        std::set<std::string> ModuleSymbols;
+        GetAllUndefinedSymbols(aModule, ModuleSymbols);
+        for (std::set<std::string>::iterator SI = ModuleSymbols.begin(),
+             SE = ModuleSymbols.end(); SI != SE; ++SI)
+          if (Searched.insert(*SI).second)
+            NewSymbols.insert(*SI);
+
         verbose("  Linking in module: " + aModule->getModuleIdentifier());
 
         // Link it in
@@ -176,23 +169,16 @@ Linker::LinkInArchive(const sys::Path &Filename, bool &is_native) {
                        aModule->getModuleIdentifier() + "': " + moduleErrorMsg);
       } 
     }
-    
-    // Get the undefined symbols from the aggregate module. This recomputes the
-    // symbols we still need after the new modules have been linked in.
-    GetAllUndefinedSymbols(Composite, UndefinedSymbols);
-
-    // At this point we have two sets of undefined symbols: UndefinedSymbols
-    // which holds the undefined symbols from all the modules, and
-    // NotDefinedByArchive which holds symbols we know the archive doesn't
-    // define. There's no point searching for symbols that we won't find in the
-    // archive so we subtract these sets.
-    set_subtract(UndefinedSymbols, NotDefinedByArchive);
-
-    // If there's no symbols left, no point in continuing to search the
-    // archive.
-    if (UndefinedSymbols.empty())
-      break;
-  } while (CurrentlyUndefinedSymbols != UndefinedSymbols);
+
+    // Only search for the new symbols that are still undefined now that all
+    // of this round's modules have been linked in.
+    for (std::set<std::string>::iterator I = NewSymbols.begin(),
+         E = NewSymbols.end(); I != E; ++I) {
+      GlobalValue *GV = Composite->getNamedValue(*I);
+      if (!GV || GV->isDeclaration())
+        UndefinedSymbols.insert(*I);
+    }
+  }
 
   return false;
 }
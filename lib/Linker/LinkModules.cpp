@@ -31,6 +31,8 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSet.h"
 using namespace llvm;
 
 // Error - Simple wrapper function to conditionally assign to E and return true.
@@ -354,6 +356,13 @@ static void CopyGVAttributes(GlobalValue *DestGV, const GlobalValue *SrcGV) {
   DestGV->setAlignment(Alignment);
 }
 
+/// isDeclaration - Return true if GV, from a module being linked in, has no
+/// definition.  Unlike GlobalValue::isDeclaration, this counts a function whose
+/// body is yet to be read from a lazily loaded module as defined.
+static bool isDeclaration(const GlobalValue *GV) {
+  return GV->isDeclaration() && !GV->isMaterializable();
+}
+
 /// GetLinkageResult - This analyzes the two global values and determines what
 /// the result will look like in the destination module.  In particular, it
 /// computes the resultant linkage type, computes whether the global in the
@@ -370,7 +379,7 @@ static bool GetLinkageResult(GlobalValue *Dest, const GlobalValue *Src,
     // Linking something to nothing.
     LinkFromSrc = true;
     LT = Src->getLinkage();
-  } else if (Src->isDeclaration()) {
+  } else if (isDeclaration(Src)) {
     // If Src is external or if both Src & Dest are external..  Just link the
     // external globals, we aren't adding anything.
     if (Src->hasDLLImportLinkage()) {
@@ -435,7 +444,7 @@ static bool GetLinkageResult(GlobalValue *Dest, const GlobalValue *Src,
 
   // Check visibility
   if (Dest && Src->getVisibility() != Dest->getVisibility() &&
-      !Src->isDeclaration() && !Dest->isDeclaration() &&
+      !isDeclaration(Src) && !Dest->isDeclaration() &&
       !Src->hasAvailableExternallyLinkage() &&
       !Dest->hasAvailableExternallyLinkage())
       return Error(Err, "Linking globals named '" + Src->getName() +
@@ -966,7 +975,7 @@ static bool LinkFunctionProtos(Module *Dest, const Module *Src,
       // The only valid mappings are:
       // - SF is external declaration, which is effectively a no-op.
       // - SF is weak, when we just need to throw SF out.
-      if (!SF->isDeclaration() && !SF->isWeakForLinker())
+      if (!isDeclaration(SF) && !SF->isWeakForLinker())
         return Error(Err, "Function-Alias Collision on '" + SF->getName() +
                      "': symbol multiple defined");
     }
@@ -1020,52 +1029,77 @@ static bool LinkFunctionBody(Function *Dest, Function *Src,
 
 // LinkFunctionBodies - Link in the function bodies that are defined in the
 // source module into the DestModule.  This consists basically of copying the
-// function over and fixing up references to values.
+// function over and fixing up references to values.  Bodies that are not
+// needed are left alone, and so are never read if Src is being read lazily.
 static bool LinkFunctionBodies(Module *Dest, Module *Src,
                                ValueToValueMapTy &ValueMap,
+                               const StringSet<> &Overridden,
                                std::string *Err) {
 
   // Loop over all of the functions in the src module, mapping them over as we
   // go
   for (Module::iterator SF = Src->begin(), E = Src->end(); SF != E; ++SF) {
-    if (!SF->isDeclaration()) {               // No body if function is external
-      Function *DF = dyn_cast<Function>(ValueMap[SF]); // Destination function
-
-      // DF not external SF external?
-      if (DF && DF->isDeclaration())
-        // Only provide the function body if there isn't one already.
-        if (LinkFunctionBody(DF, SF, ValueMap, Err))
-          return true;
-    }
+    if (isDeclaration(SF))                    // No body if function is external
+      continue;
+
+    // Only provide the function body if there isn't one already.
+    Function *DF = dyn_cast<Function>(ValueMap[SF]); // Destination function
+    if (!DF || !DF->isDeclaration())
+      continue;
+
+    // Don't bother with a weak body that another input is going to replace.
+    if ((SF->isWeakForLinker() || SF->hasAvailableExternallyLinkage()) &&
+        Overridden.count(SF->getName()))
+      continue;
+
+    if (SF->Materialize(Err) || LinkFunctionBody(DF, SF, ValueMap, Err))
+      return true;
   }
   return false;
 }
 
+/// AppendInitializer - Add the elements of appending variable G to Inits.
+static void AppendInitializer(const GlobalVariable *G,
+                              std::vector<Constant*> &Inits) {
+  const ArrayType *T = cast<ArrayType>(G->getType()->getElementType());
+  if (ConstantArray *I = dyn_cast<ConstantArray>(G->getInitializer())) {
+    for (unsigned i = 0, e = T->getNumElements(); i != e; ++i)
+      Inits.push_back(I->getOperand(i));
+  } else {
+    assert(isa<ConstantAggregateZero>(G->getInitializer()));
+    Constant *CV = Constant::getNullValue(T->getElementType());
+    Inits.insert(Inits.end(), T->getNumElements(), CV);
+  }
+}
+
 // LinkAppendingVars - If there were any appending global variables, link them
 // together now.  Return true on error.
 static bool LinkAppendingVars(Module *M,
                   std::multimap<std::string, GlobalVariable *> &AppendingVars,
                               std::string *ErrorMsg) {
-  if (AppendingVars.empty()) return false; // Nothing to do.
-
-  // Loop over the multimap of appending vars, processing any variables with the
-  // same name, forming a new appending global variable with both of the
-  // initializers merged together, then rewrite references to the old variables
-  // and delete them.
+  // Loop over the multimap of appending vars, forming one new appending global
+  // variable out of all the variables with the same name, then rewrite
+  // references to the old variables and delete them.  Merging them all at once
+  // rather than pairwise keeps this linear in the number of elements.
+  typedef std::multimap<std::string, GlobalVariable *>::iterator iterator;
   std::vector<Constant*> Inits;
-  while (AppendingVars.size() > 1) {
-    // Get the first two elements in the map...
-    std::multimap<std::string,
-      GlobalVariable*>::iterator Second = AppendingVars.begin(), First=Second++;
-
-    // If the first two elements are for different names, there is no pair...
-    // Otherwise there is a pair, so link them together...
-    if (First->first == Second->first) {
-      GlobalVariable *G1 = First->second, *G2 = Second->second;
-      const ArrayType *T1 = cast<ArrayType>(G1->getType()->getElementType());
+  for (iterator I = AppendingVars.begin(), E = AppendingVars.end(); I != E; ) {
+    iterator Last = AppendingVars.upper_bound(I->first);
+
+    // A variable of its own has nothing to be linked with.
+    if (llvm::next(I) == Last) {
+      I = Last;
+      continue;
+    }
+
+    GlobalVariable *G1 = I->second;
+    const ArrayType *T1 = cast<ArrayType>(G1->getType()->getElementType());
+    unsigned NewSize = 0;
+    for (iterator J = I; J != Last; ++J) {
+      GlobalVariable *G2 = J->second;
       const ArrayType *T2 = cast<ArrayType>(G2->getType()->getElementType());
 
-      // Check to see that they two arrays agree on type...
+      // Check to see that the arrays agree on type...
       if (T1->getElementType() != T2->getElementType())
         return Error(ErrorMsg,
          "Appending variables with different element types need to be linked!");
@@ -1085,65 +1119,43 @@ static bool LinkAppendingVars(Module *M,
         return Error(ErrorMsg,
          "Appending variables with different section name need to be linked!");
 
-      unsigned NewSize = T1->getNumElements() + T2->getNumElements();
-      ArrayType *NewType = ArrayType::get(T1->getElementType(),
-                                                         NewSize);
+      NewSize += T2->getNumElements();
+    }
 
-      G1->setName("");   // Clear G1's name in case of a conflict!
+    ArrayType *NewType = ArrayType::get(T1->getElementType(), NewSize);
 
-      // Create the new global variable...
-      GlobalVariable *NG =
-        new GlobalVariable(*M, NewType, G1->isConstant(), G1->getLinkage(),
-                           /*init*/0, First->first, 0, G1->isThreadLocal(),
-                           G1->getType()->getAddressSpace());
+    G1->setName("");   // Clear G1's name in case of a conflict!
 
-      // Propagate alignment, visibility and section info.
-      CopyGVAttributes(NG, G1);
+    // Create the new global variable...
+    GlobalVariable *NG =
+      new GlobalVariable(*M, NewType, G1->isConstant(), G1->getLinkage(),
+                         /*init*/0, I->first, 0, G1->isThreadLocal(),
+                         G1->getType()->getAddressSpace());
 
-      // Merge the initializer...
-      Inits.reserve(NewSize);
-      if (ConstantArray *I = dyn_cast<ConstantArray>(G1->getInitializer())) {
-        for (unsigned i = 0, e = T1->getNumElements(); i != e; ++i)
-          Inits.push_back(I->getOperand(i));
-      } else {
-        assert(isa<ConstantAggregateZero>(G1->getInitializer()));
-        Constant *CV = Constant::getNullValue(T1->getElementType());
-        for (unsigned i = 0, e = T1->getNumElements(); i != e; ++i)
-          Inits.push_back(CV);
-      }
-      if (ConstantArray *I = dyn_cast<ConstantArray>(G2->getInitializer())) {
-        for (unsigned i = 0, e = T2->getNumElements(); i != e; ++i)
-          Inits.push_back(I->getOperand(i));
-      } else {
-        assert(isa<ConstantAggregateZero>(G2->getInitializer()));
-        Constant *CV = Constant::getNullValue(T2->getElementType());
-        for (unsigned i = 0, e = T2->getNumElements(); i != e; ++i)
-          Inits.push_back(CV);
-      }
-      NG->setInitializer(ConstantArray::get(NewType, Inits));
-      Inits.clear();
-
-      // Replace any uses of the two global variables with uses of the new
-      // global...
-
-      // FIXME: This should rewrite simple/straight-forward uses such as
-      // getelementptr instructions to not use the Cast!
-      G1->replaceAllUsesWith(ConstantExpr::getBitCast(NG,
-                             G1->getType()));
-      G2->replaceAllUsesWith(ConstantExpr::getBitCast(NG,
-                             G2->getType()));
-
-      // Remove the two globals from the module now...
-      M->getGlobalList().erase(G1);
-      M->getGlobalList().erase(G2);
-
-      // Put the new global into the AppendingVars map so that we can handle
-      // linking of more than two vars...
-      Second->second = NG;
+    // Propagate alignment, visibility and section info.
+    CopyGVAttributes(NG, G1);
+
+    // Merge the initializers...
+    Inits.reserve(NewSize);
+    for (iterator J = I; J != Last; ++J)
+      AppendInitializer(J->second, Inits);
+    NG->setInitializer(ConstantArray::get(NewType, Inits));
+    Inits.clear();
+
+    // Replace any uses of the old global variables with uses of the new
+    // global, and remove them from the module.
+
+    // FIXME: This should rewrite simple/straight-forward uses such as
+    // getelementptr instructions to not use the Cast!
+    for (iterator J = I; J != Last; ++J) {
+      GlobalVariable *G = J->second;
+      G->replaceAllUsesWith(ConstantExpr::getBitCast(NG, G->getType()));
+      M->getGlobalList().erase(G);
     }
-    AppendingVars.erase(First);
+    I = Last;
   }
 
+  AppendingVars.clear();
   return false;
 }
 
@@ -1163,15 +1175,32 @@ static bool ResolveAliases(Module *Dest) {
   return false;
 }
 
-// LinkModules - This function links two modules together, with the resulting
-// left module modified to be the composite of the two input modules.  If an
-// error occurs, true is returned and ErrorMsg (if not null) is set to indicate
-// the problem.  Upon failure, the Dest module could be in a modified state, and
-// shouldn't be relied on to be consistent.
-bool
-Linker::LinkModules(Module *Dest, Module *Src, std::string *ErrorMsg) {
-  assert(Dest != 0 && "Invalid Destination module");
-  assert(Src  != 0 && "Invalid Source Module");
+// MaterializeForLinking - Read in the parts of Src that must be there before
+// it is linked, if it is being read lazily.  Function bodies are read as they
+// are linked, except that a blockaddress of a function that hasn't been read
+// is stood in for by an internal global declaration, which can't be linked.
+// Modules with any of those are read in full.
+static bool MaterializeForLinking(Module *Src, std::string *ErrorMsg) {
+  if (!Src->getMaterializer())
+    return false;
+  if (Src->MaterializeMetadata(ErrorMsg))
+    return true;
+  for (Module::global_iterator I = Src->global_begin(), E = Src->global_end();
+       I != E; ++I)
+    if (I->isDeclaration() && I->hasLocalLinkage())
+      return Src->MaterializeAll(ErrorMsg);
+  return false;
+}
+
+// LinkModule - Link Src into Dest, except for linking the named types, merging
+// the appending variables and resolving aliases, which are left for the caller
+// to do for all of its inputs at once.  Function bodies named in Overridden
+// that are weak are skipped, as another input is going to replace them.
+static bool LinkModule(Module *Dest, Module *Src,
+                  std::multimap<std::string, GlobalVariable *> &AppendingVars,
+                       const StringSet<> &Overridden, std::string *ErrorMsg) {
+  if (MaterializeForLinking(Src, ErrorMsg))
+    return true;
 
   if (Dest->getDataLayout().empty()) {
     if (!Src->getDataLayout().empty()) {
@@ -1228,30 +1257,12 @@ Linker::LinkModules(Module *Dest, Module *Src, std::string *ErrorMsg) {
        SI != SE; ++SI)
     Dest->addLibrary(*SI);
 
-  // LinkTypes - Go through the symbol table of the Src module and see if any
-  // types are named in the src module that are not named in the Dst module.
-  // Make sure there are no type name conflicts.
-  if (LinkTypes(Dest, Src, ErrorMsg))
-    return true;
-
   // ValueMap - Mapping of values from what they used to be in Src, to what they
   // are now in Dest.  ValueToValueMapTy is a ValueMap, which involves some
   // overhead due to the use of Value handles which the Linker doesn't actually
   // need, but this allows us to reuse the ValueMapper code.
   ValueToValueMapTy ValueMap;
 
-  // AppendingVars - Keep track of global variables in the destination module
-  // with appending linkage.  After the module is linked together, they are
-  // appended and the module is rewritten.
-  std::multimap<std::string, GlobalVariable *> AppendingVars;
-  for (Module::global_iterator I = Dest->global_begin(), E = Dest->global_end();
-       I != E; ++I) {
-    // Add all of the appending globals already in the Dest module to
-    // AppendingVars.
-    if (I->hasAppendingLinkage())
-      AppendingVars.insert(std::make_pair(I->getName(), I));
-  }
-
   // Insert all of the globals in src into the Dest module... without linking
   // initializers (which could refer to functions not yet mapped over).
   if (LinkGlobals(Dest, Src, ValueMap, AppendingVars, ErrorMsg))
@@ -1277,13 +1288,8 @@ Linker::LinkModules(Module *Dest, Module *Src, std::string *ErrorMsg) {
   // Link in the function bodies that are defined in the source module into the
   // DestModule.  This consists basically of copying the function over and
   // fixing up references to values.
-  if (LinkFunctionBodies(Dest, Src, ValueMap, ErrorMsg)) return true;
-
-  // If there were any appending global variables, link them together now.
-  if (LinkAppendingVars(Dest, AppendingVars, ErrorMsg)) return true;
-
-  // Resolve all uses of aliases with aliasees
-  if (ResolveAliases(Dest)) return true;
+  if (LinkFunctionBodies(Dest, Src, ValueMap, Overridden, ErrorMsg))
+    return true;
 
   // Remap all of the named mdnoes in Src into the Dest module. We do this
   // after linking GlobalValues so that MDNodes that reference GlobalValues
@@ -1299,4 +1305,79 @@ Linker::LinkModules(Module *Dest, Module *Src, std::string *ErrorMsg) {
   return false;
 }
 
+// LinkModules - This function links two modules together, with the resulting
+// left module modified to be the composite of the two input modules.  If an
+// error occurs, true is returned and ErrorMsg (if not null) is set to indicate
+// the problem.  Upon failure, the Dest module could be in a modified state, and
+// shouldn't be relied on to be consistent.
+bool
+Linker::LinkModules(Module *Dest, Module *Src, std::string *ErrorMsg) {
+  assert(Src  != 0 && "Invalid Source Module");
+  return LinkModules(Dest, ArrayRef<Module*>(Src), ErrorMsg);
+}
+
+// LinkModules - Link each of Srcs into Dest in turn.  Types and symbols are
+// resolved across all of them before any function body is linked, and the
+// work that has to look at the whole of Dest is only done once at the end.
+bool
+Linker::LinkModules(Module *Dest, ArrayRef<Module*> Srcs,
+                    std::string *ErrorMsg, unsigned *FailedSrc) {
+  assert(Dest != 0 && "Invalid Destination module");
+  if (FailedSrc)
+    *FailedSrc = Srcs.size();
+
+  // LinkTypes - Go through the symbol table of each Src module and see if any
+  // types are named in it that are not named in the Dst module.  Make sure
+  // there are no type name conflicts.  Resolving a type refines it everywhere
+  // it is used, so doing this for every input first means the globals of the
+  // earlier inputs are linked against the types of the later ones too.
+  for (unsigned i = 0, e = Srcs.size(); i != e; ++i) {
+    assert(Srcs[i] != 0 && "Invalid Source Module");
+    if (LinkTypes(Dest, Srcs[i], ErrorMsg)) {
+      if (FailedSrc)
+        *FailedSrc = i;
+      return true;
+    }
+  }
+
+  // Overridden - The names of the functions some input defines with a strong
+  // linkage.  Weak definitions of them in other inputs are going to lose, so
+  // their bodies are never linked, nor read in if the input is lazy.
+  StringSet<> Overridden;
+  if (Srcs.size() > 1)
+    for (unsigned i = 0, e = Srcs.size(); i != e; ++i)
+      for (Module::iterator I = Srcs[i]->begin(), E = Srcs[i]->end();
+           I != E; ++I)
+        if (!isDeclaration(I) && !I->hasLocalLinkage() &&
+            !I->isWeakForLinker() && !I->hasAvailableExternallyLinkage())
+          Overridden.insert(I->getName());
+
+  // AppendingVars - Keep track of global variables in the destination module
+  // with appending linkage.  After all of the modules are linked together,
+  // they are appended and the module is rewritten.
+  std::multimap<std::string, GlobalVariable *> AppendingVars;
+  for (Module::global_iterator I = Dest->global_begin(), E = Dest->global_end();
+       I != E; ++I) {
+    // Add all of the appending globals already in the Dest module to
+    // AppendingVars.
+    if (I->hasAppendingLinkage())
+      AppendingVars.insert(std::make_pair(I->getName(), I));
+  }
+
+  for (unsigned i = 0, e = Srcs.size(); i != e; ++i)
+    if (LinkModule(Dest, Srcs[i], AppendingVars, Overridden, ErrorMsg)) {
+      if (FailedSrc)
+        *FailedSrc = i;
+      return true;
+    }
+
+  // If there were any appending global variables, link them together now.
+  if (LinkAppendingVars(Dest, AppendingVars, ErrorMsg)) return true;
+
+  // Resolve all uses of aliases with aliasees
+  if (ResolveAliases(Dest)) return true;
+
+  return false;
+}
+
 // vim: sw=2
@@ -28,7 +28,7 @@ typedef StringMap<const MCSectionCOFF*> COFFUniqueMapTy;
 
 MCContext::MCContext(const MCAsmInfo &mai, const TargetAsmInfo *tai) :
   MAI(mai), TAI(tai),
-  Allocator(), Symbols(Allocator), UsedNames(Allocator),
+  Allocator(), Shared(false), Symbols(Allocator), UsedNames(Allocator),
   NextUniqueID(0),
   CurrentDwarfLoc(0,0,0,DWARF2_FLAG_IS_STMT,0,0),
   AllowTemporaryLabels(true) {
@@ -64,6 +64,7 @@ MCContext::~MCContext() {
 
 MCSymbol *MCContext::GetOrCreateSymbol(StringRef Name) {
   assert(!Name.empty() && "Normal symbols cannot be unnamed!");
+  ContextGuard Guard(*this);
 
   // Do the lookup and get the entire StringMapEntry.  We want access to the
   // key if we are creating the entry.
@@ -110,6 +111,7 @@ MCSymbol *MCContext::GetOrCreateSymbol(const Twine &Name) {
 }
 
 MCSymbol *MCContext::CreateTempSymbol() {
+  ContextGuard Guard(*this);
   SmallString<128> NameSV;
   raw_svector_ostream(NameSV)
     << MAI.getPrivateGlobalPrefix() << "tmp" << NextUniqueID++;
@@ -145,6 +147,7 @@ MCSymbol *MCContext::GetDirectionalLocalSymbol(int64_t LocalLabelVal,
 }
 
 MCSymbol *MCContext::LookupSymbol(StringRef Name) const {
+  ContextGuard Guard(*this);
   return Symbols.lookup(Name);
 }
 
@@ -160,6 +163,7 @@ getMachOSection(StringRef Segment, StringRef Section,
   // We unique sections by their segment/section pair.  The returned section
   // may not have the same flags as the requested section, if so this should be
   // diagnosed by the client as an error.
+  ContextGuard Guard(*this);
 
   // Create the map if it doesn't already exist.
   if (MachOUniquingMap == 0)
@@ -190,6 +194,7 @@ getELFSection(StringRef Section, unsigned Type, unsigned Flags,
 const MCSectionELF *MCContext::
 getELFSection(StringRef Section, unsigned Type, unsigned Flags,
               SectionKind Kind, unsigned EntrySize, StringRef Group) {
+  ContextGuard Guard(*this);
   if (ELFUniquingMap == 0)
     ELFUniquingMap = new ELFUniqueMapTy();
   ELFUniqueMapTy &Map = *(ELFUniqueMapTy*)ELFUniquingMap;
@@ -224,6 +229,7 @@ const MCSection *MCContext::getCOFFSection(StringRef Section,
                                            unsigned Characteristics,
                                            int Selection,
                                            SectionKind Kind) {
+  ContextGuard Guard(*this);
   if (COFFUniquingMap == 0)
     COFFUniquingMap = new COFFUniqueMapTy();
   COFFUniqueMapTy &Map = *(COFFUniqueMapTy*)COFFUniquingMap;
@@ -0,0 +1,89 @@
+//===- ConditionVariable.cpp - Condition Variable ---------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the llvm::sys::ConditionVariable class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Config/config.h"
+#include "llvm/Support/ConditionVariable.h"
+
+//===----------------------------------------------------------------------===//
+//=== WARNING: Implementation here must contain only TRULY operating system
+//===          independent code.
+//===----------------------------------------------------------------------===//
+
+#if !defined(ENABLE_THREADS) || ENABLE_THREADS == 0
+// Define all methods as no-ops if threading is explicitly disabled
+namespace llvm {
+using namespace sys;
+ConditionVariable::ConditionVariable() { }
+ConditionVariable::~ConditionVariable() { }
+bool ConditionVariable::wait(MutexImpl &) { return true; }
+bool ConditionVariable::notifyAll() { return true; }
+}
+#else
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD_MUTEX_LOCK)
+
+#include <cassert>
+#include <pthread.h>
+#include <stdlib.h>
+
+namespace llvm {
+using namespace sys;
+
+ConditionVariable::ConditionVariable()
+{
+  pthread_cond_t* cond =
+    static_cast<pthread_cond_t*>(malloc(sizeof(pthread_cond_t)));
+  int errorcode = pthread_cond_init(cond, 0);
+  assert(errorcode == 0); (void)errorcode;
+  data_ = cond;
+}
+
+ConditionVariable::~ConditionVariable()
+{
+  pthread_cond_t* cond = static_cast<pthread_cond_t*>(data_);
+  assert(cond != 0);
+  pthread_cond_destroy(cond);
+  free(cond);
+}
+
+bool
+ConditionVariable::wait(MutexImpl &Lock)
+{
+  pthread_cond_t* cond = static_cast<pthread_cond_t*>(data_);
+  pthread_mutex_t* mutex = static_cast<pthread_mutex_t*>(Lock.data_);
+  assert(cond != 0 && mutex != 0);
+
+  int errorcode = pthread_cond_wait(cond, mutex);
+  return errorcode == 0;
+}
+
+bool
+ConditionVariable::notifyAll()
+{
+  pthread_cond_t* cond = static_cast<pthread_cond_t*>(data_);
+  assert(cond != 0);
+
+  int errorcode = pthread_cond_broadcast(cond);
+  return errorcode == 0;
+}
+
+}
+
+#elif defined(LLVM_ON_UNIX)
+#include "Unix/ConditionVariable.inc"
+#elif defined( LLVM_ON_WIN32)
+#include "Windows/ConditionVariable.inc"
+#else
+#warning Neither LLVM_ON_UNIX nor LLVM_ON_WIN32 was set in Support/ConditionVariable.cpp
+#endif
+#endif
@@ -19,27 +19,23 @@
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <cstring>
 using namespace llvm;
 
 namespace {
-  struct LineNoCacheTy {
-    int LastQueryBufferID;
-    const char *LastQuery;
-    unsigned LineNoOfQuery;
-  };
+  /// LineOffsetsTy - The offsets of the newlines in a buffer, in order.
+  typedef std::vector<unsigned> LineOffsetsTy;
 }
 
-static LineNoCacheTy *getCache(void *Ptr) {
-  return (LineNoCacheTy*)Ptr;
+static LineOffsetsTy *getLineOffsets(void *Ptr) {
+  return (LineOffsetsTy*)Ptr;
 }
 
 
 SourceMgr::~SourceMgr() {
-  // Delete the line # cache if allocated.
-  if (LineNoCacheTy *Cache = getCache(LineNoCache))
-    delete Cache;
-
   while (!Buffers.empty()) {
+    delete getLineOffsets(Buffers.back().LineOffsets);
     delete Buffers.back().Buffer;
     Buffers.pop_back();
   }
@@ -77,46 +73,35 @@ int SourceMgr::FindBufferContainingLoc(SMLoc Loc) const {
   return -1;
 }
 
-/// FindLineNumber - Find the line number for the specified location in the
-/// specified file.  This is not a fast method.
-unsigned SourceMgr::FindLineNumber(SMLoc Loc, int BufferID) const {
+/// getLineAndColumn - Find the line number and the 0-based column of the
+/// specified location in the specified file.
+std::pair<unsigned, unsigned>
+SourceMgr::getLineAndColumn(SMLoc Loc, int BufferID) const {
   if (BufferID == -1) BufferID = FindBufferContainingLoc(Loc);
   assert(BufferID != -1 && "Invalid Location!");
 
-  MemoryBuffer *Buff = getBufferInfo(BufferID).Buffer;
-
-  // Count the number of \n's between the start of the file and the specified
-  // location.
-  unsigned LineNo = 1;
-
-  const char *Ptr = Buff->getBufferStart();
-
-  // If we have a line number cache, and if the query is to a later point in the
-  // same file, start searching from the last query location.  This optimizes
-  // for the case when multiple diagnostics come out of one file in order.
-  if (LineNoCacheTy *Cache = getCache(LineNoCache))
-    if (Cache->LastQueryBufferID == BufferID &&
-        Cache->LastQuery <= Loc.getPointer()) {
-      Ptr = Cache->LastQuery;
-      LineNo = Cache->LineNoOfQuery;
-    }
-
-  // Scan for the location being queried, keeping track of the number of lines
-  // we see.
-  for (; SMLoc::getFromPointer(Ptr) != Loc; ++Ptr)
-    if (*Ptr == '\n') ++LineNo;
-
-
-  // Allocate the line number cache if it doesn't exist.
-  if (LineNoCache == 0)
-    LineNoCache = new LineNoCacheTy();
+  const SrcBuffer &SB = getBufferInfo(BufferID);
+  const char *BufStart = SB.Buffer->getBufferStart();
+
+  // The first query for a buffer records where its newlines are.  memchr is
+  // vectorized by the C library, so this is a fast scan even for large files.
+  LineOffsetsTy *Offsets = getLineOffsets(SB.LineOffsets);
+  if (Offsets == 0) {
+    Offsets = new LineOffsetsTy();
+    const char *Ptr = BufStart, *End = SB.Buffer->getBufferEnd();
+    while ((Ptr = (const char*)memchr(Ptr, '\n', End-Ptr)))
+      Offsets->push_back(Ptr++ - BufStart);
+    SB.LineOffsets = Offsets;
+  }
 
-  // Update the line # cache.
-  LineNoCacheTy &Cache = *getCache(LineNoCache);
-  Cache.LastQueryBufferID = BufferID;
-  Cache.LastQuery = Ptr;
-  Cache.LineNoOfQuery = LineNo;
-  return LineNo;
+  // The line number is one more than the number of newlines before Loc, and
+  // the line starts just after the last of them.
+  unsigned Offset = Loc.getPointer() - BufStart;
+  LineOffsetsTy::const_iterator I =
+    std::lower_bound(Offsets->begin(), Offsets->end(), Offset);
+  unsigned LineStart = I == Offsets->begin() ? 0 : I[-1]+1;
+  return std::make_pair(unsigned(I - Offsets->begin()) + 1,
+                        Offset - LineStart);
 }
 
 void SourceMgr::PrintIncludeStack(SMLoc IncludeLoc, raw_ostream &OS) const {
@@ -148,11 +133,16 @@ SMDiagnostic SourceMgr::GetMessage(SMLoc Loc, const Twine &Msg,
 
   MemoryBuffer *CurMB = getBufferInfo(CurBuf).Buffer;
 
-  // Scan backward to find the start of the line.
-  const char *LineStart = Loc.getPointer();
-  while (LineStart != CurMB->getBufferStart() &&
-         LineStart[-1] != '\n' && LineStart[-1] != '\r')
-    --LineStart;
+  // Only '\n' counts towards the line number, but the line shown and the
+  // column start after a '\r' as well, the last one before Loc.  The scan
+  // back is bounded by the start of the line.
+  std::pair<unsigned, unsigned> LineAndCol = getLineAndColumn(Loc, CurBuf);
+  const char *LineStart = Loc.getPointer() - LineAndCol.second;
+  for (const char *Ptr = Loc.getPointer(); Ptr != LineStart; --Ptr)
+    if (Ptr[-1] == '\r') {
+      LineStart = Ptr;
+      break;
+    }
 
   std::string LineStr;
   if (ShowLine) {
@@ -171,7 +161,7 @@ SMDiagnostic SourceMgr::GetMessage(SMLoc Loc, const Twine &Msg,
   OS << Msg;
 
   return SMDiagnostic(*this, Loc,
-                      CurMB->getBufferIdentifier(), FindLineNumber(Loc, CurBuf),
+                      CurMB->getBufferIdentifier(), LineAndCol.first,
                       Loc.getPointer()-LineStart, OS.str(),
                       LineStr, ShowLine);
 }
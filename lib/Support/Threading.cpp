@@ -16,6 +16,7 @@
 #include "llvm/Support/Mutex.h"
 #include "llvm/Config/config.h"
 #include <cassert>
+#include <vector>
 
 using namespace llvm;
 
@@ -103,6 +104,59 @@ void llvm::llvm_execute_on_thread(void (*Fn)(void*), void *UserData,
   ::pthread_attr_destroy(&Attr);
 }
 
+void llvm::llvm_execute_on_threads(void (*Fn)(void*), void *const *UserData,
+                                   unsigned NumThreads) {
+  if (NumThreads == 0)
+    return;
+
+  ThreadInfo Default = { Fn, 0 };
+  std::vector<ThreadInfo> Info(NumThreads, Default);
+  std::vector<pthread_t> Threads(NumThreads);
+  std::vector<bool> Started(NumThreads, false);
+
+  // Start the helper threads; the first entry is run on this thread.
+  for (unsigned i = 1; i != NumThreads; ++i) {
+    Info[i].UserData = UserData[i];
+    Started[i] = ::pthread_create(&Threads[i], 0, ExecuteOnThread_Dispatch,
+                                  &Info[i]) == 0;
+  }
+
+  Fn(UserData[0]);
+
+  // Wait for the helpers, running any that could not be started here.
+  for (unsigned i = 1; i != NumThreads; ++i) {
+    if (Started[i])
+      ::pthread_join(Threads[i], 0);
+    else
+      Fn(UserData[i]);
+  }
+}
+
+namespace {
+struct StartedThread {
+  ThreadInfo Info;
+  pthread_t Thread;
+};
+}
+
+void *llvm::llvm_start_thread(void (*Fn)(void*), void *UserData) {
+  StartedThread *T = new StartedThread();
+  T->Info.UserFn = Fn;
+  T->Info.UserData = UserData;
+  if (::pthread_create(&T->Thread, 0, ExecuteOnThread_Dispatch,
+                       &T->Info) != 0) {
+    delete T;
+    return 0;
+  }
+  return T;
+}
+
+void llvm::llvm_join_thread(void *Thread) {
+  StartedThread *T = static_cast<StartedThread*>(Thread);
+  ::pthread_join(T->Thread, 0);
+  delete T;
+}
+
 #else
 
 // No non-pthread implementation, currently.
@@ -113,4 +167,20 @@ void llvm::llvm_execute_on_thread(void (*Fn)(void*), void *UserData,
   Fn(UserData);
 }
 
+void llvm::llvm_execute_on_threads(void (*Fn)(void*), void *const *UserData,
+                                   unsigned NumThreads) {
+  for (unsigned i = 0; i != NumThreads; ++i)
+    Fn(UserData[i]);
+}
+
+void *llvm::llvm_start_thread(void (*Fn)(void*), void *UserData) {
+  (void) Fn;
+  (void) UserData;
+  return 0;
+}
+
+void llvm::llvm_join_thread(void *Thread) {
+  (void) Thread;
+}
+
 #endif
@@ -66,6 +66,10 @@ TargetLibraryInfo::TargetLibraryInfo(const TargetLibraryInfo &TLI)
   memcpy(AvailableArray, TLI.AvailableArray, sizeof(AvailableArray));
 }
 
+Pass *TargetLibraryInfo::createClone() const {
+  return new TargetLibraryInfo(*this);
+}
+
 
 /// disableAllFunctions - This disables all builtins, which is used for options
 /// like -fno-builtin.
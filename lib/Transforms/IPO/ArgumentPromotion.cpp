@@ -70,6 +70,8 @@ namespace {
       initializeArgPromotionPass(*PassRegistry::getPassRegistry());
     }
 
+    Pass *createClone() const { return new ArgPromotion(maxElements); }
+
     /// A vector used to hold the indices of a single GEP instruction
     typedef std::vector<uint64_t> IndicesVector;
 
@@ -39,6 +39,9 @@ namespace {
     SimpleInliner(int Threshold) : Inliner(ID, Threshold) {
       initializeSimpleInlinerPass(*PassRegistry::getPassRegistry());
     }
+    Pass *createClone() const {
+      return new SimpleInliner(getInlineThreshold());
+    }
     static char ID; // Pass identification, replacement for typeid
     InlineCost getInlineCost(CallSite CS) {
       return CA.getInlineCost(CS, NeverInline);
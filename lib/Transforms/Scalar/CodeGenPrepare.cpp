@@ -91,6 +91,7 @@ namespace {
       : FunctionPass(ID), TLI(tli) {
         initializeCodeGenPreparePass(*PassRegistry::getPassRegistry());
       }
+    Pass *createClone() const { return new CodeGenPrepare(TLI); }
     bool runOnFunction(Function &F);
 
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
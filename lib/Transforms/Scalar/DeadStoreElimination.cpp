@@ -26,11 +26,12 @@
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
-#include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Target/TargetData.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/ValueHandle.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 using namespace llvm;
@@ -41,16 +42,16 @@ STATISTIC(NumFastOther , "Number of other instrs removed");
 namespace {
   struct DSE : public FunctionPass {
     AliasAnalysis *AA;
-    MemoryDependenceAnalysis *MD;
+    MemorySSA *MSSA;
 
     static char ID; // Pass identification, replacement for typeid
-    DSE() : FunctionPass(ID), AA(0), MD(0) {
+    DSE() : FunctionPass(ID), AA(0), MSSA(0) {
       initializeDSEPass(*PassRegistry::getPassRegistry());
     }
 
     virtual bool runOnFunction(Function &F) {
       AA = &getAnalysis<AliasAnalysis>();
-      MD = &getAnalysis<MemoryDependenceAnalysis>();
+      MSSA = &getAnalysis<MemorySSA>();
       DominatorTree &DT = getAnalysis<DominatorTree>();
       
       bool Changed = false;
@@ -60,11 +61,13 @@ namespace {
         if (DT.isReachableFromEntry(I))
           Changed |= runOnBasicBlock(*I);
       
-      AA = 0; MD = 0;
+      AA = 0; MSSA = 0;
       return Changed;
     }
     
     bool runOnBasicBlock(BasicBlock &BB);
+    bool isReadAfter(MemoryAccess *Def, const AliasAnalysis::Location &Loc);
+    bool isStoreOfLoadedValue(StoreInst *SI);
     bool HandleFree(CallInst *F);
     bool handleEndBlock(BasicBlock &BB);
     void RemoveAccessedObjects(const AliasAnalysis::Location &LoadedLoc,
@@ -74,10 +77,10 @@ namespace {
       AU.setPreservesCFG();
       AU.addRequired<DominatorTree>();
       AU.addRequired<AliasAnalysis>();
-      AU.addRequired<MemoryDependenceAnalysis>();
+      AU.addRequired<MemorySSA>();
       AU.addPreserved<AliasAnalysis>();
       AU.addPreserved<DominatorTree>();
-      AU.addPreserved<MemoryDependenceAnalysis>();
+      AU.addPreserved<MemorySSA>();
     }
   };
 }
@@ -85,7 +88,7 @@ namespace {
 char DSE::ID = 0;
 INITIALIZE_PASS_BEGIN(DSE, "dse", "Dead Store Elimination", false, false)
 INITIALIZE_PASS_DEPENDENCY(DominatorTree)
-INITIALIZE_PASS_DEPENDENCY(MemoryDependenceAnalysis)
+INITIALIZE_PASS_DEPENDENCY(MemorySSA)
 INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
 INITIALIZE_PASS_END(DSE, "dse", "Dead Store Elimination", false, false)
 
@@ -101,23 +104,21 @@ FunctionPass *llvm::createDeadStoreEliminationPass() { return new DSE(); }
 ///
 /// If ValueSet is non-null, remove any deleted instructions from it as well.
 ///
-static void DeleteDeadInstruction(Instruction *I,
-                                  MemoryDependenceAnalysis &MD,
+static void DeleteDeadInstruction(Instruction *I, MemorySSA &MSSA,
                                   SmallPtrSet<Value*, 16> *ValueSet = 0) {
   SmallVector<Instruction*, 32> NowDeadInsts;
   
   NowDeadInsts.push_back(I);
   --NumFastOther;
   
-  // Before we touch this instruction, remove it from memdep!
+  // Before we touch this instruction, remove it from Memory SSA!
   do {
     Instruction *DeadInst = NowDeadInsts.pop_back_val();
     ++NumFastOther;
     
-    // This instruction is dead, zap it, in stages.  Start by removing it from
-    // MemDep, which needs to know the operands and needs it to be in the
-    // function.
-    MD.removeInstruction(DeadInst);
+    // This instruction is dead, zap it, in stages.  Start by removing its
+    // memory access, so that the accesses that saw it see its defining access.
+    MSSA.removeMemoryAccess(DeadInst);
     
     for (unsigned op = 0, e = DeadInst->getNumOperands(); op != e; ++op) {
       Value *Op = DeadInst->getOperand(op);
@@ -431,43 +432,31 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
       continue;
     }
     
-    // If we find something that writes memory, get its memory dependence.
+    // If we find something that writes memory, look at the defs before it.
     if (!hasMemoryWrite(Inst))
       continue;
 
-    MemDepResult InstDep = MD->getDependency(Inst);
-    
-    // Ignore non-local store liveness.
-    // FIXME: cross-block DSE would be fun. :)
-    if (InstDep.isNonLocal() || 
-        // Ignore self dependence, which happens in the entry block of the
-        // function.
-        InstDep.getInst() == Inst)
-      continue;
-     
     // If we're storing the same value back to a pointer that we just
     // loaded from, then the store can be removed.
     if (StoreInst *SI = dyn_cast<StoreInst>(Inst)) {
-      if (LoadInst *DepLoad = dyn_cast<LoadInst>(InstDep.getInst())) {
-        if (SI->getPointerOperand() == DepLoad->getPointerOperand() &&
-            SI->getOperand(0) == DepLoad && !SI->isVolatile()) {
-          DEBUG(dbgs() << "DSE: Remove Store Of Load from same pointer:\n  "
-                       << "LOAD: " << *DepLoad << "\n  STORE: " << *SI << '\n');
-          
-          // DeleteDeadInstruction can delete the current instruction.  Save BBI
-          // in case we need it.
-          WeakVH NextInst(BBI);
-          
-          DeleteDeadInstruction(SI, *MD);
-          
-          if (NextInst == 0)  // Next instruction deleted.
-            BBI = BB.begin();
-          else if (BBI != BB.begin())  // Revisit this instruction if possible.
-            --BBI;
-          ++NumFastStores;
-          MadeChange = true;
-          continue;
-        }
+      if (isStoreOfLoadedValue(SI)) {
+        DEBUG(dbgs() << "DSE: Remove Store Of Load from same pointer:\n  "
+                     << "LOAD: " << *SI->getValueOperand() << "\n  STORE: "
+                     << *SI << '\n');
+        
+        // DeleteDeadInstruction can delete the current instruction.  Save BBI
+        // in case we need it.
+        WeakVH NextInst(BBI);
+        
+        DeleteDeadInstruction(SI, *MSSA);
+        
+        if (NextInst == 0)  // Next instruction deleted.
+          BBI = BB.begin();
+        else if (BBI != BB.begin())  // Revisit this instruction if possible.
+          --BBI;
+        ++NumFastStores;
+        MadeChange = true;
+        continue;
       }
     }
     
@@ -478,56 +467,64 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
     if (Loc.Ptr == 0)
       continue;
     
-    while (!InstDep.isNonLocal()) {
-      // Get the memory clobbered by the instruction we depend on.  MemDep will
-      // skip any instructions that 'Loc' clearly doesn't interact with.  If we
-      // end up depending on a may- or must-aliased load, then we can't optimize
-      // away the store and we bail out.  However, if we depend on on something
-      // that overwrites the memory location we *can* potentially optimize it.
-      //
-      // Find out what memory location the dependent instruction stores.
-      Instruction *DepWrite = InstDep.getInst();
-      AliasAnalysis::Location DepLoc = getLocForWrite(DepWrite, *AA);
-      // If we didn't get a useful location, or if it isn't a size, bail out.
-      if (DepLoc.Ptr == 0)
+    // Walk up the defs that come before Inst in this block, skipping any that
+    // 'Loc' clearly doesn't interact with.  If 'Loc' may be read before Inst
+    // overwrites it, then we can't optimize away the earlier store and we bail
+    // out.  However, if we find something that overwrites the memory location
+    // we *can* potentially optimize it.
+    // FIXME: cross-block DSE would be fun. :)
+    MemoryAccess *Def = MSSA->getMemoryAccess(Inst)->getDefiningAccess();
+    while (MemoryDef *DepDef = dyn_cast<MemoryDef>(Def)) {
+      if (MSSA->isLiveOnEntryDef(DepDef) || DepDef->getBlock() != &BB)
         break;
 
-      // If we find a write that is a) removable (i.e., non-volatile), b) is
-      // completely obliterated by the store to 'Loc', and c) which we know that
-      // 'Inst' doesn't load from, then we can remove it.
-      if (isRemovable(DepWrite) && isCompleteOverwrite(Loc, DepLoc, *AA) &&
-          !isPossibleSelfRead(Inst, Loc, DepWrite, *AA)) {
-        DEBUG(dbgs() << "DSE: Remove Dead Store:\n  DEAD: "
-              << *DepWrite << "\n  KILLER: " << *Inst << '\n');
-        
-        // Delete the store and now-dead instructions that feed it.
-        DeleteDeadInstruction(DepWrite, *MD);
-        ++NumFastStores;
-        MadeChange = true;
-        
-        // DeleteDeadInstruction can delete the current instruction in loop
-        // cases, reset BBI.
-        BBI = Inst;
-        if (BBI != BB.begin())
-          --BBI;
+      // Can't look past this def if 'Loc' is read before the next one.
+      if (isReadAfter(DepDef, Loc))
         break;
+
+      Instruction *DepWrite = DepDef->getMemoryInst();
+      AliasAnalysis::ModRefResult MR = AA->getModRefInfo(DepWrite, Loc);
+      if (MR != AliasAnalysis::NoModRef) {
+        // Find out what memory location the dependent instruction stores.
+        AliasAnalysis::Location DepLoc = getLocForWrite(DepWrite, *AA);
+        // If we didn't get a useful location, or if it isn't a size, bail out.
+        if (DepLoc.Ptr == 0)
+          break;
+
+        // If we find a write that is a) removable (i.e., non-volatile), b) is
+        // completely obliterated by the store to 'Loc', and c) which we know
+        // that 'Inst' doesn't load from, then we can remove it.
+        if (isRemovable(DepWrite) && isCompleteOverwrite(Loc, DepLoc, *AA) &&
+            !isPossibleSelfRead(Inst, Loc, DepWrite, *AA)) {
+          DEBUG(dbgs() << "DSE: Remove Dead Store:\n  DEAD: "
+                << *DepWrite << "\n  KILLER: " << *Inst << '\n');
+          
+          // Delete the store and now-dead instructions that feed it.
+          DeleteDeadInstruction(DepWrite, *MSSA);
+          ++NumFastStores;
+          MadeChange = true;
+          
+          // DeleteDeadInstruction can delete the current instruction in loop
+          // cases, reset BBI.
+          BBI = Inst;
+          if (BBI != BB.begin())
+            --BBI;
+          break;
+        }
+
+        // If this is a may-aliased store that is clobbering the store value,
+        // we can keep searching past it for another must-aliased pointer that
+        // stores to the same location.  For example, in:
+        //   store -> P
+        //   store -> Q
+        //   store -> P
+        // we can remove the first store to P even though we don't know if P
+        // and Q alias.  We can't look past it if it might read 'Loc'.
+        if (MR & AliasAnalysis::Ref)
+          break;
       }
-      
-      // If this is a may-aliased store that is clobbering the store value, we
-      // can keep searching past it for another must-aliased pointer that stores
-      // to the same location.  For example, in:
-      //   store -> P
-      //   store -> Q
-      //   store -> P
-      // we can remove the first store to P even though we don't know if P and Q
-      // alias.
-      if (DepWrite == &BB.front()) break;
-      
-      // Can't look past this instruction if it might read 'Loc'.
-      if (AA->getModRefInfo(DepWrite, Loc) & AliasAnalysis::Ref)
-        break;
-        
-      InstDep = MD->getPointerDependencyFrom(Loc, false, DepWrite, &BB);
+
+      Def = DepDef->getDefiningAccess();
     }
   }
   
@@ -539,37 +536,95 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
   return MadeChange;
 }
 
+/// isReadAfter - Return true if 'Loc' may be read by one of the uses of the
+/// memory state defined by Def.  All of them come between Def and the next
+/// def when Def is not the last def of its block.
+bool DSE::isReadAfter(MemoryAccess *Def, const AliasAnalysis::Location &Loc) {
+  for (MemoryAccess::user_iterator UI = Def->user_begin(),
+       UE = Def->user_end(); UI != UE; ++UI)
+    if (MemoryUse *MU = dyn_cast<MemoryUse>(*UI)) {
+      Instruction *I = MU->getMemoryInst();
+      // Loads from read-only memory can't be reading what a store wrote.
+      if (LoadInst *LI = dyn_cast<LoadInst>(I))
+        if (AA->pointsToConstantMemory(AA->getLocation(LI)))
+          continue;
+      if (AA->getModRefInfo(I, Loc) & AliasAnalysis::Ref)
+        return true;
+    }
+  return false;
+}
+
+/// isStoreOfLoadedValue - Return true if SI stores a value loaded from the
+/// same pointer back to it and nothing in between may have modified it.
+bool DSE::isStoreOfLoadedValue(StoreInst *SI) {
+  LoadInst *DepLoad = dyn_cast<LoadInst>(SI->getValueOperand());
+  if (DepLoad == 0 || SI->isVolatile() ||
+      SI->getPointerOperand() != DepLoad->getPointerOperand())
+    return false;
+
+  // A volatile load is a def itself; any other load sees the state it is
+  // defined from.
+  MemoryAccess *LoadState = MSSA->getMemoryAccess(DepLoad);
+  if (MemoryUse *MU = dyn_cast<MemoryUse>(LoadState))
+    LoadState = MU->getDefiningAccess();
+
+  // The load dominates the store, so walking up the defs from the store
+  // reaches the load's state unless a phi merges in other paths first.
+  AliasAnalysis::Location Loc = AA->getLocation(SI);
+  MemoryAccess *Def = MSSA->getMemoryAccess(SI)->getDefiningAccess();
+  while (Def != LoadState) {
+    MemoryDef *DepDef = dyn_cast<MemoryDef>(Def);
+    if (DepDef == 0 || MSSA->isLiveOnEntryDef(DepDef) ||
+        (AA->getModRefInfo(DepDef->getMemoryInst(), Loc) & AliasAnalysis::Mod))
+      return false;
+    Def = DepDef->getDefiningAccess();
+  }
+  return true;
+}
+
 /// HandleFree - Handle frees of entire structures whose dependency is a store
 /// to a field of that structure.
 bool DSE::HandleFree(CallInst *F) {
-  MemDepResult Dep = MD->getDependency(F);
-  do {
-    if (Dep.isNonLocal()) return false;
-    
-    Instruction *Dependency = Dep.getInst();
+  bool MadeChange = false;
+  AliasAnalysis::Location Loc(F->getArgOperand(0));
+
+  MemoryAccess *Def = MSSA->getMemoryAccess(F)->getDefiningAccess();
+  while (MemoryDef *DepDef = dyn_cast<MemoryDef>(Def)) {
+    if (MSSA->isLiveOnEntryDef(DepDef) || DepDef->getBlock() != F->getParent() ||
+        isReadAfter(DepDef, Loc))
+      break;
+
+    // Skip writes that don't touch the freed memory.
+    Instruction *Dependency = DepDef->getMemoryInst();
+    if (AA->getModRefInfo(Dependency, Loc) == AliasAnalysis::NoModRef) {
+      Def = DepDef->getDefiningAccess();
+      continue;
+    }
+
     if (!hasMemoryWrite(Dependency) || !isRemovable(Dependency))
-      return false;
+      break;
   
     Value *DepPointer =
       GetUnderlyingObject(getStoredPointerOperand(Dependency));
 
     // Check for aliasing.
     if (!AA->isMustAlias(F->getArgOperand(0), DepPointer))
-      return false;
+      break;
   
-    // DCE instructions only used to calculate that store
-    DeleteDeadInstruction(Dependency, *MD);
-    ++NumFastStores;
-
-    // Inst's old Dependency is now deleted. Compute the next dependency,
-    // which may also be dead, as in
+    // Dependency is about to be deleted.  The next def up may also be dead,
+    // as in
     //    s[0] = 0;
-    //    s[1] = 0; // This has just been deleted.
+    //    s[1] = 0; // This is being deleted.
     //    free(s);
-    Dep = MD->getDependency(F);
-  } while (!Dep.isNonLocal());
+    Def = DepDef->getDefiningAccess();
+
+    // DCE instructions only used to calculate that store
+    DeleteDeadInstruction(Dependency, *MSSA);
+    ++NumFastStores;
+    MadeChange = true;
+  }
   
-  return true;
+  return MadeChange;
 }
 
 /// handleEndBlock - Remove dead stores to stack-allocated locations in the
@@ -615,7 +670,7 @@ bool DSE::handleEndBlock(BasicBlock &BB) {
                      << *Dead << "\n  Object: " << *Pointer << '\n');
         
         // DCE instructions only used to calculate that store.
-        DeleteDeadInstruction(Dead, *MD, &DeadStackObjects);
+        DeleteDeadInstruction(Dead, *MSSA, &DeadStackObjects);
         ++NumFastStores;
         MadeChange = true;
         continue;
@@ -625,7 +680,7 @@ bool DSE::handleEndBlock(BasicBlock &BB) {
     // Remove any dead non-memory-mutating instructions.
     if (isInstructionTriviallyDead(BBI)) {
       Instruction *Inst = BBI++;
-      DeleteDeadInstruction(Inst, *MD, &DeadStackObjects);
+      DeleteDeadInstruction(Inst, *MSSA, &DeadStackObjects);
       ++NumFastOther;
       MadeChange = true;
       continue;
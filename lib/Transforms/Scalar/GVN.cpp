@@ -27,6 +27,7 @@
 #include "llvm/Analysis/Loads.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
 #include "llvm/Analysis/PHITransAddr.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Assembly/Writer.h"
@@ -52,6 +53,8 @@ STATISTIC(NumPRELoad,   "Number of loads PRE'd");
 static cl::opt<bool> EnablePRE("enable-pre",
                                cl::init(true), cl::Hidden);
 static cl::opt<bool> EnableLoadPRE("enable-load-pre", cl::init(true));
+static cl::opt<bool> EnableMemorySSA("enable-gvn-memoryssa",
+                                     cl::init(true), cl::Hidden);
 
 //===----------------------------------------------------------------------===//
 //                         ValueTable Class
@@ -392,8 +395,14 @@ namespace {
   class GVN : public FunctionPass {
     bool NoLoads;
     MemoryDependenceAnalysis *MD;
+    MemorySSA *MSSA;
     DominatorTree *DT;
     const TargetData *TD;
+
+    /// NonLocalTBAATags - The TBAA tag of the first non-local load of each
+    /// address looked up with Memory SSA, or null once two loads of the
+    /// address disagree about it.
+    DenseMap<Value*, const MDNode*> NonLocalTBAATags;
     
     ValueTable VN;
     
@@ -411,10 +420,12 @@ namespace {
   public:
     static char ID; // Pass identification, replacement for typeid
     explicit GVN(bool noloads = false)
-        : FunctionPass(ID), NoLoads(noloads), MD(0) {
+        : FunctionPass(ID), NoLoads(noloads), MD(0), MSSA(0) {
       initializeGVNPass(*PassRegistry::getPassRegistry());
     }
 
+    Pass *createClone() const { return new GVN(NoLoads); }
+
     bool runOnFunction(Function &F);
     
     /// markInstructionForDeletion - This removes the specified instruction from
@@ -428,6 +439,7 @@ namespace {
     DominatorTree &getDominatorTree() const { return *DT; }
     AliasAnalysis *getAliasAnalysis() const { return VN.getAliasAnalysis(); }
     MemoryDependenceAnalysis &getMemDep() const { return *MD; }
+    MemorySSA &getMemorySSA() const { return *MSSA; }
   private:
     /// addToLeaderTable - Push a new Value to the LeaderTable onto the list for
     /// its value number.
@@ -478,8 +490,11 @@ namespace {
     // This transformation requires dominator postdominator info
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.addRequired<DominatorTree>();
-      if (!NoLoads)
+      if (!NoLoads) {
         AU.addRequired<MemoryDependenceAnalysis>();
+        AU.addRequired<MemorySSA>();
+        AU.addPreserved<MemorySSA>();
+      }
       AU.addRequired<AliasAnalysis>();
 
       AU.addPreserved<DominatorTree>();
@@ -492,6 +507,9 @@ namespace {
     bool processLoad(LoadInst *L);
     bool processInstruction(Instruction *I);
     bool processNonLocalLoad(LoadInst *L);
+    bool getNonLocalDepsFromMemorySSA(LoadInst *LI,
+                                      AliasAnalysis::Location Loc,
+                                    SmallVectorImpl<NonLocalDepResult> &Deps);
     bool processBlock(BasicBlock *BB);
     void dump(DenseMap<uint32_t, Value*> &d);
     bool iterateOnFunction(Function &F);
@@ -512,6 +530,7 @@ FunctionPass *llvm::createGVNPass(bool NoLoads) {
 
 INITIALIZE_PASS_BEGIN(GVN, "gvn", "Global Value Numbering", false, false)
 INITIALIZE_PASS_DEPENDENCY(MemoryDependenceAnalysis)
+INITIALIZE_PASS_DEPENDENCY(MemorySSA)
 INITIALIZE_PASS_DEPENDENCY(DominatorTree)
 INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
 INITIALIZE_PASS_END(GVN, "gvn", "Global Value Numbering", false, false)
@@ -976,6 +995,7 @@ static Value *GetLoadValueForLoad(LoadInst *SrcVal, unsigned Offset,
     // but then there all of the operations based on it would need to be
     // rehashed.  Just leave the dead load around.
     gvn.getMemDep().removeInstruction(SrcVal);
+    gvn.getMemorySSA().createMemoryUse(NewLoad);
     SrcVal = NewLoad;
   }
   
@@ -1206,13 +1226,228 @@ static bool isLifetimeStart(const Instruction *Inst) {
   return false;
 }
 
+/// getLoadDependencyOnDef - Return how a load of Loc depends on the Memory SSA
+/// def Inst, which is what memdep's block scan would return when it got to
+/// Inst.  Returns a default constructed result if the def doesn't affect Loc.
+static MemDepResult getLoadDependencyOnDef(Instruction *Inst,
+                                           const AliasAnalysis::Location &Loc,
+                                           AliasAnalysis *AA,
+                                           const TargetData *TD) {
+  if (isLifetimeStart(Inst)) {
+    IntrinsicInst *II = cast<IntrinsicInst>(Inst);
+    if (AA->isMustAlias(AliasAnalysis::Location(II->getArgOperand(1)), Loc))
+      return MemDepResult::getDef(II);
+    return MemDepResult();
+  }
+
+  // Volatile loads are defs too.  Must aliased loads are defs of each other.
+  if (LoadInst *DepLI = dyn_cast<LoadInst>(Inst)) {
+    AliasAnalysis::AliasResult R = AA->alias(AA->getLocation(DepLI), Loc);
+    if (R == AliasAnalysis::MustAlias)
+      return MemDepResult::getDef(DepLI);
+    if (R == AliasAnalysis::PartialAlias)
+      return MemDepResult::getClobber(DepLI);
+    return MemDepResult();
+  }
+
+  if (StoreInst *SI = dyn_cast<StoreInst>(Inst)) {
+    if (AA->getModRefInfo(SI, Loc) == AliasAnalysis::NoModRef)
+      return MemDepResult();
+    AliasAnalysis::AliasResult R = AA->alias(AA->getLocation(SI), Loc);
+    if (R == AliasAnalysis::NoAlias)
+      return MemDepResult();
+    if (R == AliasAnalysis::MustAlias)
+      return MemDepResult::getDef(SI);
+    return MemDepResult::getClobber(SI);
+  }
+
+  // Loading from a fresh allocation is loading undef.
+  if (isa<CallInst>(Inst) && extractMallocCall(Inst)) {
+    const Value *AccessPtr = GetUnderlyingObject(Loc.Ptr, TD);
+    if (AccessPtr == Inst || AA->isMustAlias(Inst, AccessPtr))
+      return MemDepResult::getDef(Inst);
+    return MemDepResult();
+  }
+
+  if (AA->getModRefInfo(Inst, Loc) & AliasAnalysis::Mod)
+    return MemDepResult::getClobber(Inst);
+  return MemDepResult();
+}
+
+namespace {
+  /// MemorySSAWalkEntry - A memory state, the block it reaches and the point
+  /// in that block it reaches: the load being walked for, or the terminator.
+  struct MemorySSAWalkEntry {
+    MemoryAccess *MA;
+    BasicBlock *BB;
+    Instruction *Point;
+  };
+}
+
+/// getNonLocalDepsFromMemorySSA - Compute the non-local dependencies of LI the
+/// way getNonLocalPointerDependency does, walking backwards through the CFG,
+/// but using Memory SSA to step from one def to the next instead of scanning
+/// every instruction.  Each result is the dependency at the end of its block.
+/// Returns false if the walk would have to phi translate the address, which
+/// only memdep knows how to do.
+bool GVN::getNonLocalDepsFromMemorySSA(LoadInst *LI,
+                                       AliasAnalysis::Location Loc,
+                                     SmallVectorImpl<NonLocalDepResult> &Deps) {
+  MemoryUseOrDef *LIAccess = MSSA->getMemoryAccess(LI);
+  if (LIAccess == 0)
+    return false;
+
+  AliasAnalysis *AA = VN.getAliasAnalysis();
+  Value *Ptr = LI->getPointerOperand();
+
+  // Like memdep, be conservative about loads of the same address with
+  // different types: once two of them disagree, ignore the TBAA tags.
+  std::pair<DenseMap<Value*, const MDNode*>::iterator, bool> Tag =
+    NonLocalTBAATags.insert(std::make_pair(Ptr, Loc.TBAATag));
+  if (!Tag.second && Tag.first->second != Loc.TBAATag) {
+    Tag.first->second = 0;
+    Loc = Loc.getWithoutTBAATag();
+  }
+  Value *StrippedPtr = Ptr->stripPointerCasts();
+
+  // The address means the same thing in every block the walk reaches only if
+  // it is computed in a block that dominates all of them.
+  BasicBlock *PtrBB = 0;
+  if (Instruction *PtrInst = dyn_cast<Instruction>(Ptr))
+    PtrBB = PtrInst->getParent();
+
+  // Loads of the same address provide its value if nothing clobbers it in
+  // between; around a loop, that includes LI itself.  Collect them up front
+  // rather than scanning blocks for them.
+  SmallVector<std::pair<LoadInst*, MemoryAccess*>, 8> OtherLoads;
+  SmallVector<Value*, 4> Addrs(1, StrippedPtr);
+  for (unsigned i = 0; i != Addrs.size(); ++i)
+    for (Value::use_iterator UI = Addrs[i]->use_begin(),
+         UE = Addrs[i]->use_end(); UI != UE; ++UI) {
+      if (LoadInst *DepLI = dyn_cast<LoadInst>(*UI)) {
+        if (DepLI->getPointerOperand() != Addrs[i])
+          continue;
+        if (MemoryUseOrDef *MA = MSSA->getMemoryAccess(DepLI))
+          if (AA->alias(AA->getLocation(DepLI), Loc) ==
+              AliasAnalysis::MustAlias)
+            OtherLoads.push_back(std::make_pair(DepLI,
+                                                MA->getDefiningAccess()));
+      } else if (isa<BitCastInst>(*UI) ||
+                 (isa<ConstantExpr>(*UI) &&
+                  cast<ConstantExpr>(*UI)->getOpcode() ==
+                    Instruction::BitCast)) {
+        Addrs.push_back(*UI);
+      }
+    }
+
+  SmallVector<MemorySSAWalkEntry, 16> Worklist;
+  SmallPtrSet<BasicBlock*, 32> Visited;
+  SmallPtrSet<BasicBlock*, 16> ResultBlocks;
+  MemorySSAWalkEntry Start = { LIAccess->getDefiningAccess(), LI->getParent(), LI };
+  Worklist.push_back(Start);
+
+  while (!Worklist.empty()) {
+    MemorySSAWalkEntry E = Worklist.pop_back_val();
+
+    MemDepResult Result;
+    BasicBlock *ResultBB = 0;
+    while (ResultBB == 0) {
+      // A load that sees this state and dominates the point provides the
+      // value.
+      LoadInst *AvailableLoad = 0;
+      for (unsigned i = 0, e = OtherLoads.size(); i != e; ++i)
+        if (OtherLoads[i].second == E.MA && OtherLoads[i].first != E.Point &&
+            DT->dominates(OtherLoads[i].first, E.Point)) {
+          AvailableLoad = OtherLoads[i].first;
+          break;
+        }
+      if (AvailableLoad) {
+        Result = MemDepResult::getDef(AvailableLoad);
+        ResultBB = AvailableLoad->getParent();
+        break;
+      }
+
+      if (MSSA->isLiveOnEntryDef(E.MA) && E.BB == E.MA->getBlock()) {
+        // Nothing on the way stored to the location.  If it is an alloca, it
+        // is undef; otherwise the entry block clobbers it like memdep says.
+        Value *Object = GetUnderlyingObject(Ptr, TD);
+        if (AllocaInst *AI = dyn_cast<AllocaInst>(Object)) {
+          Result = MemDepResult::getDef(AI);
+          ResultBB = AI->getParent();
+        } else {
+          ResultBB = E.BB;
+          Result = MemDepResult::getClobber(ResultBB->begin());
+        }
+        break;
+      }
+
+      // A def in this block is either the dependency or skipped over.
+      if (E.MA->getBlock() == E.BB && isa<MemoryDef>(E.MA)) {
+        MemoryDef *Def = cast<MemoryDef>(E.MA);
+        Result = getLoadDependencyOnDef(Def->getMemoryInst(), Loc, AA, TD);
+        if (Result.isDef() || Result.isClobber())
+          ResultBB = E.BB;
+        else
+          E.MA = Def->getDefiningAccess();
+        continue;
+      }
+
+      // Otherwise the state flows in from the predecessors, which see the
+      // incoming values of the phi if this block has one, or else the same
+      // state.  Unreachable predecessors have their own.
+      if (PtrBB && !DT->properlyDominates(PtrBB, E.BB))
+        return false;
+      MemoryPhi *Phi = dyn_cast<MemoryPhi>(E.MA);
+      if (Phi && Phi->getBlock() != E.BB)
+        Phi = 0;
+      for (pred_iterator PI = pred_begin(E.BB), PE = pred_end(E.BB);
+           PI != PE; ++PI) {
+        BasicBlock *Pred = *PI;
+        if (!Visited.insert(Pred))
+          continue;
+        MemoryAccess *PredMA;
+        if (Phi)
+          PredMA = Phi->getIncomingValueForBlock(Pred);
+        else if (DT->getNode(Pred))
+          PredMA = E.MA;
+        else
+          PredMA = MSSA->getReachingDefAtEnd(Pred);
+        MemorySSAWalkEntry PredEntry = { PredMA, Pred, Pred->getTerminator() };
+        Worklist.push_back(PredEntry);
+      }
+      break;
+    }
+
+    if (ResultBB == 0)
+      continue;
+    if (PtrBB && !DT->dominates(PtrBB, ResultBB))
+      return false;
+
+    // Every result describes the value at the end of its block, so one per
+    // block is enough.
+    if (ResultBlocks.insert(ResultBB))
+      Deps.push_back(NonLocalDepResult(ResultBB, Result, Ptr));
+
+    // The caller gives up on loads with this many dependencies anyway.
+    if (Deps.size() > 100)
+      return true;
+  }
+
+  return true;
+}
+
 /// processNonLocalLoad - Attempt to eliminate a load whose dependencies are
 /// non-local by performing PHI construction.
 bool GVN::processNonLocalLoad(LoadInst *LI) {
-  // Find the non-local dependencies of the load.
+  // Find the non-local dependencies of the load.  Memory SSA answers this
+  // without rescanning blocks, as long as the address needs no phi
+  // translation.
   SmallVector<NonLocalDepResult, 64> Deps;
   AliasAnalysis::Location Loc = VN.getAliasAnalysis()->getLocation(LI);
-  MD->getNonLocalPointerDependency(Loc, true, LI->getParent(), Deps);
+  if (!EnableMemorySSA || !getNonLocalDepsFromMemorySSA(LI, Loc, Deps)) {
+    Deps.clear();
+    MD->getNonLocalPointerDependency(Loc, true, LI->getParent(), Deps);
+  }
   //DEBUG(dbgs() << "INVESTIGATING NONLOCAL LOAD: "
   //             << Deps.size() << *LI << '\n');
 
@@ -1541,6 +1776,7 @@ bool GVN::processNonLocalLoad(LoadInst *LI) {
     while (!NewInsts.empty()) {
       Instruction *I = NewInsts.pop_back_val();
       if (MD) MD->removeInstruction(I);
+      if (MSSA) MSSA->removeMemoryAccess(I);
       I->eraseFromParent();
     }
     return false;
@@ -1578,6 +1814,7 @@ bool GVN::processNonLocalLoad(LoadInst *LI) {
 
     // Transfer DebugLoc.
     NewLoad->setDebugLoc(LI->getDebugLoc());
+    MSSA->createMemoryUse(NewLoad);
 
     // Add the newly created load.
     ValuesPerBlock.push_back(AvailableValueInBlock::get(UnavailablePred,
@@ -1900,8 +2137,10 @@ bool GVN::processInstruction(Instruction *I) {
 
 /// runOnFunction - This is the main transformation entry point for a function.
 bool GVN::runOnFunction(Function& F) {
-  if (!NoLoads)
+  if (!NoLoads) {
     MD = &getAnalysis<MemoryDependenceAnalysis>();
+    MSSA = &getAnalysis<MemorySSA>();
+  }
   DT = &getAnalysis<DominatorTree>();
   TD = getAnalysisIfAvailable<TargetData>();
   VN.setAliasAnalysis(&getAnalysis<AliasAnalysis>());
@@ -1977,6 +2216,7 @@ bool GVN::processBlock(BasicBlock *BB) {
          E = InstrsToErase.end(); I != E; ++I) {
       DEBUG(dbgs() << "GVN removed: " << **I << '\n');
       if (MD) MD->removeInstruction(*I);
+      if (MSSA) MSSA->removeMemoryAccess(*I);
       (*I)->eraseFromParent();
       DEBUG(verifyRemoved(*I));
     }
@@ -2144,6 +2384,7 @@ bool GVN::performPRE(Function &F) {
 
       DEBUG(dbgs() << "GVN PRE removed: " << *CurInst << '\n');
       if (MD) MD->removeInstruction(CurInst);
+      if (MSSA) MSSA->removeMemoryAccess(CurInst);
       CurInst->eraseFromParent();
       DEBUG(verifyRemoved(CurInst));
       Changed = true;
@@ -2194,6 +2435,7 @@ void GVN::cleanupGlobalSets() {
   VN.clear();
   LeaderTable.clear();
   TableAllocator.Reset();
+  NonLocalTBAATags.clear();
 }
 
 /// verifyRemoved - Verify that the specified instruction does not occur in our
@@ -17,6 +17,7 @@
 #include "llvm/LLVMContext.h"
 #include "llvm/Pass.h"
 #include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/Analysis/Loads.h"
@@ -76,6 +77,7 @@ namespace {
   class JumpThreading : public FunctionPass {
     TargetData *TD;
     LazyValueInfo *LVI;
+    DominatorTree *DT;
 #ifdef NDEBUG
     SmallPtrSet<BasicBlock*, 16> LoopHeaders;
 #else
@@ -107,6 +109,7 @@ namespace {
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.addRequired<LazyValueInfo>();
       AU.addPreserved<LazyValueInfo>();
+      AU.addPreserved<DominatorTree>();
     }
 
     void FindLoopHeaders(Function &F);
@@ -126,6 +129,9 @@ namespace {
     bool ProcessBranchOnXOR(BinaryOperator *BO);
 
     bool SimplifyPartiallyRedundantLoad(LoadInst *LI);
+
+    void DeleteDeadEdgesFromDT(BasicBlock *BB,
+                               const SmallVectorImpl<BasicBlock*> &OldSuccs);
   };
 }
 
@@ -145,6 +151,7 @@ bool JumpThreading::runOnFunction(Function &F) {
   DEBUG(dbgs() << "Jump threading on function '" << F.getName() << "'\n");
   TD = getAnalysisIfAvailable<TargetData>();
   LVI = &getAnalysis<LazyValueInfo>();
+  DT = getAnalysisIfAvailable<DominatorTree>();
 
   FindLoopHeaders(F);
 
@@ -192,7 +199,16 @@ bool JumpThreading::runOnFunction(Function &F) {
         // awesome, but it allows us to use AssertingVH to prevent nasty
         // dangling pointer issues within LazyValueInfo.
         LVI->eraseBlock(BB);
+        DomTreeNode *BBNode = DT ? DT->getNode(BB) : 0;
         if (TryToSimplifyUncondBranchFromEmptyBlock(BB)) {
+          // BB's predecessors now branch straight to Succ, which BB dominated
+          // if it dominated anything at all.
+          if (BBNode) {
+            if (!BBNode->getChildren().empty())
+              DT->changeImmediateDominator(DT->getNode(Succ),
+                                           BBNode->getIDom());
+            DT->eraseNode(BB);
+          }
           Changed = true;
           // If we deleted BB and BB was the header of a loop, then the
           // successor is now the header of the loop.
@@ -641,7 +657,7 @@ bool JumpThreading::ProcessBlock(BasicBlock *BB) {
       // will need to move BB back to the entry position.
       bool isEntry = SinglePred == &SinglePred->getParent()->getEntryBlock();
       LVI->eraseBlock(SinglePred);
-      MergeBasicBlockIntoOnlyPred(BB);
+      MergeBasicBlockIntoOnlyPred(BB, this);
 
       if (isEntry && BB != &BB->getParent()->getEntryBlock())
         BB->moveBefore(&BB->getParent()->getEntryBlock());
@@ -687,6 +703,7 @@ bool JumpThreading::ProcessBlock(BasicBlock *BB) {
 
     // Fold the branch/switch.
     TerminatorInst *BBTerm = BB->getTerminator();
+    SmallVector<BasicBlock*, 4> OldSuccs(succ_begin(BB), succ_end(BB));
     for (unsigned i = 0, e = BBTerm->getNumSuccessors(); i != e; ++i) {
       if (i == BestSucc) continue;
       BBTerm->getSuccessor(i)->removePredecessor(BB, true);
@@ -696,6 +713,7 @@ bool JumpThreading::ProcessBlock(BasicBlock *BB) {
           << "' folding undef terminator: " << *BBTerm << '\n');
     BranchInst::Create(BBTerm->getSuccessor(BestSucc), BBTerm);
     BBTerm->eraseFromParent();
+    DeleteDeadEdgesFromDT(BB, OldSuccs);
     return true;
   }
 
@@ -706,7 +724,9 @@ bool JumpThreading::ProcessBlock(BasicBlock *BB) {
     DEBUG(dbgs() << "  In block '" << BB->getName()
           << "' folding terminator: " << *BB->getTerminator() << '\n');
     ++NumFolds;
+    SmallVector<BasicBlock*, 4> OldSuccs(succ_begin(BB), succ_end(BB));
     ConstantFoldTerminator(BB, true);
+    DeleteDeadEdgesFromDT(BB, OldSuccs);
     return true;
   }
 
@@ -751,9 +771,12 @@ bool JumpThreading::ProcessBlock(BasicBlock *BB) {
         if (PI == PE) {
           unsigned ToRemove = Baseline == LazyValueInfo::True ? 1 : 0;
           unsigned ToKeep = Baseline == LazyValueInfo::True ? 0 : 1;
-          CondBr->getSuccessor(ToRemove)->removePredecessor(BB, true);
+          BasicBlock *Removed = CondBr->getSuccessor(ToRemove);
+          Removed->removePredecessor(BB, true);
           BranchInst::Create(CondBr->getSuccessor(ToKeep), CondBr);
           CondBr->eraseFromParent();
+          if (DT)
+            DT->deleteEdge(BB, Removed);
           return true;
         }
       }
@@ -1434,6 +1457,15 @@ bool JumpThreading::ThreadEdge(BasicBlock *BB,
       PredTerm->setSuccessor(i, NewBB);
     }
 
+  if (DT) {
+    DominatorTree::UpdateType Updates[] = {
+      DominatorTree::UpdateType(DomTreeUpdate::Insert, NewBB, SuccBB),
+      DominatorTree::UpdateType(DomTreeUpdate::Insert, PredBB, NewBB),
+      DominatorTree::UpdateType(DomTreeUpdate::Delete, PredBB, BB)
+    };
+    DT->applyUpdates(Updates);
+  }
+
   // At this point, the IR is fully up to date and consistent.  Do a quick scan
   // over the new instructions and zap any that are constants or dead.  This
   // frequently happens because of phi translation.
@@ -1585,8 +1617,35 @@ bool JumpThreading::DuplicateCondBranchOnPHIIntoPred(BasicBlock *BB,
   // Remove the unconditional branch at the end of the PredBB block.
   OldPredBranch->eraseFromParent();
 
+  if (DT) {
+    DominatorTree::UpdateType Updates[] = {
+      DominatorTree::UpdateType(DomTreeUpdate::Delete, PredBB, BB),
+      DominatorTree::UpdateType(DomTreeUpdate::Insert, PredBB,
+                                BBBranch->getSuccessor(0)),
+      DominatorTree::UpdateType(DomTreeUpdate::Insert, PredBB,
+                                BBBranch->getSuccessor(1))
+    };
+    DT->applyUpdates(Updates);
+  }
+
   ++NumDupes;
   return true;
 }
 
 
+
+/// DeleteDeadEdgesFromDT - BB's terminator was folded and now branches to a
+/// subset of OldSuccs.  Tell the dominator tree about the edges that are gone.
+void JumpThreading::DeleteDeadEdgesFromDT(BasicBlock *BB,
+                                 const SmallVectorImpl<BasicBlock*> &OldSuccs) {
+  if (!DT) return;
+
+  SmallPtrSet<BasicBlock*, 4> Live(succ_begin(BB), succ_end(BB));
+  SmallPtrSet<BasicBlock*, 4> Seen;
+  SmallVector<DominatorTree::UpdateType, 4> Updates;
+  for (unsigned i = 0, e = OldSuccs.size(); i != e; ++i)
+    if (!Live.count(OldSuccs[i]) && Seen.insert(OldSuccs[i]))
+      Updates.push_back(DominatorTree::UpdateType(DomTreeUpdate::Delete,
+                                                  BB, OldSuccs[i]));
+  DT->applyUpdates(Updates);
+}
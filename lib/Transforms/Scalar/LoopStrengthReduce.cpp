@@ -3851,6 +3851,8 @@ public:
   static char ID; // Pass ID, replacement for typeid
   explicit LoopStrengthReduce(const TargetLowering *tli = 0);
 
+  Pass *createClone() const { return new LoopStrengthReduce(TLI); }
+
 private:
   bool runOnLoop(Loop *L, LPPassManager &LPM);
   void getAnalysisUsage(AnalysisUsage &AU) const;
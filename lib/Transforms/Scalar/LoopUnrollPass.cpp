@@ -53,6 +53,15 @@ namespace {
       initializeLoopUnrollPass(*PassRegistry::getPassRegistry());
     }
 
+    Pass *createClone() const {
+      LoopUnroll *P = new LoopUnroll();
+      P->CurrentCount = CurrentCount;
+      P->CurrentThreshold = CurrentThreshold;
+      P->CurrentAllowPartial = CurrentAllowPartial;
+      P->UserThreshold = UserThreshold;
+      return P;
+    }
+
     /// A magic value for use with the Threshold parameter to indicate
     /// that the loop unroll should be performed regardless of how much
     /// code expansion would result.
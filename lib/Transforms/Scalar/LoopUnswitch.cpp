@@ -97,6 +97,8 @@ namespace {
         initializeLoopUnswitchPass(*PassRegistry::getPassRegistry());
       }
 
+    Pass *createClone() const { return new LoopUnswitch(OptimizeForSize); }
+
     bool runOnLoop(Loop *L, LPPassManager &LPM);
     bool processCurrentLoop();
 
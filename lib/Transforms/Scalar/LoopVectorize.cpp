@@ -0,0 +1,1069 @@
+//===-- LoopVectorize.cpp - Widen loops into vector code ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass turns simple innermost loops into loops that run VF iterations at
+// a time on vector types.  For example, with a vector width of 4:
+//
+//   for (i = 0; i < n; ++i)              for (i = 0; i < n & -4; i += 4)
+//     A[i] = B[i] + C[i];       ==>        A[i:i+3] = B[i:i+3] + C[i:i+3];
+//                                        for (; i < n; ++i)
+//                                          A[i] = B[i] + C[i];
+//
+// The original loop is kept as the scalar epilogue, which runs the last
+// n % VF iterations, or all of them when a runtime check finds that the
+// arrays overlap.
+//
+// A loop is vectorized when:
+//  - It is an innermost loop whose body is a single block, as left behind by
+//    -loop-rotate, and ScalarEvolution can compute its trip count.
+//  - Every PHI in the header is an induction variable with a constant step,
+//    or a reduction: an integer add, mul, and, or or xor chain whose partial
+//    results are not used elsewhere.
+//  - Loads and stores are simple, and walk memory consecutively.  Their
+//    addresses are computed from induction variables and loop invariants.
+//  - Other instructions are integer or floating point arithmetic and casts.
+//  - Accesses through the same base are far enough apart, accesses through
+//    bases that may alias are checked for overlap at runtime.
+//
+// The vector width is the widest one the target has registers for, as told
+// by TargetLowering, and is halved while the vector loop looks no cheaper
+// than the scalar one.  Without a target, 128-bit registers are assumed.
+//
+// TODO List:
+//
+// Handle loops with control flow, using selects or masked operations.
+// Handle reductions of floating point values under relaxed FP semantics.
+// Handle strided and reversed accesses, and gathers.
+// Use vector compares and selects once the code generator lowers them well.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "loop-vectorize"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Transforms/Utils/VectorCost.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+using namespace llvm;
+
+STATISTIC(NumVectorized, "Number of loops vectorized");
+STATISTIC(NumRuntimeChecked, "Number of vectorized loops with overlap checks");
+
+static cl::opt<unsigned>
+ForceVectorWidth("force-vector-width", cl::init(0), cl::Hidden,
+  cl::desc("Use this vector width for all loops that can be vectorized, "
+           "instead of the cost model's choice"));
+
+/// MaxRuntimeChecks - Give up on loops that need more overlap checks than
+/// this, as they would cost more than the vector loop saves.
+static const unsigned MaxRuntimeChecks = 8;
+
+namespace {
+  /// Induction - A header PHI that advances by a constant step each
+  /// iteration.  Pointer inductions step in bytes.
+  struct Induction {
+    PHINode *Phi;
+    Value *Start;
+    ConstantInt *Step;
+  };
+
+  /// Reduction - A header PHI that accumulates the results of a chain of
+  /// associative operations, whose final value is Exit.
+  struct Reduction {
+    PHINode *Phi;
+    Value *Start;
+    Instruction *Exit;
+    Instruction::BinaryOps Opcode;
+  };
+
+  /// MemAccess - A load or store that walks memory consecutively.
+  struct MemAccess {
+    Instruction *Inst;
+    Value *Ptr;
+    const SCEVAddRecExpr *Ev;
+    uint64_t Size;
+    bool IsWrite;
+  };
+
+  class LoopVectorize : public LoopPass {
+    /// TLI - Keep a pointer of a TargetLowering to consult for the vector
+    /// types and operations that the target supports.
+    const TargetLowering *const TLI;
+
+    Loop *CurLoop;
+    BasicBlock *Body, *Preheader, *ExitBlock;
+    const SCEV *BECount;
+    unsigned VF;
+
+    LoopInfo *LI;
+    DominatorTree *DT;
+    ScalarEvolution *SE;
+    AliasAnalysis *AA;
+    const TargetData *TD;
+
+    SmallVector<Induction, 4> Inductions;
+    SmallVector<Reduction, 4> Reductions;
+    SmallVector<MemAccess, 16> Accesses;
+
+    /// ReductionOps - The operations of the reduction chains.  Each lane of
+    /// the vector loop sums a different subset of the operands, so their
+    /// partial results may wrap where the scalar ones did not.
+    SmallPtrSet<Instruction*, 8> ReductionOps;
+
+    /// Widened - Loop instructions whose values are needed in every lane.
+    SmallPtrSet<Instruction*, 32> Widened;
+    /// Uniform - Loop instructions that only compute addresses, which are
+    /// only needed for the first lane.
+    SmallPtrSet<Instruction*, 32> Uniform;
+
+    /// RuntimeChecks - Pairs of accesses that must not overlap.
+    SmallVector<std::pair<unsigned, unsigned>, MaxRuntimeChecks> RuntimeChecks;
+
+    /// ExitValues - The value each LCSSA PHI in the exit block gets when the
+    /// vector loop runs all of the iterations, as a SCEV or a reduction.
+    SmallVector<std::pair<PHINode*, const SCEV*>, 4> ExitValues;
+
+    // The state of the vector loop being generated.
+    IRBuilder<> *Builder;
+    BasicBlock *VectorPreheader;
+    DenseMap<Value*, Value*> ScalarMap, VectorMap;
+
+  public:
+    static char ID; // Pass ID, replacement for typeid
+    explicit LoopVectorize(const TargetLowering *tli = 0)
+      : LoopPass(ID), TLI(tli) {
+      initializeLoopVectorizePass(*PassRegistry::getPassRegistry());
+    }
+
+    Pass *createClone() const { return new LoopVectorize(TLI); }
+
+    bool runOnLoop(Loop *L, LPPassManager &LPM);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+      AU.addPreserved<LoopInfo>();
+      AU.addRequiredID(LoopSimplifyID);
+      AU.addPreservedID(LoopSimplifyID);
+      AU.addRequiredID(LCSSAID);
+      AU.addPreservedID(LCSSAID);
+      AU.addRequired<AliasAnalysis>();
+      AU.addPreserved<AliasAnalysis>();
+      AU.addRequired<ScalarEvolution>();
+      AU.addPreserved<ScalarEvolution>();
+      AU.addRequired<DominatorTree>();
+      AU.addPreserved<DominatorTree>();
+    }
+
+  private:
+    bool canVectorize();
+    bool isInductionPHI(PHINode *PN);
+    bool isReductionPHI(PHINode *PN);
+    bool addMemAccess(Instruction *I, Value *Ptr, const Type *Ty,
+                      bool IsWrite);
+    bool classifyInstructions();
+    bool checkDependences();
+    bool checkExitValues();
+    bool isVectorElementType(const Type *Ty) const;
+
+    unsigned chooseVectorWidth();
+    unsigned getVectorCost(Instruction *I, unsigned Width) const;
+
+    void vectorizeLoop(LPPassManager &LPM);
+    Value *emitRuntimeChecks(Instruction *Loc);
+    Value *getScalarValue(Value *V);
+    Value *getVectorValue(Value *V);
+    Value *getSplat(Value *V);
+    Value *getInductionStepValue(const Induction &Ind, Value *Base,
+                                 Value *Count, IRBuilder<> &B);
+    Value *getReductionIdentity(const Reduction &Red);
+    Value *reduceVector(const Reduction &Red, Value *Vec, IRBuilder<> &B);
+    const Induction *findInduction(Value *V) const;
+    const Reduction *findReduction(Value *V) const;
+  };
+}
+
+char LoopVectorize::ID = 0;
+INITIALIZE_PASS_BEGIN(LoopVectorize, "loop-vectorize",
+                      "Vectorize loops", false, false)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_PASS_DEPENDENCY(LoopSimplify)
+INITIALIZE_PASS_DEPENDENCY(LCSSA)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
+INITIALIZE_PASS_END(LoopVectorize, "loop-vectorize",
+                    "Vectorize loops", false, false)
+
+Pass *llvm::createLoopVectorizePass(const TargetLowering *TLI) {
+  return new LoopVectorize(TLI);
+}
+
+bool LoopVectorize::runOnLoop(Loop *L, LPPassManager &LPM) {
+  CurLoop = L;
+
+  // Only single block innermost loops, in rotated form, are handled.
+  if (!L->empty() || L->getBlocks().size() != 1)
+    return false;
+  Body = L->getHeader();
+  Preheader = L->getLoopPreheader();
+  ExitBlock = L->getExitBlock();
+  if (!Preheader || !ExitBlock || L->getLoopLatch() != Body ||
+      !isa<BranchInst>(Body->getTerminator()))
+    return false;
+
+  // The vector types are laid out by TargetData.
+  TD = getAnalysisIfAvailable<TargetData>();
+  if (TD == 0)
+    return false;
+
+  LI = &getAnalysis<LoopInfo>();
+  DT = &getAnalysis<DominatorTree>();
+  SE = &getAnalysis<ScalarEvolution>();
+  AA = &getAnalysis<AliasAnalysis>();
+
+  BECount = SE->getBackedgeTakenCount(L);
+  if (isa<SCEVCouldNotCompute>(BECount) || !BECount->getType()->isIntegerTy())
+    return false;
+
+  Inductions.clear();
+  Reductions.clear();
+  ReductionOps.clear();
+  Accesses.clear();
+  Widened.clear();
+  Uniform.clear();
+  RuntimeChecks.clear();
+  ExitValues.clear();
+
+  if (!canVectorize())
+    return false;
+
+  VF = chooseVectorWidth();
+  if (VF < 2)
+    return false;
+
+  // Loops known to run fewer than VF iterations gain nothing.
+  if (const SCEVConstant *C = dyn_cast<SCEVConstant>(BECount))
+    if (C->getValue()->getValue().ult(VF-1))
+      return false;
+
+  // Accesses to the same array must be at least a vector apart; narrow the
+  // vector until they are.
+  for (;;) {
+    RuntimeChecks.clear();
+    if (checkDependences())
+      break;
+    VF /= 2;
+    if (VF < 2)
+      return false;
+  }
+
+  DEBUG(dbgs() << "LV: Vectorizing loop in " << Body->getParent()->getName()
+               << " with width " << VF << "\n");
+  vectorizeLoop(LPM);
+  ++NumVectorized;
+  if (!RuntimeChecks.empty())
+    ++NumRuntimeChecked;
+  return true;
+}
+
+/// isVectorElementType - Return true if vectors of Ty can be built and are
+/// laid out like arrays of Ty.
+bool LoopVectorize::isVectorElementType(const Type *Ty) const {
+  if (!Ty->isIntegerTy() && !Ty->isFloatingPointTy())
+    return false;
+  if (!VectorType::isValidElementType(Ty))
+    return false;
+  return TD->getTypeSizeInBits(Ty) == TD->getTypeAllocSizeInBits(Ty);
+}
+
+/// findInduction - Return the induction variable for PHI V, if any.
+const Induction *LoopVectorize::findInduction(Value *V) const {
+  for (unsigned i = 0, e = Inductions.size(); i != e; ++i)
+    if (Inductions[i].Phi == V)
+      return &Inductions[i];
+  return 0;
+}
+
+/// findReduction - Return the reduction for PHI V, if any.
+const Reduction *LoopVectorize::findReduction(Value *V) const {
+  for (unsigned i = 0, e = Reductions.size(); i != e; ++i)
+    if (Reductions[i].Phi == V)
+      return &Reductions[i];
+  return 0;
+}
+
+/// isInductionPHI - If PN advances by a constant step in each iteration,
+/// record it as an induction variable.
+bool LoopVectorize::isInductionPHI(PHINode *PN) {
+  const Type *Ty = PN->getType();
+  if (!Ty->isIntegerTy() && !Ty->isPointerTy())
+    return false;
+
+  const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(PN));
+  if (!AR || AR->getLoop() != CurLoop || !AR->isAffine())
+    return false;
+  const SCEVConstant *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+  if (!Step)
+    return false;
+
+  Induction Ind;
+  Ind.Phi = PN;
+  Ind.Start = PN->getIncomingValueForBlock(Preheader);
+  Ind.Step = Step->getValue();
+  Inductions.push_back(Ind);
+  return true;
+}
+
+/// isReductionPHI - If PN accumulates a chain of integer operations of one
+/// kind, whose partial results are used nowhere else, record it as a
+/// reduction.
+bool LoopVectorize::isReductionPHI(PHINode *PN) {
+  if (!PN->getType()->isIntegerTy() || PN->getNumIncomingValues() != 2)
+    return false;
+
+  Instruction *Exit =
+    dyn_cast<Instruction>(PN->getIncomingValueForBlock(Body));
+  if (Exit == 0 || Exit->getParent() != Body || !Exit->isAssociative())
+    return false;
+  Instruction::BinaryOps Opcode = cast<BinaryOperator>(Exit)->getOpcode();
+  switch (Opcode) {
+  case Instruction::Add:
+  case Instruction::Mul:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+    break;
+  default:
+    return false;
+  }
+
+  // Walk the chain from the PHI to its exit value.  Each link has a single
+  // user in the loop, the next link, and takes the previous link as exactly
+  // one of its operands.
+  SmallVector<Instruction*, 4> Ops;
+  Instruction *Prev = PN;
+  for (;;) {
+    Instruction *Next = 0;
+    for (Value::use_iterator UI = Prev->use_begin(), E = Prev->use_end();
+         UI != E; ++UI) {
+      Instruction *User = cast<Instruction>(*UI);
+      if (!CurLoop->contains(User)) {
+        // Only the final value may leave the loop.
+        if (Prev != Exit)
+          return false;
+        continue;
+      }
+      if (Prev == Exit && User == PN)
+        continue;
+      if (Next != 0)
+        return false;
+      Next = User;
+    }
+    if (Prev == Exit) {
+      if (Next != 0)
+        return false;
+      break;
+    }
+
+    BinaryOperator *BO = dyn_cast_or_null<BinaryOperator>(Next);
+    if (BO == 0 || BO->getOpcode() != Opcode ||
+        (BO->getOperand(0) == Prev) == (BO->getOperand(1) == Prev))
+      return false;
+    Ops.push_back(BO);
+    Prev = BO;
+  }
+
+  Reduction Red;
+  Red.Phi = PN;
+  Red.Start = PN->getIncomingValueForBlock(Preheader);
+  Red.Exit = Exit;
+  Red.Opcode = Opcode;
+  Reductions.push_back(Red);
+  ReductionOps.insert(Ops.begin(), Ops.end());
+  return true;
+}
+
+/// addMemAccess - Record the load or store I of a Ty through Ptr, if it
+/// walks memory consecutively.
+bool LoopVectorize::addMemAccess(Instruction *I, Value *Ptr, const Type *Ty,
+                                 bool IsWrite) {
+  if (!isVectorElementType(Ty))
+    return false;
+
+  const SCEVAddRecExpr *Ev = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(Ptr));
+  if (!Ev || Ev->getLoop() != CurLoop || !Ev->isAffine())
+    return false;
+  const SCEVConstant *Step = dyn_cast<SCEVConstant>(Ev->getStepRecurrence(*SE));
+  uint64_t Size = TD->getTypeAllocSize(Ty);
+  if (!Step || Step->getValue()->getValue() != Size)
+    return false;
+
+  MemAccess Access;
+  Access.Inst = I;
+  Access.Ptr = Ptr;
+  Access.Ev = Ev;
+  Access.Size = Size;
+  Access.IsWrite = IsWrite;
+  Accesses.push_back(Access);
+  return true;
+}
+
+/// classifyInstructions - Sort the instructions of the loop into the ones
+/// whose values are needed in every lane and the ones that only compute
+/// addresses, and check that each can be generated that way.
+bool LoopVectorize::classifyInstructions() {
+  SmallVector<Value*, 32> WidenWorklist, UniformWorklist;
+
+  for (BasicBlock::iterator I = Body->begin(), E = Body->end(); I != E; ++I) {
+    if (isa<PHINode>(I) || isa<TerminatorInst>(I))
+      continue;
+
+    if (LoadInst *LD = dyn_cast<LoadInst>(I)) {
+      if (LD->isVolatile() ||
+          !addMemAccess(LD, LD->getPointerOperand(), LD->getType(), false))
+        return false;
+      UniformWorklist.push_back(LD->getPointerOperand());
+      continue;
+    }
+    if (StoreInst *SI = dyn_cast<StoreInst>(I)) {
+      if (SI->isVolatile() ||
+          !addMemAccess(SI, SI->getPointerOperand(),
+                        SI->getValueOperand()->getType(), true))
+        return false;
+      UniformWorklist.push_back(SI->getPointerOperand());
+      WidenWorklist.push_back(SI->getValueOperand());
+      continue;
+    }
+    if (I->mayHaveSideEffects() || I->mayReadFromMemory())
+      return false;
+  }
+
+  for (unsigned i = 0, e = Reductions.size(); i != e; ++i)
+    WidenWorklist.push_back(Reductions[i].Exit);
+
+  while (!WidenWorklist.empty()) {
+    Instruction *I = dyn_cast<Instruction>(WidenWorklist.pop_back_val());
+    if (I == 0 || !CurLoop->contains(I) || !Widened.insert(I))
+      continue;
+
+    if (PHINode *PN = dyn_cast<PHINode>(I)) {
+      // Pointer inductions have no vector form.
+      if (!isVectorElementType(PN->getType()))
+        return false;
+      continue;
+    }
+    if (isa<LoadInst>(I))
+      continue;
+
+    if (!isVectorElementType(I->getType()))
+      return false;
+    if (CastInst *CI = dyn_cast<CastInst>(I)) {
+      if (!isVectorElementType(CI->getSrcTy()))
+        return false;
+    } else if (!isa<BinaryOperator>(I)) {
+      return false;
+    }
+    for (unsigned op = 0, e = I->getNumOperands(); op != e; ++op)
+      WidenWorklist.push_back(I->getOperand(op));
+  }
+
+  while (!UniformWorklist.empty()) {
+    Instruction *I = dyn_cast<Instruction>(UniformWorklist.pop_back_val());
+    if (I == 0 || !CurLoop->contains(I) || !Uniform.insert(I))
+      continue;
+
+    // Addresses may not depend on loaded values or reductions.
+    if (PHINode *PN = dyn_cast<PHINode>(I)) {
+      if (!findInduction(PN))
+        return false;
+      continue;
+    }
+    if (!isa<GetElementPtrInst>(I) && !isa<CastInst>(I) &&
+        !isa<BinaryOperator>(I))
+      return false;
+    for (unsigned op = 0, e = I->getNumOperands(); op != e; ++op)
+      UniformWorklist.push_back(I->getOperand(op));
+  }
+
+  return true;
+}
+
+/// checkDependences - Make sure that running VF iterations at once does not
+/// reorder accesses to the same memory.  Accesses through bases that may
+/// alias are queued up in RuntimeChecks.
+bool LoopVectorize::checkDependences() {
+  for (unsigned i = 0, e = Accesses.size(); i != e; ++i) {
+    const MemAccess &A = Accesses[i];
+    if (!A.IsWrite)
+      continue;
+
+    for (unsigned j = 0; j != e; ++j) {
+      const MemAccess &B = Accesses[j];
+      if (i == j || (B.IsWrite && j < i))
+        continue;
+
+      // Accesses to the same address in each iteration stay in order.
+      if (A.Ev == B.Ev)
+        continue;
+
+      const SCEV *BaseA = SE->getPointerBase(A.Ev);
+      const SCEV *BaseB = SE->getPointerBase(B.Ev);
+      if (BaseA == BaseB) {
+        // Accesses through one base must be at least VF elements apart.
+        const SCEVConstant *Dist = dyn_cast<SCEVConstant>(
+          SE->getMinusSCEV(B.Ev->getStart(), A.Ev->getStart()));
+        if (Dist && A.Size == B.Size) {
+          APInt D = Dist->getValue()->getValue().abs();
+          if (D.uge(A.Size * VF))
+            continue;
+          return false;
+        }
+      } else if (isa<SCEVUnknown>(BaseA) && isa<SCEVUnknown>(BaseB)) {
+        // ScalarEvolution only looks at one iteration, so ask about the
+        // bases rather than the addresses.
+        Value *PtrA = cast<SCEVUnknown>(BaseA)->getValue();
+        Value *PtrB = cast<SCEVUnknown>(BaseB)->getValue();
+        if (AA->alias(PtrA, AliasAnalysis::UnknownSize,
+                      PtrB, AliasAnalysis::UnknownSize) ==
+            AliasAnalysis::NoAlias)
+          continue;
+      }
+
+      if (RuntimeChecks.size() == MaxRuntimeChecks)
+        return false;
+      RuntimeChecks.push_back(std::make_pair(i, j));
+    }
+  }
+  return true;
+}
+
+/// checkExitValues - Work out what each value used after the loop is when
+/// the vector loop runs all the iterations.
+bool LoopVectorize::checkExitValues() {
+  for (BasicBlock::iterator I = ExitBlock->begin();
+       PHINode *PN = dyn_cast<PHINode>(I); ++I) {
+    Value *V = PN->getIncomingValueForBlock(Body);
+    Instruction *Inst = dyn_cast<Instruction>(V);
+    if (Inst == 0 || !CurLoop->contains(Inst))
+      continue;
+
+    bool IsReduction = false;
+    for (unsigned i = 0, e = Reductions.size(); i != e; ++i)
+      if (Reductions[i].Exit == Inst)
+        IsReduction = true;
+    if (IsReduction) {
+      ExitValues.push_back(std::make_pair(PN, (const SCEV*)0));
+      continue;
+    }
+
+    if (!SE->isSCEVable(V->getType()))
+      return false;
+    const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(V));
+    if (!AR || AR->getLoop() != CurLoop)
+      return false;
+    ExitValues.push_back(std::make_pair(PN,
+                                        AR->evaluateAtIteration(BECount, *SE)));
+  }
+
+  // LCSSA form puts every other use of a loop value in the loop.
+  for (BasicBlock::iterator I = Body->begin(), E = Body->end(); I != E; ++I)
+    for (Value::use_iterator UI = I->use_begin(), UE = I->use_end();
+         UI != UE; ++UI) {
+      Instruction *User = cast<Instruction>(*UI);
+      if (!CurLoop->contains(User) &&
+          (User->getParent() != ExitBlock || !isa<PHINode>(User)))
+        return false;
+    }
+  return true;
+}
+
+/// canVectorize - Return true if the current loop can be vectorized with
+/// any vector width of at least two.
+bool LoopVectorize::canVectorize() {
+  for (BasicBlock::iterator I = Body->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    if (!isInductionPHI(PN) && !isReductionPHI(PN)) {
+      DEBUG(dbgs() << "LV: Unknown PHI: " << *PN << "\n");
+      return false;
+    }
+  }
+
+  if (!classifyInstructions()) {
+    DEBUG(dbgs() << "LV: Found an instruction that cannot be widened\n");
+    return false;
+  }
+
+  VF = 2;
+  if (!checkDependences()) {
+    DEBUG(dbgs() << "LV: Found a dependence that cannot be checked\n");
+    return false;
+  }
+  if (!checkExitValues()) {
+    DEBUG(dbgs() << "LV: Found an unknown value used after the loop\n");
+    return false;
+  }
+  return true;
+}
+
+/// getVectorCost - Estimate the cost of the vector form of I, in units of a
+/// simple scalar instruction.
+unsigned LoopVectorize::getVectorCost(Instruction *I, unsigned Width) const {
+  const Type *Ty = I->getType();
+  if (StoreInst *SI = dyn_cast<StoreInst>(I))
+    Ty = SI->getValueOperand()->getType();
+  return getVectorizedCost(I->getOpcode(), VectorType::get(Ty, Width), TLI);
+}
+
+/// chooseVectorWidth - Pick the widest vector width that fills a register
+/// with the widest type in the loop and still makes the loop cheaper, or
+/// return 0 if none does.
+unsigned LoopVectorize::chooseVectorWidth() {
+  uint64_t WidestBits = 8;
+  SmallVector<Instruction*, 32> Insts;
+  for (BasicBlock::iterator I = Body->begin(), E = Body->end(); I != E; ++I) {
+    if (!Widened.count(I) && !isa<LoadInst>(I) && !isa<StoreInst>(I))
+      continue;
+    Insts.push_back(I);
+    const Type *Ty = I->getType();
+    if (StoreInst *SI = dyn_cast<StoreInst>(I))
+      Ty = SI->getValueOperand()->getType();
+    WidestBits = std::max(WidestBits, TD->getTypeSizeInBits(Ty));
+  }
+
+  if (ForceVectorWidth)
+    return isPowerOf2_32(ForceVectorWidth) ? ForceVectorWidth : 0;
+
+  // The register width: the widest legal vector of the widest type.
+  uint64_t RegisterBits = getVectorRegisterBits(Body->getContext(), WidestBits,
+                                                TLI);
+
+  unsigned ScalarCost = Insts.size();
+  for (unsigned Width = RegisterBits / WidestBits; Width >= 2; Width /= 2) {
+    unsigned VectorCost = Inductions.size();
+    for (unsigned i = 0, e = Insts.size(); i != e; ++i)
+      VectorCost += getVectorCost(Insts[i], Width);
+    DEBUG(dbgs() << "LV: Width " << Width << " costs " << VectorCost
+                 << " against " << ScalarCost * Width << " scalar\n");
+    if (VectorCost < ScalarCost * Width)
+      return Width;
+  }
+  return 0;
+}
+
+/// getSplat - Return a vector with V in every lane.  Splats of loop
+/// invariants are built outside the vector loop.
+Value *LoopVectorize::getSplat(Value *V) {
+  if (Constant *C = dyn_cast<Constant>(V))
+    return ConstantVector::get(std::vector<Constant*>(VF, C));
+
+  if (Value *Splat = VectorMap.lookup(V))
+    return Splat;
+
+  IRBuilder<> B(VectorPreheader->getTerminator());
+  if (Instruction *I = dyn_cast<Instruction>(V))
+    if (I->getParent() == Builder->GetInsertBlock())
+      B.SetInsertPoint(Builder->GetInsertBlock());
+  const Type *VecTy = VectorType::get(V->getType(), VF);
+  const Type *I32 = Type::getInt32Ty(V->getContext());
+  Value *Ins = B.CreateInsertElement(UndefValue::get(VecTy), V,
+                                     ConstantInt::get(I32, 0));
+  Value *Zeros = ConstantAggregateZero::get(VectorType::get(I32, VF));
+  Value *Splat = B.CreateShuffleVector(Ins, UndefValue::get(VecTy), Zeros,
+                                       V->getName() + ".splat");
+  VectorMap[V] = Splat;
+  return Splat;
+}
+
+/// getInductionStepValue - Return Base advanced by Count steps of induction
+/// Ind.
+Value *LoopVectorize::getInductionStepValue(const Induction &Ind, Value *Base,
+                                            Value *Count, IRBuilder<> &B) {
+  // Pointer inductions step in bytes.
+  const Type *Ty = Ind.Phi->getType();
+  const Type *OffsetTy = Ty;
+  if (Ty->isPointerTy())
+    OffsetTy = TD->getIntPtrType(Ty->getContext());
+
+  Value *Offset = B.CreateIntCast(Count, OffsetTy, false);
+  if (!Ind.Step->isOne())
+    Offset = B.CreateMul(Offset, ConstantExpr::getSExtOrBitCast(Ind.Step,
+                                                                OffsetTy));
+
+  if (Ty->isIntegerTy()) {
+    if (Constant *C = dyn_cast<Constant>(Base))
+      if (C->isNullValue())
+        return Offset;
+    return B.CreateAdd(Base, Offset);
+  }
+  Value *Bytes = B.CreateBitCast(Base, Type::getInt8PtrTy(Ty->getContext()));
+  return B.CreateBitCast(B.CreateGEP(Bytes, Offset), Ty);
+}
+
+/// getScalarValue - Return the value of V in the first lane of the vector
+/// loop: its value in the first of the VF iterations.
+Value *LoopVectorize::getScalarValue(Value *V) {
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (I == 0 || !CurLoop->contains(I))
+    return V;
+
+  if (Value *Scalar = ScalarMap.lookup(V))
+    return Scalar;
+
+  assert(!isa<PHINode>(I) && "Induction PHIs are mapped up front!");
+  Instruction *Clone = I->clone();
+  for (unsigned op = 0, e = I->getNumOperands(); op != e; ++op)
+    Clone->setOperand(op, getScalarValue(I->getOperand(op)));
+  Builder->Insert(Clone, I->getName());
+  ScalarMap[V] = Clone;
+  return Clone;
+}
+
+/// getVectorValue - Return the vector of the values of V in all the lanes of
+/// the vector loop.
+Value *LoopVectorize::getVectorValue(Value *V) {
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (I == 0 || !CurLoop->contains(I))
+    return getSplat(V);
+
+  if (Value *Vec = VectorMap.lookup(V))
+    return Vec;
+
+  Value *Vec;
+  if (PHINode *PN = dyn_cast<PHINode>(I)) {
+    // Reduction PHIs are mapped up front, so this is an induction: lane i
+    // holds the first lane's value plus i steps.
+    const Induction *Ind = findInduction(PN);
+    assert(Ind && "Not an induction!");
+    std::vector<Constant*> Steps;
+    for (unsigned i = 0; i != VF; ++i)
+      Steps.push_back(ConstantInt::getSigned(PN->getType(),
+                                             Ind->Step->getSExtValue() * i));
+    Vec = Builder->CreateAdd(getSplat(getScalarValue(PN)),
+                             ConstantVector::get(Steps),
+                             PN->getName() + ".vec");
+  } else if (CastInst *CI = dyn_cast<CastInst>(I)) {
+    Vec = Builder->CreateCast(CI->getOpcode(),
+                              getVectorValue(CI->getOperand(0)),
+                              VectorType::get(CI->getType(), VF),
+                              CI->getName());
+  } else {
+    BinaryOperator *BO = cast<BinaryOperator>(I);
+    Vec = Builder->CreateBinOp(BO->getOpcode(),
+                               getVectorValue(BO->getOperand(0)),
+                               getVectorValue(BO->getOperand(1)),
+                               BO->getName());
+    // The vector loop reassociates a reduction, so the wrap flags of its
+    // chain no longer hold.
+    if (BinaryOperator *VecBO = dyn_cast<BinaryOperator>(Vec)) {
+      if (isa<OverflowingBinaryOperator>(BO) && !ReductionOps.count(BO)) {
+        VecBO->setHasNoUnsignedWrap(BO->hasNoUnsignedWrap());
+        VecBO->setHasNoSignedWrap(BO->hasNoSignedWrap());
+      }
+      if (isa<PossiblyExactOperator>(BO))
+        VecBO->setIsExact(BO->isExact());
+    }
+  }
+  VectorMap[V] = Vec;
+  return Vec;
+}
+
+/// getReductionIdentity - Return the value that leaves other operands of a
+/// reduction unchanged.
+Value *LoopVectorize::getReductionIdentity(const Reduction &Red) {
+  const Type *Ty = Red.Phi->getType();
+  switch (Red.Opcode) {
+  case Instruction::Mul: return ConstantInt::get(Ty, 1);
+  case Instruction::And: return Constant::getAllOnesValue(Ty);
+  default:               return Constant::getNullValue(Ty);
+  }
+}
+
+/// reduceVector - Combine the lanes of Vec with the operation of Red, by
+/// halving the vector until one lane is left.
+Value *LoopVectorize::reduceVector(const Reduction &Red, Value *Vec,
+                                   IRBuilder<> &B) {
+  const Type *I32 = Type::getInt32Ty(Vec->getContext());
+  for (unsigned Half = VF / 2; Half != 0; Half /= 2) {
+    std::vector<Constant*> Mask;
+    for (unsigned i = 0; i != VF; ++i)
+      Mask.push_back(i < Half ? ConstantInt::get(I32, i + Half) :
+                                UndefValue::get(I32));
+    Value *Shuf = B.CreateShuffleVector(Vec, UndefValue::get(Vec->getType()),
+                                        ConstantVector::get(Mask), "rdx.shuf");
+    Vec = B.CreateBinOp(Red.Opcode, Vec, Shuf, "bin.rdx");
+  }
+  return B.CreateExtractElement(Vec, ConstantInt::get(I32, 0),
+                                Red.Phi->getName() + ".rdx");
+}
+
+/// emitRuntimeChecks - Emit code before Loc that computes whether any of the
+/// pairs of accesses in RuntimeChecks overlap, and return it.
+Value *LoopVectorize::emitRuntimeChecks(Instruction *Loc) {
+  if (RuntimeChecks.empty())
+    return 0;
+
+  SCEVExpander Exp(*SE);
+  IRBuilder<> B(Loc);
+  const Type *I8Ptr = Type::getInt8PtrTy(Loc->getContext());
+
+  // The first byte each access touches and the byte past the last one.
+  SmallVector<Value*, 16> Starts, Ends;
+  for (unsigned i = 0, e = Accesses.size(); i != e; ++i) {
+    const MemAccess &A = Accesses[i];
+    const Type *Ty = A.Ptr->getType();
+    Value *Start = Exp.expandCodeFor(A.Ev->getStart(), Ty, Loc);
+    Value *Last = Exp.expandCodeFor(A.Ev->evaluateAtIteration(BECount, *SE),
+                                    Ty, Loc);
+    Starts.push_back(B.CreateBitCast(Start, I8Ptr));
+    Ends.push_back(B.CreateConstGEP1_64(B.CreateBitCast(Last, I8Ptr), A.Size));
+  }
+
+  Value *Overlap = 0;
+  for (unsigned i = 0, e = RuntimeChecks.size(); i != e; ++i) {
+    unsigned A = RuntimeChecks[i].first, C = RuntimeChecks[i].second;
+    Value *Cmp0 = B.CreateICmpULT(Starts[A], Ends[C], "bound0");
+    Value *Cmp1 = B.CreateICmpULT(Starts[C], Ends[A], "bound1");
+    Value *IsConflict = B.CreateAnd(Cmp0, Cmp1, "found.conflict");
+    Overlap = Overlap ? B.CreateOr(Overlap, IsConflict, "conflict.rdx") :
+                        IsConflict;
+  }
+  return Overlap;
+}
+
+/// vectorizeLoop - Put the vector loop in front of the current loop, which
+/// runs the remaining iterations:
+///
+///   preheader: trip count, runtime checks ---------------+
+///   vector.ph: splats of invariants                      |
+///   vector.body: VF iterations at a time <-+             |
+///                                          |             |
+///   middle.block: reduce, exit if done ----|---------+   |
+///   scalar.ph: resume values <-------------|---------|---+
+///   loop: the original loop                |         |
+///   scalar.exit: LCSSA PHIs                |         |
+///   exit: merges both ways out <-----------|---------+
+///
+void LoopVectorize::vectorizeLoop(LPPassManager &LPM) {
+  Function *F = Body->getParent();
+  LLVMContext &Ctx = F->getContext();
+  Loop *ParentLoop = CurLoop->getParentLoop();
+
+  SE->forgetLoop(CurLoop);
+
+  BasicBlock *VectorPH = BasicBlock::Create(Ctx, "vector.ph", F, Body);
+  BasicBlock *VectorBody = BasicBlock::Create(Ctx, "vector.body", F, Body);
+  BasicBlock *Middle = BasicBlock::Create(Ctx, "middle.block", F, Body);
+  BasicBlock *ScalarPH = BasicBlock::Create(Ctx, "scalar.ph", F, Body);
+  BasicBlock *ScalarExit = BasicBlock::Create(Ctx, "scalar.exit", F,
+                                              ExitBlock);
+  VectorPreheader = VectorPH;
+  BranchInst::Create(VectorBody, VectorPH);
+
+  // Work out the trip count of the vector loop, and whether to run it.
+  Instruction *OldBr = Preheader->getTerminator();
+  SCEVExpander Exp(*SE);
+  const Type *IdxTy = BECount->getType();
+  Value *Count = Exp.expandCodeFor(BECount, IdxTy, OldBr);
+  IRBuilder<> B(OldBr);
+  Count = B.CreateAdd(Count, ConstantInt::get(IdxTy, 1), "trip.count");
+  Value *VectorCount = B.CreateAnd(Count,
+                                   ConstantInt::getSigned(IdxTy, -(int64_t)VF),
+                                   "n.vec");
+  Value *SkipVector = B.CreateICmpEQ(VectorCount,
+                                     Constant::getNullValue(IdxTy),
+                                     "cmp.zero");
+  if (Value *Overlap = emitRuntimeChecks(OldBr))
+    SkipVector = B.CreateOr(SkipVector, Overlap);
+  BranchInst::Create(ScalarPH, VectorPH, SkipVector, Preheader);
+  OldBr->eraseFromParent();
+
+  // The vector loop counts up to the vector trip count.
+  IRBuilder<> VB(VectorBody);
+  Builder = &VB;
+  ScalarMap.clear();
+  VectorMap.clear();
+  PHINode *Index = VB.CreatePHI(IdxTy, 2, "index");
+  Index->addIncoming(Constant::getNullValue(IdxTy), VectorPH);
+
+  // Each induction has a scalar copy for the first lane, which jumps VF
+  // steps at a time.
+  SmallVector<PHINode*, 4> ScalarIVs;
+  for (unsigned i = 0, e = Inductions.size(); i != e; ++i) {
+    PHINode *PN = Inductions[i].Phi;
+    PHINode *IV = VB.CreatePHI(PN->getType(), 2, PN->getName());
+    IV->addIncoming(Inductions[i].Start, VectorPH);
+    ScalarMap[PN] = IV;
+    ScalarIVs.push_back(IV);
+  }
+
+  // Each reduction accumulates a vector, which starts out with the identity
+  // in every lane but the first.
+  SmallVector<PHINode*, 4> VectorPHIs;
+  for (unsigned i = 0, e = Reductions.size(); i != e; ++i) {
+    const Reduction &Red = Reductions[i];
+    const Type *VecTy = VectorType::get(Red.Phi->getType(), VF);
+    PHINode *VP = VB.CreatePHI(VecTy, 2, Red.Phi->getName() + ".vec");
+    IRBuilder<> PB(VectorPH->getTerminator());
+    Value *Init = PB.CreateInsertElement(getSplat(getReductionIdentity(Red)),
+                                         Red.Start,
+                                         ConstantInt::get(Type::getInt32Ty(Ctx),
+                                                          0));
+    VP->addIncoming(Init, VectorPH);
+    VectorMap[Red.Phi] = VP;
+    VectorPHIs.push_back(VP);
+  }
+
+  // Emit the loads and stores in their original order.  Everything else is
+  // generated when it is first needed.
+  for (unsigned i = 0, e = Accesses.size(); i != e; ++i) {
+    const MemAccess &A = Accesses[i];
+    const Type *EltTy = A.Inst->getType();
+    unsigned Align;
+    if (StoreInst *SI = dyn_cast<StoreInst>(A.Inst)) {
+      EltTy = SI->getValueOperand()->getType();
+      Align = SI->getAlignment();
+    } else {
+      Align = cast<LoadInst>(A.Inst)->getAlignment();
+    }
+    if (Align == 0)
+      Align = TD->getABITypeAlignment(EltTy);
+
+    const Type *VecTy = VectorType::get(EltTy, VF);
+    unsigned AS = cast<PointerType>(A.Ptr->getType())->getAddressSpace();
+    Value *Ptr = VB.CreateBitCast(getScalarValue(A.Ptr),
+                                  VecTy->getPointerTo(AS));
+    if (StoreInst *SI = dyn_cast<StoreInst>(A.Inst)) {
+      VB.CreateStore(getVectorValue(SI->getValueOperand()), Ptr)
+        ->setAlignment(Align);
+    } else {
+      LoadInst *LD = VB.CreateLoad(Ptr, A.Inst->getName());
+      LD->setAlignment(Align);
+      VectorMap[A.Inst] = LD;
+    }
+  }
+
+  for (unsigned i = 0, e = Reductions.size(); i != e; ++i)
+    VectorPHIs[i]->addIncoming(getVectorValue(Reductions[i].Exit), VectorBody);
+
+  ConstantInt *Width = ConstantInt::get(cast<IntegerType>(IdxTy), VF);
+  for (unsigned i = 0, e = Inductions.size(); i != e; ++i)
+    ScalarIVs[i]->addIncoming(getInductionStepValue(Inductions[i],
+                                                    ScalarIVs[i], Width, VB),
+                              VectorBody);
+  Value *NextIndex = VB.CreateAdd(Index, Width, "index.next");
+  Index->addIncoming(NextIndex, VectorBody);
+  VB.CreateCondBr(VB.CreateICmpEQ(NextIndex, VectorCount), Middle, VectorBody);
+
+  // In the middle block, combine the lanes of each reduction and work out
+  // where the scalar loop resumes, and the values used after the loop.
+  IRBuilder<> MB(Middle);
+  DenseMap<Value*, Value*> ResumeValues, MiddleValues;
+  for (unsigned i = 0, e = Reductions.size(); i != e; ++i) {
+    const Reduction &Red = Reductions[i];
+    PHINode *LCSSA = MB.CreatePHI(VectorPHIs[i]->getType(), 1,
+                                  Red.Phi->getName() + ".lcssa");
+    LCSSA->addIncoming(getVectorValue(Red.Exit), VectorBody);
+    Value *Result = reduceVector(Red, LCSSA, MB);
+    ResumeValues[Red.Phi] = Result;
+    MiddleValues[Red.Exit] = Result;
+  }
+  for (unsigned i = 0, e = Inductions.size(); i != e; ++i)
+    ResumeValues[Inductions[i].Phi] =
+      getInductionStepValue(Inductions[i], Inductions[i].Start, VectorCount,
+                            MB);
+  Instruction *MiddleBr =
+    MB.CreateCondBr(MB.CreateICmpEQ(VectorCount, Count, "cmp.n"),
+                    ExitBlock, ScalarPH);
+  for (unsigned i = 0, e = ExitValues.size(); i != e; ++i)
+    if (const SCEV *S = ExitValues[i].second) {
+      PHINode *PN = ExitValues[i].first;
+      Value *V = Exp.expandCodeFor(S, PN->getType(), MiddleBr);
+      MiddleValues[PN->getIncomingValueForBlock(Body)] = V;
+    }
+
+  // The scalar loop starts from where the vector loop left off.
+  IRBuilder<> SB(ScalarPH);
+  for (BasicBlock::iterator I = Body->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    int Idx = PN->getBasicBlockIndex(Preheader);
+    PHINode *Resume = SB.CreatePHI(PN->getType(), 2,
+                                   PN->getName() + ".resume");
+    Resume->addIncoming(ResumeValues[PN], Middle);
+    Resume->addIncoming(PN->getIncomingValue(Idx), Preheader);
+    PN->setIncomingValue(Idx, Resume);
+    PN->setIncomingBlock(Idx, ScalarPH);
+  }
+  SB.CreateBr(Body);
+
+  // The scalar loop gets a dedicated exit with its own LCSSA PHIs, and the
+  // old exit block merges both ways out of the loops.
+  BranchInst *LatchBr = cast<BranchInst>(Body->getTerminator());
+  for (unsigned i = 0, e = LatchBr->getNumSuccessors(); i != e; ++i)
+    if (LatchBr->getSuccessor(i) == ExitBlock)
+      LatchBr->setSuccessor(i, ScalarExit);
+  BranchInst::Create(ExitBlock, ScalarExit);
+  for (BasicBlock::iterator I = ExitBlock->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    Value *V = PN->getIncomingValueForBlock(Body);
+    Value *Merged = V;
+    if (Instruction *Inst = dyn_cast<Instruction>(V))
+      if (CurLoop->contains(Inst)) {
+        PHINode *LCSSA = PHINode::Create(V->getType(), 1,
+                                         V->getName() + ".lcssa",
+                                         ScalarExit->begin());
+        LCSSA->addIncoming(V, Body);
+        Merged = LCSSA;
+      }
+    Value *FromMiddle = V;
+    if (Value *MV = MiddleValues.lookup(V))
+      FromMiddle = MV;
+    int Idx = PN->getBasicBlockIndex(Body);
+    PN->setIncomingValue(Idx, Merged);
+    PN->setIncomingBlock(Idx, ScalarExit);
+    PN->addIncoming(FromMiddle, Middle);
+    SE->forgetValue(PN);
+  }
+
+  // Update the dominator tree.
+  DT->addNewBlock(VectorPH, Preheader);
+  DT->addNewBlock(VectorBody, VectorPH);
+  DT->addNewBlock(Middle, VectorBody);
+  DT->addNewBlock(ScalarPH, Preheader);
+  DT->changeImmediateDominator(Body, ScalarPH);
+  DT->addNewBlock(ScalarExit, Body);
+  DT->changeImmediateDominator(ExitBlock, Preheader);
+
+  // Update the loop nest.
+  if (ParentLoop) {
+    ParentLoop->addBasicBlockToLoop(VectorPH, LI->getBase());
+    ParentLoop->addBasicBlockToLoop(Middle, LI->getBase());
+    ParentLoop->addBasicBlockToLoop(ScalarPH, LI->getBase());
+    ParentLoop->addBasicBlockToLoop(ScalarExit, LI->getBase());
+  }
+  Loop *VectorLoop = new Loop();
+  LPM.insertLoop(VectorLoop, ParentLoop);
+  VectorLoop->addBasicBlockToLoop(VectorBody, LI->getBase());
+
+  Builder = 0;
+}
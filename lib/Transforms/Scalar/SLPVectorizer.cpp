@@ -0,0 +1,616 @@
+//===- SLPVectorizer.cpp - Vectorize straight-line code -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass packs isomorphic scalar computations in a basic block into vector
+// instructions, the "superword level parallelism" of unrolled loops and of
+// code that works on adjacent struct fields:
+//
+//   a[0] = b[0] + c[0];
+//   a[1] = b[1] + c[1];         ==>       a[0:3] = b[0:3] + c[0:3];
+//   a[2] = b[2] + c[2];
+//   a[3] = b[3] + c[3];
+//
+// Stores to consecutive addresses seed the search.  ScalarEvolution tells
+// whether two addresses are one element apart.  From a group of VF such
+// stores, the pass walks up the operands of the stored values, lane by lane,
+// and builds a tree of bundles.  A bundle whose lanes are all the same kind
+// of operation (consecutive loads, or binary operators or casts with the same
+// opcode) becomes a vector instruction.  Any other bundle is gathered into a
+// vector with insertelement, or is a constant vector.
+//
+// The vector code replaces the group at the last of its stores.  So the pass
+// checks with AliasAnalysis that no other access in between is reordered
+// with the stores and loads that move there.  Scalars that are still used
+// outside the tree are extracted from the vectors.
+//
+// The tree is only rewritten when the cost model says that the vector code
+// is cheaper than the scalar code it replaces.  The cost model asks the
+// optional TargetLowering which vector operations are legal.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "slp-vectorizer"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/VectorCost.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/ValueHandle.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+using namespace llvm;
+
+STATISTIC(NumStoreGroups, "Number of groups of stores vectorized");
+STATISTIC(NumVectorOps, "Number of vector instructions formed");
+
+/// MaxTreeDepth - Stop following operands this far from the stores.
+static const unsigned MaxTreeDepth = 12;
+
+/// MaxStoresPerType - Only look for adjacent stores among the first stores of
+/// each type in a block, as all pairs of them are compared.
+static const unsigned MaxStoresPerType = 64;
+
+namespace {
+  /// Bundle - A node of the tree: VF scalars, one for each lane, that are
+  /// replaced by a single vector.
+  struct Bundle {
+    SmallVector<Value*, 8> Lanes;
+
+    /// Gather - If true, the lanes are put into a vector one by one.
+    /// Otherwise they are computed by one vector instruction, whose operands
+    /// are the Operands bundles.
+    bool Gather;
+    SmallVector<unsigned, 2> Operands;
+  };
+
+  class SLPVectorizer : public FunctionPass {
+    /// TLI - Keep a pointer of a TargetLowering to consult for the vector
+    /// types and operations that the target supports.
+    const TargetLowering *const TLI;
+
+    AliasAnalysis *AA;
+    ScalarEvolution *SE;
+    const TargetData *TD;
+
+    BasicBlock *BB;
+    unsigned VF;
+
+    /// Order - The position of each instruction in BB.
+    DenseMap<Instruction*, unsigned> Order;
+
+    /// Tree - The bundles for the group of stores being vectorized.  The
+    /// first one holds the stored values.
+    SmallVector<Bundle, 16> Tree;
+
+    /// Scalars - The bundle and lane of each scalar that a vector
+    /// instruction in Tree computes.
+    DenseMap<Value*, std::pair<unsigned, unsigned> > Scalars;
+
+    /// VectorValues - The vector generated for each bundle in Tree.
+    SmallVector<Value*, 16> VectorValues;
+
+  public:
+    static char ID; // Pass identification, replacement for typeid
+    explicit SLPVectorizer(const TargetLowering *tli = 0)
+      : FunctionPass(ID), TLI(tli) {
+      initializeSLPVectorizerPass(*PassRegistry::getPassRegistry());
+    }
+
+    Pass *createClone() const { return new SLPVectorizer(TLI); }
+
+    bool runOnFunction(Function &F);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      AU.addRequired<AliasAnalysis>();
+      AU.addPreserved<AliasAnalysis>();
+      AU.addRequired<ScalarEvolution>();
+    }
+
+  private:
+    bool vectorizeStores();
+    bool vectorizeChain(ArrayRef<StoreInst*> Chain);
+    bool vectorizeGroup(StoreInst **Stores);
+
+    bool isVectorElementType(const Type *Ty) const;
+    bool isConsecutive(Value *PtrA, Value *PtrB, const Type *EltTy) const;
+    bool canVectorizeBundle(ArrayRef<Value*> Lanes) const;
+    unsigned buildTree(ArrayRef<Value*> Lanes, unsigned Depth);
+    bool isSafeToSink(StoreInst **Stores, Instruction *InsertPt);
+    bool isProfitable(StoreInst **Stores, Instruction *InsertPt);
+    Value *emitBundle(unsigned Idx, IRBuilder<> &B);
+    void renumber();
+  };
+}
+
+char SLPVectorizer::ID = 0;
+INITIALIZE_PASS_BEGIN(SLPVectorizer, "slp-vectorizer",
+                      "Vectorize straight-line code", false, false)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
+INITIALIZE_PASS_END(SLPVectorizer, "slp-vectorizer",
+                    "Vectorize straight-line code", false, false)
+
+FunctionPass *llvm::createSLPVectorizerPass(const TargetLowering *TLI) {
+  return new SLPVectorizer(TLI);
+}
+
+bool SLPVectorizer::runOnFunction(Function &F) {
+  // The vector types are laid out by TargetData.
+  TD = getAnalysisIfAvailable<TargetData>();
+  if (TD == 0)
+    return false;
+
+  AA = &getAnalysis<AliasAnalysis>();
+  SE = &getAnalysis<ScalarEvolution>();
+
+  bool Changed = false;
+  for (Function::iterator I = F.begin(), E = F.end(); I != E; ++I) {
+    BB = I;
+    Changed |= vectorizeStores();
+  }
+  return Changed;
+}
+
+/// isVectorElementType - Return true if vectors of Ty can be built and are
+/// laid out like arrays of Ty.
+bool SLPVectorizer::isVectorElementType(const Type *Ty) const {
+  if (!Ty->isIntegerTy() && !Ty->isFloatingPointTy())
+    return false;
+  if (!VectorType::isValidElementType(Ty))
+    return false;
+  return TD->getTypeSizeInBits(Ty) == TD->getTypeAllocSizeInBits(Ty);
+}
+
+/// isConsecutive - Return true if PtrB points to the EltTy right after the
+/// one PtrA points to.
+bool SLPVectorizer::isConsecutive(Value *PtrA, Value *PtrB,
+                                  const Type *EltTy) const {
+  if (PtrA->getType() != PtrB->getType())
+    return false;
+  const SCEVConstant *Dist = dyn_cast<SCEVConstant>(
+    SE->getMinusSCEV(SE->getSCEV(PtrB), SE->getSCEV(PtrA)));
+  return Dist && Dist->getValue()->getValue() == TD->getTypeAllocSize(EltTy);
+}
+
+/// renumber - Record the position of each instruction in BB.
+void SLPVectorizer::renumber() {
+  Order.clear();
+  unsigned Pos = 0;
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+    Order[I] = Pos++;
+}
+
+/// vectorizeStores - Find chains of stores to consecutive addresses in BB,
+/// and try to vectorize each of them.
+bool SLPVectorizer::vectorizeStores() {
+  // Group the simple stores in the block by the type they store.
+  DenseMap<const Type*, SmallVector<StoreInst*, 16> > StoresByType;
+  SmallVector<const Type*, 4> Types;
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+    StoreInst *SI = dyn_cast<StoreInst>(I);
+    if (SI == 0 || SI->isVolatile())
+      continue;
+    const Type *Ty = SI->getValueOperand()->getType();
+    if (!isVectorElementType(Ty))
+      continue;
+    SmallVector<StoreInst*, 16> &Stores = StoresByType[Ty];
+    if (Stores.empty())
+      Types.push_back(Ty);
+    if (Stores.size() < MaxStoresPerType)
+      Stores.push_back(SI);
+  }
+
+  bool Changed = false;
+  renumber();
+  for (unsigned t = 0, te = Types.size(); t != te; ++t) {
+    SmallVector<StoreInst*, 16> &Stores = StoresByType[Types[t]];
+    if (Stores.size() < 2)
+      continue;
+
+    // Link each store to the one that writes the next element.
+    DenseMap<StoreInst*, StoreInst*> Next;
+    SmallPtrSet<StoreInst*, 16> HasPrev;
+    for (unsigned i = 0, e = Stores.size(); i != e; ++i)
+      for (unsigned j = 0; j != e; ++j) {
+        if (i == j || HasPrev.count(Stores[j]))
+          continue;
+        if (isConsecutive(Stores[i]->getPointerOperand(),
+                          Stores[j]->getPointerOperand(), Types[t])) {
+          Next[Stores[i]] = Stores[j];
+          HasPrev.insert(Stores[j]);
+          break;
+        }
+      }
+
+    // Follow each chain up from the store to its lowest address.
+    for (unsigned i = 0, e = Stores.size(); i != e; ++i) {
+      if (HasPrev.count(Stores[i]) || !Next.count(Stores[i]))
+        continue;
+      SmallVector<StoreInst*, 16> Chain;
+      for (StoreInst *SI = Stores[i]; SI; SI = Next.lookup(SI))
+        Chain.push_back(SI);
+      Changed |= vectorizeChain(Chain);
+    }
+  }
+  return Changed;
+}
+
+/// vectorizeChain - Vectorize as many groups of adjacent stores in Chain as
+/// are profitable, trying the widest vectors first.
+bool SLPVectorizer::vectorizeChain(ArrayRef<StoreInst*> Chain) {
+  const Type *EltTy = Chain[0]->getValueOperand()->getType();
+  unsigned EltBits = TD->getTypeSizeInBits(EltTy);
+  unsigned MaxVF = getVectorRegisterBits(EltTy->getContext(), EltBits, TLI) /
+                   EltBits;
+
+  SmallVector<StoreInst*, 16> Stores(Chain.begin(), Chain.end());
+  SmallPtrSet<StoreInst*, 16> Done;
+  bool Changed = false;
+  for (VF = MaxVF; VF >= 2; VF /= 2) {
+    for (unsigned i = 0; i + VF <= Stores.size(); ) {
+      bool Skip = false;
+      for (unsigned l = 0; l != VF; ++l)
+        Skip |= Done.count(Stores[i+l]);
+      if (Skip || !vectorizeGroup(&Stores[i])) {
+        ++i;
+        continue;
+      }
+      for (unsigned l = 0; l != VF; ++l)
+        Done.insert(Stores[i+l]);
+      i += VF;
+      Changed = true;
+    }
+  }
+  return Changed;
+}
+
+/// canVectorizeBundle - Return true if the lanes of a bundle can be computed
+/// by one vector instruction.
+bool SLPVectorizer::canVectorizeBundle(ArrayRef<Value*> Lanes) const {
+  Instruction *I0 = dyn_cast<Instruction>(Lanes[0]);
+  if (I0 == 0 || !isVectorElementType(I0->getType()))
+    return false;
+
+  for (unsigned l = 0; l != VF; ++l) {
+    Instruction *I = dyn_cast<Instruction>(Lanes[l]);
+    if (I == 0 || I->getParent() != BB || I->getOpcode() != I0->getOpcode() ||
+        I->getType() != I0->getType() || Scalars.count(I))
+      return false;
+    for (unsigned k = 0; k != l; ++k)
+      if (Lanes[k] == I)
+        return false;
+
+    // Unreachable code may use values before they are defined; keep the
+    // tree in program order.
+    for (unsigned op = 0, e = I->getNumOperands(); op != e; ++op)
+      if (Instruction *Op = dyn_cast<Instruction>(I->getOperand(op)))
+        if (Op->getParent() == BB && Order.lookup(Op) >= Order.lookup(I))
+          return false;
+
+    if (LoadInst *LD = dyn_cast<LoadInst>(I)) {
+      if (LD->isVolatile())
+        return false;
+      if (l != 0 &&
+          !isConsecutive(cast<LoadInst>(Lanes[l-1])->getPointerOperand(),
+                         LD->getPointerOperand(), LD->getType()))
+        return false;
+    } else if (CastInst *CI = dyn_cast<CastInst>(I)) {
+      const Type *SrcTy = CI->getSrcTy();
+      if (SrcTy != cast<CastInst>(I0)->getSrcTy() ||
+          !isVectorElementType(SrcTy))
+        return false;
+    } else if (!isa<BinaryOperator>(I)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// buildTree - Add a bundle for Lanes to Tree, and bundles for its operands
+/// if it is vectorized.  Return the index of the bundle.
+unsigned SLPVectorizer::buildTree(ArrayRef<Value*> Lanes, unsigned Depth) {
+  // Several users may need the same bundle, as in x*x.
+  if (Scalars.count(Lanes[0])) {
+    unsigned Idx = Scalars[Lanes[0]].first;
+    if (Tree[Idx].Lanes.size() == Lanes.size() &&
+        std::equal(Lanes.begin(), Lanes.end(), Tree[Idx].Lanes.begin()))
+      return Idx;
+  }
+
+  unsigned Idx = Tree.size();
+  Tree.push_back(Bundle());
+  Tree[Idx].Lanes.append(Lanes.begin(), Lanes.end());
+  Tree[Idx].Gather = Depth > MaxTreeDepth || !canVectorizeBundle(Lanes);
+  if (Tree[Idx].Gather)
+    return Idx;
+
+  for (unsigned l = 0; l != VF; ++l)
+    Scalars[Lanes[l]] = std::make_pair(Idx, l);
+
+  // Loads are the leaves of the tree; their addresses stay scalar.
+  Instruction *I0 = cast<Instruction>(Lanes[0]);
+  if (isa<LoadInst>(I0))
+    return Idx;
+
+  for (unsigned op = 0, e = I0->getNumOperands(); op != e; ++op) {
+    SmallVector<Value*, 8> Operands;
+    for (unsigned l = 0; l != VF; ++l)
+      Operands.push_back(cast<Instruction>(Lanes[l])->getOperand(op));
+    unsigned OpIdx = buildTree(Operands, Depth + 1);
+    Tree[Idx].Operands.push_back(OpIdx);
+  }
+  return Idx;
+}
+
+/// isSafeToSink - Return true if the stores of the group and the loads in
+/// Tree can all be moved down to InsertPt without reordering them with other
+/// accesses to the same memory.
+bool SLPVectorizer::isSafeToSink(StoreInst **Stores, Instruction *InsertPt) {
+  SmallPtrSet<Instruction*, 8> GroupStores;
+  for (unsigned l = 0; l != VF; ++l)
+    GroupStores.insert(Stores[l]);
+
+  for (unsigned l = 0; l != VF; ++l) {
+    AliasAnalysis::Location Loc = AA->getLocation(Stores[l]);
+    for (BasicBlock::iterator I = Stores[l]; &*I != InsertPt; ++I)
+      if (!GroupStores.count(I) &&
+          (I->mayReadFromMemory() || I->mayWriteToMemory()) &&
+          AA->getModRefInfo(I, Loc) != AliasAnalysis::NoModRef)
+        return false;
+  }
+
+  for (unsigned Idx = 0, e = Tree.size(); Idx != e; ++Idx) {
+    if (Tree[Idx].Gather || !isa<LoadInst>(Tree[Idx].Lanes[0]))
+      continue;
+    for (unsigned l = 0; l != VF; ++l) {
+      LoadInst *LD = cast<LoadInst>(Tree[Idx].Lanes[l]);
+      AliasAnalysis::Location Loc = AA->getLocation(LD);
+      for (BasicBlock::iterator I = LD; &*I != InsertPt; ++I)
+        if (!GroupStores.count(I) && I->mayWriteToMemory() &&
+            (AA->getModRefInfo(I, Loc) & AliasAnalysis::Mod))
+          return false;
+    }
+  }
+  return true;
+}
+
+/// isProfitable - Return true if the vector code for Tree is cheaper than the
+/// scalar code it replaces.
+bool SLPVectorizer::isProfitable(StoreInst **Stores, Instruction *InsertPt) {
+  SmallPtrSet<Instruction*, 8> GroupStores;
+  for (unsigned l = 0; l != VF; ++l)
+    GroupStores.insert(Stores[l]);
+
+  const Type *EltTy = Stores[0]->getValueOperand()->getType();
+  unsigned ScalarCost = VF;
+  unsigned VectorCost = getVectorizedCost(Instruction::Store,
+                                          VectorType::get(EltTy, VF), TLI);
+
+  for (unsigned Idx = 0, e = Tree.size(); Idx != e; ++Idx) {
+    const Bundle &N = Tree[Idx];
+    if (N.Gather) {
+      bool AllConstant = true, AllSame = true;
+      for (unsigned l = 0; l != VF; ++l) {
+        AllConstant &= isa<Constant>(N.Lanes[l]);
+        AllSame &= N.Lanes[l] == N.Lanes[0];
+      }
+      if (!AllConstant)
+        VectorCost += AllSame ? 1 : VF;
+      continue;
+    }
+
+    Instruction *I0 = cast<Instruction>(N.Lanes[0]);
+    ScalarCost += VF;
+    VectorCost += getVectorizedCost(I0->getOpcode(),
+                                    VectorType::get(I0->getType(), VF), TLI);
+
+    // Scalars used outside of the tree are extracted from the vector, which
+    // must be computed before those uses.
+    for (unsigned l = 0; l != VF; ++l) {
+      Instruction *I = cast<Instruction>(N.Lanes[l]);
+      bool Extracted = false;
+      for (Value::use_iterator UI = I->use_begin(), UE = I->use_end();
+           UI != UE; ++UI) {
+        Instruction *User = cast<Instruction>(*UI);
+        if (Scalars.count(User) || GroupStores.count(User))
+          continue;
+        if (User->getParent() == BB && Order[User] < Order[InsertPt])
+          return false;
+        Extracted = true;
+      }
+      VectorCost += Extracted;
+    }
+  }
+
+  DEBUG(dbgs() << "SLP: Group of " << VF << " stores costs " << VectorCost
+               << " as vectors against " << ScalarCost << " as scalars\n");
+  return VectorCost < ScalarCost;
+}
+
+/// emitBundle - Generate the vector for bundle Idx of Tree, after its
+/// operands.
+Value *SLPVectorizer::emitBundle(unsigned Idx, IRBuilder<> &B) {
+  if (VectorValues[Idx])
+    return VectorValues[Idx];
+
+  const Bundle &N = Tree[Idx];
+  const Type *VecTy = VectorType::get(N.Lanes[0]->getType(), VF);
+  const Type *I32 = Type::getInt32Ty(VecTy->getContext());
+  Value *Vec;
+
+  if (N.Gather) {
+    bool AllConstant = true, AllSame = true;
+    for (unsigned l = 0; l != VF; ++l) {
+      AllConstant &= isa<Constant>(N.Lanes[l]);
+      AllSame &= N.Lanes[l] == N.Lanes[0];
+    }
+
+    if (AllConstant) {
+      std::vector<Constant*> Elts;
+      for (unsigned l = 0; l != VF; ++l)
+        Elts.push_back(cast<Constant>(N.Lanes[l]));
+      Vec = ConstantVector::get(Elts);
+    } else if (AllSame) {
+      Value *Ins = B.CreateInsertElement(UndefValue::get(VecTy), N.Lanes[0],
+                                         ConstantInt::get(I32, 0));
+      Vec = B.CreateShuffleVector(Ins, UndefValue::get(VecTy),
+                                  ConstantAggregateZero::get(
+                                    VectorType::get(I32, VF)));
+    } else {
+      Vec = UndefValue::get(VecTy);
+      for (unsigned l = 0; l != VF; ++l) {
+        Value *V = N.Lanes[l];
+        if (isa<UndefValue>(V))
+          continue;
+        // A scalar the tree computes elsewhere comes out of its vector.
+        DenseMap<Value*, std::pair<unsigned, unsigned> >::iterator S =
+          Scalars.find(V);
+        if (S != Scalars.end())
+          V = B.CreateExtractElement(emitBundle(S->second.first, B),
+                                     ConstantInt::get(I32, S->second.second));
+        Vec = B.CreateInsertElement(Vec, V, ConstantInt::get(I32, l));
+      }
+    }
+    VectorValues[Idx] = Vec;
+    return Vec;
+  }
+
+  Instruction *I0 = cast<Instruction>(N.Lanes[0]);
+  if (LoadInst *LD = dyn_cast<LoadInst>(I0)) {
+    unsigned AS = cast<PointerType>(LD->getPointerOperand()->getType())
+                    ->getAddressSpace();
+    Value *Ptr = B.CreateBitCast(LD->getPointerOperand(),
+                                 VecTy->getPointerTo(AS));
+    LoadInst *VecLoad = B.CreateLoad(Ptr, LD->getName());
+    unsigned Align = LD->getAlignment();
+    if (Align == 0)
+      Align = TD->getABITypeAlignment(LD->getType());
+    VecLoad->setAlignment(Align);
+    Vec = VecLoad;
+  } else if (CastInst *CI = dyn_cast<CastInst>(I0)) {
+    Vec = B.CreateCast(CI->getOpcode(), emitBundle(N.Operands[0], B), VecTy,
+                       CI->getName());
+  } else {
+    BinaryOperator *BO = cast<BinaryOperator>(I0);
+    Vec = B.CreateBinOp(BO->getOpcode(), emitBundle(N.Operands[0], B),
+                        emitBundle(N.Operands[1], B), BO->getName());
+
+    // Keep the flags that hold in every lane.
+    if (BinaryOperator *VecBO = dyn_cast<BinaryOperator>(Vec)) {
+      bool NUW = isa<OverflowingBinaryOperator>(BO);
+      bool NSW = NUW, Exact = isa<PossiblyExactOperator>(BO);
+      for (unsigned l = 0; l != VF; ++l) {
+        BinaryOperator *Lane = cast<BinaryOperator>(N.Lanes[l]);
+        if (isa<OverflowingBinaryOperator>(Lane)) {
+          NUW &= Lane->hasNoUnsignedWrap();
+          NSW &= Lane->hasNoSignedWrap();
+        }
+        if (isa<PossiblyExactOperator>(Lane))
+          Exact &= Lane->isExact();
+      }
+      if (NUW) VecBO->setHasNoUnsignedWrap();
+      if (NSW) VecBO->setHasNoSignedWrap();
+      if (Exact) VecBO->setIsExact();
+    }
+  }
+  ++NumVectorOps;
+  VectorValues[Idx] = Vec;
+  return Vec;
+}
+
+/// vectorizeGroup - Try to replace the VF stores to consecutive addresses
+/// starting at Stores, and the computations of the values they store, with
+/// vector code.
+bool SLPVectorizer::vectorizeGroup(StoreInst **Stores) {
+  // The vector code goes where the last of the stores is.
+  StoreInst *InsertPt = Stores[0];
+  for (unsigned l = 1; l != VF; ++l)
+    if (Order[Stores[l]] > Order[InsertPt])
+      InsertPt = Stores[l];
+
+  Tree.clear();
+  Scalars.clear();
+  SmallVector<Value*, 8> Values;
+  for (unsigned l = 0; l != VF; ++l) {
+    Value *V = Stores[l]->getValueOperand();
+    if (Instruction *I = dyn_cast<Instruction>(V))
+      if (I->getParent() == BB && Order[I] >= Order[Stores[l]])
+        return false;
+    Values.push_back(V);
+  }
+  unsigned Root = buildTree(Values, 0);
+
+  if (!isProfitable(Stores, InsertPt) || !isSafeToSink(Stores, InsertPt))
+    return false;
+
+  DEBUG(dbgs() << "SLP: Vectorizing " << VF << " stores in "
+               << BB->getParent()->getName() << ": " << *Stores[0] << "\n");
+
+  IRBuilder<> B(InsertPt);
+  VectorValues.assign(Tree.size(), 0);
+  Value *Vec = emitBundle(Root, B);
+  StoreInst *SI = Stores[0];
+  unsigned AS = cast<PointerType>(SI->getPointerOperand()->getType())
+                  ->getAddressSpace();
+  Value *Ptr = B.CreateBitCast(SI->getPointerOperand(),
+                               Vec->getType()->getPointerTo(AS));
+  unsigned Align = SI->getAlignment();
+  if (Align == 0)
+    Align = TD->getABITypeAlignment(SI->getValueOperand()->getType());
+  B.CreateStore(Vec, Ptr)->setAlignment(Align);
+
+  // Every use of a scalar in the tree now takes its lane of the vector.
+  // Uses within the tree go away with it.
+  SmallVector<Instruction*, 16> DeadScalars;
+  SmallVector<Instruction*, 16> Extracts;
+  SmallVector<WeakVH, 16> Pointers;
+  const Type *I32 = Type::getInt32Ty(BB->getContext());
+  for (unsigned Idx = 0, e = Tree.size(); Idx != e; ++Idx) {
+    if (Tree[Idx].Gather)
+      continue;
+    for (unsigned l = 0; l != VF; ++l) {
+      Instruction *I = cast<Instruction>(Tree[Idx].Lanes[l]);
+      if (!I->use_empty()) {
+        Value *Lane = B.CreateExtractElement(VectorValues[Idx],
+                                             ConstantInt::get(I32, l));
+        I->replaceAllUsesWith(Lane);
+        Extracts.push_back(cast<Instruction>(Lane));
+      }
+      if (LoadInst *LD = dyn_cast<LoadInst>(I))
+        Pointers.push_back(LD->getPointerOperand());
+      DeadScalars.push_back(I);
+    }
+  }
+  for (unsigned l = 0; l != VF; ++l) {
+    Pointers.push_back(Stores[l]->getPointerOperand());
+    Stores[l]->eraseFromParent();
+  }
+  for (unsigned i = 0, e = DeadScalars.size(); i != e; ++i)
+    DeadScalars[i]->eraseFromParent();
+  for (unsigned i = 0, e = Extracts.size(); i != e; ++i)
+    if (Extracts[i]->use_empty())
+      Extracts[i]->eraseFromParent();
+  for (unsigned i = 0, e = Pointers.size(); i != e; ++i)
+    if (Pointers[i])
+      RecursivelyDeleteTriviallyDeadInstructions(Pointers[i]);
+
+  renumber();
+  ++NumStoreGroups;
+  return true;
+}
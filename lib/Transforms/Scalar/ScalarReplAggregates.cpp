@@ -71,6 +71,9 @@ namespace {
     bool performScalarRepl(Function &F);
     bool performPromotion(Function &F);
 
+  protected:
+    unsigned SRThreshold;
+
   private:
     bool HasDomTree;
     TargetData *TD;
@@ -114,8 +117,6 @@ namespace {
           hasSubelementAccess(false), hasALoadOrStore(false) {}
     };
 
-    unsigned SRThreshold;
-
     void MarkUnsafe(AllocaInfo &I, Instruction *User) {
       I.isUnsafe = true;
       DEBUG(dbgs() << "  Transformation preventing inst: " << *User << '\n');
@@ -162,6 +163,8 @@ namespace {
     SROA_DT(int T = -1) : SROA(T, true, ID) {
       initializeSROA_DTPass(*PassRegistry::getPassRegistry());
     }
+
+    Pass *createClone() const { return new SROA_DT(SRThreshold); }
     
     // getAnalysisUsage - This pass does not require any passes, but we know it
     // will not alter the CFG, so say so.
@@ -178,6 +181,8 @@ namespace {
     SROA_SSAUp(int T = -1) : SROA(T, false, ID) {
       initializeSROA_SSAUpPass(*PassRegistry::getPassRegistry());
     }
+
+    Pass *createClone() const { return new SROA_SSAUp(SRThreshold); }
     
     // getAnalysisUsage - This pass does not require any passes, but we know it
     // will not alter the CFG, so say so.
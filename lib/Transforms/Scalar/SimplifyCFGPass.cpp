@@ -29,9 +29,11 @@
 #include "llvm/IntrinsicInst.h"
 #include "llvm/Module.h"
 #include "llvm/Attributes.h"
+#include "llvm/Analysis/Dominators.h"
 #include "llvm/Support/CFG.h"
 #include "llvm/Pass.h"
 #include "llvm/Target/TargetData.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
@@ -47,6 +49,10 @@ namespace {
     }
 
     virtual bool runOnFunction(Function &F);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addPreserved<DominatorTree>();
+    }
   };
 }
 
@@ -305,8 +311,7 @@ static bool IterativeSimplifyCFG(Function &F, const TargetData *TD) {
 // It is possible that we may require multiple passes over the code to fully
 // simplify the CFG.
 //
-bool CFGSimplifyPass::runOnFunction(Function &F) {
-  const TargetData *TD = getAnalysisIfAvailable<TargetData>();
+static bool SimplifyFunctionCFG(Function &F, const TargetData *TD) {
   bool EverChanged = RemoveUnreachableBlocksFromFn(F);
   EverChanged |= MergeEmptyReturnBlocks(F);
   EverChanged |= IterativeSimplifyCFG(F, TD);
@@ -329,3 +334,103 @@ bool CFGSimplifyPass::runOnFunction(Function &F) {
 
   return true;
 }
+
+namespace {
+  /// CFGSnapshot - The successors of every block of a function at some point,
+  /// used to tell the dominator tree how the CFG changed since then.
+  class CFGSnapshot {
+    typedef SmallVector<BasicBlock*, 2> SuccList;
+
+    BasicBlock *Entry;
+    std::vector<std::pair<BasicBlock*, SuccList> > Blocks;
+    DenseMap<BasicBlock*, unsigned> Index;
+
+    static void getUniqueSuccessors(BasicBlock *BB, SuccList &Succs) {
+      SmallPtrSet<BasicBlock*, 8> Seen;
+      for (succ_iterator SI = succ_begin(BB), SE = succ_end(BB); SI != SE; ++SI)
+        if (Seen.insert(*SI))
+          Succs.push_back(*SI);
+    }
+
+  public:
+    explicit CFGSnapshot(Function &F) : Entry(&F.getEntryBlock()) {
+      Blocks.reserve(F.size());
+      for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+        Index[BB] = Blocks.size();
+        Blocks.push_back(std::make_pair(BB, SuccList()));
+        getUniqueSuccessors(BB, Blocks.back().second);
+      }
+    }
+
+    /// updateDomTree - DT was up to date when the snapshot was taken; bring it
+    /// up to date with F as it is now.
+    void updateDomTree(Function &F, DominatorTree &DT) {
+      if (&F.getEntryBlock() != Entry) {
+        DT.DT->recalculate(F);
+        return;
+      }
+
+      SmallVector<DominatorTree::UpdateType, 16> Updates;
+      std::vector<bool> Live(Blocks.size());
+      SuccList Succs;
+      for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+        Succs.clear();
+        getUniqueSuccessors(BB, Succs);
+
+        DenseMap<BasicBlock*, unsigned>::iterator I = Index.find(BB);
+        if (I == Index.end()) {
+          // A new block: all of its edges are new.
+          for (unsigned i = 0, e = Succs.size(); i != e; ++i)
+            Updates.push_back(DominatorTree::UpdateType(DomTreeUpdate::Insert,
+                                                        BB, Succs[i]));
+          continue;
+        }
+
+        Live[I->second] = true;
+        const SuccList &OldSuccs = Blocks[I->second].second;
+        if (OldSuccs == Succs)
+          continue;
+        SmallPtrSet<BasicBlock*, 8> Old(OldSuccs.begin(), OldSuccs.end());
+        SmallPtrSet<BasicBlock*, 8> New(Succs.begin(), Succs.end());
+        for (unsigned i = 0, e = OldSuccs.size(); i != e; ++i)
+          if (!New.count(OldSuccs[i]))
+            Updates.push_back(DominatorTree::UpdateType(DomTreeUpdate::Delete,
+                                                        BB, OldSuccs[i]));
+        for (unsigned i = 0, e = Succs.size(); i != e; ++i)
+          if (!Old.count(Succs[i]))
+            Updates.push_back(DominatorTree::UpdateType(DomTreeUpdate::Insert,
+                                                        BB, Succs[i]));
+      }
+
+      // Blocks that are gone take all of their edges with them.
+      SmallVector<BasicBlock*, 8> Erased;
+      for (unsigned i = 0, e = Blocks.size(); i != e; ++i) {
+        if (Live[i])
+          continue;
+        BasicBlock *BB = Blocks[i].first;
+        Erased.push_back(BB);
+        const SuccList &OldSuccs = Blocks[i].second;
+        for (unsigned j = 0, je = OldSuccs.size(); j != je; ++j)
+          Updates.push_back(DominatorTree::UpdateType(DomTreeUpdate::Delete,
+                                                      BB, OldSuccs[j]));
+      }
+
+      DT.applyUpdates(Updates, Erased);
+    }
+  };
+}
+
+bool CFGSimplifyPass::runOnFunction(Function &F) {
+  const TargetData *TD = getAnalysisIfAvailable<TargetData>();
+  DominatorTree *DT = getAnalysisIfAvailable<DominatorTree>();
+  if (!DT)
+    return SimplifyFunctionCFG(F, TD);
+
+  // The transforms are too varied to report their CFG edits one at a time, so
+  // compare the CFG before and after and give the difference to the tree.
+  CFGSnapshot Before(F);
+  if (!SimplifyFunctionCFG(F, TD))
+    return false;
+  Before.updateDomTree(F, *DT);
+  return true;
+}
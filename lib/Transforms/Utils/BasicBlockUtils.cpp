@@ -22,6 +22,7 @@
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
 #include "llvm/Target/TargetData.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Transforms/Scalar.h"
@@ -150,6 +151,11 @@ bool llvm::MergeBlockIntoPredecessor(BasicBlock *BB, Pass *P) {
   if (isa<PHINode>(BB->front()))
     FoldSingleEntryPHINodes(BB, P);
   
+  // Memory SSA has to see the accesses while they are still in BB.
+  if (P)
+    if (MemorySSA *MSSA = P->getAnalysisIfAvailable<MemorySSA>())
+      MSSA->mergeBlockIntoPredecessor(BB, PredBB);
+
   // Delete the unconditional branch from the predecessor...
   PredBB->getInstList().pop_back();
   
@@ -444,13 +444,20 @@ void llvm::MergeBasicBlockIntoOnlyPred(BasicBlock *DestBB, Pass *P) {
   
   // Anything that branched to PredBB now branches to DestBB.
   PredBB->replaceAllUsesWith(DestBB);
-  
+
+  // If PredBB was the entry block, DestBB takes its place.
+  bool ReplacesEntry = PredBB == &PredBB->getParent()->getEntryBlock();
+  if (ReplacesEntry)
+    DestBB->moveAfter(PredBB);
+
+  DominatorTree *DT = 0;
   if (P) {
-    DominatorTree *DT = P->getAnalysisIfAvailable<DominatorTree>();
-    if (DT) {
-      BasicBlock *PredBBIDom = DT->getNode(PredBB)->getIDom()->getBlock();
-      DT->changeImmediateDominator(DestBB, PredBBIDom);
-      DT->eraseNode(PredBB);
+    DT = P->getAnalysisIfAvailable<DominatorTree>();
+    if (DT && !ReplacesEntry) {
+      if (DomTreeNode *PredNode = DT->getNode(PredBB)) {
+        DT->changeImmediateDominator(DestBB, PredNode->getIDom()->getBlock());
+        DT->eraseNode(PredBB);
+      }
     }
     ProfileInfo *PI = P->getAnalysisIfAvailable<ProfileInfo>();
     if (PI) {
@@ -460,6 +467,10 @@ void llvm::MergeBasicBlockIntoOnlyPred(BasicBlock *DestBB, Pass *P) {
   }
   // Nuke BB.
   PredBB->eraseFromParent();
+
+  // The tree is rooted at the entry block, so a new entry means a new root.
+  if (DT && ReplacesEntry)
+    DT->DT->recalculate(*DestBB->getParent());
 }
 
 /// CanPropagatePredecessorsForPHIs - Return true if we can fold BB, an
@@ -82,6 +82,9 @@ namespace {
         TLI(tli) {
       initializeLowerInvokePass(*PassRegistry::getPassRegistry());
     }
+    Pass *createClone() const {
+      return new LowerInvoke(TLI, useExpensiveEHSupport);
+    }
     bool doInitialization(Module &M);
     bool runOnFunction(Function &F);
 
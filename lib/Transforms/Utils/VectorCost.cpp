@@ -0,0 +1,107 @@
+//===-- VectorCost.cpp - Vectorizer cost model ----------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the cost model shared by the loop and straight-line
+// vectorizers.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/Utils/VectorCost.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instruction.h"
+#include "llvm/Target/TargetLowering.h"
+#include "llvm/Support/CommandLine.h"
+using namespace llvm;
+
+static cl::opt<unsigned>
+VectorRegisterBits("vector-register-bits", cl::init(128), cl::Hidden,
+  cl::desc("The width of a vector register, in bits, when the target is "
+           "not known"));
+
+unsigned llvm::getVectorRegisterBits(LLVMContext &Context,
+                                     unsigned ElementBits,
+                                     const TargetLowering *TLI) {
+  if (TLI == 0)
+    return VectorRegisterBits;
+
+  const Type *EltTy = IntegerType::get(Context, ElementBits);
+  unsigned RegisterBits = 0;
+  for (unsigned Bits = 2 * ElementBits; Bits <= 512; Bits *= 2)
+    if (TLI->isTypeLegal(EVT::getEVT(VectorType::get(EltTy,
+                                                     Bits / ElementBits))))
+      RegisterBits = Bits;
+  return RegisterBits;
+}
+
+/// getISDOpcode - Return the SelectionDAG node an IR opcode is lowered to,
+/// or zero if it has no single counterpart.
+static int getISDOpcode(unsigned Opcode) {
+  switch (Opcode) {
+  case Instruction::Add:     return ISD::ADD;
+  case Instruction::Sub:     return ISD::SUB;
+  case Instruction::Mul:     return ISD::MUL;
+  case Instruction::UDiv:    return ISD::UDIV;
+  case Instruction::SDiv:    return ISD::SDIV;
+  case Instruction::URem:    return ISD::UREM;
+  case Instruction::SRem:    return ISD::SREM;
+  case Instruction::Shl:     return ISD::SHL;
+  case Instruction::LShr:    return ISD::SRL;
+  case Instruction::AShr:    return ISD::SRA;
+  case Instruction::And:     return ISD::AND;
+  case Instruction::Or:      return ISD::OR;
+  case Instruction::Xor:     return ISD::XOR;
+  case Instruction::FAdd:    return ISD::FADD;
+  case Instruction::FSub:    return ISD::FSUB;
+  case Instruction::FMul:    return ISD::FMUL;
+  case Instruction::FDiv:    return ISD::FDIV;
+  case Instruction::FRem:    return ISD::FREM;
+  case Instruction::Trunc:   return ISD::TRUNCATE;
+  case Instruction::ZExt:    return ISD::ZERO_EXTEND;
+  case Instruction::SExt:    return ISD::SIGN_EXTEND;
+  case Instruction::FPTrunc: return ISD::FP_ROUND;
+  case Instruction::FPExt:   return ISD::FP_EXTEND;
+  case Instruction::FPToUI:  return ISD::FP_TO_UINT;
+  case Instruction::FPToSI:  return ISD::FP_TO_SINT;
+  case Instruction::UIToFP:  return ISD::UINT_TO_FP;
+  case Instruction::SIToFP:  return ISD::SINT_TO_FP;
+  case Instruction::Load:    return ISD::LOAD;
+  case Instruction::Store:   return ISD::STORE;
+  default:                   return 0;
+  }
+}
+
+unsigned llvm::getVectorizedCost(unsigned Opcode, const VectorType *VecTy,
+                                 const TargetLowering *TLI) {
+  unsigned Width = VecTy->getNumElements();
+  unsigned Scalarized = 3 * Width; // Extract, operate and insert each lane.
+
+  if (TLI == 0) {
+    switch (Opcode) {
+    case Instruction::UDiv:
+    case Instruction::SDiv:
+    case Instruction::URem:
+    case Instruction::SRem:
+    case Instruction::FRem:
+      return Scalarized;
+    default:
+      return 1;
+    }
+  }
+
+  int ISD = getISDOpcode(Opcode);
+  if (ISD == 0)
+    return 1;
+  if (TLI->isOperationLegalOrCustom(ISD, EVT::getEVT(VecTy)))
+    return 1;
+  // Loads and stores of illegal vectors are split into one access per lane,
+  // but need no extracts or inserts when their users are split too.
+  if (ISD == ISD::LOAD || ISD == ISD::STORE)
+    return Width;
+  return Scalarized;
+}
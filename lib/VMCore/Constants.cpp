@@ -27,6 +27,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/GetElementPtrTypeIterator.h"
 #include "llvm/ADT/DenseMap.h"
@@ -327,6 +328,7 @@ ConstantInt::ConstantInt(const IntegerType *Ty, const APInt& V)
 
 ConstantInt *ConstantInt::getTrue(LLVMContext &Context) {
   LLVMContextImpl *pImpl = Context.pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->IntConstantsLock);
   if (!pImpl->TheTrueVal)
     pImpl->TheTrueVal = ConstantInt::get(Type::getInt1Ty(Context), 1);
   return pImpl->TheTrueVal;
@@ -334,6 +336,7 @@ ConstantInt *ConstantInt::getTrue(LLVMContext &Context) {
 
 ConstantInt *ConstantInt::getFalse(LLVMContext &Context) {
   LLVMContextImpl *pImpl = Context.pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->IntConstantsLock);
   if (!pImpl->TheFalseVal)
     pImpl->TheFalseVal = ConstantInt::get(Type::getInt1Ty(Context), 0);
   return pImpl->TheFalseVal;
@@ -376,6 +379,7 @@ ConstantInt *ConstantInt::get(LLVMContext &Context, const APInt &V) {
   const IntegerType *ITy = IntegerType::get(Context, V.getBitWidth());
   // get an existing value or the insertion position
   DenseMapAPIntKeyInfo::KeyTy Key(V, ITy);
+  sys::SmartScopedLock<true> Guard(Context.pImpl->IntConstantsLock);
   ConstantInt *&Slot = Context.pImpl->IntConstants[Key]; 
   if (!Slot) Slot = new ConstantInt(ITy, V);
   return Slot;
@@ -505,6 +509,7 @@ ConstantFP* ConstantFP::get(LLVMContext &Context, const APFloat& V) {
   DenseMapAPFloatKeyInfo::KeyTy Key(V);
   
   LLVMContextImpl* pImpl = Context.pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->FPConstantsLock);
   
   ConstantFP *&Slot = pImpl->FPConstants[Key];
     
@@ -1123,6 +1128,7 @@ BlockAddress *BlockAddress::get(BasicBlock *BB) {
 }
 
 BlockAddress *BlockAddress::get(Function *F, BasicBlock *BB) {
+  sys::SmartScopedLock<true> Guard(F->getContext().pImpl->BlockAddressesLock);
   BlockAddress *&BA =
     F->getContext().pImpl->BlockAddresses[std::make_pair(F, BB)];
   if (BA == 0)
@@ -1144,8 +1150,12 @@ BlockAddress::BlockAddress(Function *F, BasicBlock *BB)
 // destroyConstant - Remove the constant from the constant table.
 //
 void BlockAddress::destroyConstant() {
-  getFunction()->getRawType()->getContext().pImpl
-    ->BlockAddresses.erase(std::make_pair(getFunction(), getBasicBlock()));
+  LLVMContextImpl *pImpl = getFunction()->getRawType()->getContext().pImpl;
+  {
+    sys::SmartScopedLock<true> Guard(pImpl->BlockAddressesLock);
+    pImpl->BlockAddresses.erase(std::make_pair(getFunction(),
+                                               getBasicBlock()));
+  }
   getBasicBlock()->AdjustBlockAddressRefCount(-1);
   destroyConstantImpl();
 }
@@ -1961,11 +1971,7 @@ void ConstantArray::replaceUsesOfWithOnConstant(Value *From, Value *To,
 
   LLVMContextImpl *pImpl = getRawType()->getContext().pImpl;
 
-  std::pair<LLVMContextImpl::ArrayConstantsTy::MapKey, ConstantArray*> Lookup;
-  Lookup.first.first = cast<ArrayType>(getRawType());
-  Lookup.second = this;
-
-  std::vector<Constant*> &Values = Lookup.first.second;
+  std::vector<Constant*> Values;
   Values.reserve(getNumOperands());  // Build replacement array.
 
   // Fill values with the modified operands of the constant array.  Also, 
@@ -1999,18 +2005,15 @@ void ConstantArray::replaceUsesOfWithOnConstant(Value *From, Value *To,
     Replacement = ConstantAggregateZero::get(getRawType());
   } else {
     // Check to see if we have this array type already.
-    bool Exists;
-    LLVMContextImpl::ArrayConstantsTy::MapTy::iterator I =
-      pImpl->ArrayConstants.InsertOrGetItem(Lookup, Exists);
+    Replacement =
+      pImpl->ArrayConstants.lookup(cast<ArrayType>(getRawType()), Values);
     
-    if (Exists) {
-      Replacement = I->second;
-    } else {
+    if (!Replacement) {
       // Okay, the new shape doesn't exist in the system yet.  Instead of
       // creating a new constant array, inserting it, replaceallusesof'ing the
       // old with the new, then deleting the old... just update the current one
       // in place!
-      pImpl->ArrayConstants.MoveConstantToNewSlot(this, I);
+      pImpl->ArrayConstants.removeForUpdate(this);
       
       // Update to the new value.  Optimize for the case when we have a single
       // operand that we're changing, but handle bulk updates efficiently.
@@ -2024,6 +2027,7 @@ void ConstantArray::replaceUsesOfWithOnConstant(Value *From, Value *To,
           if (getOperand(i) == From)
             setOperand(i, ToC);
       }
+      pImpl->ArrayConstants.reinsert(this);
       return;
     }
   }
@@ -2046,10 +2050,7 @@ void ConstantStruct::replaceUsesOfWithOnConstant(Value *From, Value *To,
   unsigned OperandToUpdate = U-OperandList;
   assert(getOperand(OperandToUpdate) == From && "ReplaceAllUsesWith broken!");
 
-  std::pair<LLVMContextImpl::StructConstantsTy::MapKey, ConstantStruct*> Lookup;
-  Lookup.first.first = cast<StructType>(getRawType());
-  Lookup.second = this;
-  std::vector<Constant*> &Values = Lookup.first.second;
+  std::vector<Constant*> Values;
   Values.reserve(getNumOperands());  // Build replacement struct.
   
   
@@ -2076,21 +2077,19 @@ void ConstantStruct::replaceUsesOfWithOnConstant(Value *From, Value *To,
     Replacement = ConstantAggregateZero::get(getRawType());
   } else {
     // Check to see if we have this struct type already.
-    bool Exists;
-    LLVMContextImpl::StructConstantsTy::MapTy::iterator I =
-      pImpl->StructConstants.InsertOrGetItem(Lookup, Exists);
+    Replacement =
+      pImpl->StructConstants.lookup(cast<StructType>(getRawType()), Values);
     
-    if (Exists) {
-      Replacement = I->second;
-    } else {
+    if (!Replacement) {
       // Okay, the new shape doesn't exist in the system yet.  Instead of
       // creating a new constant struct, inserting it, replaceallusesof'ing the
       // old with the new, then deleting the old... just update the current one
       // in place!
-      pImpl->StructConstants.MoveConstantToNewSlot(this, I);
+      pImpl->StructConstants.removeForUpdate(this);
       
       // Update to the new value.
       setOperand(OperandToUpdate, ToC);
+      pImpl->StructConstants.reinsert(this);
       return;
     }
   }
@@ -18,10 +18,13 @@
 #include "llvm/InlineAsm.h"
 #include "llvm/Instructions.h"
 #include "llvm/Operator.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/raw_ostream.h"
-#include <map>
+#include <algorithm>
 
 namespace llvm {
 template<class ValType>
@@ -300,6 +303,32 @@ struct OperandTraits<CompareConstantExpr> :
 };
 DEFINE_TRANSPARENT_OPERAND_ACCESSORS(CompareConstantExpr, Value)
 
+/// mixConstantKeyHash - Mix V into the hash value Hash of a constant's key.
+static inline unsigned mixConstantKeyHash(unsigned Hash, unsigned V) {
+  return (Hash ^ V) * 16777619U;
+}
+
+/// hashConstantOperands - Hash the operands [I, E) of a constant, given either
+/// as Constant pointers or as the constant's own Uses.
+template<typename ItTy>
+static inline unsigned hashConstantOperands(ItTy I, ItTy E) {
+  unsigned Hash = mixConstantKeyHash(0, unsigned(E - I));
+  for (; I != E; ++I)
+    Hash = mixConstantKeyHash(Hash,
+                              DenseMapInfo<const Value*>::getHashValue(*I));
+  return Hash;
+}
+
+/// hasConstantOperands - Return true if the operands of U are exactly Ops.
+static inline bool hasConstantOperands(const User *U, ArrayRef<Constant*> Ops) {
+  if (U->getNumOperands() != Ops.size())
+    return false;
+  for (unsigned i = 0, e = Ops.size(); i != e; ++i)
+    if (U->getOperand(i) != Ops[i])
+      return false;
+  return true;
+}
+
 struct ExprMapKeyType {
   ExprMapKeyType(unsigned opc,
       ArrayRef<Constant*> ops,
@@ -334,6 +363,25 @@ struct ExprMapKeyType {
   bool operator!=(const ExprMapKeyType& that) const {
     return !(*this == that);
   }
+
+  /// getHashValue - Hash a key from its fields, so that a ConstantExpr can be
+  /// hashed without building its key.
+  static unsigned getHashValue(uint8_t opcode, uint8_t subclassoptionaldata,
+                               uint16_t subclassdata, unsigned OperandsHash,
+                               ArrayRef<unsigned> indices) {
+    unsigned Hash = mixConstantKeyHash(opcode, subclassdata);
+    Hash = mixConstantKeyHash(Hash, subclassoptionaldata);
+    Hash = mixConstantKeyHash(Hash, OperandsHash);
+    for (unsigned i = 0, e = indices.size(); i != e; ++i)
+      Hash = mixConstantKeyHash(Hash, indices[i]);
+    return Hash;
+  }
+
+  unsigned getHashValue() const {
+    return getHashValue(opcode, subclassoptionaldata, subclassdata,
+                        hashConstantOperands(operands.begin(), operands.end()),
+                        indices);
+  }
 };
 
 struct InlineAsmKeyType {
@@ -367,6 +415,18 @@ struct InlineAsmKeyType {
   bool operator!=(const InlineAsmKeyType& that) const {
     return !(*this == that);
   }
+
+  static unsigned getHashValue(StringRef AsmString, StringRef Constraints,
+                               bool hasSideEffects, bool isAlignStack) {
+    unsigned Hash = mixConstantKeyHash(HashString(AsmString),
+                                       HashString(Constraints));
+    return mixConstantKeyHash(Hash, hasSideEffects * 2 + isAlignStack);
+  }
+
+  unsigned getHashValue() const {
+    return getHashValue(asm_string, constraints, has_side_effects,
+                        is_align_stack);
+  }
 };
 
 // The number of operands for each ConstantCreator::create method is
@@ -397,6 +457,9 @@ struct ConstantCreator {
   }
 };
 
+// ConstantKeyData - Describes the key under which a ConstantUniqueMap keeps a
+// constant. Besides building the key, it can hash a constant and compare it
+// with a key directly, which is what the map does on every lookup.
 template<class ConstantClass>
 struct ConstantKeyData {
   typedef void ValType;
@@ -405,6 +468,48 @@ struct ConstantKeyData {
   }
 };
 
+// KeylessConstantKeyData - The key data for constants that are unique for
+// their type alone.
+template<class ConstantClass>
+struct KeylessConstantKeyData {
+  typedef char ValType;
+  static ValType getValType(ConstantClass *C) {
+    return 0;
+  }
+  static unsigned getHashValue(const ValType &V) {
+    return 0;
+  }
+  static unsigned getHashValue(ConstantClass *C) {
+    return 0;
+  }
+  static bool isEqual(const ValType &V, ConstantClass *C) {
+    return true;
+  }
+};
+
+// OperandListConstantKeyData - The key data for constants that are described
+// by their operands alone.
+template<class ConstantClass>
+struct OperandListConstantKeyData {
+  typedef std::vector<Constant*> ValType;
+  static ValType getValType(ConstantClass *C) {
+    std::vector<Constant*> Elements;
+    Elements.reserve(C->getNumOperands());
+    for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i)
+      Elements.push_back(cast<Constant>(C->getOperand(i)));
+    return Elements;
+  }
+  static unsigned getHashValue(const ValType &V) {
+    return hashConstantOperands(V.begin(), V.end());
+  }
+  static unsigned getHashValue(ConstantClass *C) {
+    return hashConstantOperands(C->op_begin(), C->op_end());
+  }
+  static bool isEqual(const ValType &V, ConstantClass *C) {
+    return hasConstantOperands(C, V);
+  }
+};
+
 template<>
 struct ConstantCreator<ConstantExpr, Type, ExprMapKeyType> {
   static ConstantExpr *create(const Type *Ty, const ExprMapKeyType &V,
@@ -465,6 +570,28 @@ struct ConstantKeyData<ConstantExpr> {
         CE->hasIndices() ?
           CE->getIndices() : ArrayRef<unsigned>());
   }
+  static unsigned getHashValue(const ValType &V) {
+    return V.getHashValue();
+  }
+  static unsigned getHashValue(ConstantExpr *CE) {
+    return ExprMapKeyType::getHashValue(CE->getOpcode(),
+        CE->getRawSubclassOptionalData(),
+        CE->isCompare() ? CE->getPredicate() : 0,
+        hashConstantOperands(CE->op_begin(), CE->op_end()),
+        CE->hasIndices() ? CE->getIndices() : ArrayRef<unsigned>());
+  }
+  static bool isEqual(const ValType &V, ConstantExpr *CE) {
+    if (V.opcode != (uint8_t)CE->getOpcode() ||
+        V.subclassoptionaldata != (uint8_t)CE->getRawSubclassOptionalData() ||
+        V.subclassdata != (uint16_t)(CE->isCompare() ? CE->getPredicate() : 0))
+      return false;
+    if (!hasConstantOperands(CE, V.operands))
+      return false;
+    ArrayRef<unsigned> Indices =
+      CE->hasIndices() ? CE->getIndices() : ArrayRef<unsigned>();
+    return Indices.size() == V.indices.size() &&
+           std::equal(Indices.begin(), Indices.end(), V.indices.begin());
+  }
 };
 
 // ConstantAggregateZero does not take extra "value" argument...
@@ -476,48 +603,20 @@ struct ConstantCreator<ConstantAggregateZero, Type, ValType> {
 };
 
 template<>
-struct ConstantKeyData<ConstantVector> {
-  typedef std::vector<Constant*> ValType;
-  static ValType getValType(ConstantVector *CP) {
-    std::vector<Constant*> Elements;
-    Elements.reserve(CP->getNumOperands());
-    for (unsigned i = 0, e = CP->getNumOperands(); i != e; ++i)
-      Elements.push_back(CP->getOperand(i));
-    return Elements;
-  }
-};
+struct ConstantKeyData<ConstantVector>
+  : public OperandListConstantKeyData<ConstantVector> {};
 
 template<>
-struct ConstantKeyData<ConstantAggregateZero> {
-  typedef char ValType;
-  static ValType getValType(ConstantAggregateZero *C) {
-    return 0;
-  }
-};
+struct ConstantKeyData<ConstantAggregateZero>
+  : public KeylessConstantKeyData<ConstantAggregateZero> {};
 
 template<>
-struct ConstantKeyData<ConstantArray> {
-  typedef std::vector<Constant*> ValType;
-  static ValType getValType(ConstantArray *CA) {
-    std::vector<Constant*> Elements;
-    Elements.reserve(CA->getNumOperands());
-    for (unsigned i = 0, e = CA->getNumOperands(); i != e; ++i)
-      Elements.push_back(cast<Constant>(CA->getOperand(i)));
-    return Elements;
-  }
-};
+struct ConstantKeyData<ConstantArray>
+  : public OperandListConstantKeyData<ConstantArray> {};
 
 template<>
-struct ConstantKeyData<ConstantStruct> {
-  typedef std::vector<Constant*> ValType;
-  static ValType getValType(ConstantStruct *CS) {
-    std::vector<Constant*> Elements;
-    Elements.reserve(CS->getNumOperands());
-    for (unsigned i = 0, e = CS->getNumOperands(); i != e; ++i)
-      Elements.push_back(cast<Constant>(CS->getOperand(i)));
-    return Elements;
-  }
-};
+struct ConstantKeyData<ConstantStruct>
+  : public OperandListConstantKeyData<ConstantStruct> {};
 
 // ConstantPointerNull does not take extra "value" argument...
 template<class ValType>
@@ -528,12 +627,8 @@ struct ConstantCreator<ConstantPointerNull, PointerType, ValType> {
 };
 
 template<>
-struct ConstantKeyData<ConstantPointerNull> {
-  typedef char ValType;
-  static ValType getValType(ConstantPointerNull *C) {
-    return 0;
-  }
-};
+struct ConstantKeyData<ConstantPointerNull>
+  : public KeylessConstantKeyData<ConstantPointerNull> {};
 
 // UndefValue does not take extra "value" argument...
 template<class ValType>
@@ -544,12 +639,8 @@ struct ConstantCreator<UndefValue, Type, ValType> {
 };
 
 template<>
-struct ConstantKeyData<UndefValue> {
-  typedef char ValType;
-  static ValType getValType(UndefValue *C) {
-    return 0;
-  }
-};
+struct ConstantKeyData<UndefValue>
+  : public KeylessConstantKeyData<UndefValue> {};
 
 template<>
 struct ConstantCreator<InlineAsm, PointerType, InlineAsmKeyType> {
@@ -566,32 +657,84 @@ struct ConstantKeyData<InlineAsm> {
     return InlineAsmKeyType(Asm->getAsmString(), Asm->getConstraintString(),
                             Asm->hasSideEffects(), Asm->isAlignStack());
   }
+  static unsigned getHashValue(const ValType &V) {
+    return V.getHashValue();
+  }
+  static unsigned getHashValue(InlineAsm *Asm) {
+    return InlineAsmKeyType::getHashValue(Asm->getAsmString(),
+                                          Asm->getConstraintString(),
+                                          Asm->hasSideEffects(),
+                                          Asm->isAlignStack());
+  }
+  static bool isEqual(const ValType &V, InlineAsm *Asm) {
+    return V.asm_string == Asm->getAsmString() &&
+           V.constraints == Asm->getConstraintString() &&
+           V.has_side_effects == Asm->hasSideEffects() &&
+           V.is_align_stack == Asm->isAlignStack();
+  }
 };
 
-template<class ValType, class TypeClass, class ConstantClass,
-         bool HasLargeKey = false /*true for arrays and structs*/ >
+template<class ValType, class TypeClass, class ConstantClass>
 class ConstantUniqueMap : public AbstractTypeUser {
 public:
-  typedef std::pair<const TypeClass*, ValType> MapKey;
-  typedef std::map<MapKey, ConstantClass *> MapTy;
-  typedef std::map<ConstantClass *, typename MapTy::iterator> InverseMapTy;
-  typedef std::map<const DerivedType*, typename MapTy::iterator>
-    AbstractTypeMapTy;
+  /// LookupKey - Describes the constant wanted by a lookup. It refers to the
+  /// caller's ValType rather than copying it.
+  struct LookupKey {
+    const TypeClass *Ty;
+    const ValType &V;
+    LookupKey(const TypeClass *ty, const ValType &v) : Ty(ty), V(v) {}
+  };
+  typedef std::pair<const TypeClass*, ConstantClass*> MapKey;
+  typedef ConstantKeyData<ConstantClass> KeyData;
+
+  /// MapInfo - The map holds the constants themselves, along with the type
+  /// they were entered with, and is searched with a LookupKey describing the
+  /// constant wanted. The type is kept in the key as an abstract type can be
+  /// forwarded behind our back, which would otherwise change the hash.
+  struct MapInfo {
+    typedef DenseMapInfo<ConstantClass*> ConstantClassInfo;
+    typedef DenseMapInfo<const Type*> TypeInfo;
+    static inline MapKey getEmptyKey() {
+      return MapKey(0, ConstantClassInfo::getEmptyKey());
+    }
+    static inline MapKey getTombstoneKey() {
+      return MapKey(0, ConstantClassInfo::getTombstoneKey());
+    }
+    static unsigned getHashValue(const LookupKey &Val) {
+      return mixConstantKeyHash(TypeInfo::getHashValue(Val.Ty),
+                                KeyData::getHashValue(Val.V));
+    }
+    static unsigned getHashValue(const MapKey &Val) {
+      return mixConstantKeyHash(TypeInfo::getHashValue(Val.first),
+                                KeyData::getHashValue(Val.second));
+    }
+    static bool isEqual(const MapKey &LHS, const MapKey &RHS) {
+      return LHS == RHS;
+    }
+    static bool isEqual(const LookupKey &LHS, const MapKey &RHS) {
+      if (RHS.first == 0)
+        return false;
+      return LHS.Ty == RHS.first && KeyData::isEqual(LHS.V, RHS.second);
+    }
+  };
+
+  typedef DenseMap<MapKey, char, MapInfo> MapTy;
+  typedef std::vector<ConstantClass *> ConstantListTy;
+  typedef DenseMap<const DerivedType*, ConstantListTy> AbstractTypeMapTy;
 private:
   /// Map - This is the main map from the element descriptor to the Constants.
   /// This is the primary way we avoid creating two of the same shape
   /// constant.
   MapTy Map;
-    
-  /// InverseMap - If "HasLargeKey" is true, this contains an inverse mapping
-  /// from the constants to their element in Map.  This is important for
-  /// removal of constants from the array, which would otherwise have to scan
-  /// through the map with very large keys.
-  InverseMapTy InverseMap;
 
-  /// AbstractTypeMap - Map for abstract type constants.
+  /// AbstractTypeMap - The constants of each abstract type in the map.
   ///
   AbstractTypeMapTy AbstractTypeMap;
+
+  /// MapLock - Guards Map and AbstractTypeMap, so that constants can be
+  /// created by several threads at once.  This is a no-op unless
+  /// llvm_is_multithreaded().
+  sys::SmartMutex<true> MapLock;
     
 public:
   typename MapTy::iterator map_begin() { return Map.begin(); }
@@ -601,184 +744,122 @@ public:
     for (typename MapTy::iterator I=Map.begin(), E=Map.end();
          I != E; ++I) {
       // Asserts that use_empty().
-      delete I->second;
+      delete I->first.second;
     }
   }
     
-  /// InsertOrGetItem - Return an iterator for the specified element.
-  /// If the element exists in the map, the returned iterator points to the
-  /// entry and Exists=true.  If not, the iterator points to the newly
-  /// inserted entry and returns Exists=false.  Newly inserted entries have
-  /// I->second == 0, and should be filled in.
-  typename MapTy::iterator InsertOrGetItem(std::pair<MapKey, ConstantClass *>
-                                 &InsertVal,
-                                 bool &Exists) {
-    std::pair<typename MapTy::iterator, bool> IP = Map.insert(InsertVal);
-    Exists = !IP.second;
-    return IP.first;
-  }
-    
 private:
   typename MapTy::iterator FindExistingElement(ConstantClass *CP) {
-    if (HasLargeKey) {
-      typename InverseMapTy::iterator IMI = InverseMap.find(CP);
-      assert(IMI != InverseMap.end() && IMI->second != Map.end() &&
-             IMI->second->second == CP &&
-             "InverseMap corrupt!");
-      return IMI->second;
-    }
-      
     typename MapTy::iterator I =
-      Map.find(MapKey(static_cast<const TypeClass*>(CP->getRawType()),
-                      ConstantKeyData<ConstantClass>::getValType(CP)));
-    if (I == Map.end() || I->second != CP) {
+      Map.find(MapKey(cast<TypeClass>(CP->getRawType()), CP));
+    if (I == Map.end()) {
+      // The type of the constant was forwarded since it was entered.
       // FIXME: This should not use a linear scan.  If this gets to be a
       // performance problem, someone should look at this.
-      for (I = Map.begin(); I != Map.end() && I->second != CP; ++I)
+      for (I = Map.begin(); I != Map.end() && I->first.second != CP; ++I)
         /* empty */;
     }
     return I;
   }
     
-  void AddAbstractTypeUser(const Type *Ty, typename MapTy::iterator I) {
+  void AddAbstractTypeUser(const Type *Ty, ConstantClass *C) {
     // If the type of the constant is abstract, make sure that an entry
     // exists for it in the AbstractTypeMap.
     if (Ty->isAbstract()) {
       const DerivedType *DTy = static_cast<const DerivedType *>(Ty);
-      typename AbstractTypeMapTy::iterator TI = AbstractTypeMap.find(DTy);
+      ConstantListTy &Constants = AbstractTypeMap[DTy];
 
-      if (TI == AbstractTypeMap.end()) {
-        // Add ourselves to the ATU list of the type.
+      // Add ourselves to the ATU list of the type.
+      if (Constants.empty())
         cast<DerivedType>(DTy)->addAbstractTypeUser(this);
+      Constants.push_back(C);
+    }
+  }
 
-        AbstractTypeMap.insert(TI, std::make_pair(DTy, I));
-      }
+  /// RemoveAbstractTypeUser - C of abstract type Ty is leaving the map.
+  /// Forget about it, and stop listening to Ty if it was the last constant of
+  /// that type.
+  void RemoveAbstractTypeUser(const DerivedType *Ty, ConstantClass *C) {
+    typename AbstractTypeMapTy::iterator ATI = AbstractTypeMap.find(Ty);
+    assert(ATI != AbstractTypeMap.end() &&
+           "Abstract type not in AbstractTypeMap?");
+    ConstantListTy &Constants = ATI->second;
+    typename ConstantListTy::iterator CI =
+      std::find(Constants.begin(), Constants.end(), C);
+    assert(CI != Constants.end() && "Constant not in AbstractTypeMap?");
+    *CI = Constants.back();
+    Constants.pop_back();
+
+    if (Constants.empty()) {
+      // We are removing the last instance of this type from the table.
+      // Remove from the ATM, and from user list.
+      AbstractTypeMap.erase(ATI);
+      cast<DerivedType>(Ty)->removeAbstractTypeUser(this);
     }
   }
 
-  ConstantClass* Create(const TypeClass *Ty, const ValType &V,
-                        typename MapTy::iterator I) {
+  ConstantClass* Create(const TypeClass *Ty, const ValType &V) {
     ConstantClass* Result =
       ConstantCreator<ConstantClass,TypeClass,ValType>::create(Ty, V);
 
     assert(Result->getType() == Ty && "Type specified is not correct!");
-    I = Map.insert(I, std::make_pair(MapKey(Ty, V), Result));
-
-    if (HasLargeKey)  // Remember the reverse mapping if needed.
-      InverseMap.insert(std::make_pair(Result, I));
+    Map[MapKey(Ty, Result)] = 0;
 
-    AddAbstractTypeUser(Ty, I);
+    AddAbstractTypeUser(Ty, Result);
       
     return Result;
   }
 public:
     
+  /// lookup - Return the constant of type Ty described by V, or null if there
+  /// isn't one yet.
+  ConstantClass *lookup(const TypeClass *Ty, const ValType &V) {
+    sys::SmartScopedLock<true> Guard(MapLock);
+    typename MapTy::iterator I = Map.find_as(LookupKey(Ty, V));
+    return I != Map.end() ? I->first.second : 0;
+  }
+
   /// getOrCreate - Return the specified constant from the map, creating it if
   /// necessary.
   ConstantClass *getOrCreate(const TypeClass *Ty, const ValType &V) {
-    MapKey Lookup(Ty, V);
-    ConstantClass* Result = 0;
-    
-    typename MapTy::iterator I = Map.find(Lookup);
+    sys::SmartScopedLock<true> Guard(MapLock);
+
     // Is it in the map?  
-    if (I != Map.end())
-      Result = I->second;
-        
-    if (!Result) {
-      // If no preexisting value, create one now...
-      Result = Create(Ty, V, I);
-    }
+    if (ConstantClass *Result = lookup(Ty, V))
+      return Result;
         
-    return Result;
-  }
-
-  void UpdateAbstractTypeMap(const DerivedType *Ty,
-                             typename MapTy::iterator I) {
-    assert(AbstractTypeMap.count(Ty) &&
-           "Abstract type not in AbstractTypeMap?");
-    typename MapTy::iterator &ATMEntryIt = AbstractTypeMap[Ty];
-    if (ATMEntryIt == I) {
-      // Yes, we are removing the representative entry for this type.
-      // See if there are any other entries of the same type.
-      typename MapTy::iterator TmpIt = ATMEntryIt;
-
-      // First check the entry before this one...
-      if (TmpIt != Map.begin()) {
-        --TmpIt;
-        if (TmpIt->first.first != Ty) // Not the same type, move back...
-          ++TmpIt;
-      }
-
-      // If we didn't find the same type, try to move forward...
-      if (TmpIt == ATMEntryIt) {
-        ++TmpIt;
-        if (TmpIt == Map.end() || TmpIt->first.first != Ty)
-          --TmpIt;   // No entry afterwards with the same type
-      }
-
-      // If there is another entry in the map of the same abstract type,
-      // update the AbstractTypeMap entry now.
-      if (TmpIt != ATMEntryIt) {
-        ATMEntryIt = TmpIt;
-      } else {
-        // Otherwise, we are removing the last instance of this type
-        // from the table.  Remove from the ATM, and from user list.
-        cast<DerivedType>(Ty)->removeAbstractTypeUser(this);
-        AbstractTypeMap.erase(Ty);
-      }
-    }
+    // If no preexisting value, create one now...
+    return Create(Ty, V);
   }
 
   void remove(ConstantClass *CP) {
+    sys::SmartScopedLock<true> Guard(MapLock);
     typename MapTy::iterator I = FindExistingElement(CP);
     assert(I != Map.end() && "Constant not found in constant table!");
-    assert(I->second == CP && "Didn't find correct element?");
-
-    if (HasLargeKey)  // Remember the reverse mapping if needed.
-      InverseMap.erase(CP);
-      
-    // Now that we found the entry, make sure this isn't the entry that
-    // the AbstractTypeMap points to.
     const TypeClass *Ty = I->first.first;
+    Map.erase(I);
+
     if (Ty->isAbstract())
-      UpdateAbstractTypeMap(static_cast<const DerivedType *>(Ty), I);
+      RemoveAbstractTypeUser(static_cast<const DerivedType *>(Ty), CP);
+  }
 
+  /// removeForUpdate - Take C out of the map before its operands are changed
+  /// in place. Its type must not change, and it must be put back with
+  /// reinsert once the update is done.
+  void removeForUpdate(ConstantClass *C) {
+    sys::SmartScopedLock<true> Guard(MapLock);
+    typename MapTy::iterator I = FindExistingElement(C);
+    assert(I != Map.end() && "Constant not found in constant table!");
     Map.erase(I);
   }
 
-  /// MoveConstantToNewSlot - If we are about to change C to be the element
-  /// specified by I, update our internal data structures to reflect this
-  /// fact.
-  void MoveConstantToNewSlot(ConstantClass *C, typename MapTy::iterator I) {
-    // First, remove the old location of the specified constant in the map.
-    typename MapTy::iterator OldI = FindExistingElement(C);
-    assert(OldI != Map.end() && "Constant not found in constant table!");
-    assert(OldI->second == C && "Didn't find correct element?");
-      
-    // If this constant is the representative element for its abstract type,
-    // update the AbstractTypeMap so that the representative element is I.
-    //
-    // This must use getRawType() because if the type is under refinement, we
-    // will get the refineAbstractType callback below, and we don't want to
-    // kick union find in on the constant.
-    if (C->getRawType()->isAbstract()) {
-      typename AbstractTypeMapTy::iterator ATI =
-          AbstractTypeMap.find(cast<DerivedType>(C->getRawType()));
-      assert(ATI != AbstractTypeMap.end() &&
-             "Abstract type not in AbstractTypeMap?");
-      if (ATI->second == OldI)
-        ATI->second = I;
-    }
-      
-    // Remove the old entry from the map.
-    Map.erase(OldI);
-    
-    // Update the inverse map so that we know that this constant is now
-    // located at descriptor I.
-    if (HasLargeKey) {
-      assert(I->second == C && "Bad inversemap entry!");
-      InverseMap[C] = I;
-    }
+  /// reinsert - Put C back in the map after updating it in place. No other
+  /// constant may have its new shape.
+  void reinsert(ConstantClass *C) {
+    sys::SmartScopedLock<true> Guard(MapLock);
+    MapKey Key(cast<TypeClass>(C->getRawType()), C);
+    assert(!Map.count(Key) && "Constant already in the map!");
+    Map[Key] = 0;
   }
     
   void refineAbstractType(const DerivedType *OldTy, const Type *NewTy) {
@@ -791,37 +872,21 @@ public:
     // leaving will remove() itself, causing the AbstractTypeMapEntry to be
     // eliminated eventually.
     do {
-      ConstantClass *C = I->second->second;
-      MapKey Key(cast<TypeClass>(NewTy),
-                 ConstantKeyData<ConstantClass>::getValType(C));
-
-      std::pair<typename MapTy::iterator, bool> IP =
-        Map.insert(std::make_pair(Key, C));
-      if (IP.second) {
-        // The map didn't previously have an appropriate constant in the
-        // new type.
-        
-        // Remove the old entry.
-        typename MapTy::iterator OldI =
-          Map.find(MapKey(cast<TypeClass>(OldTy), IP.first->first.second));
-        assert(OldI != Map.end() && "Constant not in map!");
-        UpdateAbstractTypeMap(OldTy, OldI);
-        Map.erase(OldI);
-
-        // Set the constant's type. This is done in place!
-        setType(C, NewTy);
-
-        // Update the inverse map so that we know that this constant is now
-        // located at descriptor I.
-        if (HasLargeKey)
-          InverseMap[C] = IP.first;
-
-        AddAbstractTypeUser(NewTy, IP.first);
-      } else {
+      ConstantClass *C = I->second.back();
+      if (ConstantClass *Existing =
+            lookup(cast<TypeClass>(NewTy), KeyData::getValType(C))) {
         // The map already had an appropriate constant in the new type, so
         // there's no longer a need for the old constant.
-        C->uncheckedReplaceAllUsesWith(IP.first->second);
+        C->uncheckedReplaceAllUsesWith(Existing);
         C->destroyConstant();    // This constant is now dead, destroy it.
+      } else {
+        // The map didn't previously have an appropriate constant in the
+        // new type.  Move the old one over, changing its type in place!
+        Map.erase(MapKey(cast<TypeClass>(OldTy), C));
+        RemoveAbstractTypeUser(OldTy, C);
+        setType(C, NewTy);
+        Map[MapKey(cast<TypeClass>(NewTy), C)] = 0;
+        AddAbstractTypeUser(NewTy, C);
       }
       I = AbstractTypeMap.find(OldTy);
     } while (I != AbstractTypeMap.end());
@@ -830,6 +895,7 @@ public:
   // If the type became concrete without being refined to any other existing
   // type, we just remove ourselves from the ATU list.
   void typeBecameConcrete(const DerivedType *AbsTy) {
+    AbstractTypeMap.erase(AbsTy);
     AbsTy->removeAbstractTypeUser(this);
   }
 
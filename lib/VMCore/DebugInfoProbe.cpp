@@ -197,6 +197,11 @@ DebugInfoProbeInfo::~DebugInfoProbeInfo() {
     }
   }
 
+/// isEnabled - Return true if -enable-debug-info-probe is specified.
+bool DebugInfoProbeInfo::isEnabled() const {
+  return EnableDebugInfoProbe;
+}
+
 /// initialize - Collect information before running an optimization pass.
 void DebugInfoProbeInfo::initialize(Pass *P, Function &F) {
   if (!EnableDebugInfoProbe) return;
@@ -18,6 +18,7 @@ using namespace llvm;
 
 MDNode *DebugLoc::getScope(const LLVMContext &Ctx) const {
   if (ScopeIdx == 0) return 0;
+  sys::SmartScopedLock<true> Guard(Ctx.pImpl->ValueHandlesLock);
   
   if (ScopeIdx > 0) {
     // Positive ScopeIdx is an index into ScopeRecords, which has no inlined-at
@@ -37,6 +38,7 @@ MDNode *DebugLoc::getInlinedAt(const LLVMContext &Ctx) const {
   // Positive ScopeIdx is an index into ScopeRecords, which has no inlined-at
   // position specified.  Zero is invalid.
   if (ScopeIdx >= 0) return 0;
+  sys::SmartScopedLock<true> Guard(Ctx.pImpl->ValueHandlesLock);
   
   // Otherwise, the index is in the ScopeInlinedAtRecords array.
   assert(unsigned(-ScopeIdx) <= Ctx.pImpl->ScopeInlinedAtRecords.size() &&
@@ -51,6 +53,7 @@ void DebugLoc::getScopeAndInlinedAt(MDNode *&Scope, MDNode *&IA,
     Scope = IA = 0;
     return;
   }
+  sys::SmartScopedLock<true> Guard(Ctx.pImpl->ValueHandlesLock);
   
   if (ScopeIdx > 0) {
     // Positive ScopeIdx is an index into ScopeRecords, which has no inlined-at
@@ -157,6 +160,8 @@ bool DenseMapInfo<DebugLoc>::isEqual(const DebugLoc &LHS, const DebugLoc &RHS) {
 
 int LLVMContextImpl::getOrAddScopeRecordIdxEntry(MDNode *Scope,
                                                  int ExistingIdx) {
+  sys::SmartScopedLock<true> Guard(ValueHandlesLock);
+
   // If we already have an entry for this scope, return it.
   int &Idx = ScopeRecordIdx[Scope];
   if (Idx) return Idx;
@@ -180,6 +185,8 @@ int LLVMContextImpl::getOrAddScopeRecordIdxEntry(MDNode *Scope,
 
 int LLVMContextImpl::getOrAddScopeInlinedAtIdxEntry(MDNode *Scope, MDNode *IA,
                                                     int ExistingIdx) {
+  sys::SmartScopedLock<true> Guard(ValueHandlesLock);
+
   // If we already have an entry, return it.
   int &Idx = ScopeInlinedAtIdx[std::make_pair(Scope, IA)];
   if (Idx) return Idx;
@@ -39,6 +39,16 @@ static cl::opt<bool,true>
 VerifyDomInfoX("verify-dom-info", cl::location(VerifyDomInfo),
                cl::desc("Verify dominator info (time consuming)"));
 
+#ifdef XDEBUG
+static bool VerifyDomUpdates = true;
+#else
+static bool VerifyDomUpdates = false;
+#endif
+static cl::opt<bool,true>
+VerifyDomUpdatesX("verify-dom-updates", cl::location(VerifyDomUpdates),
+                  cl::desc("Verify each incremental dominator tree update "
+                           "(time consuming)"));
+
 //===----------------------------------------------------------------------===//
 //  DominatorTree Implementation
 //===----------------------------------------------------------------------===//
@@ -61,8 +71,11 @@ bool DominatorTree::runOnFunction(Function &F) {
 }
 
 void DominatorTree::verifyAnalysis() const {
-  if (!VerifyDomInfo) return;
+  if (VerifyDomInfo)
+    verifyDomTree();
+}
 
+void DominatorTree::verifyDomTree() const {
   Function &F = *getRoot()->getParent();
 
   DominatorTree OtherDT;
@@ -76,6 +89,25 @@ void DominatorTree::verifyAnalysis() const {
   }
 }
 
+void DominatorTree::insertEdge(BasicBlock *From, BasicBlock *To) {
+  DT->insertEdge(From, To);
+  if (VerifyDomUpdates)
+    verifyDomTree();
+}
+
+void DominatorTree::deleteEdge(BasicBlock *From, BasicBlock *To) {
+  DT->deleteEdge(From, To);
+  if (VerifyDomUpdates)
+    verifyDomTree();
+}
+
+void DominatorTree::applyUpdates(ArrayRef<UpdateType> Updates,
+                                 ArrayRef<BasicBlock*> Erased) {
+  DT->applyUpdates(Updates, Erased);
+  if (VerifyDomUpdates)
+    verifyDomTree();
+}
+
 void DominatorTree::print(raw_ostream &OS, const Module *) const {
   DT->print(OS);
 }
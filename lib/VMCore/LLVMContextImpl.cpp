@@ -43,11 +43,11 @@ LLVMContextImpl::LLVMContextImpl(LLVMContext &C)
 
 namespace {
 struct DropReferences {
-  // Takes the value_type of a ConstantUniqueMap's internal map, whose 'second'
-  // is a Constant*.
+  // Takes the value_type of a ConstantUniqueMap's internal map, whose 'first'
+  // is a (type, Constant*) pair.
   template<typename PairT>
   void operator()(const PairT &P) {
-    P.second->dropAllReferences();
+    P.first.second->dropAllReferences();
   }
 };
 }
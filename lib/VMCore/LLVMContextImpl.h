@@ -23,6 +23,7 @@
 #include "llvm/DerivedTypes.h"
 #include "llvm/Metadata.h"
 #include "llvm/Assembly/Writer.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/ValueHandle.h"
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/APInt.h"
@@ -112,7 +113,21 @@ public:
   virtual void deleted();
   virtual void allUsesReplacedWith(Value *VNew);
 };
-  
+
+/// LLVMContextImpl - The tables behind an LLVMContext.
+///
+/// When LLVM is running multithreaded, several threads may build IR in one
+/// context at once, as long as each function body is only built by one
+/// thread.  Rather than serializing on one lock, each uniquing table has its
+/// own: the ConstantUniqueMaps lock themselves, and the remaining tables are
+/// guarded by the locks declared next to them.  The use lists of values that
+/// are shared between functions (constants, globals, metadata and inline asm)
+/// are guarded by UseListLocks, picked by the address of the value.  Nothing
+/// else is locked while a use list lock is held.
+///
+/// Module-level changes, type refinement and walks over the use lists of
+/// shared values are not synchronized, and must not run concurrently with
+/// other IR construction in the context.
 class LLVMContextImpl {
 public:
   /// OwnedModules - The set of modules instantiated in this context, and which
@@ -125,10 +140,16 @@ public:
   typedef DenseMap<DenseMapAPIntKeyInfo::KeyTy, ConstantInt*, 
                          DenseMapAPIntKeyInfo> IntMapTy;
   IntMapTy IntConstants;
+
+  /// IntConstantsLock - Guards IntConstants, TheTrueVal and TheFalseVal.
+  sys::SmartMutex<true> IntConstantsLock;
   
   typedef DenseMap<DenseMapAPFloatKeyInfo::KeyTy, ConstantFP*, 
                          DenseMapAPFloatKeyInfo> FPMapTy;
   FPMapTy FPConstants;
+
+  /// FPConstantsLock - Guards FPConstants.
+  sys::SmartMutex<true> FPConstantsLock;
   
   StringMap<MDString*> MDStringCache;
   
@@ -142,11 +163,11 @@ public:
   ConstantUniqueMap<char, Type, ConstantAggregateZero> AggZeroConstants;
 
   typedef ConstantUniqueMap<std::vector<Constant*>, ArrayType,
-    ConstantArray, true /*largekey*/> ArrayConstantsTy;
+    ConstantArray> ArrayConstantsTy;
   ArrayConstantsTy ArrayConstants;
   
   typedef ConstantUniqueMap<std::vector<Constant*>, StructType,
-    ConstantStruct, true /*largekey*/> StructConstantsTy;
+    ConstantStruct> StructConstantsTy;
   StructConstantsTy StructConstants;
   
   typedef ConstantUniqueMap<std::vector<Constant*>, VectorType,
@@ -157,6 +178,10 @@ public:
   ConstantUniqueMap<char, Type, UndefValue> UndefValueConstants;
   
   DenseMap<std::pair<Function*, BasicBlock*> , BlockAddress*> BlockAddresses;
+
+  /// BlockAddressesLock - Guards BlockAddresses.
+  sys::SmartMutex<true> BlockAddressesLock;
+
   ConstantUniqueMap<ExprMapKeyType, Type, ConstantExpr> ExprConstants;
 
   ConstantUniqueMap<InlineAsmKeyType, PointerType, InlineAsm> InlineAsms;
@@ -203,12 +228,32 @@ public:
   /// Used as an abstract type that will never be resolved.
   OpaqueType *const AlwaysOpaqueTy;
 
+  /// TypesLock - Guards the type maps, OpaqueTypes and the type descriptions.
+  sys::SmartMutex<true> TypesLock;
+
 
   /// ValueHandles - This map keeps track of all of the value handles that are
   /// watching a Value*.  The Value::HasValueHandle bit is used to know
   // whether or not a value has an entry in this map.
   typedef DenseMap<Value*, ValueHandleBase*> ValueHandlesTy;
   ValueHandlesTy ValueHandles;
+
+  /// ValueHandlesLock - Guards ValueHandles and the handle lists hanging off
+  /// it.  It also guards the metadata tables (MDStringCache, MDNodeSet,
+  /// NonUniquedMDNodes, CustomMDKindNames, MetadataStore and the scope
+  /// records), because MDNode operands are value handles: updating one can
+  /// re-unique its node from inside a handle callback.
+  sys::SmartMutex<true> ValueHandlesLock;
+
+  /// UseListLocks - Guard the use lists of values shared between functions.
+  /// The lock for a value is picked by its address; see getUseListLock.
+  enum { NumUseListLocks = 64 };
+  sys::SmartMutex<true> UseListLocks[NumUseListLocks];
+
+  sys::SmartMutex<true> &getUseListLock(const Value *V) {
+    return UseListLocks[(reinterpret_cast<uintptr_t>(V) >> 4) %
+                        NumUseListLocks];
+  }
   
   /// CustomMDKindNames - Map to hold the metadata string to ID mapping.
   StringMap<unsigned> CustomMDKindNames;
@@ -36,6 +36,7 @@ void LeakDetector::addGarbageObjectImpl(void *Object) {
 
 void LeakDetector::addGarbageObjectImpl(const Value *Object) {
   LLVMContextImpl *pImpl = Object->getContext().pImpl;
+  sys::SmartScopedLock<true> Lock(*ObjectsLock);
   pImpl->LLVMObjects.addGarbage(Object);
 }
 
@@ -46,6 +47,7 @@ void LeakDetector::removeGarbageObjectImpl(void *Object) {
 
 void LeakDetector::removeGarbageObjectImpl(const Value *Object) {
   LLVMContextImpl *pImpl = Object->getContext().pImpl;
+  sys::SmartScopedLock<true> Lock(*ObjectsLock);
   pImpl->LLVMObjects.removeGarbage(Object);
 }
 
@@ -21,6 +21,7 @@
 #include "llvm/ADT/SmallString.h"
 #include "SymbolTableListTraitsImpl.h"
 #include "llvm/Support/LeakDetector.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/ValueHandle.h"
 using namespace llvm;
 
@@ -33,6 +34,7 @@ MDString::MDString(LLVMContext &C, StringRef S)
 
 MDString *MDString::get(LLVMContext &Context, StringRef Str) {
   LLVMContextImpl *pImpl = Context.pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->ValueHandlesLock);
   StringMapEntry<MDString *> &Entry =
     pImpl->MDStringCache.GetOrCreateValue(Str);
   MDString *&S = Entry.getValue();
@@ -104,6 +106,7 @@ MDNode::~MDNode() {
   assert((getSubclassDataFromValue() & DestroyFlag) != 0 &&
          "Not being destroyed through destroy()?");
   LLVMContextImpl *pImpl = getType()->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->ValueHandlesLock);
   if (isNotUniqued()) {
     pImpl->NonUniquedMDNodes.erase(this);
   } else {
@@ -186,6 +189,7 @@ static bool isFunctionLocalValue(Value *V) {
 MDNode *MDNode::getMDNode(LLVMContext &Context, ArrayRef<Value*> Vals,
                           FunctionLocalness FL, bool Insert) {
   LLVMContextImpl *pImpl = Context.pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->ValueHandlesLock);
 
   // Add all the operand pointers. Note that we don't have to add the
   // isFunctionLocal bit because that's implied by the operands.
@@ -286,11 +290,14 @@ void MDNode::Profile(FoldingSetNodeID &ID) const {
 void MDNode::setIsNotUniqued() {
   setValueSubclassData(getSubclassDataFromValue() | NotUniquedBit);
   LLVMContextImpl *pImpl = getType()->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->ValueHandlesLock);
   pImpl->NonUniquedMDNodes.insert(this);
 }
 
 // Replace value from this node's operand list.
 void MDNode::replaceOperand(MDNodeOperand *Op, Value *To) {
+  LLVMContextImpl *pImpl = getType()->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->ValueHandlesLock);
   Value *From = *Op;
 
   // If is possible that someone did GV->RAUW(inst), replacing a global variable
@@ -321,8 +328,6 @@ void MDNode::replaceOperand(MDNodeOperand *Op, Value *To) {
   // already went to null), then there is nothing else to do here.
   if (isNotUniqued()) return;
 
-  LLVMContextImpl *pImpl = getType()->getContext().pImpl;
-
   // Remove "this" from the context map.  FoldingSet doesn't have to reprofile
   // this node to remove it, so we don't care what state the operands are in.
   pImpl->MDNodeSet.RemoveNode(this);
@@ -445,9 +450,12 @@ void Instruction::setMetadata(unsigned KindID, MDNode *Node) {
     return;
   }
   
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->ValueHandlesLock);
+
   // Handle the case when we're adding/updating metadata on an instruction.
   if (Node) {
-    LLVMContextImpl::MDMapTy &Info = getContext().pImpl->MetadataStore[this];
+    LLVMContextImpl::MDMapTy &Info = pImpl->MetadataStore[this];
     assert(!Info.empty() == hasMetadataHashEntry() &&
            "HasMetadata bit is wonked");
     if (Info.empty()) {
@@ -468,13 +476,13 @@ void Instruction::setMetadata(unsigned KindID, MDNode *Node) {
 
   // Otherwise, we're removing metadata from an instruction.
   assert(hasMetadataHashEntry() &&
-         getContext().pImpl->MetadataStore.count(this) &&
+         pImpl->MetadataStore.count(this) &&
          "HasMetadata bit out of date!");
-  LLVMContextImpl::MDMapTy &Info = getContext().pImpl->MetadataStore[this];
+  LLVMContextImpl::MDMapTy &Info = pImpl->MetadataStore[this];
 
   // Common case is removing the only entry.
   if (Info.size() == 1 && Info[0].first == KindID) {
-    getContext().pImpl->MetadataStore.erase(this);
+    pImpl->MetadataStore.erase(this);
     setHasMetadataHashEntry(false);
     return;
   }
@@ -497,7 +505,9 @@ MDNode *Instruction::getMetadataImpl(unsigned KindID) const {
   
   if (!hasMetadataHashEntry()) return 0;
   
-  LLVMContextImpl::MDMapTy &Info = getContext().pImpl->MetadataStore[this];
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->ValueHandlesLock);
+  LLVMContextImpl::MDMapTy &Info = pImpl->MetadataStore[this];
   assert(!Info.empty() && "bit out of sync with hash table");
 
   for (LLVMContextImpl::MDMapTy::iterator I = Info.begin(), E = Info.end();
@@ -518,11 +528,13 @@ void Instruction::getAllMetadataImpl(SmallVectorImpl<std::pair<unsigned,
     if (!hasMetadataHashEntry()) return;
   }
   
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->ValueHandlesLock);
   assert(hasMetadataHashEntry() &&
-         getContext().pImpl->MetadataStore.count(this) &&
+         pImpl->MetadataStore.count(this) &&
          "Shouldn't have called this");
   const LLVMContextImpl::MDMapTy &Info =
-    getContext().pImpl->MetadataStore.find(this)->second;
+    pImpl->MetadataStore.find(this)->second;
   assert(!Info.empty() && "Shouldn't have called this");
 
   Result.append(Info.begin(), Info.end());
@@ -536,11 +548,13 @@ void Instruction::
 getAllMetadataOtherThanDebugLocImpl(SmallVectorImpl<std::pair<unsigned,
                                     MDNode*> > &Result) const {
   Result.clear();
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->ValueHandlesLock);
   assert(hasMetadataHashEntry() &&
-         getContext().pImpl->MetadataStore.count(this) &&
+         pImpl->MetadataStore.count(this) &&
          "Shouldn't have called this");
   const LLVMContextImpl::MDMapTy &Info =
-  getContext().pImpl->MetadataStore.find(this)->second;
+  pImpl->MetadataStore.find(this)->second;
   assert(!Info.empty() && "Shouldn't have called this");
   
   Result.append(Info.begin(), Info.end());
@@ -555,7 +569,9 @@ getAllMetadataOtherThanDebugLocImpl(SmallVectorImpl<std::pair<unsigned,
 /// this instruction.
 void Instruction::clearMetadataHashEntries() {
   assert(hasMetadataHashEntry() && "Caller should check");
-  getContext().pImpl->MetadataStore.erase(this);
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->ValueHandlesLock);
+  pImpl->MetadataStore.erase(this);
   setHasMetadataHashEntry(false);
 }
 
@@ -53,12 +53,14 @@ template class llvm::SymbolTableListTraits<GlobalVariable, Module>;
 template class llvm::SymbolTableListTraits<Function, Module>;
 template class llvm::SymbolTableListTraits<GlobalAlias, Module>;
 
+ModuleAccessHook::~ModuleAccessHook() {}
+
 //===----------------------------------------------------------------------===//
 // Primitive Module methods.
 //
 
 Module::Module(StringRef MID, LLVMContext& C)
-  : Context(C), Materializer(NULL), ModuleID(MID) {
+  : Context(C), Materializer(NULL), ModuleID(MID), AccessHook(0) {
   ValSymTab = new ValueSymbolTable();
   TypeSymTab = new TypeSymbolTable();
   NamedMDSymTab = new StringMap<NamedMDNode *>();
@@ -124,6 +126,7 @@ Module::PointerSize Module::getPointerSize() const {
 /// the specified name, of arbitrary type.  This method returns null
 /// if a global with the specified name is not found.
 GlobalValue *Module::getNamedValue(StringRef Name) const {
+  noteAccess();
   return cast_or_null<GlobalValue>(getValueSymbolTable().lookup(Name));
 }
 
@@ -316,6 +319,7 @@ GlobalAlias *Module::getNamedAlias(StringRef Name) const {
 /// specified name. This method returns null if a NamedMDNode with the 
 /// specified name is not found.
 NamedMDNode *Module::getNamedMetadata(const Twine &Name) const {
+  noteAccess();
   SmallString<256> NameData;
   StringRef NameRef = Name.toStringRef(NameData);
   return static_cast<StringMap<NamedMDNode*> *>(NamedMDSymTab)->lookup(NameRef);
@@ -325,6 +329,7 @@ NamedMDNode *Module::getNamedMetadata(const Twine &Name) const {
 /// with the specified name. This method returns a new NamedMDNode if a 
 /// NamedMDNode with the specified name is not found.
 NamedMDNode *Module::getOrInsertNamedMetadata(StringRef Name) {
+  noteAccess();
   NamedMDNode *&NMD =
     (*static_cast<StringMap<NamedMDNode *> *>(NamedMDSymTab))[Name];
   if (!NMD) {
@@ -336,6 +341,7 @@ NamedMDNode *Module::getOrInsertNamedMetadata(StringRef Name) {
 }
 
 void Module::eraseNamedMetadata(NamedMDNode *NMD) {
+  noteAccess();
   static_cast<StringMap<NamedMDNode *> *>(NamedMDSymTab)->erase(NMD->getName());
   NamedMDList.erase(NMD);
 }
@@ -419,6 +425,12 @@ void Module::Dematerialize(GlobalValue *GV) {
     return Materializer->Dematerialize(GV);
 }
 
+bool Module::MaterializeMetadata(std::string *ErrInfo) {
+  if (Materializer)
+    return Materializer->MaterializeMetadata(ErrInfo);
+  return false;
+}
+
 bool Module::MaterializeAll(std::string *ErrInfo) {
   if (!Materializer)
     return false;
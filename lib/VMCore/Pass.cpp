@@ -44,6 +44,13 @@ PassManagerType ModulePass::getPotentialPassManagerType() const {
   return PMT_ModulePassManager;
 }
 
+Pass *Pass::createClone() const {
+  const PassInfo *PI = lookupPassInfo(getPassID());
+  if (PI == 0 || PI->getNormalCtor() == 0)
+    return 0;
+  return PI->createPass();
+}
+
 bool Pass::mustPreserveAnalysisID(char &AID) const {
   return Resolver->getAnalysisIfAvailable(&AID, true) != 0;
 }
@@ -11,13 +11,19 @@
 //
 //===----------------------------------------------------------------------===//
 
-
+#define DEBUG_TYPE "passmgr"
 #include "llvm/PassManagers.h"
 #include "llvm/PassManager.h"
+#include "llvm/Constants.h"
 #include "llvm/DebugInfoProbe.h"
+#include "llvm/GlobalAlias.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/InlineAsm.h"
+#include "llvm/Metadata.h"
 #include "llvm/Assembly/PrintModulePass.h"
 #include "llvm/Assembly/Writer.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ConditionVariable.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Module.h"
@@ -26,10 +32,15 @@
 #include "llvm/Support/PassNameParser.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/ThreadLocal.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringMap.h"
 #include <algorithm>
 #include <cstdio>
 #include <map>
+#include <set>
 using namespace llvm;
 
 // See PassManagers.h for Pass Manager infrastructure overview.
@@ -113,6 +124,13 @@ static bool ShouldPrintAfterPass(const void *PassID) {
   return PrintAfterAll || ShouldPrintBeforeOrAfterPass(PassID, PrintAfter);
 }
 
+static cl::opt<unsigned>
+FunctionThreads("threads", cl::Hidden, cl::init(1),
+                cl::desc("Number of threads to run function passes on "
+                         "(default = 1, experimental)"));
+
+STATISTIC(NumHelperFunctions, "Number of functions run on helper threads");
+
 } // End of llvm namespace
 
 /// isPassDebuggingExecutionsOrMore - Return true if -debug-pass=Executions
@@ -121,6 +139,26 @@ bool PMDataManager::isPassDebuggingExecutionsOrMore() const {
   return PassDebugging >= Executions;
 }
 
+/// isPassInstrumentationEnabled - Return true if -debug-pass or -time-passes
+/// is specified.
+bool PMDataManager::isPassInstrumentationEnabled() const {
+  return PassDebugging > None || TimePassesIsEnabled;
+}
+
+void PMDataManager::collectPasses(std::vector<Pass*> &Passes,
+                                  std::vector<AnalysisID> &Shape) {
+  for (unsigned i = 0, e = getNumContainedPasses(); i != e; ++i) {
+    Pass *P = getContainedPass(i);
+    Shape.push_back(P->getPassID());
+    if (PMDataManager *Nested = P->getAsPMDataManager()) {
+      Nested->collectPasses(Passes, Shape);
+      Shape.push_back(0);
+    } else {
+      Passes.push_back(P);
+    }
+  }
+}
+
 
 
 
@@ -837,6 +875,33 @@ void PMDataManager::verifyPreservedAnalysis(Pass *P) {
   }
 }
 
+/// removeNotPreserved - Remove the analyses in Analyses that are neither
+/// immutable nor preserved by P.  -debug-pass=Details lists them in order of
+/// their IDs, as it did when the tables were std::maps, rather than in hash
+/// order.
+static void removeNotPreserved(Pass *P,
+                               DenseMap<AnalysisID, Pass*> &Analyses,
+                               const AnalysisUsage::VectorType &PreservedSet) {
+  SmallVector<AnalysisID, 8> Removed;
+  for (DenseMap<AnalysisID, Pass*>::iterator I = Analyses.begin(),
+         E = Analyses.end(); I != E; ++I)
+    if (I->second->getAsImmutablePass() == 0 &&
+        std::find(PreservedSet.begin(), PreservedSet.end(), I->first) ==
+        PreservedSet.end())
+      Removed.push_back(I->first);
+
+  std::sort(Removed.begin(), Removed.end(), std::less<AnalysisID>());
+  for (unsigned i = 0, e = Removed.size(); i != e; ++i) {
+    // Remove this analysis
+    if (PassDebugging >= Details) {
+      Pass *S = Analyses[Removed[i]];
+      dbgs() << " -- '" <<  P->getPassName() << "' is not preserving '";
+      dbgs() << S->getPassName() << "'\n";
+    }
+    Analyses.erase(Removed[i]);
+  }
+}
+
 /// Remove Analysis not preserved by Pass P
 void PMDataManager::removeNotPreservedAnalysis(Pass *P) {
   AnalysisUsage *AnUsage = TPM->findAnalysisUsage(P);
@@ -844,46 +909,13 @@ void PMDataManager::removeNotPreservedAnalysis(Pass *P) {
     return;
 
   const AnalysisUsage::VectorType &PreservedSet = AnUsage->getPreservedSet();
-  for (std::map<AnalysisID, Pass*>::iterator I = AvailableAnalysis.begin(),
-         E = AvailableAnalysis.end(); I != E; ) {
-    std::map<AnalysisID, Pass*>::iterator Info = I++;
-    if (Info->second->getAsImmutablePass() == 0 &&
-        std::find(PreservedSet.begin(), PreservedSet.end(), Info->first) ==
-        PreservedSet.end()) {
-      // Remove this analysis
-      if (PassDebugging >= Details) {
-        Pass *S = Info->second;
-        dbgs() << " -- '" <<  P->getPassName() << "' is not preserving '";
-        dbgs() << S->getPassName() << "'\n";
-      }
-      AvailableAnalysis.erase(Info);
-    }
-  }
+  removeNotPreserved(P, AvailableAnalysis, PreservedSet);
 
   // Check inherited analysis also. If P is not preserving analysis
   // provided by parent manager then remove it here.
-  for (unsigned Index = 0; Index < PMT_Last; ++Index) {
-
-    if (!InheritedAnalysis[Index])
-      continue;
-
-    for (std::map<AnalysisID, Pass*>::iterator
-           I = InheritedAnalysis[Index]->begin(),
-           E = InheritedAnalysis[Index]->end(); I != E; ) {
-      std::map<AnalysisID, Pass *>::iterator Info = I++;
-      if (Info->second->getAsImmutablePass() == 0 &&
-          std::find(PreservedSet.begin(), PreservedSet.end(), Info->first) ==
-             PreservedSet.end()) {
-        // Remove this analysis
-        if (PassDebugging >= Details) {
-          Pass *S = Info->second;
-          dbgs() << " -- '" <<  P->getPassName() << "' is not preserving '";
-          dbgs() << S->getPassName() << "'\n";
-        }
-        InheritedAnalysis[Index]->erase(Info);
-      }
-    }
-  }
+  for (unsigned Index = 0; Index < PMT_Last; ++Index)
+    if (InheritedAnalysis[Index])
+      removeNotPreserved(P, *InheritedAnalysis[Index], PreservedSet);
 }
 
 /// Remove analysis passes that are not used any longer
@@ -930,7 +962,7 @@ void PMDataManager::freePass(Pass *P, StringRef Msg,
     // listed as the available implementation.
     const std::vector<const PassInfo*> &II = PInf->getInterfacesImplemented();
     for (unsigned i = 0, e = II.size(); i != e; ++i) {
-      std::map<AnalysisID, Pass*>::iterator Pos =
+      DenseMap<AnalysisID, Pass*>::iterator Pos =
         AvailableAnalysis.find(II[i]->getTypeInfo());
       if (Pos != AvailableAnalysis.end() && Pos->second == P)
         AvailableAnalysis.erase(Pos);
@@ -1070,7 +1102,7 @@ void PMDataManager::initializeAnalysisImpl(Pass *P) {
 Pass *PMDataManager::findAnalysisPass(AnalysisID AID, bool SearchParent) {
 
   // Check if AvailableAnalysis map has one entry.
-  std::map<AnalysisID, Pass*>::const_iterator I =  AvailableAnalysis.find(AID);
+  DenseMap<AnalysisID, Pass*>::const_iterator I =  AvailableAnalysis.find(AID);
 
   if (I != AvailableAnalysis.end())
     return I->second;
@@ -1459,6 +1491,282 @@ bool FunctionPassManagerImpl::run(Function &F) {
   return Changed;
 }
 
+//===----------------------------------------------------------------------===//
+// FunctionSchedule
+//
+/// FunctionSchedule - Decides which functions of a module the function passes
+/// may run on at the same time without changing the result of running them
+/// in module order.
+///
+/// The thread that runs the FPPassManager still takes every function in
+/// order.  Helper threads run copies of the passes and take any function
+/// that is ready.
+///
+/// A function starts once the earlier functions that may use any of the
+/// shared values it may use, itself included, have finished.  Shared values
+/// are the constants, globals, inline asm and metadata that several
+/// functions may use.  Functions that use too many of them to track run
+/// alone.  Lastly, only the first unfinished function may look at the
+/// module's lists and symbol tables: a thread that gets there early waits in
+/// willAccessModule, so declarations are created and named in the same order
+/// as in a serial run.
+///
+/// This is why -threads is experimental: a value that a pass creates or
+/// looks up while it runs is not tracked, e.g. a constant folded in two
+/// functions that did not use it before.  Two threads may then walk and
+/// change its use list at the same time.
+
+namespace llvm {
+
+class FunctionSchedule : public ModuleAccessHook {
+  enum FunctionState { NotStarted, Running, Finished };
+
+  struct FunctionInfo {
+    Function *F;
+    std::vector<unsigned> Dependents; // Functions that wait for this one.
+    unsigned Index;
+    unsigned NumPending;   // Unfinished functions this one waits for.
+    bool Exclusive;        // Runs with no other function running.
+    mutable bool HasTurn;  // All earlier functions have finished.  Only the
+                           // running thread uses this.
+    FunctionState State;
+  };
+  std::vector<FunctionInfo> Functions;
+
+  /// Exclusives - The indices of the exclusive functions, in order.
+  std::vector<unsigned> Exclusives;
+
+  sys::Mutex Lock;
+  sys::ConditionVariable StateChanged;
+
+  /// Ready - Functions that are only waiting for a thread.
+  std::set<unsigned> Ready;
+
+  /// FirstUnfinished - All functions before this one have finished.
+  unsigned FirstUnfinished;
+
+  /// NextExclusive - Index into Exclusives of the first unfinished exclusive
+  /// function.  Helper threads do not start functions after it before it
+  /// finishes.
+  unsigned NextExclusive;
+
+  /// Current - The function that the calling thread is running passes on,
+  /// if any.
+  sys::ThreadLocal<const FunctionInfo> Current;
+
+  void computeDependences();
+
+  unsigned getExclusiveLimit() const {
+    return NextExclusive == Exclusives.size() ? Functions.size() :
+                                                Exclusives[NextExclusive];
+  }
+
+  Function *begin(FunctionInfo &FI) {
+    FI.HasTurn = false;
+    Current.set(&FI);
+    return FI.F;
+  }
+
+public:
+  explicit FunctionSchedule(Module &M);
+
+  unsigned size() const { return Functions.size(); }
+
+  /// startInOrder - Wait until function #i may start and return it.  Returns
+  /// null if a helper thread has already taken it.
+  Function *startInOrder(unsigned i);
+
+  /// startNext - Wait for a function that may start and return it, setting
+  /// i to its index.  Returns null once every function has finished.
+  Function *startNext(unsigned &i);
+
+  /// finish - Note that the calling thread is done with function #i.
+  void finish(unsigned i);
+
+  virtual void willAccessModule();
+};
+
+} // End of llvm namespace
+
+/// MaxSharedPerFunction - Functions that may use more shared values than
+/// this are made exclusive instead of tracking each value, which bounds the
+/// memory and time spent on the schedule.
+static const unsigned MaxSharedPerFunction = 1024;
+
+typedef std::vector<const Value*> SharedList;
+
+/// addSharedValues - Add V to Shared if it is a value that other functions
+/// may use as well, along with the shared values a pass may reach through
+/// it.  Passes may change globals, e.g. a callee's attributes or a global
+/// variable's alignment.  They may also walk the use list of any shared
+/// value, e.g. through hasOneUse, and those walks are not synchronized with
+/// other threads adding or removing uses.
+static void addSharedValues(const Value *V,
+                            SmallPtrSet<const Value*, 32> &Visited,
+                            SharedList &Shared) {
+  if (!isa<Constant>(V) && !isa<InlineAsm>(V) && !isa<MDNode>(V) &&
+      !isa<MDString>(V))
+    return;
+  if (!Visited.insert(V))
+    return;
+  Shared.push_back(V);
+
+  if (const GlobalAlias *GA = dyn_cast<GlobalAlias>(V)) {
+    if (const Constant *Aliasee = GA->getAliasee())
+      addSharedValues(Aliasee, Visited, Shared);
+    return;
+  }
+
+  if (const GlobalVariable *GV = dyn_cast<GlobalVariable>(V)) {
+    // Passes may look through the initializers of constant globals.
+    if (GV->isConstant() && GV->hasDefinitiveInitializer())
+      addSharedValues(GV->getInitializer(), Visited, Shared);
+    return;
+  }
+
+  if (isa<Function>(V))
+    return;
+
+  if (const Constant *C = dyn_cast<Constant>(V))
+    for (User::const_op_iterator I = C->op_begin(), E = C->op_end();
+         I != E; ++I)
+      addSharedValues(*I, Visited, Shared);
+}
+
+FunctionSchedule::FunctionSchedule(Module &M)
+  : Lock(false), FirstUnfinished(0), NextExclusive(0) {
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
+    if (I->isDeclaration())
+      continue;
+    Functions.push_back(FunctionInfo());
+    FunctionInfo &FI = Functions.back();
+    FI.F = I;
+    FI.Index = Functions.size()-1;
+    FI.NumPending = 0;
+    FI.Exclusive = false;
+    FI.HasTurn = false;
+    FI.State = NotStarted;
+  }
+  computeDependences();
+
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i) {
+    if (Functions[i].Exclusive)
+      Exclusives.push_back(i);
+    else if (Functions[i].NumPending == 0)
+      Ready.insert(i);
+  }
+}
+
+void FunctionSchedule::computeDependences() {
+  // The last function so far that may use each shared value.
+  DenseMap<const Value*, unsigned> LastUser;
+
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i) {
+    FunctionInfo &FI = Functions[i];
+    Function *F = FI.F;
+    SharedList R;
+    SmallPtrSet<const Value*, 32> Visited;
+
+    addSharedValues(F, Visited, R);
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+        for (User::op_iterator OI = I->op_begin(), OE = I->op_end();
+             OI != OE; ++OI)
+          addSharedValues(*OI, Visited, R);
+
+    if (R.size() > MaxSharedPerFunction) {
+      // Exclusive functions wait for everything before them and hold up
+      // everything after them, so they need no other ordering.
+      FI.Exclusive = true;
+      continue;
+    }
+
+    SmallVector<unsigned, 8> Deps;
+    for (SharedList::iterator I = R.begin(), E = R.end(); I != E; ++I) {
+      unsigned &Last = LastUser[*I];
+      if (Last != 0)
+        Deps.push_back(Last-1);
+      Last = i+1;
+    }
+
+    std::sort(Deps.begin(), Deps.end());
+    Deps.erase(std::unique(Deps.begin(), Deps.end()), Deps.end());
+    FI.NumPending = Deps.size();
+    for (unsigned d = 0, de = Deps.size(); d != de; ++d)
+      Functions[Deps[d]].Dependents.push_back(i);
+  }
+}
+
+Function *FunctionSchedule::startInOrder(unsigned i) {
+  FunctionInfo &FI = Functions[i];
+  {
+    sys::ScopedLock Guard(Lock);
+    for (;;) {
+      if (FI.State != NotStarted)
+        return 0;
+      if (FI.NumPending == 0 && (!FI.Exclusive || FirstUnfinished == i))
+        break;
+      StateChanged.wait(Lock);
+    }
+    FI.State = Running;
+    Ready.erase(i);
+  }
+  return begin(FI);
+}
+
+Function *FunctionSchedule::startNext(unsigned &i) {
+  {
+    sys::ScopedLock Guard(Lock);
+    for (;;) {
+      if (!Ready.empty() && *Ready.begin() < getExclusiveLimit())
+        break;
+      if (FirstUnfinished == Functions.size())
+        return 0;
+      StateChanged.wait(Lock);
+    }
+    i = *Ready.begin();
+    Ready.erase(Ready.begin());
+    Functions[i].State = Running;
+  }
+  return begin(Functions[i]);
+}
+
+void FunctionSchedule::finish(unsigned i) {
+  Current.erase();
+
+  sys::ScopedLock Guard(Lock);
+  FunctionInfo &FI = Functions[i];
+  FI.State = Finished;
+
+  for (unsigned d = 0, e = FI.Dependents.size(); d != e; ++d) {
+    FunctionInfo &D = Functions[FI.Dependents[d]];
+    if (--D.NumPending == 0 && !D.Exclusive && D.State == NotStarted)
+      Ready.insert(D.Index);
+  }
+
+  while (FirstUnfinished != Functions.size() &&
+         Functions[FirstUnfinished].State == Finished)
+    ++FirstUnfinished;
+  if (FI.Exclusive)
+    ++NextExclusive;
+
+  StateChanged.notifyAll();
+}
+
+/// willAccessModule - Called whenever a pass is about to look at the lists or
+/// symbol tables of the module.  Hold the calling thread until all the
+/// functions before its own have finished.
+void FunctionSchedule::willAccessModule() {
+  const FunctionInfo *FI = Current.get();
+  if (FI == 0 || FI->HasTurn)
+    return;
+
+  sys::ScopedLock Guard(Lock);
+  while (FirstUnfinished != FI->Index)
+    StateChanged.wait(Lock);
+  FI->HasTurn = true;
+}
+
 //===----------------------------------------------------------------------===//
 // FPPassManager implementation
 
@@ -1519,14 +1827,204 @@ bool FPPassManager::runOnFunction(Function &F) {
 }
 
 bool FPPassManager::runOnModule(Module &M) {
+  // Copies of this pass manager on helper threads only run on the functions
+  // they are handed.  The original is initialized and finalized on their
+  // behalf.
+  if (Schedule)
+    return runReadyFunctions(*Schedule);
+
   bool Changed = doInitialization(M);
+  if (FunctionThreads > 1 && runInParallel(M, Changed))
+    return doFinalization(M) || Changed;
 
   for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
-    runOnFunction(*I);
+    Changed |= runOnFunction(*I);
 
   return doFinalization(M) || Changed;
 }
 
+bool FPPassManager::runInOrder(FunctionSchedule &Sched) {
+  bool Changed = false;
+  for (unsigned i = 0, e = Sched.size(); i != e; ++i) {
+    Function *F = Sched.startInOrder(i);
+    if (F == 0)
+      continue;
+    Changed |= runOnFunction(*F);
+    Sched.finish(i);
+  }
+  return Changed;
+}
+
+bool FPPassManager::runReadyFunctions(FunctionSchedule &Sched) {
+  bool Changed = false;
+  unsigned i;
+  while (Function *F = Sched.startNext(i)) {
+    ++NumHelperFunctions;
+    Changed |= runOnFunction(*F);
+    Sched.finish(i);
+  }
+  return Changed;
+}
+
+/// createHelper - Build a pass manager that runs copies of the passes in this
+/// one, for a helper thread, and set Copy to the copy of this pass manager in
+/// it.  Returns null if some pass cannot be copied, or if the copy would not
+/// have the given Shape.
+PassManager *FPPassManager::createHelper(const std::vector<AnalysisID> &Shape,
+                                         FPPassManager *&Copy) {
+  PassManager *PM = new PassManager();
+
+  SmallVectorImpl<ImmutablePass*> &Immutables = TPM->getImmutablePasses();
+  for (unsigned i = 0, e = Immutables.size(); i != e; ++i) {
+    Pass *P = Immutables[i]->createClone();
+    if (P == 0) {
+      delete PM;
+      return 0;
+    }
+    PM->add(P);
+  }
+
+  std::vector<Pass*> Passes;
+  std::vector<AnalysisID> Unused;
+  collectPasses(Passes, Unused);
+  Pass *First = 0;
+  for (unsigned i = 0, e = Passes.size(); i != e; ++i) {
+    Pass *P = Passes[i]->createClone();
+    if (P == 0) {
+      delete PM;
+      return 0;
+    }
+    PM->add(P);
+    if (i == 0)
+      First = P;
+  }
+
+  // The first pass is a FunctionPass, so it was added straight to the copy
+  // of this pass manager, which must be the only module pass.
+  FPPassManager *Helper =
+    static_cast<FPPassManager*>(&First->getResolver()->getPMDataManager());
+  std::vector<Pass*> HelperPasses;
+  std::vector<AnalysisID> HelperShape;
+  Helper->collectPasses(HelperPasses, HelperShape);
+  if (HelperShape != Shape ||
+      Helper->getResolver()->getPMDataManager().getNumContainedPasses() != 1) {
+    delete PM;
+    return 0;
+  }
+
+  Copy = Helper;
+  return PM;
+}
+
+namespace {
+
+/// FunctionLane - One of the threads that run function passes in parallel.
+struct FunctionLane {
+  FPPassManager *InOrder; // Set for the calling thread.
+  PassManager *Helper;    // Set for helper threads.
+  Module *M;
+  FunctionSchedule *Sched;
+  bool Changed;
+};
+
+} // End of anon namespace
+
+static void RunFunctionLane(void *Arg) {
+  FunctionLane *Lane = static_cast<FunctionLane*>(Arg);
+  if (Lane->InOrder)
+    Lane->Changed = Lane->InOrder->runInOrder(*Lane->Sched);
+  else
+    Lane->Changed = Lane->Helper->run(*Lane->M);
+}
+
+/// runInParallel - Run the passes on the functions of M on -threads threads,
+/// as FunctionSchedule allows.  Returns false, having done nothing, if that
+/// cannot be done with the same result as a serial run, e.g. because some
+/// pass cannot be copied.
+bool FPPassManager::runInParallel(Module &M, bool &Changed) {
+  // Pass timers, -debug-pass output and the debug info probe are not thread
+  // safe.
+  if (isPassInstrumentationEnabled() ||
+      (TheDebugProbe && TheDebugProbe->isEnabled()))
+    return false;
+
+  // The first pass must be a FunctionPass, see createHelper.
+  if (getNumContainedPasses() == 0 ||
+      getContainedPass(0)->getAsPMDataManager())
+    return false;
+
+  // Helper threads only get the immutable passes, so no module level
+  // analysis may be in use.
+  DenseMap<AnalysisID, Pass*> *Available =
+    getResolver()->getPMDataManager().getAvailableAnalysis();
+  for (DenseMap<AnalysisID, Pass*>::iterator I = Available->begin(),
+       E = Available->end(); I != E; ++I) {
+    const PassInfo *PI = lookupPassInfo(I->second->getPassID());
+    if (PI && PI->isAnalysis())
+      return false;
+  }
+
+  FunctionSchedule Sched(M);
+  if (Sched.size() < 2)
+    return false;
+
+  std::vector<Pass*> Passes;
+  std::vector<AnalysisID> Shape;
+  collectPasses(Passes, Shape);
+
+  std::vector<PassManager*> Helpers;
+  std::vector<FPPassManager*> Copies;
+  for (unsigned i = 1; i < FunctionThreads; ++i) {
+    FPPassManager *Copy;
+    PassManager *Helper = createHelper(Shape, Copy);
+    if (Helper == 0)
+      break;
+    Helpers.push_back(Helper);
+    Copies.push_back(Copy);
+  }
+
+  bool StartedThreads = false;
+  if (Helpers.size() == FunctionThreads-1 && !llvm_is_multithreaded())
+    StartedThreads = llvm_start_multithreaded();
+  if (Helpers.size() != FunctionThreads-1 || !llvm_is_multithreaded()) {
+    for (unsigned i = 0, e = Helpers.size(); i != e; ++i)
+      delete Helpers[i];
+    return false;
+  }
+
+  // The copies start out like the original, initialized before any function
+  // is run on.  Only the original is finalized.
+  for (unsigned i = 0, e = Copies.size(); i != e; ++i) {
+    Copies[i]->doInitialization(M);
+    Copies[i]->Schedule = &Sched;
+  }
+
+  std::vector<FunctionLane> Lanes(Helpers.size()+1);
+  std::vector<void*> Args(Lanes.size());
+  for (unsigned i = 0, e = Lanes.size(); i != e; ++i) {
+    FunctionLane &Lane = Lanes[i];
+    Lane.InOrder = i == 0 ? this : 0;
+    Lane.Helper = i == 0 ? 0 : Helpers[i-1];
+    Lane.M = &M;
+    Lane.Sched = &Sched;
+    Lane.Changed = false;
+    Args[i] = &Lane;
+  }
+
+  M.setAccessHook(&Sched);
+  llvm_execute_on_threads(RunFunctionLane, &Args[0], Args.size());
+  M.setAccessHook(0);
+
+  if (StartedThreads)
+    llvm_stop_multithreaded();
+
+  for (unsigned i = 0, e = Lanes.size(); i != e; ++i)
+    Changed |= Lanes[i].Changed;
+  for (unsigned i = 0, e = Helpers.size(); i != e; ++i)
+    delete Helpers[i];
+  return true;
+}
+
 bool FPPassManager::doInitialization(Module &M) {
   bool Changed = false;
 
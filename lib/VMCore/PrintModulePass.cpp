@@ -61,6 +61,9 @@ namespace {
     ~PrintFunctionPass() {
       if (DeleteStream) delete Out;
     }
+
+    // Printers write to a stream in pass order, so they cannot be copied.
+    Pass *createClone() const { return 0; }
     
     // runOnFunction - This pass just prints a banner followed by the
     // function as it's processed.
@@ -27,6 +27,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Threading.h"
 #include <algorithm>
@@ -89,6 +90,7 @@ void Type::destroy() const {
     return;
   } else if (const OpaqueType *opaque_this = dyn_cast<OpaqueType>(this)) {
     LLVMContextImpl *pImpl = this->getContext().pImpl;
+    sys::SmartScopedLock<true> Guard(pImpl->TypesLock);
     pImpl->OpaqueTypes.erase(opaque_this);
   }
 
@@ -312,6 +314,7 @@ void Type::typeBecameConcrete(const DerivedType *AbsTy) {
 
 std::string Type::getDescription() const {
   LLVMContextImpl *pImpl = getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->TypesLock);
   TypePrinting &Map =
     isAbstract() ?
       pImpl->AbstractTypeDescriptions :
@@ -818,12 +821,12 @@ const IntegerType *IntegerType::get(LLVMContext &C, unsigned NumBits) {
   }
 
   LLVMContextImpl *pImpl = C.pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->TypesLock);
   
   IntegerValType IVT(NumBits);
   IntegerType *ITy = 0;
   
-  // First, see if the type is already in the table, for which
-  // a reader lock suffices.
+  // First, see if the type is already in the table.
   ITy = pImpl->IntegerTypes.get(IVT);
     
   if (!ITy) {
@@ -864,6 +867,7 @@ FunctionType *FunctionType::get(const Type *ReturnType,
   FunctionType *FT = 0;
   
   LLVMContextImpl *pImpl = ReturnType->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->TypesLock);
   
   FT = pImpl->FunctionTypes.get(VT);
   
@@ -888,6 +892,7 @@ ArrayType *ArrayType::get(const Type *ElementType, uint64_t NumElements) {
   ArrayType *AT = 0;
 
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->TypesLock);
   
   AT = pImpl->ArrayTypes.get(AVT);
       
@@ -913,6 +918,7 @@ VectorType *VectorType::get(const Type *ElementType, unsigned NumElements) {
   VectorType *PT = 0;
   
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->TypesLock);
   
   PT = pImpl->VectorTypes.get(PVT);
     
@@ -941,6 +947,7 @@ StructType *StructType::get(LLVMContext &Context,
   StructType *ST = 0;
   
   LLVMContextImpl *pImpl = Context.pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->TypesLock);
   
   ST = pImpl->StructTypes.get(STV);
     
@@ -988,6 +995,7 @@ PointerType *PointerType::get(const Type *ValueType, unsigned AddressSpace) {
   PointerType *PT = 0;
   
   LLVMContextImpl *pImpl = ValueType->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->TypesLock);
   
   PT = pImpl->PointerTypes.get(PVT);
   
@@ -1018,6 +1026,7 @@ bool PointerType::isValidElementType(const Type *ElemTy) {
 OpaqueType *OpaqueType::get(LLVMContext &C) {
   OpaqueType *OT = new OpaqueType(C);       // All opaque types are distinct.
   LLVMContextImpl *pImpl = C.pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->TypesLock);
   pImpl->OpaqueTypes.insert(OT);
   return OT;
 }
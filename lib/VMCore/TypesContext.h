@@ -16,6 +16,7 @@
 #define LLVM_TYPESCONTEXT_H
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include <map>
 
@@ -63,6 +64,34 @@ static unsigned getSubElementHash(const Type *Ty) {
   return HashVal ? HashVal : 1;  // Do not return zero unless opaque subty.
 }
 
+/// hashTypeKey - Mix V into the hash value Hash of a TypeMap key.
+static inline unsigned hashTypeKey(unsigned Hash, unsigned V) {
+  return (Hash ^ V) * 16777619U;
+}
+
+static inline unsigned hashTypeKey(unsigned Hash, const Type *Ty) {
+  return hashTypeKey(Hash, DenseMapInfo<const Type*>::getHashValue(Ty));
+}
+
+static inline unsigned hashTypeKey(unsigned Hash, ArrayRef<const Type*> Tys) {
+  Hash = hashTypeKey(Hash, (unsigned)Tys.size());
+  for (unsigned i = 0, e = Tys.size(); i != e; ++i)
+    Hash = hashTypeKey(Hash, Tys[i]);
+  return Hash;
+}
+
+/// TypeMapKeyInfo - DenseMap traits for the keys of a TypeMap. Each key class
+/// provides its own empty and tombstone keys, equality and hash.
+template<class ValType>
+struct TypeMapKeyInfo {
+  static inline ValType getEmptyKey() { return ValType::getEmptyKey(); }
+  static inline ValType getTombstoneKey() { return ValType::getTombstoneKey(); }
+  static unsigned getHashValue(const ValType &V) { return V.getHashValue(); }
+  static bool isEqual(const ValType &LHS, const ValType &RHS) {
+    return LHS == RHS;
+  }
+};
+
 //===----------------------------------------------------------------------===//
 // Integer Type Factory...
 //
@@ -79,8 +108,14 @@ public:
     return (unsigned)Ty->getBitWidth();
   }
 
-  inline bool operator<(const IntegerValType &IVT) const {
-    return bits < IVT.bits;
+  // No integer type is this wide.
+  static IntegerValType getEmptyKey() { return IntegerValType(~0U); }
+  static IntegerValType getTombstoneKey() { return IntegerValType(~0U - 1); }
+
+  unsigned getHashValue() const { return bits * 37U; }
+
+  inline bool operator==(const IntegerValType &IVT) const {
+    return bits == IVT.bits;
   }
 };
 
@@ -100,9 +135,19 @@ public:
     return getSubElementHash(PT);
   }
 
-  bool operator<(const PointerValType &MTV) const {
-    if (AddressSpace < MTV.AddressSpace) return true;
-    return AddressSpace == MTV.AddressSpace && ValTy < MTV.ValTy;
+  static PointerValType getEmptyKey() {
+    return PointerValType(DenseMapInfo<const Type*>::getEmptyKey(), 0);
+  }
+  static PointerValType getTombstoneKey() {
+    return PointerValType(DenseMapInfo<const Type*>::getTombstoneKey(), 0);
+  }
+
+  unsigned getHashValue() const {
+    return hashTypeKey(AddressSpace, ValTy);
+  }
+
+  bool operator==(const PointerValType &MTV) const {
+    return ValTy == MTV.ValTy && AddressSpace == MTV.AddressSpace;
   }
 };
 
@@ -123,9 +168,20 @@ public:
     return (unsigned)AT->getNumElements();
   }
 
-  inline bool operator<(const ArrayValType &MTV) const {
-    if (Size < MTV.Size) return true;
-    return Size == MTV.Size && ValTy < MTV.ValTy;
+  static ArrayValType getEmptyKey() {
+    return ArrayValType(DenseMapInfo<const Type*>::getEmptyKey(), 0);
+  }
+  static ArrayValType getTombstoneKey() {
+    return ArrayValType(DenseMapInfo<const Type*>::getTombstoneKey(), 0);
+  }
+
+  unsigned getHashValue() const {
+    return hashTypeKey(hashTypeKey((unsigned)Size, (unsigned)(Size >> 32)),
+                       ValTy);
+  }
+
+  inline bool operator==(const ArrayValType &MTV) const {
+    return ValTy == MTV.ValTy && Size == MTV.Size;
   }
 };
 
@@ -146,9 +202,17 @@ public:
     return PT->getNumElements();
   }
 
-  inline bool operator<(const VectorValType &MTV) const {
-    if (Size < MTV.Size) return true;
-    return Size == MTV.Size && ValTy < MTV.ValTy;
+  static VectorValType getEmptyKey() {
+    return VectorValType(DenseMapInfo<const Type*>::getEmptyKey(), 0);
+  }
+  static VectorValType getTombstoneKey() {
+    return VectorValType(DenseMapInfo<const Type*>::getTombstoneKey(), 0);
+  }
+
+  unsigned getHashValue() const { return hashTypeKey(Size, ValTy); }
+
+  inline bool operator==(const VectorValType &MTV) const {
+    return ValTy == MTV.ValTy && Size == MTV.Size;
   }
 };
 
@@ -156,7 +220,12 @@ public:
 //
 class StructValType {
   std::vector<const Type*> ElTypes;
-  bool packed;
+  // Zero or one, or one of the sentinels for the empty and tombstone keys, so
+  // that they don't need an element list.
+  unsigned packed;
+
+  enum { EmptyKey = ~0U, TombstoneKey = ~0U - 1 };
+  explicit StructValType(unsigned Sentinel) : packed(Sentinel) {}
 public:
   StructValType(ArrayRef<const Type*> args, bool isPacked)
     : ElTypes(args.vec()), packed(isPacked) {}
@@ -174,10 +243,13 @@ public:
     return ST->getNumElements();
   }
 
-  inline bool operator<(const StructValType &STV) const {
-    if (ElTypes < STV.ElTypes) return true;
-    else if (ElTypes > STV.ElTypes) return false;
-    else return (int)packed < (int)STV.packed;
+  static StructValType getEmptyKey() { return StructValType(EmptyKey); }
+  static StructValType getTombstoneKey() { return StructValType(TombstoneKey); }
+
+  unsigned getHashValue() const { return hashTypeKey(packed, ElTypes); }
+
+  inline bool operator==(const StructValType &STV) const {
+    return packed == STV.packed && ElTypes == STV.ElTypes;
   }
 };
 
@@ -198,14 +270,22 @@ public:
     return Result;
   }
 
-  inline bool operator<(const FunctionValType &MTV) const {
-    if (RetTy < MTV.RetTy) return true;
-    if (RetTy > MTV.RetTy) return false;
-    if (isVarArg < MTV.isVarArg) return true;
-    if (isVarArg > MTV.isVarArg) return false;
-    if (ArgTypes < MTV.ArgTypes) return true;
-    if (ArgTypes > MTV.ArgTypes) return false;
-    return false;
+  static FunctionValType getEmptyKey() {
+    return FunctionValType(DenseMapInfo<const Type*>::getEmptyKey(),
+                           ArrayRef<const Type*>(), false);
+  }
+  static FunctionValType getTombstoneKey() {
+    return FunctionValType(DenseMapInfo<const Type*>::getTombstoneKey(),
+                           ArrayRef<const Type*>(), false);
+  }
+
+  unsigned getHashValue() const {
+    return hashTypeKey(hashTypeKey(isVarArg, RetTy), ArgTypes);
+  }
+
+  inline bool operator==(const FunctionValType &MTV) const {
+    return RetTy == MTV.RetTy && isVarArg == MTV.isVarArg &&
+           ArgTypes == MTV.ArgTypes;
   }
 };
 
@@ -279,9 +359,10 @@ public:
 //
 template<class ValType, class TypeClass>
 class TypeMap : public TypeMapBase {
-  std::map<ValType, PATypeHolder> Map;
+  typedef DenseMap<ValType, PATypeHolder, TypeMapKeyInfo<ValType> > MapTy;
+  MapTy Map;
 public:
-  typedef typename std::map<ValType, PATypeHolder>::iterator iterator;
+  typedef typename MapTy::iterator iterator;
 
   inline TypeClass *get(const ValType &V) {
     iterator I = Map.find(V);
@@ -334,7 +415,7 @@ public:
     // efficient lookup in the map, instead of an inefficient nasty linear
     // lookup.
     if (!TypeHasCycleThroughItself(Ty)) {
-      typename std::map<ValType, PATypeHolder>::iterator I;
+      iterator I;
       bool Inserted;
 
       tie(I, Inserted) = Map.insert(std::make_pair(ValType::get(Ty), Ty));
@@ -412,8 +493,8 @@ public:
 #ifdef DEBUG_MERGE_TYPES
     DEBUG(dbgs() << "TypeMap<>::" << Arg << " table contents:\n");
     unsigned i = 0;
-    for (typename std::map<ValType, PATypeHolder>::const_iterator I
-           = Map.begin(), E = Map.end(); I != E; ++I)
+    for (typename MapTy::const_iterator I = Map.begin(), E = Map.end();
+         I != E; ++I)
       DEBUG(dbgs() << " " << (++i) << ". " << (void*)I->second.get() << " "
                    << *I->second.get() << "\n");
 #endif
@@ -24,11 +24,11 @@ void Use::swap(Use &RHS) {
   Value *V2(RHS.Val);
   if (V1 != V2) {
     if (V1) {
-      removeFromList();
+      V1->removeUse(*this);
     }
 
     if (V2) {
-      RHS.removeFromList();
+      V2->removeUse(RHS);
       Val = V2;
       V2->addUse(*this);
     } else {
@@ -49,6 +49,13 @@ void Use::swap(Use &RHS) {
 //===----------------------------------------------------------------------===//
 
 const Use *Use::getImpliedUser() const {
+  // The Uses closest to the User know how far away it is.
+  unsigned DirectTag = getTag();
+  if (DirectTag >= directTag)
+    return this + (DirectTag - directTag + 1);
+
+  // The others are waymarked up to the first of those, which are
+  // MaxDirectDistance Uses before the User.
   const Use *Current = this;
 
   while (true) {
@@ -70,13 +77,13 @@ const Use *Use::getImpliedUser() const {
               Offset = (Offset << 1) + Tag;
               continue;
             default:
-              return Current + Offset;
+              return Current + Offset + MaxDirectDistance;
           }
         }
       }
 
       case fullStopTag:
-        return Current;
+        return Current + MaxDirectDistance;
     }
   }
 }
@@ -86,6 +93,14 @@ const Use *Use::getImpliedUser() const {
 //===----------------------------------------------------------------------===//
 
 Use *Use::initTags(Use * const Start, Use *Stop) {
+  // Give the last Uses their distance from the User.
+  for (unsigned Distance = 1; Distance <= MaxDirectDistance; ++Distance) {
+    if (Start == Stop)
+      return Start;
+    new(--Stop) Use(directTag + Distance - 1);
+  }
+
+  // Waymark the rest.
   ptrdiff_t Done = 0;
   while (Done < 20) {
     if (Start == Stop--)
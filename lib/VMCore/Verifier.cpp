@@ -196,6 +196,8 @@ namespace {
         initializeVerifierPass(*PassRegistry::getPassRegistry());
       }
 
+    Pass *createClone() const { return new Verifier(action); }
+
     bool doInitialization(Module &M) {
       Mod = &M;
       Context = &M.getContext();
@@ -0,0 +1,91 @@
+; RUN: opt < %s -basicaa -memoryssa -analyze -verify-memoryssa | FileCheck %s
+
+declare void @g()
+
+; Defs chain through a block, and the load sees the last one.
+; CHECK: Printing analysis 'Memory SSA' for function 'straight':
+; CHECK: 1 = MemoryDef(liveOnEntry)
+; CHECK-NEXT: store i32 0, i32* %p
+; CHECK: 2 = MemoryDef(1)
+; CHECK-NEXT: call void @g()
+; CHECK: MemoryUse(2)
+; CHECK-NEXT: %v = load i32* %p
+define i32 @straight(i32* %p) {
+entry:
+  store i32 0, i32* %p
+  call void @g()
+  %v = load i32* %p
+  ret i32 %v
+}
+
+; The states flowing out of the two arms merge in a phi; the arm without a
+; store passes on the state from the entry block.
+; CHECK: Printing analysis 'Memory SSA' for function 'diamond':
+; CHECK: 1 = MemoryDef(liveOnEntry)
+; CHECK-NEXT: store i32 0, i32* %p
+; CHECK: %left:
+; CHECK: 2 = MemoryDef(1)
+; CHECK-NEXT: store i32 1, i32* %p
+; CHECK: %join:
+; CHECK-NEXT: 3 = MemoryPhi({%entry,1},{%left,2})
+; CHECK: MemoryUse(3)
+; CHECK-NEXT: %v = load i32* %p
+define i32 @diamond(i32* %p, i1 %c) {
+entry:
+  store i32 0, i32* %p
+  br i1 %c, label %left, label %join
+
+left:
+  store i32 1, i32* %p
+  br label %join
+
+join:
+  %v = load i32* %p
+  ret i32 %v
+}
+
+; A loop header merges the state from before the loop with the state from
+; the latch; blocks without defs need no phi.
+; CHECK: Printing analysis 'Memory SSA' for function 'loop':
+; CHECK: %loop:
+; CHECK-NEXT: 2 = MemoryPhi({%entry,liveOnEntry},{%loop,1})
+; CHECK: MemoryUse(2)
+; CHECK-NEXT: %v = load i32* %p
+; CHECK: 1 = MemoryDef(2)
+; CHECK-NEXT: store i32 %inc, i32* %p
+; CHECK: %exit:
+; CHECK-NOT: MemoryPhi
+; CHECK: MemoryUse(1)
+; CHECK-NEXT: %r = load i32* %p
+define i32 @loop(i32* %p, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32* %p
+  %inc = add i32 %v, 1
+  store i32 %inc, i32* %p
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = load i32* %p
+  ret i32 %r
+}
+
+; Unreachable blocks start from the live on entry state.
+; CHECK: Printing analysis 'Memory SSA' for function 'unreachable':
+; CHECK: %dead:
+; CHECK: 2 = MemoryDef(liveOnEntry)
+; CHECK-NEXT: store i32 2, i32* %p
+define void @unreachable(i32* %p) {
+entry:
+  store i32 1, i32* %p
+  ret void
+
+dead:
+  store i32 2, i32* %p
+  ret void
+}
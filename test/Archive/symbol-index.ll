@@ -0,0 +1,30 @@
+; Members are pulled in through the archive's symbol index, including those
+; that only become needed once an earlier member has been linked in.
+; RUN: rm -f %t.a
+; RUN: echo {define i32 @a() \{ %r = call i32 @b() \
+; RUN:   ret i32 %r \} declare i32 @b()} | llvm-as -o %t.a.bc
+; RUN: echo {define i32 @b() \{ %r = call i32 @c() \
+; RUN:   ret i32 %r \} declare i32 @c()} | llvm-as -o %t.b.bc
+; RUN: echo {define i32 @c() \{ ret i32 7 \}} | llvm-as -o %t.c.bc
+; RUN: echo {define i32 @unused() \{ ret i32 0 \}} | llvm-as -o %t.unused.bc
+; RUN: llvm-ar rcs %t.a %t.c.bc %t.unused.bc %t.b.bc %t.a.bc
+; RUN: llvm-as %s -o %t.main.bc
+; RUN: llvm-ld -disable-opt -link-as-library %t.main.bc %t.a -o %t.linked.bc
+; RUN: llvm-dis < %t.linked.bc | FileCheck %s
+
+; Members are linked in the order they become needed.
+; CHECK: define i32 @main
+; CHECK-NOT: define i32 @unused
+; CHECK: define i32 @a
+; CHECK-NOT: define i32 @unused
+; CHECK: define i32 @b
+; CHECK-NOT: define i32 @unused
+; CHECK: define i32 @c
+; CHECK-NOT: define i32 @unused
+
+declare i32 @a()
+
+define i32 @main() {
+	%r = call i32 @a()
+	ret i32 %r
+}
@@ -0,0 +1,9 @@
+; RUN: not llvm-as < %s |& FileCheck %s
+; The largest numbered references must get the usual diagnostic.
+
+; CHECK: use of undefined value '@4294967295'
+
+define void @f() {
+  call void @4294967295()
+  ret void
+}
@@ -0,0 +1,8 @@
+; RUN: not llvm-as < %s |& FileCheck %s
+; The largest numbered references must get the usual diagnostic.
+
+; CHECK: use of undefined value '%4294967294'
+
+define i32 @f() {
+  ret i32 %4294967294
+}
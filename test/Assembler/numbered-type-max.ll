@@ -0,0 +1,6 @@
+; RUN: not llvm-as < %s |& FileCheck %s
+; The largest numbered references must get the usual diagnostic.
+
+; CHECK: use of undefined type '%4294967295'
+
+%x = type %4294967295*
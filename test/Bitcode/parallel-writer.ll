@@ -0,0 +1,63 @@
+; Function blocks encoded on several threads must be spliced back into
+; exactly the bits the serial writer produces.
+; RUN: llvm-as < %s -o %t.serial.bc
+; RUN: llvm-as -bitcode-writer-threads=3 < %s -o %t.parallel.bc
+; RUN: cmp %t.serial.bc %t.parallel.bc
+; RUN: llvm-dis < %t.parallel.bc | FileCheck %s
+
+@str = internal constant [6 x i8] c"hello\00"
+@table = global [2 x i8*] [i8* blockaddress(@jump, %a), i8* blockaddress(@jump, %b)]
+
+; CHECK: define i32 @add
+define i32 @add(i32 %x, i32 %y) nounwind {
+entry:
+  %sum = add nsw i32 %x, %y, !dbg !3
+  %cmp = icmp sgt i32 %sum, 1000, !prof !5
+  br i1 %cmp, label %big, label %small
+
+big:
+  ret i32 1000
+
+small:
+  ret i32 %sum
+}
+
+; CHECK: define double @scale
+define double @scale(double %v) {
+  %m = fmul double %v, 2.500000e+00
+  %d = fdiv double %m, 3.000000e+00
+  ret double %d
+}
+
+; CHECK: define i8* @name
+define i8* @name() {
+  ret i8* getelementptr ([6 x i8]* @str, i32 0, i32 0)
+}
+
+; CHECK: define void @jump
+define void @jump(i8* %target) {
+entry:
+  indirectbr i8* %target, [label %a, label %b]
+a:
+  ret void
+b:
+  call void @llvm.dbg.value(metadata !{i8* %target}, i64 0, metadata !4)
+  ret void
+}
+
+declare void @llvm.dbg.value(metadata, i64, metadata) nounwind readnone
+
+; CHECK: define <4 x i32> @vec
+define <4 x i32> @vec(<4 x i32> %a) {
+  %b = add <4 x i32> %a, <i32 1, i32 2, i32 3, i32 4>
+  %c = shufflevector <4 x i32> %b, <4 x i32> undef, <4 x i32> zeroinitializer
+  ret <4 x i32> %c
+}
+
+!llvm.named = !{!0}
+!0 = metadata !{metadata !"module-level", i32 7}
+!1 = metadata !{metadata !"t.c"}
+!2 = metadata !{metadata !"add", metadata !1}
+!3 = metadata !{i32 4, i32 3, metadata !2, null}
+!4 = metadata !{metadata !"target", metadata !2}
+!5 = metadata !{metadata !"branch_weights", i32 1, i32 99}
@@ -0,0 +1,181 @@
+; Exercise the interpreter's register bytecode at the edges of its fast
+; paths: narrow and wide integers, shifts by the width or more, signed
+; division overflow, NaNs, memory of every width and PHI nodes that swap.
+; Loads and stores only take the fast path when the target's byte order is the
+; host's.
+; RUN: lli -force-interpreter %s > /dev/null
+; XFAIL: powerpc, sparc
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64"
+
+@arr = global [4 x i16] [i16 1, i16 -2, i16 3, i16 -4]
+@flag = global i8 -1
+
+declare i32 @llvm.ctpop.i32(i32)
+
+define i1 @narrow() {
+	%a = add i8 127, 1
+	%b = mul i16 300, 300
+	%c = sub i8 0, 1
+	%ok1 = icmp eq i8 %a, -128
+	%ok2 = icmp eq i16 %b, 24464
+	%ok3 = icmp slt i8 %c, 0
+	%ok4 = icmp ugt i8 %c, 200
+	%s = sext i8 %c to i32
+	%z = zext i8 %c to i32
+	%ok5 = icmp eq i32 %s, -1
+	%ok6 = icmp eq i32 %z, 255
+	%t = trunc i32 511 to i8
+	%ok7 = icmp eq i8 %t, -1
+	%r1 = and i1 %ok1, %ok2
+	%r2 = and i1 %r1, %ok3
+	%r3 = and i1 %r2, %ok4
+	%r4 = and i1 %r3, %ok5
+	%r5 = and i1 %r4, %ok6
+	%r6 = and i1 %r5, %ok7
+	ret i1 %r6
+}
+
+define i1 @shifts(i32 %amt, i64 %wide) {
+	%a = shl i32 5, %amt
+	%b = ashr i32 -8, %amt
+	%c = lshr i64 %wide, 70
+	%d = ashr i32 -8, 1
+	%ok1 = icmp eq i32 %a, 5
+	%ok2 = icmp eq i32 %b, -8
+	%ok3 = icmp eq i64 %c, %wide
+	%ok4 = icmp eq i32 %d, -4
+	%r1 = and i1 %ok1, %ok2
+	%r2 = and i1 %r1, %ok3
+	%r3 = and i1 %r2, %ok4
+	ret i1 %r3
+}
+
+define i1 @division(i32 %min, i64 %min64, i32 %m1) {
+	%a = sdiv i32 %min, %m1
+	%b = srem i32 %min, %m1
+	%c = sdiv i64 %min64, -1
+	%d = sdiv i32 -7, 2
+	%e = srem i32 -7, 2
+	%f = udiv i32 -7, 2
+	%ok1 = icmp eq i32 %a, %min
+	%ok2 = icmp eq i32 %b, 0
+	%ok3 = icmp eq i64 %c, %min64
+	%ok4 = icmp eq i32 %d, -3
+	%ok5 = icmp eq i32 %e, -1
+	%ok6 = icmp eq i32 %f, 2147483644
+	%r1 = and i1 %ok1, %ok2
+	%r2 = and i1 %r1, %ok3
+	%r3 = and i1 %r2, %ok4
+	%r4 = and i1 %r3, %ok5
+	%r5 = and i1 %r4, %ok6
+	ret i1 %r5
+}
+
+define i1 @floats(double %x) {
+	%nan = fdiv double 0.0, 0.0
+	%ok1 = fcmp uno double %nan, %x
+	%lt = fcmp olt double %nan, %x
+	%ok2 = xor i1 %lt, true
+	%ok3 = fcmp ult double %nan, %x
+	%h = fmul double %x, 5.000000e-01
+	%ok4 = fcmp oeq double %h, 1.250000e+00
+	%i = sitofp i8 -3 to double
+	%ok5 = fcmp oeq double %i, -3.000000e+00
+	%u = uitofp i8 -3 to double
+	%ok6 = fcmp oeq double %u, 2.530000e+02
+	%f = fptrunc double %x to float
+	%e = fpext float %f to double
+	%ok7 = fcmp oeq double %e, %x
+	%r1 = and i1 %ok1, %ok2
+	%r2 = and i1 %r1, %ok3
+	%r3 = and i1 %r2, %ok4
+	%r4 = and i1 %r3, %ok5
+	%r5 = and i1 %r4, %ok6
+	%r6 = and i1 %r5, %ok7
+	ret i1 %r6
+}
+
+define i1 @memory(i32 %i) {
+	%p = getelementptr [4 x i16]* @arr, i32 0, i32 %i
+	%v = load i16* %p
+	%ok1 = icmp eq i16 %v, -4
+	%back = sub i32 0, 2
+	%q = getelementptr i16* %p, i32 %back
+	%w = load i16* %q
+	%ok2 = icmp eq i16 %w, -2
+	store i16 7, i16* %q
+	%x = load i16* getelementptr ([4 x i16]* @arr, i32 0, i32 1)
+	%ok3 = icmp eq i16 %x, 7
+	%slot = alloca i64
+	store i64 -1, i64* %slot
+	%lo = bitcast i64* %slot to i32*
+	store i32 0, i32* %lo
+	%all = load i64* %slot
+	%ok4 = icmp eq i64 %all, -4294967296
+	%fl = load i8* @flag
+	%ok5 = icmp eq i8 %fl, -1
+	%r1 = and i1 %ok1, %ok2
+	%r2 = and i1 %r1, %ok3
+	%r3 = and i1 %r2, %ok4
+	%r4 = and i1 %r3, %ok5
+	ret i1 %r4
+}
+
+; The back edge swaps %a and %b, so its moves have to read both before
+; writing either.
+define i1 @swap() {
+entry:
+	br label %loop
+
+loop:
+	%a = phi i32 [ 1, %entry ], [ %b, %loop ]
+	%b = phi i32 [ 2, %entry ], [ %a, %loop ]
+	%n = phi i32 [ 0, %entry ], [ %n1, %loop ]
+	%n1 = add i32 %n, 1
+	%done = icmp eq i32 %n1, 2
+	br i1 %done, label %exit, label %loop
+
+exit:
+	%ok1 = icmp eq i32 %a, 2
+	%ok2 = icmp eq i32 %b, 1
+	%r = and i1 %ok1, %ok2
+	ret i1 %r
+}
+
+; The deepest call lowers the first @llvm.ctpop while the frames above it
+; wait to run the second one, which the next deepest then lowers under them.
+define i32 @lowered(i32 %n) {
+	%base = icmp eq i32 %n, 0
+	br i1 %base, label %done, label %more
+
+more:
+	%m = sub i32 %n, 1
+	%r = call i32 @lowered( i32 %m )
+	%c = call i32 @llvm.ctpop.i32( i32 %n )
+	%s = add i32 %r, %c
+	ret i32 %s
+
+done:
+	%c0 = call i32 @llvm.ctpop.i32( i32 7 )
+	ret i32 %c0
+}
+
+define i32 @main() {
+	%ok1 = call i1 @narrow()
+	%ok2 = call i1 @shifts( i32 32, i64 81985529216486895 )
+	%ok3 = call i1 @division( i32 -2147483648, i64 -9223372036854775808, i32 -1 )
+	%ok4 = call i1 @floats( double 2.500000e+00 )
+	%ok5 = call i1 @memory( i32 3 )
+	%ok6 = call i1 @swap()
+	%l = call i32 @lowered( i32 3 )
+	%ok7 = icmp eq i32 %l, 7
+	%r1 = and i1 %ok1, %ok2
+	%r2 = and i1 %r1, %ok3
+	%r3 = and i1 %r2, %ok4
+	%r4 = and i1 %r3, %ok5
+	%r5 = and i1 %r4, %ok6
+	%r6 = and i1 %r5, %ok7
+	%ret = select i1 %r6, i32 0, i32 1
+	ret i32 %ret
+}
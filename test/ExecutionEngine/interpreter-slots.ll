@@ -0,0 +1,41 @@
+; Recursion keeps several frames of the same function live, and lowering
+; @llvm.ctpop inserts new instructions into a function that is running.
+; RUN: lli -force-interpreter %s > /dev/null
+
+declare i32 @llvm.ctpop.i32(i32)
+
+define i32 @fib(i32 %N) {
+entry:
+	%small = icmp slt i32 %N, 2
+	br i1 %small, label %done, label %recurse
+
+recurse:
+	%n1 = sub i32 %N, 1
+	%f1 = call i32 @fib( i32 %n1 )
+	%n2 = sub i32 %N, 2
+	%f2 = call i32 @fib( i32 %n2 )
+	%sum = add i32 %f1, %f2
+	ret i32 %sum
+
+done:
+	ret i32 %N
+}
+
+define i32 @bits(i32 %X) {
+	%a = call i32 @llvm.ctpop.i32( i32 %X )
+	%b = add i32 %a, %X
+	ret i32 %b
+}
+
+define i32 @main() {
+	%f = call i32 @fib( i32 10 )
+	%ok1 = icmp eq i32 %f, 55
+	%b1 = call i32 @bits( i32 7 )
+	%b2 = call i32 @bits( i32 255 )
+	%ok2 = icmp eq i32 %b1, 10
+	%ok3 = icmp eq i32 %b2, 263
+	%ok12 = and i1 %ok1, %ok2
+	%ok = and i1 %ok12, %ok3
+	%ret = select i1 %ok, i32 0, i32 1
+	ret i32 %ret
+}
@@ -0,0 +1,59 @@
+; Run with tiered execution, so that @sum gets handed to the JIT part of the
+; way through the loop in @main, which keeps counting through a global both
+; tiers share.
+; RUN: lli -force-interpreter -interpreter-jit-threshold=3 -stats %s |& \
+; RUN:   FileCheck %s -check-prefix=BACKGROUND
+; RUN: lli -force-interpreter -interpreter-jit-threshold=3 \
+; RUN:   -interpreter-jit-sync -stats %s |& FileCheck %s -check-prefix=SYNC
+; XFAIL: arm
+
+; The loop in the first call to @sum makes it hot, so the second call hands it
+; to the compile thread. The interpreter keeps going; how many calls still run
+; interpreted depends on timing.
+; BACKGROUND: 1 interpreter - Number of functions handed over to the JIT
+
+; Compiling on the interpreter's thread, the second call and the eight after
+; it run natively.
+; SYNC: 9 interpreter - Number of calls run natively
+; SYNC: 1 interpreter - Number of functions compiled by the JIT
+; SYNC: 1 interpreter - Number of functions handed over to the JIT
+
+target datalayout = "e-p:64:64-s:64-f64:64:64-i64:64:64-f80:128:128-f128:128:128-n8:16:32:64"
+
+@total = global i64 0
+
+define i64 @sum(i64 %N, double %Scale) {
+entry:
+	br label %loop
+
+loop:
+	%i = phi i64 [ 0, %entry ], [ %next, %loop ]
+	%old = load i64* @total
+	%new = add i64 %old, %i
+	store i64 %new, i64* @total
+	%next = add i64 %i, 1
+	%done = icmp eq i64 %next, %N
+	br i1 %done, label %exit, label %loop
+
+exit:
+	%r = load i64* @total
+	ret i64 %r
+}
+
+define i32 @main() {
+entry:
+	br label %loop
+
+loop:
+	%i = phi i32 [ 0, %entry ], [ %next, %loop ]
+	%r = call i64 @sum( i64 10, double 1.000000e+00 )
+	%next = add i32 %i, 1
+	%done = icmp eq i32 %next, 10
+	br i1 %done, label %exit, label %loop
+
+exit:
+	; Ten calls adding 45 each.
+	%ok = icmp eq i64 %r, 450
+	%ret = select i1 %ok, i32 0, i32 1
+	ret i32 %ret
+}
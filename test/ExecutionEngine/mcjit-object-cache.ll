@@ -0,0 +1,21 @@
+; RUN: rm -rf %t.cache
+; RUN: lli -use-mcjit -mcjit-object-cache=%t.cache -stats %s |& FileCheck %s -check-prefix=MISS
+; RUN: ls %t.cache | grep mcjit-
+; RUN: lli -use-mcjit -mcjit-object-cache=%t.cache -stats %s |& FileCheck %s -check-prefix=HIT
+; XFAIL: arm, mingw32, win32, cygwin
+
+; The first run generates code and stores the object, the second loads it.
+; MISS-NOT: loaded from the object cache
+; MISS: 1 mcjit - Number of objects stored in the object cache
+; HIT: 1 mcjit - Number of objects loaded from the object cache
+; HIT-NOT: stored in the object cache
+
+define i32 @twice(i32 %A) {
+	%B = add i32 %A, %A		; <i32> [#uses=1]
+	ret i32 %B
+}
+
+define i32 @main() {
+	%X = call i32 @twice( i32 0 )		; <i32> [#uses=1]
+	ret i32 %X
+}
@@ -0,0 +1,69 @@
+; Functions compiled on the background thread must be picked up through the
+; lazy stubs that have already been emitted for them, and keep the address
+; they had before being compiled.
+; RUN: lli -speculative-compilation -stats %s |& FileCheck %s
+; XFAIL: arm
+
+; @main sleeps before its first call, which leaves the compile thread time
+; to get through @outer and the functions it calls.
+; CHECK: {{[1-9][0-9]*}} jit - Number of functions compiled ahead of a call
+
+declare i32 @usleep(i32)
+
+@funcPtr = global i32 (i32)* null
+
+define i32 @main() nounwind {
+entry:
+	store i32 (i32)* @leaf, i32 (i32)** @funcPtr
+	call i32 @usleep(i32 500000)
+	br label %loop
+
+loop:
+	%i = phi i32 [ 0, %entry ], [ %next, %loop ]
+	%acc = phi i32 [ 0, %entry ], [ %sum, %loop ]
+	%v = call i32 @outer(i32 %i)
+	%sum = add i32 %acc, %v
+	%next = add i32 %i, 1
+	%done = icmp eq i32 %next, 1000
+	br i1 %done, label %check, label %loop
+
+check:
+	; Each iteration adds 4 * i.
+	%ok = icmp eq i32 %sum, 1998000
+	%same = call i1 @same_address()
+	%pass = and i1 %ok, %same
+	br i1 %pass, label %pass_block, label %fail_block
+
+pass_block:
+	ret i32 0
+
+fail_block:
+	ret i32 1
+}
+
+define i32 @outer(i32 %x) nounwind {
+	%a = call i32 @middle(i32 %x)
+	%b = call i32 @leaf(i32 %a)
+	%c = add i32 %a, %b
+	ret i32 %c
+}
+
+define i32 @middle(i32 %x) nounwind {
+	%a = call i32 @leaf(i32 %x)
+	%b = add i32 %a, %x
+	ret i32 %b
+}
+
+define i32 @leaf(i32 %x) nounwind {
+	%a = shl i32 %x, 1
+	%b = sub i32 %a, %x
+	%c = add i32 %b, 1
+	%d = sub i32 %c, 1
+	ret i32 %d
+}
+
+define i1 @same_address() nounwind {
+	%p = load i32 (i32)** @funcPtr
+	%eq = icmp eq i32 (i32)* %p, @leaf
+	ret i1 %eq
+}
@@ -0,0 +1,12 @@
+; RUN: lli -use-mcjit %s > /dev/null
+; XFAIL: arm, mingw32, win32, cygwin
+
+define i32 @diff(i32 %A, i32 %B) {
+	%C = sub i32 %A, %B		; <i32> [#uses=1]
+	ret i32 %C
+}
+
+define i32 @main() {
+	%X = call i32 @diff( i32 42, i32 42 )		; <i32> [#uses=1]
+	ret i32 %X
+}
@@ -0,0 +1,32 @@
+; Link several modules at once: appending variables are merged in input
+; order, a weak body is replaced by a strong definition from a later input,
+; and only one copy of a linkonce body is kept.
+; RUN: llvm-as %s -o %t.a.bc
+; RUN: llvm-as %p/multiple-inputs-b.ll -o %t.b.bc
+; RUN: llvm-as %p/multiple-inputs-c.ll -o %t.c.bc
+; RUN: llvm-link %t.a.bc %t.b.bc %t.c.bc -S | FileCheck %s
+
+; CHECK: @table = global i8* blockaddress(@g, %b)
+; CHECK: @X = appending global [4 x i32] [i32 7, i32 8, i32 9, i32 10]
+@X = appending global [1 x i32] [i32 7]
+
+; CHECK: define i32 @main()
+define i32 @main() {
+  %a = call i32 @f()
+  %b = call i32 @once()
+  %c = add i32 %a, %b
+  ret i32 %c
+}
+
+; CHECK: define linkonce i32 @once()
+; CHECK-NEXT: ret i32 2
+; CHECK-NOT: ret i32 4
+declare i32 @once()
+
+; CHECK: define i32 @f()
+; CHECK-NEXT: ret i32 3
+define weak i32 @f() {
+  ret i32 1
+}
+
+; CHECK: define void @g()
@@ -0,0 +1,12 @@
+; This file is for use with multiple-inputs-a.ll
+; RUN: true
+
+@X = appending global [1 x i32] [i32 8]
+
+define linkonce i32 @once() {
+  ret i32 2
+}
+
+define i32 @f() {
+  ret i32 3
+}
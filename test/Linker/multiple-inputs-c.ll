@@ -0,0 +1,15 @@
+; This file is for use with multiple-inputs-a.ll
+; RUN: true
+
+@X = appending global [2 x i32] [i32 9, i32 10]
+@table = global i8* blockaddress(@g, %b)
+
+define linkonce i32 @once() {
+  ret i32 4
+}
+
+define void @g() {
+  br label %b
+b:
+  ret void
+}
@@ -0,0 +1,27 @@
+; A weak body in a lazily read input that a later input overrides with a
+; strong definition is skipped, and the strong body is linked in its place.
+; RUN: llvm-as %s -o %t.d.bc
+; RUN: llvm-as %p/multiple-inputs-e.ll -o %t.e.bc
+; RUN: llvm-as %p/multiple-inputs-b.ll -o %t.b.bc
+; RUN: llvm-link %t.d.bc %t.e.bc %t.b.bc -S | FileCheck %s
+
+; CHECK: @X = appending global [3 x i32] [i32 5, i32 6, i32 8]
+@X = appending global [1 x i32] [i32 5]
+
+; CHECK: define i32 @main()
+define i32 @main() {
+  %a = call i32 @f()
+  %b = call i32 @once()
+  %c = add i32 %a, %b
+  ret i32 %c
+}
+
+declare i32 @f()
+declare i32 @once()
+
+; CHECK: define linkonce i32 @once()
+; CHECK-NEXT: ret i32 5
+
+; CHECK: define i32 @f()
+; CHECK-NEXT: ret i32 3
+; CHECK-NOT: ret i32 1
@@ -0,0 +1,12 @@
+; This file is for use with multiple-inputs-d.ll
+; RUN: true
+
+@X = appending global [1 x i32] [i32 6]
+
+define weak i32 @f() {
+  ret i32 1
+}
+
+define linkonce i32 @once() {
+  ret i32 5
+}
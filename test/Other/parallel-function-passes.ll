@@ -0,0 +1,90 @@
+; RUN: opt < %s -simplify-libcalls -instcombine -gvn -simplifycfg -S -threads=1 > %t1
+; RUN: opt < %s -simplify-libcalls -instcombine -gvn -simplifycfg -S -threads=4 > %t2
+; RUN: diff %t1 %t2
+; RUN: FileCheck %s < %t2
+
+; Running function passes on several threads must give the same module as
+; running them on one function at a time.
+
+@G = global i32 0
+@H = internal global i32 5
+@Str = private constant [4 x i8] c"abc\00"
+@Msg = private constant [7 x i8] c"hello\0A\00"
+
+declare i32 @strlen(i8*)
+declare i32 @printf(i8*, ...)
+
+; CHECK: define i32 @len
+; CHECK: ret i32 3
+define i32 @len() {
+  %s = call i32 @strlen(i8* getelementptr ([4 x i8]* @Str, i32 0, i32 0))
+  ret i32 %s
+}
+
+; printf of a constant string becomes a call to puts, which is declared in the
+; module while other functions may still be running.
+; CHECK: define void @hello1
+; CHECK: call i32 @puts
+define void @hello1() {
+  %r = call i32 (i8*, ...)* @printf(i8* getelementptr ([7 x i8]* @Msg, i32 0, i32 0))
+  ret void
+}
+
+; CHECK: define void @hello2
+; CHECK: call i32 @puts
+define void @hello2() {
+  %r = call i32 (i8*, ...)* @printf(i8* getelementptr ([7 x i8]* @Msg, i32 0, i32 0))
+  ret void
+}
+
+; CHECK: define i32 @fold
+; CHECK-NOT: add
+; CHECK: ret i32 %x
+define i32 @fold(i32 %x) {
+  %a = add i32 %x, 1
+  %b = sub i32 %a, 1
+  br label %next
+next:
+  ret i32 %b
+}
+
+; CHECK: define i32 @loads
+; CHECK: load i32* @G
+; CHECK-NOT: load
+; CHECK: ret
+define i32 @loads() {
+  %a = load i32* @G
+  %b = load i32* @G
+  %c = add i32 %a, %b
+  ret i32 %c
+}
+
+; CHECK: define void @stores
+define void @stores(i32 %x) {
+  store i32 %x, i32* @G
+  store i32 %x, i32* @H
+  ret void
+}
+
+; CHECK: define i32 @calls
+define i32 @calls(i32 %x) {
+  %a = call i32 @fold(i32 %x)
+  %b = call i32 @loads()
+  call void @stores(i32 %a)
+  %c = add i32 %a, %b
+  ret i32 %c
+}
+
+; CHECK: define i32 @select
+; CHECK: select
+define i32 @select(i1 %c, i32 %x, i32 %y) {
+entry:
+  br i1 %c, label %t, label %f
+t:
+  br label %join
+f:
+  br label %join
+join:
+  %p = phi i32 [ %x, %t ], [ %y, %f ]
+  ret i32 %p
+}
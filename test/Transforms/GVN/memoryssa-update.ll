@@ -0,0 +1,53 @@
+; RUN: opt < %s -basicaa -gvn -verify-memoryssa -S | FileCheck %s
+
+; GVN merges %next into %entry before it looks at the loads.  Memory SSA has
+; to follow the store into %entry for the non-local load in %join to find the
+; store's value on one path and the load inserted by PRE on the other.
+
+declare void @g()
+
+; CHECK: @merged_block
+; CHECK: b:
+; CHECK-NEXT: call void @g()
+; CHECK-NEXT: %y.pre = load i32* %p
+; CHECK: join:
+; CHECK-NEXT: %y = phi i32 [ %y.pre, %b ], [ 1, %a ]
+define i32 @merged_block(i32* %p, i1 %c) {
+entry:
+  br label %next
+
+next:
+  store i32 1, i32* %p
+  br i1 %c, label %a, label %b
+
+a:
+  br label %join
+
+b:
+  call void @g()
+  br label %join
+
+join:
+  %y = load i32* %p
+  ret i32 %y
+}
+
+; PRE splits the critical edge from %entry to %join to insert the load.
+; CHECK: @split_edge
+; CHECK: entry.join_crit_edge:
+; CHECK-NEXT: %y.pre = load i32* %p
+; CHECK: join:
+; CHECK-NEXT: %y = phi i32 [ %y.pre, %entry.join_crit_edge ], [ 2, %a ]
+define i32 @split_edge(i32* %p, i1 %c) {
+entry:
+  call void @g()
+  br i1 %c, label %a, label %join
+
+a:
+  store i32 2, i32* %p
+  br label %join
+
+join:
+  %y = load i32* %p
+  ret i32 %y
+}
@@ -0,0 +1,62 @@
+; RUN: opt < %s -inline -functionattrs -instcombine -S -cgscc-threads=1 > %t1
+; RUN: opt < %s -inline -functionattrs -instcombine -S -cgscc-threads=4 > %t2
+; RUN: diff %t1 %t2
+; RUN: FileCheck %s < %t2
+
+; Visiting SCCs on several threads must give the same module as visiting
+; them one at a time.
+
+@G = global i32 0
+@FP = global void ()* null
+@Str = private constant [4 x i8] c"abc\00"
+
+define internal i32 @leaf1(i32 %x) {
+  %a = add i32 %x, 1
+  ret i32 %a
+}
+
+define internal i32 @leaf2(i32 %x) {
+  %v = load i32* @G
+  %a = mul i32 %x, %v
+  ret i32 %a
+}
+
+define i32 @leaf3(i32* %p) {
+  store i32 7, i32* %p
+  %s = call i32 @strlen(i8* getelementptr ([4 x i8]* @Str, i32 0, i32 0))
+  ret i32 %s
+}
+
+declare i32 @strlen(i8*)
+
+define internal void @indirect() {
+  %f = load void ()** @FP
+  call void %f()
+  ret void
+}
+
+define i32 @rec(i32 %n) {
+  %c = icmp eq i32 %n, 0
+  br i1 %c, label %done, label %more
+more:
+  %m = sub i32 %n, 1
+  %r = call i32 @rec(i32 %m)
+  ret i32 %r
+done:
+  ret i32 0
+}
+
+; CHECK: define i32 @caller
+; CHECK-NOT: call i32 @leaf1
+; CHECK-NOT: call i32 @leaf2
+; CHECK: ret i32
+define i32 @caller(i32 %x) {
+  %a = call i32 @leaf1(i32 %x)
+  %b = call i32 @leaf2(i32 %a)
+  %c = alloca i32
+  %d = call i32 @leaf3(i32* %c)
+  call void @indirect()
+  %e = call i32 @rec(i32 %b)
+  %f = add i32 %d, %e
+  ret i32 %f
+}
@@ -0,0 +1,85 @@
+; RUN: opt < %s -domtree -jump-threading -verify-dom-info -verify-dom-updates -S | FileCheck %s
+
+; Jump threading keeps the dominator tree up to date as it changes the CFG;
+; -verify-dom-updates checks the tree against a fresh one after each update.
+
+declare void @f1()
+declare void @f2()
+
+; Both predecessors of %merge are threaded through it, leaving it dead, and
+; the threaded blocks are then merged into their successors.
+; CHECK: @thread
+; CHECK: entry:
+; CHECK-NEXT: br i1 %c, label %yes, label %no
+; CHECK: yes:
+; CHECK-NEXT: call void @f1()
+; CHECK-NEXT: call void @f1()
+; CHECK-NEXT: ret i32 1
+define i32 @thread(i1 %c) {
+entry:
+  br i1 %c, label %t, label %f
+
+t:
+  call void @f1()
+  br label %merge
+
+f:
+  call void @f2()
+  br label %merge
+
+merge:
+  %p = phi i1 [ true, %t ], [ false, %f ]
+  br i1 %p, label %yes, label %no
+
+yes:
+  call void @f1()
+  ret i32 1
+
+no:
+  call void @f2()
+  ret i32 0
+}
+
+; The branch on undef is folded, which makes one arm unreachable.
+; CHECK: @fold_undef
+; CHECK-NOT: br
+; CHECK: ret i32 1
+define i32 @fold_undef() {
+entry:
+  call void @f1()
+  br i1 undef, label %a, label %b
+
+a:
+  call void @f1()
+  br label %join
+
+b:
+  call void @f2()
+  br label %join
+
+join:
+  %r = phi i32 [ 1, %a ], [ 2, %b ]
+  ret i32 %r
+}
+
+; %next is merged into the entry block, which changes the root of the tree.
+; CHECK: @merge_entry
+; CHECK-NEXT: next:
+; CHECK-NEXT: call void @f1()
+; CHECK-NEXT: call void @f2()
+define void @merge_entry(i1 %c) {
+entry:
+  call void @f1()
+  br label %next
+
+next:
+  call void @f2()
+  br i1 %c, label %loop, label %exit
+
+loop:
+  call void @f1()
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,256 @@
+; RUN: opt -basicaa -loop-vectorize -force-vector-width=4 -S < %s | FileCheck %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-apple-darwin10.0.0"
+
+; a[i] = b[i] + c[i], with arrays that cannot overlap.
+define void @test1(i32* noalias %a, i32* noalias %b, i32* noalias %c, i64 %n) nounwind {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pb = getelementptr inbounds i32* %b, i64 %i
+  %vb = load i32* %pb, align 4
+  %pc = getelementptr inbounds i32* %c, i64 %i
+  %vc = load i32* %pc, align 4
+  %s = add nsw i32 %vb, %vc
+  %pa = getelementptr inbounds i32* %a, i64 %i
+  store i32 %s, i32* %pa, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test1
+; CHECK: %n.vec = and i64 %trip.count, -4
+; CHECK-NOT: found.conflict
+; CHECK: br i1 %cmp.zero, label %scalar.ph, label %vector.ph
+; CHECK: vector.body:
+; CHECK: load <4 x i32>* {{.*}}, align 4
+; CHECK: load <4 x i32>* {{.*}}, align 4
+; CHECK: add nsw <4 x i32>
+; CHECK: store <4 x i32> {{.*}}, align 4
+; CHECK: %index.next = add i64 %index, 4
+; CHECK: middle.block:
+; CHECK: %cmp.n = icmp eq i64 %n.vec, %trip.count
+; CHECK: scalar.ph:
+; CHECK: %i.resume = phi i64
+; CHECK: for.body:
+; CHECK: load i32*
+; CHECK: ret void
+}
+
+; The lanes of a sum are added up after the vector loop.
+define i32 @test2(i32* %a, i64 %n) nounwind readonly {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %r = phi i32 [ 7, %entry ], [ %r.next, %for.body ]
+  %p = getelementptr inbounds i32* %a, i64 %i
+  %v = load i32* %p, align 4
+  %r.next = add i32 %v, %r
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret i32 %r.next
+; CHECK: @test2
+; CHECK: vector.body:
+; CHECK: %r.vec = phi <4 x i32> [ <i32 7, i32 0, i32 0, i32 0>, %vector.ph ]
+; CHECK: add <4 x i32>
+; CHECK: middle.block:
+; CHECK: shufflevector <4 x i32> {{.*}} <i32 2, i32 3, i32 undef, i32 undef>
+; CHECK: shufflevector <4 x i32> {{.*}} <i32 1, i32 undef, i32 undef, i32 undef>
+; CHECK: %r.rdx = extractelement <4 x i32> {{.*}}, i32 0
+; CHECK: %r.resume = phi i32 [ %r.rdx, %middle.block ], [ 7, %entry ]
+; CHECK: for.end:
+; CHECK: phi i32 [ %r.next.lcssa{{.*}}, %scalar.exit ], [ %r.rdx, %middle.block ]
+}
+
+; The product of the lanes starts from ones.
+define i32 @test3(i32* %a, i64 %n) nounwind readonly {
+entry:
+  %n.trunc = trunc i64 %n to i32
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %r = phi i32 [ %n.trunc, %entry ], [ %r.next, %for.body ]
+  %p = getelementptr inbounds i32* %a, i64 %i
+  %v = load i32* %p, align 4
+  %r.next = mul i32 %r, %v
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret i32 %r.next
+; CHECK: @test3
+; CHECK: vector.ph:
+; CHECK: insertelement <4 x i32> <i32 1, i32 1, i32 1, i32 1>, i32 %n.trunc, i32 0
+; CHECK: mul <4 x i32>
+}
+
+; Arrays that may overlap are checked before the vector loop, and the final
+; value of the induction variable is computed from the trip count.
+define i64 @test4(float* %a, float* %b, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pb = getelementptr inbounds float* %b, i64 %i
+  %vb = load float* %pb, align 4
+  %mul = fmul float %vb, 3.000000e+00
+  %conv = sitofp i64 %i to float
+  %add = fadd float %mul, %conv
+  %pa = getelementptr inbounds float* %a, i64 %i
+  store float %add, float* %pa, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret i64 %i
+; CHECK: @test4
+; CHECK: %bound0 = icmp ult i8*
+; CHECK: %bound1 = icmp ult i8*
+; CHECK: %found.conflict = and i1 %bound0, %bound1
+; CHECK: br i1 {{.*}}, label %scalar.ph, label %vector.ph
+; CHECK: vector.body:
+; CHECK: %i.vec = add <4 x i64> %{{.*}}, <i64 0, i64 1, i64 2, i64 3>
+; CHECK: sitofp <4 x i64> %i.vec to <4 x float>
+; CHECK: fmul <4 x float>
+; CHECK: store <4 x float>
+; CHECK: middle.block:
+; CHECK: [[LAST:%.*]] = add i64 %n, -1
+; CHECK: for.end:
+; CHECK: phi i64 [ %i.lcssa{{.*}}, %scalar.exit ], [ [[LAST]], %middle.block ]
+}
+
+; Each iteration reads the element written by the one before, so this cannot
+; be vectorized.
+define void @test5(i32* %a, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pa = getelementptr inbounds i32* %a, i64 %i
+  %v = load i32* %pa, align 4
+  %i.next = add i64 %i, 1
+  %pa1 = getelementptr inbounds i32* %a, i64 %i.next
+  store i32 %v, i32* %pa1, align 4
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test5
+; CHECK-NOT: <4 x i32>
+; CHECK: ret void
+}
+
+; Accesses four elements apart are far enough for a width of four.
+define void @test6(i32* %a, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pa = getelementptr inbounds i32* %a, i64 %i
+  %v = load i32* %pa, align 4
+  %i.next = add i64 %i, 1
+  %j = add i64 %i, 4
+  %pa4 = getelementptr inbounds i32* %a, i64 %j
+  store i32 %v, i32* %pa4, align 4
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test6
+; CHECK-NOT: found.conflict
+; CHECK: load <4 x i32>
+; CHECK: store <4 x i32>
+; CHECK: ret void
+}
+
+declare i32 @f(i32)
+
+; Calls are not vectorized.
+define void @test7(i32* noalias %a, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pa = getelementptr inbounds i32* %a, i64 %i
+  %v = load i32* %pa, align 4
+  %c = call i32 @f(i32 %v)
+  store i32 %c, i32* %pa, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test7
+; CHECK-NOT: <4 x i32>
+; CHECK: ret void
+}
+
+; Loops that run fewer iterations than the vector width are left alone.
+define void @test8(i32* noalias %a) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pa = getelementptr inbounds i32* %a, i64 %i
+  store i32 0, i32* %pa, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, 3
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test8
+; CHECK-NOT: <4 x i32>
+; CHECK: ret void
+}
+
+; The vector loop adds up a reduction in a different order, so its chain
+; loses the wrap flags.  Other operations keep theirs.
+define i32 @test9(i32* %a, i32* %b, i64 %n) nounwind readonly {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %r = phi i32 [ 0, %entry ], [ %r.next, %for.body ]
+  %pa = getelementptr inbounds i32* %a, i64 %i
+  %va = load i32* %pa, align 4
+  %pb = getelementptr inbounds i32* %b, i64 %i
+  %vb = load i32* %pb, align 4
+  %t = add nsw i32 %va, 1
+  %s = add nsw i32 %r, %t
+  %r.next = add nuw nsw i32 %s, %vb
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret i32 %r.next
+; CHECK: @test9
+; CHECK: vector.body:
+; CHECK: add nsw <4 x i32> {{.*}}, <i32 1, i32 1, i32 1, i32 1>
+; CHECK-NOT: nsw
+; CHECK-NOT: nuw
+; CHECK: middle.block:
+}
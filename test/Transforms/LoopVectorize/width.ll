@@ -0,0 +1,73 @@
+; RUN: opt -basicaa -loop-vectorize -S < %s | FileCheck %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-apple-darwin10.0.0"
+
+; Without a target, the widest type in the loop fills a 128-bit register.
+define void @test1(i8* noalias %a, i8* noalias %b, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pb = getelementptr inbounds i8* %b, i64 %i
+  %vb = load i8* %pb, align 1
+  %s = shl i8 %vb, 1
+  %pa = getelementptr inbounds i8* %a, i64 %i
+  store i8 %s, i8* %pa, align 1
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test1
+; CHECK: shl <16 x i8>
+; CHECK: ret void
+}
+
+define void @test2(i32* noalias %a, i64* noalias %b, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pb = getelementptr inbounds i64* %b, i64 %i
+  %vb = load i64* %pb, align 8
+  %t = trunc i64 %vb to i32
+  %pa = getelementptr inbounds i32* %a, i64 %i
+  store i32 %t, i32* %pa, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test2
+; CHECK: load <2 x i64>* {{.*}}, align 8
+; CHECK: trunc <2 x i64> {{.*}} to <2 x i32>
+; CHECK: store <2 x i32> {{.*}}, align 4
+; CHECK: ret void
+}
+
+; Division has no vector form, so splitting it up costs more than the
+; vector loop saves.
+define void @test3(i32* noalias %a, i32 %d, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pa = getelementptr inbounds i32* %a, i64 %i
+  %v = load i32* %pa, align 4
+  %q = sdiv i32 %v, %d
+  store i32 %q, i32* %pa, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test3
+; CHECK-NOT: vector.body
+; CHECK: ret void
+}
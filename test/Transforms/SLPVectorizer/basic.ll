@@ -0,0 +1,128 @@
+; RUN: opt -basicaa -slp-vectorizer -S < %s | FileCheck %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-apple-darwin10.0.0"
+
+%struct.V = type { float, float, float, float }
+
+; a[0:3] = b[0:3] + c[0:3], written out one element at a time.
+define void @add4(i32* noalias %a, i32* noalias %b, i32* noalias %c) nounwind {
+entry:
+  %b0 = load i32* %b, align 4
+  %c0 = load i32* %c, align 4
+  %s0 = add nsw i32 %b0, %c0
+  store i32 %s0, i32* %a, align 4
+  %pb1 = getelementptr inbounds i32* %b, i64 1
+  %b1 = load i32* %pb1, align 4
+  %pc1 = getelementptr inbounds i32* %c, i64 1
+  %c1 = load i32* %pc1, align 4
+  %s1 = add nsw i32 %b1, %c1
+  %pa1 = getelementptr inbounds i32* %a, i64 1
+  store i32 %s1, i32* %pa1, align 4
+  %pb2 = getelementptr inbounds i32* %b, i64 2
+  %b2 = load i32* %pb2, align 4
+  %pc2 = getelementptr inbounds i32* %c, i64 2
+  %c2 = load i32* %pc2, align 4
+  %s2 = add nsw i32 %b2, %c2
+  %pa2 = getelementptr inbounds i32* %a, i64 2
+  store i32 %s2, i32* %pa2, align 4
+  %pb3 = getelementptr inbounds i32* %b, i64 3
+  %b3 = load i32* %pb3, align 4
+  %pc3 = getelementptr inbounds i32* %c, i64 3
+  %c3 = load i32* %pc3, align 4
+  %s3 = add nsw i32 %b3, %c3
+  %pa3 = getelementptr inbounds i32* %a, i64 3
+  store i32 %s3, i32* %pa3, align 4
+  ret void
+; CHECK: @add4
+; CHECK: load <4 x i32>* {{.*}}, align 4
+; CHECK: load <4 x i32>* {{.*}}, align 4
+; CHECK: add nsw <4 x i32>
+; CHECK: store <4 x i32> {{.*}}, align 4
+; CHECK-NOT: store i32
+; CHECK: ret void
+}
+
+; The fields of a struct, with a scalar used by every lane and two lanes used
+; after the stores.
+define float @scale(%struct.V* noalias %r, %struct.V* noalias %v, float %k) nounwind {
+entry:
+  %px = getelementptr inbounds %struct.V* %v, i64 0, i32 0
+  %x = load float* %px, align 4
+  %py = getelementptr inbounds %struct.V* %v, i64 0, i32 1
+  %y = load float* %py, align 4
+  %pz = getelementptr inbounds %struct.V* %v, i64 0, i32 2
+  %z = load float* %pz, align 4
+  %pw = getelementptr inbounds %struct.V* %v, i64 0, i32 3
+  %w = load float* %pw, align 4
+  %mx = fmul float %x, %k
+  %my = fmul float %y, %k
+  %mz = fmul float %z, %k
+  %mw = fmul float %w, %k
+  %rx = getelementptr inbounds %struct.V* %r, i64 0, i32 0
+  store float %mx, float* %rx, align 4
+  %ry = getelementptr inbounds %struct.V* %r, i64 0, i32 1
+  store float %my, float* %ry, align 4
+  %rz = getelementptr inbounds %struct.V* %r, i64 0, i32 2
+  store float %mz, float* %rz, align 4
+  %rw = getelementptr inbounds %struct.V* %r, i64 0, i32 3
+  store float %mw, float* %rw, align 4
+  %sum = fadd float %mx, %mw
+  ret float %sum
+; CHECK: @scale
+; CHECK: [[SPLAT:%.*]] = shufflevector <4 x float> {{.*}}, <4 x float> undef, <4 x i32> zeroinitializer
+; CHECK: [[V:%.*]] = load <4 x float>* {{.*}}, align 4
+; CHECK: [[M:%.*]] = fmul <4 x float> [[V]], [[SPLAT]]
+; CHECK: store <4 x float> [[M]]
+; CHECK: [[X:%.*]] = extractelement <4 x float> [[M]], i32 0
+; CHECK: [[W:%.*]] = extractelement <4 x float> [[M]], i32 3
+; CHECK: fadd float [[X]], [[W]]
+}
+
+; The second load may read what the first store wrote, so the stores cannot
+; move past it.
+define void @clobber(i32* %a, i32* %b) nounwind {
+entry:
+  %b0 = load i32* %b, align 4
+  store i32 %b0, i32* %a, align 4
+  %pb1 = getelementptr inbounds i32* %b, i64 1
+  %b1 = load i32* %pb1, align 4
+  %pa1 = getelementptr inbounds i32* %a, i64 1
+  store i32 %b1, i32* %pa1, align 4
+  ret void
+; CHECK: @clobber
+; CHECK-NOT: <2 x i32>
+; CHECK: ret void
+}
+
+; Constant stores become a constant vector.
+define void @zero(i16* %a) nounwind {
+entry:
+  store i16 0, i16* %a, align 2
+  %p1 = getelementptr inbounds i16* %a, i64 1
+  store i16 0, i16* %p1, align 2
+  %p2 = getelementptr inbounds i16* %a, i64 2
+  store i16 0, i16* %p2, align 2
+  %p3 = getelementptr inbounds i16* %a, i64 3
+  store i16 0, i16* %p3, align 2
+  ret void
+; CHECK: @zero
+; CHECK: store <4 x i16> zeroinitializer, <4 x i16>* {{.*}}, align 2
+; CHECK-NEXT: ret void
+}
+
+; Division has no vector form, so it is cheaper to leave this alone.
+define void @div(i32* noalias %a, i32* noalias %b, i32 %d) nounwind {
+entry:
+  %b0 = load i32* %b, align 4
+  %s0 = sdiv i32 %b0, %d
+  store i32 %s0, i32* %a, align 4
+  %pb1 = getelementptr inbounds i32* %b, i64 1
+  %b1 = load i32* %pb1, align 4
+  %s1 = sdiv i32 %b1, %d
+  %pa1 = getelementptr inbounds i32* %a, i64 1
+  store i32 %s1, i32* %pa1, align 4
+  ret void
+; CHECK: @div
+; CHECK-NOT: <2 x i32>
+; CHECK: ret void
+}
@@ -0,0 +1,55 @@
+; RUN: opt < %s -domtree -simplifycfg -verify-dom-info -verify-dom-updates -S | FileCheck %s
+
+; CFG simplification keeps an existing dominator tree up to date rather than
+; throwing it away.
+
+declare void @f1()
+declare void @f2()
+
+; The empty block %fwd is folded away and %dead goes with its only edge.
+; CHECK: @empty_and_dead
+; CHECK-NOT: fwd:
+; CHECK-NOT: dead:
+; CHECK: ret void
+define void @empty_and_dead(i1 %c) {
+entry:
+  br i1 %c, label %fwd, label %other
+
+fwd:
+  br label %exit
+
+other:
+  call void @f1()
+  br i1 false, label %dead, label %exit
+
+dead:
+  call void @f2()
+  br label %exit
+
+exit:
+  ret void
+}
+
+; The comparisons are folded into one range check, which erases %next and
+; makes the entry block dominate %b.
+; CHECK: @to_switch
+; CHECK: entry:
+; CHECK-NOT: next:
+; CHECK: br i1 %switch, label %a, label %b
+define void @to_switch(i32 %x) {
+entry:
+  %c1 = icmp eq i32 %x, 1
+  br i1 %c1, label %a, label %next
+
+next:
+  %c2 = icmp eq i32 %x, 2
+  br i1 %c2, label %a, label %b
+
+a:
+  call void @f1()
+  ret void
+
+b:
+  call void @f2()
+  ret void
+}
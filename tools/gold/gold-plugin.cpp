@@ -77,6 +77,8 @@ namespace options {
   static std::string extra_library_path;
   static std::string triple;
   static std::string mcpu;
+  // Compile each module on its own, caching the results in this directory.
+  static std::string cache_dir;
   // Additional options to pass into the code generator.
   // Note: This array will contain all plugin options which are not claimed
   // as plugin exclusive to pass to the code generator.
@@ -98,6 +100,8 @@ namespace options {
       extra_library_path = opt.substr(strlen("extra_library_path="));
     } else if (opt.startswith("mtriple=")) {
       triple = opt.substr(strlen("mtriple="));
+    } else if (opt.startswith("cache-dir=")) {
+      cache_dir = opt.substr(strlen("cache-dir="));
     } else if (opt.startswith("obj-path=")) {
       obj_path = opt.substr(strlen("obj-path="));
     } else if (opt == "emit-llvm") {
@@ -226,6 +230,12 @@ ld_plugin_status onload(ld_plugin_tv *tv) {
     return LDPS_ERR;
   }
 
+  if (code_gen && !options::cache_dir.empty() &&
+      lto_codegen_set_cache_dir(code_gen, options::cache_dir.c_str())) {
+    (*message)(LDPL_ERROR, "%s", lto_get_error_message());
+    return LDPS_ERR;
+  }
+
   return LDPS_OK;
 }
 
@@ -408,10 +418,16 @@ static ld_plugin_status all_symbols_read_hook(void) {
     if (options::generate_bc_file == options::BC_ONLY)
       exit(0);
   }
-  const char *objPath;
-  if (lto_codegen_compile_to_file(code_gen, &objPath)) {
+  // The merged module may be code generated into several object files (see
+  // -lto-partitions), or each module into one of its own with cache-dir, all
+  // of which go into the link.
+  const char **objNames = NULL;
+  unsigned numObjs = 0;
+  if (lto_codegen_compile_to_files(code_gen, &objNames, &numObjs)) {
     (*message)(LDPL_ERROR, "Could not produce a combined object file\n");
   }
+  // The names are owned by the code generator.
+  std::vector<std::string> objPaths(objNames, objNames + numObjs);
 
   lto_codegen_dispose(code_gen);
   for (std::list<claimed_file>::iterator I = Modules.begin(),
@@ -422,11 +438,12 @@ static ld_plugin_status all_symbols_read_hook(void) {
     }
   }
 
-  if ((*add_input_file)(objPath) != LDPS_OK) {
-    (*message)(LDPL_ERROR, "Unable to add .o file to the link.");
-    (*message)(LDPL_ERROR, "File left behind in: %s", objPath);
-    return LDPS_ERR;
-  }
+  for (unsigned i = 0, e = objPaths.size(); i != e; ++i)
+    if ((*add_input_file)(objPaths[i].c_str()) != LDPS_OK) {
+      (*message)(LDPL_ERROR, "Unable to add .o file to the link.");
+      (*message)(LDPL_ERROR, "File left behind in: %s", objPaths[i].c_str());
+      return LDPS_ERR;
+    }
 
   if (!options::extra_library_path.empty() &&
       set_extra_library_path(options::extra_library_path.c_str()) != LDPS_OK) {
@@ -435,7 +452,8 @@ static ld_plugin_status all_symbols_read_hook(void) {
   }
 
   if (options::obj_path.empty())
-    Cleanup.push_back(sys::Path(objPath));
+    for (unsigned i = 0, e = objPaths.size(); i != e; ++i)
+      Cleanup.push_back(sys::Path(objPaths[i]));
 
   return LDPS_OK;
 }
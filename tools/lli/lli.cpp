@@ -108,6 +108,12 @@ namespace {
   NoLazyCompilation("disable-lazy-compilation",
                   cl::desc("Disable JIT lazy compilation"),
                   cl::init(false));
+
+  cl::opt<bool>
+  SpeculativeCompilation("speculative-compilation",
+                  cl::desc("Compile functions on a background thread before "
+                           "their lazy stubs are called"),
+                  cl::init(false));
 }
 
 static ExecutionEngine *EE = 0;
@@ -202,6 +208,7 @@ int main(int argc, char **argv, char * const *envp) {
   EE->RegisterJITEventListener(createOProfileJITEventListener());
 
   EE->DisableLazyCompilation(NoLazyCompilation);
+  EE->EnableSpeculativeCompilation(SpeculativeCompilation);
 
   // If the user specifically requested an argv[0] to pass into the program,
   // do it now.
@@ -140,6 +140,14 @@ int main(int argc, char **argv) {
     }
   }
 
+  // Module-level metadata is read lazily as well; bring it in even if no
+  // function body was materialized above.
+  std::string ErrInfo;
+  if (M->MaterializeMetadata(&ErrInfo)) {
+    errs() << argv[0] << ": error reading input: " << ErrInfo << "\n";
+    return 1;
+  }
+
   // In addition to deleting all other functions, we also want to spiff it
   // up a little bit.  Do this now.
   PassManager Passes;
@@ -17,6 +17,7 @@
 #include "llvm/Module.h"
 #include "llvm/Analysis/Verifier.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/PrettyStackTrace.h"
@@ -50,7 +51,9 @@ static cl::opt<bool>
 DumpAsm("d", cl::desc("Print assembly as linked"), cl::Hidden);
 
 // LoadFile - Read the specified bitcode file in and return it.  This routine
-// searches the link path for the specified file to try to find it...
+// searches the link path for the specified file to try to find it...  Bitcode
+// function bodies are read lazily, so that the linker only reads the ones it
+// links in.
 //
 static inline std::auto_ptr<Module> LoadFile(const char *argv0,
                                              const std::string &FN, 
@@ -66,7 +69,7 @@ static inline std::auto_ptr<Module> LoadFile(const char *argv0,
   Module* Result = 0;
   
   const std::string &FNStr = Filename.str();
-  Result = ParseIRFile(FNStr, Err, Context);
+  Result = getLazyIRFileModule(FNStr, Err, Context);
   if (Result) return std::auto_ptr<Module>(Result);   // Load successful!
 
   Err.Print(argv0, errs());
@@ -93,21 +96,39 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  // The composite is what gets written out, so it has to be read in full.
+  if (Composite->MaterializeAllPermanently(&ErrorMessage)) {
+    errs() << argv[0] << ": error loading file '"
+           << InputFilenames[BaseArg] << "': " << ErrorMessage << "\n";
+    return 1;
+  }
+
+  // Load all of the other inputs and link them in together, so that symbols
+  // are resolved across all of them before any function bodies are read.
+  std::vector<Module*> Modules;
   for (unsigned i = BaseArg+1; i < InputFilenames.size(); ++i) {
     std::auto_ptr<Module> M(LoadFile(argv[0],
                                      InputFilenames[i], Context));
     if (M.get() == 0) {
       errs() << argv[0] << ": error loading file '" <<InputFilenames[i]<< "'\n";
+      DeleteContainerPointers(Modules);
       return 1;
     }
 
     if (Verbose) errs() << "Linking in '" << InputFilenames[i] << "'\n";
+    Modules.push_back(M.release());
+  }
 
-    if (Linker::LinkModules(Composite.get(), M.get(), &ErrorMessage)) {
-      errs() << argv[0] << ": link error in '" << InputFilenames[i]
-             << "': " << ErrorMessage << "\n";
-      return 1;
-    }
+  unsigned NumInputs = Modules.size(), FailedInput;
+  bool Failed = Linker::LinkModules(Composite.get(), Modules, &ErrorMessage,
+                                    &FailedInput);
+  DeleteContainerPointers(Modules);
+  if (Failed) {
+    errs() << argv[0] << ": link error";
+    if (FailedInput < NumInputs)
+      errs() << " in '" << InputFilenames[BaseArg+1+FailedInput] << "'";
+    errs() << ": " << ErrorMessage << "\n";
+    return 1;
   }
 
   // TODO: Iterate over the -l list and link in any modules containing
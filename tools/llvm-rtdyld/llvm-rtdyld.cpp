@@ -55,6 +55,7 @@ public:
   uint8_t *startFunctionBody(const char *Name, uintptr_t &Size);
   void endFunctionBody(const char *Name, uint8_t *FunctionStart,
                        uint8_t *FunctionEnd);
+  uint8_t *allocateSection(uintptr_t Size, unsigned Alignment);
 };
 
 uint8_t *TrivialMemoryManager::startFunctionBody(const char *Name,
@@ -69,6 +70,15 @@ void TrivialMemoryManager::endFunctionBody(const char *Name,
   FunctionMemory.push_back(sys::MemoryBlock(FunctionStart, Size));
 }
 
+uint8_t *TrivialMemoryManager::allocateSection(uintptr_t Size,
+                                               unsigned Alignment) {
+  // AllocateRWX hands back whole pages, which satisfies any section alignment
+  // we're going to see.
+  sys::MemoryBlock Block = sys::Memory::AllocateRWX(Size, 0, 0);
+  FunctionMemory.push_back(Block);
+  return (uint8_t*)Block.base();
+}
+
 static const char *ProgramName;
 
 static void Message(const char *Type, const Twine &Msg) {
@@ -104,7 +114,8 @@ static int executeInput() {
   }
 
   // Resolve all the relocations we can.
-  Dyld.resolveRelocations();
+  if (Dyld.resolveRelocations())
+    return Error(Dyld.getErrorString());
 
   // FIXME: Error out if there are unresolved relocations.
 
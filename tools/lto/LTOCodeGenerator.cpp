@@ -14,6 +14,7 @@
 
 #include "LTOModule.h"
 #include "LTOCodeGenerator.h"
+#include "LTOPartition.h"
 #include "llvm/Constants.h"
 #include "llvm/DerivedTypes.h"
 #include "llvm/Linker.h"
@@ -21,6 +22,7 @@
 #include "llvm/Module.h"
 #include "llvm/PassManager.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Bitcode/ReaderWriter.h"
@@ -33,18 +35,28 @@
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetRegistry.h"
 #include "llvm/Target/TargetSelect.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/CallSite.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PathV2.h"
 #include "llvm/Support/PassManagerBuilder.h"
 #include "llvm/Support/SystemUtils.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/system_error.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Config/config.h"
+#include <algorithm>
 #include <cstdlib>
+#include <map>
+#include <set>
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -54,6 +66,21 @@ using namespace llvm;
 static cl::opt<bool> DisableInline("disable-inlining",
   cl::desc("Do not run the inliner pass"));
 
+static cl::opt<unsigned> CodeGenPartitions("lto-partitions",
+  cl::desc("Number of partitions to code generate in parallel when "
+           "compiling to multiple object files, or of modules to code "
+           "generate at once when compiling incrementally"),
+  cl::init(1));
+
+static cl::opt<unsigned> ImportInstrLimit("lto-import-instr-limit",
+  cl::desc("Largest function, in instructions, that incremental LTO "
+           "imports into the modules that call it"),
+  cl::init(100));
+
+static cl::opt<unsigned> CacheSize("lto-cache-size",
+  cl::desc("Size limit of the incremental LTO cache, in megabytes"),
+  cl::init(1024));
+
 
 const char* LTOCodeGenerator::getVersionString()
 {
@@ -69,8 +96,8 @@ LTOCodeGenerator::LTOCodeGenerator()
     : _context(getGlobalContext()),
       _linker("LinkTimeOptimizer", "ld-temp.o", _context), _target(NULL),
       _emitDwarfDebugInfo(false), _scopeRestrictionsDone(false),
-      _codeModel(LTO_CODEGEN_PIC_MODEL_DYNAMIC),
-      _nativeObjectFile(NULL)
+      _modulesAdded(false),
+      _codeModel(LTO_CODEGEN_PIC_MODEL_DYNAMIC)
 {
     InitializeAllTargets();
     InitializeAllAsmPrinters();
@@ -79,18 +106,23 @@ LTOCodeGenerator::LTOCodeGenerator()
 LTOCodeGenerator::~LTOCodeGenerator()
 {
     delete _target;
-    delete _nativeObjectFile;
 }
 
 
 
 bool LTOCodeGenerator::addModule(LTOModule* mod, std::string& errMsg)
 {
+  _modulesAdded = true;
 
-  if(mod->getLLVVMModule()->MaterializeAllPermanently(&errMsg))
-    return true;
+  bool ret;
+  if ( !_cacheDir.empty() ) {
+    ret = this->summarizeModule(mod, errMsg);
+  } else {
+    if(mod->getLLVVMModule()->MaterializeAllPermanently(&errMsg))
+      return true;
 
-  bool ret = _linker.LinkInModule(mod->getLLVVMModule(), &errMsg);
+    ret = _linker.LinkInModule(mod->getLLVVMModule(), &errMsg);
+  }
 
   const std::vector<const char*> &undefs = mod->getAsmUndefinedRefs();
   for (int i = 0, e = undefs.size(); i != e; ++i)
@@ -135,6 +167,16 @@ void LTOCodeGenerator::setCpu(const char* mCpu)
   _mCpu = mCpu;
 }
 
+bool LTOCodeGenerator::setCacheDir(const char* path, std::string& errMsg)
+{
+  if ( _modulesAdded ) {
+    errMsg = "the cache directory must be set before any module is added";
+    return true;
+  }
+  _cacheDir = path;
+  return false;
+}
+
 void LTOCodeGenerator::addMustPreserveSymbol(const char* sym)
 {
     _mustPreserveSymbols[sym] = 1;
@@ -143,6 +185,10 @@ void LTOCodeGenerator::addMustPreserveSymbol(const char* sym)
 
 bool LTOCodeGenerator::writeMergedModules(const char *path,
                                           std::string &errMsg) {
+  if (!_cacheDir.empty()) {
+    errMsg = "modules are not merged when compiling incrementally";
+    return true;
+  }
   if (determineTarget(errMsg))
     return true;
 
@@ -209,29 +255,19 @@ bool LTOCodeGenerator::compile_to_file(const char** name, std::string& errMsg)
 
 const void* LTOCodeGenerator::compile(size_t* length, std::string& errMsg)
 {
-  const char *name;
-  if (compile_to_file(&name, errMsg))
-    return NULL;
-
-  // remove old buffer if compile() called twice
-  delete _nativeObjectFile;
-
-  // read .o file into memory buffer
-  OwningPtr<MemoryBuffer> BuffPtr;
-  if (error_code ec = MemoryBuffer::getFile(name, BuffPtr, -1, false)) {
-    errMsg = ec.message();
-    return NULL;
+  // remove old object if compile() called twice
+  _nativeObject.clear();
+
+  // generate the object straight into memory; the stream writes into the
+  // vector's storage, so the object is neither copied nor written to disk
+  {
+    raw_svector_ostream out(_nativeObject);
+    if ( this->generateObjectFile(out, errMsg) )
+      return NULL;
   }
-  _nativeObjectFile = BuffPtr.take();
 
-  // remove temp files
-  sys::Path(_nativeObjectPath).eraseFromDisk();
-
-  // return buffer, unless error
-  if ( _nativeObjectFile == NULL )
-    return NULL;
-  *length = _nativeObjectFile->getBufferSize();
-  return _nativeObjectFile->getBufferStart();
+  *length = _nativeObject.size();
+  return _nativeObject.data();
 }
 
 bool LTOCodeGenerator::determineTarget(std::string& errMsg)
@@ -263,8 +299,9 @@ bool LTOCodeGenerator::determineTarget(std::string& errMsg)
         // construct LTModule, hand over ownership of module and target
         SubtargetFeatures Features;
         Features.getDefaultSubtargetFeatures(_mCpu, llvm::Triple(Triple));
-        std::string FeatureStr = Features.getString();
-        _target = march->createTargetMachine(Triple, FeatureStr);
+        _targetTriple = Triple;
+        _targetFeatures = Features.getString();
+        _target = march->createTargetMachine(Triple, _targetFeatures);
     }
     return false;
 }
@@ -354,8 +391,7 @@ void LTOCodeGenerator::applyScopeRestrictions() {
 }
 
 /// Optimize merged modules using various IPO passes
-bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
-                                          std::string &errMsg) {
+bool LTOCodeGenerator::optimize(std::string &errMsg) {
     if ( this->determineTarget(errMsg) ) 
         return true;
 
@@ -384,36 +420,865 @@ bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
     // Make sure everything is still good.
     passes.add(createVerifierPass());
 
-    FunctionPassManager *codeGenPasses = new FunctionPassManager(mergedModule);
-
-    codeGenPasses->add(new TargetData(*_target->getTargetData()));
+    // Run our queue of passes all at once now, efficiently.
+    passes.run(*mergedModule);
+    return false;
+}
 
+/// emitObject - Run the code generator for target over the module, writing
+/// an object file to out.
+static bool emitObject(Module &M, TargetMachine &target, raw_ostream &out,
+                       std::string &errMsg) {
     formatted_raw_ostream Out(out);
 
-    if (_target->addPassesToEmitFile(*codeGenPasses, Out,
-                                     TargetMachine::CGFT_ObjectFile,
-                                     CodeGenOpt::Aggressive)) {
+    FunctionPassManager codeGenPasses(&M);
+
+    codeGenPasses.add(new TargetData(*target.getTargetData()));
+
+    if (target.addPassesToEmitFile(codeGenPasses, Out,
+                                   TargetMachine::CGFT_ObjectFile,
+                                   CodeGenOpt::Aggressive)) {
       errMsg = "target file type not supported";
       return true;
     }
 
-    // Run our queue of passes all at once now, efficiently.
-    passes.run(*mergedModule);
-
     // Run the code generator, and write assembly file
-    codeGenPasses->doInitialization();
+    codeGenPasses.doInitialization();
 
-    for (Module::iterator
-           it = mergedModule->begin(), e = mergedModule->end(); it != e; ++it)
+    for (Module::iterator it = M.begin(), e = M.end(); it != e; ++it)
       if (!it->isDeclaration())
-        codeGenPasses->run(*it);
+        codeGenPasses.run(*it);
 
-    codeGenPasses->doFinalization();
-    delete codeGenPasses;
+    codeGenPasses.doFinalization();
 
     return false; // success
 }
 
+/// emitObjectFile - Like emitObject, but writing the object to the file at
+/// path.
+static bool emitObjectFile(Module &M, TargetMachine &target,
+                           const std::string &path, std::string &errMsg) {
+  std::string errInfo;
+  raw_fd_ostream out(path.c_str(), errInfo, raw_fd_ostream::F_Binary);
+  if (!errInfo.empty()) {
+    errMsg = errInfo;
+    return true;
+  }
+  if (emitObject(M, target, out, errMsg))
+    return true;
+  out.close();
+  if (out.has_error()) {
+    out.clear_error();
+    errMsg = "could not write object file: " + path;
+    return true;
+  }
+  return false;
+}
+
+/// Optimize merged modules using various IPO passes, and generate code
+bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
+                                          std::string &errMsg) {
+    if ( !_cacheDir.empty() ) {
+        errMsg = "incremental compilation produces one object file per module";
+        return true;
+    }
+
+    if ( this->optimize(errMsg) )
+        return true;
+
+    return emitObject(*_linker.getModule(), *_target, out, errMsg);
+}
+
+namespace {
+  /// PartitionJob - The code generation of one partition of the merged
+  /// module.  Each job reads the module back from bitcode into a context of
+  /// its own, which is what lets the jobs run on separate threads.
+  struct PartitionJob {
+    const LTOPartitioning *partitioning;
+    unsigned               index;
+    StringRef              bitcode;
+    // The identifier of the merged module, which the object's file symbol
+    // is named after.
+    std::string            moduleName;
+    const Target          *march;
+    std::string            triple;
+    std::string            features;
+    std::string            path;
+    std::string            errMsg;
+    bool                   failed;
+
+    static void run(void *data);
+  };
+}
+
+void PartitionJob::run(void *data) {
+  PartitionJob &job = *static_cast<PartitionJob*>(data);
+  job.failed = true;
+
+  LLVMContext context;
+  MemoryBuffer *buffer = MemoryBuffer::getMemBuffer(job.bitcode,
+                                                    job.moduleName, false);
+  OwningPtr<Module> M(getLazyBitcodeModule(buffer, context, &job.errMsg));
+  if (!M) {
+    delete buffer;
+    return;
+  }
+  if (job.partitioning->extract(*M, job.index, job.errMsg))
+    return;
+
+  OwningPtr<TargetMachine> target(job.march->createTargetMachine(job.triple,
+                                                                 job.features));
+  job.failed = emitObjectFile(*M, *target, job.path, job.errMsg);
+}
+
+/// Generate code for the merged module into one or more object files.  The
+/// module is split into as many as -lto-partitions partitions, each of which
+/// is code generated on a thread of its own.
+bool LTOCodeGenerator::compile_to_files(const char*** names, unsigned* count,
+                                        std::string& errMsg)
+{
+  if ( !_cacheDir.empty() )
+    return this->compileIncrementally(names, count, errMsg);
+
+  if ( this->optimize(errMsg) )
+    return true;
+
+  Module* mergedModule = _linker.getModule();
+  LTOPartitioning partitioning;
+  partitioning.partition(*mergedModule, CodeGenPartitions);
+
+  // make unique temp .o files to put the generated object files in
+  std::vector<PartitionJob> jobs(partitioning.numPartitions);
+  for (unsigned i = 0, e = jobs.size(); i != e; ++i) {
+    sys::PathWithStatus uniqueObjPath("lto-llvm.o");
+    if ( uniqueObjPath.createTemporaryFileOnDisk(false, &errMsg) ) {
+      uniqueObjPath.eraseFromDisk();
+      for (unsigned j = 0; j != i; ++j)
+        sys::Path(jobs[j].path).eraseFromDisk();
+      return true;
+    }
+    sys::RemoveFileOnSignal(uniqueObjPath);
+    jobs[i].path = uniqueObjPath.str();
+  }
+
+  bool failed = false;
+  if (jobs.size() == 1) {
+    failed = emitObjectFile(*mergedModule, *_target, jobs[0].path, errMsg);
+  } else {
+    std::string bitcode;
+    raw_string_ostream bitcodeStream(bitcode);
+    WriteBitcodeToFile(mergedModule, bitcodeStream);
+    bitcodeStream.flush();
+
+    std::vector<void*> jobData;
+    for (unsigned i = 0, e = jobs.size(); i != e; ++i) {
+      jobs[i].partitioning = &partitioning;
+      jobs[i].index = i;
+      jobs[i].bitcode = bitcode;
+      jobs[i].moduleName = mergedModule->getModuleIdentifier();
+      jobs[i].march = &_target->getTarget();
+      jobs[i].triple = _targetTriple;
+      jobs[i].features = _targetFeatures;
+      jobData.push_back(&jobs[i]);
+    }
+
+    // The jobs share pass registration and other global state, which is only
+    // locked in multithreaded mode; without it, run them one after another.
+    bool startedThreads = false;
+    if (!llvm_is_multithreaded())
+      startedThreads = llvm_start_multithreaded();
+    if (llvm_is_multithreaded())
+      llvm_execute_on_threads(PartitionJob::run, &jobData[0], jobData.size());
+    else
+      for (unsigned i = 0, e = jobData.size(); i != e; ++i)
+        PartitionJob::run(jobData[i]);
+    if (startedThreads)
+      llvm_stop_multithreaded();
+
+    for (unsigned i = 0, e = jobs.size(); i != e && !failed; ++i)
+      if (jobs[i].failed) {
+        errMsg = jobs[i].errMsg;
+        failed = true;
+      }
+  }
+
+  if (failed) {
+    for (unsigned i = 0, e = jobs.size(); i != e; ++i)
+      sys::Path(jobs[i].path).eraseFromDisk();
+    return true;
+  }
+
+  _nativeObjectPaths.clear();
+  _nativeObjectNames.clear();
+  for (unsigned i = 0, e = jobs.size(); i != e; ++i)
+    _nativeObjectPaths.push_back(jobs[i].path);
+  for (unsigned i = 0, e = jobs.size(); i != e; ++i)
+    _nativeObjectNames.push_back(_nativeObjectPaths[i].c_str());
+  *names = &_nativeObjectNames[0];
+  *count = _nativeObjectNames.size();
+  return false;
+}
+
+
+/// hashBytes - Hash data with FNV-1a, which is good enough to name cache
+/// entries.
+static uint64_t hashBytes(StringRef data,
+                          uint64_t hash = 14695981039346656037ULL) {
+  for (size_t i = 0, e = data.size(); i != e; ++i) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/// createCacheTemp - Create a temporary file in the cache directory dir.
+/// Cache entries are written to a temporary file first and then renamed into
+/// place, so that concurrent links never see a partly written entry.
+static bool createCacheTemp(const std::string &dir, int &fd, std::string &path,
+                            std::string &errMsg) {
+  SmallString<128> tmpPath;
+  if (error_code ec = sys::fs::unique_file(dir + "/lto-%%%%%%%%.tmp", fd,
+                                           tmpPath)) {
+    errMsg = "could not create a file in " + dir + ": " + ec.message();
+    return true;
+  }
+  path = tmpPath.str();
+  return false;
+}
+
+/// markUsed - Bring the modification time of the cache file at path up to
+/// date, which is what the cache is pruned by.
+static void markUsed(const std::string &path) {
+  sys::PathWithStatus file(path);
+  if (const sys::FileStatus *status = file.getFileStatus()) {
+    sys::FileStatus newStatus = *status;
+    newStatus.modTime = sys::TimeValue::now();
+    file.setStatusInfoOnDisk(newStatus);
+  }
+}
+
+/// isCached - Return true if the cache holds the object at objPath and it was
+/// built for key, as recorded in the file at keyPath.
+static bool isCached(const std::string &objPath, const std::string &keyPath,
+                     StringRef key) {
+  bool exists;
+  if (sys::fs::exists(objPath, exists) || !exists)
+    return false;
+  OwningPtr<MemoryBuffer> buffer;
+  if (MemoryBuffer::getFile(keyPath, buffer) || buffer->getBuffer() != key)
+    return false;
+  markUsed(objPath);
+  return true;
+}
+
+namespace {
+  /// CacheEntry - The files in the cache named after the same hash: an
+  /// object file and its key, or a module summary.
+  struct CacheEntry {
+    sys::TimeValue         lastUsed;
+    uint64_t               size;
+    std::vector<sys::Path> files;
+
+    CacheEntry() : lastUsed(sys::TimeValue::MinTime), size(0) {}
+  };
+}
+
+/// pruneCache - Remove the least recently used entries from the cache in dir
+/// until it fits in maxSize bytes.  The entries named in inUse are the ones
+/// of the current link and are kept whatever their size.  Temporary files
+/// are left alone, as other links may still be writing them.
+static void pruneCache(const std::string &dir, uint64_t maxSize,
+                       const std::set<std::string> &inUse) {
+  std::set<sys::Path> contents;
+  if (sys::Path(dir).getDirectoryContents(contents, 0))
+    return;
+
+  std::map<std::string, CacheEntry> entries;
+  uint64_t totalSize = 0;
+  for (std::set<sys::Path>::iterator I = contents.begin(), E = contents.end();
+       I != E; ++I) {
+    StringRef name = I->getLast();
+    StringRef ext = sys::path::extension(name);
+    if (ext != ".o" && ext != ".key" && ext != ".summary")
+      continue;
+    sys::PathWithStatus file(*I);
+    const sys::FileStatus *status = file.getFileStatus();
+    if (!status || status->isDir)
+      continue;
+    CacheEntry &entry = entries[sys::path::stem(name)];
+    if (entry.lastUsed < status->modTime)
+      entry.lastUsed = status->modTime;
+    entry.size += status->fileSize;
+    entry.files.push_back(*I);
+    totalSize += status->fileSize;
+  }
+
+  if (totalSize <= maxSize)
+    return;
+
+  std::vector<std::pair<sys::TimeValue, std::string> > byAge;
+  for (std::map<std::string, CacheEntry>::iterator I = entries.begin(),
+       E = entries.end(); I != E; ++I)
+    if (!inUse.count(I->first))
+      byAge.push_back(std::make_pair(I->second.lastUsed, I->first));
+  std::sort(byAge.begin(), byAge.end());
+
+  for (unsigned i = 0, e = byAge.size(); i != e && totalSize > maxSize; ++i) {
+    CacheEntry &entry = entries[byAge[i].second];
+    for (unsigned f = 0, fe = entry.files.size(); f != fe; ++f)
+      entry.files[f].eraseFromDisk();
+    totalSize -= entry.size;
+  }
+}
+
+std::string LTOCodeGenerator::getCachePath(uint64_t hash, const char* suffix)
+{
+  return _cacheDir + "/" + utohexstr(hash) + suffix;
+}
+
+/// Record the bitcode of a module compiled incrementally, and its summary.
+/// The summary is read from the cache when this bitcode has been seen before,
+/// so that the module's function bodies don't have to be read in.
+bool LTOCodeGenerator::summarizeModule(LTOModule* mod, std::string& errMsg)
+{
+  Module *M = mod->getLLVVMModule();
+  if (!M->getMaterializer()) {
+    errMsg = "module has already been read in";
+    return true;
+  }
+
+  // The linker's module is never code generated in this mode, it just
+  // supplies the target triple.
+  Module *linkerModule = _linker.getModule();
+  if (linkerModule->getTargetTriple().empty())
+    linkerModule->setTargetTriple(M->getTargetTriple());
+
+  StringRef bitcode = mod->getBitcode();
+  _moduleBitcode.push_back(std::string());
+  _moduleBitcode.back().assign(bitcode.data(), bitcode.size());
+  _moduleSummaries.push_back(LTOModuleSummary());
+  LTOModuleSummary &summary = _moduleSummaries.back();
+  summary.hash = hashBytes(bitcode);
+
+  std::string summaryPath = getCachePath(summary.hash, ".summary");
+  OwningPtr<MemoryBuffer> buffer;
+  if (!MemoryBuffer::getFile(summaryPath, buffer) &&
+      !summary.read(buffer->getBuffer())) {
+    markUsed(summaryPath);
+    return false;
+  }
+
+  if (M->MaterializeAllPermanently(&errMsg))
+    return true;
+  summary.compute(*M);
+
+  // Caching the summary is best effort: without it, the next link has to
+  // read the module in again.
+  bool existed;
+  int fd;
+  std::string tmpPath, tmpErrMsg;
+  if (sys::fs::create_directories(_cacheDir, existed) ||
+      createCacheTemp(_cacheDir, fd, tmpPath, tmpErrMsg))
+    return false;
+  bool written;
+  {
+    raw_fd_ostream out(fd, /*shouldClose=*/true);
+    written = !summary.write(out);
+    out.close();
+    if (out.has_error()) {
+      out.clear_error();
+      written = false;
+    }
+  }
+  if (!written || sys::fs::rename(tmpPath, summaryPath))
+    sys::Path(tmpPath).eraseFromDisk();
+  return false;
+}
+
+/// makeDeclaration - Turn the definition of GV into a declaration.  An alias
+/// can't be a declaration, so it is replaced by a declaration of what it
+/// aliases.
+static void makeDeclaration(GlobalValue *GV) {
+  if (Function *F = dyn_cast<Function>(GV)) {
+    F->deleteBody();
+  } else if (GlobalVariable *Var = dyn_cast<GlobalVariable>(GV)) {
+    Var->setInitializer(0);
+    Var->setLinkage(GlobalValue::ExternalLinkage);
+  } else {
+    GlobalAlias *GA = cast<GlobalAlias>(GV);
+    const PointerType *Ty = GA->getType();
+    GlobalValue *Decl;
+    if (const FunctionType *FTy = dyn_cast<FunctionType>(Ty->getElementType()))
+      Decl = Function::Create(FTy, GlobalValue::ExternalLinkage, "",
+                              GA->getParent());
+    else
+      Decl = new GlobalVariable(*GA->getParent(), Ty->getElementType(), false,
+                                GlobalValue::ExternalLinkage, 0, "", 0, false,
+                                Ty->getAddressSpace());
+    Decl->takeName(GA);
+    Decl->setVisibility(GA->getVisibility());
+    GA->replaceAllUsesWith(Decl);
+    GA->eraseFromParent();
+  }
+}
+
+/// collectGlobals - Add the global values C refers to, looking through
+/// constant expressions, to globals.
+static void collectGlobals(Constant *C, SmallPtrSet<GlobalValue*, 16> &globals,
+                           SmallPtrSet<Constant*, 16> &visited) {
+  if (GlobalValue *GV = dyn_cast<GlobalValue>(C)) {
+    globals.insert(GV);
+    return;
+  }
+  if (!visited.insert(C))
+    return;
+  for (User::op_iterator I = C->op_begin(), E = C->op_end(); I != E; ++I)
+    collectGlobals(cast<Constant>(*I), globals, visited);
+}
+
+/// importFunction - Give M an available_externally copy of the function
+/// name defined in Src, a module in the same context, so that it can be
+/// inlined.  The globals the body refers to are mapped to the globals of the
+/// same name in M, which are declared if M doesn't have them yet.  Returns
+/// true on error; a function that can't be imported is left alone.
+static bool importFunction(Module &M, Module &Src, StringRef name,
+                           std::string &errMsg) {
+  Function *DF = M.getFunction(name);
+  Function *SF = Src.getFunction(name);
+  if (!DF || !DF->isDeclaration() || !SF || DF->getType() != SF->getType())
+    return false;
+  if (SF->Materialize(&errMsg))
+    return true;
+
+  SmallPtrSet<GlobalValue*, 16> globals;
+  SmallPtrSet<Constant*, 16> visited;
+  for (Function::iterator BB = SF->begin(), E = SF->end(); BB != E; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      for (User::op_iterator OI = I->op_begin(), OE = I->op_end();
+           OI != OE; ++OI)
+        if (Constant *C = dyn_cast<Constant>(*OI))
+          collectGlobals(C, globals, visited);
+
+  // A local symbol of M can't stand in for a global symbol of Src.
+  for (SmallPtrSet<GlobalValue*, 16>::iterator I = globals.begin(),
+       E = globals.end(); I != E; ++I)
+    if (GlobalValue *DGV = M.getNamedValue((*I)->getName()))
+      if (DGV->hasLocalLinkage())
+        return false;
+
+  ValueToValueMapTy VMap;
+  VMap[SF] = DF;
+  for (SmallPtrSet<GlobalValue*, 16>::iterator I = globals.begin(),
+       E = globals.end(); I != E; ++I) {
+    GlobalValue *SGV = *I;
+    GlobalValue *DGV = M.getNamedValue(SGV->getName());
+    if (!DGV) {
+      const PointerType *Ty = SGV->getType();
+      if (Function *F = dyn_cast<Function>(SGV)) {
+        Function *NF = Function::Create(F->getFunctionType(),
+                                        GlobalValue::ExternalLinkage,
+                                        F->getName(), &M);
+        NF->setCallingConv(F->getCallingConv());
+        NF->setAttributes(F->getAttributes());
+        DGV = NF;
+      } else {
+        GlobalVariable *Var = dyn_cast<GlobalVariable>(SGV);
+        DGV = new GlobalVariable(M, Ty->getElementType(),
+                                 Var && Var->isConstant(),
+                                 GlobalValue::ExternalLinkage, 0,
+                                 SGV->getName(), 0,
+                                 Var && Var->isThreadLocal(),
+                                 Ty->getAddressSpace());
+      }
+      DGV->setVisibility(SGV->getVisibility());
+    }
+    if (DGV->getType() != SGV->getType())
+      VMap[SGV] = ConstantExpr::getBitCast(DGV, SGV->getType());
+    else
+      VMap[SGV] = DGV;
+  }
+
+  Function::arg_iterator DA = DF->arg_begin();
+  for (Function::arg_iterator A = SF->arg_begin(), AE = SF->arg_end();
+       A != AE; ++A, ++DA) {
+    DA->setName(A->getName());
+    VMap[A] = DA;
+  }
+
+  SmallVector<ReturnInst*, 8> returns;
+  CloneFunctionInto(DF, SF, VMap, /*ModuleLevelChanges=*/true, returns);
+  DF->setLinkage(GlobalValue::AvailableExternallyLinkage);
+  return false;
+}
+
+namespace {
+  /// ModuleJob - The code generation of one module compiled incrementally.
+  /// Like a PartitionJob, it reads the module into a context of its own, so
+  /// that modules can be compiled on several threads at once.
+  struct ModuleJob {
+    // The bitcode of all the modules.
+    const std::vector<std::string> *bitcode;
+    unsigned               index;
+    // The definitions that stay visible outside the module, sorted.
+    std::vector<std::string> exported;
+    // The definitions that are overridden by those of other modules.
+    std::vector<std::string> dropped;
+    // The functions imported from other modules, as the index of the module
+    // and the name of the function, sorted.
+    std::vector<std::pair<unsigned, std::string> > imports;
+    // The name the module is read in under, which the object's file symbol
+    // is named after.
+    std::string            moduleName;
+    const Target          *march;
+    std::string            triple;
+    std::string            features;
+    std::string            cachePath;
+    // The cache key of the object, and the file it is stored in.
+    std::string            key;
+    std::string            keyPath;
+    std::string            errMsg;
+    bool                   failed;
+
+    bool compile(std::string &tmpPath);
+    static void run(void *data);
+  };
+
+  /// ModuleJobQueue - The jobs left to do, which each of the threads takes
+  /// from in turn.
+  struct ModuleJobQueue {
+    std::vector<ModuleJob*> jobs;
+    volatile sys::cas_flag  next;
+
+    static void run(void *data);
+  };
+}
+
+/// readModule - Read bitcode lazily into context, as a module named name.
+static Module *readModule(const std::string &bitcode, StringRef name,
+                          LLVMContext &context, std::string &errMsg) {
+  MemoryBuffer *buffer = MemoryBuffer::getMemBuffer(bitcode, name, false);
+  Module *M = getLazyBitcodeModule(buffer, context, &errMsg);
+  if (!M)
+    delete buffer;
+  return M;
+}
+
+bool ModuleJob::compile(std::string &tmpPath) {
+  LLVMContext context;
+  OwningPtr<Module> M(readModule((*bitcode)[index], moduleName, context,
+                                 errMsg));
+  if (!M || M->MaterializeAllPermanently(&errMsg))
+    return true;
+  M->setTargetTriple(triple);
+
+  // The definitions that don't prevail are dropped, except that the ones
+  // that are the same everywhere are kept for inlining.
+  for (unsigned i = 0, e = dropped.size(); i != e; ++i) {
+    GlobalValue *GV = M->getNamedValue(dropped[i]);
+    if (!GV)
+      continue;
+    if (isa<Function>(GV) &&
+        (GV->getLinkage() == GlobalValue::LinkOnceODRLinkage ||
+         GV->getLinkage() == GlobalValue::WeakODRLinkage))
+      GV->setLinkage(GlobalValue::AvailableExternallyLinkage);
+    else
+      makeDeclaration(GV);
+  }
+
+  // Import the functions of other modules it calls, reading in only their
+  // bodies.
+  for (unsigned i = 0, e = imports.size(); i != e; ) {
+    unsigned source = imports[i].first;
+    OwningPtr<Module> Src(readModule((*bitcode)[source], moduleName, context,
+                                     errMsg));
+    if (!Src)
+      return true;
+    for (; i != e && imports[i].first == source; ++i)
+      if (importFunction(*M, *Src, imports[i].second, errMsg))
+        return true;
+  }
+
+  OwningPtr<TargetMachine> target(march->createTargetMachine(triple,
+                                                             features));
+
+  // Everything that no other module refers to is internalized, and then
+  // the module is optimized as if it was the merged module.
+  std::vector<const char*> exportList;
+  for (unsigned i = 0, e = exported.size(); i != e; ++i)
+    exportList.push_back(exported[i].c_str());
+
+  PassManager passes;
+  passes.add(createVerifierPass());
+  passes.add(new TargetData(*target->getTargetData()));
+  passes.add(createInternalizePass(exportList));
+  PassManagerBuilder().populateLTOPassManager(passes, /*Internalize=*/ false,
+                                              !DisableInline);
+  passes.add(createVerifierPass());
+  passes.run(*M);
+
+  int fd;
+  if (createCacheTemp(sys::path::parent_path(cachePath), fd, tmpPath, errMsg))
+    return true;
+  ::close(fd);
+  if (emitObjectFile(*M, *target, tmpPath, errMsg))
+    return true;
+
+  // The old key goes first, so that the entry never pairs this object with
+  // the key of the one it replaces.
+  bool existed;
+  sys::fs::remove(keyPath, existed);
+  if (error_code ec = sys::fs::rename(tmpPath, cachePath)) {
+    errMsg = "could not write " + cachePath + ": " + ec.message();
+    return true;
+  }
+  tmpPath.clear();
+
+  // Storing the key is best effort: without it, the next link compiles the
+  // module again.
+  std::string keyTmpPath, keyErrMsg;
+  if (createCacheTemp(sys::path::parent_path(keyPath), fd, keyTmpPath,
+                      keyErrMsg))
+    return false;
+  bool written;
+  {
+    raw_fd_ostream out(fd, /*shouldClose=*/true);
+    out << key;
+    out.close();
+    written = !out.has_error();
+    out.clear_error();
+  }
+  if (!written || sys::fs::rename(keyTmpPath, keyPath))
+    sys::Path(keyTmpPath).eraseFromDisk();
+  return false;
+}
+
+void ModuleJob::run(void *data) {
+  ModuleJob &job = *static_cast<ModuleJob*>(data);
+  std::string tmpPath;
+  job.failed = job.compile(tmpPath);
+  if (!tmpPath.empty())
+    sys::Path(tmpPath).eraseFromDisk();
+}
+
+void ModuleJobQueue::run(void *data) {
+  ModuleJobQueue &queue = *static_cast<ModuleJobQueue*>(data);
+  for (;;) {
+    unsigned i = sys::AtomicIncrement(&queue.next) - 1;
+    if (i >= queue.jobs.size())
+      return;
+    ModuleJob::run(queue.jobs[i]);
+  }
+}
+
+/// Generate code for each module into an object file of its own, after
+/// internalizing what the other modules don't use and importing the small
+/// functions it calls from them.  The analysis this needs only looks at the
+/// module summaries, and the object files are cached, keyed by everything
+/// that goes into them, so that a module is only compiled again when it or
+/// a module it imports from has changed.
+bool LTOCodeGenerator::compileIncrementally(const char*** names,
+                                            unsigned* count,
+                                            std::string& errMsg)
+{
+  if ( this->determineTarget(errMsg) )
+    return true;
+
+  // if options were requested, set them
+  if ( !_codegenOptions.empty() )
+    cl::ParseCommandLineOptions(_codegenOptions.size(),
+                                const_cast<char **>(&_codegenOptions[0]));
+
+  bool existed;
+  if (error_code ec = sys::fs::create_directories(_cacheDir, existed)) {
+    errMsg = "could not create cache directory " + _cacheDir + ": " +
+             ec.message();
+    return true;
+  }
+
+  typedef LTOModuleSummary::Definition Definition;
+  typedef LTOModuleSummary::ModuleAndDefinition ModuleAndDefinition;
+  unsigned numModules = _moduleSummaries.size();
+
+  StringMap<ModuleAndDefinition> prevailing;
+  if (LTOModuleSummary::findPrevailing(_moduleSummaries, prevailing, errMsg))
+    return true;
+
+  std::vector<ModuleJob> jobs(numModules);
+
+  // The symbols the linker is asked to keep, and the ones module level
+  // assembly refers to, stay visible.
+  MCContext Context(*_target->getMCAsmInfo(), NULL);
+  Mangler mangler(Context, *_target->getTargetData());
+  for (StringMap<ModuleAndDefinition>::iterator I = prevailing.begin(),
+       E = prevailing.end(); I != E; ++I) {
+    SmallString<64> Buffer;
+    mangler.getNameWithPrefix(Buffer, I->getKey());
+    if (_mustPreserveSymbols.count(Buffer) || _asmUndefinedRefs.count(Buffer))
+      jobs[I->getValue().first].exported.push_back(I->getKey());
+  }
+
+  for (unsigned i = 0; i != numModules; ++i) {
+    const LTOModuleSummary &summary = _moduleSummaries[i];
+
+    // A definition other modules refer to stays visible, as does one that is
+    // overridden in this module.
+    for (unsigned r = 0, re = summary.references.size(); r != re; ++r) {
+      StringMap<ModuleAndDefinition>::iterator P =
+        prevailing.find(summary.references[r]);
+      if (P != prevailing.end() && P->getValue().first != i)
+        jobs[P->getValue().first].exported.push_back(P->getKey());
+    }
+
+    for (unsigned d = 0, de = summary.definitions.size(); d != de; ++d) {
+      const Definition &D = summary.definitions[d];
+      if (D.common)
+        jobs[i].exported.push_back(D.name);
+      else if (prevailing[D.name].first != i)
+        jobs[i].dropped.push_back(D.name);
+    }
+
+    // Import the small functions it calls.  What their bodies refer to
+    // becomes visible in the module that defines it.
+    for (unsigned c = 0, ce = summary.calls.size(); c != ce; ++c) {
+      StringMap<ModuleAndDefinition>::iterator P =
+        prevailing.find(summary.calls[c]);
+      if (P == prevailing.end() || P->getValue().first == i)
+        continue;
+      const Definition &D = *P->getValue().second;
+      if (!D.importable || D.size > ImportInstrLimit)
+        continue;
+      jobs[i].imports.push_back(std::make_pair(P->getValue().first, D.name));
+      for (unsigned r = 0, re = D.refs.size(); r != re; ++r) {
+        StringMap<ModuleAndDefinition>::iterator RP = prevailing.find(D.refs[r]);
+        if (RP != prevailing.end() && RP->getValue().first != i)
+          jobs[RP->getValue().first].exported.push_back(RP->getKey());
+      }
+    }
+  }
+
+  // Key each object file by everything that goes into it.
+  std::string options;
+  raw_string_ostream optionsStream(options);
+  optionsStream << getVersionString() << '\0' << _targetTriple << '\0'
+                << _targetFeatures << '\0' << _mCpu << '\0' << _codeModel
+                << '\0' << unsigned(_emitDwarfDebugInfo) << '\0'
+                << unsigned(DisableInline) << '\0' << unsigned(ImportInstrLimit)
+                << '\0';
+  for (unsigned i = 0, e = _codegenOptions.size(); i != e; ++i)
+    optionsStream << _codegenOptions[i] << '\0';
+  optionsStream.flush();
+  uint64_t optionsHash = hashBytes(options);
+
+  ModuleJobQueue queue;
+  queue.next = 0;
+  for (unsigned i = 0; i != numModules; ++i) {
+    ModuleJob &job = jobs[i];
+    std::sort(job.exported.begin(), job.exported.end());
+    job.exported.erase(std::unique(job.exported.begin(), job.exported.end()),
+                       job.exported.end());
+    std::sort(job.imports.begin(), job.imports.end());
+
+    // The bitcode of a module is identified by its hash and size.
+    std::string key;
+    raw_string_ostream keyStream(key);
+    keyStream << _moduleSummaries[i].hash << ' ' << _moduleBitcode[i].size()
+              << '\0';
+    for (unsigned e = 0, ee = job.exported.size(); e != ee; ++e)
+      keyStream << 'e' << job.exported[e] << '\0';
+    for (unsigned d = 0, de = job.dropped.size(); d != de; ++d)
+      keyStream << 'd' << job.dropped[d] << '\0';
+    for (unsigned m = 0, me = job.imports.size(); m != me; ++m)
+      keyStream << 'i' << _moduleSummaries[job.imports[m].first].hash << ' '
+                << _moduleBitcode[job.imports[m].first].size() << ' '
+                << job.imports[m].second << '\0';
+    keyStream.flush();
+
+    // The hash of the key names the cache entry, and the key itself is
+    // stored next to the object so that a collision is a miss.
+    uint64_t keyHash = hashBytes(key, optionsHash);
+
+    job.bitcode = &_moduleBitcode;
+    job.index = i;
+    job.moduleName = _linker.getModule()->getModuleIdentifier();
+    job.march = &_target->getTarget();
+    job.triple = _targetTriple;
+    job.features = _targetFeatures;
+    job.cachePath = getCachePath(keyHash, ".o");
+    job.keyPath = getCachePath(keyHash, ".key");
+    job.key = options + key;
+    job.failed = false;
+    if (!isCached(job.cachePath, job.keyPath, job.key))
+      queue.jobs.push_back(&job);
+  }
+
+  // The jobs share pass registration and other global state, which is only
+  // locked in multithreaded mode; without it, run them one after another.
+  if (!queue.jobs.empty()) {
+    unsigned numThreads = CodeGenPartitions;
+    numThreads = std::max(1U, std::min<unsigned>(numThreads,
+                                                 queue.jobs.size()));
+    bool startedThreads = false;
+    if (numThreads > 1 && !llvm_is_multithreaded())
+      startedThreads = llvm_start_multithreaded();
+    if (numThreads > 1 && llvm_is_multithreaded()) {
+      std::vector<void*> threadData(numThreads, &queue);
+      llvm_execute_on_threads(ModuleJobQueue::run, &threadData[0],
+                              threadData.size());
+    } else {
+      ModuleJobQueue::run(&queue);
+    }
+    if (startedThreads)
+      llvm_stop_multithreaded();
+  }
+
+  for (unsigned i = 0; i != numModules; ++i)
+    if (jobs[i].failed) {
+      errMsg = jobs[i].errMsg;
+      return true;
+    }
+
+  // Hand out links to the cached object files, which the caller is free to
+  // delete.  Copy them where links aren't possible.
+  std::vector<std::string> paths;
+  for (unsigned i = 0; i != numModules; ++i) {
+    sys::PathWithStatus uniqueObjPath("lto-llvm.o");
+    bool failed = uniqueObjPath.createTemporaryFileOnDisk(false, &errMsg);
+    if (!failed) {
+      sys::RemoveFileOnSignal(uniqueObjPath);
+      paths.push_back(uniqueObjPath.str());
+      uniqueObjPath.eraseFromDisk();
+      if (sys::fs::create_hard_link(jobs[i].cachePath, paths.back()))
+        if (error_code ec = sys::fs::copy_file(jobs[i].cachePath,
+                                               paths.back())) {
+          errMsg = "could not copy " + jobs[i].cachePath + ": " + ec.message();
+          failed = true;
+        }
+    }
+    if (failed) {
+      for (unsigned j = 0, je = paths.size(); j != je; ++j)
+        sys::Path(paths[j]).eraseFromDisk();
+      return true;
+    }
+  }
+
+  // Now that the caller has its own links to the objects, make room in the
+  // cache, keeping the entries of this link.
+  std::set<std::string> inUse;
+  for (unsigned i = 0; i != numModules; ++i) {
+    inUse.insert(sys::path::stem(jobs[i].cachePath));
+    inUse.insert(utohexstr(_moduleSummaries[i].hash));
+  }
+  pruneCache(_cacheDir, (uint64_t)CacheSize << 20, inUse);
+
+  _nativeObjectPaths.swap(paths);
+  _nativeObjectNames.clear();
+  for (unsigned i = 0; i != numModules; ++i)
+    _nativeObjectNames.push_back(_nativeObjectPaths[i].c_str());
+  *names = numModules ? &_nativeObjectNames[0] : NULL;
+  *count = numModules;
+  return false;
+}
+
 
 /// Optimize merged modules using various IPO passes
 void LTOCodeGenerator::setCodeGenDebugOptions(const char* options)
@@ -20,6 +20,7 @@
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "LTOSummary.h"
 
 #include <string>
 
@@ -38,13 +39,23 @@ struct LTOCodeGenerator {
     bool                setDebugInfo(lto_debug_model, std::string& errMsg);
     bool                setCodePICModel(lto_codegen_model, std::string& errMsg);
     void                setCpu(const char *cpu);
+    bool                setCacheDir(const char* path, std::string& errMsg);
     void                addMustPreserveSymbol(const char* sym);
     bool                writeMergedModules(const char* path, 
                                                            std::string& errMsg);
     bool                compile_to_file(const char** name, std::string& errMsg);
     const void*         compile(size_t* length, std::string& errMsg);
+    bool                compile_to_files(const char*** names, unsigned* count,
+                                         std::string& errMsg);
     void                setCodeGenDebugOptions(const char *opts); 
 private:
+    bool                optimize(std::string& errMsg);
+    bool                summarizeModule(struct LTOModule*,
+                                        std::string& errMsg);
+    bool                compileIncrementally(const char*** names,
+                                             unsigned* count,
+                                             std::string& errMsg);
+    std::string         getCachePath(uint64_t hash, const char* suffix);
     bool                generateObjectFile(llvm::raw_ostream& out, 
                                            std::string& errMsg);
     void                applyScopeRestrictions();
@@ -61,13 +72,21 @@ private:
     llvm::TargetMachine*        _target;
     bool                        _emitDwarfDebugInfo;
     bool                        _scopeRestrictionsDone;
+    bool                        _modulesAdded;
     lto_codegen_model           _codeModel;
     StringSet                   _mustPreserveSymbols;
     StringSet                   _asmUndefinedRefs;
-    llvm::MemoryBuffer*         _nativeObjectFile;
+    llvm::SmallVector<char, 0>  _nativeObject;
     std::vector<const char*>    _codegenOptions;
     std::string                 _mCpu;
+    std::string                 _targetTriple;
+    std::string                 _targetFeatures;
     std::string                 _nativeObjectPath;
+    std::vector<std::string>    _nativeObjectPaths;
+    std::vector<const char*>    _nativeObjectNames;
+    std::string                 _cacheDir;
+    std::vector<std::string>    _moduleBitcode;
+    std::vector<LTOModuleSummary> _moduleSummaries;
 };
 
 #endif // LTO_CODE_GENERATOR_H
@@ -161,6 +161,7 @@ LTOModule *LTOModule::makeLTOModule(MemoryBuffer *buffer,
   std::string FeatureStr = Features.getString();
   TargetMachine *target = march->createTargetMachine(Triple, FeatureStr);
   LTOModule *Ret = new LTOModule(m.take(), target);
+  Ret->_bitcode = buffer->getBuffer();
   bool Err = Ret->ParseSymbols();
   if (Err) {
     delete Ret;
@@ -72,6 +72,9 @@ struct LTOModule {
     const std::vector<const char*> &getAsmUndefinedRefs() {
             return _asm_undefines;
     }
+    // The bitcode the module is read from, which is only available until
+    // the module has been read in completely.
+    llvm::StringRef          getBitcode() { return _bitcode; }
 
 private:
                             LTOModule(llvm::Module* m, llvm::TargetMachine* t);
@@ -112,6 +115,7 @@ private:
 
     llvm::OwningPtr<llvm::Module>           _module;
     llvm::OwningPtr<llvm::TargetMachine>    _target;
+    llvm::StringRef                         _bitcode;
     std::vector<NameAndAttributes>          _symbols;
     // _defines and _undefines only needed to disambiguate tentative definitions
     StringSet                               _defines;    
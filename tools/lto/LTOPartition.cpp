@@ -0,0 +1,374 @@
+//===-LTOPartition.cpp - Split a module for parallel code generation ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the splitting of the merged module into partitions,
+// which are code generated on their own threads and linked back together by
+// the linker.
+//
+//===----------------------------------------------------------------------===//
+
+#include "LTOPartition.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/EquivalenceClasses.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Twine.h"
+
+using namespace llvm;
+
+const unsigned LTOPartitioning::Everywhere;
+
+/// refersToGlobal - Return true if C refers to a global value or the address
+/// of a basic block.
+static bool refersToGlobal(const Constant *C) {
+  if (isa<GlobalValue>(C) || isa<BlockAddress>(C))
+    return true;
+  for (User::const_op_iterator I = C->op_begin(), E = C->op_end(); I != E; ++I)
+    if (refersToGlobal(cast<Constant>(*I)))
+      return true;
+  return false;
+}
+
+/// isCopyable - Return true if GV is a local constant whose address is not
+/// significant and which refers to no other global, so that each partition
+/// can have its own copy instead of sharing one.
+static bool isCopyable(const GlobalVariable *GV) {
+  return GV->hasLocalLinkage() && GV->isConstant() && GV->hasUnnamedAddr() &&
+         !GV->isThreadLocal() && GV->hasInitializer() &&
+         !refersToGlobal(GV->getInitializer());
+}
+
+/// collectOwners - Add the definitions that refer to V to owners, looking
+/// through the constants that refer to it.
+static void collectOwners(const Value *V,
+                          SmallPtrSet<const GlobalValue*, 8> &owners,
+                          SmallPtrSet<const Constant*, 8> &visited) {
+  for (Value::const_use_iterator UI = V->use_begin(), E = V->use_end();
+       UI != E; ++UI) {
+    const User *U = *UI;
+    if (const Instruction *I = dyn_cast<Instruction>(U))
+      owners.insert(I->getParent()->getParent());
+    else if (const GlobalValue *GV = dyn_cast<GlobalValue>(U))
+      owners.insert(GV);
+    else if (const Constant *C = dyn_cast<Constant>(U))
+      if (visited.insert(C))
+        collectOwners(C, owners, visited);
+  }
+}
+
+/// collectReferences - Add the global values that C refers to to refs,
+/// looking through the constants in between.
+static void collectReferences(const Constant *C,
+                              std::vector<const GlobalValue*> &refs,
+                              SmallPtrSet<const Constant*, 8> &visited) {
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(C)) {
+    refs.push_back(GV);
+    return;
+  }
+  if (!visited.insert(C))
+    return;
+  for (User::const_op_iterator I = C->op_begin(), E = C->op_end(); I != E; ++I)
+    if (const Constant *Op = dyn_cast<Constant>(*I))
+      collectReferences(Op, refs, visited);
+}
+
+/// collectReferences - Add the global values that the body or initializer of
+/// GV refers to to refs.  An alias refers to its aliasee.
+static void collectReferences(const GlobalValue *GV,
+                              std::vector<const GlobalValue*> &refs) {
+  SmallPtrSet<const Constant*, 8> visited;
+  if (const Function *F = dyn_cast<Function>(GV)) {
+    for (Function::const_iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+      for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end();
+           I != IE; ++I)
+        for (User::const_op_iterator O = I->op_begin(), OE = I->op_end();
+             O != OE; ++O)
+          if (const Constant *C = dyn_cast<Constant>(*O))
+            collectReferences(C, refs, visited);
+  } else if (const GlobalVariable *Var = dyn_cast<GlobalVariable>(GV)) {
+    if (Var->hasInitializer())
+      collectReferences(Var->getInitializer(), refs, visited);
+  } else if (const GlobalAlias *GA = dyn_cast<GlobalAlias>(GV)) {
+    if (const Constant *Aliasee = GA->getAliasee())
+      collectReferences(Aliasee, refs, visited);
+  }
+}
+
+/// getWeight - An estimate of the time it takes to code generate GV.
+static unsigned getWeight(const GlobalValue *GV) {
+  const Function *F = dyn_cast<Function>(GV);
+  if (!F)
+    return 1;
+  unsigned weight = 1;
+  for (Function::const_iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+    weight += BB->size();
+  return weight;
+}
+
+void LTOPartitioning::partition(Module &M, unsigned maxPartitions) {
+  functions.assign(M.size(), Everywhere);
+  globals.assign(M.getGlobalList().size(), Everywhere);
+  aliases.assign(M.getAliasList().size(), Everywhere);
+  numPartitions = 1;
+
+  // Collect the definitions to be partitioned, with the slot that records
+  // the partition of each.
+  std::vector<std::pair<GlobalValue*, unsigned*> > defs;
+  unsigned i = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F, ++i)
+    if (!F->isDeclaration())
+      defs.push_back(std::make_pair(F, &functions[i]));
+  i = 0;
+  for (Module::global_iterator GV = M.global_begin(), E = M.global_end();
+       GV != E; ++GV, ++i)
+    if (GV->hasInitializer() && !isCopyable(GV))
+      defs.push_back(std::make_pair(GV, &globals[i]));
+  i = 0;
+  for (Module::alias_iterator GA = M.alias_begin(), E = M.alias_end();
+       GA != E; ++GA, ++i)
+    defs.push_back(std::make_pair(GA, &aliases[i]));
+
+  if (maxPartitions <= 1) {
+    for (unsigned d = 0, e = defs.size(); d != e; ++d)
+      *defs[d].second = 0;
+    return;
+  }
+
+  // Group the definitions that have to end up in the same object file.
+  EquivalenceClasses<const GlobalValue*> classes;
+  for (unsigned d = 0, e = defs.size(); d != e; ++d)
+    classes.insert(defs[d].first);
+
+  // An alias is emitted along with its aliasee.
+  for (Module::alias_iterator GA = M.alias_begin(), E = M.alias_end();
+       GA != E; ++GA)
+    if (const GlobalValue *aliasee = GA->getAliasedGlobal())
+      if (classes.findValue(aliasee) != classes.end())
+        classes.unionSets(GA, aliasee);
+
+  // A blockaddress can only refer to a block in the same object file.
+  SmallPtrSet<const GlobalValue*, 8> owners;
+  SmallPtrSet<const Constant*, 8> visited;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB) {
+      if (!BB->hasAddressTaken())
+        continue;
+      owners.clear();
+      visited.clear();
+      for (Value::use_iterator UI = BB->use_begin(), UE = BB->use_end();
+           UI != UE; ++UI)
+        if (BlockAddress *BA = dyn_cast<BlockAddress>(*UI))
+          collectOwners(BA, owners, visited);
+      for (SmallPtrSet<const GlobalValue*, 8>::iterator I = owners.begin(),
+           OE = owners.end(); I != OE; ++I)
+        if (classes.findValue(*I) != classes.end())
+          classes.unionSets(F, *I);
+    }
+
+  // The appending variables go in the first partition, along with the module
+  // inline asm and the local symbols it may refer to, which are those listed
+  // in llvm.used and llvm.compiler.used.
+  std::vector<const GlobalValue*> pinned;
+  for (Module::global_iterator GV = M.global_begin(), E = M.global_end();
+       GV != E; ++GV) {
+    if (!GV->hasAppendingLinkage())
+      continue;
+    pinned.push_back(GV);
+    if (GV->getName() != "llvm.used" && GV->getName() != "llvm.compiler.used")
+      continue;
+    if (const ConstantArray *Inits =
+          dyn_cast<ConstantArray>(GV->getInitializer()))
+      for (unsigned o = 0, oe = Inits->getNumOperands(); o != oe; ++o)
+        if (const GlobalValue *Used =
+              dyn_cast<GlobalValue>(Inits->getOperand(o)->stripPointerCasts()))
+          if (Used->hasLocalLinkage() &&
+              classes.findValue(Used) != classes.end())
+            pinned.push_back(Used);
+  }
+
+  // Weigh each group.
+  DenseMap<const GlobalValue*, unsigned> classWeight;
+  uint64_t totalWeight = 0;
+  for (unsigned d = 0, e = defs.size(); d != e; ++d) {
+    unsigned weight = getWeight(defs[d].first);
+    classWeight[classes.getLeaderValue(defs[d].first)] += weight;
+    totalWeight += weight;
+  }
+
+  // Order the definitions along the references between them: a depth-first
+  // walk from each definition in module order, listing each definition after
+  // the ones it refers to.  A callee then lands in the partition of the first
+  // caller that reaches it, so most calls stay within a partition and fewer
+  // local symbols have to be promoted.
+  std::vector<const GlobalValue*> order;
+  order.reserve(defs.size());
+  SmallPtrSet<const GlobalValue*, 32> seen;
+  std::vector<std::pair<const GlobalValue*, bool> > stack;
+  std::vector<const GlobalValue*> refs;
+  for (unsigned d = 0, e = defs.size(); d != e; ++d) {
+    stack.push_back(std::make_pair(defs[d].first, false));
+    while (!stack.empty()) {
+      const GlobalValue *GV = stack.back().first;
+      bool expanded = stack.back().second;
+      stack.pop_back();
+      if (expanded) {
+        order.push_back(GV);
+        continue;
+      }
+      if (!seen.insert(GV))
+        continue;
+      stack.push_back(std::make_pair(GV, true));
+      refs.clear();
+      collectReferences(GV, refs);
+      // Push in reverse so that the first reference is walked first.
+      for (unsigned r = refs.size(); r != 0; --r)
+        if (classes.findValue(refs[r-1]) != classes.end() &&
+            !seen.count(refs[r-1]))
+          stack.push_back(std::make_pair(refs[r-1], false));
+    }
+  }
+
+  // Cut that order into runs of about the same weight.  The definitions of
+  // each input module are next to each other after linking, so walking from
+  // them in module order also keeps the code of each source file together.
+  DenseMap<const GlobalValue*, unsigned> classPartition;
+  uint64_t doneWeight = 0;
+  for (unsigned p = 0, e = pinned.size(); p != e; ++p) {
+    const GlobalValue *leader = classes.getLeaderValue(pinned[p]);
+    if (classPartition.insert(std::make_pair(leader, 0U)).second)
+      doneWeight += classWeight[leader];
+  }
+  std::vector<bool> used(maxPartitions);
+  used[0] = !pinned.empty();
+  for (unsigned d = 0, e = order.size(); d != e; ++d) {
+    const GlobalValue *leader = classes.getLeaderValue(order[d]);
+    if (classPartition.count(leader))
+      continue;
+    unsigned p = unsigned(doneWeight * maxPartitions / totalWeight);
+    classPartition[leader] = p;
+    used[p] = true;
+    doneWeight += classWeight[leader];
+  }
+
+  // Number the partitions that got something.
+  std::vector<unsigned> number(maxPartitions);
+  numPartitions = 0;
+  for (unsigned p = 0; p != maxPartitions; ++p)
+    if (used[p])
+      number[p] = numPartitions++;
+
+  DenseMap<const GlobalValue*, unsigned> partitionOf;
+  for (unsigned d = 0, e = defs.size(); d != e; ++d) {
+    const GlobalValue *GV = defs[d].first;
+    unsigned p = number[classPartition[classes.getLeaderValue(GV)]];
+    *defs[d].second = p;
+    partitionOf[GV] = p;
+  }
+  if (numPartitions <= 1)
+    return;
+
+  // Local symbols that are referred to from other partitions become hidden
+  // globals.  They are renamed, as another input may have a local symbol of
+  // the same name.
+  unsigned numPromoted = 0;
+  for (unsigned d = 0, e = defs.size(); d != e; ++d) {
+    GlobalValue *GV = defs[d].first;
+    if (!GV->hasLocalLinkage())
+      continue;
+    owners.clear();
+    visited.clear();
+    collectOwners(GV, owners, visited);
+    unsigned p = *defs[d].second;
+    bool crossesPartitions = false;
+    for (SmallPtrSet<const GlobalValue*, 8>::iterator I = owners.begin(),
+         E = owners.end(); I != E && !crossesPartitions; ++I)
+      crossesPartitions = partitionOf.lookup(*I) != p;
+    if (!crossesPartitions)
+      continue;
+    GV->setName(Twine(GV->hasName() ? GV->getName() : "anon") + ".lto." +
+                Twine(numPromoted++));
+    GV->setLinkage(GlobalValue::ExternalLinkage);
+    GV->setVisibility(GlobalValue::HiddenVisibility);
+  }
+}
+
+bool LTOPartitioning::extract(Module &M, unsigned index,
+                              std::string &errMsg) const {
+  assert(functions.size() == M.size() &&
+         globals.size() == M.getGlobalList().size() &&
+         aliases.size() == M.getAliasList().size() &&
+         "Module doesn't match the partitioning!");
+
+  // Read in this partition's function bodies, and drop the others.
+  unsigned i = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F, ++i)
+    if (functions[i] == index && F->Materialize(&errMsg))
+      return true;
+  i = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F, ++i)
+    if (functions[i] != index && functions[i] != Everywhere)
+      F->deleteBody();
+
+  std::vector<GlobalVariable*> dead;
+  i = 0;
+  for (Module::global_iterator GV = M.global_begin(), E = M.global_end();
+       GV != E; ++GV, ++i) {
+    if (globals[i] == index)
+      continue;
+    if (globals[i] == Everywhere) {
+      // A partition only keeps the copies of local constants it uses.
+      if (GV->hasLocalLinkage())
+        dead.push_back(GV);
+      continue;
+    }
+    if (GV->hasAppendingLinkage()) {
+      dead.push_back(GV);
+      continue;
+    }
+    GV->setInitializer(0);
+    GV->setLinkage(GlobalValue::ExternalLinkage);
+  }
+
+  // An alias can't be a declaration, so the aliases of other partitions are
+  // replaced by declarations of what they alias.
+  std::vector<GlobalAlias*> foreignAliases;
+  i = 0;
+  for (Module::alias_iterator GA = M.alias_begin(), E = M.alias_end();
+       GA != E; ++GA, ++i)
+    if (aliases[i] != index)
+      foreignAliases.push_back(GA);
+  for (unsigned a = 0, e = foreignAliases.size(); a != e; ++a) {
+    GlobalAlias *GA = foreignAliases[a];
+    const PointerType *Ty = GA->getType();
+    GlobalValue *Decl;
+    if (const FunctionType *FTy = dyn_cast<FunctionType>(Ty->getElementType()))
+      Decl = Function::Create(FTy, GlobalValue::ExternalLinkage, "", &M);
+    else
+      Decl = new GlobalVariable(M, Ty->getElementType(), false,
+                                GlobalValue::ExternalLinkage, 0, "", 0, false,
+                                Ty->getAddressSpace());
+    Decl->takeName(GA);
+    Decl->setVisibility(GA->getVisibility());
+    GA->replaceAllUsesWith(Decl);
+    GA->eraseFromParent();
+  }
+
+  for (unsigned d = 0, e = dead.size(); d != e; ++d) {
+    dead[d]->removeDeadConstantUsers();
+    if (dead[d]->use_empty())
+      dead[d]->eraseFromParent();
+  }
+
+  if (index != 0)
+    M.setModuleInlineAsm("");
+  return false;
+}
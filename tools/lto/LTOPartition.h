@@ -0,0 +1,61 @@
+//===-LTOPartition.h - Split a module for parallel code generation --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the LTOPartitioning class, which splits the merged
+// module into partitions that can be code generated independently.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LTO_PARTITION_H
+#define LTO_PARTITION_H
+
+#include <string>
+#include <vector>
+
+// forward references to llvm classes
+namespace llvm {
+    class Module;
+}
+
+
+//
+// An assignment of the definitions in a module to partitions.  Definitions
+// are identified by their position in the module's function, global variable
+// and alias lists, which is preserved when the module is written out as
+// bitcode and read back into another LLVMContext.
+//
+struct LTOPartitioning {
+    // Everywhere - The partition of declarations, and of local constants that
+    // each partition using them gets its own copy of.
+    static const unsigned   Everywhere = ~0U;
+
+                            LTOPartitioning() : numPartitions(1) {}
+
+    // Split M into at most maxPartitions partitions of about the same size.
+    // The definitions are ordered along the call graph and the references
+    // between globals before being cut, so that callees tend to share a
+    // partition with their callers.  Definitions that have to be emitted
+    // together, such as an alias and its aliasee, are kept in the same
+    // partition, and local symbols that are referenced from other partitions
+    // are made hidden globals named <name>.lto.<N>.
+    void                    partition(llvm::Module& M, unsigned maxPartitions);
+
+    // Reduce M, a copy of the partitioned module that may be read lazily, to
+    // the definitions in partition index.  The definitions that belong to
+    // other partitions become declarations.
+    bool                    extract(llvm::Module& M, unsigned index,
+                                    std::string& errMsg) const;
+
+    unsigned                numPartitions;
+    std::vector<unsigned>   functions;
+    std::vector<unsigned>   globals;
+    std::vector<unsigned>   aliases;
+};
+
+#endif // LTO_PARTITION_H
@@ -0,0 +1,255 @@
+//===-LTOSummary.cpp - Summary of a module for incremental LTO ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the module summaries used by incremental LTO, and
+// the text format they are cached in.
+//
+//===----------------------------------------------------------------------===//
+
+#include "LTOSummary.h"
+#include "llvm/Constants.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+static const char SummaryHeader[] = "LLVM LTO summary 1";
+
+/// isSymbol - Return true if GV is a global symbol that other modules can
+/// refer to.
+static bool isSymbol(const GlobalValue *GV) {
+  return !GV->hasLocalLinkage() && !GV->hasAppendingLinkage() &&
+         !GV->getName().startswith("llvm.");
+}
+
+/// collectRefs - Add the global symbols C refers to, looking through
+/// constant expressions, to refs.  Returns false if C refers to a local
+/// symbol or takes the address of a block.
+static bool collectRefs(const Constant *C,
+                        SmallPtrSet<const GlobalValue*, 16> &refs,
+                        SmallPtrSet<const Constant*, 16> &visited) {
+  if (isa<BlockAddress>(C))
+    return false;
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(C)) {
+    if (GV->hasLocalLinkage())
+      return false;
+    if (isSymbol(GV))
+      refs.insert(GV);
+    return true;
+  }
+  if (!visited.insert(C))
+    return true;
+  for (User::const_op_iterator I = C->op_begin(), E = C->op_end(); I != E; ++I)
+    if (!collectRefs(cast<Constant>(*I), refs, visited))
+      return false;
+  return true;
+}
+
+/// summarizeBody - Count the instructions of F, and work out whether it can
+/// be imported into other modules.
+static void summarizeBody(const Function &F, LTOModuleSummary::Definition &D) {
+  D.size = 0;
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    D.size += BB->size();
+
+  // Only a definition that is the same in every module may be imported, and
+  // only if the copy in the importing module can refer to everything the
+  // body refers to.
+  D.importable = false;
+  GlobalValue::LinkageTypes linkage = F.getLinkage();
+  if (linkage != GlobalValue::ExternalLinkage &&
+      linkage != GlobalValue::LinkOnceODRLinkage &&
+      linkage != GlobalValue::WeakODRLinkage)
+    return;
+  if (F.hasFnAttr(Attribute::NoInline))
+    return;
+
+  SmallPtrSet<const GlobalValue*, 16> refs;
+  SmallPtrSet<const Constant*, 16> visited;
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    if (BB->hasAddressTaken())
+      return;
+    for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end();
+         I != IE; ++I)
+      for (User::const_op_iterator OI = I->op_begin(), OE = I->op_end();
+           OI != OE; ++OI)
+        if (const Constant *C = dyn_cast<Constant>(*OI))
+          if (!collectRefs(C, refs, visited))
+            return;
+  }
+
+  D.importable = true;
+  for (SmallPtrSet<const GlobalValue*, 16>::iterator I = refs.begin(),
+       E = refs.end(); I != E; ++I)
+    D.refs.push_back((*I)->getName());
+}
+
+/// addDefinition - Record the definition of GV, if it is a global symbol.
+static void addDefinition(const GlobalValue &GV, char kind,
+                          std::vector<LTOModuleSummary::Definition> &defs) {
+  if (!isSymbol(&GV) || GV.hasAvailableExternallyLinkage())
+    return;
+  defs.push_back(LTOModuleSummary::Definition());
+  LTOModuleSummary::Definition &D = defs.back();
+  D.name = GV.getName();
+  D.kind = kind;
+  D.weak = GV.isWeakForLinker();
+  D.common = GV.hasCommonLinkage();
+  D.importable = false;
+  D.size = 0;
+  if (const Function *F = dyn_cast<Function>(&GV))
+    summarizeBody(*F, D);
+}
+
+void LTOModuleSummary::compute(Module &M) {
+  definitions.clear();
+  references.clear();
+  calls.clear();
+
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (!F->isDeclaration())
+      addDefinition(*F, 'f', definitions);
+    if (isSymbol(F) && !F->use_empty())
+      references.push_back(F->getName());
+  }
+  for (Module::global_iterator GV = M.global_begin(), E = M.global_end();
+       GV != E; ++GV) {
+    if (GV->hasInitializer())
+      addDefinition(*GV, 'v', definitions);
+    if (isSymbol(GV) && !GV->use_empty())
+      references.push_back(GV->getName());
+  }
+  for (Module::alias_iterator GA = M.alias_begin(), E = M.alias_end();
+       GA != E; ++GA) {
+    addDefinition(*GA, 'a', definitions);
+    if (isSymbol(GA) && !GA->use_empty())
+      references.push_back(GA->getName());
+  }
+
+  SmallPtrSet<const Function*, 32> callees;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+        CallSite CS(cast<Value>(I));
+        if (!CS)
+          continue;
+        const Function *Callee =
+          dyn_cast<Function>(CS.getCalledValue()->stripPointerCasts());
+        if (Callee && isSymbol(Callee) && callees.insert(Callee))
+          calls.push_back(Callee->getName());
+      }
+}
+
+/// writeName - Write a record holding name; returns true if the name can't
+/// be written on a line of its own.
+static bool writeName(raw_ostream &out, char tag, StringRef name) {
+  if (name.find_first_of("\r\n") != StringRef::npos)
+    return true;
+  out << tag << ' ' << name << '\n';
+  return false;
+}
+
+bool LTOModuleSummary::write(raw_ostream &out) const {
+  out << SummaryHeader << '\n';
+  for (unsigned i = 0, e = definitions.size(); i != e; ++i) {
+    const Definition &D = definitions[i];
+    out << "d " << D.kind << (D.weak ? 'w' : '-') << (D.common ? 'c' : '-')
+        << (D.importable ? 'i' : '-') << ' ' << D.size << ' ';
+    if (writeName(out, 'n', D.name))
+      return true;
+    for (unsigned r = 0, re = D.refs.size(); r != re; ++r)
+      if (writeName(out, 'r', D.refs[r]))
+        return true;
+  }
+  for (unsigned i = 0, e = references.size(); i != e; ++i)
+    if (writeName(out, 'u', references[i]))
+      return true;
+  for (unsigned i = 0, e = calls.size(); i != e; ++i)
+    if (writeName(out, 'c', calls[i]))
+      return true;
+  return false;
+}
+
+bool LTOModuleSummary::read(StringRef data) {
+  definitions.clear();
+  references.clear();
+  calls.clear();
+
+  SmallVector<StringRef, 64> lines;
+  data.split(lines, "\n", -1, false);
+  if (lines.empty() || lines[0] != SummaryHeader)
+    return true;
+
+  for (unsigned i = 1, e = lines.size(); i != e; ++i) {
+    StringRef line = lines[i];
+    if (line.size() < 2 || line[1] != ' ')
+      return true;
+    char tag = line[0];
+    StringRef rest = line.substr(2);
+    switch (tag) {
+    case 'd': {
+      // d <kind><weak><common><importable> <size> n <name>
+      if (rest.size() < 5 || rest[4] != ' ')
+        return true;
+      Definition D;
+      D.kind = rest[0];
+      D.weak = rest[1] == 'w';
+      D.common = rest[2] == 'c';
+      D.importable = rest[3] == 'i';
+      std::pair<StringRef, StringRef> sizeAndName = rest.substr(5).split(' ');
+      if (sizeAndName.first.getAsInteger(10, D.size) ||
+          !sizeAndName.second.startswith("n "))
+        return true;
+      D.name = sizeAndName.second.substr(2);
+      definitions.push_back(D);
+      break;
+    }
+    case 'r':
+      if (definitions.empty())
+        return true;
+      definitions.back().refs.push_back(rest);
+      break;
+    case 'u':
+      references.push_back(rest);
+      break;
+    case 'c':
+      calls.push_back(rest);
+      break;
+    default:
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LTOModuleSummary::findPrevailing(
+                        const std::vector<LTOModuleSummary> &summaries,
+                        StringMap<ModuleAndDefinition> &prevailing,
+                        std::string &errMsg) {
+  for (unsigned i = 0, e = summaries.size(); i != e; ++i) {
+    const std::vector<Definition> &defs = summaries[i].definitions;
+    for (unsigned d = 0, de = defs.size(); d != de; ++d) {
+      const Definition &D = defs[d];
+      if (D.common)
+        continue;
+      ModuleAndDefinition &P = prevailing[D.name];
+      if (!P.second || (P.second->weak && !D.weak))
+        P = ModuleAndDefinition(i, &D);
+      else if (!P.second->weak && !D.weak) {
+        errMsg = "symbol multiply defined: " + D.name;
+        return true;
+      }
+    }
+  }
+  return false;
+}
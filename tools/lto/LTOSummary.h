@@ -0,0 +1,90 @@
+//===-LTOSummary.h - Summary of a module for incremental LTO --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the LTOModuleSummary class, which records what the
+// incremental code generator needs to know about a module to decide how it
+// is code generated, without reading in the module's function bodies.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LTO_SUMMARY_H
+#define LTO_SUMMARY_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+
+#include <string>
+#include <vector>
+
+// forward references to llvm classes
+namespace llvm {
+    class Module;
+    class raw_ostream;
+}
+
+
+//
+// The global symbols a module defines and refers to, and the calls it makes.
+// A summary is cached next to the objects built from the module, keyed by a
+// hash of the module's bitcode, so that it only has to be computed once.
+//
+struct LTOModuleSummary {
+    struct Definition {
+        std::string                 name;
+        char                        kind;       // 'f', 'v' or 'a'
+        bool                        weak;       // may be overridden
+        bool                        common;
+        // The function can be imported into the modules that call it: its
+        // definition is the same everywhere and its body only refers to
+        // global symbols.
+        bool                        importable;
+        unsigned                    size;       // instructions, for functions
+        // The global symbols the body of an importable function refers to.
+        std::vector<std::string>    refs;
+    };
+
+    // A definition, as the index of the summary of its module and the
+    // definition itself.
+    typedef std::pair<unsigned, const Definition*> ModuleAndDefinition;
+
+                            LTOModuleSummary() : hash(0) {}
+
+    // Summarize M, whose function bodies must have been read in.
+    void                    compute(llvm::Module& M);
+
+    // Write the summary out; returns true if it can't be represented, as
+    // when a symbol name contains a newline.
+    bool                    write(llvm::raw_ostream& out) const;
+
+    // Read back a summary written by write; returns true on error.
+    bool                    read(llvm::StringRef data);
+
+    // Find the definition of each symbol that prevails among the modules
+    // summarized: the strong one, or else the first weak one.  Common
+    // symbols are left for the linker to merge.  Returns true if a symbol
+    // has more than one strong definition.
+    static bool             findPrevailing(
+                        const std::vector<LTOModuleSummary>& summaries,
+                        llvm::StringMap<ModuleAndDefinition>& prevailing,
+                        std::string& errMsg);
+
+    // The hash of the module's bitcode.
+    uint64_t                    hash;
+    // The global symbols the module defines, other than appending variables
+    // and available_externally definitions.
+    std::vector<Definition>     definitions;
+    // The global symbols the module refers to, whether it defines them or
+    // not.  The definition of a weak symbol in another module may prevail.
+    std::vector<std::string>    references;
+    // The global functions called directly.
+    std::vector<std::string>    calls;
+};
+
+#endif // LTO_SUMMARY_H
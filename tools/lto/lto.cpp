@@ -239,6 +239,15 @@ void lto_codegen_set_cpu(lto_code_gen_t cg, const char* cpu)
   return cg->setCpu(cpu);
 }
 
+//
+// turns on incremental compilation, caching in the directory at path
+// returns true on error (check lto_get_error_message() for details)
+//
+bool lto_codegen_set_cache_dir(lto_code_gen_t cg, const char* path)
+{
+  return cg->setCacheDir(path, sLastErrorString);
+}
+
 //
 // sets the path to the assembler tool
 //
@@ -299,6 +308,13 @@ lto_codegen_compile_to_file(lto_code_gen_t cg, const char **name)
   return cg->compile_to_file(name, sLastErrorString);
 }
 
+extern bool
+lto_codegen_compile_to_files(lto_code_gen_t cg, const char ***names,
+                             unsigned *count)
+{
+  return cg->compile_to_files(names, count, sLastErrorString);
+}
+
 
 //
 // Used to pass extra options to the code generator
@@ -0,0 +1,169 @@
+//===- llvm/unittest/AsmParser/LLParserTest.cpp - .ll parser tests --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Function.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/ValueSymbolTable.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/Assembly/Parser.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <string>
+
+namespace llvm {
+namespace {
+
+class LLParserTest : public testing::Test {
+protected:
+  Module *parse(const char *Source) {
+    M.reset(ParseAssemblyString(Source, 0, Err, Context));
+    return M.get();
+  }
+
+  LLVMContext Context;
+  OwningPtr<Module> M;
+  SMDiagnostic Err;
+};
+
+TEST_F(LLParserTest, EscapedNames) {
+  ASSERT_TRUE(parse(
+    "@\"a\\22b\" = global i32 0\n"
+    "define i32 @\"f\\5C\"(i32 %\"x\\41\") {\n"
+    "\"bb\\3A\":\n"
+    "  %\"y\\20z\" = add i32 %\"x\\41\", 1\n"
+    "  ret i32 %\"y\\20z\"\n"
+    "}\n")) << Err.getMessage();
+
+  EXPECT_TRUE(M->getNamedGlobal("a\"b") != 0);
+  Function *F = M->getFunction("f\\");
+  ASSERT_TRUE(F != 0);
+  EXPECT_EQ("xA", F->arg_begin()->getName());
+  EXPECT_EQ("bb:", F->begin()->getName());
+  EXPECT_EQ("y z", F->begin()->begin()->getName());
+}
+
+TEST_F(LLParserTest, ForwardReferences) {
+  ASSERT_TRUE(parse(
+    "define i32 @f(i1 %c) {\n"
+    "entry:\n"
+    "  br i1 %c, label %loop, label %exit\n"
+    "loop:\n"
+    "  %0 = phi i32 [ 0, %entry ], [ %next, %loop ]\n"
+    "  %next = call i32 @g(i32 %0)\n"
+    "  br i1 %c, label %loop, label %exit\n"
+    "exit:\n"
+    "  %r = phi i32 [ 0, %entry ], [ %next, %loop ]\n"
+    "  ret i32 %r\n"
+    "}\n"
+    "declare i32 @g(i32)\n")) << Err.getMessage();
+  EXPECT_FALSE(verifyModule(*M, ReturnStatusAction));
+
+  Function *F = M->getFunction("f");
+  Function *G = M->getFunction("g");
+  ASSERT_TRUE(F != 0 && G != 0);
+  EXPECT_TRUE(G->isDeclaration());
+  EXPECT_EQ(1U, G->getNumUses());
+  EXPECT_EQ(3U, F->size());
+  EXPECT_EQ(2U, F->getValueSymbolTable().lookup("next")->getNumUses());
+}
+
+// The forward reference tables are hashed; the undefined name or number that
+// sorts first is still the one reported.
+TEST_F(LLParserTest, UndefinedValueDiagnostics) {
+  EXPECT_FALSE(parse(
+    "define void @f() {\n"
+    "  %a = add i32 %zzz, %4\n"
+    "  %b = add i32 %aaa, %3\n"
+    "  ret void\n"
+    "}\n"));
+  EXPECT_EQ("error: use of undefined value '%aaa'", Err.getMessage());
+  EXPECT_EQ(3, Err.getLineNo());
+
+  EXPECT_FALSE(parse(
+    "define void @f() {\n"
+    "  %a = add i32 %4, 0\n"
+    "  %b = add i32 %3, 0\n"
+    "  ret void\n"
+    "}\n"));
+  EXPECT_EQ("error: use of undefined value '%3'", Err.getMessage());
+  EXPECT_EQ(3, Err.getLineNo());
+
+  EXPECT_FALSE(parse(
+    "@p = global i32* @zzz\n"
+    "@q = global i32* @aaa\n"));
+  EXPECT_EQ("error: use of undefined value '@aaa'", Err.getMessage());
+  EXPECT_EQ(2, Err.getLineNo());
+
+  EXPECT_FALSE(parse(
+    "@p = global %zzz* null\n"
+    "@q = global %aaa* null\n"));
+  EXPECT_EQ("error: use of undefined type named 'aaa'", Err.getMessage());
+  EXPECT_EQ(2, Err.getLineNo());
+}
+
+// Generate a module of about Size bytes with named values, forward branches
+// and phis, which is what most .ll files written by the tools look like.
+static std::string GenerateModule(unsigned Size) {
+  std::string Source;
+  raw_string_ostream OS(Source);
+  OS << "@counter = global i64 0\n"
+     << "declare i64 @callee(i64, i64)\n";
+  for (unsigned F = 0; OS.tell() < Size; ++F) {
+    OS << "define i64 @function_" << F << "(i64 %argument, i1 %flag) {\n"
+       << "entry:\n";
+    for (unsigned B = 0; B != 16; ++B) {
+      OS << "  br i1 %flag, label %block_" << B << ", label %exit\n"
+         << "block_" << B << ":\n"
+         << "  %phi_" << B << " = phi i64 [ %argument, %";
+      if (B)
+        OS << "block_" << B-1;
+      else
+        OS << "entry";
+      OS << " ]\n"
+         << "  %sum_" << B << " = add nsw i64 %phi_" << B << ", " << B << "\n"
+         << "  %load_" << B << " = load i64* @counter, align 8\n"
+         << "  %call_" << B << " = call i64 @callee(i64 %sum_" << B
+         << ", i64 %load_" << B << ")\n"
+         << "  store i64 %call_" << B << ", i64* @counter, align 8\n";
+    }
+    OS << "  br label %exit\n"
+       << "exit:\n"
+       << "  ret i64 %argument\n"
+       << "}\n";
+  }
+  return OS.str();
+}
+
+// Reports the parse throughput of a 16MB module. Run it with
+// --gtest_also_run_disabled_tests --gtest_filter=*ParseThroughputBenchmark.
+TEST(LLParserBenchmark, DISABLED_ParseThroughputBenchmark) {
+  std::string Source = GenerateModule(16 << 20);
+  for (unsigned Run = 0; Run != 3; ++Run) {
+    LLVMContext Context;
+    SMDiagnostic Err;
+    sys::TimeValue Start = sys::TimeValue::now();
+    OwningPtr<Module> M(ParseAssembly(MemoryBuffer::getMemBuffer(Source),
+                                      0, Err, Context));
+    sys::TimeValue Elapsed = sys::TimeValue::now() - Start;
+    ASSERT_TRUE(M.get() != 0) << Err.getMessage();
+    double Seconds = Elapsed.seconds() + Elapsed.microseconds() / 1e6;
+    errs() << format("%.1f", Source.size() / Seconds / (1 << 20))
+           << " MB/s (" << Elapsed.msec() << " ms)\n";
+  }
+}
+
+}  // end anonymous namespace
+}  // end namespace llvm
@@ -0,0 +1,124 @@
+//===- llvm/unittest/Bitcode/BitReaderTest.cpp - Bitcode reader tests -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Constants.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Assembly/Parser.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+namespace llvm {
+namespace {
+
+const char ModuleSource[] =
+  "define i32 @f(i32 %x) {\n"
+  "  %y = add i32 %x, 1, !attached !1\n"
+  "  ret i32 %y\n"
+  "}\n"
+  "!llvm.ident = !{!0, !1}\n"
+  "!0 = metadata !{metadata !\"first\"}\n"
+  "!1 = metadata !{i32 42, metadata !0}\n";
+
+// Writes ModuleSource as bitcode and reads it back lazily.
+class LazyBitReaderTest : public testing::Test {
+protected:
+  LLVMContext Context;
+  OwningPtr<Module> M;
+
+  void readLazily() {
+    SMDiagnostic Err;
+    OwningPtr<Module> Source(ParseAssemblyString(ModuleSource, 0, Err,
+                                                 Context));
+    ASSERT_TRUE(Source != 0);
+
+    SmallString<1024> Bitcode;
+    {
+      raw_svector_ostream OS(Bitcode);
+      WriteBitcodeToFile(Source.get(), OS);
+    }
+
+    MemoryBuffer *Buffer = MemoryBuffer::getMemBufferCopy(Bitcode.str());
+    std::string ErrMsg;
+    M.reset(getLazyBitcodeModule(Buffer, Context, &ErrMsg));
+    ASSERT_TRUE(M != 0) << ErrMsg;
+  }
+
+  // Check that !llvm.ident reads back as written.
+  void checkNamedMetadata() {
+    NamedMDNode *Ident = M->getNamedMetadata("llvm.ident");
+    ASSERT_TRUE(Ident != 0);
+    ASSERT_EQ(2U, Ident->getNumOperands());
+
+    MDNode *First = Ident->getOperand(0);
+    ASSERT_EQ(1U, First->getNumOperands());
+    MDString *Str = dyn_cast_or_null<MDString>(First->getOperand(0));
+    ASSERT_TRUE(Str != 0);
+    EXPECT_EQ("first", Str->getString());
+
+    MDNode *Second = Ident->getOperand(1);
+    ASSERT_EQ(2U, Second->getNumOperands());
+    ConstantInt *CI = dyn_cast_or_null<ConstantInt>(Second->getOperand(0));
+    ASSERT_TRUE(CI != 0);
+    EXPECT_EQ(42U, CI->getZExtValue());
+    EXPECT_EQ(First, Second->getOperand(1));
+  }
+};
+
+TEST_F(LazyBitReaderTest, MaterializeMetadata) {
+  readLazily();
+
+  // Module-level metadata is not read until it is asked for.
+  EXPECT_EQ(0, M->getNamedMetadata("llvm.ident"));
+  EXPECT_TRUE(M->getFunction("f")->isMaterializable());
+
+  std::string ErrMsg;
+  ASSERT_FALSE(M->MaterializeMetadata(&ErrMsg)) << ErrMsg;
+  checkNamedMetadata();
+  EXPECT_TRUE(M->getFunction("f")->isMaterializable());
+
+  // Reading it twice is harmless.
+  ASSERT_FALSE(M->MaterializeMetadata(&ErrMsg)) << ErrMsg;
+  EXPECT_EQ(2U, M->getNamedMetadata("llvm.ident")->getNumOperands());
+}
+
+TEST_F(LazyBitReaderTest, MaterializeFunction) {
+  readLazily();
+
+  // Materializing a body reads the module-level metadata first, so the
+  // body's attachments refer to the same nodes as the named metadata.
+  Function *F = M->getFunction("f");
+  std::string ErrMsg;
+  ASSERT_FALSE(M->Materialize(F, &ErrMsg)) << ErrMsg;
+  checkNamedMetadata();
+
+  Instruction *Add = F->getEntryBlock().begin();
+  MDNode *Attached = Add->getMetadata("attached");
+  ASSERT_TRUE(Attached != 0);
+  EXPECT_EQ(M->getNamedMetadata("llvm.ident")->getOperand(1), Attached);
+}
+
+TEST_F(LazyBitReaderTest, MaterializeAll) {
+  readLazily();
+
+  std::string ErrMsg;
+  ASSERT_FALSE(M->MaterializeAll(&ErrMsg)) << ErrMsg;
+  checkNamedMetadata();
+}
+
+}
+}
@@ -0,0 +1,254 @@
+//===- llvm/unittest/LTO/LTOCodeGenTest.cpp - LTO code generation tests ---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm-c/lto.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Assembly/Parser.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PathV2.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace llvm {
+namespace {
+
+// A function of N volatile stores, which the optimizer leaves alone.
+std::string heavyFunction(StringRef Name, unsigned N) {
+  std::string Body = ("define void @" + Name + "() {\n").str();
+  for (unsigned i = 0; i != N; ++i)
+    Body += ("  volatile store i32 " + Twine(i) + ", i32* @g\n").str();
+  return Body + "  ret void\n}\n";
+}
+
+class LTOCodeGenTest : public testing::Test {
+protected:
+  // Where objects are cached, if they are compiled incrementally.
+  SmallString<128> CacheDir;
+
+  static std::string assemble(const std::string &Source) {
+    LLVMContext Context;
+    SMDiagnostic Err;
+    OwningPtr<Module> M(ParseAssemblyString(Source.c_str(), 0, Err, Context));
+    EXPECT_TRUE(M != 0) << Err.getMessage();
+    if (!M)
+      return std::string();
+    M->setTargetTriple(sys::getHostTriple());
+    std::string Bitcode;
+    raw_string_ostream OS(Bitcode);
+    WriteBitcodeToFile(M.get(), OS);
+    OS.flush();
+    return Bitcode;
+  }
+
+  // Code generate Sources, keeping every symbol they define, and return the
+  // contents of the object files produced.
+  bool compile(const std::vector<std::string> &Sources, const char *Options,
+               std::vector<std::string> &Objects) {
+    lto_code_gen_t CG = lto_codegen_create();
+    std::vector<lto_module_t> Modules;
+    bool Failed = !CacheDir.empty() &&
+                  lto_codegen_set_cache_dir(CG, CacheDir.c_str());
+    for (unsigned i = 0, e = Sources.size(); i != e && !Failed; ++i) {
+      std::string Bitcode = assemble(Sources[i]);
+      lto_module_t Mod = lto_module_create_from_memory(Bitcode.data(),
+                                                       Bitcode.size());
+      if (!Mod) {
+        Failed = true;
+        break;
+      }
+      Modules.push_back(Mod);
+      for (unsigned s = 0, se = lto_module_get_num_symbols(Mod); s != se; ++s)
+        if ((lto_module_get_symbol_attribute(Mod, s) &
+             LTO_SYMBOL_DEFINITION_MASK) != LTO_SYMBOL_DEFINITION_UNDEFINED)
+          lto_codegen_add_must_preserve_symbol(CG,
+                                           lto_module_get_symbol_name(Mod, s));
+      Failed = lto_codegen_add_module(CG, Mod);
+    }
+    if (Options)
+      lto_codegen_debug_options(CG, Options);
+
+    const char **Names;
+    unsigned Count;
+    if (!Failed)
+      Failed = lto_codegen_compile_to_files(CG, &Names, &Count);
+    EXPECT_FALSE(Failed) << lto_get_error_message();
+
+    Objects.clear();
+    for (unsigned i = 0; !Failed && i != Count; ++i) {
+      OwningPtr<MemoryBuffer> Buffer;
+      EXPECT_FALSE(MemoryBuffer::getFile(Names[i], Buffer));
+      Objects.push_back(Buffer ? Buffer->getBuffer().str() : std::string());
+      bool Existed;
+      sys::fs::remove(Names[i], Existed);
+    }
+
+    lto_codegen_dispose(CG);
+    for (unsigned i = 0, e = Modules.size(); i != e; ++i)
+      lto_module_dispose(Modules[i]);
+    return !Failed;
+  }
+};
+
+// Command line options can only be given once per process, so this is the
+// only test that sets -lto-partitions.
+TEST_F(LTOCodeGenTest, Partitions) {
+  std::vector<std::string> Sources;
+  Sources.push_back("@g = global i32 0\n" + heavyFunction("a", 20) +
+                    heavyFunction("b", 20));
+  std::vector<std::string> Objects;
+  ASSERT_TRUE(compile(Sources, "-lto-partitions=2", Objects));
+  ASSERT_EQ(2U, Objects.size());
+  EXPECT_FALSE(Objects[0].empty());
+  EXPECT_FALSE(Objects[1].empty());
+}
+
+// Written over the cached objects, so that a cache hit can be told from an
+// object that was built again.
+const char Marker[] = "cached object";
+
+class LTOCacheTest : public LTOCodeGenTest {
+protected:
+  std::vector<std::string> Sources;
+
+  virtual void SetUp() {
+    int fd;
+    ASSERT_FALSE(sys::fs::unique_file("lto-cache-test-%%-%%-%%-%%/anchor", fd,
+                                      CacheDir));
+    ::close(fd);
+    CacheDir = sys::path::parent_path(CacheDir);
+
+    // @main calls @f, which is small enough to be imported from the module
+    // that defines it.
+    Sources.push_back(
+      "define i32 @main() {\n"
+      "  %r = call i32 @f()\n"
+      "  ret i32 %r\n"
+      "}\n"
+      "declare i32 @f()\n");
+    Sources.push_back(
+      "define i32 @f() {\n"
+      "  ret i32 1\n"
+      "}\n");
+  }
+
+  virtual void TearDown() {
+    uint32_t Removed;
+    sys::fs::remove_all(CacheDir.str(), Removed);
+  }
+
+  // Overwrite each cache entry with the extension Ext with Contents, and
+  // return how many there were.
+  unsigned overwriteEntries(StringRef Ext, StringRef Contents) {
+    unsigned Count = 0;
+    error_code ec;
+    for (sys::fs::directory_iterator I(CacheDir.str(), ec), E; I != E;
+         I.increment(ec)) {
+      if (sys::path::extension(I->path()) != Ext)
+        continue;
+      std::string ErrInfo;
+      raw_fd_ostream OS(I->path().c_str(), ErrInfo, raw_fd_ostream::F_Binary);
+      EXPECT_EQ("", ErrInfo);
+      OS << Contents;
+      ++Count;
+    }
+    EXPECT_FALSE(ec);
+    return Count;
+  }
+
+  // Return how many cache entries have the extension Ext.
+  unsigned countEntries(StringRef Ext) {
+    unsigned Count = 0;
+    error_code ec;
+    for (sys::fs::directory_iterator I(CacheDir.str(), ec), E; I != E;
+         I.increment(ec))
+      if (sys::path::extension(I->path()) == Ext)
+        ++Count;
+    EXPECT_FALSE(ec);
+    return Count;
+  }
+};
+
+TEST_F(LTOCacheTest, HitOnSecondCompile) {
+  std::vector<std::string> Objects;
+  ASSERT_TRUE(compile(Sources, 0, Objects));
+  ASSERT_EQ(2U, Objects.size());
+  EXPECT_NE(Marker, Objects[0]);
+  EXPECT_EQ(2U, overwriteEntries(".o", Marker));
+
+  ASSERT_TRUE(compile(Sources, 0, Objects));
+  ASSERT_EQ(2U, Objects.size());
+  EXPECT_EQ(Marker, Objects[0]);
+  EXPECT_EQ(Marker, Objects[1]);
+}
+
+TEST_F(LTOCacheTest, MissWhenModuleChanges) {
+  std::vector<std::string> Objects;
+  ASSERT_TRUE(compile(Sources, 0, Objects));
+  EXPECT_EQ(2U, overwriteEntries(".o", Marker));
+
+  // @main imports @f, so its object has to be built again as well.
+  Sources[1] =
+    "define i32 @f() {\n"
+    "  ret i32 2\n"
+    "}\n";
+  ASSERT_TRUE(compile(Sources, 0, Objects));
+  ASSERT_EQ(2U, Objects.size());
+  EXPECT_NE(Marker, Objects[0]);
+  EXPECT_NE(Marker, Objects[1]);
+}
+
+TEST_F(LTOCacheTest, MissWhenKeyDiffers) {
+  // An entry whose stored key doesn't match belongs to another key with the
+  // same hash.
+  std::vector<std::string> Objects;
+  ASSERT_TRUE(compile(Sources, 0, Objects));
+  EXPECT_EQ(2U, overwriteEntries(".o", Marker));
+  EXPECT_EQ(2U, overwriteEntries(".key", "some other key"));
+
+  ASSERT_TRUE(compile(Sources, 0, Objects));
+  ASSERT_EQ(2U, Objects.size());
+  EXPECT_NE(Marker, Objects[0]);
+  EXPECT_NE(Marker, Objects[1]);
+}
+
+// This is the only test that sets -lto-cache-size, and it comes last as the
+// limit stays in effect for the rest of the process.
+TEST_F(LTOCacheTest, PruneKeepsEntriesInUse) {
+  std::vector<std::string> Objects;
+  ASSERT_TRUE(compile(Sources, 0, Objects));
+  EXPECT_EQ(2U, countEntries(".o"));
+  EXPECT_EQ(2U, countEntries(".summary"));
+
+  // With no room at all, only the entries the second link uses are kept.
+  // The objects of the first link and the summary of the old @f go, which
+  // leaves one object per module rather than two, as @main imports @f.
+  Sources[1] =
+    "define i32 @f() {\n"
+    "  ret i32 2\n"
+    "}\n";
+  ASSERT_TRUE(compile(Sources, "-lto-cache-size=0", Objects));
+  ASSERT_EQ(2U, Objects.size());
+  EXPECT_EQ(2U, countEntries(".o"));
+  EXPECT_EQ(2U, countEntries(".key"));
+  EXPECT_EQ(2U, countEntries(".summary"));
+}
+
+}
+}
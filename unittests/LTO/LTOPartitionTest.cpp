@@ -0,0 +1,169 @@
+//===- llvm/unittest/LTO/LTOPartitionTest.cpp - LTO partitioning tests ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "LTOPartition.h"
+#include "llvm/Function.h"
+#include "llvm/GlobalAlias.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Assembly/Parser.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+#include <string>
+
+namespace llvm {
+namespace {
+
+// A chain of N adds, to give a function some weight.
+std::string padding(unsigned N) {
+  std::string Body;
+  for (unsigned i = 0; i != N; ++i)
+    Body += ("  %p" + Twine(i) + " = add i32 " +
+             (i ? "%p" + Twine(i - 1) : Twine("0")) + ", 1\n").str();
+  return Body;
+}
+
+class LTOPartitionTest : public testing::Test {
+protected:
+  Module *parse(const std::string &Source) {
+    M.reset(ParseAssemblyString(Source.c_str(), 0, Err, Context));
+    return M.get();
+  }
+
+  // The partition P assigned to GV, found by its position in the module.
+  unsigned partitionOf(const GlobalValue *GV) {
+    unsigned i = 0;
+    if (isa<Function>(GV)) {
+      for (Module::iterator I = M->begin(); &*I != GV; ++I)
+        ++i;
+      return P.functions[i];
+    }
+    if (isa<GlobalVariable>(GV)) {
+      for (Module::global_iterator I = M->global_begin(); &*I != GV; ++I)
+        ++i;
+      return P.globals[i];
+    }
+    for (Module::alias_iterator I = M->alias_begin(); &*I != GV; ++I)
+      ++i;
+    return P.aliases[i];
+  }
+
+  GlobalValue *get(StringRef Name) {
+    GlobalValue *GV = M->getNamedValue(Name);
+    EXPECT_TRUE(GV != 0) << "no global named " << Name.str();
+    return GV;
+  }
+
+  LLVMContext Context;
+  OwningPtr<Module> M;
+  SMDiagnostic Err;
+  LTOPartitioning P;
+};
+
+// @a and @b are heavy enough to end up in different partitions.  @only_a is
+// only called by @a but is defined after @b, so it stays with @a only if the
+// definitions are ordered along the call graph.  @helper is called from both.
+const std::string TwoCallers =
+  "define void @a() {\n" + padding(40) +
+  "  call void @only_a()\n"
+  "  call void @helper()\n"
+  "  ret void\n"
+  "}\n"
+  "define void @b() {\n" + padding(20) +
+  "  call void @helper()\n"
+  "  ret void\n"
+  "}\n"
+  "define internal void @helper() {\n"
+  "  ret void\n"
+  "}\n"
+  "define internal void @only_a() {\n"
+  "  ret void\n"
+  "}\n";
+
+TEST_F(LTOPartitionTest, SinglePartition) {
+  ASSERT_TRUE(parse(TwoCallers)) << Err.getMessage();
+  P.partition(*M, 1);
+  EXPECT_EQ(1U, P.numPartitions);
+  EXPECT_EQ(0U, partitionOf(get("a")));
+  EXPECT_EQ(0U, partitionOf(get("b")));
+  EXPECT_TRUE(get("helper")->hasLocalLinkage());
+}
+
+TEST_F(LTOPartitionTest, CalleesFollowCallers) {
+  ASSERT_TRUE(parse(TwoCallers)) << Err.getMessage();
+  P.partition(*M, 2);
+  EXPECT_EQ(2U, P.numPartitions);
+  EXPECT_NE(partitionOf(get("a")), partitionOf(get("b")));
+
+  GlobalValue *OnlyA = get("only_a");
+  EXPECT_EQ(partitionOf(get("a")), partitionOf(OnlyA));
+  EXPECT_TRUE(OnlyA->hasLocalLinkage());
+}
+
+TEST_F(LTOPartitionTest, PromotedLocalsAreHidden) {
+  ASSERT_TRUE(parse(TwoCallers)) << Err.getMessage();
+  P.partition(*M, 2);
+  ASSERT_EQ(2U, P.numPartitions);
+
+  // @helper is called from both partitions, so it is renamed apart from any
+  // other input's local of the same name and hidden from outside the link.
+  EXPECT_TRUE(M->getNamedValue("helper") == 0);
+  GlobalValue *Helper = get("helper.lto.0");
+  ASSERT_TRUE(Helper != 0);
+  EXPECT_TRUE(Helper->hasExternalLinkage());
+  EXPECT_TRUE(Helper->hasHiddenVisibility());
+  EXPECT_EQ(partitionOf(get("a")), partitionOf(Helper));
+}
+
+TEST_F(LTOPartitionTest, AliasFollowsAliasee) {
+  ASSERT_TRUE(parse(
+    "define void @a() {\n" + padding(40) +
+    "  ret void\n"
+    "}\n"
+    "define void @b() {\n" + padding(40) +
+    "  ret void\n"
+    "}\n"
+    "@alias_a = alias void ()* @a\n"
+    "@alias_b = alias void ()* @b\n")) << Err.getMessage();
+  P.partition(*M, 2);
+  EXPECT_EQ(2U, P.numPartitions);
+  EXPECT_NE(partitionOf(get("a")), partitionOf(get("b")));
+  EXPECT_EQ(partitionOf(get("a")), partitionOf(get("alias_a")));
+  EXPECT_EQ(partitionOf(get("b")), partitionOf(get("alias_b")));
+}
+
+TEST_F(LTOPartitionTest, BlockAddressFollowsBlock) {
+  // @g is half the weight of the module, so the cut falls right after it and
+  // only the blockaddress keeps @user and @table with it.
+  ASSERT_TRUE(parse(
+    "define void @g() {\n"
+    "entry:\n" + padding(40) +
+    "  br label %target\n"
+    "target:\n"
+    "  ret void\n"
+    "}\n"
+    "define i8* @user() {\n"
+    "  ret i8* blockaddress(@g, %target)\n"
+    "}\n"
+    "@table = global i8* blockaddress(@g, %target)\n"
+    "define void @h() {\n" + padding(40) +
+    "  ret void\n"
+    "}\n")) << Err.getMessage();
+  P.partition(*M, 2);
+  EXPECT_EQ(2U, P.numPartitions);
+  EXPECT_EQ(partitionOf(get("g")), partitionOf(get("table")));
+  EXPECT_EQ(partitionOf(get("g")), partitionOf(get("user")));
+  EXPECT_NE(partitionOf(get("g")), partitionOf(get("h")));
+}
+
+}
+}
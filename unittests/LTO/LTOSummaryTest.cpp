@@ -0,0 +1,195 @@
+//===- llvm/unittest/LTO/LTOSummaryTest.cpp - LTO module summary tests ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "LTOSummary.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Assembly/Parser.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <string>
+
+namespace llvm {
+namespace {
+
+typedef LTOModuleSummary::Definition Definition;
+typedef LTOModuleSummary::ModuleAndDefinition ModuleAndDefinition;
+
+const Definition *findDefinition(const LTOModuleSummary &S, StringRef Name) {
+  for (unsigned i = 0, e = S.definitions.size(); i != e; ++i)
+    if (S.definitions[i].name == Name)
+      return &S.definitions[i];
+  return 0;
+}
+
+bool contains(const std::vector<std::string> &Names, StringRef Name) {
+  return std::find(Names.begin(), Names.end(), Name.str()) != Names.end();
+}
+
+Definition makeDefinition(StringRef Name, bool Weak, bool Common = false) {
+  Definition D;
+  D.name = Name;
+  D.kind = Common ? 'v' : 'f';
+  D.weak = Weak || Common;
+  D.common = Common;
+  D.importable = false;
+  D.size = 0;
+  return D;
+}
+
+TEST(LTOSummaryTest, ComputeWriteRead) {
+  LLVMContext Context;
+  SMDiagnostic Err;
+  OwningPtr<Module> M(ParseAssemblyString(
+    "@g = global i32 1\n"
+    "@c = common global i32 0\n"
+    "@local = internal global i32 2\n"
+    "define i32 @small() {\n"
+    "  %v = load i32* @g\n"
+    "  ret i32 %v\n"
+    "}\n"
+    "define weak void @w() {\n"
+    "  ret void\n"
+    "}\n"
+    "define i32 @uses_local() {\n"
+    "  %v = load i32* @local\n"
+    "  ret i32 %v\n"
+    "}\n"
+    "define i32 @caller() {\n"
+    "  %v = call i32 @small()\n"
+    "  call void @ext()\n"
+    "  ret i32 %v\n"
+    "}\n"
+    "declare void @ext()\n"
+    "@alias = alias i32 ()* @small\n", 0, Err, Context));
+  ASSERT_TRUE(M != 0) << Err.getMessage();
+
+  LTOModuleSummary S;
+  S.compute(*M);
+
+  const Definition *Small = findDefinition(S, "small");
+  ASSERT_TRUE(Small != 0);
+  EXPECT_EQ('f', Small->kind);
+  EXPECT_FALSE(Small->weak);
+  EXPECT_TRUE(Small->importable);
+  EXPECT_EQ(2U, Small->size);
+  ASSERT_EQ(1U, Small->refs.size());
+  EXPECT_EQ("g", Small->refs[0]);
+
+  const Definition *W = findDefinition(S, "w");
+  ASSERT_TRUE(W != 0);
+  EXPECT_TRUE(W->weak);
+  EXPECT_FALSE(W->importable);
+
+  // A body that refers to a local symbol can't be copied elsewhere.
+  const Definition *UsesLocal = findDefinition(S, "uses_local");
+  ASSERT_TRUE(UsesLocal != 0);
+  EXPECT_FALSE(UsesLocal->importable);
+
+  const Definition *C = findDefinition(S, "c");
+  ASSERT_TRUE(C != 0);
+  EXPECT_EQ('v', C->kind);
+  EXPECT_TRUE(C->common);
+
+  ASSERT_TRUE(findDefinition(S, "alias") != 0);
+  EXPECT_EQ('a', findDefinition(S, "alias")->kind);
+  EXPECT_TRUE(findDefinition(S, "local") == 0);
+
+  EXPECT_TRUE(contains(S.references, "ext"));
+  EXPECT_TRUE(contains(S.references, "g"));
+  EXPECT_FALSE(contains(S.references, "local"));
+  EXPECT_TRUE(contains(S.calls, "small"));
+  EXPECT_TRUE(contains(S.calls, "ext"));
+
+  std::string Text;
+  raw_string_ostream OS(Text);
+  ASSERT_FALSE(S.write(OS));
+  OS.flush();
+
+  LTOModuleSummary R;
+  ASSERT_FALSE(R.read(Text));
+  ASSERT_EQ(S.definitions.size(), R.definitions.size());
+  for (unsigned i = 0, e = S.definitions.size(); i != e; ++i) {
+    const Definition &A = S.definitions[i], &B = R.definitions[i];
+    EXPECT_EQ(A.name, B.name);
+    EXPECT_EQ(A.kind, B.kind);
+    EXPECT_EQ(A.weak, B.weak);
+    EXPECT_EQ(A.common, B.common);
+    EXPECT_EQ(A.importable, B.importable);
+    EXPECT_EQ(A.size, B.size);
+    EXPECT_TRUE(A.refs == B.refs) << A.name;
+  }
+  EXPECT_TRUE(S.references == R.references);
+  EXPECT_TRUE(S.calls == R.calls);
+}
+
+TEST(LTOSummaryTest, ReadRejectsGarbage) {
+  LTOModuleSummary S;
+  EXPECT_TRUE(S.read(""));
+  EXPECT_TRUE(S.read("LLVM LTO summary 0\n"));
+  EXPECT_TRUE(S.read("LLVM LTO summary 1\nx y\n"));
+  EXPECT_TRUE(S.read("LLVM LTO summary 1\nd f--- 3 q f\n"));
+  EXPECT_TRUE(S.read("LLVM LTO summary 1\nr f\n"));
+}
+
+TEST(LTOSummaryTest, WriteRejectsNewlines) {
+  LTOModuleSummary S;
+  S.references.push_back("a\nb");
+  std::string Text;
+  raw_string_ostream OS(Text);
+  EXPECT_TRUE(S.write(OS));
+}
+
+TEST(LTOSummaryTest, StrongDefinitionPrevails) {
+  std::vector<LTOModuleSummary> Summaries(3);
+  Summaries[0].definitions.push_back(makeDefinition("f", true));
+  Summaries[1].definitions.push_back(makeDefinition("f", false));
+  Summaries[2].definitions.push_back(makeDefinition("f", true));
+  Summaries[1].definitions.push_back(makeDefinition("g", true));
+  Summaries[2].definitions.push_back(makeDefinition("g", true));
+
+  StringMap<ModuleAndDefinition> Prevailing;
+  std::string ErrMsg;
+  ASSERT_FALSE(LTOModuleSummary::findPrevailing(Summaries, Prevailing,
+                                                ErrMsg)) << ErrMsg;
+  EXPECT_EQ(1U, Prevailing["f"].first);
+  EXPECT_FALSE(Prevailing["f"].second->weak);
+  // Among weak definitions only, the first one wins.
+  EXPECT_EQ(1U, Prevailing["g"].first);
+}
+
+TEST(LTOSummaryTest, CommonIsLeftToTheLinker) {
+  std::vector<LTOModuleSummary> Summaries(2);
+  Summaries[0].definitions.push_back(makeDefinition("c", false, true));
+  Summaries[1].definitions.push_back(makeDefinition("c", false, true));
+
+  StringMap<ModuleAndDefinition> Prevailing;
+  std::string ErrMsg;
+  ASSERT_FALSE(LTOModuleSummary::findPrevailing(Summaries, Prevailing,
+                                                ErrMsg)) << ErrMsg;
+  EXPECT_EQ(0U, Prevailing.count("c"));
+}
+
+TEST(LTOSummaryTest, MultipleStrongDefinitions) {
+  std::vector<LTOModuleSummary> Summaries(2);
+  Summaries[0].definitions.push_back(makeDefinition("f", false));
+  Summaries[1].definitions.push_back(makeDefinition("f", false));
+
+  StringMap<ModuleAndDefinition> Prevailing;
+  std::string ErrMsg;
+  EXPECT_TRUE(LTOModuleSummary::findPrevailing(Summaries, Prevailing,
+                                               ErrMsg));
+  EXPECT_EQ("symbol multiply defined: f", ErrMsg);
+}
+
+}
+}
@@ -0,0 +1,88 @@
+//===- llvm/unittest/MC/MCContextTest.cpp - MCContext tests ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCSectionELF.h"
+#include "llvm/MC/MCSymbol.h"
+#include "llvm/MC/SectionKind.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/ELF.h"
+#include "llvm/Support/Threading.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace llvm {
+namespace {
+
+const unsigned NumThreads = 8;
+const unsigned NumNames = 4096;
+
+// What one thread creates in the shared context: a symbol and a section for
+// each of the names all threads use, plus temporary symbols of its own.
+struct ContextUser {
+  MCContext *Ctx;
+  std::vector<MCSymbol*> Symbols;
+  std::vector<const MCSection*> Sections;
+  std::vector<MCSymbol*> Temps;
+
+  static void run(void *Arg) {
+    ContextUser *U = static_cast<ContextUser*>(Arg);
+    MCContext &Ctx = *U->Ctx;
+    for (unsigned i = 0; i != NumNames; ++i) {
+      U->Symbols.push_back(Ctx.GetOrCreateSymbol("sym" + utostr(i)));
+      U->Sections.push_back(
+        Ctx.getELFSection(".text.f" + utostr(i), ELF::SHT_PROGBITS,
+                          ELF::SHF_ALLOC | ELF::SHF_EXECINSTR,
+                          SectionKind::getText()));
+      U->Temps.push_back(Ctx.CreateTempSymbol());
+    }
+  }
+};
+
+TEST(MCContextTest, ConcurrentSymbolsAndSections) {
+  // Without thread support, the users run one after another.
+  bool StartedThreads = !llvm_is_multithreaded() && llvm_start_multithreaded();
+
+  MCAsmInfo MAI;
+  MCContext Ctx(MAI, 0);
+  Ctx.setShared(true);
+  std::vector<ContextUser> Users(NumThreads);
+  std::vector<void*> Args;
+  for (unsigned i = 0; i != NumThreads; ++i) {
+    Users[i].Ctx = &Ctx;
+    Args.push_back(&Users[i]);
+  }
+  llvm_execute_on_threads(ContextUser::run, &Args[0], NumThreads);
+
+  if (StartedThreads)
+    llvm_stop_multithreaded();
+
+  // Every thread got the same symbol and section for the same name.
+  for (unsigned t = 1; t != NumThreads; ++t)
+    for (unsigned i = 0; i != NumNames; ++i) {
+      EXPECT_EQ(Users[0].Symbols[i], Users[t].Symbols[i]) << "sym" << i;
+      EXPECT_EQ(Users[0].Sections[i], Users[t].Sections[i]) << "section " << i;
+    }
+  for (unsigned i = 0; i != NumNames; ++i) {
+    EXPECT_EQ("sym" + utostr(i), Users[0].Symbols[i]->getName().str());
+    EXPECT_EQ(Users[0].Symbols[i],
+              Ctx.LookupSymbol("sym" + utostr(i)));
+  }
+
+  // Temporary symbols all got distinct names.
+  StringSet<> TempNames;
+  for (unsigned t = 0; t != NumThreads; ++t)
+    for (unsigned i = 0; i != NumNames; ++i)
+      EXPECT_TRUE(TempNames.insert(Users[t].Temps[i]->getName()));
+}
+
+}
+}
@@ -219,6 +219,20 @@ TEST_F(FileSystemTest, TempFiles) {
   EXPECT_FALSE(TempFileExists);
 }
 
+TEST_F(FileSystemTest, CreateDirectories) {
+  SmallString<128> Nested(TestDirectory);
+  path::append(Nested, "a", "b", "c");
+  bool Existed;
+  ASSERT_NO_ERROR(fs::create_directories(Twine(Nested), Existed));
+  EXPECT_FALSE(Existed);
+  bool IsDirectory;
+  ASSERT_NO_ERROR(fs::is_directory(Twine(Nested), IsDirectory));
+  EXPECT_TRUE(IsDirectory);
+
+  ASSERT_NO_ERROR(fs::create_directories(Twine(Nested), Existed));
+  EXPECT_TRUE(Existed);
+}
+
 TEST_F(FileSystemTest, DirectoryIteration) {
   error_code ec;
   for (fs::directory_iterator i(".", ec), e; i != e; i.increment(ec))
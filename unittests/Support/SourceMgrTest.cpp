@@ -0,0 +1,102 @@
+//===- llvm/unittest/Support/SourceMgrTest.cpp - SourceMgr tests ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+class SourceMgrTest : public testing::Test {
+protected:
+  unsigned addBuffer(StringRef Text) {
+    return SM.AddNewSourceBuffer(MemoryBuffer::getMemBufferCopy(Text), SMLoc());
+  }
+
+  SMLoc getLoc(unsigned BufferID, unsigned Offset) {
+    return SMLoc::getFromPointer(
+      SM.getMemoryBuffer(BufferID)->getBufferStart() + Offset);
+  }
+
+  SourceMgr SM;
+};
+
+TEST_F(SourceMgrTest, LineAndColumn) {
+  unsigned B = addBuffer("abc\n\ndef\r\nghi");
+
+  const unsigned Expected[][3] = {
+    // Offset, line, column.
+    { 0, 1, 0 }, { 3, 1, 3 }, { 4, 2, 0 }, { 7, 3, 2 }, { 9, 3, 4 },
+    { 10, 4, 0 },
+    // The end of the buffer is a valid location too.
+    { 13, 4, 3 }
+  };
+  for (unsigned i = 0; i != array_lengthof(Expected); ++i) {
+    std::pair<unsigned, unsigned> LineAndCol =
+      SM.getLineAndColumn(getLoc(B, Expected[i][0]));
+    EXPECT_EQ(Expected[i][1], LineAndCol.first) << "offset " << Expected[i][0];
+    EXPECT_EQ(Expected[i][2], LineAndCol.second) << "offset " << Expected[i][0];
+  }
+}
+
+TEST_F(SourceMgrTest, OutOfOrderQueries) {
+  std::string Text;
+  for (unsigned i = 0; i != 1000; ++i)
+    Text += "0123456789\n";
+  unsigned B1 = addBuffer(Text);
+  unsigned B2 = addBuffer("x\ny\nz");
+
+  for (unsigned i = 1000; i-- != 0; ) {
+    EXPECT_EQ(i + 1, SM.FindLineNumber(getLoc(B1, i * 11 + i % 11)));
+    EXPECT_EQ(i % 3 + 1, SM.FindLineNumber(getLoc(B2, i % 3 * 2)));
+  }
+  EXPECT_EQ(1001U, SM.FindLineNumber(getLoc(B1, Text.size()), B1));
+}
+
+TEST_F(SourceMgrTest, GetMessage) {
+  unsigned B = addBuffer("first line\n  second line\nthird");
+
+  SMDiagnostic D = SM.GetMessage(getLoc(B, 13), "msg", "error");
+  EXPECT_EQ(2, D.getLineNo());
+  EXPECT_EQ(2, D.getColumnNo());
+  EXPECT_EQ("  second line", D.getLineContents());
+  EXPECT_EQ("error: msg", D.getMessage());
+
+  D = SM.GetMessage(getLoc(B, 30), "msg", "error");
+  EXPECT_EQ(3, D.getLineNo());
+  EXPECT_EQ(5, D.getColumnNo());
+  EXPECT_EQ("third", D.getLineContents());
+}
+
+TEST_F(SourceMgrTest, GetMessageAfterCarriageReturn) {
+  // A '\r' starts the line shown, as it did before line starts were indexed,
+  // but only '\n' counts towards the line number.
+  unsigned B = addBuffer("one\r\ntwo\rthree\nfour");
+
+  SMDiagnostic D = SM.GetMessage(getLoc(B, 1), "msg", "error");
+  EXPECT_EQ(1, D.getLineNo());
+  EXPECT_EQ(1, D.getColumnNo());
+  EXPECT_EQ("one", D.getLineContents());
+
+  D = SM.GetMessage(getLoc(B, 11), "msg", "error");
+  EXPECT_EQ(2, D.getLineNo());
+  EXPECT_EQ(2, D.getColumnNo());
+  EXPECT_EQ("three", D.getLineContents());
+
+  D = SM.GetMessage(getLoc(B, 6), "msg", "error");
+  EXPECT_EQ(2, D.getLineNo());
+  EXPECT_EQ(1, D.getColumnNo());
+  EXPECT_EQ("two", D.getLineContents());
+}
+
+}  // end anonymous namespace
@@ -9,7 +9,9 @@
 
 #include "gtest/gtest.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
@@ -143,4 +145,22 @@ TEST(raw_ostreamTest, WriteEscaped) {
   EXPECT_EQ("\\001\\010\\200", Str);
 }
 
+TEST(raw_ostreamTest, FormattedSVectorTell) {
+  SmallVector<char, 0> Vec;
+  {
+    raw_svector_ostream SOS(Vec);
+    formatted_raw_ostream OS(SOS);
+    OS.SetBufferSize(16);
+    std::string Expected;
+    for (unsigned i = 0; i != 100; ++i) {
+      std::string Chunk(i % 37, 'a' + i % 26);
+      OS << Chunk;
+      Expected += Chunk;
+      EXPECT_EQ(Expected.size(), OS.tell());
+    }
+    OS.flush();
+    EXPECT_EQ(Expected, SOS.str().str());
+  }
+}
+
 }
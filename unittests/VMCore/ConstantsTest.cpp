@@ -9,7 +9,10 @@
 
 #include "llvm/Constants.h"
 #include "llvm/DerivedTypes.h"
+#include "llvm/GlobalVariable.h"
 #include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Support/ValueHandle.h"
 #include "gtest/gtest.h"
 
 namespace llvm {
@@ -118,5 +121,109 @@ TEST(ConstantsTest, FP128Test) {
   EXPECT_TRUE(isa<ConstantFP>(X));
 }
 
+TEST(ConstantsTest, Uniquing) {
+  LLVMContext C;
+  const Type *Int32Ty = Type::getInt32Ty(C);
+  const ArrayType *ArrTy = ArrayType::get(Int32Ty, 2);
+
+  // Enough constants to make the tables grow a few times.
+  std::vector<Constant*> Exprs, Arrays;
+  for (unsigned i = 0; i != 1000; ++i) {
+    Constant *A = ConstantInt::get(Int32Ty, i);
+    Constant *B = ConstantInt::get(Int32Ty, i + 1);
+    Exprs.push_back(ConstantExpr::getAdd(A, B));
+    Constant *Elts[] = { A, B };
+    Arrays.push_back(ConstantArray::get(ArrTy, Elts, 2));
+  }
+  for (unsigned i = 0; i != 1000; ++i) {
+    Constant *A = ConstantInt::get(Int32Ty, i);
+    Constant *B = ConstantInt::get(Int32Ty, i + 1);
+    EXPECT_EQ(Exprs[i], ConstantExpr::getAdd(A, B));
+    Constant *Elts[] = { A, B };
+    EXPECT_EQ(Arrays[i], ConstantArray::get(ArrTy, Elts, 2));
+  }
+
+  // Replacing an operand moves the constant to its new key.
+  Module M("uniquing", C);
+  const PointerType *PtrTy = PointerType::getUnqual(Int32Ty);
+  const ArrayType *PtrArrTy = ArrayType::get(PtrTy, 2);
+  GlobalVariable *G1 = new GlobalVariable(M, Int32Ty, false,
+                                          GlobalValue::ExternalLinkage, 0,
+                                          "g1");
+  GlobalVariable *G2 = new GlobalVariable(M, Int32Ty, false,
+                                          GlobalValue::ExternalLinkage, 0,
+                                          "g2");
+  Constant *Old[] = { G1, ConstantPointerNull::get(PtrTy) };
+  WeakVH Arr = ConstantArray::get(PtrArrTy, Old, 2);
+  G1->replaceAllUsesWith(G2);
+  Constant *New[] = { G2, ConstantPointerNull::get(PtrTy) };
+  EXPECT_EQ((Value*)Arr, ConstantArray::get(PtrArrTy, New, 2));
+  EXPECT_EQ(G2, cast<Constant>(Arr)->getOperand(0));
+  G1->eraseFromParent();
+}
+
+TEST(ConstantsTest, UniquingRefinement) {
+  LLVMContext C;
+  const Type *Int32Ty = Type::getInt32Ty(C);
+
+  // Two structurally identical constants of different abstract types merge
+  // once the types are refined to the same concrete type.
+  PATypeHolder O1 = OpaqueType::get(C);
+  PATypeHolder O2 = OpaqueType::get(C);
+  WeakVH Null1 = ConstantPointerNull::get(PointerType::getUnqual(O1.get()));
+  WeakVH Null2 = ConstantPointerNull::get(PointerType::getUnqual(O2.get()));
+  EXPECT_NE((Value*)Null1, (Value*)Null2);
+
+  PATypeHolder S1 = StructType::get(C, Int32Ty,
+                                    PointerType::getUnqual(O1.get()), NULL);
+  std::vector<Constant*> Elts;
+  Elts.push_back(ConstantInt::get(Int32Ty, 7));
+  Elts.push_back(cast<Constant>(Null1));
+  WeakVH CS = ConstantStruct::get(cast<StructType>(S1.get()), Elts);
+
+  cast<OpaqueType>(O1.get())->refineAbstractTypeTo(Int32Ty);
+  cast<OpaqueType>(O2.get())->refineAbstractTypeTo(Int32Ty);
+
+  const PointerType *PtrTy = PointerType::getUnqual(Int32Ty);
+  Constant *Null = ConstantPointerNull::get(PtrTy);
+  EXPECT_EQ(Null, (Value*)Null1);
+  EXPECT_EQ(Null, (Value*)Null2);
+
+  const StructType *STy = StructType::get(C, Int32Ty, PtrTy, NULL);
+  Elts[1] = Null;
+  EXPECT_EQ(ConstantStruct::get(STy, Elts), (Value*)CS);
+  EXPECT_EQ(STy, CS->getType());
+}
+
+// Builds millions of constants through the uniquing tables. Run it with
+// --gtest_also_run_disabled_tests --gtest_filter=*UniquingBenchmark to time
+// them.
+TEST(ConstantsTest, DISABLED_UniquingBenchmark) {
+  LLVMContext C;
+  Module M("UniquingBenchmark", C);
+  const Type *Int64Ty = Type::getInt64Ty(C);
+  const ArrayType *ArrTy = ArrayType::get(Int64Ty, 2);
+  const StructType *STy = StructType::get(C, Int64Ty, Int64Ty, NULL);
+  Constant *G = ConstantExpr::getPtrToInt(
+    new GlobalVariable(M, Int64Ty, false, GlobalValue::ExternalLinkage, 0, "G"),
+    Int64Ty);
+
+  const unsigned N = 1000000;
+  std::vector<Constant*> Ints;
+  Ints.reserve(N + 1);
+  for (unsigned i = 0; i != N + 1; ++i)
+    Ints.push_back(ConstantInt::get(Int64Ty, i));
+
+  // Create each shape, then look all of them up again in a scrambled order.
+  for (unsigned Round = 0; Round != 2; ++Round)
+    for (unsigned j = 0; j != N; ++j) {
+      unsigned i = Round ? (j * 7919ULL) % N : j;
+      std::vector<Constant*> Elts(&Ints[i], &Ints[i] + 2);
+      ConstantExpr::getAdd(G, Ints[i]);
+      ConstantArray::get(ArrTy, Elts);
+      ConstantStruct::get(STy, Elts);
+    }
+}
+
 }  // end anonymous namespace
 }  // end namespace llvm
@@ -0,0 +1,278 @@
+//===- llvm/unittest/VMCore/DominatorTreeTest.cpp - Dominator tree tests --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "gtest/gtest.h"
+
+namespace llvm {
+namespace {
+
+// Every block ends in an indirectbr, so CFG edges can be added and removed
+// just by editing its destination list.
+class DominatorTreeTest : public testing::Test {
+protected:
+  LLVMContext &C;
+  OwningPtr<Function> F;
+  SmallVector<BasicBlock*, 16> Blocks;
+  unsigned Seed;
+
+  DominatorTreeTest() : C(getGlobalContext()), Seed(42) {}
+
+  void makeFunction(unsigned NumBlocks) {
+    FunctionType *FTy = FunctionType::get(Type::getVoidTy(C), false);
+    F.reset(Function::Create(FTy, GlobalValue::ExternalLinkage));
+    Value *Addr = ConstantPointerNull::get(Type::getInt8PtrTy(C));
+    for (unsigned i = 0; i != NumBlocks; ++i) {
+      BasicBlock *BB = BasicBlock::Create(C, "", F.get());
+      IndirectBrInst::Create(Addr, 4, BB);
+      Blocks.push_back(BB);
+    }
+  }
+
+  static IndirectBrInst *getBr(BasicBlock *BB) {
+    return cast<IndirectBrInst>(BB->getTerminator());
+  }
+
+  void addEdge(BasicBlock *From, BasicBlock *To) {
+    getBr(From)->addDestination(To);
+  }
+
+  void removeEdge(BasicBlock *From, BasicBlock *To) {
+    IndirectBrInst *Br = getBr(From);
+    for (unsigned i = 0, e = Br->getNumDestinations(); i != e; ++i)
+      if (Br->getDestination(i) == To) {
+        Br->removeDestination(i);
+        return;
+      }
+    FAIL() << "no such edge";
+  }
+
+  bool hasEdge(BasicBlock *From, BasicBlock *To) {
+    IndirectBrInst *Br = getBr(From);
+    for (unsigned i = 0, e = Br->getNumDestinations(); i != e; ++i)
+      if (Br->getDestination(i) == To)
+        return true;
+    return false;
+  }
+
+  unsigned random(unsigned N) {
+    Seed = Seed * 1103515245 + 12345;
+    return ((Seed >> 16) & 0x7fff) % N;
+  }
+
+  // Return true if DT matches a tree computed from scratch and every node's
+  // level is one more than its immediate dominator's.
+  bool isUpToDate(DominatorTree &DT) {
+    DominatorTree Fresh;
+    Fresh.runOnFunction(*F);
+    if (DT.compare(Fresh))
+      return false;
+    for (unsigned i = 0, e = Blocks.size(); i != e; ++i)
+      if (DomTreeNode *N = DT.getNode(Blocks[i])) {
+        DomTreeNode *IDom = N->getIDom();
+        if (N->getLevel() != (IDom ? IDom->getLevel() + 1 : 0))
+          return false;
+      }
+    return true;
+  }
+
+  // Add a random edge that does not exist yet, never into the entry block.
+  bool randomInsert(DominatorTree::UpdateType *U) {
+    for (unsigned Tries = 0; Tries != 100; ++Tries) {
+      BasicBlock *From = Blocks[random(Blocks.size())];
+      BasicBlock *To = Blocks[1 + random(Blocks.size() - 1)];
+      if (hasEdge(From, To))
+        continue;
+      addEdge(From, To);
+      *U = DominatorTree::UpdateType(DomTreeUpdate::Insert, From, To);
+      return true;
+    }
+    return false;
+  }
+
+  // Remove a random edge, if there is one.
+  bool randomDelete(DominatorTree::UpdateType *U) {
+    for (unsigned Tries = 0; Tries != 100; ++Tries) {
+      BasicBlock *From = Blocks[random(Blocks.size())];
+      IndirectBrInst *Br = getBr(From);
+      if (Br->getNumDestinations() == 0)
+        continue;
+      BasicBlock *To = Br->getDestination(random(Br->getNumDestinations()));
+      removeEdge(From, To);
+      *U = DominatorTree::UpdateType(DomTreeUpdate::Delete, From, To);
+      return true;
+    }
+    return false;
+  }
+};
+
+TEST_F(DominatorTreeTest, InsertEdge) {
+  // 0 -> 1 -> 2 -> 3, then 0 -> 3.
+  makeFunction(4);
+  addEdge(Blocks[0], Blocks[1]);
+  addEdge(Blocks[1], Blocks[2]);
+  addEdge(Blocks[2], Blocks[3]);
+  DominatorTree DT;
+  DT.runOnFunction(*F);
+  EXPECT_EQ(Blocks[2], DT.getNode(Blocks[3])->getIDom()->getBlock());
+  EXPECT_EQ(3U, DT.getNode(Blocks[3])->getLevel());
+
+  addEdge(Blocks[0], Blocks[3]);
+  DT.insertEdge(Blocks[0], Blocks[3]);
+  EXPECT_EQ(Blocks[0], DT.getNode(Blocks[3])->getIDom()->getBlock());
+  EXPECT_EQ(1U, DT.getNode(Blocks[3])->getLevel());
+  EXPECT_TRUE(isUpToDate(DT));
+}
+
+TEST_F(DominatorTreeTest, InsertEdgeToUnreachable) {
+  // 0 -> 1 -> 3; 2 -> 3 and 2 -> 4 are unreachable until 0 -> 2 is added.
+  makeFunction(5);
+  addEdge(Blocks[0], Blocks[1]);
+  addEdge(Blocks[1], Blocks[3]);
+  addEdge(Blocks[2], Blocks[3]);
+  addEdge(Blocks[2], Blocks[4]);
+  DominatorTree DT;
+  DT.runOnFunction(*F);
+  EXPECT_EQ(0, DT.getNode(Blocks[2]));
+  EXPECT_EQ(Blocks[1], DT.getNode(Blocks[3])->getIDom()->getBlock());
+
+  addEdge(Blocks[0], Blocks[2]);
+  DT.insertEdge(Blocks[0], Blocks[2]);
+  EXPECT_EQ(Blocks[2], DT.getNode(Blocks[4])->getIDom()->getBlock());
+  EXPECT_EQ(Blocks[0], DT.getNode(Blocks[3])->getIDom()->getBlock());
+  EXPECT_TRUE(isUpToDate(DT));
+}
+
+TEST_F(DominatorTreeTest, DeleteEdge) {
+  // 0 -> 1 -> 3 and 0 -> 2 -> 3, then 2 -> 3 goes away.
+  makeFunction(4);
+  addEdge(Blocks[0], Blocks[1]);
+  addEdge(Blocks[0], Blocks[2]);
+  addEdge(Blocks[1], Blocks[3]);
+  addEdge(Blocks[2], Blocks[3]);
+  DominatorTree DT;
+  DT.runOnFunction(*F);
+  EXPECT_EQ(Blocks[0], DT.getNode(Blocks[3])->getIDom()->getBlock());
+
+  removeEdge(Blocks[2], Blocks[3]);
+  DT.deleteEdge(Blocks[2], Blocks[3]);
+  EXPECT_EQ(Blocks[1], DT.getNode(Blocks[3])->getIDom()->getBlock());
+  EXPECT_TRUE(isUpToDate(DT));
+}
+
+TEST_F(DominatorTreeTest, DeleteEdgeMakesUnreachable) {
+  // 0 -> 1 -> 5, 0 -> 2 -> 3 -> 4 -> 5.  Cutting 3 -> 4 drops 4 and leaves 5
+  // reachable only through 1.
+  makeFunction(6);
+  addEdge(Blocks[0], Blocks[1]);
+  addEdge(Blocks[0], Blocks[2]);
+  addEdge(Blocks[1], Blocks[5]);
+  addEdge(Blocks[2], Blocks[3]);
+  addEdge(Blocks[3], Blocks[4]);
+  addEdge(Blocks[4], Blocks[5]);
+  DominatorTree DT;
+  DT.runOnFunction(*F);
+  EXPECT_EQ(Blocks[0], DT.getNode(Blocks[5])->getIDom()->getBlock());
+
+  removeEdge(Blocks[3], Blocks[4]);
+  DT.deleteEdge(Blocks[3], Blocks[4]);
+  EXPECT_EQ(0, DT.getNode(Blocks[4]));
+  EXPECT_EQ(Blocks[1], DT.getNode(Blocks[5])->getIDom()->getBlock());
+  EXPECT_TRUE(isUpToDate(DT));
+}
+
+TEST_F(DominatorTreeTest, DeleteDuplicateEdge) {
+  makeFunction(3);
+  addEdge(Blocks[0], Blocks[1]);
+  addEdge(Blocks[0], Blocks[1]);
+  addEdge(Blocks[1], Blocks[2]);
+  DominatorTree DT;
+  DT.runOnFunction(*F);
+
+  removeEdge(Blocks[0], Blocks[1]);
+  DT.deleteEdge(Blocks[0], Blocks[1]);
+  EXPECT_TRUE(DT.getNode(Blocks[2]) != 0);
+  EXPECT_TRUE(isUpToDate(DT));
+}
+
+TEST_F(DominatorTreeTest, RandomUpdates) {
+  makeFunction(12);
+  for (unsigned i = 0; i != 16; ++i)
+    addEdge(Blocks[random(12)], Blocks[1 + random(11)]);
+  DominatorTree DT;
+  DT.runOnFunction(*F);
+
+  DominatorTree::UpdateType U(DomTreeUpdate::Insert, 0, 0);
+  for (unsigned i = 0; i != 2000; ++i) {
+    if (random(2)) {
+      if (randomInsert(&U))
+        DT.insertEdge(U.From, U.To);
+    } else if (randomDelete(&U)) {
+      DT.deleteEdge(U.From, U.To);
+    }
+    ASSERT_TRUE(isUpToDate(DT)) << "after update " << i;
+  }
+}
+
+TEST_F(DominatorTreeTest, RandomBatches) {
+  makeFunction(12);
+  for (unsigned i = 0; i != 16; ++i)
+    addEdge(Blocks[random(12)], Blocks[1 + random(11)]);
+  DominatorTree DT;
+  DT.runOnFunction(*F);
+
+  for (unsigned i = 0; i != 500; ++i) {
+    SmallVector<DominatorTree::UpdateType, 8> Updates;
+    for (unsigned n = 1 + random(6); n != 0; --n) {
+      DominatorTree::UpdateType U(DomTreeUpdate::Insert, 0, 0);
+      if (random(2) ? randomInsert(&U) : randomDelete(&U))
+        Updates.push_back(U);
+    }
+    DT.applyUpdates(Updates);
+    ASSERT_TRUE(isUpToDate(DT)) << "after batch " << i;
+  }
+}
+
+TEST_F(DominatorTreeTest, BatchWithErasedBlock) {
+  // 0 -> 1 -> 2 -> 3 and 0 -> 3.  Block 2 is erased and 1 branches to 3.
+  makeFunction(4);
+  addEdge(Blocks[0], Blocks[1]);
+  addEdge(Blocks[0], Blocks[3]);
+  addEdge(Blocks[1], Blocks[2]);
+  addEdge(Blocks[2], Blocks[3]);
+  DominatorTree DT;
+  DT.runOnFunction(*F);
+
+  BasicBlock *Dead = Blocks[2];
+  removeEdge(Blocks[1], Dead);
+  addEdge(Blocks[1], Blocks[3]);
+  Dead->eraseFromParent();
+  Blocks.erase(Blocks.begin() + 2);
+
+  SmallVector<DominatorTree::UpdateType, 4> Updates;
+  Updates.push_back(DominatorTree::UpdateType(DomTreeUpdate::Delete,
+                                              Blocks[1], Dead));
+  Updates.push_back(DominatorTree::UpdateType(DomTreeUpdate::Delete,
+                                              Dead, Blocks[2]));
+  Updates.push_back(DominatorTree::UpdateType(DomTreeUpdate::Insert,
+                                              Blocks[1], Blocks[2]));
+  DT.applyUpdates(Updates, Dead);
+  EXPECT_EQ(0, DT.getNode(Dead));
+  EXPECT_TRUE(isUpToDate(DT));
+}
+
+}
+}
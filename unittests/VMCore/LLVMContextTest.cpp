@@ -0,0 +1,168 @@
+//===- llvm/unittest/VMCore/LLVMContextTest.cpp - LLVMContext tests -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/BasicBlock.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
+#include "llvm/Module.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace llvm {
+namespace {
+
+// The shared values every function body refers to.
+struct SharedValues {
+  Function *Callee;
+  GlobalVariable *G;
+  unsigned KindID;
+};
+
+// Build the bodies of some functions of i32 (i32).  Every function adds the
+// same integer constants, xors with the same constant expression, calls the
+// same callee and tags its instructions with the same metadata.
+struct BodyBuilder {
+  const SharedValues *Shared;
+  std::vector<Function*> Functions;
+  unsigned NumOps;
+
+  static void run(void *Arg) {
+    BodyBuilder *B = static_cast<BodyBuilder*>(Arg);
+    for (unsigned i = 0, e = B->Functions.size(); i != e; ++i)
+      B->build(B->Functions[i]);
+  }
+
+  void build(Function *F) {
+    LLVMContext &C = F->getContext();
+    const Type *I32 = Type::getInt32Ty(C);
+    BasicBlock *BB = BasicBlock::Create(C, "entry", F);
+    Value *Acc = F->arg_begin();
+    for (unsigned j = 0; j != NumOps; ++j) {
+      Instruction *I;
+      if (j % 16 == 15)
+        I = CallInst::Create(Shared->Callee, Acc, "", BB);
+      else if (j % 2)
+        I = BinaryOperator::CreateXor(
+          Acc, ConstantExpr::getPtrToInt(Shared->G, I32), "", BB);
+      else
+        I = BinaryOperator::CreateAdd(Acc, ConstantInt::get(I32, j % 64),
+                                      "", BB);
+      Value *Elts[] = { ConstantInt::get(I32, j % 8) };
+      I->setMetadata(Shared->KindID, MDNode::get(C, Elts));
+      Acc = I;
+    }
+    ReturnInst::Create(C, Acc, BB);
+  }
+};
+
+// Declare NumFunctions functions in M and build their bodies on NumThreads
+// threads.
+static void BuildConcurrently(Module &M, const SharedValues &Shared,
+                              unsigned NumFunctions, unsigned NumOps,
+                              unsigned NumThreads) {
+  LLVMContext &C = M.getContext();
+  const Type *I32 = Type::getInt32Ty(C);
+  std::vector<const Type*> Params(1, I32);
+  FunctionType *FTy = FunctionType::get(I32, Params, false);
+
+  std::vector<BodyBuilder> Builders(NumThreads);
+  for (unsigned i = 0; i != NumThreads; ++i) {
+    Builders[i].Shared = &Shared;
+    Builders[i].NumOps = NumOps;
+  }
+  for (unsigned i = 0; i != NumFunctions; ++i)
+    Builders[i % NumThreads].Functions.push_back(
+      Function::Create(FTy, GlobalValue::ExternalLinkage, "", &M));
+
+  std::vector<void*> Args;
+  for (unsigned i = 0; i != NumThreads; ++i)
+    Args.push_back(&Builders[i]);
+  llvm_execute_on_threads(BodyBuilder::run, &Args[0], NumThreads);
+}
+
+static SharedValues CreateSharedValues(Module &M) {
+  LLVMContext &C = M.getContext();
+  const Type *I32 = Type::getInt32Ty(C);
+  std::vector<const Type*> Params(1, I32);
+  SharedValues Shared;
+  Shared.Callee = Function::Create(FunctionType::get(I32, Params, false),
+                                   GlobalValue::ExternalLinkage, "callee", &M);
+  Shared.G = new GlobalVariable(M, I32, false, GlobalValue::ExternalLinkage,
+                                0, "G");
+  Shared.KindID = C.getMDKindID("tag");
+  return Shared;
+}
+
+TEST(LLVMContextTest, ConcurrentConstruction) {
+  // Without thread support, the bodies are built one after another.
+  bool StartedThreads = !llvm_is_multithreaded() && llvm_start_multithreaded();
+
+  const unsigned NumFunctions = 64, NumOps = 256, NumThreads = 8;
+  LLVMContext C;
+  Module M("ConcurrentConstruction", C);
+  SharedValues Shared = CreateSharedValues(M);
+  BuildConcurrently(M, Shared, NumFunctions, NumOps, NumThreads);
+
+  if (StartedThreads)
+    llvm_stop_multithreaded();
+
+  EXPECT_FALSE(verifyModule(M, ReturnStatusAction));
+
+  // Every function saw the same uniqued constants and metadata.
+  const Type *I32 = Type::getInt32Ty(C);
+  Constant *CE = ConstantExpr::getPtrToInt(Shared.G, I32);
+  EXPECT_EQ(NumFunctions * NumOps * 7 / 16, CE->getNumUses());
+  EXPECT_EQ(1U, Shared.G->getNumUses());
+  EXPECT_EQ(NumFunctions * NumOps / 16, Shared.Callee->getNumUses());
+  for (unsigned j = 0; j != 64; j += 2)
+    EXPECT_EQ(NumFunctions * NumOps / 64,
+              ConstantInt::get(I32, j)->getNumUses()) << "constant " << j;
+
+  for (Module::iterator F = M.begin(), FE = M.end(); F != FE; ++F)
+    for (Function::iterator BB = F->begin(), BBE = F->end(); BB != BBE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+        if (MDNode *N = I->getMetadata(Shared.KindID)) {
+          Value *Elts[] = { N->getOperand(0) };
+          EXPECT_EQ(N, MDNode::get(C, Elts));
+        }
+}
+
+// Builds the same IR on 1 to 32 threads. Run it with
+// --gtest_also_run_disabled_tests --gtest_filter=*ConstructionBenchmark to
+// time them.
+TEST(LLVMContextTest, DISABLED_ConcurrentConstructionBenchmark) {
+  bool StartedThreads = !llvm_is_multithreaded() && llvm_start_multithreaded();
+
+  for (unsigned NumThreads = 1; NumThreads <= 32; NumThreads *= 2) {
+    sys::TimeValue Start = sys::TimeValue::now();
+    {
+      LLVMContext C;
+      Module M("ConcurrentConstructionBenchmark", C);
+      SharedValues Shared = CreateSharedValues(M);
+      BuildConcurrently(M, Shared, 1024, 2048, NumThreads);
+    }
+    errs() << NumThreads << " threads: "
+           << (sys::TimeValue::now() - Start).msec() << " ms\n";
+  }
+
+  if (StartedThreads)
+    llvm_stop_multithreaded();
+}
+
+}  // end anonymous namespace
+}  // end namespace llvm
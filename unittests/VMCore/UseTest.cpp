@@ -0,0 +1,138 @@
+//===- llvm/unittest/VMCore/UseTest.cpp - Use unit tests ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Argument.h"
+#include "llvm/BasicBlock.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace llvm {
+namespace {
+
+// Check that every operand of U finds its way back to U.
+static void ExpectUsersFound(const User *U) {
+  for (unsigned i = 0, e = U->getNumOperands(); i != e; ++i)
+    EXPECT_EQ(U, U->getOperandUse(i).getUser()) << "operand " << i;
+}
+
+TEST(UseTest, CoAllocatedOperands) {
+  LLVMContext &C(getGlobalContext());
+  const Type *I32 = Type::getInt32Ty(C);
+  Argument *Arg = new Argument(I32);
+
+  // Cover operand lists on either side of the ones that hold their distance
+  // from the User outright.
+  for (unsigned N = 0; N != 70; ++N) {
+    std::vector<const Type*> Params(N, I32);
+    FunctionType *FTy = FunctionType::get(I32, Params, false);
+    Argument *Callee = new Argument(PointerType::getUnqual(FTy));
+    std::vector<Value*> Args(N, Arg);
+    CallInst *CI = CallInst::Create(Callee, Args.begin(), Args.end());
+    ExpectUsersFound(CI);
+
+    unsigned Seen = 0;
+    for (Value::use_iterator UI = Arg->use_begin(), UE = Arg->use_end();
+         UI != UE; ++UI, ++Seen) {
+      EXPECT_EQ(CI, *UI);
+      EXPECT_EQ(Arg, CI->getOperand(UI.getOperandNo()));
+    }
+    EXPECT_EQ(N, Seen);
+
+    delete CI;
+    delete Callee;
+  }
+  delete Arg;
+}
+
+TEST(UseTest, HungOffOperands) {
+  LLVMContext &C(getGlobalContext());
+  const Type *I32 = Type::getInt32Ty(C);
+  Argument *A = new Argument(I32);
+  Argument *B = new Argument(I32);
+  BasicBlock *BB = BasicBlock::Create(C);
+
+  // Growing the operand list moves the Uses to a new array.
+  PHINode *PN = PHINode::Create(I32, 1);
+  for (unsigned i = 0; i != 100; ++i) {
+    PN->addIncoming(i % 2 ? A : B, BB);
+    ExpectUsersFound(PN);
+  }
+  for (Value::use_iterator UI = A->use_begin(), UE = A->use_end();
+       UI != UE; ++UI) {
+    EXPECT_EQ(PN, *UI);
+    unsigned i = PHINode::getIncomingValueNumForOperand(UI.getOperandNo());
+    EXPECT_EQ(1U, i % 2);
+  }
+
+  // Relinking Uses into other use lists must not disturb the tags.
+  A->replaceAllUsesWith(B);
+  EXPECT_TRUE(A->use_empty());
+  ExpectUsersFound(PN);
+  PN->setIncomingValue(7, A);
+  PN->setIncomingValue(3, A);
+  PN->removeIncomingValue(5u, false);
+  ExpectUsersFound(PN);
+  B->replaceAllUsesWith(A);
+  ExpectUsersFound(PN);
+  EXPECT_TRUE(B->use_empty());
+
+  unsigned Seen = 0;
+  for (Value::use_iterator UI = A->use_begin(), UE = A->use_end();
+       UI != UE; ++UI, ++Seen)
+    EXPECT_EQ(PN, *UI);
+  EXPECT_EQ(99U, Seen);
+
+  delete PN;
+  delete BB;
+  delete A;
+  delete B;
+}
+
+// getUser over calls with operand lists that fit in the directly tagged
+// Uses, and longer ones that partly fall back to waymarking.
+TEST(UseTest, DISABLED_GetUserBenchmark) {
+  LLVMContext &C(getGlobalContext());
+  const Type *I32 = Type::getInt32Ty(C);
+  Argument *Arg = new Argument(I32);
+
+  static const unsigned NumArgs[] = { 1, 2, 4, 11, 16, 40 };
+  const unsigned NumSizes = sizeof(NumArgs) / sizeof(NumArgs[0]);
+  std::vector<Argument*> Callees;
+  std::vector<CallInst*> Calls;
+  for (unsigned s = 0; s != NumSizes; ++s) {
+    std::vector<const Type*> Params(NumArgs[s], I32);
+    FunctionType *FTy = FunctionType::get(I32, Params, false);
+    Callees.push_back(new Argument(PointerType::getUnqual(FTy)));
+    std::vector<Value*> Args(NumArgs[s], Arg);
+    for (unsigned i = 0; i != 1000; ++i)
+      Calls.push_back(CallInst::Create(Callees.back(), Args.begin(),
+                                       Args.end()));
+  }
+
+  unsigned Found = 0, Total = 0;
+  for (unsigned Round = 0; Round != 1000; ++Round)
+    for (unsigned c = 0, ce = Calls.size(); c != ce; ++c) {
+      CallInst *CI = Calls[c];
+      for (unsigned i = 0, e = CI->getNumOperands(); i != e; ++i, ++Total)
+        Found += CI->getOperandUse(i).getUser() == CI;
+    }
+  EXPECT_EQ(Total, Found);
+
+  for (unsigned c = 0, ce = Calls.size(); c != ce; ++c)
+    delete Calls[c];
+  for (unsigned s = 0; s != NumSizes; ++s)
+    delete Callees[s];
+  delete Arg;
+}
+
+} // end anonymous namespace
+} // end namespace llvm